@@ -0,0 +1,88 @@
+// Benchmarks for RPC wire encodings
+//
+// Serializes and parses a `list_surfaces` response the size of a busy scene
+// in JSON and in MessagePack, the two encodings a client can negotiate.
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion};
+use serde_json::json;
+use std::hint::black_box;
+use weston_ivi_controller::rpc::msgpack;
+use weston_ivi_controller::rpc::protocol::{Encoding, RpcMessage, RpcResponse};
+
+/// A response shaped like the handler's `list_surfaces` result
+fn list_surfaces_response(count: u32) -> RpcResponse {
+    let surfaces: Vec<serde_json::Value> = (0..count)
+        .map(|i| {
+            json!({
+                "id": 1000 + i,
+                "orig_size": { "width": 1920, "height": 1080 },
+                "src_rect": { "x": 0, "y": 0, "width": 1920, "height": 1080 },
+                "dest_rect": { "x": (i * 64) as i32, "y": 0, "width": 640, "height": 360 },
+                "visibility": i % 2 == 0,
+                "opacity": 0.75,
+                "orientation": "Normal",
+                "z_order": i as i32,
+            })
+        })
+        .collect();
+
+    RpcResponse::success(1, json!({ "surfaces": surfaces }))
+}
+
+fn bench_encode(c: &mut Criterion) {
+    let mut group = c.benchmark_group("encoding/encode");
+    let response = list_surfaces_response(64);
+
+    for encoding in [Encoding::Json, Encoding::MessagePack] {
+        group.bench_with_input(
+            BenchmarkId::from_parameter(encoding.name()),
+            &encoding,
+            |b, encoding| b.iter(|| black_box(response.encode(*encoding).unwrap())),
+        );
+    }
+
+    group.finish();
+}
+
+fn bench_decode(c: &mut Criterion) {
+    let mut group = c.benchmark_group("encoding/decode");
+    let response = list_surfaces_response(64);
+
+    let json = response.encode(Encoding::Json).unwrap();
+    group.bench_function("json", |b| {
+        b.iter(|| black_box(serde_json::from_slice::<serde_json::Value>(&json).unwrap()))
+    });
+
+    let binary = response.encode(Encoding::MessagePack).unwrap();
+    group.bench_function("msgpack", |b| {
+        b.iter(|| black_box(msgpack::decode(&binary).unwrap()))
+    });
+
+    group.finish();
+}
+
+fn bench_request(c: &mut Criterion) {
+    let mut group = c.benchmark_group("encoding/request");
+    let request = json!({
+        "id": 42,
+        "method": "set_surface_destination_rectangle",
+        "params": { "id": 1000, "x": 0, "y": 0, "width": 1920, "height": 1080 }
+    });
+
+    for encoding in [Encoding::Json, Encoding::MessagePack] {
+        let data = match encoding {
+            Encoding::Json => serde_json::to_vec(&request).unwrap(),
+            Encoding::MessagePack => msgpack::to_vec(&request),
+        };
+        group.bench_with_input(
+            BenchmarkId::from_parameter(encoding.name()),
+            &data,
+            |b, data| b.iter(|| black_box(RpcMessage::decode(data, encoding).unwrap())),
+        );
+    }
+
+    group.finish();
+}
+
+criterion_group!(benches, bench_encode, bench_decode, bench_request);
+criterion_main!(benches);
@@ -0,0 +1,282 @@
+// Benchmarks for length-prefixed frame decoding
+//
+// Compares the in-place FrameReader against the previous implementation,
+// which staged reads through a 4 KiB stack buffer and removed consumed bytes
+// from the front of a Vec with `drain`, and measures `write_frame` throughput.
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use std::hint::black_box;
+use std::io::{self, Cursor, Read};
+use weston_ivi_controller::rpc::framing::{write_frame, FillStatus, FrameReadResult, FrameReader};
+
+/// The FrameReader as it was before frames were parsed in place
+mod legacy {
+    use std::io::{self, Read};
+    use weston_ivi_controller::rpc::framing::{FrameReadResult, MAX_MESSAGE_SIZE};
+
+    enum ReadState {
+        WaitingForHeader {
+            header_buf: [u8; 4],
+            bytes_read: usize,
+        },
+        WaitingForPayload {
+            expected_len: u32,
+            bytes_read: usize,
+            buffer: Vec<u8>,
+        },
+    }
+
+    impl Default for ReadState {
+        fn default() -> Self {
+            ReadState::WaitingForHeader {
+                header_buf: [0; 4],
+                bytes_read: 0,
+            }
+        }
+    }
+
+    #[derive(Default)]
+    pub struct FrameReader {
+        state: ReadState,
+        buffer: Vec<u8>,
+    }
+
+    impl FrameReader {
+        pub fn read_frame<R: Read>(&mut self, reader: &mut R) -> io::Result<FrameReadResult> {
+            loop {
+                if !self.buffer.is_empty() {
+                    if let Some(message) = self.try_extract_message()? {
+                        return Ok(FrameReadResult::Complete(message));
+                    }
+                }
+
+                let mut temp_buf = [0u8; 4096];
+                let n = match reader.read(&mut temp_buf) {
+                    Ok(0) => return Ok(FrameReadResult::Eof),
+                    Ok(n) => n,
+                    Err(e) if e.kind() == io::ErrorKind::WouldBlock => {
+                        return Ok(FrameReadResult::NeedMore)
+                    }
+                    Err(e) if e.kind() == io::ErrorKind::Interrupted => continue,
+                    Err(e) => return Err(e),
+                };
+
+                self.buffer.extend_from_slice(&temp_buf[..n]);
+
+                if let Some(message) = self.try_extract_message()? {
+                    return Ok(FrameReadResult::Complete(message));
+                }
+            }
+        }
+
+        fn try_extract_message(&mut self) -> io::Result<Option<Vec<u8>>> {
+            loop {
+                match &mut self.state {
+                    ReadState::WaitingForHeader {
+                        header_buf,
+                        bytes_read,
+                    } => {
+                        let needed = 4 - *bytes_read;
+                        let available = self.buffer.len();
+                        if available == 0 {
+                            return Ok(None);
+                        }
+
+                        let to_copy = needed.min(available);
+                        header_buf[*bytes_read..*bytes_read + to_copy]
+                            .copy_from_slice(&self.buffer[..to_copy]);
+                        self.buffer.drain(..to_copy);
+                        *bytes_read += to_copy;
+
+                        if *bytes_read == 4 {
+                            let msg_len = u32::from_be_bytes(*header_buf);
+                            if msg_len == 0 || msg_len > MAX_MESSAGE_SIZE {
+                                return Err(io::Error::new(
+                                    io::ErrorKind::InvalidData,
+                                    "Invalid message length",
+                                ));
+                            }
+
+                            self.state = ReadState::WaitingForPayload {
+                                expected_len: msg_len,
+                                bytes_read: 0,
+                                buffer: Vec::with_capacity(msg_len as usize),
+                            };
+                        }
+                    }
+                    ReadState::WaitingForPayload {
+                        expected_len,
+                        bytes_read,
+                        buffer,
+                    } => {
+                        let needed = (*expected_len as usize) - *bytes_read;
+                        let available = self.buffer.len();
+                        if available == 0 {
+                            return Ok(None);
+                        }
+
+                        let to_copy = needed.min(available);
+                        buffer.extend_from_slice(&self.buffer[..to_copy]);
+                        self.buffer.drain(..to_copy);
+                        *bytes_read += to_copy;
+
+                        if *bytes_read == *expected_len as usize {
+                            let message = std::mem::take(buffer);
+                            self.state = ReadState::default();
+                            return Ok(Some(message));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// Source that behaves like a non-blocking socket: WouldBlock once drained
+struct NonBlockingSource<'a> {
+    cursor: Cursor<&'a [u8]>,
+}
+
+impl<'a> NonBlockingSource<'a> {
+    fn new(data: &'a [u8]) -> Self {
+        Self {
+            cursor: Cursor::new(data),
+        }
+    }
+}
+
+impl Read for NonBlockingSource<'_> {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        match self.cursor.read(buf)? {
+            0 => Err(io::Error::from(io::ErrorKind::WouldBlock)),
+            n => Ok(n),
+        }
+    }
+}
+
+/// Encode `count` frames of `size` bytes back to back, as a pipelining client would
+fn pipelined_stream(count: usize, size: usize) -> Vec<u8> {
+    let payload = vec![b'x'; size];
+    let mut data = Vec::with_capacity(count * (size + 4));
+    for _ in 0..count {
+        write_frame(&mut data, &payload).unwrap();
+    }
+    data
+}
+
+fn bench_pipelined_requests(c: &mut Criterion) {
+    let mut group = c.benchmark_group("framing/pipelined");
+
+    for &(count, size) in &[(64, 128), (1024, 128), (256, 4096)] {
+        let data = pipelined_stream(count, size);
+        let label = format!("{}x{}B", count, size);
+        group.throughput(Throughput::Bytes(data.len() as u64));
+
+        group.bench_with_input(BenchmarkId::new("legacy", &label), &data, |b, data| {
+            b.iter(|| {
+                let mut source = NonBlockingSource::new(data);
+                let mut reader = legacy::FrameReader::default();
+                let mut frames = 0;
+                while let FrameReadResult::Complete(message) =
+                    reader.read_frame(&mut source).unwrap()
+                {
+                    black_box(&message);
+                    frames += 1;
+                }
+                assert_eq!(frames, count);
+            })
+        });
+
+        group.bench_with_input(BenchmarkId::new("read_frame", &label), &data, |b, data| {
+            b.iter(|| {
+                let mut source = NonBlockingSource::new(data);
+                let mut reader = FrameReader::new();
+                let mut frames = 0;
+                while let FrameReadResult::Complete(message) =
+                    reader.read_frame(&mut source).unwrap()
+                {
+                    black_box(&message);
+                    frames += 1;
+                }
+                assert_eq!(frames, count);
+            })
+        });
+
+        group.bench_with_input(BenchmarkId::new("borrowed", &label), &data, |b, data| {
+            b.iter(|| {
+                let mut source = NonBlockingSource::new(data);
+                let mut reader = FrameReader::new();
+                let mut frames = 0;
+                loop {
+                    let status = reader.fill_from(&mut source, 64 * 1024).unwrap();
+                    while let Some(message) = reader.next_frame().unwrap() {
+                        black_box(message);
+                        frames += 1;
+                    }
+                    if status != FillStatus::BudgetExhausted {
+                        break;
+                    }
+                }
+                assert_eq!(frames, count);
+            })
+        });
+    }
+
+    group.finish();
+}
+
+fn bench_large_frame(c: &mut Criterion) {
+    let mut group = c.benchmark_group("framing/large");
+    let data = pipelined_stream(1, 1024 * 1024);
+    group.throughput(Throughput::Bytes(data.len() as u64));
+
+    // Readers live as long as their connection, so they are reused across iterations
+
+    group.bench_function("legacy", |b| {
+        let mut reader = legacy::FrameReader::default();
+        b.iter(|| {
+            let mut source = NonBlockingSource::new(&data);
+            black_box(reader.read_frame(&mut source).unwrap());
+        })
+    });
+
+    group.bench_function("borrowed", |b| {
+        let mut reader = FrameReader::new();
+        b.iter(|| {
+            let mut source = NonBlockingSource::new(&data);
+            reader.fill_from(&mut source, usize::MAX).unwrap();
+            black_box(reader.next_frame().unwrap());
+        })
+    });
+
+    group.finish();
+}
+
+fn bench_write(c: &mut Criterion) {
+    let mut group = c.benchmark_group("framing/write");
+
+    for size in [128usize, 4096, 64 * 1024] {
+        let payload = vec![b'x'; size];
+        group.throughput(Throughput::Bytes(size as u64 + 4));
+
+        // The output buffer is reused, as a connection reuses its write buffer
+        let mut out = Vec::with_capacity(size + 4);
+        group.bench_with_input(BenchmarkId::from_parameter(size), &payload, |b, payload| {
+            b.iter(|| {
+                out.clear();
+                write_frame(&mut out, payload).unwrap();
+                black_box(&out);
+            })
+        });
+    }
+
+    group.finish();
+}
+
+criterion_group!(
+    benches,
+    bench_pipelined_requests,
+    bench_large_frame,
+    bench_write
+);
+criterion_main!(benches);
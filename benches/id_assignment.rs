@@ -0,0 +1,97 @@
+// Benchmarks for automatic surface ID assignment
+//
+// Measures one assignment while a stretch of the range in front of the
+// assigner is already taken, at rising occupancy and after a wraparound.
+// The linear probe the assigner used before the registry kept runs of
+// active IDs is measured alongside for comparison.
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion};
+use std::hint::black_box;
+use weston_ivi_controller::controller::id_assignment::{
+    IdAssigner, IdAssignmentConfig, SurfaceIdRegistry,
+};
+
+/// IDs in the benchmark assignment range
+const RANGE_SIZE: u32 = 1 << 16;
+const START_ID: u32 = 0x10000000;
+
+fn config() -> IdAssignmentConfig {
+    IdAssignmentConfig::new(START_ID, START_ID + RANGE_SIZE - 1, 0xFFFFFFFF).unwrap()
+}
+
+/// Registry with the first `percent` of the range active
+fn occupied_registry(percent: u32) -> SurfaceIdRegistry {
+    let mut registry = SurfaceIdRegistry::new(config());
+    for id in START_ID..START_ID + RANGE_SIZE / 100 * percent {
+        registry.register_id(id, true).unwrap();
+    }
+    registry
+}
+
+/// The assignment search as it was: probe each ID from `from` on
+fn linear_probe(registry: &SurfaceIdRegistry, config: &IdAssignmentConfig, from: u32) -> u32 {
+    let mut id = from;
+    while !registry.is_available(id) {
+        id = if id >= config.max_id {
+            config.start_id
+        } else {
+            id + 1
+        };
+    }
+    id
+}
+
+fn bench_occupancy(c: &mut Criterion) {
+    let mut group = c.benchmark_group("id_assignment/occupancy");
+    let config = config();
+
+    for percent in [50, 90, 99] {
+        let registry = occupied_registry(percent);
+        let mut assigner = IdAssigner::new(config.clone());
+
+        group.bench_with_input(BenchmarkId::new("runs", percent), &percent, |b, _| {
+            b.iter(|| {
+                assigner.set_current_id(START_ID).unwrap();
+                black_box(assigner.assign_next_id(&registry).unwrap())
+            })
+        });
+        group.bench_with_input(BenchmarkId::new("linear", percent), &percent, |b, _| {
+            b.iter(|| black_box(linear_probe(&registry, &config, START_ID)))
+        });
+    }
+
+    group.finish();
+}
+
+fn bench_wraparound(c: &mut Criterion) {
+    let mut group = c.benchmark_group("id_assignment/wraparound");
+    let config = config();
+
+    // The whole range is taken except for one ID near its start, and the
+    // assigner is in the middle: the search runs to max_id and wraps
+    let mut registry = occupied_registry(100);
+    for id in START_ID + RANGE_SIZE / 100 * 100..=config.max_id {
+        registry.register_id(id, true).unwrap();
+    }
+    let free_id = START_ID + 16;
+    registry.release_id(free_id).unwrap();
+    let from = START_ID + RANGE_SIZE / 2;
+    let mut assigner = IdAssigner::new(config.clone());
+
+    group.bench_function("runs", |b| {
+        b.iter(|| {
+            assigner.set_current_id(from).unwrap();
+            let result = assigner.assign_next_id(&registry).unwrap();
+            assert_eq!(result.assigned_id, free_id);
+            black_box(result)
+        })
+    });
+    group.bench_function("linear", |b| {
+        b.iter(|| black_box(linear_probe(&registry, &config, from)))
+    });
+
+    group.finish();
+}
+
+criterion_group!(benches, bench_occupancy, bench_wraparound);
+criterion_main!(benches);
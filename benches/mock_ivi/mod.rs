@@ -0,0 +1,255 @@
+// Mock IVI layout API standing in for Weston in benchmarks
+//
+// Serves a fixed scene of surfaces on one layer through an
+// `ivi_layout_interface` table of plain functions, so that measurements
+// cover the controller and not the compositor. Handles point at the mock
+// objects themselves. Benchmarks issue one request at a time, so property
+// writes are not synchronized.
+
+use std::cell::UnsafeCell;
+use std::sync::{Arc, OnceLock};
+use weston_ivi_controller::ffi::bindings::ivi_layout_api::IviLayoutApi;
+use weston_ivi_controller::ffi::bindings::{
+    f32_to_wl_fixed_t, ivi_layout_interface, ivi_layout_layer, ivi_layout_layer_properties,
+    ivi_layout_surface, ivi_layout_surface_properties, wl_fixed_t, IVI_SUCCEEDED,
+};
+
+/// ID of the first mock surface; the others follow it
+pub const FIRST_SURFACE_ID: u32 = 1000;
+/// ID of the layer holding every mock surface
+pub const LAYER_ID: u32 = 5000;
+
+struct MockSurface {
+    id: u32,
+    props: UnsafeCell<ivi_layout_surface_properties>,
+}
+
+struct MockLayer {
+    id: u32,
+    props: UnsafeCell<ivi_layout_layer_properties>,
+    surfaces: Vec<*mut ivi_layout_surface>,
+}
+
+struct MockScene {
+    surfaces: Vec<MockSurface>,
+    surface_handles: Vec<*mut ivi_layout_surface>,
+    layer: Box<MockLayer>,
+    layer_handles: Vec<*mut ivi_layout_layer>,
+}
+
+// Safety: the scene is built once and never resized; see the file comment
+// for property writes
+unsafe impl Send for MockScene {}
+unsafe impl Sync for MockScene {}
+
+static SCENE: OnceLock<MockScene> = OnceLock::new();
+
+fn scene() -> &'static MockScene {
+    SCENE.get().expect("mock IVI scene not created")
+}
+
+fn surface(handle: *mut ivi_layout_surface) -> &'static MockSurface {
+    unsafe { &*(handle as *const MockSurface) }
+}
+
+fn layer(handle: *mut ivi_layout_layer) -> &'static MockLayer {
+    unsafe { &*(handle as *const MockLayer) }
+}
+
+fn build_scene(surface_count: u32) -> MockScene {
+    let surfaces: Vec<MockSurface> = (0..surface_count)
+        .map(|i| {
+            let mut props: ivi_layout_surface_properties = unsafe { std::mem::zeroed() };
+            props.opacity = f32_to_wl_fixed_t(1.0);
+            props.source_width = 1920;
+            props.source_height = 1080;
+            props.dest_x = (i % 8) as i32 * 240;
+            props.dest_y = (i / 8) as i32 * 135;
+            props.dest_width = 240;
+            props.dest_height = 135;
+            props.visibility = true;
+            MockSurface {
+                id: FIRST_SURFACE_ID + i,
+                props: UnsafeCell::new(props),
+            }
+        })
+        .collect();
+    let surface_handles: Vec<*mut ivi_layout_surface> = surfaces
+        .iter()
+        .map(|s| s as *const MockSurface as *mut ivi_layout_surface)
+        .collect();
+
+    let mut props: ivi_layout_layer_properties = unsafe { std::mem::zeroed() };
+    props.opacity = f32_to_wl_fixed_t(1.0);
+    props.source_width = 1920;
+    props.source_height = 1080;
+    props.dest_width = 1920;
+    props.dest_height = 1080;
+    props.visibility = true;
+    let layer = Box::new(MockLayer {
+        id: LAYER_ID,
+        props: UnsafeCell::new(props),
+        surfaces: surface_handles.clone(),
+    });
+    let layer_handles = vec![&*layer as *const MockLayer as *mut ivi_layout_layer];
+
+    MockScene {
+        surfaces,
+        surface_handles,
+        layer,
+        layer_handles,
+    }
+}
+
+unsafe extern "C" fn commit_changes() -> i32 {
+    IVI_SUCCEEDED
+}
+
+unsafe extern "C" fn get_surfaces(
+    length: *mut i32,
+    array: *mut *mut *mut ivi_layout_surface,
+) -> i32 {
+    let scene = scene();
+    *length = scene.surface_handles.len() as i32;
+    *array = scene.surface_handles.as_ptr() as *mut *mut ivi_layout_surface;
+    IVI_SUCCEEDED
+}
+
+unsafe extern "C" fn get_id_of_surface(handle: *mut ivi_layout_surface) -> u32 {
+    surface(handle).id
+}
+
+unsafe extern "C" fn get_surface_from_id(id: u32) -> *mut ivi_layout_surface {
+    let scene = scene();
+    id.checked_sub(FIRST_SURFACE_ID)
+        .and_then(|index| scene.surfaces.get(index as usize))
+        .map_or(std::ptr::null_mut(), |s| {
+            s as *const MockSurface as *mut ivi_layout_surface
+        })
+}
+
+unsafe extern "C" fn get_properties_of_surface(
+    handle: *mut ivi_layout_surface,
+) -> *const ivi_layout_surface_properties {
+    surface(handle).props.get()
+}
+
+unsafe extern "C" fn surface_set_visibility(handle: *mut ivi_layout_surface, visible: bool) -> i32 {
+    (*surface(handle).props.get()).visibility = visible;
+    IVI_SUCCEEDED
+}
+
+unsafe extern "C" fn surface_set_opacity(
+    handle: *mut ivi_layout_surface,
+    opacity: wl_fixed_t,
+) -> i32 {
+    (*surface(handle).props.get()).opacity = opacity;
+    IVI_SUCCEEDED
+}
+
+unsafe extern "C" fn surface_set_source_rectangle(
+    handle: *mut ivi_layout_surface,
+    x: i32,
+    y: i32,
+    width: i32,
+    height: i32,
+) -> i32 {
+    let props = &mut *surface(handle).props.get();
+    props.source_x = x;
+    props.source_y = y;
+    props.source_width = width;
+    props.source_height = height;
+    IVI_SUCCEEDED
+}
+
+unsafe extern "C" fn surface_set_destination_rectangle(
+    handle: *mut ivi_layout_surface,
+    x: i32,
+    y: i32,
+    width: i32,
+    height: i32,
+) -> i32 {
+    let props = &mut *surface(handle).props.get();
+    props.dest_x = x;
+    props.dest_y = y;
+    props.dest_width = width;
+    props.dest_height = height;
+    IVI_SUCCEEDED
+}
+
+unsafe extern "C" fn get_layers(length: *mut i32, array: *mut *mut *mut ivi_layout_layer) -> i32 {
+    let scene = scene();
+    *length = scene.layer_handles.len() as i32;
+    *array = scene.layer_handles.as_ptr() as *mut *mut ivi_layout_layer;
+    IVI_SUCCEEDED
+}
+
+unsafe extern "C" fn get_id_of_layer(handle: *mut ivi_layout_layer) -> u32 {
+    layer(handle).id
+}
+
+unsafe extern "C" fn get_layer_from_id(id: u32) -> *mut ivi_layout_layer {
+    let scene = scene();
+    if id == scene.layer.id {
+        scene.layer_handles[0]
+    } else {
+        std::ptr::null_mut()
+    }
+}
+
+unsafe extern "C" fn get_properties_of_layer(
+    handle: *mut ivi_layout_layer,
+) -> *const ivi_layout_layer_properties {
+    layer(handle).props.get()
+}
+
+unsafe extern "C" fn get_surfaces_on_layer(
+    handle: *mut ivi_layout_layer,
+    length: *mut i32,
+    array: *mut *mut *mut ivi_layout_surface,
+) -> i32 {
+    let surfaces = &layer(handle).surfaces;
+    *length = surfaces.len() as i32;
+    *array = surfaces.as_ptr() as *mut *mut ivi_layout_surface;
+    IVI_SUCCEEDED
+}
+
+unsafe extern "C" fn layer_set_visibility(handle: *mut ivi_layout_layer, visible: bool) -> i32 {
+    (*layer(handle).props.get()).visibility = visible;
+    IVI_SUCCEEDED
+}
+
+unsafe extern "C" fn layer_set_opacity(handle: *mut ivi_layout_layer, opacity: wl_fixed_t) -> i32 {
+    (*layer(handle).props.get()).opacity = opacity;
+    IVI_SUCCEEDED
+}
+
+/// Create the mock API over a scene of `surface_count` surfaces.
+///
+/// The scene is shared by every API created in the process; later calls
+/// reuse the first one.
+pub fn mock_ivi_api(surface_count: u32) -> Arc<IviLayoutApi> {
+    SCENE.get_or_init(|| build_scene(surface_count));
+
+    // Entries left out stay null, which the wrapper reports as an error
+    let mut api: ivi_layout_interface = unsafe { std::mem::zeroed() };
+    api.commit_changes = Some(commit_changes);
+    api.get_surfaces = Some(get_surfaces);
+    api.get_id_of_surface = Some(get_id_of_surface);
+    api.get_surface_from_id = Some(get_surface_from_id);
+    api.get_properties_of_surface = Some(get_properties_of_surface);
+    api.surface_set_visibility = Some(surface_set_visibility);
+    api.surface_set_opacity = Some(surface_set_opacity);
+    api.surface_set_source_rectangle = Some(surface_set_source_rectangle);
+    api.surface_set_destination_rectangle = Some(surface_set_destination_rectangle);
+    api.get_layers = Some(get_layers);
+    api.get_id_of_layer = Some(get_id_of_layer);
+    api.get_layer_from_id = Some(get_layer_from_id);
+    api.get_properties_of_layer = Some(get_properties_of_layer);
+    api.get_surfaces_on_layer = Some(get_surfaces_on_layer);
+    api.layer_set_visibility = Some(layer_set_visibility);
+    api.layer_set_opacity = Some(layer_set_opacity);
+
+    let api: &'static ivi_layout_interface = Box::leak(Box::new(api));
+    Arc::new(IviLayoutApi::from_raw(api).unwrap())
+}
@@ -0,0 +1,196 @@
+// Benchmarks for RPC request parsing and response serialization
+//
+// Parses a typical request of every method, from bytes into an `RpcMethod`,
+// and serializes a typical response of every method to JSON. Each method is
+// a benchmark of its own, so a regression in one parser shows up by name.
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion};
+use serde_json::{json, Value};
+use std::hint::black_box;
+use weston_ivi_controller::rpc::protocol::{RpcMethod, RpcRequest, RpcResponse};
+
+const SURFACES_IN_LIST: u32 = 16;
+
+fn surface_json(id: u32) -> Value {
+    json!({
+        "id": id,
+        "orig_size": { "width": 1920, "height": 1080 },
+        "src_rect": { "x": 0, "y": 0, "width": 1920, "height": 1080 },
+        "dest_rect": { "x": 0, "y": 0, "width": 960, "height": 540 },
+        "visibility": true,
+        "opacity": 1.0,
+        "orientation": "Normal",
+        "z_order": 0,
+    })
+}
+
+fn layer_json(id: u32) -> Value {
+    json!({
+        "id": id,
+        "src_rect": { "x": 0, "y": 0, "width": 1920, "height": 1080 },
+        "dest_rect": { "x": 0, "y": 0, "width": 1920, "height": 1080 },
+        "visibility": true,
+        "opacity": 1.0,
+        "orientation": "Normal",
+    })
+}
+
+fn screen_json() -> Value {
+    json!({
+        "name": "HDMI-A-1",
+        "width": 1920,
+        "height": 1080,
+        "x": 0,
+        "y": 0,
+        "transform": "Normal",
+        "enabled": true,
+        "scale": 1,
+    })
+}
+
+/// Parameters of a typical request of `method`
+fn sample_params(method: &str) -> Value {
+    let rect = json!({ "id": 1000, "x": 0, "y": 0, "width": 960, "height": 540 });
+    match method {
+        "list_surfaces" | "commit" | "list_subscriptions" | "list_layers" | "list_screens" => {
+            json!({})
+        }
+        "get_surface" | "set_surface_focus" | "get_layer" | "destroy_layer" => {
+            json!({ "id": 1000 })
+        }
+        "set_surface_source_rectangle"
+        | "set_surface_destination_rectangle"
+        | "set_layer_source_rectangle"
+        | "set_layer_destination_rectangle" => rect,
+        "set_surface_visibility" | "set_layer_visibility" => {
+            json!({ "id": 1000, "visible": true, "auto_commit": true })
+        }
+        "set_surface_opacity" | "set_layer_opacity" => json!({ "id": 1000, "opacity": 0.5 }),
+        "set_surface_z_order" => json!({ "id": 1000, "z_order": 3 }),
+        "animate_surface" | "animate_layer" => json!({
+            "id": 1000,
+            "destination": { "x": 0, "y": 0, "width": 1920, "height": 1080 },
+            "opacity": 1.0,
+            "duration_ms": 300,
+            "easing": "ease_out",
+        }),
+        "subscribe" => json!({
+            "event_types": ["SurfaceCreated", "SurfaceDestroyed", "DestinationGeometryChanged"],
+            "surface_ids": [1000, 1001],
+            "coalesce": true,
+        }),
+        "unsubscribe" => json!({ "event_types": ["DestinationGeometryChanged"] }),
+        "handshake" => json!({ "encodings": ["msgpack", "json"] }),
+        "get_changes_since" => json!({ "generation": 42 }),
+        "get_metrics" => json!({ "format": "json" }),
+        "create_layer" => json!({ "id": 5000, "width": 1920, "height": 1080 }),
+        "set_layer_surfaces" => json!({ "layer_id": 5000, "surface_ids": [1000, 1001, 1002] }),
+        "add_surface_to_layer" | "remove_surface_from_layer" => {
+            json!({ "layer_id": 5000, "surface_id": 1000 })
+        }
+        "get_layer_surfaces" | "get_layer_screens" => json!({ "layer_id": 5000 }),
+        "get_screen" => json!({ "name": "HDMI-A-1" }),
+        "get_screen_layers" => json!({ "screen_name": "HDMI-A-1" }),
+        "add_layers_to_screen" => json!({ "screen_name": "HDMI-A-1", "layer_ids": [5000, 5001] }),
+        "remove_layer_from_screen" => json!({ "screen_name": "HDMI-A-1", "layer_id": 5000 }),
+        "define_scene" => json!({
+            "name": "navigation",
+            "surfaces": [{
+                "id": 1000,
+                "destination": { "x": 0, "y": 0, "width": 1920, "height": 1080 },
+                "visible": true,
+            }],
+            "layers": [{ "id": 5000, "surfaces": [1000, 1001], "visible": true }],
+            "screens": [{ "name": "HDMI-A-1", "layers": [5000] }],
+        }),
+        "apply_scene" => json!({ "name": "navigation" }),
+        _ => panic!("no sample request for method '{}'", method),
+    }
+}
+
+/// Result of a typical response to `method`
+fn sample_result(method: &str) -> Value {
+    match method {
+        "list_surfaces" => json!({
+            "surfaces": (0..SURFACES_IN_LIST).map(|i| surface_json(1000 + i)).collect::<Vec<_>>(),
+            "generation": 42,
+        }),
+        "get_surface" => surface_json(1000),
+        "list_layers" => json!({
+            "layers": (0..4).map(|i| layer_json(5000 + i)).collect::<Vec<_>>(),
+            "generation": 42,
+        }),
+        "get_layer" => layer_json(5000),
+        "get_changes_since" => json!({
+            "generation": 45,
+            "full": false,
+            "surfaces": [surface_json(1000), surface_json(1001)],
+            "layers": [],
+            "removed_surfaces": [1002],
+            "removed_layers": [],
+        }),
+        "list_screens" => json!({ "screens": [screen_json()] }),
+        "get_screen" => screen_json(),
+        "get_layer_surfaces" => json!({ "layer_id": 5000, "surface_ids": [1000, 1001, 1002] }),
+        "get_screen_layers" => json!({ "screen_name": "HDMI-A-1", "layer_ids": [5000, 5001] }),
+        "get_layer_screens" => json!({ "layer_id": 5000, "screens": ["HDMI-A-1"] }),
+        "subscribe" | "unsubscribe" | "list_subscriptions" => json!({
+            "event_types": ["SurfaceCreated", "SurfaceDestroyed", "DestinationGeometryChanged"],
+        }),
+        "handshake" => json!({ "encoding": "msgpack" }),
+        "animate_surface" | "animate_layer" => json!({
+            "success": true,
+            "animation_id": 7,
+            "duration_ms": 300,
+            "easing": "ease_out",
+        }),
+        "get_metrics" => json!({ "rpc": {}, "invalid_requests": 0 }),
+        "define_scene" => json!({ "name": "navigation", "operations": 5, "replaced": false }),
+        "apply_scene" => json!({ "name": "navigation", "operations": 5, "committed": true }),
+        _ => json!({ "success": true, "committed": false }),
+    }
+}
+
+fn bench_parse(c: &mut Criterion) {
+    let mut group = c.benchmark_group("protocol/parse");
+
+    for (index, method) in RpcMethod::NAMES.iter().enumerate() {
+        let data = serde_json::to_vec(&json!({
+            "id": index,
+            "method": method,
+            "params": sample_params(method),
+        }))
+        .unwrap();
+
+        // Every sample has to parse, otherwise the benchmark measures an error path
+        let request = RpcRequest::from_json(&data).unwrap();
+        assert_eq!(RpcMethod::from_request(&request).unwrap().name(), *method);
+
+        group.bench_with_input(BenchmarkId::from_parameter(method), &data, |b, data| {
+            b.iter(|| {
+                let request = RpcRequest::from_json(data).unwrap();
+                black_box(RpcMethod::from_request(&request).unwrap())
+            })
+        });
+    }
+
+    group.finish();
+}
+
+fn bench_serialize(c: &mut Criterion) {
+    let mut group = c.benchmark_group("protocol/serialize");
+
+    for (index, method) in RpcMethod::NAMES.iter().enumerate() {
+        let response = RpcResponse::success(index as u64, sample_result(method));
+        group.bench_with_input(
+            BenchmarkId::from_parameter(method),
+            &response,
+            |b, response| b.iter(|| black_box(response.to_json().unwrap())),
+        );
+    }
+
+    group.finish();
+}
+
+criterion_group!(benches, bench_parse, bench_serialize);
+criterion_main!(benches);
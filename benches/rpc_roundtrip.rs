@@ -0,0 +1,138 @@
+// Benchmarks for end-to-end request latency
+//
+// Runs the RPC handler behind a real UnixSocketTransport, with a mock IVI
+// layout API standing in for Weston, and measures one request from the
+// client writing it to the client holding the response. This covers framing,
+// the transport event loop, parsing, dispatch, state updates and encoding.
+
+use criterion::{criterion_group, criterion_main};
+
+#[cfg(not(feature = "enable-ipcon"))]
+mod mock_ivi;
+
+#[cfg(not(feature = "enable-ipcon"))]
+mod unix_socket {
+    use super::mock_ivi;
+    use criterion::Criterion;
+    use serde_json::{json, Value};
+    use std::hint::black_box;
+    use std::os::unix::net::UnixStream;
+    use std::path::PathBuf;
+    use std::sync::Arc;
+    use weston_ivi_controller::controller::state::StateManager;
+    use weston_ivi_controller::rpc::framing::{write_frame, FrameReadResult, FrameReader};
+    use weston_ivi_controller::rpc::RpcHandler;
+    use weston_ivi_controller::transport::unix_socket::UnixSocketConfig;
+    use weston_ivi_controller::transport::UnixSocketTransport;
+
+    /// Surfaces in the mock scene
+    const SURFACE_COUNT: u32 = 64;
+
+    /// Controller serving the mock scene on a socket of its own
+    struct Controller {
+        handler: Arc<RpcHandler>,
+        socket_path: PathBuf,
+    }
+
+    impl Controller {
+        fn start() -> Self {
+            let socket_path =
+                std::env::temp_dir().join(format!("ivi-bench-{}.sock", std::process::id()));
+
+            let state_manager = Arc::new(StateManager::new(mock_ivi::mock_ivi_api(SURFACE_COUNT)));
+            state_manager.sync_with_ivi();
+
+            let handler = RpcHandler::new(state_manager);
+            let transport = UnixSocketTransport::new(UnixSocketConfig {
+                socket_path: socket_path.clone(),
+                ..UnixSocketConfig::default()
+            });
+            handler.register_transport(Box::new(transport)).unwrap();
+            handler.start_transport().unwrap();
+
+            Self {
+                handler,
+                socket_path,
+            }
+        }
+    }
+
+    impl Drop for Controller {
+        fn drop(&mut self) {
+            let _ = self.handler.stop_transport();
+            let _ = std::fs::remove_file(&self.socket_path);
+        }
+    }
+
+    /// Blocking client that waits for each response before the next request
+    struct Client {
+        stream: UnixStream,
+        reader: FrameReader,
+        next_id: u64,
+    }
+
+    impl Client {
+        fn connect(controller: &Controller) -> Self {
+            Self {
+                stream: UnixStream::connect(&controller.socket_path).unwrap(),
+                reader: FrameReader::new(),
+                next_id: 1,
+            }
+        }
+
+        fn call(&mut self, method: &str, params: &Value) -> Vec<u8> {
+            let request = json!({ "id": self.next_id, "method": method, "params": params });
+            self.next_id += 1;
+            write_frame(&mut self.stream, &serde_json::to_vec(&request).unwrap()).unwrap();
+
+            loop {
+                match self.reader.read_frame(&mut self.stream).unwrap() {
+                    FrameReadResult::Complete(response) => return response,
+                    FrameReadResult::NeedMore => continue,
+                    FrameReadResult::Eof => panic!("controller closed the connection"),
+                }
+            }
+        }
+    }
+
+    pub fn bench_roundtrip(c: &mut Criterion) {
+        let mut group = c.benchmark_group("rpc_roundtrip");
+        let controller = Controller::start();
+        let mut client = Client::connect(&controller);
+
+        let requests = [
+            ("get_surface", json!({ "id": 1000 })),
+            ("list_surfaces", json!({})),
+            (
+                "set_surface_opacity",
+                json!({ "id": 1000, "opacity": 0.5, "auto_commit": false }),
+            ),
+            (
+                "set_surface_destination_rectangle",
+                json!({ "id": 1000, "x": 0, "y": 0, "width": 960, "height": 540, "auto_commit": true }),
+            ),
+        ];
+
+        for (method, params) in requests.iter() {
+            // A failing request would measure the error path instead
+            let response: Value = serde_json::from_slice(&client.call(method, params)).unwrap();
+            assert!(response.get("result").is_some(), "{}: {}", method, response);
+
+            group.bench_function(*method, |b| {
+                b.iter(|| black_box(client.call(method, params)))
+            });
+        }
+
+        group.finish();
+    }
+}
+
+#[cfg(not(feature = "enable-ipcon"))]
+use unix_socket::bench_roundtrip;
+
+// IPCON needs its kernel module and a peer, so only UNIX sockets are measured
+#[cfg(feature = "enable-ipcon")]
+fn bench_roundtrip(_c: &mut criterion::Criterion) {}
+
+criterion_group!(benches, bench_roundtrip);
+criterion_main!(benches);
@@ -0,0 +1,92 @@
+// Benchmarks for notification fan-out to subscribed clients
+//
+// Queues one notification to every subscriber and drains it the way the
+// delivery thread does, at rising client counts. Clients watching an object
+// the notification is not about are measured alongside, since they must be
+// skipped without cost.
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion};
+use serde_json::json;
+use std::hint::black_box;
+use weston_ivi_controller::controller::subscriptions::SubscriptionManager;
+use weston_ivi_controller::rpc::protocol::{EventType, RpcNotification, SubscriptionScope};
+use weston_ivi_controller::rpc::transport::ClientId;
+
+fn destination_changed(surface_id: u32) -> RpcNotification {
+    RpcNotification::new(
+        "notification".to_string(),
+        json!({
+            "event_type": "DestinationGeometryChanged",
+            "surface_id": surface_id,
+            "old_rect": { "x": 0, "y": 0, "width": 960, "height": 540 },
+            "new_rect": { "x": 0, "y": 0, "width": 1920, "height": 1080 },
+        }),
+    )
+}
+
+fn bench_fan_out(c: &mut Criterion) {
+    let mut group = c.benchmark_group("subscriptions/fan_out");
+
+    for clients in [1u64, 10, 100] {
+        let manager = SubscriptionManager::new();
+        for id in 0..clients {
+            manager
+                .subscribe(
+                    &ClientId::UnixDomainId(id),
+                    vec![EventType::DestinationGeometryChanged],
+                )
+                .unwrap();
+        }
+        let waiter = manager.waiter();
+
+        group.bench_with_input(BenchmarkId::new("global", clients), &clients, |b, _| {
+            b.iter(|| {
+                manager.queue_notification(
+                    EventType::DestinationGeometryChanged,
+                    destination_changed(1000),
+                );
+                black_box(waiter.wait_and_drain())
+            })
+        });
+    }
+
+    group.finish();
+}
+
+fn bench_scoped(c: &mut Criterion) {
+    let mut group = c.benchmark_group("subscriptions/scoped");
+
+    // Every client watches a surface of its own; one of them gets the notification
+    for clients in [1u64, 10, 100] {
+        let manager = SubscriptionManager::new();
+        for id in 0..clients {
+            let scope = SubscriptionScope {
+                surface_ids: vec![1000 + id as u32],
+                layer_ids: Vec::new(),
+            };
+            manager
+                .subscribe_scoped(
+                    &ClientId::UnixDomainId(id),
+                    vec![EventType::DestinationGeometryChanged],
+                    &scope,
+                )
+                .unwrap();
+        }
+        let waiter = manager.waiter();
+
+        group.bench_with_input(BenchmarkId::new("one_of", clients), &clients, |b, _| {
+            b.iter(|| {
+                manager.queue_notification(
+                    EventType::DestinationGeometryChanged,
+                    destination_changed(1000),
+                );
+                black_box(waiter.wait_and_drain())
+            })
+        });
+    }
+
+    group.finish();
+}
+
+criterion_group!(benches, bench_fan_out, bench_scoped);
+criterion_main!(benches);
@@ -4,12 +4,16 @@
 //! Controller, allowing users to manage surfaces and layers from the terminal.
 
 mod output;
+mod replay;
 
 use clap::{ArgAction, Parser, Subcommand};
-use ivi_client::{IviClient, IviError, Result};
+use ivi_client::{Encoding, IviClient, IviError, Result};
 #[allow(unused_imports)]
 use jlogger_tracing::{jdebug, jerror, jinfo, jwarn, JloggerBuilder, LevelFilter, LogTimeFormat};
+use std::io::{BufRead, IsTerminal, Write};
+use std::path::PathBuf;
 use std::result::Result as StdResult;
+use std::time::Duration;
 
 /// Command-line interface for Weston IVI Controller
 #[derive(Parser)]
@@ -21,6 +25,10 @@ struct Cli {
     #[command(subcommand)]
     command: Commands,
 
+    /// Controller socket path (default: /tmp/weston-ivi-controller.sock)
+    #[arg(long, global = true)]
+    socket: Option<String>,
+
     /// logging enable
     #[arg(short, long, default_value_t = false)]
     log: bool,
@@ -56,6 +64,72 @@ enum Commands {
     Scene,
     /// Commit pending changes atomically
     Commit,
+    /// Show controller latency and queue statistics
+    Stats {
+        /// Print the raw Prometheus text exposition
+        #[arg(long, default_value_t = false)]
+        prometheus: bool,
+    },
+    /// Replay a recorded session or a synthetic load and report latency
+    Replay(ReplayArgs),
+    /// Run commands read from stdin, one per line, over one connection
+    Shell {
+        /// Print no prompt and stop at the first command that fails
+        #[arg(long, default_value_t = false)]
+        batch: bool,
+    },
+}
+
+/// Arguments of the replay command
+#[derive(clap::Args)]
+struct ReplayArgs {
+    /// Recording made with the plugin's --record option
+    #[arg(required_unless_present = "rate")]
+    recording: Option<PathBuf>,
+
+    /// Connections a recording is replayed over (default: one per recorded client)
+    #[arg(long)]
+    connections: Option<usize>,
+
+    /// Playback speed of a recording; 0 sends as fast as the pipeline allows
+    #[arg(long, default_value_t = 1.0)]
+    speed: f64,
+
+    /// Synthetic load instead of a recording: updates per second over all clients
+    #[arg(long, conflicts_with = "recording")]
+    rate: Option<f64>,
+
+    /// Synthetic load: number of clients, one connection each
+    #[arg(long, default_value_t = 1)]
+    clients: usize,
+
+    /// Synthetic load: number of surfaces updated
+    #[arg(long, default_value_t = 10)]
+    surfaces: u32,
+
+    /// Synthetic load: ID of the first surface, the others follow it
+    #[arg(long, default_value_t = 1000)]
+    first_surface: u32,
+
+    /// Synthetic load: duration in seconds
+    #[arg(long, default_value_t = 10.0)]
+    duration: f64,
+
+    /// Most requests in flight on one connection
+    #[arg(long, default_value_t = 32)]
+    pipeline: usize,
+
+    /// Wire encoding of the replay connections (json or msgpack)
+    #[arg(long, default_value = "json")]
+    encoding: Encoding,
+}
+
+/// One line of shell input, parsed like the command line
+#[derive(Parser)]
+#[command(name = "ivi_cli", no_binary_name = true)]
+struct ShellLine {
+    #[command(subcommand)]
+    command: Commands,
 }
 
 /// Surface management commands
@@ -296,6 +370,87 @@ fn validate_opacity(opacity: f32) -> StdResult<(), ValidationError> {
     }
 }
 
+/// Validate a duration given in seconds
+fn validate_seconds(seconds: f64) -> StdResult<Duration, ValidationError> {
+    Duration::try_from_secs_f64(seconds).map_err(|_| ValidationError {
+        message: format!("Duration must be a number of seconds, got: {}", seconds),
+    })
+}
+
+/// Split a shell line into words, honouring single and double quotes
+fn split_shell_words(line: &str) -> StdResult<Vec<String>, String> {
+    let mut words = Vec::new();
+    let mut word = String::new();
+    let mut in_word = false;
+    let mut quote = None;
+
+    for c in line.chars() {
+        match (quote, c) {
+            (Some(q), c) if c == q => quote = None,
+            (Some(_), c) => word.push(c),
+            (None, '"' | '\'') => {
+                quote = Some(c);
+                in_word = true;
+            }
+            (None, c) if c.is_whitespace() => {
+                if in_word {
+                    words.push(std::mem::take(&mut word));
+                    in_word = false;
+                }
+            }
+            (None, c) => {
+                word.push(c);
+                in_word = true;
+            }
+        }
+    }
+
+    if quote.is_some() {
+        return Err("Unterminated quote".to_string());
+    }
+    if in_word {
+        words.push(word);
+    }
+    Ok(words)
+}
+
+/// Parse one line of shell input into a command
+fn parse_shell_line(line: &str) -> StdResult<Commands, clap::Error> {
+    let words = split_shell_words(line)
+        .map_err(|e| clap::Error::raw(clap::error::ErrorKind::InvalidValue, e))?;
+    ShellLine::try_parse_from(words).map(|line| line.command)
+}
+
+/// Handle replay command
+fn handle_replay(args: ReplayArgs, remote: Option<&str>) -> Result<String> {
+    let schedule = match (&args.recording, args.rate) {
+        (Some(path), _) => replay::load_recording(path, args.connections, args.speed)?,
+        (None, Some(rate)) => replay::synthetic_schedule(&replay::SyntheticProfile {
+            clients: args.clients,
+            first_surface: args.first_surface,
+            surfaces: args.surfaces,
+            rate,
+            duration: validate_seconds(args.duration)?,
+        }),
+        (None, None) => unreachable!("clap requires a recording or --rate"),
+    };
+
+    if schedule.iter().all(Vec::is_empty) {
+        return Err(ValidationError {
+            message: "Nothing to replay".to_string(),
+        }
+        .into());
+    }
+
+    let options = replay::ReplayOptions {
+        remote: remote.map(str::to_string),
+        encoding: args.encoding,
+        max_in_flight: args.pipeline,
+    };
+    let report = replay::run(schedule, &options)?;
+    Ok(output::format_replay_report(&report))
+}
+
 struct IviCli {
     client: IviClient,
 }
@@ -558,11 +713,158 @@ impl IviCli {
         self.client.commit()?;
         Ok(output::format_commit_success())
     }
+
+    /// Handle stats command
+    fn handle_stats(&mut self, prometheus: bool) -> Result<String> {
+        if prometheus {
+            return self.client.get_metrics_prometheus();
+        }
+        let metrics = self.client.get_metrics()?;
+        Ok(output::format_metrics(&metrics))
+    }
+    /// Run one command on this connection
+    fn run(&mut self, command: Commands) -> Result<String> {
+        match command {
+            Commands::Surface { command } => match command {
+                SurfaceCommands::List { ids_only } => self.handle_surface_list(ids_only),
+                SurfaceCommands::GetProps { id } => self.handle_surface_get_properties(id),
+                SurfaceCommands::SetVisibility { id, visible } => {
+                    self.handle_surface_set_visibility(id, visible)
+                }
+                SurfaceCommands::SetOpacity { id, opacity } => {
+                    self.handle_surface_set_opacity(id, opacity)
+                }
+                SurfaceCommands::SetSrcRect {
+                    id,
+                    x,
+                    y,
+                    width,
+                    height,
+                } => self.handle_surface_set_source_rect(id, x, y, width, height),
+                SurfaceCommands::SetDestRect {
+                    id,
+                    x,
+                    y,
+                    width,
+                    height,
+                } => self.handle_surface_set_dest_rect(id, x, y, width, height),
+                SurfaceCommands::SetZOrder { id, z_order } => {
+                    self.handle_surface_set_z_order(id, z_order)
+                }
+                SurfaceCommands::SetFocus { id } => self.handle_surface_set_focus(id),
+            },
+            Commands::Layer { command } => match command {
+                LayerCommands::List { ids_only } => self.handle_layer_list(ids_only),
+                LayerCommands::GetProps { id } => self.handle_layer_get_properties(id),
+                LayerCommands::Create { id, width, height } => {
+                    self.handle_layer_create_layer(id, width, height)
+                }
+                LayerCommands::Destroy { id } => self.handle_layer_destroy(id),
+                LayerCommands::SetSrcRect {
+                    id,
+                    x,
+                    y,
+                    width,
+                    height,
+                } => self.handle_layer_set_source_rect(id, x, y, width, height),
+                LayerCommands::SetDestRect {
+                    id,
+                    x,
+                    y,
+                    width,
+                    height,
+                } => self.handle_layer_set_dest_rect(id, x, y, width, height),
+                LayerCommands::SetVisibility { id, visible } => {
+                    self.handle_layer_set_visibility(id, visible)
+                }
+                LayerCommands::SetOpacity { id, opacity } => {
+                    self.handle_layer_set_opacity(id, opacity)
+                }
+                LayerCommands::SetSurfaces {
+                    layer_id,
+                    surface_ids,
+                } => self.handle_layer_set_surfaces(layer_id, &surface_ids),
+                LayerCommands::AddSurface {
+                    layer_id,
+                    surface_id,
+                } => self.handle_layer_add_surface(layer_id, surface_id),
+                LayerCommands::RemoveSurface {
+                    layer_id,
+                    surface_id,
+                } => self.handle_layer_remove_surface(layer_id, surface_id),
+                LayerCommands::GetSurfaces { layer_id } => self.handle_layer_get_surfaces(layer_id),
+            },
+            Commands::Screen { command } => match command {
+                ScreenCommands::List => self.handle_screen_list(),
+                ScreenCommands::GetProps { name } => self.handle_screen_get_properties(&name),
+                ScreenCommands::GetLayers { name } => self.handle_screen_get_layers(&name),
+                ScreenCommands::GetScreensForLayer { layer_id } => {
+                    self.handle_screen_get_screens_for_layer(layer_id)
+                }
+                ScreenCommands::SetLayers { name, layer_ids } => {
+                    self.handle_screen_set_layers(&name, &layer_ids)
+                }
+                ScreenCommands::RemoveLayer { name, layer_id } => {
+                    self.handle_screen_remove_layer(&name, layer_id)
+                }
+            },
+            Commands::Scene => self.handle_scene(),
+            Commands::Commit => self.handle_commit(),
+            Commands::Stats { prometheus } => self.handle_stats(prometheus),
+            Commands::Replay(_) | Commands::Shell { .. } => Err(ValidationError {
+                message: "replay and shell cannot run inside the shell".to_string(),
+            }
+            .into()),
+        }
+    }
+
+    /// Run the commands read from stdin until it ends or `exit` is read
+    ///
+    /// Interactively each failure is reported and the shell carries on; in
+    /// batch mode the first failure ends it.
+    fn run_shell(&mut self, batch: bool) -> Result<String> {
+        let stdin = std::io::stdin();
+        let prompt = !batch && stdin.is_terminal();
+
+        let mut lines = stdin.lock().lines().enumerate();
+        loop {
+            if prompt {
+                print!("ivi> ");
+                std::io::stdout().flush()?;
+            }
+            let Some((index, line)) = lines.next() else {
+                break;
+            };
+            let line = line?;
+            let line = line.trim();
+            if line.is_empty() || line.starts_with('#') {
+                continue;
+            }
+            if line == "exit" || line == "quit" {
+                break;
+            }
+
+            let result = parse_shell_line(line)
+                .map_err(|e| e.to_string().trim_end().to_string())
+                .and_then(|command| self.run(command).map_err(|e| output::format_error(&e)));
+            match result {
+                Ok(output) => println!("{}", output),
+                Err(message) => {
+                    eprintln!("{}", message);
+                    if batch {
+                        eprintln!("Stopped at line {}: {}", index + 1, line);
+                        std::process::exit(1);
+                    }
+                }
+            }
+        }
+
+        Ok(String::new())
+    }
 }
 
 fn main() -> Result<()> {
     let cli = Cli::parse();
-    let mut ivi_cli = IviCli::new(None)?;
 
     if cli.log {
         let log_level = match cli.verbose {
@@ -581,94 +883,17 @@ fn main() -> Result<()> {
 
     jinfo!("Starting IVI CLI");
 
+    let remote = cli.socket.as_deref();
     match cli.command {
-        Commands::Surface { command } => match command {
-            SurfaceCommands::List { ids_only } => ivi_cli.handle_surface_list(ids_only),
-            SurfaceCommands::GetProps { id } => ivi_cli.handle_surface_get_properties(id),
-            SurfaceCommands::SetVisibility { id, visible } => {
-                ivi_cli.handle_surface_set_visibility(id, visible)
-            }
-            SurfaceCommands::SetOpacity { id, opacity } => {
-                ivi_cli.handle_surface_set_opacity(id, opacity)
-            }
-            SurfaceCommands::SetSrcRect {
-                id,
-                x,
-                y,
-                width,
-                height,
-            } => ivi_cli.handle_surface_set_source_rect(id, x, y, width, height),
-            SurfaceCommands::SetDestRect {
-                id,
-                x,
-                y,
-                width,
-                height,
-            } => ivi_cli.handle_surface_set_dest_rect(id, x, y, width, height),
-            SurfaceCommands::SetZOrder { id, z_order } => {
-                ivi_cli.handle_surface_set_z_order(id, z_order)
-            }
-            SurfaceCommands::SetFocus { id } => ivi_cli.handle_surface_set_focus(id),
-        },
-        Commands::Layer { command } => match command {
-            LayerCommands::List { ids_only } => ivi_cli.handle_layer_list(ids_only),
-            LayerCommands::GetProps { id } => ivi_cli.handle_layer_get_properties(id),
-            LayerCommands::Create { id, width, height } => {
-                ivi_cli.handle_layer_create_layer(id, width, height)
-            }
-            LayerCommands::Destroy { id } => ivi_cli.handle_layer_destroy(id),
-            LayerCommands::SetSrcRect {
-                id,
-                x,
-                y,
-                width,
-                height,
-            } => ivi_cli.handle_layer_set_source_rect(id, x, y, width, height),
-            LayerCommands::SetDestRect {
-                id,
-                x,
-                y,
-                width,
-                height,
-            } => ivi_cli.handle_layer_set_dest_rect(id, x, y, width, height),
-            LayerCommands::SetVisibility { id, visible } => {
-                ivi_cli.handle_layer_set_visibility(id, visible)
-            }
-            LayerCommands::SetOpacity { id, opacity } => {
-                ivi_cli.handle_layer_set_opacity(id, opacity)
-            }
-            LayerCommands::SetSurfaces {
-                layer_id,
-                surface_ids,
-            } => ivi_cli.handle_layer_set_surfaces(layer_id, &surface_ids),
-            LayerCommands::AddSurface {
-                layer_id,
-                surface_id,
-            } => ivi_cli.handle_layer_add_surface(layer_id, surface_id),
-            LayerCommands::RemoveSurface {
-                layer_id,
-                surface_id,
-            } => ivi_cli.handle_layer_remove_surface(layer_id, surface_id),
-            LayerCommands::GetSurfaces { layer_id } => ivi_cli.handle_layer_get_surfaces(layer_id),
-        },
-        Commands::Screen { command } => match command {
-            ScreenCommands::List => ivi_cli.handle_screen_list(),
-            ScreenCommands::GetProps { name } => ivi_cli.handle_screen_get_properties(&name),
-            ScreenCommands::GetLayers { name } => ivi_cli.handle_screen_get_layers(&name),
-            ScreenCommands::GetScreensForLayer { layer_id } => {
-                ivi_cli.handle_screen_get_screens_for_layer(layer_id)
-            }
-            ScreenCommands::SetLayers { name, layer_ids } => {
-                ivi_cli.handle_screen_set_layers(&name, &layer_ids)
-            }
-            ScreenCommands::RemoveLayer { name, layer_id } => {
-                ivi_cli.handle_screen_remove_layer(&name, layer_id)
-            }
-        },
-        Commands::Scene => ivi_cli.handle_scene(),
-        Commands::Commit => ivi_cli.handle_commit(),
+        Commands::Replay(args) => handle_replay(args, remote),
+        Commands::Shell { batch } => IviCli::new(remote)?.run_shell(batch),
+        command => IviCli::new(remote)?.run(command),
     }
-    .map(|r| println!("{}", r))
+    .map(|r| {
+        if !r.is_empty() {
+            println!("{}", r)
+        }
+    })
     .map_err(|e| {
         eprintln!("{}", output::format_error(&e));
 
@@ -688,6 +913,24 @@ mod tests {
         assert!(validate_opacity(1.0).is_ok());
     }
 
+    #[test]
+    fn test_parse_shell_line() {
+        assert_eq!(
+            split_shell_words(r#"screen get-props "HDMI A" 'x y'"#).unwrap(),
+            vec!["screen", "get-props", "HDMI A", "x y"]
+        );
+        assert!(split_shell_words("screen get-props \"HDMI").is_err());
+
+        assert!(matches!(
+            parse_shell_line("surface set-opacity 1000 0.5"),
+            Ok(Commands::Surface {
+                command: SurfaceCommands::SetOpacity { id: 1000, .. }
+            })
+        ));
+        assert!(matches!(parse_shell_line("commit"), Ok(Commands::Commit)));
+        assert!(parse_shell_line("surface set-opacity x").is_err());
+    }
+
     #[test]
     fn test_validate_opacity_invalid() {
         assert!(validate_opacity(-0.1).is_err());
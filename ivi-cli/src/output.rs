@@ -4,7 +4,8 @@
 //!
 //! This module provides functions to format CLI output in a consistent,
 //! human-readable manner.
-use ivi_client::{IviLayer, IviScreen, IviSurface};
+use crate::replay::ReplayReport;
+use ivi_client::{IviLayer, IviScreen, IviSurface, LatencyStats, ServerMetrics};
 
 /// Format a list of surfaces
 ///
@@ -1066,6 +1067,115 @@ pub fn format_hierarchical_scene(hierarchy: &HierarchicalScene) -> String {
     output
 }
 
+/// Format one latency row: count, errors and percentiles in microseconds
+fn format_latency_row(name: &str, stats: &LatencyStats) -> String {
+    format!(
+        "  {:<32} {:>8} {:>6} {:>8} {:>8} {:>8} {:>8}\n",
+        name, stats.count, stats.errors, stats.p50_us, stats.p90_us, stats.p99_us, stats.max_us
+    )
+}
+
+/// Format controller metrics as latency tables followed by counters
+///
+/// # Arguments
+/// * `metrics` - Metrics returned by `get_metrics`
+///
+/// # Returns
+/// A formatted string; latencies are in microseconds
+pub fn format_metrics(metrics: &ServerMetrics) -> String {
+    let header = format!(
+        "  {:<32} {:>8} {:>6} {:>8} {:>8} {:>8} {:>8}\n",
+        "", "count", "errors", "p50", "p90", "p99", "max"
+    );
+    let mut output = String::new();
+
+    output.push_str("RPC latency (us):\n");
+    output.push_str(&header);
+    for (method, stats) in metrics.rpc.iter() {
+        output.push_str(&format_latency_row(method, stats));
+    }
+    output.push_str(&format_latency_row("(all messages)", &metrics.messages));
+    output.push_str(&format!(
+        "  Invalid requests: {}\n",
+        metrics.invalid_requests
+    ));
+
+    output.push_str("Callback latency (us):\n");
+    if metrics.callbacks.is_empty() {
+        output.push_str("  No callbacks recorded\n");
+    } else {
+        output.push_str(&header);
+        for (callback, stats) in metrics.callbacks.iter() {
+            output.push_str(&format_latency_row(callback, stats));
+        }
+    }
+
+    let transport = &metrics.transport;
+    output.push_str("Transport:\n");
+    output.push_str(&format!(
+        "  Frames received: {} ({} bytes)\n",
+        transport.frames_received, transport.bytes_received
+    ));
+    output.push_str(&format!("  Frames dropped: {}\n", transport.frames_dropped));
+    output.push_str(&format!(
+        "  Slow clients disconnected: {}\n",
+        transport.slow_client_disconnects
+    ));
+
+    let notifications = &metrics.notifications;
+    output.push_str("Notifications:\n");
+    output.push_str(&format!(
+        "  Queued: {}, dropped: {}, coalesced: {}\n",
+        notifications.queued, notifications.dropped, notifications.coalesced
+    ));
+    for queue in notifications.queues.iter() {
+        output.push_str(&format!(
+            "  Client {}: depth {}, dropped {}\n",
+            queue.client_id, queue.depth, queue.dropped
+        ));
+    }
+
+    output
+}
+
+/// Format the outcome of a replay
+///
+/// # Arguments
+/// * `report` - Counts and latencies collected by the replay
+///
+/// # Returns
+/// A formatted string; latencies are in microseconds
+pub fn format_replay_report(report: &ReplayReport) -> String {
+    let micros = |q: f64| report.percentile(q).as_micros();
+    let mut output = String::new();
+
+    output.push_str(&format!(
+        "Replayed {} requests over {} connections in {:.3} s\n",
+        report.sent,
+        report.connections,
+        report.elapsed.as_secs_f64()
+    ));
+    output.push_str(&format!(
+        "  Answered: {} ({} errors), unanswered: {}\n",
+        report.latencies.len(),
+        report.errors,
+        report.unanswered
+    ));
+    output.push_str(&format!(
+        "  Throughput: {:.1} requests/s\n",
+        report.throughput()
+    ));
+    output.push_str(&format!(
+        "  Latency (us): p50 {}, p99 {}, p999 {}, max {}",
+        micros(0.5),
+        micros(0.99),
+        micros(0.999),
+        micros(1.0)
+    ));
+
+    output
+}
+
 #[cfg(test)]
 mod message_tests {
     use super::*;
@@ -1216,3 +1326,104 @@ mod message_tests {
         assert_eq!(format_commit_success(), "✓ Changes committed");
     }
 }
+
+#[cfg(test)]
+mod metrics_tests {
+    use super::*;
+    use ivi_client::{ClientQueueStats, NotificationStats, TransportStats};
+    use std::collections::BTreeMap;
+
+    fn latency(count: u64, errors: u64, p50_us: u64) -> LatencyStats {
+        LatencyStats {
+            count,
+            sum_us: count * p50_us,
+            max_us: p50_us * 4,
+            p50_us,
+            p90_us: p50_us * 2,
+            p99_us: p50_us * 4,
+            buckets: Vec::new(),
+            errors,
+        }
+    }
+
+    #[test]
+    fn test_format_metrics() {
+        let mut rpc = BTreeMap::new();
+        rpc.insert("list_surfaces".to_string(), latency(12, 0, 50));
+        rpc.insert("set_surface_opacity".to_string(), latency(3, 1, 100));
+
+        let metrics = ServerMetrics {
+            rpc,
+            invalid_requests: 2,
+            messages: latency(15, 0, 100),
+            callbacks: BTreeMap::new(),
+            transport: TransportStats {
+                frames_received: 17,
+                bytes_received: 2048,
+                frames_dropped: 0,
+                slow_client_disconnects: 1,
+            },
+            notifications: NotificationStats {
+                queued: 40,
+                dropped: 5,
+                coalesced: 7,
+                queues: vec![ClientQueueStats {
+                    client_id: "client-1".to_string(),
+                    depth: 3,
+                    dropped: 5,
+                }],
+            },
+        };
+
+        let output = format_metrics(&metrics);
+        let lines: Vec<&str> = output.lines().collect();
+        assert_eq!(lines[0], "RPC latency (us):");
+        // Methods are listed by name
+        assert!(lines[2].trim_start().starts_with("list_surfaces"));
+        assert!(lines[3].split_whitespace().eq([
+            "set_surface_opacity",
+            "3",
+            "1",
+            "100",
+            "200",
+            "400",
+            "400"
+        ]));
+        assert!(output.contains("  Invalid requests: 2\n"));
+        assert!(output.contains("  No callbacks recorded\n"));
+        assert!(output.contains("  Frames received: 17 (2048 bytes)\n"));
+        assert!(output.contains("  Slow clients disconnected: 1\n"));
+        assert!(output.contains("  Queued: 40, dropped: 5, coalesced: 7\n"));
+        assert!(output.contains("  Client client-1: depth 3, dropped 5\n"));
+    }
+}
+
+#[cfg(test)]
+mod replay_tests {
+    use super::*;
+    use std::time::Duration;
+
+    #[test]
+    fn test_format_replay_report() {
+        let report = ReplayReport {
+            connections: 2,
+            sent: 4,
+            errors: 1,
+            unanswered: 1,
+            elapsed: Duration::from_millis(1500),
+            latencies: [100, 200, 300].map(Duration::from_micros).to_vec(),
+        };
+
+        let output = format_replay_report(&report);
+        let lines: Vec<&str> = output.lines().collect();
+        assert_eq!(
+            lines,
+            vec![
+                "Replayed 4 requests over 2 connections in 1.500 s",
+                "  Answered: 3 (1 errors), unanswered: 1",
+                "  Throughput: 2.0 requests/s",
+                "  Latency (us): p50 200, p99 300, p999 300, max 300",
+            ]
+        );
+    }
+}
@@ -0,0 +1,364 @@
+//! Load generation: replay of recorded sessions and synthetic profiles
+//!
+//! Every connection runs on its own thread and keeps up to a fixed number of
+//! requests in flight, sending each one at its scheduled time. Latency is
+//! measured from when a request is written to when its response is read.
+
+use ivi_client::{Encoding, IviClient, IviError, RecordKind, RecordReader, Result};
+#[allow(unused_imports)]
+use jlogger_tracing::{jdebug, jerror, jinfo, jwarn};
+use serde_json::{json, Value};
+use std::collections::HashMap;
+use std::path::Path;
+use std::sync::{Arc, Mutex};
+use std::thread;
+use std::time::{Duration, Instant};
+
+/// How long to wait for the last responses once everything is sent
+const DRAIN_TIMEOUT: Duration = Duration::from_secs(10);
+
+/// A request sent at a fixed offset from the start of the run
+#[derive(Debug, Clone, PartialEq)]
+pub struct ScheduledRequest {
+    pub at: Duration,
+    pub method: String,
+    pub params: Value,
+}
+
+/// Requests of each connection, in the order they are sent
+pub type Schedule = Vec<Vec<ScheduledRequest>>;
+
+/// Synthetic load: `clients` connections updating `surfaces` surfaces
+#[derive(Debug, Clone, Copy)]
+pub struct SyntheticProfile {
+    pub clients: usize,
+    /// ID of the first surface; the others follow it
+    pub first_surface: u32,
+    pub surfaces: u32,
+    /// Updates per second across all clients
+    pub rate: f64,
+    pub duration: Duration,
+}
+
+/// Settings shared by every connection of a run
+#[derive(Debug, Clone)]
+pub struct ReplayOptions {
+    pub remote: Option<String>,
+    pub encoding: Encoding,
+    /// Most requests in flight on one connection
+    pub max_in_flight: usize,
+}
+
+/// Outcome of a run
+#[derive(Debug, Default)]
+pub struct ReplayReport {
+    pub connections: usize,
+    pub sent: usize,
+    /// Responses that carried an error
+    pub errors: usize,
+    /// Requests still unanswered when the run gave up waiting
+    pub unanswered: usize,
+    pub elapsed: Duration,
+    /// Latency of every answered request, sorted
+    pub latencies: Vec<Duration>,
+}
+
+impl ReplayReport {
+    /// Answered requests per second
+    pub fn throughput(&self) -> f64 {
+        let secs = self.elapsed.as_secs_f64();
+        if secs > 0.0 {
+            self.latencies.len() as f64 / secs
+        } else {
+            0.0
+        }
+    }
+
+    /// Latency at quantile `q` (0.0 to 1.0), by nearest rank
+    pub fn percentile(&self, q: f64) -> Duration {
+        if self.latencies.is_empty() {
+            return Duration::ZERO;
+        }
+        let rank = (q * self.latencies.len() as f64).ceil() as usize;
+        self.latencies[rank.clamp(1, self.latencies.len()) - 1]
+    }
+}
+
+/// Build one schedule per connection from a recording
+///
+/// Only requests are replayed, except handshakes, since each connection
+/// negotiates its own encoding. Recorded clients map to connections
+/// round-robin in the order they first appear; without `connections` each
+/// client gets its own. Times are divided by `speed`, and a speed of 0 sends
+/// everything as fast as the in-flight limit allows.
+pub fn load_recording(path: &Path, connections: Option<usize>, speed: f64) -> Result<Schedule> {
+    let invalid = |e: String| IviError::DeserializationError(format!("{}: {}", path.display(), e));
+
+    let mut per_client: Vec<Vec<ScheduledRequest>> = Vec::new();
+    let mut clients: HashMap<u64, usize> = HashMap::new();
+    let mut first: Option<Duration> = None;
+
+    for frame in RecordReader::open(path).map_err(|e| invalid(e.to_string()))? {
+        let frame = frame.map_err(|e| invalid(e.to_string()))?;
+        if frame.kind != RecordKind::Request {
+            continue;
+        }
+
+        let start = *first.get_or_insert(frame.timestamp);
+        let offset = frame.timestamp.saturating_sub(start);
+        let at = if speed > 0.0 {
+            offset.div_f64(speed)
+        } else {
+            Duration::ZERO
+        };
+
+        let requests = match frame.requests() {
+            Ok(requests) => requests,
+            Err(e) => {
+                jwarn!("Skipping undecodable recorded request: {}", e.message);
+                continue;
+            }
+        };
+        let index = *clients.entry(frame.client).or_insert_with(|| {
+            per_client.push(Vec::new());
+            per_client.len() - 1
+        });
+        per_client[index].extend(
+            requests
+                .into_iter()
+                .filter(|request| request.method != "handshake")
+                .map(|request| ScheduledRequest {
+                    at,
+                    method: request.method,
+                    params: request.params,
+                }),
+        );
+    }
+
+    let Some(connections) = connections else {
+        return Ok(per_client);
+    };
+    let mut schedule: Schedule = vec![Vec::new(); connections.clamp(1, per_client.len().max(1))];
+    let count = schedule.len();
+    for (index, requests) in per_client.into_iter().enumerate() {
+        schedule[index % count].extend(requests);
+    }
+    for requests in &mut schedule {
+        requests.sort_by_key(|request| request.at);
+    }
+    Ok(schedule)
+}
+
+/// Build one schedule per client of a synthetic profile
+///
+/// Each client sends its share of the rate as `set_surface_opacity` requests
+/// with `auto_commit`, cycling through the surfaces. Clients are staggered so
+/// their updates interleave evenly.
+pub fn synthetic_schedule(profile: &SyntheticProfile) -> Schedule {
+    let clients = profile.clients.max(1);
+    let surfaces = profile.surfaces.max(1);
+    if profile.rate <= 0.0 {
+        return vec![Vec::new(); clients];
+    }
+
+    let interval = Duration::from_secs_f64(clients as f64 / profile.rate);
+    let stagger = Duration::from_secs_f64(1.0 / profile.rate);
+    let updates = (profile.duration.as_secs_f64() * profile.rate / clients as f64) as usize;
+
+    (0..clients)
+        .map(|client| {
+            (0..updates)
+                .map(|update| {
+                    let n = client + update * clients;
+                    let id = profile.first_surface + (n as u32 % surfaces);
+                    // Alternate between two values so every update changes the scene
+                    let opacity = if (n as u32 / surfaces).is_multiple_of(2) {
+                        1.0
+                    } else {
+                        0.5
+                    };
+                    ScheduledRequest {
+                        at: stagger * client as u32 + interval * update as u32,
+                        method: "set_surface_opacity".to_string(),
+                        params: json!({ "id": id, "opacity": opacity, "auto_commit": true }),
+                    }
+                })
+                .collect()
+        })
+        .collect()
+}
+
+/// Latencies and error count of one connection, filled in by the callbacks
+#[derive(Default)]
+struct Samples {
+    latencies: Vec<Duration>,
+    errors: usize,
+}
+
+/// Send every schedule over its own connection and collect the latencies
+pub fn run(schedule: Schedule, options: &ReplayOptions) -> Result<ReplayReport> {
+    // Connect before starting the clock, so setup is not measured
+    let mut clients = Vec::with_capacity(schedule.len());
+    for _ in 0..schedule.len() {
+        let mut client = IviClient::new(options.remote.as_deref())?;
+        if options.encoding != Encoding::Json {
+            client.set_encoding(options.encoding)?;
+        }
+        clients.push(client);
+    }
+
+    let start = Instant::now();
+    let workers: Vec<_> = clients
+        .into_iter()
+        .zip(schedule)
+        .map(|(client, requests)| {
+            let max_in_flight = options.max_in_flight.max(1);
+            thread::spawn(move || drive(client, requests, start, max_in_flight))
+        })
+        .collect();
+
+    let mut report = ReplayReport {
+        connections: workers.len(),
+        ..Default::default()
+    };
+    for worker in workers {
+        let (sent, unanswered, samples) = worker
+            .join()
+            .map_err(|_| IviError::ConnectionFailed("Replay connection panicked".to_string()))??;
+        report.sent += sent;
+        report.unanswered += unanswered;
+        report.errors += samples.errors;
+        report.latencies.extend(samples.latencies);
+    }
+    report.elapsed = start.elapsed();
+    report.latencies.sort_unstable();
+
+    Ok(report)
+}
+
+/// Run the requests of one connection; returns the number sent, the number
+/// left unanswered and the samples
+fn drive(
+    mut client: IviClient,
+    requests: Vec<ScheduledRequest>,
+    start: Instant,
+    max_in_flight: usize,
+) -> Result<(usize, usize, Samples)> {
+    let samples = Arc::new(Mutex::new(Samples::default()));
+    let sent = requests.len();
+
+    for request in requests {
+        let due = start + request.at;
+        loop {
+            let now = Instant::now();
+            if client.pending_count() >= max_in_flight {
+                wait_readable(&client, None);
+            } else if due > now + Duration::from_millis(1) {
+                wait_readable(&client, Some(due - now));
+            } else {
+                break;
+            }
+            client.poll()?;
+        }
+
+        let samples = Arc::clone(&samples);
+        let sent_at = Instant::now();
+        client.submit_with(&request.method, request.params, move |_, result| {
+            let mut samples = samples.lock().unwrap();
+            samples.latencies.push(sent_at.elapsed());
+            if result.is_err() {
+                samples.errors += 1;
+            }
+        })?;
+    }
+
+    let deadline = Instant::now() + DRAIN_TIMEOUT;
+    while client.pending_count() > 0 {
+        let now = Instant::now();
+        if now >= deadline {
+            jwarn!(
+                "Giving up on {} unanswered requests",
+                client.pending_count()
+            );
+            break;
+        }
+        wait_readable(&client, Some(deadline - now));
+        client.poll()?;
+    }
+
+    let unanswered = client.pending_count();
+    // Drop the client first, so the callbacks holding the samples are gone
+    drop(client);
+    let samples = Arc::try_unwrap(samples)
+        .map(|samples| samples.into_inner().unwrap())
+        .unwrap_or_default();
+    Ok((sent, unanswered, samples))
+}
+
+/// Block until the connection is readable or `timeout` has passed
+///
+/// Without a pollable descriptor this sleeps for at most a millisecond.
+fn wait_readable(client: &IviClient, timeout: Option<Duration>) {
+    let Some(fd) = client.raw_fd() else {
+        thread::sleep(timeout.map_or(Duration::from_millis(1), |t| {
+            t.min(Duration::from_millis(1))
+        }));
+        return;
+    };
+
+    let timeout_ms = timeout.map_or(-1, |t| t.as_millis().min(i32::MAX as u128) as i32);
+    let mut pollfd = libc::pollfd {
+        fd,
+        events: libc::POLLIN,
+        revents: 0,
+    };
+    // Safety: pollfd is a valid, initialized descriptor set of length 1
+    unsafe {
+        libc::poll(&mut pollfd, 1, timeout_ms);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_synthetic_schedule_spreads_the_rate() {
+        let schedule = synthetic_schedule(&SyntheticProfile {
+            clients: 2,
+            first_surface: 1000,
+            surfaces: 3,
+            rate: 100.0,
+            duration: Duration::from_millis(100),
+        });
+
+        // 10 updates in 100 ms, 5 per client, 20 ms apart, clients 10 ms apart
+        assert_eq!(schedule.len(), 2);
+        assert!(schedule.iter().all(|requests| requests.len() == 5));
+        assert_eq!(schedule[0][1].at, Duration::from_millis(20));
+        assert_eq!(schedule[1][0].at, Duration::from_millis(10));
+
+        let ids: Vec<u64> = schedule[0]
+            .iter()
+            .map(|request| request.params["id"].as_u64().unwrap())
+            .collect();
+        assert_eq!(ids, vec![1000, 1002, 1001, 1000, 1002]);
+        assert_eq!(schedule[0][0].params["opacity"], 1.0);
+        assert_eq!(schedule[0][2].params["opacity"], 0.5);
+    }
+
+    #[test]
+    fn test_report_percentiles() {
+        let report = ReplayReport {
+            latencies: (1..=1000).map(Duration::from_micros).collect(),
+            elapsed: Duration::from_secs(2),
+            ..Default::default()
+        };
+        assert_eq!(report.percentile(0.5), Duration::from_micros(500));
+        assert_eq!(report.percentile(0.99), Duration::from_micros(990));
+        assert_eq!(report.percentile(0.999), Duration::from_micros(999));
+        assert_eq!(report.percentile(1.0), Duration::from_micros(1000));
+        assert_eq!(report.throughput(), 500.0);
+        assert_eq!(ReplayReport::default().percentile(0.5), Duration::ZERO);
+    }
+}
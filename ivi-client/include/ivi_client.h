@@ -10,6 +10,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+/*
+ Size of the name buffer of an `IviScreenInfo`, including the terminating NUL
+ */
+#define IVI_SCREEN_NAME_LEN 64
+
 /*
  C-compatible error codes
  */
@@ -44,6 +49,20 @@ typedef enum IviErrorCode {
     INVALID_PARAM = -6,
 } IviErrorCode;
 
+/*
+ C-compatible wire encoding enum
+ */
+typedef enum IviEncoding {
+    /*
+     JSON text (default)
+     */
+    JSON = 0,
+    /*
+     MessagePack binary
+     */
+    MESSAGE_PACK = 1,
+} IviEncoding;
+
 /*
  Event type enum for C consumers.
  */
@@ -63,6 +82,7 @@ typedef enum IviEventType {
     LAYER_OPACITY_CHANGED = 12,
     SURFACE_CONTENT_READY = 13,
     SURFACE_CONTENT_SIZE_CHANGED = 14,
+    ANIMATION_COMPLETED = 15,
 } IviEventType;
 
 /*
@@ -87,8 +107,52 @@ typedef enum IviOrientation {
     FLIPPED270 = 7,
 } IviOrientation;
 
+/*
+ C-compatible easing curve of an animation
+ */
+typedef enum IviEasing {
+    LINEAR = 0,
+    EASE_IN = 1,
+    EASE_OUT = 2,
+    EASE_IN_OUT = 3,
+} IviEasing;
+
+/*
+ Builder for a batch of surface and layer changes.
+
+ Create one with [`IviClient::batch`](crate::IviClient::batch), queue
+ changes, then send everything with
+ [`IviClient::submit_batch`](crate::IviClient::submit_batch).
+
+ # Example
+
+ ```no_run
+ use ivi_client::IviClient;
+
+ # fn main() -> ivi_client::Result<()> {
+ let mut client = IviClient::new(Some("/tmp/weston-ivi-controller.sock"))?;
+
+ let mut batch = client.batch();
+ batch
+     .set_surface_destination_rectangle(1000, 0, 0, 1920, 1080)
+     .set_surface_visibility(1000, true)
+     .set_surface_opacity(1001, 0.5);
+
+ // One frame out, one frame back, one commit
+ client.submit_batch(batch)?;
+ # Ok(())
+ # }
+ ```
+ */
+typedef struct IviBatch IviBatch;
+
 typedef struct IviClient IviClient;
 
+/*
+ Memory-mapped, read-only view of the controller's scene
+ */
+typedef struct IviSceneMap IviSceneMap;
+
 /*
  Listens for event notifications from the IVI controller.
 
@@ -162,6 +226,38 @@ typedef struct IviLayer {
     enum IviOrientation orientation;
 } IviLayer;
 
+/*
+ C-compatible screen structure with an inline name
+
+ Filled in by `ivi_list_screens_into`. Longer names are truncated to
+ `IVI_SCREEN_NAME_LEN - 1` bytes.
+ */
+typedef struct IviScreenInfo {
+    char name[IVI_SCREEN_NAME_LEN];
+    int32_t width;
+    int32_t height;
+    double x;
+    double y;
+    enum IviOrientation transform;
+    bool enabled;
+    int32_t scale;
+} IviScreenInfo;
+
+/*
+ C-compatible animation of a surface or layer
+
+ Only the properties whose `has_*` flag is set are animated, from their
+ current values to the given ones.
+ */
+typedef struct IviAnimation {
+    bool has_destination;
+    struct Rectangle destination;
+    bool has_opacity;
+    float opacity;
+    uint32_t duration_ms;
+    enum IviEasing easing;
+} IviAnimation;
+
 /*
  Visibility change data (old and new state).
  */
@@ -220,6 +316,15 @@ typedef struct IviContentSizeChange {
     int32_t new_height;
 } IviContentSizeChange;
 
+/*
+ Animation completed data: the animation ID and whether it was cancelled
+ before reaching its target values.
+ */
+typedef struct IviAnimationCompletedInfo {
+    uint64_t animation_id;
+    bool cancelled;
+} IviAnimationCompletedInfo;
+
 /*
  A notification event delivered to C callbacks.
 
@@ -251,6 +356,7 @@ typedef struct IviNotification {
     struct IviOrientationChange orientation;
     struct IviContentReadyInfo content_ready;
     struct IviContentSizeChange content_size;
+    struct IviAnimationCompletedInfo animation;
 } IviNotification;
 
 /*
@@ -258,6 +364,18 @@ typedef struct IviNotification {
  */
 typedef void (*IviNotificationCCallback)(const struct IviNotification *notif, void *user_data);
 
+/*
+ C callback type for the result of a request sent with `ivi_client_submit`.
+
+ On success `status` is `Ok` and `result_json` is the JSON-encoded result.
+ On failure `result_json` holds the error message. The string is only
+ valid for the duration of the call.
+ */
+typedef void (*IviResponseCallback)(uint64_t request_id,
+                                    enum IviErrorCode status,
+                                    const char *result_json,
+                                    void *user_data);
+
 /*
  Connect to the IVI controller
 
@@ -283,6 +401,49 @@ struct IviClient *ivi_client_connect(const char *remote, char *error_buf, uintpt
  */
 void ivi_client_disconnect(struct IviClient *client);
 
+/*
+ Switch the connection to another wire encoding
+
+ MessagePack is cheaper to produce and parse than JSON. It must be called
+ while no requests submitted with `ivi_client_submit` are outstanding.
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+ */
+enum IviErrorCode ivi_client_set_encoding(struct IviClient *client,
+                                          enum IviEncoding encoding,
+                                          char *error_buf,
+                                          uintptr_t error_buf_len);
+
+/*
+ Keep a local copy of the scene to answer `ivi_get_surface` and
+ `ivi_get_layer` without a round trip
+
+ The cache follows the scene through notifications on a second
+ connection and resynchronizes when notifications were lost. Layer
+ rectangles, layer orientation and layer membership changed by other
+ clients are only picked up on the next resynchronization.
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+ */
+enum IviErrorCode ivi_client_enable_cache(struct IviClient *client,
+                                          char *error_buf,
+                                          uintptr_t error_buf_len);
+
+/*
+ Drop the scene cache enabled with `ivi_client_enable_cache`
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`, or NULL
+ */
+void ivi_client_disable_cache(struct IviClient *client);
+
 /*
  List all surfaces
 
@@ -305,6 +466,33 @@ enum IviErrorCode ivi_list_surfaces(struct IviClient *client,
                                     char *error_buf,
                                     uintptr_t error_buf_len);
 
+/*
+ List all surfaces into a caller-provided array
+
+ Writes up to `cap` surfaces to `buf` and the total number of surfaces to
+ `needed`. If `*needed` is larger than `cap` the list was cut short; call
+ again with a buffer of at least `*needed` entries. `buf` may be NULL if
+ `cap` is 0, to only query the count.
+
+ The response is decoded straight into `buf`. Once the connection's
+ buffers have grown to fit the response, a successful call makes no heap
+ allocation, so it can be used from a render loop. This holds for the JSON
+ encoding; other encodings decode through an intermediate copy.
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+ - `buf` must point to at least `cap` writable `IviSurface` entries, or be NULL if `cap` is 0
+ - `needed` must be a valid pointer
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+ */
+enum IviErrorCode ivi_list_surfaces_into(struct IviClient *client,
+                                         struct IviSurface *buf,
+                                         uintptr_t cap,
+                                         uintptr_t *needed,
+                                         char *error_buf,
+                                         uintptr_t error_buf_len);
+
 /*
  Get properties of a specific surface
 
@@ -436,6 +624,47 @@ enum IviErrorCode ivi_list_layers(struct IviClient *client,
                                   char *error_buf,
                                   uintptr_t error_buf_len);
 
+/*
+ List all layers into a caller-provided array
+
+ Works like `ivi_list_surfaces_into`: writes up to `cap` layers, stores the
+ total number in `needed` and makes no heap allocation on success.
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+ - `buf` must point to at least `cap` writable `IviLayer` entries, or be NULL if `cap` is 0
+ - `needed` must be a valid pointer
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+ */
+enum IviErrorCode ivi_list_layers_into(struct IviClient *client,
+                                       struct IviLayer *buf,
+                                       uintptr_t cap,
+                                       uintptr_t *needed,
+                                       char *error_buf,
+                                       uintptr_t error_buf_len);
+
+/*
+ List all screens into a caller-provided array
+
+ Works like `ivi_list_surfaces_into`: writes up to `cap` screens, stores
+ the total number in `needed` and makes no heap allocation on success.
+ Names are copied into the `name` array of each entry.
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+ - `buf` must point to at least `cap` writable `IviScreenInfo` entries, or be NULL if `cap` is 0
+ - `needed` must be a valid pointer
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+ */
+enum IviErrorCode ivi_list_screens_into(struct IviClient *client,
+                                        struct IviScreenInfo *buf,
+                                        uintptr_t cap,
+                                        uintptr_t *needed,
+                                        char *error_buf,
+                                        uintptr_t error_buf_len);
+
 /*
  Get properties of a specific layer
 
@@ -528,6 +757,296 @@ enum IviErrorCode ivi_set_layer_destination_rectangle(struct IviClient *client,
  */
 enum IviErrorCode ivi_commit(struct IviClient *client, char *error_buf, uintptr_t error_buf_len);
 
+/*
+ Commit pending changes with the next output frame
+
+ On success, `frame` (if not NULL) receives the number of the output frame
+ that first shows the changes, or 0 if the controller committed immediately.
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+ - `frame` must be a valid pointer to a `uint64_t`, or NULL
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+ */
+enum IviErrorCode ivi_commit_next_frame(struct IviClient *client,
+                                        uint64_t *frame,
+                                        char *error_buf,
+                                        uintptr_t error_buf_len);
+
+/*
+ Animate a surface to new property values on the compositor frame clock
+
+ On success, `animation_id` (if not NULL) receives the ID reported by the
+ `ANIMATION_COMPLETED` notification of this animation.
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+ - `animation` must be a valid pointer to an `IviAnimation`
+ - `animation_id` must be a valid pointer to a `uint64_t`, or NULL
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+ */
+enum IviErrorCode ivi_animate_surface(struct IviClient *client,
+                                      uint32_t id,
+                                      const struct IviAnimation *animation,
+                                      uint64_t *animation_id,
+                                      char *error_buf,
+                                      uintptr_t error_buf_len);
+
+/*
+ Animate a layer to new property values on the compositor frame clock
+
+ On success, `animation_id` (if not NULL) receives the ID reported by the
+ `ANIMATION_COMPLETED` notification of this animation.
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+ - `animation` must be a valid pointer to an `IviAnimation`
+ - `animation_id` must be a valid pointer to a `uint64_t`, or NULL
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+ */
+enum IviErrorCode ivi_animate_layer(struct IviClient *client,
+                                    uint32_t id,
+                                    const struct IviAnimation *animation,
+                                    uint64_t *animation_id,
+                                    char *error_buf,
+                                    uintptr_t error_buf_len);
+
+/*
+ Start a batch of changes
+
+ Changes queued with the `ivi_batch_set_*` functions are sent together by
+ `ivi_batch_submit`, in one request frame, and committed once.
+
+ # Returns
+
+ Returns a pointer to an empty batch. It must be passed to `ivi_batch_submit`
+ or released with `ivi_batch_free`.
+ */
+struct IviBatch *ivi_batch_begin(void);
+
+/*
+ Queue a surface source rectangle change
+
+ # Safety
+
+ - `batch` must be a valid pointer returned from `ivi_batch_begin`
+ */
+enum IviErrorCode ivi_batch_set_surface_source_rectangle(struct IviBatch *batch,
+                                                         uint32_t id,
+                                                         int32_t x,
+                                                         int32_t y,
+                                                         int32_t width,
+                                                         int32_t height);
+
+/*
+ Queue a surface destination rectangle change
+
+ # Safety
+
+ - `batch` must be a valid pointer returned from `ivi_batch_begin`
+ */
+enum IviErrorCode ivi_batch_set_surface_destination_rectangle(struct IviBatch *batch,
+                                                              uint32_t id,
+                                                              int32_t x,
+                                                              int32_t y,
+                                                              int32_t width,
+                                                              int32_t height);
+
+/*
+ Queue a surface visibility change
+
+ # Safety
+
+ - `batch` must be a valid pointer returned from `ivi_batch_begin`
+ */
+enum IviErrorCode ivi_batch_set_surface_visibility(struct IviBatch *batch,
+                                                   uint32_t id,
+                                                   bool visible);
+
+/*
+ Queue a surface opacity change
+
+ # Safety
+
+ - `batch` must be a valid pointer returned from `ivi_batch_begin`
+ */
+enum IviErrorCode ivi_batch_set_surface_opacity(struct IviBatch *batch, uint32_t id, float opacity);
+
+/*
+ Queue a surface z-order change
+
+ # Safety
+
+ - `batch` must be a valid pointer returned from `ivi_batch_begin`
+ */
+enum IviErrorCode ivi_batch_set_surface_z_order(struct IviBatch *batch,
+                                                uint32_t id,
+                                                int32_t z_order);
+
+/*
+ Queue a surface focus change
+
+ # Safety
+
+ - `batch` must be a valid pointer returned from `ivi_batch_begin`
+ */
+enum IviErrorCode ivi_batch_set_surface_focus(struct IviBatch *batch, uint32_t id);
+
+/*
+ Queue a layer source rectangle change
+
+ # Safety
+
+ - `batch` must be a valid pointer returned from `ivi_batch_begin`
+ */
+enum IviErrorCode ivi_batch_set_layer_source_rectangle(struct IviBatch *batch,
+                                                       uint32_t id,
+                                                       int32_t x,
+                                                       int32_t y,
+                                                       int32_t width,
+                                                       int32_t height);
+
+/*
+ Queue a layer destination rectangle change
+
+ # Safety
+
+ - `batch` must be a valid pointer returned from `ivi_batch_begin`
+ */
+enum IviErrorCode ivi_batch_set_layer_destination_rectangle(struct IviBatch *batch,
+                                                            uint32_t id,
+                                                            int32_t x,
+                                                            int32_t y,
+                                                            int32_t width,
+                                                            int32_t height);
+
+/*
+ Queue a layer visibility change
+
+ # Safety
+
+ - `batch` must be a valid pointer returned from `ivi_batch_begin`
+ */
+enum IviErrorCode ivi_batch_set_layer_visibility(struct IviBatch *batch, uint32_t id, bool visible);
+
+/*
+ Queue a layer opacity change
+
+ # Safety
+
+ - `batch` must be a valid pointer returned from `ivi_batch_begin`
+ */
+enum IviErrorCode ivi_batch_set_layer_opacity(struct IviBatch *batch, uint32_t id, float opacity);
+
+/*
+ Send a batch and commit it
+
+ The batch is consumed whether or not the submission succeeds.
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+ - `batch` must be a valid pointer returned from `ivi_batch_begin`
+ - After calling this function, `batch` must not be used again
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+
+ # Returns
+
+ Returns IviErrorCode::Ok if every change succeeded, or the error of the first
+ change that failed.
+ */
+enum IviErrorCode ivi_batch_submit(struct IviClient *client,
+                                   struct IviBatch *batch,
+                                   char *error_buf,
+                                   uintptr_t error_buf_len);
+
+/*
+ Discard a batch without sending it
+
+ # Safety
+
+ - `batch` must be a pointer returned from `ivi_batch_begin`, or NULL
+ - After calling this function, `batch` must not be used again
+ */
+void ivi_batch_free(struct IviBatch *batch);
+
+/*
+ Send a JSON-RPC request without waiting for its response
+
+ The callback is invoked from `ivi_client_poll`, or from any other call on
+ the same client that reads the response. Responses may arrive in any order;
+ they are matched to requests by id.
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+ - `method` must be a valid null-terminated C string
+ - `params_json` must be a valid null-terminated JSON object, or NULL for no parameters
+ - `callback` may be NULL if the result is not needed
+ - `user_data` is passed to the callback as-is; the caller is responsible for its lifetime
+ - `request_id` must be a valid pointer, or NULL
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+ */
+enum IviErrorCode ivi_client_submit(struct IviClient *client,
+                                    const char *method,
+                                    const char *params_json,
+                                    IviResponseCallback callback,
+                                    void *user_data,
+                                    uint64_t *request_id,
+                                    char *error_buf,
+                                    uintptr_t error_buf_len);
+
+/*
+ Process responses that can be read without blocking
+
+ Call this when the descriptor from `ivi_client_get_fd` becomes readable.
+ Callbacks of completed requests run before this function returns.
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+ - `completed` must be a valid pointer, or NULL
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+
+ # Returns
+
+ Returns an error if the connection failed; all outstanding callbacks are
+ then invoked with `ConnectionFailed`.
+ */
+enum IviErrorCode ivi_client_poll(struct IviClient *client,
+                                  uintptr_t *completed,
+                                  char *error_buf,
+                                  uintptr_t error_buf_len);
+
+/*
+ Get the file descriptor of the client connection
+
+ The descriptor becomes readable when responses arrive. Add it to an event
+ loop and call `ivi_client_poll` when it fires. It must not be read from or
+ closed by the caller.
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+
+ # Returns
+
+ Returns the descriptor, or -1 if none is available.
+ */
+int ivi_client_get_fd(const struct IviClient *client);
+
+/*
+ Get the number of submitted requests still waiting for a response
+
+ # Safety
+
+ - `client` must be a valid pointer returned from `ivi_client_connect`
+ */
+uintptr_t ivi_client_pending_count(const struct IviClient *client);
+
 /*
  Free surfaces array allocated by ivi_list_surfaces
 
@@ -550,6 +1069,89 @@ void ivi_free_surfaces(struct IviSurface *surfaces, uintptr_t count);
  */
 void ivi_free_layers(struct IviLayer *layers, uintptr_t count);
 
+/*
+ Map the scene mirror published by the controller
+
+ Reads through the returned map are plain memory loads: no system call and
+ no round trip to the controller.
+
+ # Safety
+
+ - `path` must be a valid null-terminated C string, or NULL to use the default path
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+
+ # Returns
+
+ Returns a pointer to the scene map on success, or NULL on failure.
+ The map must be released with `ivi_client_unmap_scene`.
+ */
+struct IviSceneMap *ivi_client_map_scene(const char *path, char *error_buf, uintptr_t error_buf_len);
+
+/*
+ Unmap a scene mirror
+
+ # Safety
+
+ - `scene` must be a pointer returned from `ivi_client_map_scene`, or NULL
+ - After calling this function, `scene` must not be used again
+ */
+void ivi_client_unmap_scene(struct IviSceneMap *scene);
+
+/*
+ Read a surface from a scene mirror
+
+ # Safety
+
+ - `scene` must be a valid pointer returned from `ivi_client_map_scene`
+ - `surface` must be a valid pointer to an IviSurface structure
+
+ # Returns
+
+ Returns true and fills `surface` if the surface is in the mirror. Returns
+ false if it is not, or if the mirror could not be read because the
+ controller died in the middle of an update.
+ */
+bool ivi_scene_get_surface(struct IviSceneMap *scene, uint32_t id, struct IviSurface *surface);
+
+/*
+ Read a layer from a scene mirror
+
+ # Safety
+
+ - `scene` must be a valid pointer returned from `ivi_client_map_scene`
+ - `layer` must be a valid pointer to an IviLayer structure
+
+ # Returns
+
+ Returns true and fills `layer` if the layer is in the mirror. Returns
+ false if it is not, or if the mirror could not be read.
+ */
+bool ivi_scene_get_layer(struct IviSceneMap *scene, uint32_t id, struct IviLayer *layer);
+
+/*
+ Scene generation a mirror was last updated to
+
+ The generation changes whenever the scene does, so comparing it with a
+ saved value tells whether anything needs to be read again.
+
+ # Safety
+
+ - `scene` must be a valid pointer returned from `ivi_client_map_scene`
+ */
+uint64_t ivi_scene_generation(const struct IviSceneMap *scene);
+
+/*
+ Check whether the controller still updates a scene mirror
+
+ Returns false once the controller has shut down or restarted; map the
+ scene again to follow a new instance.
+
+ # Safety
+
+ - `scene` must be a valid pointer returned from `ivi_client_map_scene`
+ */
+bool ivi_scene_is_live(const struct IviSceneMap *scene);
+
 /*
  Create a notification listener with its own connection to the IVI controller.
 
@@ -630,4 +1232,61 @@ enum IviErrorCode ivi_notification_listener_start(struct NotificationListener *l
  */
 void ivi_notification_listener_stop(struct NotificationListener *listener);
 
+/*
+ Subscribe to the specified event types without starting a reader thread.
+
+ Drive the listener from your own event loop instead: watch the descriptor
+ from `ivi_notification_listener_get_fd` and call
+ `ivi_notification_listener_dispatch` when it becomes readable, and once
+ right after this call. Callbacks then run on the thread calling dispatch.
+
+ # Safety
+
+ - `listener` must be a valid pointer returned from `ivi_notification_listener_new`
+ - `event_types` must be a valid pointer to an array of `count` `IviEventType` values, or NULL
+   if `count` is 0
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+ */
+enum IviErrorCode ivi_notification_listener_subscribe(struct NotificationListener *listener,
+                                                      const enum IviEventType *event_types,
+                                                      uintptr_t count,
+                                                      char *error_buf,
+                                                      uintptr_t error_buf_len);
+
+/*
+ Get the file descriptor of the listener connection
+
+ The descriptor becomes readable when notifications arrive. It must not be
+ read from or closed by the caller.
+
+ # Safety
+
+ - `listener` must be a valid pointer returned from `ivi_notification_listener_new`
+
+ # Returns
+
+ Returns the descriptor, or -1 if none is available.
+ */
+int ivi_notification_listener_get_fd(const struct NotificationListener *listener);
+
+/*
+ Run callbacks for every notification that can be read without blocking
+
+ Only for listeners set up with `ivi_notification_listener_subscribe`.
+
+ # Safety
+
+ - `listener` must be a valid pointer returned from `ivi_notification_listener_new`
+ - `dispatched` must be a valid pointer, or NULL
+ - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+
+ # Returns
+
+ Returns an error if the connection failed or the reader thread is running.
+ */
+enum IviErrorCode ivi_notification_listener_dispatch(struct NotificationListener *listener,
+                                                     uintptr_t *dispatched,
+                                                     char *error_buf,
+                                                     uintptr_t error_buf_len);
+
 #endif /* IVI_CLIENT_H */
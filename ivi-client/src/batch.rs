@@ -0,0 +1,219 @@
+//! Batched requests for applying many changes in a single round trip.
+//!
+//! An [`IviBatch`] collects property changes and sends them to the IVI
+//! controller as one JSON-RPC 2.0 batch array. The controller applies the
+//! requests in order and commits once at the end, so a whole scene
+//! transition costs one socket round trip and becomes visible atomically.
+
+use serde_json::{json, Value};
+
+/// Builder for a batch of surface and layer changes.
+///
+/// Create one with [`IviClient::batch`](crate::IviClient::batch), queue
+/// changes, then send everything with
+/// [`IviClient::submit_batch`](crate::IviClient::submit_batch).
+///
+/// # Example
+///
+/// ```no_run
+/// use ivi_client::IviClient;
+///
+/// # fn main() -> ivi_client::Result<()> {
+/// let mut client = IviClient::new(Some("/tmp/weston-ivi-controller.sock"))?;
+///
+/// let mut batch = client.batch();
+/// batch
+///     .set_surface_destination_rectangle(1000, 0, 0, 1920, 1080)
+///     .set_surface_visibility(1000, true)
+///     .set_surface_opacity(1001, 0.5);
+///
+/// // One frame out, one frame back, one commit
+/// client.submit_batch(batch)?;
+/// # Ok(())
+/// # }
+/// ```
+#[derive(Debug, Clone, Default)]
+pub struct IviBatch {
+    calls: Vec<(&'static str, Value)>,
+}
+
+impl IviBatch {
+    /// Creates an empty batch.
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Returns the number of queued changes.
+    pub fn len(&self) -> usize {
+        self.calls.len()
+    }
+
+    /// Returns true if no changes are queued.
+    pub fn is_empty(&self) -> bool {
+        self.calls.is_empty()
+    }
+
+    /// Discards all queued changes.
+    pub fn clear(&mut self) {
+        self.calls.clear();
+    }
+
+    /// Takes the queued method calls, leaving the batch empty.
+    pub(crate) fn take_calls(&mut self) -> Vec<(&'static str, Value)> {
+        std::mem::take(&mut self.calls)
+    }
+
+    fn push(&mut self, method: &'static str, params: Value) -> &mut Self {
+        self.calls.push((method, params));
+        self
+    }
+
+    /// Queues a change of the surface source rectangle.
+    pub fn set_surface_source_rectangle(
+        &mut self,
+        id: u32,
+        x: i32,
+        y: i32,
+        width: i32,
+        height: i32,
+    ) -> &mut Self {
+        self.push(
+            "set_surface_source_rectangle",
+            json!({ "id": id, "x": x, "y": y, "width": width, "height": height }),
+        )
+    }
+
+    /// Queues a change of the surface destination rectangle.
+    pub fn set_surface_destination_rectangle(
+        &mut self,
+        id: u32,
+        x: i32,
+        y: i32,
+        width: i32,
+        height: i32,
+    ) -> &mut Self {
+        self.push(
+            "set_surface_destination_rectangle",
+            json!({ "id": id, "x": x, "y": y, "width": width, "height": height }),
+        )
+    }
+
+    /// Queues a change of surface visibility.
+    pub fn set_surface_visibility(&mut self, id: u32, visible: bool) -> &mut Self {
+        self.push(
+            "set_surface_visibility",
+            json!({ "id": id, "visible": visible }),
+        )
+    }
+
+    /// Queues a change of surface opacity.
+    pub fn set_surface_opacity(&mut self, id: u32, opacity: f32) -> &mut Self {
+        self.push(
+            "set_surface_opacity",
+            json!({ "id": id, "opacity": opacity }),
+        )
+    }
+
+    /// Queues a change of surface z-order.
+    pub fn set_surface_z_order(&mut self, id: u32, z_order: i32) -> &mut Self {
+        self.push(
+            "set_surface_z_order",
+            json!({ "id": id, "z_order": z_order }),
+        )
+    }
+
+    /// Queues an input focus change to the surface.
+    pub fn set_surface_focus(&mut self, id: u32) -> &mut Self {
+        self.push("set_surface_focus", json!({ "id": id }))
+    }
+
+    /// Queues a change of the layer source rectangle.
+    pub fn set_layer_source_rectangle(
+        &mut self,
+        id: u32,
+        x: i32,
+        y: i32,
+        width: i32,
+        height: i32,
+    ) -> &mut Self {
+        self.push(
+            "set_layer_source_rectangle",
+            json!({ "id": id, "x": x, "y": y, "width": width, "height": height }),
+        )
+    }
+
+    /// Queues a change of the layer destination rectangle.
+    pub fn set_layer_destination_rectangle(
+        &mut self,
+        id: u32,
+        x: i32,
+        y: i32,
+        width: i32,
+        height: i32,
+    ) -> &mut Self {
+        self.push(
+            "set_layer_destination_rectangle",
+            json!({ "id": id, "x": x, "y": y, "width": width, "height": height }),
+        )
+    }
+
+    /// Queues a change of layer visibility.
+    pub fn set_layer_visibility(&mut self, id: u32, visible: bool) -> &mut Self {
+        self.push(
+            "set_layer_visibility",
+            json!({ "id": id, "visible": visible }),
+        )
+    }
+
+    /// Queues a change of layer opacity.
+    pub fn set_layer_opacity(&mut self, id: u32, opacity: f32) -> &mut Self {
+        self.push("set_layer_opacity", json!({ "id": id, "opacity": opacity }))
+    }
+
+    /// Queues replacing the surfaces on a layer (first = bottom, last = top).
+    pub fn set_surfaces_on_layer(&mut self, layer_id: u32, surface_ids: &[u32]) -> &mut Self {
+        self.push(
+            "set_layer_surfaces",
+            json!({ "layer_id": layer_id, "surface_ids": surface_ids }),
+        )
+    }
+
+    /// Queues adding a surface to a layer as the topmost surface.
+    pub fn add_surface_to_layer(&mut self, layer_id: u32, surface_id: u32) -> &mut Self {
+        self.push(
+            "add_surface_to_layer",
+            json!({ "layer_id": layer_id, "surface_id": surface_id }),
+        )
+    }
+
+    /// Queues removing a surface from a layer.
+    pub fn remove_surface_from_layer(&mut self, layer_id: u32, surface_id: u32) -> &mut Self {
+        self.push(
+            "remove_surface_from_layer",
+            json!({ "layer_id": layer_id, "surface_id": surface_id }),
+        )
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_batch_builder_queues_in_order() {
+        let mut batch = IviBatch::new();
+        assert!(batch.is_empty());
+
+        batch
+            .set_surface_visibility(1000, true)
+            .set_surface_opacity(1000, 0.5)
+            .set_surfaces_on_layer(10, &[1000, 1001]);
+        assert_eq!(batch.len(), 3);
+
+        let calls = batch.take_calls();
+        assert!(batch.is_empty());
+        assert_eq!(calls[0].0, "set_surface_visibility");
+        assert_eq!(calls[1].1, json!({ "id": 1000, "opacity": 0.5 }));
+        assert_eq!(calls[2].1["surface_ids"], json!([1000, 1001]));
+    }
+}
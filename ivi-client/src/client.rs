@@ -9,19 +9,31 @@ pub mod unix_domain;
 #[cfg(feature = "enable-ipcon")]
 pub mod ipcon;
 
+pub mod pending;
+
+mod cache;
+mod decode;
+mod wake;
+
+use crate::batch::IviBatch;
 use crate::error::{IviError, Result};
 use crate::ffi::*;
-use crate::protocol::{EventType, JsonRpcRequest, JsonRpcResponse, Notification};
+use crate::protocol::{
+    EventType, JsonRpcRequest, JsonRpcResponse, Notification, SceneChanges, ServerMetrics,
+};
 #[allow(unused)]
 use jlogger_tracing::{jdebug, jerror, jinfo, jtrace, jwarn};
+use serde::de::DeserializeOwned;
+use serde::Serialize;
 use serde_json::json;
 use serde_json::Value;
-use std::collections::HashMap;
 use std::io::ErrorKind;
+use std::os::unix::io::RawFd;
 use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
 use std::sync::{Arc, Mutex};
 use std::thread::JoinHandle;
 use std::time::Duration;
+use weston_ivi_controller::rpc::{msgpack, Encoding};
 
 #[cfg(not(feature = "enable-ipcon"))]
 use unix_domain::UnixDomainIviClient;
@@ -29,6 +41,11 @@ use unix_domain::UnixDomainIviClient;
 #[cfg(feature = "enable-ipcon")]
 pub use ipcon::IpconIviClient;
 
+use cache::ClientCache;
+use pending::PendingRequests;
+pub use pending::{PendingResponse, ResponseCallback};
+use wake::{WakeFd, Wakeup};
+
 pub enum IviRequestResult {
     /// Result of creating a layer, returns the new layer ID
     CreateLayer(LayerId),
@@ -38,15 +55,57 @@ pub enum IviRequestResult {
 trait IviClientTransport: Send {
     fn send_request(&mut self, request: &[u8]) -> Result<()>;
     fn receive_response(&mut self) -> Result<Vec<u8>>;
+
+    /// Receives the next frame into `frame`, reusing its allocation.
+    fn receive_response_into(&mut self, frame: &mut Vec<u8>) -> Result<()> {
+        *frame = self.receive_response()?;
+        Ok(())
+    }
     fn disconnect(&mut self) -> Result<()>;
     fn set_read_timeout(&mut self, timeout: Option<Duration>) -> Result<()>;
+
+    /// Returns a frame if a complete one can be read without blocking.
+    fn try_receive_response(&mut self) -> Result<Option<Vec<u8>>> {
+        Err(IviError::IoError(std::io::Error::new(
+            ErrorKind::Unsupported,
+            "Non-blocking receive is not supported by this transport",
+        )))
+    }
+
+    /// File descriptor that becomes readable when a frame arrives.
+    fn raw_fd(&self) -> Option<RawFd> {
+        None
+    }
 }
 
+/// Callback type for notifications received on an `IviClient` connection.
+pub type ClientNotificationCallback = Box<dyn FnMut(&Notification) + Send + 'static>;
+
 pub struct IviClient {
     transport: Option<Box<dyn IviClientTransport>>,
 
     /// Atomic counter for generating unique request IDs
     request_id: AtomicU64,
+
+    /// Requests that have been sent but not yet answered
+    pending: PendingRequests,
+
+    /// Receives notifications interleaved with responses on this connection
+    notification_callback: Option<ClientNotificationCallback>,
+
+    /// Wire encoding negotiated with the controller
+    encoding: Encoding,
+
+    /// Controller address, for the connections opened by the scene cache
+    remote: Option<String>,
+
+    /// Local scene answering lookups, if enabled
+    cache: Option<ClientCache>,
+
+    /// Request and response buffers of the `*_into` methods, kept to reuse
+    /// their allocations
+    request_buf: Vec<u8>,
+    response_buf: Vec<u8>,
 }
 
 impl IviClient {
@@ -54,6 +113,13 @@ impl IviClient {
         let mut client = IviClient {
             transport: None,
             request_id: AtomicU64::new(1),
+            pending: PendingRequests::default(),
+            notification_callback: None,
+            encoding: Encoding::Json,
+            remote: remote.map(str::to_string),
+            cache: None,
+            request_buf: Vec::new(),
+            response_buf: Vec::new(),
         };
 
         #[cfg(not(feature = "enable-ipcon"))]
@@ -101,6 +167,11 @@ impl IviClient {
     /// # }
     /// ```
     pub fn disconnect(&mut self) -> Result<()> {
+        self.pending.fail_all("Disconnected");
+        if let Some(cache) = self.cache.as_ref() {
+            cache.scene().lock().unwrap().requests_lost();
+        }
+
         if let Some(mut transport) = self.transport.take() {
             transport.disconnect()
         } else {
@@ -119,14 +190,132 @@ impl IviClient {
         self.request_id.fetch_add(1, Ordering::SeqCst)
     }
 
+    fn transport_mut(&mut self) -> Result<&mut Box<dyn IviClientTransport>> {
+        self.transport.as_mut().ok_or_else(|| {
+            IviError::ConnectionFailed("No active connection to send request.".to_string())
+        })
+    }
+
+    /// Serializes a JSON-RPC request and writes it to the connection.
+    fn write_request(&mut self, request_id: u64, method: &str, params: Value) -> Result<()> {
+        let request = JsonRpcRequest::new(request_id, method, params);
+
+        jtrace!(
+            event = "ivi_client_send_request",
+            request_id = request_id,
+            method = method,
+            request = format!("{:?}", request.params)
+        );
+
+        let request_data = self.encode_message(&request)?;
+        self.transport_mut()?.send_request(&request_data)?;
+        self.note_request(request_id, method);
+        Ok(())
+    }
+
+    /// Tells the scene cache about a request sent on this connection.
+    fn note_request(&mut self, request_id: u64, method: &str) {
+        if let Some(cache) = self.cache.as_ref() {
+            cache
+                .scene()
+                .lock()
+                .unwrap()
+                .note_request(request_id, method);
+        }
+    }
+
+    /// Tells the scene cache that a request sent on this connection was answered.
+    fn note_response(&mut self, request_id: u64) {
+        if let Some(cache) = self.cache.as_ref() {
+            cache.scene().lock().unwrap().note_response(request_id);
+        }
+    }
+
+    /// Serializes an outgoing message in the negotiated encoding.
+    fn encode_message<T: Serialize>(&self, message: &T) -> Result<Vec<u8>> {
+        match self.encoding {
+            Encoding::Json => {
+                serde_json::to_vec(message).map_err(|e| IviError::SerializationError(e.to_string()))
+            }
+            Encoding::MessagePack => serde_json::to_value(message)
+                .map(|value| msgpack::to_vec(&value))
+                .map_err(|e| IviError::SerializationError(e.to_string())),
+        }
+    }
+
+    /// Decodes an incoming frame in the negotiated encoding.
+    fn decode_frame(&self, frame: &[u8]) -> Result<Value> {
+        match self.encoding {
+            Encoding::Json => serde_json::from_slice(frame)
+                .map_err(|e| IviError::DeserializationError(e.to_string())),
+            Encoding::MessagePack => {
+                msgpack::decode(frame).map_err(|e| IviError::DeserializationError(e.to_string()))
+            }
+        }
+    }
+
+    /// Returns the wire encoding used on this connection.
+    pub fn encoding(&self) -> Encoding {
+        self.encoding
+    }
+
+    /// Switches the connection to another wire encoding.
+    ///
+    /// Sends a `handshake` request; once the controller accepts it, every
+    /// later request, response and notification on this connection uses
+    /// `encoding`. MessagePack is considerably cheaper to produce and parse
+    /// than JSON text, which matters for `list_surfaces` and notifications on
+    /// slow CPUs. JSON stays the default and is easier to debug.
+    ///
+    /// # Errors
+    ///
+    /// Fails if requests are still in flight, since their responses could
+    /// arrive in either encoding, or if the controller rejects the encoding.
+    ///
+    /// # Example
+    ///
+    /// ```no_run
+    /// use ivi_client::{Encoding, IviClient};
+    ///
+    /// # fn main() -> ivi_client::Result<()> {
+    /// let mut client = IviClient::new(Some("/tmp/weston-ivi-controller.sock"))?;
+    /// client.set_encoding(Encoding::MessagePack)?;
+    /// let surfaces = client.list_surfaces()?;
+    /// # Ok(())
+    /// # }
+    /// ```
+    pub fn set_encoding(&mut self, encoding: Encoding) -> Result<()> {
+        if encoding == self.encoding {
+            return Ok(());
+        }
+
+        if self.pending.len() > 0 {
+            return Err(IviError::IoError(std::io::Error::new(
+                ErrorKind::InvalidInput,
+                "Cannot change encoding while requests are in flight",
+            )));
+        }
+
+        // The response is still in the current encoding
+        let result = self.send_request("handshake", json!({ "encodings": [encoding.name()] }))?;
+
+        if result.get("encoding").and_then(|v| v.as_str()) != Some(encoding.name()) {
+            return Err(IviError::DeserializationError(format!(
+                "Controller did not accept the {} encoding",
+                encoding.name()
+            )));
+        }
+
+        self.encoding = encoding;
+        Ok(())
+    }
+
     /// Sends a JSON-RPC request to the IVI controller and receives the response.
     ///
-    /// This is an internal helper method that handles the low-level communication:
-    /// 1. Generates a unique request ID
-    /// 2. Serializes the request to JSON
-    /// 3. Sends the request over the socket with newline termination
-    /// 4. Receives the response from the socket
-    /// 5. Deserializes and validates the response
+    /// This is an internal helper method that submits the request and then
+    /// processes incoming frames until its response arrives. Responses to
+    /// other pipelined requests and notifications received in the meantime
+    /// are dispatched as they come in.
     ///
     /// # Arguments
     ///
@@ -148,37 +337,390 @@ impl IviClient {
     /// - `IviError::DeserializationError` - Failed to deserialize the response
     /// - `IviError::RequestFailed` - The server returned an error response
     pub(crate) fn send_request(&mut self, method: &str, params: Value) -> Result<Value> {
-        // Generate unique request ID
-        let request_id = self.next_request_id();
+        let pending = self.submit(method, params)?;
+        self.wait(pending)
+    }
 
-        // Create JSON-RPC request
-        let request = JsonRpcRequest::new(request_id, method, params);
+    /// Sends a parameterless request for a list and passes each element of
+    /// the `key` list in the result to `sink` with its index, as it is
+    /// parsed. Returns the number of elements.
+    ///
+    /// With the JSON encoding the request and response reuse buffers of the
+    /// client and the response is decoded in place, so once the buffers have
+    /// grown to fit, a successful call allocates nothing. Frames of other
+    /// requests and notifications received meanwhile are dispatched as usual.
+    pub(crate) fn list_into<E, F>(&mut self, method: &str, key: &str, mut sink: F) -> Result<usize>
+    where
+        E: DeserializeOwned,
+        F: FnMut(usize, E),
+    {
+        if self.encoding != Encoding::Json {
+            // Only JSON frames are decoded in place
+            let result = self.send_request(method, json!({}))?;
+            let list = result.get(key).and_then(Value::as_array).ok_or_else(|| {
+                IviError::DeserializationError(format!("Missing '{}' field in response", key))
+            })?;
+            for (index, value) in list.iter().enumerate() {
+                let element = E::deserialize(value).map_err(|e| {
+                    IviError::DeserializationError(format!("Failed to parse {}: {}", key, e))
+                })?;
+                sink(index, element);
+            }
+            return Ok(list.len());
+        }
+
+        let request_id = self.next_request_id();
+        let request = decode::BareRequest {
+            id: request_id,
+            method,
+            params: decode::NoParams,
+        };
+        self.request_buf.clear();
+        serde_json::to_writer(&mut self.request_buf, &request)
+            .map_err(|e| IviError::SerializationError(e.to_string()))?;
 
         jtrace!(
             event = "ivi_client_send_request",
             request_id = request_id,
-            method = method,
-            request = format!("{:?}", request.params)
+            method = method
         );
 
-        // Serialize request to JSON (as bytes for length-prefix protocol)
-        let request_json = serde_json::to_vec(&request)
-            .map_err(|e| IviError::SerializationError(e.to_string()))?;
-
         let transport = self.transport.as_mut().ok_or_else(|| {
             IviError::ConnectionFailed("No active connection to send request.".to_string())
         })?;
+        transport.send_request(&self.request_buf)?;
+        self.note_request(request_id, method);
+
+        loop {
+            let received = match self.transport.as_mut() {
+                Some(transport) => transport.receive_response_into(&mut self.response_buf),
+                None => Err(IviError::ConnectionFailed(
+                    "No active connection to receive response.".to_string(),
+                )),
+            };
+            if let Err(e) = received {
+                return Err(self.receive_failed(e));
+            }
 
-        transport.send_request(&request_json)?;
-        let response_buf = transport.receive_response()?;
+            // Taken out so other frames can be dispatched; put back to keep its capacity
+            let frame = std::mem::take(&mut self.response_buf);
+            let decoded = decode::decode_list(&frame, request_id, key, &mut sink);
+            if decoded.is_none() {
+                self.dispatch_frame(&frame);
+            }
+            self.response_buf = frame;
 
-        // Deserialize response
-        let response: JsonRpcResponse = serde_json::from_slice(&response_buf)
-            .map_err(|e| IviError::DeserializationError(e.to_string()))?;
+            if let Some(result) = decoded {
+                self.note_response(request_id);
+                return result;
+            }
+        }
+    }
+
+    /// Sends a request without waiting for its response.
+    ///
+    /// Any number of requests can be in flight at once. The response is
+    /// matched to the request by its JSON-RPC id, so the controller may
+    /// answer them in any order. The returned handle is completed by
+    /// [`poll`](Self::poll) or [`wait`](Self::wait), or whenever another call
+    /// on this client reads the response.
+    ///
+    /// # Example
+    ///
+    /// ```no_run
+    /// use ivi_client::IviClient;
+    /// use serde_json::json;
+    ///
+    /// # fn main() -> ivi_client::Result<()> {
+    /// let mut client = IviClient::new(Some("/tmp/weston-ivi-controller.sock"))?;
+    ///
+    /// let first = client.submit("get_surface", json!({ "id": 1000 }))?;
+    /// let second = client.submit("get_surface", json!({ "id": 1001 }))?;
+    ///
+    /// // Both requests are on the wire; collect the answers
+    /// let first = client.wait(first)?;
+    /// let second = client.wait(second)?;
+    /// # Ok(())
+    /// # }
+    /// ```
+    pub fn submit(&mut self, method: &str, params: Value) -> Result<PendingResponse> {
+        let request_id = self.next_request_id();
+        let pending = self.pending.insert_handle(request_id);
+
+        if let Err(e) = self.write_request(request_id, method, params) {
+            self.pending.remove(request_id);
+            return Err(e);
+        }
+
+        Ok(pending)
+    }
+
+    /// Sends a request and invokes `callback` with its id and result once it arrives.
+    ///
+    /// The callback runs from [`poll`](Self::poll), [`wait`](Self::wait) or
+    /// any other call that reads the response. Returns the request id.
+    pub fn submit_with<F>(&mut self, method: &str, params: Value, callback: F) -> Result<u64>
+    where
+        F: FnOnce(u64, Result<Value>) + Send + 'static,
+    {
+        let request_id = self.next_request_id();
+        self.pending.insert_callback(request_id, Box::new(callback));
+
+        if let Err(e) = self.write_request(request_id, method, params) {
+            self.pending.remove(request_id);
+            return Err(e);
+        }
+
+        Ok(request_id)
+    }
+
+    /// Processes every frame that can be read without blocking.
+    ///
+    /// Call this when the descriptor returned by [`raw_fd`](Self::raw_fd)
+    /// becomes readable. Returns the number of requests that were completed.
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if the connection fails. All outstanding requests are
+    /// then completed with `IviError::ConnectionFailed`.
+    pub fn poll(&mut self) -> Result<usize> {
+        let mut completed = 0;
+
+        loop {
+            let frame = match self.transport_mut()?.try_receive_response() {
+                Ok(Some(frame)) => frame,
+                Ok(None) => break,
+                Err(e) => return Err(self.receive_failed(e)),
+            };
+            completed += self.dispatch_frame(&frame);
+        }
+
+        Ok(completed)
+    }
+
+    /// Blocks until the response for `pending` arrives and returns its result.
+    ///
+    /// Frames for other requests and notifications received while waiting
+    /// are dispatched as usual.
+    pub fn wait(&mut self, pending: PendingResponse) -> Result<Value> {
+        loop {
+            if let Some(result) = pending.try_take() {
+                return result;
+            }
+
+            if !self.pending.contains(pending.id()) {
+                return Err(IviError::ConnectionFailed(format!(
+                    "Request {} is not pending on this client",
+                    pending.id()
+                )));
+            }
+
+            let frame = match self.transport_mut()?.receive_response() {
+                Ok(frame) => frame,
+                Err(e) => return Err(self.receive_failed(e)),
+            };
+            self.dispatch_frame(&frame);
+        }
+    }
+
+    /// Returns the number of requests that are still waiting for a response.
+    pub fn pending_count(&self) -> usize {
+        self.pending.len()
+    }
+
+    /// Returns the file descriptor of the connection, for use in an external
+    /// event loop together with [`poll`](Self::poll).
+    ///
+    /// Returns `None` if the client is disconnected or the transport has no
+    /// pollable descriptor.
+    pub fn raw_fd(&self) -> Option<RawFd> {
+        self.transport
+            .as_ref()
+            .and_then(|transport| transport.raw_fd())
+    }
+
+    /// Registers a callback for notifications that arrive on this connection.
+    ///
+    /// Without a callback such notifications are discarded. Use a
+    /// [`NotificationListener`] for a dedicated notification connection.
+    pub fn set_notification_callback<F>(&mut self, callback: F)
+    where
+        F: FnMut(&Notification) + Send + 'static,
+    {
+        self.notification_callback = Some(Box::new(callback));
+    }
+
+    /// Enables the local scene cache, see [`enable_cache`](Self::enable_cache).
+    ///
+    /// # Example
+    ///
+    /// ```no_run
+    /// use ivi_client::IviClient;
+    ///
+    /// # fn main() -> ivi_client::Result<()> {
+    /// let mut client = IviClient::new(None)?.with_cache()?;
+    /// // Answered from the cache, without a round trip
+    /// let surface = client.get_surface(1000)?;
+    /// # Ok(())
+    /// # }
+    /// ```
+    pub fn with_cache(mut self) -> Result<Self> {
+        self.enable_cache()?;
+        Ok(self)
+    }
+
+    /// Keeps a local copy of the scene to answer [`get_surface`](Self::get_surface),
+    /// [`get_layer`](Self::get_layer) and [`get_layer_surfaces`](Self::get_layer_surfaces).
+    ///
+    /// Loads the scene once and then follows it through a notification
+    /// listener on a second connection. Changes sent by this client are
+    /// fetched with `get_changes_since` before the next lookup, and the whole
+    /// scene is fetched again when notifications were lost or the listener
+    /// had to reconnect. Lookups of objects missing from the cache still ask
+    /// the controller.
+    ///
+    /// Layer rectangles, layer orientation and the surfaces of a layer
+    /// changed by other clients are not announced by the controller; call
+    /// [`resync_cache`](Self::resync_cache) when those matter.
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if the listener cannot connect or the scene cannot be
+    /// loaded.
+    pub fn enable_cache(&mut self) -> Result<()> {
+        if self.cache.is_some() {
+            return Ok(());
+        }
+
+        self.cache = Some(ClientCache::start(self.remote.as_deref())?);
+        if let Err(e) = self.refresh_cache() {
+            self.cache = None;
+            return Err(e);
+        }
+        Ok(())
+    }
+
+    /// Drops the scene cache and its listener; lookups go to the controller again.
+    pub fn disable_cache(&mut self) {
+        self.cache = None;
+    }
+
+    /// Fetches the whole scene into the cache again.
+    ///
+    /// Does nothing if the cache is not enabled.
+    pub fn resync_cache(&mut self) -> Result<()> {
+        match self.cache.as_ref() {
+            Some(cache) => cache.scene().lock().unwrap().invalidate(),
+            None => return Ok(()),
+        }
+        self.refresh_cache()
+    }
+
+    /// Brings the cache up to date with the controller if it fell behind.
+    fn refresh_cache(&mut self) -> Result<()> {
+        let Some(cache) = self.cache.as_mut() else {
+            return Ok(());
+        };
+        cache.ensure_listener()?;
+
+        let scene = Arc::clone(cache.scene());
+        let Some(generation) = scene.lock().unwrap().begin_resync() else {
+            return Ok(());
+        };
+
+        // Events arriving meanwhile are buffered and applied after the changes
+        match self.get_changes_since(generation) {
+            Ok(changes) => {
+                scene.lock().unwrap().finish_resync(changes);
+                Ok(())
+            }
+            Err(e) => {
+                scene.lock().unwrap().abort_resync(generation);
+                Err(e)
+            }
+        }
+    }
+
+    /// Looks an object up in the cache, bringing it up to date first.
+    ///
+    /// Returns None if the cache is disabled, could not be refreshed or does
+    /// not hold the object, so the caller asks the controller.
+    fn cached<T>(&mut self, lookup: impl FnOnce(&cache::SceneCache) -> Option<T>) -> Option<T> {
+        self.cache.as_ref()?;
+
+        if let Err(e) = self.refresh_cache() {
+            jwarn!("Failed to refresh the scene cache: {}", e);
+            return None;
+        }
+
+        let scene = self.cache.as_ref()?.scene().lock().unwrap();
+        lookup(&scene)
+    }
+
+    /// Fails all outstanding requests unless `error` is only a timeout.
+    fn receive_failed(&mut self, error: IviError) -> IviError {
+        let recoverable = matches!(&error, IviError::IoError(e)
+            if matches!(e.kind(), ErrorKind::WouldBlock | ErrorKind::TimedOut | ErrorKind::Unsupported));
+
+        if !recoverable {
+            self.pending.fail_all(&error.to_string());
+
+            // Requests may have been applied without this client seeing the result
+            if let Some(cache) = self.cache.as_ref() {
+                cache.scene().lock().unwrap().requests_lost();
+            }
+        }
+
+        error
+    }
+
+    /// Routes a received frame to the pending request or notification
+    /// callback it belongs to. Returns the number of completed requests.
+    fn dispatch_frame(&mut self, frame: &[u8]) -> usize {
+        let value = match self.decode_frame(frame) {
+            Ok(value) => value,
+            Err(e) => {
+                jwarn!("Dropping malformed frame: {}", e);
+                return 0;
+            }
+        };
+
+        match value {
+            Value::Array(responses) => {
+                let mut completed = 0;
+                for response in responses {
+                    completed += self.complete_response(response) as usize;
+                }
+                completed
+            }
+            value if value.get("id").is_some() => self.complete_response(value) as usize,
+            value => {
+                match Notification::try_from_value(&value) {
+                    Ok(Some(notification)) => {
+                        if let Some(callback) = self.notification_callback.as_mut() {
+                            callback(&notification);
+                        }
+                    }
+                    Ok(None) => {}
+                    Err(e) => jwarn!("Dropping malformed notification: {}", e),
+                }
+                0
+            }
+        }
+    }
+
+    fn complete_response(&mut self, value: Value) -> bool {
+        let response: JsonRpcResponse = match serde_json::from_value(value) {
+            Ok(response) => response,
+            Err(e) => {
+                jwarn!("Dropping malformed response: {}", e);
+                return false;
+            }
+        };
 
         jtrace!(
             event = "ivi_client_receive_response",
-            request_id = request_id,
+            request_id = response.id,
             result = response
                 .result
                 .as_ref()
@@ -191,26 +733,14 @@ impl IviClient {
                 .unwrap_or("None".to_string()),
         );
 
-        // Verify response ID matches request ID
-        if response.id != request_id {
-            return Err(IviError::DeserializationError(format!(
-                "Response ID mismatch: expected {}, got {}",
-                request_id, response.id
-            )));
-        }
-
-        // Check for error response
-        if let Some(error) = response.error {
-            return Err(IviError::RequestFailed {
-                code: error.code,
-                message: error.message,
-            });
+        let request_id = response.id;
+        self.note_response(request_id);
+        if !self.pending.complete(response) {
+            jwarn!("Dropping response to unknown request {}", request_id);
+            return false;
         }
 
-        // Return the result value
-        response.result.ok_or_else(|| {
-            IviError::DeserializationError("Response missing both result and error".to_string())
-        })
+        true
     }
 
     /// Lists all available surfaces in the IVI compositor.
@@ -260,6 +790,41 @@ impl IviClient {
         Ok(surfaces)
     }
 
+    /// Lists all surfaces into `buf` without allocating.
+    ///
+    /// Writes the first `buf.len()` surfaces and returns the total number,
+    /// which is larger than `buf.len()` if the buffer was too small. Meant for
+    /// callers that poll the scene every frame: once the connection's
+    /// buffers have grown to fit the response, a successful call with the
+    /// JSON encoding makes no heap allocation.
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if communication fails or the response cannot be parsed.
+    ///
+    /// # Example
+    ///
+    /// ```no_run
+    /// use ivi_client::{IviClient, IviSurface};
+    ///
+    /// # fn main() -> ivi_client::Result<()> {
+    /// let mut client = IviClient::new(None)?;
+    /// let mut surfaces = vec![IviSurface::default(); 64];
+    /// let count = client.list_surfaces_into(&mut surfaces)?;
+    /// for surface in &surfaces[..count.min(surfaces.len())] {
+    ///     println!("Surface ID: {}", surface.id);
+    /// }
+    /// # Ok(())
+    /// # }
+    /// ```
+    pub fn list_surfaces_into(&mut self, buf: &mut [IviSurface]) -> Result<usize> {
+        self.list_into("list_surfaces", "surfaces", |index, surface| {
+            if let Some(slot) = buf.get_mut(index) {
+                *slot = surface;
+            }
+        })
+    }
+
     /// Gets detailed properties of a specific surface.
     ///
     /// # Arguments
@@ -290,6 +855,10 @@ impl IviClient {
     /// # }
     /// ```
     pub fn get_surface(&mut self, id: u32) -> Result<IviSurface> {
+        if let Some(surface) = self.cached(|scene| scene.surface(id)) {
+            return Ok(surface);
+        }
+
         let result = self.send_request("get_surface", json!({ "id": id }))?;
 
         // Parse the result as a surface
@@ -561,6 +1130,22 @@ impl IviClient {
         Ok(layers)
     }
 
+    /// Lists all layers into `buf` without allocating.
+    ///
+    /// Writes the first `buf.len()` layers and returns the total number; see
+    /// [`list_surfaces_into`](Self::list_surfaces_into).
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if communication fails or the response cannot be parsed.
+    pub fn list_layers_into(&mut self, buf: &mut [IviLayer]) -> Result<usize> {
+        self.list_into("list_layers", "layers", |index, layer| {
+            if let Some(slot) = buf.get_mut(index) {
+                *slot = layer;
+            }
+        })
+    }
+
     /// Gets detailed properties of a specific layer.
     ///
     /// # Arguments
@@ -591,6 +1176,10 @@ impl IviClient {
     /// # }
     /// ```
     pub fn get_layer(&mut self, id: u32) -> Result<IviLayer> {
+        if let Some(layer) = self.cached(|scene| scene.layer(id)) {
+            return Ok(layer);
+        }
+
         let result = self.send_request("get_layer", json!({ "id": id }))?;
 
         // Parse the result as a layer
@@ -833,6 +1422,73 @@ impl IviClient {
         self.send_request("set_layer_opacity", value).map(|_| ())
     }
 
+    /// Animates a surface to new property values on the compositor frame clock.
+    ///
+    /// The controller steps the animation once per output frame, starting
+    /// from the current values of the animated properties, and commits each
+    /// step itself. An `AnimationCompleted` notification with the returned ID
+    /// follows when the animation reaches its target or is replaced by a newer
+    /// animation of the same property.
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if:
+    /// - The surface ID does not exist
+    /// - The animation sets no property, or a target value is out of range
+    /// - The controller has no output frames to animate with
+    /// - Communication with the controller fails
+    ///
+    /// # Example
+    ///
+    /// ```no_run
+    /// use ivi_client::{IviAnimation, IviClient, IviEasing};
+    ///
+    /// # fn main() -> ivi_client::Result<()> {
+    /// let mut client = IviClient::new(Some("/tmp/weston-ivi-controller.sock"))?;
+    /// let fade_out = IviAnimation {
+    ///     has_opacity: true,
+    ///     opacity: 0.0,
+    ///     duration_ms: 300,
+    ///     easing: IviEasing::EaseOut,
+    ///     ..Default::default()
+    /// };
+    /// let animation_id = client.animate_surface(1000, &fade_out)?;
+    /// # Ok(())
+    /// # }
+    /// ```
+    pub fn animate_surface(&mut self, id: u32, animation: &IviAnimation) -> Result<u64> {
+        self.animate("animate_surface", id, animation)
+    }
+
+    /// Animates a layer to new property values on the compositor frame clock.
+    ///
+    /// See [`animate_surface`](Self::animate_surface).
+    pub fn animate_layer(&mut self, id: u32, animation: &IviAnimation) -> Result<u64> {
+        self.animate("animate_layer", id, animation)
+    }
+
+    fn animate(&mut self, method: &str, id: u32, animation: &IviAnimation) -> Result<u64> {
+        let mut params = json!({
+            "id": id,
+            "duration_ms": animation.duration_ms,
+            "easing": animation.easing.name(),
+        });
+        if animation.has_destination {
+            params["destination"] = serde_json::to_value(animation.destination)?;
+        }
+        if animation.has_opacity {
+            params["opacity"] = json!(animation.opacity);
+        }
+
+        let result = self.send_request(method, params)?;
+        result
+            .get("animation_id")
+            .and_then(Value::as_u64)
+            .ok_or_else(|| {
+                IviError::DeserializationError("Missing 'animation_id' in response".to_string())
+            })
+    }
+
     /// Lists all available screens (outputs) in the IVI compositor.
     ///
     /// # Returns
@@ -1097,12 +1753,158 @@ impl IviClient {
     ///
     /// Returns an error if the layer is not found or communication fails.
     pub fn get_layer_surfaces(&mut self, layer_id: u32) -> Result<Vec<u32>> {
+        if let Some(surface_ids) = self.cached(|scene| scene.layer_surfaces(layer_id)) {
+            return Ok(surface_ids);
+        }
+
         let response = self.send_request("get_layer_surfaces", json!({ "layer_id": layer_id }))?;
         let surface_ids: Vec<u32> = serde_json::from_value(response["surface_ids"].clone())
             .map_err(|e| IviError::DeserializationError(e.to_string()))?;
+
+        if let Some(cache) = self.cache.as_ref() {
+            let mut scene = cache.scene().lock().unwrap();
+            // A change since the request might have made the answer stale
+            if scene.is_current() {
+                scene.store_layer_surfaces(layer_id, surface_ids.clone());
+            }
+        }
         Ok(surface_ids)
     }
 
+    /// Gets the surfaces and layers that changed after a scene generation.
+    ///
+    /// Pass 0 to get the full scene, then the returned `generation` on the
+    /// next call. The cost of catching up is proportional to what changed,
+    /// not to the size of the scene.
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if communication fails or the response cannot be parsed.
+    ///
+    /// # Example
+    ///
+    /// ```no_run
+    /// use ivi_client::IviClient;
+    ///
+    /// # fn main() -> ivi_client::Result<()> {
+    /// let mut client = IviClient::new(Some("/tmp/weston-ivi-controller.sock"))?;
+    /// let scene = client.get_changes_since(0)?;
+    /// let changes = client.get_changes_since(scene.generation)?;
+    /// println!("{} surfaces changed", changes.surfaces.len());
+    /// # Ok(())
+    /// # }
+    /// ```
+    pub fn get_changes_since(&mut self, generation: u64) -> Result<SceneChanges> {
+        let result = self.send_request("get_changes_since", json!({ "generation": generation }))?;
+        serde_json::from_value(result).map_err(|e| {
+            IviError::DeserializationError(format!("Failed to parse scene changes: {}", e))
+        })
+    }
+
+    /// Stores a named scene to be applied later with [`apply_scene`](Self::apply_scene).
+    ///
+    /// # Arguments
+    ///
+    /// * `name` - The scene name; an existing scene of this name is replaced
+    /// * `definition` - Object with optional `surfaces`, `layers` and `screens`
+    ///   arrays, as described for `define_scene` in the control interface
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if the definition is invalid or communication fails.
+    ///
+    /// # Example
+    ///
+    /// ```no_run
+    /// use ivi_client::IviClient;
+    /// use serde_json::json;
+    ///
+    /// # fn main() -> ivi_client::Result<()> {
+    /// let mut client = IviClient::new(Some("/tmp/weston-ivi-controller.sock"))?;
+    /// client.define_scene(
+    ///     "navigation",
+    ///     json!({ "surfaces": [{ "id": 1000, "visible": true, "opacity": 1.0 }] }),
+    /// )?;
+    /// client.apply_scene("navigation", true)?;
+    /// # Ok(())
+    /// # }
+    /// ```
+    pub fn define_scene(&mut self, name: &str, definition: serde_json::Value) -> Result<()> {
+        let mut params = definition;
+        if let Some(object) = params.as_object_mut() {
+            object.insert("name".to_string(), json!(name));
+        }
+        self.send_request("define_scene", params).map(|_| ())
+    }
+
+    /// Applies a scene stored with [`define_scene`](Self::define_scene).
+    ///
+    /// Nothing changes if any surface, layer or screen of the scene is missing.
+    ///
+    /// # Arguments
+    ///
+    /// * `name` - The scene name
+    /// * `auto_commit` - If true, commits the whole scene at once
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if the scene is not defined, one of its objects is
+    /// missing, or communication fails.
+    pub fn apply_scene(&mut self, name: &str, auto_commit: bool) -> Result<()> {
+        self.send_request(
+            "apply_scene",
+            json!({ "name": name, "auto_commit": auto_commit }),
+        )
+        .map(|_| ())
+    }
+
+    /// Retrieves the runtime metrics of the controller.
+    ///
+    /// # Returns
+    ///
+    /// Per-method RPC latencies, compositor callback run times, transport
+    /// counters and notification queue depths.
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if communication fails or the response cannot be parsed.
+    ///
+    /// # Example
+    ///
+    /// ```no_run
+    /// use ivi_client::IviClient;
+    ///
+    /// # fn main() -> ivi_client::Result<()> {
+    /// let mut client = IviClient::new(Some("/tmp/weston-ivi-controller.sock"))?;
+    /// let metrics = client.get_metrics()?;
+    /// if let Some(stats) = metrics.rpc.get("set_surface_visibility") {
+    ///     println!("p99: {} us", stats.p99_us);
+    /// }
+    /// # Ok(())
+    /// # }
+    /// ```
+    pub fn get_metrics(&mut self) -> Result<ServerMetrics> {
+        let result = self.send_request("get_metrics", json!({}))?;
+        serde_json::from_value(result)
+            .map_err(|e| IviError::DeserializationError(format!("Failed to parse metrics: {}", e)))
+    }
+
+    /// Retrieves the runtime metrics in the Prometheus text exposition format.
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if communication fails or the response holds no text.
+    pub fn get_metrics_prometheus(&mut self) -> Result<String> {
+        let result = self.send_request("get_metrics", json!({ "format": "prometheus" }))?;
+        result
+            .get("text")
+            .and_then(|text| text.as_str())
+            .map(str::to_string)
+            .ok_or_else(|| {
+                IviError::DeserializationError("Missing 'text' in metrics response".to_string())
+            })
+    }
+
     /// Commits all pending changes to the IVI compositor atomically.
     ///
     /// This method applies all pending surface and layer modifications in a single
@@ -1139,6 +1941,119 @@ impl IviClient {
     pub fn commit(&mut self) -> Result<()> {
         self.send_request("commit", json!({})).map(|_| ())
     }
+
+    /// Commits all pending changes with the next output frame.
+    ///
+    /// The controller issues one commit per output frame for every change
+    /// requested this way, by any client, since the previous frame. The call
+    /// returns once that commit has been issued, at most about one frame
+    /// later.
+    ///
+    /// # Returns
+    ///
+    /// The number of the output frame that first shows the changes, or `0` if
+    /// the controller has no output frames to align with and committed
+    /// immediately.
+    pub fn commit_next_frame(&mut self) -> Result<u64> {
+        let result = self.send_request("commit", json!({ "commit": "next_frame" }))?;
+        Ok(result.get("frame").and_then(Value::as_u64).unwrap_or(0))
+    }
+
+    /// Starts a batch of changes to be sent with [`submit_batch`](Self::submit_batch).
+    ///
+    /// See [`IviBatch`] for the available changes.
+    pub fn batch(&self) -> IviBatch {
+        IviBatch::new()
+    }
+
+    /// Sends all changes queued in `batch` as one JSON-RPC batch and commits them.
+    ///
+    /// The controller applies the changes in order and commits once after the
+    /// last one, so the batch costs a single round trip. An empty batch sends
+    /// nothing.
+    ///
+    /// # Errors
+    ///
+    /// Returns the first error reported for any change in the batch, or an
+    /// error if communication with the controller fails. Changes before and
+    /// after a failed one are still applied.
+    ///
+    /// # Example
+    ///
+    /// ```no_run
+    /// use ivi_client::IviClient;
+    ///
+    /// # fn main() -> ivi_client::Result<()> {
+    /// let mut client = IviClient::new(Some("/tmp/weston-ivi-controller.sock"))?;
+    ///
+    /// let mut batch = client.batch();
+    /// batch.set_surface_visibility(1000, false);
+    /// batch.set_surface_visibility(1001, true);
+    /// client.submit_batch(batch)?;
+    /// # Ok(())
+    /// # }
+    /// ```
+    pub fn submit_batch(&mut self, mut batch: IviBatch) -> Result<()> {
+        let mut calls = batch.take_calls();
+        if calls.is_empty() {
+            return Ok(());
+        }
+
+        // The controller commits once for the whole batch
+        calls.push(("commit", json!({})));
+
+        let requests: Vec<JsonRpcRequest> = calls
+            .into_iter()
+            .map(|(method, params)| JsonRpcRequest::new(self.next_request_id(), method, params))
+            .collect();
+
+        jtrace!(
+            event = "ivi_client_send_batch",
+            first_request_id = requests[0].id,
+            count = requests.len()
+        );
+
+        let request_data = self.encode_message(&requests)?;
+
+        let handles: Vec<PendingResponse> = requests
+            .iter()
+            .map(|request| self.pending.insert_handle(request.id))
+            .collect();
+
+        let sent = self
+            .transport_mut()
+            .and_then(|transport| transport.send_request(&request_data));
+        if let Err(e) = sent {
+            for request in &requests {
+                self.pending.remove(request.id);
+            }
+            return Err(e);
+        }
+
+        for request in &requests {
+            self.note_request(request.id, &request.method);
+        }
+
+        // Collect every response so none is left pending, but report the first failure
+        let mut first_error = None;
+        for (request, handle) in requests.iter().zip(handles) {
+            match self.wait(handle) {
+                Ok(_) => {}
+                Err(IviError::RequestFailed { code, message }) => {
+                    first_error.get_or_insert(IviError::RequestFailed {
+                        code,
+                        message: format!("{}: {}", request.method, message),
+                    });
+                }
+                Err(e) => return Err(e),
+            }
+        }
+
+        match first_error {
+            Some(error) => Err(error),
+            None => Ok(()),
+        }
+    }
 }
 
 // ============================================================================
@@ -1148,6 +2063,55 @@ impl IviClient {
 /// Callback type for notification events.
 pub type NotificationCallback = Arc<dyn Fn(&Notification) + Send + Sync + 'static>;
 
+/// Callback type for notification events decoded into [`IviNotification`].
+pub type TypedNotificationCallback = Arc<dyn Fn(&IviNotification) + Send + Sync + 'static>;
+
+#[derive(Clone)]
+enum Handler {
+    Value(NotificationCallback),
+    Typed(TypedNotificationCallback),
+}
+
+/// Callbacks of a listener, indexed by `IviEventType`
+#[derive(Clone, Default)]
+struct CallbackTable {
+    by_type: [Vec<Handler>; EventType::ALL.len()],
+    all: Vec<Handler>,
+}
+
+impl CallbackTable {
+    fn add(&mut self, event_type: Option<EventType>, handler: Handler) {
+        match event_type {
+            Some(event_type) => {
+                self.by_type[IviEventType::from(&event_type) as usize].push(handler)
+            }
+            None => self.all.push(handler),
+        }
+    }
+
+    /// Run per-type callbacks, then catch-all callbacks, for one event
+    fn dispatch(&self, event: &IviNotification, frame: &[u8]) {
+        // Only `Notification` callbacks need the params as a `Value`, so the
+        // frame is parsed a second time at most once, and only for them.
+        let mut notification: Option<Option<Notification>> = None;
+        for handler in self.by_type[event.event_type as usize]
+            .iter()
+            .chain(&self.all)
+        {
+            match handler {
+                Handler::Typed(cb) => cb(event),
+                Handler::Value(cb) => {
+                    let parsed = notification
+                        .get_or_insert_with(|| Notification::try_from_frame(frame).ok().flatten());
+                    if let Some(notif) = parsed {
+                        cb(notif);
+                    }
+                }
+            }
+        }
+    }
+}
+
 /// Listens for event notifications from the IVI controller.
 ///
 /// Opens its own dedicated socket connection so that notifications are not
@@ -1169,6 +2133,11 @@ pub type NotificationCallback = Arc<dyn Fn(&Notification) + Send + Sync + 'stati
 ///     println!("Event: {:?}", notif.event_type);
 /// });
 ///
+/// // Typed callbacks skip building the `Value` params entirely
+/// listener.on_typed(EventType::VisibilityChanged, |notif| {
+///     println!("Surface {} visible: {}", notif.object_id, notif.visibility.new_visibility);
+/// });
+///
 /// listener.start(&[EventType::SurfaceCreated, EventType::VisibilityChanged])?;
 /// // ... callbacks fire in background thread ...
 /// listener.stop();
@@ -1178,10 +2147,15 @@ pub type NotificationCallback = Arc<dyn Fn(&Notification) + Send + Sync + 'stati
 pub struct NotificationListener {
     transport: Arc<Mutex<Box<dyn IviClientTransport>>>,
     request_id: AtomicU64,
-    callbacks: Arc<Mutex<HashMap<EventType, Vec<NotificationCallback>>>>,
-    catch_all_callbacks: Arc<Mutex<Vec<NotificationCallback>>>,
+    /// Copied on write, so the reader thread dispatches from a snapshot
+    /// without cloning callback lists per event
+    callbacks: Arc<Mutex<Arc<CallbackTable>>>,
     stop_flag: Arc<AtomicBool>,
+    wake: Arc<WakeFd>,
     thread_handle: Option<JoinHandle<()>>,
+    coalesce: bool,
+    surface_ids: Vec<u32>,
+    layer_ids: Vec<u32>,
 }
 
 impl NotificationListener {
@@ -1198,13 +2172,36 @@ impl NotificationListener {
         Ok(Self {
             transport: Arc::new(Mutex::new(transport)),
             request_id: AtomicU64::new(1),
-            callbacks: Arc::new(Mutex::new(HashMap::new())),
-            catch_all_callbacks: Arc::new(Mutex::new(Vec::new())),
+            callbacks: Arc::new(Mutex::new(Arc::new(CallbackTable::default()))),
             stop_flag: Arc::new(AtomicBool::new(false)),
+            wake: Arc::new(WakeFd::new()?),
             thread_handle: None,
+            coalesce: false,
+            surface_ids: Vec::new(),
+            layer_ids: Vec::new(),
         })
     }
 
+    /// Ask the server to coalesce state changes per object.
+    ///
+    /// While this client is behind, a newer geometry, opacity, visibility or
+    /// similar change replaces the pending one for the same surface or layer,
+    /// keeping the original `old_*` values. Lifecycle and focus events are
+    /// always delivered. Takes effect with the next [`start`](Self::start).
+    pub fn set_coalescing(&mut self, coalesce: bool) {
+        self.coalesce = coalesce;
+    }
+
+    /// Limit the subscription to events of the given surfaces and layers.
+    ///
+    /// Events of other objects are filtered out by the server, so they cost
+    /// this client nothing. Passing two empty slices subscribes to every
+    /// object again. Takes effect with the next [`start`](Self::start).
+    pub fn set_scope(&mut self, surface_ids: &[u32], layer_ids: &[u32]) {
+        self.surface_ids = surface_ids.to_vec();
+        self.layer_ids = layer_ids.to_vec();
+    }
+
     fn next_request_id(&self) -> u64 {
         self.request_id.fetch_add(1, Ordering::SeqCst)
     }
@@ -1234,18 +2231,18 @@ impl NotificationListener {
         })
     }
 
+    fn add_handler(&mut self, event_type: Option<EventType>, handler: Handler) {
+        let mut callbacks = self.callbacks.lock().unwrap();
+        Arc::make_mut(&mut callbacks).add(event_type, handler);
+    }
+
     /// Register a callback for a specific event type.
     /// Multiple callbacks per event type are allowed.
     pub fn on<F>(&mut self, event_type: EventType, callback: F)
     where
         F: Fn(&Notification) + Send + Sync + 'static,
     {
-        self.callbacks
-            .lock()
-            .unwrap()
-            .entry(event_type)
-            .or_default()
-            .push(Arc::new(callback));
+        self.add_handler(Some(event_type), Handler::Value(Arc::new(callback)));
     }
 
     /// Register a catch-all callback invoked for every received event.
@@ -1253,78 +2250,119 @@ impl NotificationListener {
     where
         F: Fn(&Notification) + Send + Sync + 'static,
     {
-        self.catch_all_callbacks
-            .lock()
-            .unwrap()
-            .push(Arc::new(callback));
+        self.add_handler(None, Handler::Value(Arc::new(callback)));
+    }
+
+    /// Register a callback for a specific event type that receives the event
+    /// decoded into an [`IviNotification`].
+    ///
+    /// Events are decoded into that struct without an intermediate `Value`;
+    /// prefer this over [`on`](Self::on) where events arrive at a high rate.
+    pub fn on_typed<F>(&mut self, event_type: EventType, callback: F)
+    where
+        F: Fn(&IviNotification) + Send + Sync + 'static,
+    {
+        self.add_handler(Some(event_type), Handler::Typed(Arc::new(callback)));
+    }
+
+    /// Register a typed catch-all callback invoked for every received event.
+    pub fn on_all_typed<F>(&mut self, callback: F)
+    where
+        F: Fn(&IviNotification) + Send + Sync + 'static,
+    {
+        self.add_handler(None, Handler::Typed(Arc::new(callback)));
+    }
+
+    /// Subscribe to the given event types on the server without starting
+    /// the background reader thread.
+    ///
+    /// Use this to drive the listener from an application event loop: watch
+    /// the descriptor from [`raw_fd`](Self::raw_fd) and call
+    /// [`dispatch`](Self::dispatch) when it becomes readable. Callbacks then
+    /// run on the thread calling `dispatch`. Call `dispatch` once right after
+    /// subscribing, since notifications may already have been read along with
+    /// the reply to the subscription.
+    pub fn subscribe(&mut self, event_types: &[EventType]) -> Result<()> {
+        self.send_rpc(
+            "subscribe",
+            json!({
+                "event_types": event_types,
+                "surface_ids": self.surface_ids,
+                "layer_ids": self.layer_ids,
+                "coalesce": self.coalesce
+            }),
+        )?;
+        Ok(())
     }
 
     /// Subscribe to the given event types on the server and start the
     /// background reader thread. Callbacks registered with `on`/`on_all`
     /// will fire from this thread.
+    ///
+    /// The thread blocks until a notification arrives or [`stop`](Self::stop)
+    /// wakes it, so an idle listener costs no CPU time.
     pub fn start(&mut self, event_types: &[EventType]) -> Result<()> {
-        self.send_rpc("subscribe", json!({ "event_types": event_types }))?;
+        self.subscribe(event_types)?;
 
         self.stop_flag.store(false, Ordering::Relaxed);
+        self.wake.clear();
 
         let transport = Arc::clone(&self.transport);
         let callbacks = Arc::clone(&self.callbacks);
-        let catch_all_callbacks = Arc::clone(&self.catch_all_callbacks);
         let stop_flag = Arc::clone(&self.stop_flag);
+        let wake = Arc::clone(&self.wake);
+        let socket_fd = transport.lock().unwrap().raw_fd();
 
-        self.thread_handle = Some(std::thread::spawn(move || {
-            loop {
-                if stop_flag.load(Ordering::Relaxed) {
-                    break;
-                }
-
-                let frame = {
-                    let mut t = transport.lock().unwrap();
-                    let _ = t.set_read_timeout(Some(Duration::from_millis(100)));
-                    let r = t.receive_response();
-                    let _ = t.set_read_timeout(None);
-                    r
-                };
-
-                match frame {
-                    Ok(bytes) => match Notification::try_from_frame(&bytes) {
-                        Ok(Some(notif)) => {
-                            // Clone Arc refs before dispatching to avoid holding the lock
-                            // while callbacks run.
-                            let per_type: Vec<NotificationCallback> = callbacks
-                                .lock()
-                                .unwrap()
-                                .get(&notif.event_type)
-                                .cloned()
-                                .unwrap_or_default();
-                            for cb in &per_type {
-                                cb(&notif);
-                            }
-                            let all: Vec<NotificationCallback> =
-                                catch_all_callbacks.lock().unwrap().clone();
-                            for cb in &all {
-                                cb(&notif);
-                            }
-                        }
-                        Ok(None) => {} // stray RPC response, skip
-                        Err(_) => {}   // parse error, skip
-                    },
-                    Err(IviError::IoError(ref e))
-                        if e.kind() == ErrorKind::WouldBlock || e.kind() == ErrorKind::TimedOut =>
-                    {
-                        continue; // timeout — check stop flag and retry
-                    }
-                    Err(_) => break, // real error — exit thread
-                }
-            }
+        self.thread_handle = Some(std::thread::spawn(move || match socket_fd {
+            Some(fd) => read_until_woken(fd, &wake, &transport, &callbacks),
+            None => read_until_stopped(&stop_flag, &transport, &callbacks),
         }));
 
         Ok(())
     }
 
+    /// Returns the file descriptor of the listener connection, for use in an
+    /// external event loop together with [`dispatch`](Self::dispatch).
+    ///
+    /// Returns `None` if the transport has no pollable descriptor.
+    pub fn raw_fd(&self) -> Option<RawFd> {
+        self.transport.lock().unwrap().raw_fd()
+    }
+
+    /// Runs callbacks for every notification that can be read without blocking.
+    ///
+    /// Returns the number of notifications dispatched. Only for listeners
+    /// set up with [`subscribe`](Self::subscribe); a listener whose background
+    /// thread is running is read by that thread alone.
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if the connection fails or the thread is running.
+    pub fn dispatch(&mut self) -> Result<usize> {
+        if self.is_running() {
+            return Err(IviError::IoError(std::io::Error::new(
+                ErrorKind::WouldBlock,
+                "Notifications are read by the listener thread",
+            )));
+        }
+
+        dispatch_available(&self.transport, &self.callbacks)
+    }
+
+    /// Whether the background thread is still reading notifications.
+    ///
+    /// Turns false after [`stop`](Self::stop) or when the connection to the
+    /// controller is lost.
+    pub fn is_running(&self) -> bool {
+        self.thread_handle
+            .as_ref()
+            .is_some_and(|handle| !handle.is_finished())
+    }
+
     /// Signal the background thread to stop and wait for it to finish.
     pub fn stop(&mut self) {
         self.stop_flag.store(true, Ordering::Relaxed);
+        self.wake.notify();
         if let Some(handle) = self.thread_handle.take() {
             let _ = handle.join();
         }
@@ -1338,3 +2376,97 @@ impl Drop for NotificationListener {
         let _ = t.disconnect();
     }
 }
+
+type SharedTransport = Mutex<Box<dyn IviClientTransport>>;
+
+/// Decode one frame and run its callbacks; returns false for non-notifications
+fn dispatch_notification(callbacks: &Mutex<Arc<CallbackTable>>, frame: &[u8]) -> bool {
+    match IviNotification::try_from_frame(frame) {
+        Ok(Some(event)) => {
+            // Dispatch from a snapshot so the lock is not held while
+            // callbacks run.
+            let table = Arc::clone(&callbacks.lock().unwrap());
+            table.dispatch(&event, frame);
+            true
+        }
+        Ok(None) => false, // stray RPC response, skip
+        Err(_) => false,   // parse error, skip
+    }
+}
+
+/// Dispatch every frame that can be read without blocking
+fn dispatch_available(
+    transport: &SharedTransport,
+    callbacks: &Mutex<Arc<CallbackTable>>,
+) -> Result<usize> {
+    let mut dispatched = 0;
+
+    loop {
+        // Locked per frame, so callbacks never run with the transport held
+        let frame = transport.lock().unwrap().try_receive_response()?;
+        match frame {
+            Some(bytes) => {
+                if dispatch_notification(callbacks, &bytes) {
+                    dispatched += 1;
+                }
+            }
+            None => return Ok(dispatched),
+        }
+    }
+}
+
+/// Reader thread body: sleep in poll(2) until the socket is readable or
+/// `wake` is signalled
+fn read_until_woken(
+    fd: RawFd,
+    wake: &WakeFd,
+    transport: &SharedTransport,
+    callbacks: &Mutex<Arc<CallbackTable>>,
+) {
+    loop {
+        // Frames read along with the subscription reply are already buffered,
+        // so drain before the first wait as well.
+        if dispatch_available(transport, callbacks).is_err() {
+            break; // connection lost
+        }
+
+        match wake.wait(fd) {
+            Ok(Wakeup::Readable) => {}
+            Ok(Wakeup::Woken) | Err(_) => break,
+        }
+    }
+}
+
+/// Reader thread body for transports without a pollable descriptor: read
+/// with a short timeout and check `stop_flag` in between
+fn read_until_stopped(
+    stop_flag: &AtomicBool,
+    transport: &SharedTransport,
+    callbacks: &Mutex<Arc<CallbackTable>>,
+) {
+    loop {
+        if stop_flag.load(Ordering::Relaxed) {
+            break;
+        }
+
+        let frame = {
+            let mut t = transport.lock().unwrap();
+            let _ = t.set_read_timeout(Some(Duration::from_millis(100)));
+            let r = t.receive_response();
+            let _ = t.set_read_timeout(None);
+            r
+        };
+
+        match frame {
+            Ok(bytes) => {
+                dispatch_notification(callbacks, &bytes);
+            }
+            Err(IviError::IoError(ref e))
+                if e.kind() == ErrorKind::WouldBlock || e.kind() == ErrorKind::TimedOut =>
+            {
+                continue; // timeout — check stop flag and retry
+            }
+            Err(_) => break, // real error — exit thread
+        }
+    }
+}
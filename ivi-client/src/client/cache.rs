@@ -0,0 +1,730 @@
+//! Local copy of the scene kept current by notifications.
+//!
+//! A [`SceneCache`] is loaded once with `get_changes_since` and then updated
+//! from the events a [`NotificationListener`] receives, so that
+//! [`IviClient`](super::IviClient) can answer `get_surface`, `get_layer` and
+//! `get_layer_surfaces` without a round trip. The cache falls back to
+//! `get_changes_since` whenever it cannot vouch for its contents:
+//!
+//! - after this client sent a change, until its response arrived and the
+//!   diff is fetched after it, so reads see the client's own writes;
+//! - after an event about an object it does not know;
+//! - from scratch when the sequence numbers of the notifications show a gap,
+//!   or the listener lost its connection.
+//!
+//! The controller announces no changes of layer rectangles, layer
+//! orientation or layer membership, so those made by other clients only show
+//! up after the next resync.
+
+use super::NotificationListener;
+use crate::error::Result;
+use crate::ffi::{IviLayer, IviOrientation, IviSurface, LayerId, Rectangle, SurfaceId};
+use crate::protocol::{EventType, Notification, SceneChanges};
+#[allow(unused)]
+use jlogger_tracing::{jdebug, jerror, jinfo, jtrace, jwarn};
+use serde::de::DeserializeOwned;
+use std::collections::HashMap;
+use std::sync::{Arc, Mutex};
+
+/// Methods that do not change the scene
+const READ_ONLY_METHODS: &[&str] = &[
+    "list_surfaces",
+    "get_surface",
+    "list_layers",
+    "get_layer",
+    "get_layer_surfaces",
+    "list_screens",
+    "get_screen",
+    "get_screen_layers",
+    "get_layer_screens",
+    "get_changes_since",
+    "get_metrics",
+    "subscribe",
+    "unsubscribe",
+    "list_subscriptions",
+    "handshake",
+];
+
+/// Methods that change which surfaces are on a layer
+const MEMBERSHIP_METHODS: &[&str] = &[
+    "set_layer_surfaces",
+    "add_surface_to_layer",
+    "remove_surface_from_layer",
+];
+
+/// How much has to be fetched before the cache can be trusted again
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord)]
+enum Resync {
+    /// Nothing, the cache is current
+    Current,
+    /// The diff since the cached generation
+    Changes,
+    /// The whole scene
+    Full,
+}
+
+/// Scene state tracked from notifications
+#[derive(Debug)]
+pub(crate) struct SceneCache {
+    surfaces: HashMap<SurfaceId, IviSurface>,
+    layers: HashMap<LayerId, IviLayer>,
+    /// Surfaces of each layer, for layers asked for since the last full resync
+    layer_surfaces: HashMap<LayerId, Vec<SurfaceId>>,
+    /// Scene generation the cache was last synchronized to
+    generation: u64,
+    resync: Resync,
+    /// Sequence number of the last notification received
+    last_seq: Option<u64>,
+    /// Notifications received while a resync is in flight, applied after it
+    buffered: Option<Vec<Notification>>,
+    /// Ids of the changes this client sent that were not answered yet
+    in_flight: Vec<u64>,
+}
+
+impl Default for SceneCache {
+    fn default() -> Self {
+        Self {
+            surfaces: HashMap::new(),
+            layers: HashMap::new(),
+            layer_surfaces: HashMap::new(),
+            generation: 0,
+            resync: Resync::Full,
+            last_seq: None,
+            buffered: None,
+            in_flight: Vec::new(),
+        }
+    }
+}
+
+impl SceneCache {
+    /// Whether lookups can be answered without fetching anything first
+    pub(crate) fn is_current(&self) -> bool {
+        self.resync == Resync::Current
+    }
+
+    /// Forget everything and load the whole scene on the next lookup
+    pub(crate) fn invalidate(&mut self) {
+        self.resync = Resync::Full;
+    }
+
+    /// Start over after the listener was restarted on a new connection
+    pub(crate) fn reset_sequence(&mut self) {
+        self.last_seq = None;
+        self.resync = Resync::Full;
+    }
+
+    fn require(&mut self, resync: Resync) {
+        self.resync = self.resync.max(resync);
+    }
+
+    /// Record a request this client sent, so its effects are fetched before
+    /// the next lookup instead of waiting for their notifications.
+    ///
+    /// The cache stays stale until [`note_response`](Self::note_response)
+    /// reports the answer: a diff fetched earlier may not hold the change yet.
+    pub(crate) fn note_request(&mut self, id: u64, method: &str) {
+        if READ_ONLY_METHODS.contains(&method) {
+            return;
+        }
+
+        if MEMBERSHIP_METHODS.contains(&method) {
+            self.layer_surfaces.clear();
+        }
+        self.in_flight.push(id);
+        self.require(Resync::Changes);
+    }
+
+    /// Record the response to request `id`, successful or not
+    pub(crate) fn note_response(&mut self, id: u64) {
+        if let Some(index) = self.in_flight.iter().position(|&i| i == id) {
+            self.in_flight.swap_remove(index);
+            // Fetch the diff again, one already running may predate the change
+            self.require(Resync::Changes);
+        }
+    }
+
+    /// Forget the requests in flight after their responses were lost with
+    /// the connection, and load the whole scene on the next lookup
+    pub(crate) fn requests_lost(&mut self) {
+        self.in_flight.clear();
+        self.invalidate();
+    }
+
+    /// Apply a notification, or hold it back until the running resync ends
+    pub(crate) fn on_notification(&mut self, notification: &Notification) {
+        if let Some(seq) = notification.seq() {
+            if self.last_seq.is_some_and(|last| seq != last + 1) {
+                jwarn!(
+                    "Notifications {}..{} were lost, reloading the scene",
+                    self.last_seq.unwrap() + 1,
+                    seq
+                );
+                self.require(Resync::Full);
+            }
+            self.last_seq = Some(seq);
+        }
+
+        match self.buffered.as_mut() {
+            Some(buffered) => buffered.push(notification.clone()),
+            None => self.apply(notification),
+        }
+    }
+
+    /// Start a resync; returns the generation to fetch changes since, or
+    /// None if the cache is current.
+    ///
+    /// While changes of this client are in flight the cache is not current
+    /// after the resync either, and lookups keep fetching the diff.
+    ///
+    /// Notifications received until [`finish_resync`](Self::finish_resync) or
+    /// [`abort_resync`](Self::abort_resync) are buffered and applied on top of
+    /// the fetched scene.
+    pub(crate) fn begin_resync(&mut self) -> Option<u64> {
+        let generation = match self.resync {
+            Resync::Current => return None,
+            Resync::Changes => self.generation,
+            Resync::Full => 0,
+        };
+
+        self.resync = if self.in_flight.is_empty() {
+            Resync::Current
+        } else {
+            Resync::Changes
+        };
+        self.buffered.get_or_insert_with(Vec::new);
+        Some(generation)
+    }
+
+    /// Apply the result of the fetch started with `begin_resync`
+    pub(crate) fn finish_resync(&mut self, changes: SceneChanges) {
+        if changes.full {
+            self.surfaces.clear();
+            self.layers.clear();
+            self.layer_surfaces.clear();
+        }
+
+        for id in &changes.removed_surfaces {
+            self.remove_surface(*id);
+        }
+        for id in &changes.removed_layers {
+            self.remove_layer(*id);
+        }
+        for surface in changes.surfaces {
+            self.surfaces.insert(surface.id, surface);
+        }
+        for layer in changes.layers {
+            self.layers.insert(layer.id, layer);
+        }
+        self.generation = changes.generation;
+
+        self.replay_buffered();
+    }
+
+    /// End a resync whose fetch failed, so it is retried on the next lookup
+    pub(crate) fn abort_resync(&mut self, generation: u64) {
+        self.require(if generation == 0 {
+            Resync::Full
+        } else {
+            Resync::Changes
+        });
+        self.replay_buffered();
+    }
+
+    fn replay_buffered(&mut self) {
+        for notification in self.buffered.take().unwrap_or_default() {
+            self.apply(&notification);
+        }
+    }
+
+    pub(crate) fn surface(&self, id: SurfaceId) -> Option<IviSurface> {
+        self.surfaces.get(&id).cloned()
+    }
+
+    pub(crate) fn layer(&self, id: LayerId) -> Option<IviLayer> {
+        self.layers.get(&id).cloned()
+    }
+
+    pub(crate) fn layer_surfaces(&self, id: LayerId) -> Option<Vec<SurfaceId>> {
+        self.layer_surfaces.get(&id).cloned()
+    }
+
+    /// Remember the surfaces of a layer fetched from the controller
+    pub(crate) fn store_layer_surfaces(&mut self, id: LayerId, surface_ids: Vec<SurfaceId>) {
+        if self.layers.contains_key(&id) {
+            self.layer_surfaces.insert(id, surface_ids);
+        }
+    }
+
+    fn remove_surface(&mut self, id: SurfaceId) {
+        self.surfaces.remove(&id);
+        for surface_ids in self.layer_surfaces.values_mut() {
+            surface_ids.retain(|surface_id| *surface_id != id);
+        }
+    }
+
+    fn remove_layer(&mut self, id: LayerId) {
+        self.layers.remove(&id);
+        self.layer_surfaces.remove(&id);
+    }
+
+    fn apply(&mut self, notification: &Notification) {
+        let params = &notification.params;
+        let field = |name: &str| params.get(name).and_then(|v| v.as_u64()).map(|v| v as u32);
+
+        match notification.event_type {
+            EventType::SurfaceCreated => {
+                // The event carries no properties, so they are fetched
+                if let Some(id) = field("surface_id") {
+                    if !self.surfaces.contains_key(&id) {
+                        self.require(Resync::Changes);
+                    }
+                }
+            }
+            EventType::SurfaceDestroyed => {
+                if let Some(id) = field("surface_id") {
+                    self.remove_surface(id);
+                }
+            }
+            EventType::LayerCreated => {
+                if let Some(id) = field("layer_id") {
+                    if !self.layers.contains_key(&id) {
+                        self.require(Resync::Changes);
+                    }
+                }
+            }
+            EventType::LayerDestroyed => {
+                if let Some(id) = field("layer_id") {
+                    self.remove_layer(id);
+                }
+            }
+            EventType::LayerVisibilityChanged | EventType::LayerOpacityChanged => {
+                let Some(layer) = field("layer_id").and_then(|id| self.layers.get_mut(&id)) else {
+                    self.require(Resync::Changes);
+                    return;
+                };
+                if !update_layer(layer, notification) {
+                    self.require(Resync::Changes);
+                }
+            }
+            EventType::FocusChanged | EventType::AnimationCompleted => {}
+            _ => {
+                let Some(surface) = field("surface_id").and_then(|id| self.surfaces.get_mut(&id))
+                else {
+                    self.require(Resync::Changes);
+                    return;
+                };
+                if !update_surface(surface, notification) {
+                    self.require(Resync::Changes);
+                }
+            }
+        }
+    }
+}
+
+fn new_value<T: DeserializeOwned>(notification: &Notification, name: &str) -> Option<T> {
+    serde_json::from_value(notification.params.get(name)?.clone()).ok()
+}
+
+/// Apply a surface property change; false if the event could not be read
+fn update_surface(surface: &mut IviSurface, notification: &Notification) -> bool {
+    match notification.event_type {
+        EventType::SurfaceContentReady => {
+            let (Some(width), Some(height)) = (
+                new_value(notification, "width"),
+                new_value(notification, "height"),
+            ) else {
+                return false;
+            };
+            surface.orig_size.width = width;
+            surface.orig_size.height = height;
+        }
+        EventType::SurfaceContentSizeChanged => {
+            let (Some(width), Some(height)) = (
+                new_value(notification, "new_width"),
+                new_value(notification, "new_height"),
+            ) else {
+                return false;
+            };
+            surface.orig_size.width = width;
+            surface.orig_size.height = height;
+        }
+        EventType::SourceGeometryChanged => {
+            let Some(rect) = new_value::<Rectangle>(notification, "new_rect") else {
+                return false;
+            };
+            surface.src_rect = rect;
+        }
+        EventType::DestinationGeometryChanged => {
+            let Some(rect) = new_value::<Rectangle>(notification, "new_rect") else {
+                return false;
+            };
+            surface.dest_rect = rect;
+        }
+        EventType::VisibilityChanged => {
+            let Some(visibility) = new_value(notification, "new_visibility") else {
+                return false;
+            };
+            surface.visibility = visibility;
+        }
+        EventType::OpacityChanged => {
+            let Some(opacity) = new_value(notification, "new_opacity") else {
+                return false;
+            };
+            surface.opacity = opacity;
+        }
+        EventType::OrientationChanged => {
+            let Some(orientation) = new_value::<IviOrientation>(notification, "new_orientation")
+            else {
+                return false;
+            };
+            surface.orientation = orientation;
+        }
+        EventType::ZOrderChanged => {
+            let Some(z_order) = new_value(notification, "new_z_order") else {
+                return false;
+            };
+            surface.z_order = z_order;
+        }
+        _ => return false,
+    }
+    true
+}
+
+/// Apply a layer property change; false if the event could not be read
+fn update_layer(layer: &mut IviLayer, notification: &Notification) -> bool {
+    match notification.event_type {
+        EventType::LayerVisibilityChanged => {
+            let Some(visibility) = new_value(notification, "new_visibility") else {
+                return false;
+            };
+            layer.visibility = visibility;
+        }
+        EventType::LayerOpacityChanged => {
+            let Some(opacity) = new_value(notification, "new_opacity") else {
+                return false;
+            };
+            layer.opacity = opacity;
+        }
+        _ => return false,
+    }
+    true
+}
+
+/// Scene cache of an [`IviClient`](super::IviClient) and the listener feeding it
+pub(crate) struct ClientCache {
+    scene: Arc<Mutex<SceneCache>>,
+    listener: NotificationListener,
+    remote: Option<String>,
+}
+
+impl ClientCache {
+    /// Connect a listener for every event and start with an empty cache
+    pub(crate) fn start(remote: Option<&str>) -> Result<Self> {
+        let scene = Arc::new(Mutex::new(SceneCache::default()));
+        let listener = Self::listen(remote, &scene)?;
+
+        Ok(Self {
+            scene,
+            listener,
+            remote: remote.map(str::to_string),
+        })
+    }
+
+    fn listen(
+        remote: Option<&str>,
+        scene: &Arc<Mutex<SceneCache>>,
+    ) -> Result<NotificationListener> {
+        let mut listener = NotificationListener::new(remote)?;
+        let scene = Arc::clone(scene);
+        listener.on_all(move |notification| scene.lock().unwrap().on_notification(notification));
+
+        // Every event of every object, uncoalesced, so sequence numbers have no gaps
+        listener.start(&EventType::ALL)?;
+        Ok(listener)
+    }
+
+    pub(crate) fn scene(&self) -> &Arc<Mutex<SceneCache>> {
+        &self.scene
+    }
+
+    /// Reconnect the listener if it lost its connection
+    ///
+    /// Events may have been missed meanwhile, so the scene is fetched again.
+    pub(crate) fn ensure_listener(&mut self) -> Result<()> {
+        if self.listener.is_running() {
+            return Ok(());
+        }
+
+        jinfo!("Notification listener stopped, reconnecting the scene cache");
+        self.listener = Self::listen(self.remote.as_deref(), &self.scene)?;
+        self.scene.lock().unwrap().reset_sequence();
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::IviSize;
+    use serde_json::{json, Value};
+
+    fn surface(id: u32) -> IviSurface {
+        IviSurface {
+            id,
+            orig_size: IviSize {
+                width: 1920,
+                height: 1080,
+            },
+            src_rect: Rectangle {
+                x: 0,
+                y: 0,
+                width: 1920,
+                height: 1080,
+            },
+            dest_rect: Rectangle {
+                x: 0,
+                y: 0,
+                width: 960,
+                height: 540,
+            },
+            visibility: false,
+            opacity: 1.0,
+            orientation: IviOrientation::Normal,
+            z_order: 0,
+        }
+    }
+
+    fn layer(id: u32) -> IviLayer {
+        IviLayer {
+            id,
+            src_rect: Rectangle {
+                x: 0,
+                y: 0,
+                width: 1920,
+                height: 1080,
+            },
+            dest_rect: Rectangle {
+                x: 0,
+                y: 0,
+                width: 1920,
+                height: 1080,
+            },
+            visibility: true,
+            opacity: 1.0,
+            orientation: IviOrientation::Normal,
+        }
+    }
+
+    fn notification(event_type: EventType, seq: u64, mut params: Value) -> Notification {
+        params["seq"] = json!(seq);
+        Notification { event_type, params }
+    }
+
+    fn loaded() -> SceneCache {
+        let mut cache = SceneCache::default();
+        assert_eq!(cache.begin_resync(), Some(0));
+        cache.finish_resync(SceneChanges {
+            generation: 10,
+            full: true,
+            surfaces: vec![surface(1000), surface(1001)],
+            layers: vec![layer(5000)],
+            removed_surfaces: vec![],
+            removed_layers: vec![],
+        });
+        cache.store_layer_surfaces(5000, vec![1000, 1001]);
+        assert!(cache.is_current());
+        cache
+    }
+
+    #[test]
+    fn test_applies_property_changes() {
+        let mut cache = loaded();
+
+        cache.on_notification(&notification(
+            EventType::DestinationGeometryChanged,
+            1,
+            json!({
+                "surface_id": 1000,
+                "old_rect": { "x": 0, "y": 0, "width": 960, "height": 540 },
+                "new_rect": { "x": 10, "y": 20, "width": 480, "height": 270 }
+            }),
+        ));
+        cache.on_notification(&notification(
+            EventType::VisibilityChanged,
+            2,
+            json!({ "surface_id": 1000, "old_visibility": false, "new_visibility": true }),
+        ));
+        cache.on_notification(&notification(
+            EventType::OrientationChanged,
+            3,
+            json!({ "surface_id": 1000, "old_orientation": "Normal", "new_orientation": "Rotate90" }),
+        ));
+        cache.on_notification(&notification(
+            EventType::LayerOpacityChanged,
+            4,
+            json!({ "layer_id": 5000, "old_opacity": 1.0, "new_opacity": 0.5 }),
+        ));
+
+        let changed = cache.surface(1000).unwrap();
+        assert_eq!(changed.dest_rect.x, 10);
+        assert_eq!(changed.dest_rect.width, 480);
+        assert!(changed.visibility);
+        assert_eq!(changed.orientation, IviOrientation::Rotate90);
+        assert_eq!(cache.layer(5000).unwrap().opacity, 0.5);
+        assert!(cache.is_current());
+    }
+
+    #[test]
+    fn test_lifecycle_events() {
+        let mut cache = loaded();
+
+        cache.on_notification(&notification(
+            EventType::SurfaceDestroyed,
+            1,
+            json!({ "surface_id": 1000 }),
+        ));
+        assert!(cache.surface(1000).is_none());
+        assert_eq!(cache.layer_surfaces(5000), Some(vec![1001]));
+        assert!(cache.is_current());
+
+        // A new surface has to be fetched
+        cache.on_notification(&notification(
+            EventType::SurfaceCreated,
+            2,
+            json!({ "surface_id": 1002 }),
+        ));
+        assert!(!cache.is_current());
+        assert_eq!(cache.begin_resync(), Some(10));
+        cache.finish_resync(SceneChanges {
+            generation: 12,
+            full: false,
+            surfaces: vec![surface(1002)],
+            layers: vec![],
+            removed_surfaces: vec![],
+            removed_layers: vec![5000],
+        });
+        assert!(cache.surface(1002).is_some());
+        assert!(cache.surface(1001).is_some());
+        assert!(cache.layer(5000).is_none());
+        assert!(cache.layer_surfaces(5000).is_none());
+    }
+
+    #[test]
+    fn test_sequence_gap_reloads_the_scene() {
+        let mut cache = loaded();
+
+        cache.on_notification(&notification(
+            EventType::OpacityChanged,
+            7,
+            json!({ "surface_id": 1000, "old_opacity": 1.0, "new_opacity": 0.5 }),
+        ));
+        assert!(cache.is_current());
+
+        cache.on_notification(&notification(
+            EventType::OpacityChanged,
+            9,
+            json!({ "surface_id": 1000, "old_opacity": 0.5, "new_opacity": 0.25 }),
+        ));
+        assert!(!cache.is_current());
+        assert_eq!(cache.begin_resync(), Some(0));
+    }
+
+    #[test]
+    fn test_buffers_notifications_during_resync() {
+        let mut cache = loaded();
+        cache.note_request(1, "set_surface_opacity");
+        cache.note_response(1);
+        assert_eq!(cache.begin_resync(), Some(10));
+
+        // Arrives while the diff is being fetched and is newer than it
+        cache.on_notification(&notification(
+            EventType::OpacityChanged,
+            1,
+            json!({ "surface_id": 1001, "old_opacity": 0.5, "new_opacity": 0.25 }),
+        ));
+        assert_eq!(cache.surface(1001).unwrap().opacity, 1.0);
+
+        let mut fetched = surface(1001);
+        fetched.opacity = 0.5;
+        cache.finish_resync(SceneChanges {
+            generation: 11,
+            full: false,
+            surfaces: vec![fetched],
+            layers: vec![],
+            removed_surfaces: vec![],
+            removed_layers: vec![],
+        });
+        assert_eq!(cache.surface(1001).unwrap().opacity, 0.25);
+        assert!(cache.is_current());
+
+        // A failed fetch is retried from the same generation
+        cache.note_request(2, "commit");
+        cache.note_response(2);
+        assert_eq!(cache.begin_resync(), Some(11));
+        cache.abort_resync(11);
+        assert_eq!(cache.begin_resync(), Some(11));
+    }
+
+    #[test]
+    fn test_note_request() {
+        let mut cache = loaded();
+
+        cache.note_request(1, "get_surface");
+        cache.note_request(2, "list_layers");
+        assert!(cache.is_current());
+
+        cache.note_request(3, "add_surface_to_layer");
+        assert!(!cache.is_current());
+        assert!(cache.layer_surfaces(5000).is_none());
+    }
+
+    #[test]
+    fn test_resync_during_a_change_leaves_the_cache_stale() {
+        let mut cache = loaded();
+        cache.note_request(1, "set_surface_opacity");
+
+        // The diff is fetched before the controller applied the change
+        assert_eq!(cache.begin_resync(), Some(10));
+        cache.finish_resync(SceneChanges {
+            generation: 10,
+            full: false,
+            surfaces: vec![],
+            layers: vec![],
+            removed_surfaces: vec![],
+            removed_layers: vec![],
+        });
+        assert!(!cache.is_current());
+
+        // A resync ending after the response arrived is fetched again
+        assert_eq!(cache.begin_resync(), Some(10));
+        cache.note_response(1);
+        cache.finish_resync(SceneChanges {
+            generation: 10,
+            full: false,
+            surfaces: vec![],
+            layers: vec![],
+            removed_surfaces: vec![],
+            removed_layers: vec![],
+        });
+        assert!(!cache.is_current());
+
+        let mut fetched = surface(1001);
+        fetched.opacity = 0.5;
+        assert_eq!(cache.begin_resync(), Some(10));
+        cache.finish_resync(SceneChanges {
+            generation: 11,
+            full: false,
+            surfaces: vec![fetched],
+            layers: vec![],
+            removed_surfaces: vec![],
+            removed_layers: vec![],
+        });
+        assert!(cache.is_current());
+        assert_eq!(cache.surface(1001).unwrap().opacity, 0.5);
+
+        // Responses lost with the connection are not waited for
+        cache.note_request(2, "set_surface_visibility");
+        cache.requests_lost();
+        assert_eq!(cache.begin_resync(), Some(0));
+    }
+}
@@ -0,0 +1,426 @@
+//! Decoding of list responses straight into caller memory.
+//!
+//! The regular request path parses each response into a `serde_json::Value`
+//! and converts that into owned Rust types. The `*_into` methods of
+//! [`IviClient`](super::IviClient) instead walk the response frame once and
+//! hand every element of the list to a sink as it is parsed, so a successful
+//! call allocates nothing.
+
+use crate::error::{IviError, Result};
+use crate::protocol::JsonRpcError;
+use serde::de::{self, DeserializeOwned, DeserializeSeed, IgnoredAny, MapAccess, SeqAccess};
+use serde::ser::SerializeMap;
+use serde::{Deserialize, Deserializer, Serialize, Serializer};
+use std::cell::Cell;
+use std::fmt;
+use std::marker::PhantomData;
+
+/// Request without parameters, serialized without building a `Value`
+#[derive(Serialize)]
+pub(crate) struct BareRequest<'a> {
+    pub id: u64,
+    pub method: &'a str,
+    pub params: NoParams,
+}
+
+/// Empty `params` object
+pub(crate) struct NoParams;
+
+impl Serialize for NoParams {
+    fn serialize<S: Serializer>(&self, serializer: S) -> std::result::Result<S::Ok, S::Error> {
+        serializer.serialize_map(Some(0))?.end()
+    }
+}
+
+/// Decodes `frame` if it is the response to `request_id`, passing each
+/// element of the `key` list of its result to `sink` with its index.
+///
+/// Returns the number of elements, or None if the frame is a notification
+/// or the response to another request. The frame is parsed once when its
+/// `id` precedes its `result`, as the controller writes it, and twice
+/// otherwise.
+pub(crate) fn decode_list<E, F>(
+    frame: &[u8],
+    request_id: u64,
+    key: &str,
+    mut sink: F,
+) -> Option<Result<usize>>
+where
+    E: DeserializeOwned,
+    F: FnMut(usize, E),
+{
+    let matched = Cell::new(None);
+    let mut response = parse_response(frame, request_id, false, key, &mut sink, &matched);
+
+    if matched.get() != Some(true) {
+        return None;
+    }
+
+    // The result came before the id and was skipped
+    if let Ok(Response::Skipped) = response {
+        response = parse_response(frame, request_id, true, key, &mut sink, &matched);
+    }
+
+    Some(match response {
+        Ok(Response::Result(Some(count))) => Ok(count),
+        Ok(Response::Result(None)) => Err(IviError::DeserializationError(format!(
+            "Missing '{}' field in response",
+            key
+        ))),
+        Ok(Response::Error(error)) => Err(IviError::RequestFailed {
+            code: error.code,
+            message: error.message,
+        }),
+        Ok(Response::Empty | Response::Skipped) => Err(IviError::DeserializationError(
+            "Response missing both result and error".to_string(),
+        )),
+        Err(e) => Err(IviError::DeserializationError(format!(
+            "Failed to parse {}: {}",
+            key, e
+        ))),
+    })
+}
+
+fn parse_response<E, F>(
+    frame: &[u8],
+    request_id: u64,
+    id_known: bool,
+    key: &str,
+    sink: F,
+    matched: &Cell<Option<bool>>,
+) -> serde_json::Result<Response>
+where
+    E: DeserializeOwned,
+    F: FnMut(usize, E),
+{
+    let seed = ResponseSeed {
+        request_id,
+        id_known,
+        matched,
+        result: ResultSeed {
+            key,
+            list: ListSeed {
+                sink,
+                element: PhantomData,
+            },
+        },
+    };
+
+    let mut deserializer = serde_json::Deserializer::from_slice(frame);
+    let response = seed.deserialize(&mut deserializer)?;
+    deserializer.end()?;
+    Ok(response)
+}
+
+enum Response {
+    /// Number of list elements, None if the result had no such list
+    Result(Option<usize>),
+    Error(JsonRpcError),
+    /// The result was skipped because the id was not known yet
+    Skipped,
+    Empty,
+}
+
+#[derive(Deserialize)]
+#[serde(field_identifier, rename_all = "lowercase")]
+enum ResponseField {
+    Id,
+    Result,
+    Error,
+    #[serde(other)]
+    Other,
+}
+
+/// Top-level response object
+///
+/// Whether its `id` is `request_id` is recorded in `matched` as soon as it
+/// is read, so that a parse error can still be told apart from a frame for
+/// someone else.
+struct ResponseSeed<'a, F, E> {
+    request_id: u64,
+    /// Decode the result even before the id was read
+    id_known: bool,
+    matched: &'a Cell<Option<bool>>,
+    result: ResultSeed<'a, F, E>,
+}
+
+impl<'de, F, E> DeserializeSeed<'de> for ResponseSeed<'_, F, E>
+where
+    E: DeserializeOwned,
+    F: FnMut(usize, E),
+{
+    type Value = Response;
+
+    fn deserialize<D: Deserializer<'de>>(
+        self,
+        deserializer: D,
+    ) -> std::result::Result<Response, D::Error> {
+        deserializer.deserialize_map(self)
+    }
+}
+
+impl<'de, F, E> de::Visitor<'de> for ResponseSeed<'_, F, E>
+where
+    E: DeserializeOwned,
+    F: FnMut(usize, E),
+{
+    type Value = Response;
+
+    fn expecting(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.write_str("a JSON-RPC response")
+    }
+
+    fn visit_map<A: MapAccess<'de>>(self, mut map: A) -> std::result::Result<Response, A::Error> {
+        let mut result = Some(self.result);
+        let mut response = Response::Empty;
+
+        while let Some(field) = map.next_key::<ResponseField>()? {
+            match field {
+                ResponseField::Id => {
+                    let id: Option<u64> = map.next_value()?;
+                    self.matched.set(Some(id == Some(self.request_id)));
+                }
+                ResponseField::Result => {
+                    let ours = self.id_known || self.matched.get() == Some(true);
+                    match result.take() {
+                        Some(seed) if ours => {
+                            response = Response::Result(map.next_value_seed(seed)?);
+                        }
+                        Some(_) => {
+                            map.next_value::<IgnoredAny>()?;
+                            response = Response::Skipped;
+                        }
+                        None => return Err(de::Error::duplicate_field("result")),
+                    }
+                }
+                ResponseField::Error => {
+                    let error: Option<JsonRpcError> = map.next_value()?;
+                    if let Some(error) = error {
+                        response = Response::Error(error);
+                    }
+                }
+                ResponseField::Other => {
+                    map.next_value::<IgnoredAny>()?;
+                }
+            }
+        }
+
+        Ok(response)
+    }
+}
+
+/// `result` object holding the list under `key`
+struct ResultSeed<'k, F, E> {
+    key: &'k str,
+    list: ListSeed<F, E>,
+}
+
+impl<'de, F, E> DeserializeSeed<'de> for ResultSeed<'_, F, E>
+where
+    E: DeserializeOwned,
+    F: FnMut(usize, E),
+{
+    type Value = Option<usize>;
+
+    fn deserialize<D: Deserializer<'de>>(
+        self,
+        deserializer: D,
+    ) -> std::result::Result<Self::Value, D::Error> {
+        deserializer.deserialize_map(self)
+    }
+}
+
+impl<'de, F, E> de::Visitor<'de> for ResultSeed<'_, F, E>
+where
+    E: DeserializeOwned,
+    F: FnMut(usize, E),
+{
+    type Value = Option<usize>;
+
+    fn expecting(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "a result object with '{}'", self.key)
+    }
+
+    fn visit_map<A: MapAccess<'de>>(
+        self,
+        mut map: A,
+    ) -> std::result::Result<Self::Value, A::Error> {
+        let mut list = Some(self.list);
+        let mut count = None;
+
+        while let Some(matched) = map.next_key_seed(KeyIs(self.key))? {
+            match (matched, list.take()) {
+                (true, Some(seed)) => count = Some(map.next_value_seed(seed)?),
+                (true, None) => return Err(de::Error::duplicate_field("list")),
+                (false, seed) => {
+                    list = seed;
+                    map.next_value::<IgnoredAny>()?;
+                }
+            }
+        }
+
+        Ok(count)
+    }
+}
+
+/// Map key compared against an expected name, without copying it
+struct KeyIs<'k>(&'k str);
+
+impl<'de> DeserializeSeed<'de> for KeyIs<'_> {
+    type Value = bool;
+
+    fn deserialize<D: Deserializer<'de>>(
+        self,
+        deserializer: D,
+    ) -> std::result::Result<bool, D::Error> {
+        deserializer.deserialize_str(self)
+    }
+}
+
+impl<'de> de::Visitor<'de> for KeyIs<'_> {
+    type Value = bool;
+
+    fn expecting(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.write_str("a field name")
+    }
+
+    fn visit_str<Err: de::Error>(self, key: &str) -> std::result::Result<bool, Err> {
+        Ok(key == self.0)
+    }
+}
+
+/// The list itself, handed to the sink element by element
+struct ListSeed<F, E> {
+    sink: F,
+    element: PhantomData<fn() -> E>,
+}
+
+impl<'de, F, E> DeserializeSeed<'de> for ListSeed<F, E>
+where
+    E: DeserializeOwned,
+    F: FnMut(usize, E),
+{
+    type Value = usize;
+
+    fn deserialize<D: Deserializer<'de>>(
+        self,
+        deserializer: D,
+    ) -> std::result::Result<usize, D::Error> {
+        deserializer.deserialize_seq(self)
+    }
+}
+
+impl<'de, F, E> de::Visitor<'de> for ListSeed<F, E>
+where
+    E: DeserializeOwned,
+    F: FnMut(usize, E),
+{
+    type Value = usize;
+
+    fn expecting(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.write_str("a list")
+    }
+
+    fn visit_seq<A: SeqAccess<'de>>(mut self, mut seq: A) -> std::result::Result<usize, A::Error> {
+        let mut count = 0;
+        while let Some(element) = seq.next_element::<E>()? {
+            (self.sink)(count, element);
+            count += 1;
+        }
+        Ok(count)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::IviLayer;
+    use serde_json::json;
+
+    fn layer(id: u32) -> serde_json::Value {
+        json!({
+            "id": id,
+            "src_rect": { "x": 0, "y": 0, "width": 1920, "height": 1080 },
+            "dest_rect": { "x": 0, "y": 0, "width": 960, "height": 540 },
+            "visibility": true,
+            "opacity": 0.5,
+            "orientation": "Rotate90",
+            "extra": [1, 2, 3]
+        })
+    }
+
+    #[test]
+    fn test_request_matches_json_rpc_request() {
+        let request = BareRequest {
+            id: 7,
+            method: "list_layers",
+            params: NoParams,
+        };
+        assert_eq!(
+            serde_json::to_value(&request).unwrap(),
+            serde_json::to_value(crate::protocol::JsonRpcRequest::new(
+                7,
+                "list_layers",
+                json!({})
+            ))
+            .unwrap()
+        );
+    }
+
+    #[test]
+    fn test_decode_list() {
+        let layers = serde_json::to_string(&json!([layer(1), layer(2), layer(3)])).unwrap();
+
+        // Order of the fields and unknown fields do not matter
+        for frame in [
+            format!(
+                r#"{{"id": 3, "result": {{"before": {{}}, "layers": {}, "after": 1}}}}"#,
+                layers
+            ),
+            format!(r#"{{"result": {{"layers": {}}}, "id": 3}}"#, layers),
+        ] {
+            let mut ids = [0u32; 2];
+            let count = decode_list(frame.as_bytes(), 3, "layers", |i, layer: IviLayer| {
+                if let Some(slot) = ids.get_mut(i) {
+                    *slot = layer.id;
+                }
+            });
+            assert_eq!(count.unwrap().unwrap(), 3);
+            assert_eq!(ids, [1, 2]);
+        }
+    }
+
+    #[test]
+    fn test_other_frames_are_not_decoded() {
+        let sink = |_: usize, _: IviLayer| panic!("decoded a frame for someone else");
+
+        let frame = br#"{"id": 4, "result": {"layers": [{"id": 1}]}}"#;
+        assert!(decode_list(frame, 3, "layers", sink).is_none());
+        let frame = br#"{"method": "notification", "params": {"layer_id": 1}}"#;
+        assert!(decode_list(frame, 3, "layers", sink).is_none());
+        assert!(decode_list(b"not json", 3, "layers", sink).is_none());
+    }
+
+    #[test]
+    fn test_decode_list_errors() {
+        let sink = |_: usize, _: IviLayer| {};
+
+        let frame = br#"{"id": 1, "error": {"code": -32000, "message": "No layers"}}"#;
+        assert!(matches!(
+            decode_list(frame, 1, "layers", sink),
+            Some(Err(IviError::RequestFailed { code: -32000, .. }))
+        ));
+
+        let frame = br#"{"id": 1, "result": {"surfaces": []}}"#;
+        assert!(matches!(
+            decode_list(frame, 1, "layers", sink),
+            Some(Err(IviError::DeserializationError(_)))
+        ));
+
+        let frame = br#"{"id": 1, "result": {"layers": [{"id": 1}]}}"#;
+        assert!(matches!(
+            decode_list(frame, 1, "layers", sink),
+            Some(Err(IviError::DeserializationError(_)))
+        ));
+    }
+}
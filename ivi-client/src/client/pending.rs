@@ -0,0 +1,213 @@
+//! Correlation of in-flight requests with their responses.
+//!
+//! Every request written by [`IviClient`](crate::IviClient) is recorded here
+//! under its JSON-RPC `id`. When a response frame arrives, in whatever order,
+//! the matching entry is completed: either a callback is invoked or a
+//! [`PendingResponse`] handle is filled in.
+
+use crate::error::{IviError, Result};
+use crate::protocol::JsonRpcResponse;
+use serde_json::Value;
+use std::collections::HashMap;
+use std::future::Future;
+use std::pin::Pin;
+use std::sync::{Arc, Mutex};
+use std::task::{Context, Poll, Waker};
+
+/// Callback invoked with the id and result of a pipelined request.
+pub type ResponseCallback = Box<dyn FnOnce(u64, Result<Value>) + Send + 'static>;
+
+#[derive(Default)]
+struct SlotState {
+    result: Option<Result<Value>>,
+    waker: Option<Waker>,
+}
+
+type Slot = Arc<Mutex<SlotState>>;
+
+/// Handle to the response of a pipelined request.
+///
+/// The handle is completed while the client processes incoming frames, in
+/// [`IviClient::poll`](crate::IviClient::poll) or
+/// [`IviClient::wait`](crate::IviClient::wait). It also implements
+/// [`Future`], so it can be awaited from an executor that drives `poll` when
+/// the client's file descriptor becomes readable.
+pub struct PendingResponse {
+    id: u64,
+    slot: Slot,
+}
+
+impl PendingResponse {
+    /// The JSON-RPC id of the request.
+    pub fn id(&self) -> u64 {
+        self.id
+    }
+
+    /// Returns true once the response has arrived.
+    pub fn is_ready(&self) -> bool {
+        self.slot.lock().unwrap().result.is_some()
+    }
+
+    /// Takes the result if the response has arrived.
+    pub fn try_take(&self) -> Option<Result<Value>> {
+        self.slot.lock().unwrap().result.take()
+    }
+}
+
+impl Future for PendingResponse {
+    type Output = Result<Value>;
+
+    fn poll(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Self::Output> {
+        let mut state = self.slot.lock().unwrap();
+        match state.result.take() {
+            Some(result) => Poll::Ready(result),
+            None => {
+                state.waker = Some(cx.waker().clone());
+                Poll::Pending
+            }
+        }
+    }
+}
+
+enum Completion {
+    Callback(ResponseCallback),
+    Slot(Slot),
+}
+
+impl Completion {
+    fn complete(self, id: u64, result: Result<Value>) {
+        match self {
+            Completion::Callback(callback) => callback(id, result),
+            Completion::Slot(slot) => {
+                let waker = {
+                    let mut state = slot.lock().unwrap();
+                    state.result = Some(result);
+                    state.waker.take()
+                };
+                if let Some(waker) = waker {
+                    waker.wake();
+                }
+            }
+        }
+    }
+}
+
+/// Table of requests that have been written but not yet answered.
+#[derive(Default)]
+pub(crate) struct PendingRequests {
+    requests: HashMap<u64, Completion>,
+}
+
+impl PendingRequests {
+    /// Track a request whose result is delivered to `callback`
+    pub fn insert_callback(&mut self, id: u64, callback: ResponseCallback) {
+        self.requests.insert(id, Completion::Callback(callback));
+    }
+
+    /// Track a request whose result is delivered to the returned handle
+    pub fn insert_handle(&mut self, id: u64) -> PendingResponse {
+        let slot = Slot::default();
+        self.requests
+            .insert(id, Completion::Slot(Arc::clone(&slot)));
+        PendingResponse { id, slot }
+    }
+
+    /// Forget a request that could not be sent
+    pub fn remove(&mut self, id: u64) {
+        self.requests.remove(&id);
+    }
+
+    /// Complete the request answered by `response` (returns false if it is unknown)
+    pub fn complete(&mut self, response: JsonRpcResponse) -> bool {
+        match self.requests.remove(&response.id) {
+            Some(completion) => {
+                completion.complete(response.id, response_result(response));
+                true
+            }
+            None => false,
+        }
+    }
+
+    /// Fail every outstanding request, e.g. after the connection was lost
+    pub fn fail_all(&mut self, reason: &str) {
+        for (id, completion) in self.requests.drain() {
+            completion.complete(id, Err(IviError::ConnectionFailed(reason.to_string())));
+        }
+    }
+
+    /// Returns true if `id` is still waiting for its response
+    pub fn contains(&self, id: u64) -> bool {
+        self.requests.contains_key(&id)
+    }
+
+    pub fn len(&self) -> usize {
+        self.requests.len()
+    }
+}
+
+/// Convert a response into the result of its request
+fn response_result(response: JsonRpcResponse) -> Result<Value> {
+    if let Some(error) = response.error {
+        return Err(IviError::RequestFailed {
+            code: error.code,
+            message: error.message,
+        });
+    }
+
+    response.result.ok_or_else(|| {
+        IviError::DeserializationError("Response missing both result and error".to_string())
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::protocol::JsonRpcError;
+    use serde_json::json;
+
+    #[test]
+    fn test_out_of_order_completion() {
+        let mut pending = PendingRequests::default();
+        let first = pending.insert_handle(1);
+        let second = pending.insert_handle(2);
+
+        let called = Arc::new(Mutex::new(None));
+        let called_clone = Arc::clone(&called);
+        pending.insert_callback(
+            3,
+            Box::new(move |id, result| *called_clone.lock().unwrap() = Some((id, result.is_ok()))),
+        );
+        assert_eq!(pending.len(), 3);
+
+        // Responses arrive in reverse order
+        assert!(pending.complete(JsonRpcResponse::error(
+            3,
+            JsonRpcError::new(-32000, "Surface not found")
+        )));
+        assert!(pending.complete(JsonRpcResponse::success(2, json!({ "two": 2 }))));
+        assert!(!first.is_ready());
+        assert!(pending.complete(JsonRpcResponse::success(1, json!({ "one": 1 }))));
+
+        assert_eq!(first.try_take().unwrap().unwrap(), json!({ "one": 1 }));
+        assert_eq!(second.try_take().unwrap().unwrap(), json!({ "two": 2 }));
+        assert_eq!(*called.lock().unwrap(), Some((3, false)));
+
+        // Unknown IDs are reported, not completed
+        assert!(!pending.complete(JsonRpcResponse::success(99, json!({}))));
+        assert_eq!(pending.len(), 0);
+    }
+
+    #[test]
+    fn test_fail_all() {
+        let mut pending = PendingRequests::default();
+        let handle = pending.insert_handle(1);
+
+        pending.fail_all("Connection closed");
+
+        assert!(matches!(
+            handle.try_take(),
+            Some(Err(IviError::ConnectionFailed(_)))
+        ));
+        assert_eq!(pending.len(), 0);
+    }
+}
@@ -1,12 +1,17 @@
 use super::IviClientTransport;
 use crate::error::{IviError, Result};
+use std::io::{self, Write};
+use std::os::unix::io::{AsRawFd, RawFd};
 use std::os::unix::net::UnixStream;
 use std::time::Duration;
-use weston_ivi_controller::rpc::framing::{write_frame, FrameReadResult, FrameReader};
+use weston_ivi_controller::rpc::framing::{write_frame, FillStatus, FrameReadResult, FrameReader};
 
 /// Default socket path for the IVI controller
 pub const DEFAULT_SOCKET_PATH: &str = "/tmp/weston-ivi-controller.sock";
 
+/// Bytes read from the socket before buffered frames are looked at again
+const RECEIVE_BUDGET: usize = 64 * 1024;
+
 /// Client for communicating with the Weston IVI controller.
 ///
 /// The `IviClient` maintains a connection to the IVI controller over a UNIX domain socket
@@ -30,6 +35,12 @@ pub struct UnixDomainIviClient {
 
     /// Frame reader for length-prefixed protocol
     frame_reader: FrameReader,
+
+    /// How long `receive_response` waits for a frame (None = forever)
+    read_timeout: Option<Duration>,
+
+    /// Outgoing frame, kept to reuse its allocation
+    write_buf: Vec<u8>,
 }
 
 impl UnixDomainIviClient {
@@ -65,48 +76,175 @@ impl UnixDomainIviClient {
         let socket = UnixStream::connect(socket_path)
             .map_err(|e| IviError::ConnectionFailed(format!("{}: {}", socket_path, e)))?;
 
+        // The socket is never read in blocking mode so it can be polled from
+        // an external event loop; blocking calls wait in poll(2) instead
+        socket
+            .set_nonblocking(true)
+            .map_err(|e| IviError::ConnectionFailed(format!("{}: {}", socket_path, e)))?;
+
         Ok(Self {
             socket: Some(socket),
             frame_reader: FrameReader::new(),
+            read_timeout: None,
+            write_buf: Vec::new(),
         })
     }
+
+    fn socket(&mut self) -> Result<&mut UnixStream> {
+        self.socket.as_mut().ok_or_else(|| {
+            IviError::IoError(io::Error::new(
+                io::ErrorKind::NotConnected,
+                "Socket is not connected",
+            ))
+        })
+    }
+
+    /// Wait until the socket reports one of `events` (returns false on timeout)
+    fn wait_for(
+        socket: &UnixStream,
+        events: libc::c_short,
+        timeout: Option<Duration>,
+    ) -> Result<bool> {
+        let mut pollfd = libc::pollfd {
+            fd: socket.as_raw_fd(),
+            events,
+            revents: 0,
+        };
+        let timeout_ms = timeout
+            .map(|t| t.as_millis().min(i32::MAX as u128) as libc::c_int)
+            .unwrap_or(-1);
+
+        loop {
+            // SAFETY: pollfd is a valid, initialized pollfd for the duration of the call
+            let ret = unsafe { libc::poll(&mut pollfd, 1, timeout_ms) };
+            if ret >= 0 {
+                return Ok(ret > 0);
+            }
+
+            let err = io::Error::last_os_error();
+            if err.kind() != io::ErrorKind::Interrupted {
+                return Err(IviError::IoError(err));
+            }
+        }
+    }
 }
 
 impl IviClientTransport for UnixDomainIviClient {
     fn send_request(&mut self, request: &[u8]) -> Result<()> {
+        self.write_buf.clear();
+        write_frame(&mut self.write_buf, request).map_err(IviError::IoError)?;
+        let frame = &self.write_buf;
         let socket = self.socket.as_mut().ok_or_else(|| {
-            IviError::IoError(std::io::Error::new(
-                std::io::ErrorKind::NotConnected,
+            IviError::IoError(io::Error::new(
+                io::ErrorKind::NotConnected,
                 "Socket is not connected",
             ))
         })?;
-        write_frame(socket, request).map_err(IviError::IoError)
+
+        let mut written = 0;
+        while written < frame.len() {
+            match socket.write(&frame[written..]) {
+                Ok(0) => {
+                    return Err(IviError::IoError(io::Error::new(
+                        io::ErrorKind::WriteZero,
+                        "Socket refused to accept more data",
+                    )));
+                }
+                Ok(n) => written += n,
+                Err(e) if e.kind() == io::ErrorKind::WouldBlock => {
+                    Self::wait_for(socket, libc::POLLOUT, None)?;
+                }
+                Err(e) if e.kind() == io::ErrorKind::Interrupted => {}
+                Err(e) => return Err(IviError::IoError(e)),
+            }
+        }
+
+        Ok(())
     }
 
     fn receive_response(&mut self) -> Result<Vec<u8>> {
+        let timeout = self.read_timeout;
+
+        loop {
+            if let Some(frame) = self.try_receive_response()? {
+                return Ok(frame);
+            }
+
+            let socket = self.socket()?;
+            if !Self::wait_for(socket, libc::POLLIN, timeout)? {
+                return Err(IviError::IoError(io::Error::new(
+                    io::ErrorKind::TimedOut,
+                    "Timed out waiting for response",
+                )));
+            }
+        }
+    }
+
+    fn receive_response_into(&mut self, frame: &mut Vec<u8>) -> Result<()> {
+        let timeout = self.read_timeout;
+        let mut wait = false;
+        let mut eof = false;
+
+        loop {
+            if let Some(payload) = self.frame_reader.next_frame()? {
+                frame.clear();
+                frame.extend_from_slice(payload);
+                return Ok(());
+            }
+
+            if eof {
+                return Err(IviError::IoError(io::Error::new(
+                    io::ErrorKind::UnexpectedEof,
+                    "Connection closed while reading response",
+                )));
+            }
+
+            let socket = self.socket.as_mut().ok_or_else(|| {
+                IviError::IoError(io::Error::new(
+                    io::ErrorKind::NotConnected,
+                    "Socket is not connected",
+                ))
+            })?;
+
+            if wait && !Self::wait_for(socket, libc::POLLIN, timeout)? {
+                return Err(IviError::IoError(io::Error::new(
+                    io::ErrorKind::TimedOut,
+                    "Timed out waiting for response",
+                )));
+            }
+
+            wait = match self.frame_reader.fill_from(socket, RECEIVE_BUDGET)? {
+                FillStatus::Eof => {
+                    // Frames read before the end are still delivered
+                    eof = true;
+                    false
+                }
+                FillStatus::Drained => true,
+                FillStatus::BudgetExhausted => false,
+            };
+        }
+    }
+
+    fn try_receive_response(&mut self) -> Result<Option<Vec<u8>>> {
         let socket = self.socket.as_mut().ok_or_else(|| {
-            IviError::IoError(std::io::Error::new(
-                std::io::ErrorKind::NotConnected,
+            IviError::IoError(io::Error::new(
+                io::ErrorKind::NotConnected,
                 "Socket is not connected",
             ))
         })?;
-        let response_buf = loop {
-            match self.frame_reader.read_frame(socket)? {
-                FrameReadResult::Complete(msg) => break msg,
-                FrameReadResult::NeedMore => {
-                    // Partial read, continue reading
-                    std::thread::yield_now();
-                    continue;
-                }
-                FrameReadResult::Eof => {
-                    return Err(IviError::IoError(std::io::Error::new(
-                        std::io::ErrorKind::UnexpectedEof,
-                        "Connection closed while reading response",
-                    )));
-                }
-            }
-        };
-        Ok(response_buf)
+
+        match self.frame_reader.read_frame(socket)? {
+            FrameReadResult::Complete(msg) => Ok(Some(msg)),
+            FrameReadResult::NeedMore => Ok(None),
+            FrameReadResult::Eof => Err(IviError::IoError(io::Error::new(
+                io::ErrorKind::UnexpectedEof,
+                "Connection closed while reading response",
+            ))),
+        }
+    }
+
+    fn raw_fd(&self) -> Option<RawFd> {
+        self.socket.as_ref().map(|socket| socket.as_raw_fd())
     }
 
     fn disconnect(&mut self) -> Result<()> {
@@ -119,12 +257,8 @@ impl IviClientTransport for UnixDomainIviClient {
     }
 
     fn set_read_timeout(&mut self, timeout: Option<Duration>) -> Result<()> {
-        let socket = self.socket.as_mut().ok_or_else(|| {
-            IviError::IoError(std::io::Error::new(
-                std::io::ErrorKind::NotConnected,
-                "Socket is not connected",
-            ))
-        })?;
-        socket.set_read_timeout(timeout).map_err(IviError::IoError)
+        self.socket()?;
+        self.read_timeout = timeout;
+        Ok(())
     }
 }
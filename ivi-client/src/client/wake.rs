@@ -0,0 +1,134 @@
+//! Wake-up descriptor for threads blocked in poll(2).
+//!
+//! The reader thread of a [`NotificationListener`](crate::NotificationListener)
+//! sleeps in poll(2) on its socket and on an eventfd. Signalling the eventfd
+//! ends the wait at once, so the thread needs no read timeout to notice that
+//! it should stop.
+
+use crate::error::{IviError, Result};
+use std::io;
+use std::os::fd::{AsRawFd, FromRawFd, OwnedFd, RawFd};
+
+/// What ended a [`WakeFd::wait`]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(crate) enum Wakeup {
+    /// The watched descriptor is readable, or was closed
+    Readable,
+    /// [`WakeFd::notify`] was called
+    Woken,
+}
+
+/// Non-blocking eventfd used to interrupt a blocked poll(2)
+pub(crate) struct WakeFd {
+    fd: OwnedFd,
+}
+
+impl WakeFd {
+    pub(crate) fn new() -> Result<Self> {
+        // SAFETY: eventfd takes no pointers; the result is checked below
+        let fd = unsafe { libc::eventfd(0, libc::EFD_CLOEXEC | libc::EFD_NONBLOCK) };
+        if fd < 0 {
+            return Err(IviError::IoError(io::Error::last_os_error()));
+        }
+
+        // SAFETY: fd is a freshly created descriptor owned by nobody else
+        Ok(Self {
+            fd: unsafe { OwnedFd::from_raw_fd(fd) },
+        })
+    }
+
+    /// Interrupt the current or next [`wait`](Self::wait)
+    pub(crate) fn notify(&self) {
+        let value: u64 = 1;
+        // SAFETY: writes 8 bytes from a valid u64. The write can only fail if
+        // the counter would overflow, in which case a wake-up is pending anyway
+        unsafe {
+            libc::write(
+                self.fd.as_raw_fd(),
+                &value as *const u64 as *const libc::c_void,
+                std::mem::size_of::<u64>(),
+            );
+        }
+    }
+
+    /// Consume pending wake-ups so the next wait blocks again
+    pub(crate) fn clear(&self) {
+        let mut value: u64 = 0;
+        // SAFETY: reads at most 8 bytes into a valid u64; EAGAIN means nothing was pending
+        unsafe {
+            libc::read(
+                self.fd.as_raw_fd(),
+                &mut value as *mut u64 as *mut libc::c_void,
+                std::mem::size_of::<u64>(),
+            );
+        }
+    }
+
+    /// Block until `fd` is readable or [`notify`](Self::notify) is called
+    ///
+    /// A wake-up takes precedence when both happen at once.
+    pub(crate) fn wait(&self, fd: RawFd) -> Result<Wakeup> {
+        let mut fds = [
+            libc::pollfd {
+                fd,
+                events: libc::POLLIN,
+                revents: 0,
+            },
+            libc::pollfd {
+                fd: self.fd.as_raw_fd(),
+                events: libc::POLLIN,
+                revents: 0,
+            },
+        ];
+
+        loop {
+            // SAFETY: fds is a valid array of two initialized pollfds for the duration of the call
+            let ret = unsafe { libc::poll(fds.as_mut_ptr(), fds.len() as libc::nfds_t, -1) };
+            if ret >= 0 {
+                break;
+            }
+
+            let err = io::Error::last_os_error();
+            if err.kind() != io::ErrorKind::Interrupted {
+                return Err(IviError::IoError(err));
+            }
+        }
+
+        if fds[1].revents != 0 {
+            Ok(Wakeup::Woken)
+        } else {
+            Ok(Wakeup::Readable)
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::io::Write;
+    use std::os::unix::net::UnixStream;
+    use std::sync::Arc;
+    use std::time::{Duration, Instant};
+
+    #[test]
+    fn notify_interrupts_a_blocked_wait() {
+        let (local, mut peer) = UnixStream::pair().unwrap();
+        let wake = Arc::new(WakeFd::new().unwrap());
+
+        let waker = Arc::clone(&wake);
+        let handle = std::thread::spawn(move || {
+            std::thread::sleep(Duration::from_millis(20));
+            waker.notify();
+        });
+
+        let start = Instant::now();
+        assert_eq!(wake.wait(local.as_raw_fd()).unwrap(), Wakeup::Woken);
+        assert!(start.elapsed() < Duration::from_secs(5));
+        handle.join().unwrap();
+
+        // Cleared wake-ups no longer end a wait
+        wake.clear();
+        peer.write_all(b"x").unwrap();
+        assert_eq!(wake.wait(local.as_raw_fd()).unwrap(), Wakeup::Readable);
+    }
+}
@@ -6,19 +6,21 @@
 use serde::{Deserialize, Serialize};
 use std::ffi::{CStr, CString};
 use std::fmt::Display;
-use std::os::raw::{c_char, c_void};
+use std::os::raw::{c_char, c_int, c_void};
 use std::ptr;
-use std::sync::Arc;
 
-use crate::client::{IviClient, NotificationCallback, NotificationListener};
+use crate::batch::IviBatch;
+use crate::client::{IviClient, NotificationListener};
 use crate::error::IviError;
-use crate::protocol::{EventType, Notification};
+use crate::protocol::EventType;
+use crate::scene::IviSceneMap;
+use crate::Encoding;
 
 pub type SurfaceId = u32;
 pub type LayerId = u32;
 
 #[repr(C)]
-#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default, Serialize, Deserialize)]
 pub struct IviSize {
     pub width: i32,
     pub height: i32,
@@ -103,10 +105,30 @@ impl From<IviErrorCode> for IviError {
     }
 }
 
+/// C-compatible wire encoding enum
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum IviEncoding {
+    /// JSON text (default)
+    Json = 0,
+    /// MessagePack binary
+    MessagePack = 1,
+}
+
+impl From<IviEncoding> for Encoding {
+    fn from(encoding: IviEncoding) -> Self {
+        match encoding {
+            IviEncoding::Json => Encoding::Json,
+            IviEncoding::MessagePack => Encoding::MessagePack,
+        }
+    }
+}
+
 /// C-compatible orientation enum
 #[repr(C)]
-#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+#[derive(Debug, Clone, PartialEq, Default, Serialize, Deserialize)]
 pub enum IviOrientation {
+    #[default]
     Normal = 0,
     Rotate90 = 1,
     Rotate180 = 2,
@@ -134,7 +156,7 @@ impl Display for IviOrientation {
 
 /// C-compatible surface structure
 #[repr(C)]
-#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+#[derive(Debug, Clone, PartialEq, Default, Serialize, Deserialize)]
 pub struct IviSurface {
     pub id: SurfaceId,
     pub orig_size: IviSize,
@@ -148,7 +170,7 @@ pub struct IviSurface {
 
 /// C-compatible layer structure
 #[repr(C)]
-#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+#[derive(Debug, Clone, PartialEq, Default, Serialize, Deserialize)]
 pub struct IviLayer {
     pub id: LayerId,
     pub src_rect: Rectangle,
@@ -172,6 +194,98 @@ pub struct IviScreen {
     pub scale: i32,
 }
 
+/// Size of the name buffer of an `IviScreenInfo`, including the terminating NUL
+pub const IVI_SCREEN_NAME_LEN: usize = 64;
+
+/// C-compatible screen structure with an inline name
+///
+/// Filled in by `ivi_list_screens_into`. Longer names are truncated to
+/// `IVI_SCREEN_NAME_LEN - 1` bytes.
+#[repr(C)]
+#[derive(Debug, Clone, PartialEq, Deserialize)]
+pub struct IviScreenInfo {
+    #[serde(deserialize_with = "deserialize_screen_name")]
+    pub name: [c_char; IVI_SCREEN_NAME_LEN],
+    pub width: i32,
+    pub height: i32,
+    pub x: f64,
+    pub y: f64,
+    pub transform: IviOrientation,
+    pub enabled: bool,
+    pub scale: i32,
+}
+
+/// Copies a screen name into a NUL-terminated buffer, without allocating
+fn deserialize_screen_name<'de, D>(
+    deserializer: D,
+) -> Result<[c_char; IVI_SCREEN_NAME_LEN], D::Error>
+where
+    D: serde::Deserializer<'de>,
+{
+    struct NameVisitor;
+
+    impl serde::de::Visitor<'_> for NameVisitor {
+        type Value = [c_char; IVI_SCREEN_NAME_LEN];
+
+        fn expecting(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+            f.write_str("a screen name")
+        }
+
+        fn visit_str<E: serde::de::Error>(self, name: &str) -> Result<Self::Value, E> {
+            let mut buf = [0 as c_char; IVI_SCREEN_NAME_LEN];
+            let mut len = name.len().min(IVI_SCREEN_NAME_LEN - 1);
+            // Never cut a UTF-8 sequence in half
+            while !name.is_char_boundary(len) {
+                len -= 1;
+            }
+            for (dst, src) in buf.iter_mut().zip(&name.as_bytes()[..len]) {
+                *dst = *src as c_char;
+            }
+            Ok(buf)
+        }
+    }
+
+    deserializer.deserialize_str(NameVisitor)
+}
+
+/// C-compatible easing curve of an animation
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum IviEasing {
+    #[default]
+    Linear = 0,
+    EaseIn = 1,
+    EaseOut = 2,
+    EaseInOut = 3,
+}
+
+impl IviEasing {
+    /// Name used in the RPC protocol
+    pub fn name(self) -> &'static str {
+        match self {
+            IviEasing::Linear => "linear",
+            IviEasing::EaseIn => "ease_in",
+            IviEasing::EaseOut => "ease_out",
+            IviEasing::EaseInOut => "ease_in_out",
+        }
+    }
+}
+
+/// C-compatible animation of a surface or layer
+///
+/// Only the properties whose `has_*` flag is set are animated, from their
+/// current values to the given ones.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Default)]
+pub struct IviAnimation {
+    pub has_destination: bool,
+    pub destination: Rectangle,
+    pub has_opacity: bool,
+    pub opacity: f32,
+    pub duration_ms: u32,
+    pub easing: IviEasing,
+}
+
 /// Helper function to write error message to C buffer
 fn write_error_to_buffer(error: &IviError, error_buf: *mut c_char, error_buf_len: usize) {
     if error_buf.is_null() || error_buf_len == 0 {
@@ -256,6 +370,82 @@ pub unsafe extern "C" fn ivi_client_disconnect(client: *mut IviClient) {
     }
 }
 
+/// Switch the connection to another wire encoding
+///
+/// MessagePack is cheaper to produce and parse than JSON. It must be called
+/// while no requests submitted with `ivi_client_submit` are outstanding.
+///
+/// # Safety
+///
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+#[no_mangle]
+pub unsafe extern "C" fn ivi_client_set_encoding(
+    client: *mut IviClient,
+    encoding: IviEncoding,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    if client.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    let client = &mut *client;
+
+    match client.set_encoding(encoding.into()) {
+        Ok(_) => IviErrorCode::Ok,
+        Err(err) => {
+            write_error_to_buffer(&err, error_buf, error_buf_len);
+            err.into()
+        }
+    }
+}
+
+/// Keep a local copy of the scene to answer `ivi_get_surface` and
+/// `ivi_get_layer` without a round trip
+///
+/// The cache follows the scene through notifications on a second
+/// connection and resynchronizes when notifications were lost. Layer
+/// rectangles, layer orientation and layer membership changed by other
+/// clients are only picked up on the next resynchronization.
+///
+/// # Safety
+///
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+#[no_mangle]
+pub unsafe extern "C" fn ivi_client_enable_cache(
+    client: *mut IviClient,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    if client.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    let client = &mut *client;
+
+    match client.enable_cache() {
+        Ok(_) => IviErrorCode::Ok,
+        Err(err) => {
+            write_error_to_buffer(&err, error_buf, error_buf_len);
+            err.into()
+        }
+    }
+}
+
+/// Drop the scene cache enabled with `ivi_client_enable_cache`
+///
+/// # Safety
+///
+/// - `client` must be a valid pointer returned from `ivi_client_connect`, or NULL
+#[no_mangle]
+pub unsafe extern "C" fn ivi_client_disable_cache(client: *mut IviClient) {
+    if let Some(client) = client.as_mut() {
+        client.disable_cache();
+    }
+}
+
 // ============================================================================
 // C API Functions - Surface Operations
 // ============================================================================
@@ -303,6 +493,82 @@ pub unsafe extern "C" fn ivi_list_surfaces(
     }
 }
 
+/// List all surfaces into a caller-provided array
+///
+/// Writes up to `cap` surfaces to `buf` and the total number of surfaces to
+/// `needed`. If `*needed` is larger than `cap` the list was cut short; call
+/// again with a buffer of at least `*needed` entries. `buf` may be NULL if
+/// `cap` is 0, to only query the count.
+///
+/// The response is decoded straight into `buf`. Once the connection's
+/// buffers have grown to fit the response, a successful call makes no heap
+/// allocation, so it can be used from a render loop. This holds for the JSON
+/// encoding; other encodings decode through an intermediate copy.
+///
+/// # Safety
+///
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+/// - `buf` must point to at least `cap` writable `IviSurface` entries, or be NULL if `cap` is 0
+/// - `needed` must be a valid pointer
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+#[no_mangle]
+pub unsafe extern "C" fn ivi_list_surfaces_into(
+    client: *mut IviClient,
+    buf: *mut IviSurface,
+    cap: usize,
+    needed: *mut usize,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    list_into(
+        client,
+        "list_surfaces",
+        "surfaces",
+        buf,
+        cap,
+        needed,
+        error_buf,
+        error_buf_len,
+    )
+}
+
+/// Shared body of the `ivi_list_*_into` functions
+#[allow(clippy::too_many_arguments)]
+unsafe fn list_into<T: serde::de::DeserializeOwned>(
+    client: *mut IviClient,
+    method: &str,
+    key: &str,
+    buf: *mut T,
+    cap: usize,
+    needed: *mut usize,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    if client.is_null() || needed.is_null() || (buf.is_null() && cap > 0) {
+        return IviErrorCode::InvalidParam;
+    }
+
+    let client = &mut *client;
+
+    // Entries are written in place, the caller's memory may be uninitialized
+    let result = client.list_into(method, key, |index, entry: T| {
+        if index < cap {
+            buf.add(index).write(entry);
+        }
+    });
+
+    match result {
+        Ok(count) => {
+            *needed = count;
+            IviErrorCode::Ok
+        }
+        Err(err) => {
+            write_error_to_buffer(&err, error_buf, error_buf_len);
+            err.into()
+        }
+    }
+}
+
 /// Get properties of a specific surface
 ///
 /// # Safety
@@ -567,6 +833,71 @@ pub unsafe extern "C" fn ivi_list_layers(
     }
 }
 
+/// List all layers into a caller-provided array
+///
+/// Works like `ivi_list_surfaces_into`: writes up to `cap` layers, stores the
+/// total number in `needed` and makes no heap allocation on success.
+///
+/// # Safety
+///
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+/// - `buf` must point to at least `cap` writable `IviLayer` entries, or be NULL if `cap` is 0
+/// - `needed` must be a valid pointer
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+#[no_mangle]
+pub unsafe extern "C" fn ivi_list_layers_into(
+    client: *mut IviClient,
+    buf: *mut IviLayer,
+    cap: usize,
+    needed: *mut usize,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    list_into(
+        client,
+        "list_layers",
+        "layers",
+        buf,
+        cap,
+        needed,
+        error_buf,
+        error_buf_len,
+    )
+}
+
+/// List all screens into a caller-provided array
+///
+/// Works like `ivi_list_surfaces_into`: writes up to `cap` screens, stores
+/// the total number in `needed` and makes no heap allocation on success.
+/// Names are copied into the `name` array of each entry.
+///
+/// # Safety
+///
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+/// - `buf` must point to at least `cap` writable `IviScreenInfo` entries, or be NULL if `cap` is 0
+/// - `needed` must be a valid pointer
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+#[no_mangle]
+pub unsafe extern "C" fn ivi_list_screens_into(
+    client: *mut IviClient,
+    buf: *mut IviScreenInfo,
+    cap: usize,
+    needed: *mut usize,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    list_into(
+        client,
+        "list_screens",
+        "screens",
+        buf,
+        cap,
+        needed,
+        error_buf,
+        error_buf_len,
+    )
+}
+
 /// Get properties of a specific layer
 ///
 /// # Safety
@@ -758,42 +1089,767 @@ pub unsafe extern "C" fn ivi_commit(
     }
 }
 
+/// Commit pending changes with the next output frame
+///
+/// On success, `frame` (if not NULL) receives the number of the output frame
+/// that first shows the changes, or 0 if the controller committed immediately.
+///
+/// # Safety
+///
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+/// - `frame` must be a valid pointer to a `uint64_t`, or NULL
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+#[no_mangle]
+pub unsafe extern "C" fn ivi_commit_next_frame(
+    client: *mut IviClient,
+    frame: *mut u64,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    if client.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    let client = &mut *client;
+
+    match client.commit_next_frame() {
+        Ok(committed_frame) => {
+            if !frame.is_null() {
+                *frame = committed_frame;
+            }
+            IviErrorCode::Ok
+        }
+        Err(err) => {
+            write_error_to_buffer(&err, error_buf, error_buf_len);
+            err.into()
+        }
+    }
+}
+
 // ============================================================================
-// C API Functions - Memory Management
+// C API Functions - Animations
 // ============================================================================
 
-/// Free surfaces array allocated by ivi_list_surfaces
+/// Animate a surface to new property values on the compositor frame clock
+///
+/// On success, `animation_id` (if not NULL) receives the ID reported by the
+/// `ANIMATION_COMPLETED` notification of this animation.
 ///
 /// # Safety
 ///
-/// - `surfaces` must be a pointer returned from `ivi_list_surfaces`, or NULL
-/// - `count` must be the same value that was returned by `ivi_list_surfaces`
-/// - After calling this function, `surfaces` must not be used again
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+/// - `animation` must be a valid pointer to an `IviAnimation`
+/// - `animation_id` must be a valid pointer to a `uint64_t`, or NULL
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
 #[no_mangle]
-pub unsafe extern "C" fn ivi_free_surfaces(surfaces: *mut IviSurface, count: usize) {
-    if !surfaces.is_null() && count > 0 {
-        // Reconstruct the Box with the correct length
-        let slice = std::slice::from_raw_parts_mut(surfaces, count);
-        let _ = Box::from_raw(slice);
+pub unsafe extern "C" fn ivi_animate_surface(
+    client: *mut IviClient,
+    id: u32,
+    animation: *const IviAnimation,
+    animation_id: *mut u64,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    if client.is_null() || animation.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    let client = &mut *client;
+
+    match client.animate_surface(id, &*animation) {
+        Ok(started) => {
+            if !animation_id.is_null() {
+                *animation_id = started;
+            }
+            IviErrorCode::Ok
+        }
+        Err(err) => {
+            write_error_to_buffer(&err, error_buf, error_buf_len);
+            err.into()
+        }
     }
 }
 
-/// Free layers array allocated by ivi_list_layers
+/// Animate a layer to new property values on the compositor frame clock
+///
+/// On success, `animation_id` (if not NULL) receives the ID reported by the
+/// `ANIMATION_COMPLETED` notification of this animation.
 ///
 /// # Safety
 ///
-/// - `layers` must be a pointer returned from `ivi_list_layers`, or NULL
-/// - `count` must be the same value that was returned by `ivi_list_layers`
-/// - After calling this function, `layers` must not be used again
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+/// - `animation` must be a valid pointer to an `IviAnimation`
+/// - `animation_id` must be a valid pointer to a `uint64_t`, or NULL
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
 #[no_mangle]
-pub unsafe extern "C" fn ivi_free_layers(layers: *mut IviLayer, count: usize) {
-    if !layers.is_null() && count > 0 {
-        // Reconstruct the Box with the correct length
-        let slice = std::slice::from_raw_parts_mut(layers, count);
-        let _ = Box::from_raw(slice);
+pub unsafe extern "C" fn ivi_animate_layer(
+    client: *mut IviClient,
+    id: u32,
+    animation: *const IviAnimation,
+    animation_id: *mut u64,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    if client.is_null() || animation.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    let client = &mut *client;
+
+    match client.animate_layer(id, &*animation) {
+        Ok(started) => {
+            if !animation_id.is_null() {
+                *animation_id = started;
+            }
+            IviErrorCode::Ok
+        }
+        Err(err) => {
+            write_error_to_buffer(&err, error_buf, error_buf_len);
+            err.into()
+        }
     }
 }
 
+// ============================================================================
+// C API Functions - Batch Operations
+// ============================================================================
+
+/// Start a batch of changes
+///
+/// Changes queued with the `ivi_batch_set_*` functions are sent together by
+/// `ivi_batch_submit`, in one request frame, and committed once.
+///
+/// # Returns
+///
+/// Returns a pointer to an empty batch. It must be passed to `ivi_batch_submit`
+/// or released with `ivi_batch_free`.
+#[no_mangle]
+pub extern "C" fn ivi_batch_begin() -> *mut IviBatch {
+    Box::into_raw(Box::new(IviBatch::new()))
+}
+
+/// Queue a surface source rectangle change
+///
+/// # Safety
+///
+/// - `batch` must be a valid pointer returned from `ivi_batch_begin`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_batch_set_surface_source_rectangle(
+    batch: *mut IviBatch,
+    id: u32,
+    x: i32,
+    y: i32,
+    width: i32,
+    height: i32,
+) -> IviErrorCode {
+    if batch.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    (*batch).set_surface_source_rectangle(id, x, y, width, height);
+    IviErrorCode::Ok
+}
+
+/// Queue a surface destination rectangle change
+///
+/// # Safety
+///
+/// - `batch` must be a valid pointer returned from `ivi_batch_begin`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_batch_set_surface_destination_rectangle(
+    batch: *mut IviBatch,
+    id: u32,
+    x: i32,
+    y: i32,
+    width: i32,
+    height: i32,
+) -> IviErrorCode {
+    if batch.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    (*batch).set_surface_destination_rectangle(id, x, y, width, height);
+    IviErrorCode::Ok
+}
+
+/// Queue a surface visibility change
+///
+/// # Safety
+///
+/// - `batch` must be a valid pointer returned from `ivi_batch_begin`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_batch_set_surface_visibility(
+    batch: *mut IviBatch,
+    id: u32,
+    visible: bool,
+) -> IviErrorCode {
+    if batch.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    (*batch).set_surface_visibility(id, visible);
+    IviErrorCode::Ok
+}
+
+/// Queue a surface opacity change
+///
+/// # Safety
+///
+/// - `batch` must be a valid pointer returned from `ivi_batch_begin`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_batch_set_surface_opacity(
+    batch: *mut IviBatch,
+    id: u32,
+    opacity: f32,
+) -> IviErrorCode {
+    if batch.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    (*batch).set_surface_opacity(id, opacity);
+    IviErrorCode::Ok
+}
+
+/// Queue a surface z-order change
+///
+/// # Safety
+///
+/// - `batch` must be a valid pointer returned from `ivi_batch_begin`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_batch_set_surface_z_order(
+    batch: *mut IviBatch,
+    id: u32,
+    z_order: i32,
+) -> IviErrorCode {
+    if batch.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    (*batch).set_surface_z_order(id, z_order);
+    IviErrorCode::Ok
+}
+
+/// Queue a surface focus change
+///
+/// # Safety
+///
+/// - `batch` must be a valid pointer returned from `ivi_batch_begin`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_batch_set_surface_focus(
+    batch: *mut IviBatch,
+    id: u32,
+) -> IviErrorCode {
+    if batch.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    (*batch).set_surface_focus(id);
+    IviErrorCode::Ok
+}
+
+/// Queue a layer source rectangle change
+///
+/// # Safety
+///
+/// - `batch` must be a valid pointer returned from `ivi_batch_begin`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_batch_set_layer_source_rectangle(
+    batch: *mut IviBatch,
+    id: u32,
+    x: i32,
+    y: i32,
+    width: i32,
+    height: i32,
+) -> IviErrorCode {
+    if batch.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    (*batch).set_layer_source_rectangle(id, x, y, width, height);
+    IviErrorCode::Ok
+}
+
+/// Queue a layer destination rectangle change
+///
+/// # Safety
+///
+/// - `batch` must be a valid pointer returned from `ivi_batch_begin`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_batch_set_layer_destination_rectangle(
+    batch: *mut IviBatch,
+    id: u32,
+    x: i32,
+    y: i32,
+    width: i32,
+    height: i32,
+) -> IviErrorCode {
+    if batch.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    (*batch).set_layer_destination_rectangle(id, x, y, width, height);
+    IviErrorCode::Ok
+}
+
+/// Queue a layer visibility change
+///
+/// # Safety
+///
+/// - `batch` must be a valid pointer returned from `ivi_batch_begin`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_batch_set_layer_visibility(
+    batch: *mut IviBatch,
+    id: u32,
+    visible: bool,
+) -> IviErrorCode {
+    if batch.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    (*batch).set_layer_visibility(id, visible);
+    IviErrorCode::Ok
+}
+
+/// Queue a layer opacity change
+///
+/// # Safety
+///
+/// - `batch` must be a valid pointer returned from `ivi_batch_begin`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_batch_set_layer_opacity(
+    batch: *mut IviBatch,
+    id: u32,
+    opacity: f32,
+) -> IviErrorCode {
+    if batch.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    (*batch).set_layer_opacity(id, opacity);
+    IviErrorCode::Ok
+}
+
+/// Send a batch and commit it
+///
+/// The batch is consumed whether or not the submission succeeds.
+///
+/// # Safety
+///
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+/// - `batch` must be a valid pointer returned from `ivi_batch_begin`
+/// - After calling this function, `batch` must not be used again
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+///
+/// # Returns
+///
+/// Returns IviErrorCode::Ok if every change succeeded, or the error of the first
+/// change that failed.
+#[no_mangle]
+pub unsafe extern "C" fn ivi_batch_submit(
+    client: *mut IviClient,
+    batch: *mut IviBatch,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    if batch.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    let batch = Box::from_raw(batch);
+
+    if client.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    let client = &mut *client;
+
+    match client.submit_batch(*batch) {
+        Ok(_) => IviErrorCode::Ok,
+        Err(err) => {
+            write_error_to_buffer(&err, error_buf, error_buf_len);
+            err.into()
+        }
+    }
+}
+
+/// Discard a batch without sending it
+///
+/// # Safety
+///
+/// - `batch` must be a pointer returned from `ivi_batch_begin`, or NULL
+/// - After calling this function, `batch` must not be used again
+#[no_mangle]
+pub unsafe extern "C" fn ivi_batch_free(batch: *mut IviBatch) {
+    if !batch.is_null() {
+        let _ = Box::from_raw(batch);
+    }
+}
+
+// ============================================================================
+// C API Functions - Pipelined Requests
+// ============================================================================
+
+/// C callback type for the result of a request sent with `ivi_client_submit`.
+///
+/// On success `status` is `Ok` and `result_json` is the JSON-encoded result.
+/// On failure `result_json` holds the error message. The string is only
+/// valid for the duration of the call.
+pub type IviResponseCallback = unsafe extern "C" fn(
+    request_id: u64,
+    status: IviErrorCode,
+    result_json: *const c_char,
+    user_data: *mut c_void,
+);
+
+/// Send a JSON-RPC request without waiting for its response
+///
+/// The callback is invoked from `ivi_client_poll`, or from any other call on
+/// the same client that reads the response. Responses may arrive in any order;
+/// they are matched to requests by id.
+///
+/// # Safety
+///
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+/// - `method` must be a valid null-terminated C string
+/// - `params_json` must be a valid null-terminated JSON object, or NULL for no parameters
+/// - `callback` may be NULL if the result is not needed
+/// - `user_data` is passed to the callback as-is; the caller is responsible for its lifetime
+/// - `request_id` must be a valid pointer, or NULL
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+#[no_mangle]
+#[allow(clippy::too_many_arguments)]
+pub unsafe extern "C" fn ivi_client_submit(
+    client: *mut IviClient,
+    method: *const c_char,
+    params_json: *const c_char,
+    callback: Option<IviResponseCallback>,
+    user_data: *mut c_void,
+    request_id: *mut u64,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    if client.is_null() || method.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    let client = &mut *client;
+
+    let method = match CStr::from_ptr(method).to_str() {
+        Ok(s) => s,
+        Err(_) => return IviErrorCode::InvalidParam,
+    };
+
+    let params = if params_json.is_null() {
+        serde_json::json!({})
+    } else {
+        match CStr::from_ptr(params_json)
+            .to_str()
+            .map_err(|e| IviError::SerializationError(e.to_string()))
+            .and_then(|s| serde_json::from_str(s).map_err(IviError::from))
+        {
+            Ok(params) => params,
+            Err(err) => {
+                write_error_to_buffer(&err, error_buf, error_buf_len);
+                return err.into();
+            }
+        }
+    };
+
+    let user_data_ptr = user_data as usize; // make Send-safe
+
+    let submitted = client.submit_with(method, params, move |id, result| {
+        let Some(callback) = callback else {
+            return;
+        };
+
+        let (status, text) = match result {
+            Ok(value) => (IviErrorCode::Ok, value.to_string()),
+            Err(err) => {
+                let text = err.to_string();
+                (err.into(), text)
+            }
+        };
+        let text = CString::new(text).unwrap_or_default();
+        callback(id, status, text.as_ptr(), user_data_ptr as *mut c_void);
+    });
+
+    match submitted {
+        Ok(id) => {
+            if !request_id.is_null() {
+                *request_id = id;
+            }
+            IviErrorCode::Ok
+        }
+        Err(err) => {
+            write_error_to_buffer(&err, error_buf, error_buf_len);
+            err.into()
+        }
+    }
+}
+
+/// Process responses that can be read without blocking
+///
+/// Call this when the descriptor from `ivi_client_get_fd` becomes readable.
+/// Callbacks of completed requests run before this function returns.
+///
+/// # Safety
+///
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+/// - `completed` must be a valid pointer, or NULL
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+///
+/// # Returns
+///
+/// Returns an error if the connection failed; all outstanding callbacks are
+/// then invoked with `ConnectionFailed`.
+#[no_mangle]
+pub unsafe extern "C" fn ivi_client_poll(
+    client: *mut IviClient,
+    completed: *mut usize,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    if client.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    let client = &mut *client;
+
+    match client.poll() {
+        Ok(count) => {
+            if !completed.is_null() {
+                *completed = count;
+            }
+            IviErrorCode::Ok
+        }
+        Err(err) => {
+            write_error_to_buffer(&err, error_buf, error_buf_len);
+            err.into()
+        }
+    }
+}
+
+/// Get the file descriptor of the client connection
+///
+/// The descriptor becomes readable when responses arrive. Add it to an event
+/// loop and call `ivi_client_poll` when it fires. It must not be read from or
+/// closed by the caller.
+///
+/// # Safety
+///
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+///
+/// # Returns
+///
+/// Returns the descriptor, or -1 if none is available.
+#[no_mangle]
+pub unsafe extern "C" fn ivi_client_get_fd(client: *const IviClient) -> c_int {
+    if client.is_null() {
+        return -1;
+    }
+
+    (*client).raw_fd().unwrap_or(-1)
+}
+
+/// Get the number of submitted requests still waiting for a response
+///
+/// # Safety
+///
+/// - `client` must be a valid pointer returned from `ivi_client_connect`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_client_pending_count(client: *const IviClient) -> usize {
+    if client.is_null() {
+        return 0;
+    }
+
+    (*client).pending_count()
+}
+
+// ============================================================================
+// C API Functions - Memory Management
+// ============================================================================
+
+/// Free surfaces array allocated by ivi_list_surfaces
+///
+/// # Safety
+///
+/// - `surfaces` must be a pointer returned from `ivi_list_surfaces`, or NULL
+/// - `count` must be the same value that was returned by `ivi_list_surfaces`
+/// - After calling this function, `surfaces` must not be used again
+#[no_mangle]
+pub unsafe extern "C" fn ivi_free_surfaces(surfaces: *mut IviSurface, count: usize) {
+    if !surfaces.is_null() && count > 0 {
+        // Reconstruct the Box with the correct length
+        let slice = std::slice::from_raw_parts_mut(surfaces, count);
+        let _ = Box::from_raw(slice);
+    }
+}
+
+/// Free layers array allocated by ivi_list_layers
+///
+/// # Safety
+///
+/// - `layers` must be a pointer returned from `ivi_list_layers`, or NULL
+/// - `count` must be the same value that was returned by `ivi_list_layers`
+/// - After calling this function, `layers` must not be used again
+#[no_mangle]
+pub unsafe extern "C" fn ivi_free_layers(layers: *mut IviLayer, count: usize) {
+    if !layers.is_null() && count > 0 {
+        // Reconstruct the Box with the correct length
+        let slice = std::slice::from_raw_parts_mut(layers, count);
+        let _ = Box::from_raw(slice);
+    }
+}
+
+// ============================================================================
+// Shared-memory scene
+// ============================================================================
+
+/// Map the scene mirror published by the controller
+///
+/// Reads through the returned map are plain memory loads: no system call and
+/// no round trip to the controller.
+///
+/// # Safety
+///
+/// - `path` must be a valid null-terminated C string, or NULL to use the default path
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+///
+/// # Returns
+///
+/// Returns a pointer to the scene map on success, or NULL on failure.
+/// The map must be released with `ivi_client_unmap_scene`.
+#[no_mangle]
+pub unsafe extern "C" fn ivi_client_map_scene(
+    path: *const c_char,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> *mut IviSceneMap {
+    let path = if path.is_null() {
+        None
+    } else {
+        match CStr::from_ptr(path).to_str() {
+            Ok(s) => Some(s),
+            Err(_) => {
+                let err = IviError::ConnectionFailed("Invalid UTF-8 in path".to_string());
+                write_error_to_buffer(&err, error_buf, error_buf_len);
+                return ptr::null_mut();
+            }
+        }
+    };
+
+    match IviSceneMap::open(path) {
+        Ok(scene) => Box::into_raw(Box::new(scene)),
+        Err(err) => {
+            write_error_to_buffer(&err, error_buf, error_buf_len);
+            ptr::null_mut()
+        }
+    }
+}
+
+/// Unmap a scene mirror
+///
+/// # Safety
+///
+/// - `scene` must be a pointer returned from `ivi_client_map_scene`, or NULL
+/// - After calling this function, `scene` must not be used again
+#[no_mangle]
+pub unsafe extern "C" fn ivi_client_unmap_scene(scene: *mut IviSceneMap) {
+    if !scene.is_null() {
+        let _ = Box::from_raw(scene);
+    }
+}
+
+/// Read a surface from a scene mirror
+///
+/// # Safety
+///
+/// - `scene` must be a valid pointer returned from `ivi_client_map_scene`
+/// - `surface` must be a valid pointer to an IviSurface structure
+///
+/// # Returns
+///
+/// Returns true and fills `surface` if the surface is in the mirror. Returns
+/// false if it is not, or if the mirror could not be read because the
+/// controller died in the middle of an update.
+#[no_mangle]
+pub unsafe extern "C" fn ivi_scene_get_surface(
+    scene: *mut IviSceneMap,
+    id: u32,
+    surface: *mut IviSurface,
+) -> bool {
+    if scene.is_null() || surface.is_null() {
+        return false;
+    }
+
+    match (*scene).surface(id) {
+        Ok(Some(surf)) => {
+            *surface = surf;
+            true
+        }
+        _ => false,
+    }
+}
+
+/// Read a layer from a scene mirror
+///
+/// # Safety
+///
+/// - `scene` must be a valid pointer returned from `ivi_client_map_scene`
+/// - `layer` must be a valid pointer to an IviLayer structure
+///
+/// # Returns
+///
+/// Returns true and fills `layer` if the layer is in the mirror. Returns
+/// false if it is not, or if the mirror could not be read.
+#[no_mangle]
+pub unsafe extern "C" fn ivi_scene_get_layer(
+    scene: *mut IviSceneMap,
+    id: u32,
+    layer: *mut IviLayer,
+) -> bool {
+    if scene.is_null() || layer.is_null() {
+        return false;
+    }
+
+    match (*scene).layer(id) {
+        Ok(Some(l)) => {
+            *layer = l;
+            true
+        }
+        _ => false,
+    }
+}
+
+/// Scene generation a mirror was last updated to
+///
+/// The generation changes whenever the scene does, so comparing it with a
+/// saved value tells whether anything needs to be read again.
+///
+/// # Safety
+///
+/// - `scene` must be a valid pointer returned from `ivi_client_map_scene`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_scene_generation(scene: *const IviSceneMap) -> u64 {
+    if scene.is_null() {
+        return 0;
+    }
+    (*scene).generation()
+}
+
+/// Check whether the controller still updates a scene mirror
+///
+/// Returns false once the controller has shut down or restarted; map the
+/// scene again to follow a new instance.
+///
+/// # Safety
+///
+/// - `scene` must be a valid pointer returned from `ivi_client_map_scene`
+#[no_mangle]
+pub unsafe extern "C" fn ivi_scene_is_live(scene: *const IviSceneMap) -> bool {
+    !scene.is_null() && (*scene).is_live()
+}
+
 // ============================================================================
 // Notification types
 // ============================================================================
@@ -827,6 +1883,7 @@ pub enum IviEventType {
     LayerOpacityChanged = 12,
     SurfaceContentReady = 13,
     SurfaceContentSizeChanged = 14,
+    AnimationCompleted = 15,
 }
 
 impl From<&EventType> for IviEventType {
@@ -847,6 +1904,7 @@ impl From<&EventType> for IviEventType {
             EventType::LayerOpacityChanged => IviEventType::LayerOpacityChanged,
             EventType::SurfaceContentReady => IviEventType::SurfaceContentReady,
             EventType::SurfaceContentSizeChanged => IviEventType::SurfaceContentSizeChanged,
+            EventType::AnimationCompleted => IviEventType::AnimationCompleted,
         }
     }
 }
@@ -869,6 +1927,7 @@ impl From<IviEventType> for EventType {
             IviEventType::LayerOpacityChanged => EventType::LayerOpacityChanged,
             IviEventType::SurfaceContentReady => EventType::SurfaceContentReady,
             IviEventType::SurfaceContentSizeChanged => EventType::SurfaceContentSizeChanged,
+            IviEventType::AnimationCompleted => EventType::AnimationCompleted,
         }
     }
 }
@@ -940,6 +1999,15 @@ pub struct IviContentSizeChange {
     pub new_height: i32,
 }
 
+/// Animation completed data: the animation ID and whether it was cancelled
+/// before reaching its target values.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct IviAnimationCompletedInfo {
+    pub animation_id: u64,
+    pub cancelled: bool,
+}
+
 /// A notification event delivered to C callbacks.
 ///
 /// Only the fields relevant to `event_type` are populated; all others are
@@ -967,137 +2035,7 @@ pub struct IviNotification {
     pub orientation: IviOrientationChange,
     pub content_ready: IviContentReadyInfo,
     pub content_size: IviContentSizeChange,
-}
-
-fn parse_rect(params: &serde_json::Value, key: &str) -> Rectangle {
-    let r = &params[key];
-    Rectangle {
-        x: r["x"].as_i64().unwrap_or(0) as i32,
-        y: r["y"].as_i64().unwrap_or(0) as i32,
-        width: r["width"].as_i64().unwrap_or(0) as i32,
-        height: r["height"].as_i64().unwrap_or(0) as i32,
-    }
-}
-
-fn parse_orientation(params: &serde_json::Value, key: &str) -> IviOrientation {
-    match params[key].as_str().unwrap_or("Normal") {
-        "Rotate90" => IviOrientation::Rotate90,
-        "Rotate180" => IviOrientation::Rotate180,
-        "Rotate270" => IviOrientation::Rotate270,
-        "Flipped" => IviOrientation::Flipped,
-        "Flipped90" => IviOrientation::Flipped90,
-        "Flipped180" => IviOrientation::Flipped180,
-        "Flipped270" => IviOrientation::Flipped270,
-        _ => IviOrientation::Normal,
-    }
-}
-
-fn notification_to_ffi(notif: &Notification) -> IviNotification {
-    let p = &notif.params;
-    let mut result = IviNotification {
-        event_type: IviEventType::from(&notif.event_type),
-        ..Default::default()
-    };
-
-    match &notif.event_type {
-        EventType::SurfaceCreated | EventType::SurfaceDestroyed => {
-            result.object_type = IviObjectType::Surface;
-            result.object_id = p["surface_id"].as_u64().unwrap_or(0) as u32;
-        }
-        EventType::SourceGeometryChanged => {
-            result.object_type = IviObjectType::Surface;
-            result.object_id = p["surface_id"].as_u64().unwrap_or(0) as u32;
-            result.src_geometry = IviGeometryChange {
-                old_rect: parse_rect(p, "old_rect"),
-                new_rect: parse_rect(p, "new_rect"),
-            };
-        }
-        EventType::DestinationGeometryChanged => {
-            result.object_type = IviObjectType::Surface;
-            result.object_id = p["surface_id"].as_u64().unwrap_or(0) as u32;
-            result.dest_geometry = IviGeometryChange {
-                old_rect: parse_rect(p, "old_rect"),
-                new_rect: parse_rect(p, "new_rect"),
-            };
-        }
-        EventType::VisibilityChanged => {
-            result.object_type = IviObjectType::Surface;
-            result.object_id = p["surface_id"].as_u64().unwrap_or(0) as u32;
-            result.visibility = IviVisibilityChange {
-                old_visibility: p["old_visibility"].as_bool().unwrap_or(false),
-                new_visibility: p["new_visibility"].as_bool().unwrap_or(false),
-            };
-        }
-        EventType::OpacityChanged => {
-            result.object_type = IviObjectType::Surface;
-            result.object_id = p["surface_id"].as_u64().unwrap_or(0) as u32;
-            result.opacity = IviOpacityChange {
-                old_opacity: p["old_opacity"].as_f64().unwrap_or(0.0) as f32,
-                new_opacity: p["new_opacity"].as_f64().unwrap_or(0.0) as f32,
-            };
-        }
-        EventType::OrientationChanged => {
-            result.object_type = IviObjectType::Surface;
-            result.object_id = p["surface_id"].as_u64().unwrap_or(0) as u32;
-            result.orientation = IviOrientationChange {
-                old_orientation: parse_orientation(p, "old_orientation"),
-                new_orientation: parse_orientation(p, "new_orientation"),
-            };
-        }
-        EventType::ZOrderChanged => {
-            result.object_type = IviObjectType::Surface;
-            result.object_id = p["surface_id"].as_u64().unwrap_or(0) as u32;
-            result.z_order = IviZOrderChange {
-                old_z_order: p["old_z_order"].as_i64().unwrap_or(0) as i32,
-                new_z_order: p["new_z_order"].as_i64().unwrap_or(0) as i32,
-            };
-        }
-        EventType::FocusChanged => {
-            result.object_type = IviObjectType::Surface;
-            result.object_id = p["new_focused_surface"].as_u64().unwrap_or(0) as u32;
-            result.object_old_id = p["old_focused_surface"].as_u64().unwrap_or(0) as u32;
-        }
-        EventType::LayerCreated | EventType::LayerDestroyed => {
-            result.object_type = IviObjectType::Layer;
-            result.object_id = p["layer_id"].as_u64().unwrap_or(0) as u32;
-        }
-        EventType::LayerVisibilityChanged => {
-            result.object_type = IviObjectType::Layer;
-            result.object_id = p["layer_id"].as_u64().unwrap_or(0) as u32;
-            result.visibility = IviVisibilityChange {
-                old_visibility: p["old_visibility"].as_bool().unwrap_or(false),
-                new_visibility: p["new_visibility"].as_bool().unwrap_or(false),
-            };
-        }
-        EventType::LayerOpacityChanged => {
-            result.object_type = IviObjectType::Layer;
-            result.object_id = p["layer_id"].as_u64().unwrap_or(0) as u32;
-            result.opacity = IviOpacityChange {
-                old_opacity: p["old_opacity"].as_f64().unwrap_or(0.0) as f32,
-                new_opacity: p["new_opacity"].as_f64().unwrap_or(0.0) as f32,
-            };
-        }
-        EventType::SurfaceContentReady => {
-            result.object_type = IviObjectType::Surface;
-            result.object_id = p["surface_id"].as_u64().unwrap_or(0) as u32;
-            result.content_ready = IviContentReadyInfo {
-                width: p["width"].as_i64().unwrap_or(0) as i32,
-                height: p["height"].as_i64().unwrap_or(0) as i32,
-            };
-        }
-        EventType::SurfaceContentSizeChanged => {
-            result.object_type = IviObjectType::Surface;
-            result.object_id = p["surface_id"].as_u64().unwrap_or(0) as u32;
-            result.content_size = IviContentSizeChange {
-                old_width: p["old_width"].as_i64().unwrap_or(0) as i32,
-                old_height: p["old_height"].as_i64().unwrap_or(0) as i32,
-                new_width: p["new_width"].as_i64().unwrap_or(0) as i32,
-                new_height: p["new_height"].as_i64().unwrap_or(0) as i32,
-            };
-        }
-    }
-
-    result
+    pub animation: IviAnimationCompletedInfo,
 }
 
 /// C callback type for notification events.
@@ -1185,12 +2123,9 @@ pub unsafe extern "C" fn ivi_notification_listener_on(
     let listener = &mut *listener;
     let user_data_ptr = user_data as usize; // make Send-safe
 
-    let cb: NotificationCallback = Arc::new(move |notif: &Notification| {
-        let ffi_notif = notification_to_ffi(notif);
-        unsafe { callback(&ffi_notif, user_data_ptr as *mut c_void) };
+    listener.on_typed(EventType::from(event_type), move |notif| {
+        unsafe { callback(notif, user_data_ptr as *mut c_void) };
     });
-
-    listener.on(EventType::from(event_type), move |notif| cb(notif));
     IviErrorCode::Ok
 }
 
@@ -1214,13 +2149,23 @@ pub unsafe extern "C" fn ivi_notification_listener_on_all(
     let listener = &mut *listener;
     let user_data_ptr = user_data as usize;
 
-    listener.on_all(move |notif: &Notification| {
-        let ffi_notif = notification_to_ffi(notif);
-        unsafe { callback(&ffi_notif, user_data_ptr as *mut c_void) };
+    listener.on_all_typed(move |notif| {
+        unsafe { callback(notif, user_data_ptr as *mut c_void) };
     });
     IviErrorCode::Ok
 }
 
+unsafe fn event_types_from_raw(event_types: *const IviEventType, count: usize) -> Vec<EventType> {
+    if event_types.is_null() || count == 0 {
+        vec![]
+    } else {
+        std::slice::from_raw_parts(event_types, count)
+            .iter()
+            .map(|&et| EventType::from(et))
+            .collect()
+    }
+}
+
 /// Subscribe to the specified event types and start the background reader thread.
 ///
 /// # Safety
@@ -1243,14 +2188,7 @@ pub unsafe extern "C" fn ivi_notification_listener_start(
 
     let listener = &mut *listener;
 
-    let types: Vec<EventType> = if event_types.is_null() || count == 0 {
-        vec![]
-    } else {
-        std::slice::from_raw_parts(event_types, count)
-            .iter()
-            .map(|&et| EventType::from(et))
-            .collect()
-    };
+    let types = event_types_from_raw(event_types, count);
 
     match listener.start(&types) {
         Ok(()) => IviErrorCode::Ok,
@@ -1272,3 +2210,103 @@ pub unsafe extern "C" fn ivi_notification_listener_stop(listener: *mut Notificat
         (*listener).stop();
     }
 }
+
+/// Subscribe to the specified event types without starting a reader thread.
+///
+/// Drive the listener from your own event loop instead: watch the descriptor
+/// from `ivi_notification_listener_get_fd` and call
+/// `ivi_notification_listener_dispatch` when it becomes readable, and once
+/// right after this call. Callbacks then run on the thread calling dispatch.
+///
+/// # Safety
+///
+/// - `listener` must be a valid pointer returned from `ivi_notification_listener_new`
+/// - `event_types` must be a valid pointer to an array of `count` `IviEventType` values, or NULL
+///   if `count` is 0
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+#[no_mangle]
+pub unsafe extern "C" fn ivi_notification_listener_subscribe(
+    listener: *mut NotificationListener,
+    event_types: *const IviEventType,
+    count: usize,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    if listener.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    let listener = &mut *listener;
+    let types = event_types_from_raw(event_types, count);
+
+    match listener.subscribe(&types) {
+        Ok(()) => IviErrorCode::Ok,
+        Err(err) => {
+            write_error_to_buffer(&err, error_buf, error_buf_len);
+            err.into()
+        }
+    }
+}
+
+/// Get the file descriptor of the listener connection
+///
+/// The descriptor becomes readable when notifications arrive. It must not be
+/// read from or closed by the caller.
+///
+/// # Safety
+///
+/// - `listener` must be a valid pointer returned from `ivi_notification_listener_new`
+///
+/// # Returns
+///
+/// Returns the descriptor, or -1 if none is available.
+#[no_mangle]
+pub unsafe extern "C" fn ivi_notification_listener_get_fd(
+    listener: *const NotificationListener,
+) -> c_int {
+    if listener.is_null() {
+        return -1;
+    }
+
+    (*listener).raw_fd().unwrap_or(-1)
+}
+
+/// Run callbacks for every notification that can be read without blocking
+///
+/// Only for listeners set up with `ivi_notification_listener_subscribe`.
+///
+/// # Safety
+///
+/// - `listener` must be a valid pointer returned from `ivi_notification_listener_new`
+/// - `dispatched` must be a valid pointer, or NULL
+/// - `error_buf` must be a valid pointer to a buffer of at least `error_buf_len` bytes, or NULL
+///
+/// # Returns
+///
+/// Returns an error if the connection failed or the reader thread is running.
+#[no_mangle]
+pub unsafe extern "C" fn ivi_notification_listener_dispatch(
+    listener: *mut NotificationListener,
+    dispatched: *mut usize,
+    error_buf: *mut c_char,
+    error_buf_len: usize,
+) -> IviErrorCode {
+    if listener.is_null() {
+        return IviErrorCode::InvalidParam;
+    }
+
+    let listener = &mut *listener;
+
+    match listener.dispatch() {
+        Ok(count) => {
+            if !dispatched.is_null() {
+                *dispatched = count;
+            }
+            IviErrorCode::Ok
+        }
+        Err(err) => {
+            write_error_to_buffer(&err, error_buf, error_buf_len);
+            err.into()
+        }
+    }
+}
@@ -88,9 +88,11 @@
 //! # Modules
 //!
 //! - [`client`] - Main client implementation for connecting and communicating
+//! - [`batch`] - Batched changes applied with a single round trip and commit
 //! - [`types`] - Data structures for surfaces, layers, and properties
 //! - [`error`] - Error types and result aliases
 //! - [`protocol`] - JSON-RPC protocol structures
+//! - [`scene`] - Read-only scene through the controller's shared-memory mirror
 //! - [`ffi`] - C FFI bindings for C language integration
 //!
 //! # Examples
@@ -100,13 +102,25 @@
 //! - `c_example.c` - Comprehensive C API usage
 
 // Module declarations
+pub mod batch;
 pub mod client;
 pub mod error;
 pub mod ffi;
 pub mod protocol;
+pub mod scene;
 
 // Re-export main types for convenience
-pub use client::{IviClient, NotificationCallback, NotificationListener};
+pub use batch::IviBatch;
+pub use client::{
+    ClientNotificationCallback, IviClient, NotificationCallback, NotificationListener,
+    PendingResponse, ResponseCallback, TypedNotificationCallback,
+};
 pub use error::{IviError, Result};
 pub use ffi::*;
-pub use protocol::{EventType, JsonRpcError, JsonRpcRequest, JsonRpcResponse, Notification};
+pub use protocol::{
+    ClientQueueStats, EventType, JsonRpcError, JsonRpcRequest, JsonRpcResponse, LatencyBucket,
+    LatencyStats, Notification, NotificationStats, SceneChanges, ServerMetrics, TransportStats,
+};
+pub use scene::{IviSceneMap, DEFAULT_SCENE_PATH};
+pub use weston_ivi_controller::rpc::recorder::{RecordKind, RecordReader, RecordedFrame};
+pub use weston_ivi_controller::rpc::Encoding;
@@ -4,8 +4,15 @@
 //! used to communicate with the Weston IVI controller over UNIX domain sockets.
 
 use crate::error::{IviError, Result};
-use serde::{Deserialize, Serialize};
+use crate::ffi::{
+    IviAnimationCompletedInfo, IviContentReadyInfo, IviContentSizeChange, IviEventType,
+    IviGeometryChange, IviLayer, IviNotification, IviObjectType, IviOpacityChange, IviOrientation,
+    IviOrientationChange, IviSurface, IviVisibilityChange, IviZOrderChange, Rectangle,
+};
+use serde::de::IgnoredAny;
+use serde::{Deserialize, Deserializer, Serialize};
 use serde_json::Value;
+use std::collections::BTreeMap;
 
 /// JSON-RPC 2.0 request structure.
 ///
@@ -215,6 +222,104 @@ impl JsonRpcError {
     }
 }
 
+/// Scene changes returned by `get_changes_since`.
+///
+/// Apply `removed_surfaces` and `removed_layers` first, then the changed
+/// objects. When `full` is set, the requested generation could not be served
+/// incrementally: `surfaces` and `layers` hold the whole scene and replace
+/// any local copy.
+#[derive(Debug, Clone, Deserialize)]
+pub struct SceneChanges {
+    /// Generation to pass to the next `get_changes_since` call
+    pub generation: u64,
+    /// Whether the result is the full scene rather than a diff
+    pub full: bool,
+    /// Surfaces added or changed since the requested generation
+    pub surfaces: Vec<IviSurface>,
+    /// Layers added or changed since the requested generation
+    pub layers: Vec<IviLayer>,
+    /// IDs of surfaces removed since the requested generation
+    pub removed_surfaces: Vec<u32>,
+    /// IDs of layers removed since the requested generation
+    pub removed_layers: Vec<u32>,
+}
+
+/// One bucket of a latency histogram returned by `get_metrics`.
+#[derive(Debug, Clone, PartialEq, Eq, Deserialize)]
+pub struct LatencyBucket {
+    /// Upper bound in microseconds, `None` for the overflow bucket
+    pub le_us: Option<u64>,
+    /// Number of durations up to the bound (cumulative)
+    pub count: u64,
+}
+
+/// Latency statistics of one RPC method or compositor callback.
+///
+/// Percentiles are bucket upper bounds, so they overestimate by at most one
+/// bucket width.
+#[derive(Debug, Clone, PartialEq, Eq, Deserialize)]
+pub struct LatencyStats {
+    pub count: u64,
+    pub sum_us: u64,
+    pub max_us: u64,
+    pub p50_us: u64,
+    pub p90_us: u64,
+    pub p99_us: u64,
+    pub buckets: Vec<LatencyBucket>,
+    /// Calls that returned an error (RPC methods only)
+    #[serde(default)]
+    pub errors: u64,
+}
+
+/// Transport counters returned by `get_metrics`.
+#[derive(Debug, Clone, PartialEq, Eq, Deserialize)]
+pub struct TransportStats {
+    pub frames_received: u64,
+    pub bytes_received: u64,
+    /// Frames dropped for clients that do not read
+    pub frames_dropped: u64,
+    /// Clients disconnected for not reading
+    pub slow_client_disconnects: u64,
+}
+
+/// Notification queue of one subscribed client.
+#[derive(Debug, Clone, PartialEq, Eq, Deserialize)]
+pub struct ClientQueueStats {
+    pub client_id: String,
+    /// Notifications waiting for delivery
+    pub depth: usize,
+    /// Notifications dropped because the queue was full
+    pub dropped: u64,
+}
+
+/// Notification counters returned by `get_metrics`.
+#[derive(Debug, Clone, PartialEq, Eq, Deserialize)]
+pub struct NotificationStats {
+    pub queued: u64,
+    pub dropped: u64,
+    /// Notifications merged into a pending one for coalescing clients
+    pub coalesced: u64,
+    pub queues: Vec<ClientQueueStats>,
+}
+
+/// Runtime metrics of the controller returned by `get_metrics`.
+///
+/// Counters run from controller start. Only methods and callbacks that ran
+/// at least once are listed.
+#[derive(Debug, Clone, PartialEq, Eq, Deserialize)]
+pub struct ServerMetrics {
+    /// Latency of each RPC method, by method name
+    pub rpc: BTreeMap<String, LatencyStats>,
+    /// Requests whose method or parameters could not be parsed
+    pub invalid_requests: u64,
+    /// Time from receiving a message to sending its response
+    pub messages: LatencyStats,
+    /// Run time of each compositor callback, by callback name
+    pub callbacks: BTreeMap<String, LatencyStats>,
+    pub transport: TransportStats,
+    pub notifications: NotificationStats,
+}
+
 /// Event types for notifications from the IVI controller.
 #[derive(Debug, Clone, PartialEq, Eq, Hash, Serialize, Deserialize)]
 pub enum EventType {
@@ -233,9 +338,33 @@ pub enum EventType {
     LayerDestroyed,
     LayerVisibilityChanged,
     LayerOpacityChanged,
+    AnimationCompleted,
+}
+
+impl EventType {
+    /// Every event type, in declaration order
+    pub const ALL: [EventType; 16] = [
+        EventType::SurfaceCreated,
+        EventType::SurfaceContentReady,
+        EventType::SurfaceContentSizeChanged,
+        EventType::SurfaceDestroyed,
+        EventType::SourceGeometryChanged,
+        EventType::DestinationGeometryChanged,
+        EventType::VisibilityChanged,
+        EventType::OpacityChanged,
+        EventType::OrientationChanged,
+        EventType::ZOrderChanged,
+        EventType::FocusChanged,
+        EventType::LayerCreated,
+        EventType::LayerDestroyed,
+        EventType::LayerVisibilityChanged,
+        EventType::LayerOpacityChanged,
+        EventType::AnimationCompleted,
+    ];
 }
 
 /// A notification received from the IVI controller.
+#[derive(Debug, Clone)]
 pub struct Notification {
     pub event_type: EventType,
     pub params: Value,
@@ -248,7 +377,13 @@ impl Notification {
     /// so callers can silently skip it.
     pub fn try_from_frame(frame: &[u8]) -> Result<Option<Self>> {
         let value: Value = serde_json::from_slice(frame)?;
+        Self::try_from_value(&value)
+    }
 
+    /// Parse an already decoded frame into a Notification.
+    ///
+    /// Returns `Ok(None)` for RPC responses, like [`try_from_frame`](Self::try_from_frame).
+    pub fn try_from_value(value: &Value) -> Result<Option<Self>> {
         // Frames with "id" are RPC responses, not notifications.
         if value.get("id").is_some() {
             return Ok(None);
@@ -277,6 +412,179 @@ impl Notification {
 
         Ok(Some(Notification { event_type, params }))
     }
+
+    /// Sequence number the controller stamped on this notification
+    ///
+    /// Numbers are consecutive for a listener subscribed to every event type
+    /// of every object without coalescing; a gap means notifications were
+    /// dropped on the way.
+    pub fn seq(&self) -> Option<u64> {
+        self.params.get("seq")?.as_u64()
+    }
+}
+
+/// Shape of a notification frame, decoded without building a `Value`
+#[derive(Deserialize)]
+struct NotificationFrame {
+    /// Set for RPC responses, which are not notifications
+    #[serde(default, deserialize_with = "field_present")]
+    id: bool,
+    params: Option<EventParams>,
+}
+
+/// Parameters of every event type; each type sends only some of them
+#[derive(Deserialize)]
+struct EventParams {
+    event_type: EventType,
+    surface_id: Option<u32>,
+    layer_id: Option<u32>,
+    #[serde(default)]
+    width: i32,
+    #[serde(default)]
+    height: i32,
+    #[serde(default)]
+    old_width: i32,
+    #[serde(default)]
+    old_height: i32,
+    #[serde(default)]
+    new_width: i32,
+    #[serde(default)]
+    new_height: i32,
+    #[serde(default)]
+    old_rect: Rectangle,
+    #[serde(default)]
+    new_rect: Rectangle,
+    #[serde(default)]
+    old_visibility: bool,
+    #[serde(default)]
+    new_visibility: bool,
+    #[serde(default)]
+    old_opacity: f32,
+    #[serde(default)]
+    new_opacity: f32,
+    #[serde(default)]
+    old_orientation: IviOrientation,
+    #[serde(default)]
+    new_orientation: IviOrientation,
+    #[serde(default)]
+    old_z_order: i32,
+    #[serde(default)]
+    new_z_order: i32,
+    old_focused_surface: Option<u32>,
+    new_focused_surface: Option<u32>,
+    #[serde(default)]
+    animation_id: u64,
+    #[serde(default)]
+    cancelled: bool,
+}
+
+fn field_present<'de, D: Deserializer<'de>>(
+    deserializer: D,
+) -> std::result::Result<bool, D::Error> {
+    IgnoredAny::deserialize(deserializer).map(|_| true)
+}
+
+impl EventParams {
+    fn into_notification(self) -> IviNotification {
+        let mut result = IviNotification {
+            event_type: IviEventType::from(&self.event_type),
+            object_type: IviObjectType::Surface,
+            object_id: self.surface_id.unwrap_or(0),
+            ..Default::default()
+        };
+
+        match self.event_type {
+            EventType::SurfaceCreated | EventType::SurfaceDestroyed => {}
+            EventType::SourceGeometryChanged => {
+                result.src_geometry = IviGeometryChange {
+                    old_rect: self.old_rect,
+                    new_rect: self.new_rect,
+                };
+            }
+            EventType::DestinationGeometryChanged => {
+                result.dest_geometry = IviGeometryChange {
+                    old_rect: self.old_rect,
+                    new_rect: self.new_rect,
+                };
+            }
+            EventType::VisibilityChanged | EventType::LayerVisibilityChanged => {
+                result.visibility = IviVisibilityChange {
+                    old_visibility: self.old_visibility,
+                    new_visibility: self.new_visibility,
+                };
+            }
+            EventType::OpacityChanged | EventType::LayerOpacityChanged => {
+                result.opacity = IviOpacityChange {
+                    old_opacity: self.old_opacity,
+                    new_opacity: self.new_opacity,
+                };
+            }
+            EventType::OrientationChanged => {
+                result.orientation = IviOrientationChange {
+                    old_orientation: self.old_orientation,
+                    new_orientation: self.new_orientation,
+                };
+            }
+            EventType::ZOrderChanged => {
+                result.z_order = IviZOrderChange {
+                    old_z_order: self.old_z_order,
+                    new_z_order: self.new_z_order,
+                };
+            }
+            EventType::FocusChanged => {
+                result.object_id = self.new_focused_surface.unwrap_or(0);
+                result.object_old_id = self.old_focused_surface.unwrap_or(0);
+            }
+            EventType::LayerCreated | EventType::LayerDestroyed => {}
+            EventType::SurfaceContentReady => {
+                result.content_ready = IviContentReadyInfo {
+                    width: self.width,
+                    height: self.height,
+                };
+            }
+            EventType::SurfaceContentSizeChanged => {
+                result.content_size = IviContentSizeChange {
+                    old_width: self.old_width,
+                    old_height: self.old_height,
+                    new_width: self.new_width,
+                    new_height: self.new_height,
+                };
+            }
+            EventType::AnimationCompleted => {
+                result.animation = IviAnimationCompletedInfo {
+                    animation_id: self.animation_id,
+                    cancelled: self.cancelled,
+                };
+            }
+        }
+
+        // Layer events, and animations that ran on a layer, name a layer
+        if let Some(layer_id) = self.layer_id {
+            result.object_type = IviObjectType::Layer;
+            result.object_id = layer_id;
+        }
+
+        result
+    }
+}
+
+impl IviNotification {
+    /// Decode a raw frame straight into the C notification struct.
+    ///
+    /// Unlike [`Notification::try_from_frame`], no intermediate `Value` is
+    /// built, so decoding an event allocates nothing. Returns `Ok(None)` for
+    /// RPC responses.
+    pub fn try_from_frame(frame: &[u8]) -> Result<Option<Self>> {
+        let frame: NotificationFrame = serde_json::from_slice(frame)?;
+        if frame.id {
+            return Ok(None);
+        }
+
+        let params = frame.params.ok_or_else(|| {
+            IviError::DeserializationError("Missing 'params' field in notification".to_string())
+        })?;
+        Ok(Some(params.into_notification()))
+    }
 }
 
 #[cfg(test)]
@@ -300,6 +608,7 @@ mod tests {
             EventType::LayerDestroyed,
             EventType::LayerVisibilityChanged,
             EventType::LayerOpacityChanged,
+            EventType::AnimationCompleted,
         ];
         for et in &types {
             let s = serde_json::to_string(et).unwrap();
@@ -329,6 +638,47 @@ mod tests {
         assert!(Notification::try_from_frame(frame).is_err());
     }
 
+    #[test]
+    fn test_typed_notification_geometry() {
+        let frame = br#"{"jsonrpc":"2.0","method":"notification","params":{"event_type":"DestinationGeometryChanged","surface_id":1000,"seq":7,"old_rect":{"x":0,"y":0,"width":100,"height":50},"new_rect":{"x":10,"y":20,"width":200,"height":100}}}"#;
+        let notif = IviNotification::try_from_frame(frame).unwrap().unwrap();
+        assert_eq!(notif.event_type, IviEventType::DestinationGeometryChanged);
+        assert_eq!(notif.object_type, IviObjectType::Surface);
+        assert_eq!(notif.object_id, 1000);
+        assert_eq!(notif.dest_geometry.old_rect.width, 100);
+        assert_eq!(notif.dest_geometry.new_rect.x, 10);
+        assert_eq!(notif.dest_geometry.new_rect.height, 100);
+        assert_eq!(notif.src_geometry.new_rect, Rectangle::default());
+    }
+
+    #[test]
+    fn test_typed_notification_layer_and_focus() {
+        let frame = br#"{"params":{"event_type":"LayerOpacityChanged","layer_id":5000,"old_opacity":1.0,"new_opacity":0.5}}"#;
+        let notif = IviNotification::try_from_frame(frame).unwrap().unwrap();
+        assert_eq!(notif.object_type, IviObjectType::Layer);
+        assert_eq!(notif.object_id, 5000);
+        assert_eq!(notif.opacity.new_opacity, 0.5);
+
+        let frame = br#"{"params":{"event_type":"FocusChanged","old_focused_surface":null,"new_focused_surface":1001}}"#;
+        let notif = IviNotification::try_from_frame(frame).unwrap().unwrap();
+        assert_eq!(notif.object_id, 1001);
+        assert_eq!(notif.object_old_id, 0);
+
+        let frame = br#"{"params":{"event_type":"OrientationChanged","surface_id":1,"old_orientation":"Normal","new_orientation":"Rotate270"}}"#;
+        let notif = IviNotification::try_from_frame(frame).unwrap().unwrap();
+        assert_eq!(notif.orientation.new_orientation, IviOrientation::Rotate270);
+    }
+
+    #[test]
+    fn test_typed_notification_skips_rpc_response() {
+        let frame = br#"{"id":1,"result":{"surfaces":[]}}"#;
+        assert!(IviNotification::try_from_frame(frame).unwrap().is_none());
+        let frame = br#"{"id":null,"error":{"code":-32700,"message":"Parse error"}}"#;
+        assert!(IviNotification::try_from_frame(frame).unwrap().is_none());
+        let frame = br#"{"params":{"event_type":"NoSuchEvent"}}"#;
+        assert!(IviNotification::try_from_frame(frame).is_err());
+    }
+
     #[test]
     fn test_request_creation() {
         let request = JsonRpcRequest::new(1, "list_surfaces", json!({}));
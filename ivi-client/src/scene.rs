@@ -0,0 +1,388 @@
+//! Read-only view of the scene through the controller's shared-memory mirror
+//!
+//! The controller publishes every surface and layer in a memory-mapped file
+//! (see `docs/control_interface.md`). An [`IviSceneMap`] maps that file and reads
+//! records with plain loads, so state queries cost no system call and no
+//! round trip through the socket. Mutations and notifications still go
+//! through [`IviClient`](crate::IviClient).
+//!
+//! # Example
+//!
+//! ```no_run
+//! use ivi_client::{Result, IviSceneMap};
+//!
+//! fn main() -> Result<()> {
+//!     let mut scene = IviSceneMap::open(None)?;
+//!     if let Some(surface) = scene.surface(1000)? {
+//!         println!("Surface 1000 at {}", surface.dest_rect);
+//!     }
+//!     Ok(())
+//! }
+//! ```
+
+use std::collections::HashMap;
+use std::path::Path;
+
+use weston_ivi_controller::controller::scene_mirror::{
+    LayerRecord, RectRecord, SurfaceRecord, DEFAULT_SCENE_MIRROR_PATH,
+};
+use weston_ivi_controller::controller::SceneMirrorReader;
+
+use crate::error::{IviError, Result};
+use crate::ffi::{IviLayer, IviOrientation, IviSize, IviSurface, LayerId, Rectangle, SurfaceId};
+
+/// Default path of the scene mirror published by the controller
+pub const DEFAULT_SCENE_PATH: &str = DEFAULT_SCENE_MIRROR_PATH;
+
+/// Slots of one object kind, looked up by ID
+///
+/// The controller may move an object to another slot when it is destroyed
+/// and created again, so a cached slot is checked against the record's ID and
+/// the slots are scanned again on a mismatch.
+#[derive(Default)]
+struct SlotCache {
+    slots: HashMap<u32, usize>,
+    /// Generation of the last full scan, if any
+    scanned: Option<u64>,
+}
+
+impl SlotCache {
+    fn lookup<R>(
+        &mut self,
+        id: u32,
+        generation: u64,
+        capacity: usize,
+        read: impl Fn(usize) -> std::io::Result<Option<R>>,
+        id_of: impl Fn(&R) -> u32,
+    ) -> std::io::Result<Option<R>> {
+        if let Some(&slot) = self.slots.get(&id) {
+            match read(slot)? {
+                Some(record) if id_of(&record) == id => return Ok(Some(record)),
+                _ => {
+                    self.slots.remove(&id);
+                }
+            }
+        }
+
+        // A scan at this generation already found every object there was
+        if self.scanned == Some(generation) {
+            return Ok(None);
+        }
+
+        self.slots.clear();
+        self.scanned = None;
+        let mut found = None;
+        for slot in 0..capacity {
+            if let Some(record) = read(slot)? {
+                let record_id = id_of(&record);
+                self.slots.insert(record_id, slot);
+                if record_id == id {
+                    found = Some(record);
+                }
+            }
+        }
+        self.scanned = Some(generation);
+        Ok(found)
+    }
+}
+
+/// Memory-mapped, read-only view of the controller's scene
+pub struct IviSceneMap {
+    reader: SceneMirrorReader,
+    surfaces: SlotCache,
+    layers: SlotCache,
+}
+
+impl IviSceneMap {
+    /// Map the scene mirror at `path`, or at [`DEFAULT_SCENE_PATH`] if None
+    ///
+    /// Fails if the controller does not publish a mirror there.
+    pub fn open(path: Option<&str>) -> Result<Self> {
+        let path = path.unwrap_or(DEFAULT_SCENE_PATH);
+        let reader = SceneMirrorReader::open(Path::new(path)).map_err(|e| {
+            IviError::ConnectionFailed(format!("Failed to map scene at {}: {}", path, e))
+        })?;
+
+        Ok(Self {
+            reader,
+            surfaces: SlotCache::default(),
+            layers: SlotCache::default(),
+        })
+    }
+
+    /// Scene generation the mirror was last updated to
+    ///
+    /// Comparing generations is enough to tell whether anything changed.
+    pub fn generation(&self) -> u64 {
+        self.reader.generation()
+    }
+
+    /// False once the controller stopped updating the mirror
+    ///
+    /// The controller has shut down or restarted; open the mirror again to
+    /// follow a new instance.
+    pub fn is_live(&self) -> bool {
+        !self.reader.is_closed()
+    }
+
+    /// False while the scene holds more objects than the mirror has room for
+    ///
+    /// Objects missing from an overflowed mirror may still exist, so callers
+    /// should ask the controller through [`IviClient`](crate::IviClient).
+    pub fn is_complete(&self) -> bool {
+        !self.reader.is_overflowed()
+    }
+
+    /// Current properties of a surface, or None if it is not in the scene
+    ///
+    /// Fails if a slot stays in the middle of a write, which happens when the
+    /// controller dies while updating it.
+    pub fn surface(&mut self, id: SurfaceId) -> Result<Option<IviSurface>> {
+        let reader = &self.reader;
+        let record = self.surfaces.lookup(
+            id,
+            reader.generation(),
+            reader.surface_capacity(),
+            |slot| reader.read_surface(slot),
+            |record| record.id,
+        )?;
+        Ok(record.map(surface_from_record))
+    }
+
+    /// Current properties of a layer, or None if it is not in the scene
+    ///
+    /// Fails like [`surface`](Self::surface).
+    pub fn layer(&mut self, id: LayerId) -> Result<Option<IviLayer>> {
+        let reader = &self.reader;
+        let record = self.layers.lookup(
+            id,
+            reader.generation(),
+            reader.layer_capacity(),
+            |slot| reader.read_layer(slot),
+            |record| record.id,
+        )?;
+        Ok(record.map(layer_from_record))
+    }
+
+    /// Every surface in the mirror, in no particular order
+    pub fn surfaces(&self) -> Result<Vec<IviSurface>> {
+        let mut surfaces = Vec::new();
+        for slot in 0..self.reader.surface_capacity() {
+            if let Some(record) = self.reader.read_surface(slot)? {
+                surfaces.push(surface_from_record(record));
+            }
+        }
+        Ok(surfaces)
+    }
+
+    /// Every layer in the mirror, in no particular order
+    pub fn layers(&self) -> Result<Vec<IviLayer>> {
+        let mut layers = Vec::new();
+        for slot in 0..self.reader.layer_capacity() {
+            if let Some(record) = self.reader.read_layer(slot)? {
+                layers.push(layer_from_record(record));
+            }
+        }
+        Ok(layers)
+    }
+}
+
+fn rect_from_record(rect: RectRecord) -> Rectangle {
+    Rectangle {
+        x: rect.x,
+        y: rect.y,
+        width: rect.width,
+        height: rect.height,
+    }
+}
+
+fn orientation_from_record(orientation: u32) -> IviOrientation {
+    match orientation {
+        1 => IviOrientation::Rotate90,
+        2 => IviOrientation::Rotate180,
+        3 => IviOrientation::Rotate270,
+        4 => IviOrientation::Flipped,
+        5 => IviOrientation::Flipped90,
+        6 => IviOrientation::Flipped180,
+        7 => IviOrientation::Flipped270,
+        _ => IviOrientation::Normal,
+    }
+}
+
+fn surface_from_record(record: SurfaceRecord) -> IviSurface {
+    IviSurface {
+        id: record.id,
+        orig_size: IviSize {
+            width: record.orig_width,
+            height: record.orig_height,
+        },
+        src_rect: rect_from_record(record.src_rect),
+        dest_rect: rect_from_record(record.dest_rect),
+        visibility: record.visibility != 0,
+        opacity: record.opacity,
+        orientation: orientation_from_record(record.orientation),
+        z_order: record.z_order,
+    }
+}
+
+fn layer_from_record(record: LayerRecord) -> IviLayer {
+    IviLayer {
+        id: record.id,
+        src_rect: rect_from_record(record.src_rect),
+        dest_rect: rect_from_record(record.dest_rect),
+        visibility: record.visibility != 0,
+        opacity: record.opacity,
+        orientation: orientation_from_record(record.orientation),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::mem::{offset_of, size_of};
+    use std::sync::Arc;
+    use weston_ivi_controller::controller::state::{LayerState, StateManager, SurfaceState};
+    use weston_ivi_controller::controller::SceneMirror;
+    use weston_ivi_controller::ffi::bindings::ivi_layout_api::IviLayoutApi;
+    use weston_ivi_controller::ffi::bindings::{Orientation, Rectangle as ControllerRectangle};
+
+    #[test]
+    fn mirror_records_match_the_c_structs() {
+        assert_eq!(size_of::<SurfaceRecord>(), size_of::<IviSurface>());
+        assert_eq!(offset_of!(SurfaceRecord, id), offset_of!(IviSurface, id));
+        assert_eq!(
+            offset_of!(SurfaceRecord, orig_width),
+            offset_of!(IviSurface, orig_size)
+        );
+        assert_eq!(
+            offset_of!(SurfaceRecord, src_rect),
+            offset_of!(IviSurface, src_rect)
+        );
+        assert_eq!(
+            offset_of!(SurfaceRecord, dest_rect),
+            offset_of!(IviSurface, dest_rect)
+        );
+        assert_eq!(
+            offset_of!(SurfaceRecord, visibility),
+            offset_of!(IviSurface, visibility)
+        );
+        assert_eq!(
+            offset_of!(SurfaceRecord, opacity),
+            offset_of!(IviSurface, opacity)
+        );
+        assert_eq!(
+            offset_of!(SurfaceRecord, orientation),
+            offset_of!(IviSurface, orientation)
+        );
+        assert_eq!(
+            offset_of!(SurfaceRecord, z_order),
+            offset_of!(IviSurface, z_order)
+        );
+
+        assert_eq!(size_of::<LayerRecord>(), size_of::<IviLayer>());
+        assert_eq!(
+            offset_of!(LayerRecord, src_rect),
+            offset_of!(IviLayer, src_rect)
+        );
+        assert_eq!(
+            offset_of!(LayerRecord, dest_rect),
+            offset_of!(IviLayer, dest_rect)
+        );
+        assert_eq!(
+            offset_of!(LayerRecord, visibility),
+            offset_of!(IviLayer, visibility)
+        );
+        assert_eq!(
+            offset_of!(LayerRecord, opacity),
+            offset_of!(IviLayer, opacity)
+        );
+        assert_eq!(
+            offset_of!(LayerRecord, orientation),
+            offset_of!(IviLayer, orientation)
+        );
+    }
+
+    fn surface_state(id: u32, width: i32) -> SurfaceState {
+        SurfaceState {
+            id,
+            orig_size: (1920, 1080),
+            src_rect: ControllerRectangle {
+                x: 0,
+                y: 0,
+                width: 1920,
+                height: 1080,
+            },
+            dest_rect: ControllerRectangle {
+                x: 10,
+                y: 20,
+                width,
+                height: 540,
+            },
+            visibility: true,
+            opacity: 0.75,
+            orientation: Orientation::Rotate180,
+            z_order: 2,
+            is_auto_assigned: false,
+            original_id: None,
+        }
+    }
+
+    #[test]
+    fn reads_the_scene_published_by_the_controller() {
+        let path = std::env::temp_dir().join(format!("ivi-scene-map-{}", std::process::id()));
+        let ivi_api = Arc::new(IviLayoutApi::from_raw(std::ptr::dangling()).unwrap());
+        let sm = StateManager::new(ivi_api);
+        sm.attach_scene_mirror(SceneMirror::create(&path).unwrap());
+        sm.add_surface(1000, surface_state(1000, 960));
+        sm.add_layer(
+            5000,
+            LayerState {
+                id: 5000,
+                visibility: true,
+                opacity: 1.0,
+                src_rect: (0, 0, 1920, 1080),
+                dest_rect: (0, 0, 1920, 1080),
+                orientation: Orientation::Normal,
+            },
+        );
+
+        let mut scene = IviSceneMap::open(path.to_str()).unwrap();
+        assert!(scene.is_live());
+        assert!(scene.is_complete());
+        assert_eq!(scene.generation(), sm.snapshot().generation);
+
+        let surface = scene.surface(1000).unwrap().unwrap();
+        assert_eq!(surface.orig_size.width, 1920);
+        assert_eq!(surface.dest_rect.x, 10);
+        assert_eq!(surface.dest_rect.width, 960);
+        assert!(surface.visibility);
+        assert_eq!(surface.opacity, 0.75);
+        assert_eq!(surface.orientation, IviOrientation::Rotate180);
+        assert_eq!(surface.z_order, 2);
+        assert_eq!(scene.layer(5000).unwrap().unwrap().dest_rect.width, 1920);
+        assert!(scene.surface(1001).unwrap().is_none());
+
+        // Changes are visible without reopening, through the cached slot
+        sm.update_surface(1000, surface_state(1000, 480));
+        assert_eq!(scene.surface(1000).unwrap().unwrap().dest_rect.width, 480);
+
+        // Objects created after a miss are found on the next generation
+        sm.add_surface(1001, surface_state(1001, 100));
+        assert_eq!(scene.surface(1001).unwrap().unwrap().dest_rect.width, 100);
+        sm.remove_surface(1000);
+        assert!(scene.surface(1000).unwrap().is_none());
+        assert_eq!(scene.surfaces().unwrap().len(), 1);
+        assert_eq!(scene.layers().unwrap().len(), 1);
+
+        drop(sm);
+        assert!(!scene.is_live());
+    }
+
+    #[test]
+    fn open_fails_without_a_mirror() {
+        assert!(matches!(
+            IviSceneMap::open(Some("/nonexistent/ivi.scene")),
+            Err(IviError::ConnectionFailed(_))
+        ));
+    }
+}
@@ -18,7 +18,493 @@ fn test_connection_to_nonexistent_socket() {
     }
 }
 
+/// Serve one batch request on `socket_path`, failing the request with `failing_id`
+#[cfg(not(feature = "enable-ipcon"))]
+fn serve_one_batch(socket_path: &str, failing_id: u64) -> std::thread::JoinHandle<usize> {
+    use std::os::unix::net::UnixListener;
+    use weston_ivi_controller::rpc::framing::{write_frame, FrameReadResult, FrameReader};
+
+    let _ = std::fs::remove_file(socket_path);
+    let listener = UnixListener::bind(socket_path).expect("Failed to bind");
+
+    std::thread::spawn(move || {
+        let (mut stream, _) = listener.accept().expect("Failed to accept");
+        let mut reader = FrameReader::new();
+        let request = match reader.read_frame(&mut stream).expect("Failed to read") {
+            FrameReadResult::Complete(data) => data,
+            _ => panic!("Expected a complete frame"),
+        };
+
+        let requests: Vec<serde_json::Value> =
+            serde_json::from_slice(&request).expect("Expected a batch array");
+        let responses: Vec<serde_json::Value> = requests
+            .iter()
+            .map(|r| {
+                let id = r["id"].as_u64().unwrap();
+                if id == failing_id {
+                    serde_json::json!({ "id": id, "error": { "code": -32000, "message": "Surface not found: 7" } })
+                } else {
+                    serde_json::json!({ "id": id, "result": { "success": true } })
+                }
+            })
+            .collect();
+
+        write_frame(&mut stream, &serde_json::to_vec(&responses).unwrap()).unwrap();
+        requests.len()
+    })
+}
+
+#[cfg(not(feature = "enable-ipcon"))]
+#[test]
+fn test_submit_batch_sends_one_frame() {
+    let socket_path = "/tmp/test-ivi-client-batch.sock";
+    let server = serve_one_batch(socket_path, 0);
+
+    let mut client = IviClient::new(Some(socket_path)).expect("Failed to connect");
+    let mut batch = client.batch();
+    batch
+        .set_surface_visibility(1000, true)
+        .set_surface_opacity(1000, 0.5)
+        .set_layer_visibility(10, true);
+    client.submit_batch(batch).expect("Batch failed");
+
+    // Three changes plus the trailing commit
+    assert_eq!(server.join().unwrap(), 4);
+    let _ = std::fs::remove_file(socket_path);
+}
+
+#[cfg(not(feature = "enable-ipcon"))]
+#[test]
+fn test_submit_batch_reports_failed_change() {
+    let socket_path = "/tmp/test-ivi-client-batch-error.sock";
+    // Request IDs start at 1, so the second change fails
+    let server = serve_one_batch(socket_path, 2);
+
+    let mut client = IviClient::new(Some(socket_path)).expect("Failed to connect");
+    let mut batch = client.batch();
+    batch
+        .set_surface_visibility(1000, true)
+        .set_surface_visibility(7, true);
+
+    match client.submit_batch(batch) {
+        Err(IviError::RequestFailed { code, message }) => {
+            assert_eq!(code, -32000);
+            assert!(message.starts_with("set_surface_visibility"));
+        }
+        other => panic!("Expected RequestFailed, got {:?}", other.map(|_| ())),
+    }
+
+    server.join().unwrap();
+    let _ = std::fs::remove_file(socket_path);
+}
+
 // Note: Full end-to-end tests with a real IVI controller would require
 // a running Weston instance with the IVI controller plugin loaded.
 // Those tests would be added in a separate test suite that can be run
 // in a proper test environment.
+
+/// Read `count` requests on `socket_path`, then send a notification followed
+/// by the responses in reverse order. The stream is handed back open.
+#[cfg(not(feature = "enable-ipcon"))]
+fn serve_reversed(
+    socket_path: &str,
+    count: usize,
+) -> std::thread::JoinHandle<std::os::unix::net::UnixStream> {
+    use std::os::unix::net::UnixListener;
+    use weston_ivi_controller::rpc::framing::{write_frame, FrameReadResult, FrameReader};
+
+    let _ = std::fs::remove_file(socket_path);
+    let listener = UnixListener::bind(socket_path).expect("Failed to bind");
+
+    std::thread::spawn(move || {
+        let (mut stream, _) = listener.accept().expect("Failed to accept");
+        let mut reader = FrameReader::new();
+        let mut ids = Vec::new();
+        while ids.len() < count {
+            if let FrameReadResult::Complete(data) =
+                reader.read_frame(&mut stream).expect("Failed to read")
+            {
+                let request: serde_json::Value = serde_json::from_slice(&data).unwrap();
+                ids.push(request["id"].as_u64().unwrap());
+            }
+        }
+
+        let notification = serde_json::json!({
+            "method": "notification",
+            "params": { "event_type": "SurfaceCreated", "surface_id": 1000 }
+        });
+        write_frame(&mut stream, &serde_json::to_vec(&notification).unwrap()).unwrap();
+
+        for id in ids.into_iter().rev() {
+            let response = serde_json::json!({ "id": id, "result": { "id": id } });
+            write_frame(&mut stream, &serde_json::to_vec(&response).unwrap()).unwrap();
+        }
+        stream
+    })
+}
+
+#[cfg(not(feature = "enable-ipcon"))]
+#[test]
+fn test_pipelined_requests_complete_out_of_order() {
+    use std::sync::{Arc, Mutex};
+
+    let socket_path = "/tmp/test-ivi-client-pipelined.sock";
+    let server = serve_reversed(socket_path, 3);
+
+    let mut client = IviClient::new(Some(socket_path)).expect("Failed to connect");
+    let notified = Arc::new(Mutex::new(0));
+    let notified_clone = Arc::clone(&notified);
+    client.set_notification_callback(move |_| *notified_clone.lock().unwrap() += 1);
+
+    let first = client
+        .submit("get_surface", serde_json::json!({ "id": 1 }))
+        .unwrap();
+    let second = client
+        .submit("get_surface", serde_json::json!({ "id": 2 }))
+        .unwrap();
+    let called = Arc::new(Mutex::new(None));
+    let called_clone = Arc::clone(&called);
+    let third = client
+        .submit_with(
+            "get_surface",
+            serde_json::json!({ "id": 3 }),
+            move |id, r| {
+                *called_clone.lock().unwrap() = Some((id, r.unwrap()["id"].as_u64().unwrap()));
+            },
+        )
+        .unwrap();
+    assert_eq!(client.pending_count(), 3);
+
+    // Waiting for the first response dispatches the two answered before it
+    let first_id = first.id();
+    assert_eq!(client.wait(first).unwrap()["id"], first_id);
+    assert!(second.is_ready());
+    assert_eq!(*called.lock().unwrap(), Some((third, third)));
+    assert_eq!(*notified.lock().unwrap(), 1);
+    assert_eq!(client.pending_count(), 0);
+
+    server.join().unwrap();
+    let _ = std::fs::remove_file(socket_path);
+}
+
+#[cfg(not(feature = "enable-ipcon"))]
+#[test]
+fn test_poll_completes_requests_without_blocking() {
+    let socket_path = "/tmp/test-ivi-client-poll.sock";
+    let server = serve_reversed(socket_path, 2);
+
+    let mut client = IviClient::new(Some(socket_path)).expect("Failed to connect");
+    assert!(client.raw_fd().is_some());
+
+    let first = client
+        .submit("list_surfaces", serde_json::json!({}))
+        .unwrap();
+    let second = client.submit("list_layers", serde_json::json!({})).unwrap();
+    let _stream = server.join().unwrap();
+
+    let mut completed = 0;
+    while completed < 2 {
+        completed += client.poll().expect("Poll failed");
+    }
+
+    assert!(first.try_take().unwrap().is_ok());
+    assert!(second.try_take().unwrap().is_ok());
+    assert_eq!(client.poll().unwrap(), 0);
+    let _ = std::fs::remove_file(socket_path);
+}
+
+#[cfg(not(feature = "enable-ipcon"))]
+#[test]
+fn test_set_encoding_switches_to_msgpack() {
+    use ivi_client::Encoding;
+    use std::os::unix::net::UnixListener;
+    use weston_ivi_controller::rpc::framing::{write_frame, FrameReadResult, FrameReader};
+    use weston_ivi_controller::rpc::msgpack;
+
+    let socket_path = "/tmp/test-ivi-client-encoding.sock";
+    let _ = std::fs::remove_file(socket_path);
+    let listener = UnixListener::bind(socket_path).expect("Failed to bind");
+
+    let server = std::thread::spawn(move || {
+        let (mut stream, _) = listener.accept().expect("Failed to accept");
+        let mut reader = FrameReader::new();
+        let mut next_frame = |stream: &mut std::os::unix::net::UnixStream| loop {
+            if let FrameReadResult::Complete(data) = reader.read_frame(stream).unwrap() {
+                return data;
+            }
+        };
+
+        // Handshake in JSON, answered in JSON
+        let handshake: serde_json::Value =
+            serde_json::from_slice(&next_frame(&mut stream)).unwrap();
+        assert_eq!(handshake["method"], "handshake");
+        assert_eq!(handshake["params"]["encodings"][0], "msgpack");
+        let response =
+            serde_json::json!({ "id": handshake["id"], "result": { "encoding": "msgpack" } });
+        write_frame(&mut stream, &serde_json::to_vec(&response).unwrap()).unwrap();
+
+        // Everything after that is MessagePack
+        let request = msgpack::decode(&next_frame(&mut stream)).expect("Expected MessagePack");
+        assert_eq!(request["method"], "list_surfaces");
+        let response = serde_json::json!({ "id": request["id"], "result": { "surfaces": [] } });
+        write_frame(&mut stream, &msgpack::to_vec(&response)).unwrap();
+    });
+
+    let mut client = IviClient::new(Some(socket_path)).expect("Failed to connect");
+    assert_eq!(client.encoding(), Encoding::Json);
+    client
+        .set_encoding(Encoding::MessagePack)
+        .expect("Handshake failed");
+    assert_eq!(client.encoding(), Encoding::MessagePack);
+    assert!(client.list_surfaces().unwrap().is_empty());
+
+    server.join().unwrap();
+    let _ = std::fs::remove_file(socket_path);
+}
+
+/// Counts heap allocations made by the current thread
+#[cfg(not(feature = "enable-ipcon"))]
+mod alloc_counter {
+    use std::alloc::{GlobalAlloc, Layout, System};
+    use std::cell::Cell;
+
+    thread_local! {
+        static ALLOCATIONS: Cell<usize> = const { Cell::new(0) };
+    }
+
+    pub struct CountingAllocator;
+
+    unsafe impl GlobalAlloc for CountingAllocator {
+        unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+            ALLOCATIONS.with(|count| count.set(count.get() + 1));
+            System.alloc(layout)
+        }
+
+        unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+            System.dealloc(ptr, layout)
+        }
+
+        unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+            ALLOCATIONS.with(|count| count.set(count.get() + 1));
+            System.realloc(ptr, layout, new_size)
+        }
+    }
+
+    pub fn allocations() -> usize {
+        ALLOCATIONS.with(|count| count.get())
+    }
+}
+
+#[cfg(not(feature = "enable-ipcon"))]
+#[global_allocator]
+static ALLOCATOR: alloc_counter::CountingAllocator = alloc_counter::CountingAllocator;
+
+#[cfg(not(feature = "enable-ipcon"))]
+#[test]
+fn test_list_surfaces_into_caller_buffer() {
+    use ivi_client::IviSurface;
+    use std::os::unix::net::UnixListener;
+    use weston_ivi_controller::rpc::framing::{write_frame, FrameReadResult, FrameReader};
+
+    const CALLS: usize = 4;
+    let socket_path = "/tmp/test-ivi-client-list-into.sock";
+    let _ = std::fs::remove_file(socket_path);
+    let listener = UnixListener::bind(socket_path).expect("Failed to bind");
+
+    let server = std::thread::spawn(move || {
+        let (mut stream, _) = listener.accept().expect("Failed to accept");
+        let mut reader = FrameReader::new();
+        let surfaces: Vec<serde_json::Value> = (0..3)
+            .map(|i| {
+                serde_json::json!({
+                    "id": 1000 + i,
+                    "orig_size": { "width": 1920, "height": 1080 },
+                    "src_rect": { "x": 0, "y": 0, "width": 1920, "height": 1080 },
+                    "dest_rect": { "x": i * 100, "y": 0, "width": 640, "height": 360 },
+                    "visibility": true,
+                    "opacity": 1.0,
+                    "orientation": "Rotate90",
+                    "z_order": i
+                })
+            })
+            .collect();
+
+        for call in 0..CALLS {
+            let request = loop {
+                if let FrameReadResult::Complete(data) = reader.read_frame(&mut stream).unwrap() {
+                    break serde_json::from_slice::<serde_json::Value>(&data).unwrap();
+                }
+            };
+            assert_eq!(request["method"], "list_surfaces");
+
+            // Frames for others are dispatched while waiting for the response
+            if call == 0 {
+                let notification = serde_json::json!({
+                    "method": "notification",
+                    "params": { "event_type": "SurfaceCreated", "surface_id": 1002 }
+                });
+                write_frame(&mut stream, &serde_json::to_vec(&notification).unwrap()).unwrap();
+            }
+
+            let response =
+                serde_json::json!({ "id": request["id"], "result": { "surfaces": surfaces } });
+            write_frame(&mut stream, &serde_json::to_vec(&response).unwrap()).unwrap();
+        }
+    });
+
+    let mut client = IviClient::new(Some(socket_path)).expect("Failed to connect");
+
+    // Too small: the first two are written and the total is reported
+    let mut buf = vec![IviSurface::default(); 2];
+    assert_eq!(client.list_surfaces_into(&mut buf).unwrap(), 3);
+    assert_eq!(buf[0].id, 1000);
+    assert_eq!(buf[1].dest_rect.x, 100);
+    assert_eq!(buf[1].orientation, ivi_client::IviOrientation::Rotate90);
+
+    let mut buf = vec![IviSurface::default(); 8];
+    assert_eq!(client.list_surfaces_into(&mut buf).unwrap(), 3);
+    assert_eq!(buf[2].z_order, 2);
+
+    // Buffers have grown to fit, so further calls do not allocate
+    let before = alloc_counter::allocations();
+    for _ in 2..CALLS {
+        assert_eq!(client.list_surfaces_into(&mut buf).unwrap(), 3);
+    }
+    assert_eq!(alloc_counter::allocations(), before);
+
+    server.join().unwrap();
+    let _ = std::fs::remove_file(socket_path);
+}
+
+/// Answer the subscription on `socket_path` and send a notification in the
+/// same write, then one more for every message received on `more`.
+#[cfg(not(feature = "enable-ipcon"))]
+fn serve_notifications(
+    socket_path: &str,
+    more: std::sync::mpsc::Receiver<u32>,
+) -> std::thread::JoinHandle<()> {
+    use std::io::Write;
+    use std::os::unix::net::UnixListener;
+    use weston_ivi_controller::rpc::framing::{write_frame, FrameReadResult, FrameReader};
+
+    let _ = std::fs::remove_file(socket_path);
+    let listener = UnixListener::bind(socket_path).expect("Failed to bind");
+
+    let visibility = |surface_id: u32| {
+        serde_json::to_vec(&serde_json::json!({
+            "jsonrpc": "2.0",
+            "method": "notification",
+            "params": {
+                "event_type": "VisibilityChanged",
+                "surface_id": surface_id,
+                "old_visibility": false,
+                "new_visibility": true
+            }
+        }))
+        .unwrap()
+    };
+
+    std::thread::spawn(move || {
+        let (mut stream, _) = listener.accept().expect("Failed to accept");
+        let mut reader = FrameReader::new();
+        let request = match reader.read_frame(&mut stream).expect("Failed to read") {
+            FrameReadResult::Complete(data) => data,
+            _ => panic!("Expected a complete frame"),
+        };
+        let request: serde_json::Value = serde_json::from_slice(&request).unwrap();
+        assert_eq!(request["method"], "subscribe");
+
+        let mut out = Vec::new();
+        let response = serde_json::json!({ "id": request["id"], "result": { "success": true } });
+        write_frame(&mut out, &serde_json::to_vec(&response).unwrap()).unwrap();
+        write_frame(&mut out, &visibility(1000)).unwrap();
+        stream.write_all(&out).unwrap();
+
+        for surface_id in more {
+            write_frame(&mut stream, &visibility(surface_id)).unwrap();
+        }
+    })
+}
+
+#[cfg(not(feature = "enable-ipcon"))]
+#[test]
+fn test_notification_listener_dispatch_from_caller_loop() {
+    use ivi_client::{EventType, NotificationListener};
+    use std::sync::{Arc, Mutex};
+
+    let socket_path = "/tmp/test-ivi-client-listener-dispatch.sock";
+    let (more, rx) = std::sync::mpsc::channel();
+    let server = serve_notifications(socket_path, rx);
+
+    let seen = Arc::new(Mutex::new(Vec::new()));
+    let mut listener = NotificationListener::new(Some(socket_path)).expect("Failed to connect");
+    let sink = Arc::clone(&seen);
+    listener.on_typed(EventType::VisibilityChanged, move |notif| {
+        assert!(notif.visibility.new_visibility);
+        sink.lock().unwrap().push(notif.object_id);
+    });
+    listener
+        .subscribe(&[EventType::VisibilityChanged])
+        .expect("Subscribe failed");
+    assert!(!listener.is_running());
+    assert!(listener.raw_fd().is_some());
+
+    // The first notification arrived with the subscription reply
+    assert_eq!(listener.dispatch().unwrap(), 1);
+    assert_eq!(listener.dispatch().unwrap(), 0);
+
+    more.send(1001).unwrap();
+    let mut dispatched = 0;
+    for _ in 0..500 {
+        dispatched += listener.dispatch().unwrap();
+        if dispatched > 0 {
+            break;
+        }
+        std::thread::sleep(std::time::Duration::from_millis(2));
+    }
+    assert_eq!(*seen.lock().unwrap(), vec![1000, 1001]);
+
+    drop(more);
+    drop(listener);
+    server.join().unwrap();
+    let _ = std::fs::remove_file(socket_path);
+}
+
+#[cfg(not(feature = "enable-ipcon"))]
+#[test]
+fn test_notification_listener_thread_stops_promptly() {
+    use ivi_client::{EventType, NotificationListener};
+    use std::sync::mpsc;
+    use std::time::{Duration, Instant};
+
+    let socket_path = "/tmp/test-ivi-client-listener-thread.sock";
+    let (more, rx) = mpsc::channel();
+    let server = serve_notifications(socket_path, rx);
+
+    let (seen_tx, seen) = mpsc::channel();
+    let seen_tx = std::sync::Mutex::new(seen_tx);
+    let mut listener = NotificationListener::new(Some(socket_path)).expect("Failed to connect");
+    listener.on_all_typed(move |notif| {
+        seen_tx.lock().unwrap().send(notif.object_id).unwrap();
+    });
+    listener
+        .start(&[EventType::VisibilityChanged])
+        .expect("Start failed");
+
+    let timeout = Duration::from_secs(5);
+    assert_eq!(seen.recv_timeout(timeout).unwrap(), 1000);
+    more.send(1001).unwrap();
+    assert_eq!(seen.recv_timeout(timeout).unwrap(), 1001);
+
+    // An idle thread blocks in poll(2) and is woken rather than timing out
+    assert!(listener.dispatch().is_err());
+    let start = Instant::now();
+    listener.stop();
+    assert!(start.elapsed() < Duration::from_millis(50));
+    assert!(!listener.is_running());
+
+    drop(more);
+    drop(listener);
+    server.join().unwrap();
+    let _ = std::fs::remove_file(socket_path);
+}
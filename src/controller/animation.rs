@@ -0,0 +1,383 @@
+// Property animations stepped by the compositor frame clock
+
+use crate::ffi::bindings::Rectangle;
+use std::str::FromStr;
+use std::sync::Mutex;
+use std::time::{Duration, Instant};
+
+/// Easing curve applied to the progress of an animation
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum Easing {
+    #[default]
+    Linear,
+    /// Cubic, starting slowly
+    EaseIn,
+    /// Cubic, ending slowly
+    EaseOut,
+    /// Cubic, starting and ending slowly
+    EaseInOut,
+}
+
+impl Easing {
+    /// Name used in the RPC protocol
+    pub fn name(self) -> &'static str {
+        match self {
+            Easing::Linear => "linear",
+            Easing::EaseIn => "ease_in",
+            Easing::EaseOut => "ease_out",
+            Easing::EaseInOut => "ease_in_out",
+        }
+    }
+
+    /// Eased progress for the linear progress `t`, both in [0, 1]
+    pub fn apply(self, t: f32) -> f32 {
+        let t = t.clamp(0.0, 1.0);
+        match self {
+            Easing::Linear => t,
+            Easing::EaseIn => t * t * t,
+            Easing::EaseOut => 1.0 - (1.0 - t).powi(3),
+            Easing::EaseInOut => {
+                if t < 0.5 {
+                    4.0 * t * t * t
+                } else {
+                    1.0 - (2.0 - 2.0 * t).powi(3) / 2.0
+                }
+            }
+        }
+    }
+}
+
+impl FromStr for Easing {
+    type Err = String;
+
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        match s {
+            "linear" => Ok(Easing::Linear),
+            "ease_in" => Ok(Easing::EaseIn),
+            "ease_out" => Ok(Easing::EaseOut),
+            "ease_in_out" => Ok(Easing::EaseInOut),
+            _ => Err(format!("Unknown easing: {}", s)),
+        }
+    }
+}
+
+/// Object an animation applies to
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum AnimationTarget {
+    Surface(u32),
+    Layer(u32),
+}
+
+/// Animatable properties; `None` leaves a property alone
+#[derive(Debug, Clone, Copy, PartialEq, Default)]
+pub struct AnimatedProperties {
+    pub destination: Option<Rectangle>,
+    pub opacity: Option<f32>,
+}
+
+impl AnimatedProperties {
+    /// Returns true if both animate at least one common property
+    fn overlaps(&self, other: &AnimatedProperties) -> bool {
+        (self.destination.is_some() && other.destination.is_some())
+            || (self.opacity.is_some() && other.opacity.is_some())
+    }
+
+    /// Values at eased progress `t` on the way from `from` to `to`
+    fn interpolate(from: &AnimatedProperties, to: &AnimatedProperties, t: f32) -> Self {
+        let lerp = |a: f32, b: f32| a + (b - a) * t;
+        let lerp_i32 = |a: i32, b: i32| lerp(a as f32, b as f32).round() as i32;
+
+        Self {
+            destination: to.destination.map(|end| {
+                let start = from.destination.unwrap_or(end);
+                Rectangle {
+                    x: lerp_i32(start.x, end.x),
+                    y: lerp_i32(start.y, end.y),
+                    width: lerp_i32(start.width, end.width),
+                    height: lerp_i32(start.height, end.height),
+                }
+            }),
+            opacity: to.opacity.map(|end| lerp(from.opacity.unwrap_or(end), end)),
+        }
+    }
+}
+
+/// Values to apply to one target in the current frame
+#[derive(Debug, Clone, PartialEq)]
+pub struct AnimationStep {
+    pub target: AnimationTarget,
+    pub values: AnimatedProperties,
+}
+
+/// An animation that reached its end or was cancelled
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct FinishedAnimation {
+    pub id: u64,
+    pub target: AnimationTarget,
+    pub cancelled: bool,
+}
+
+struct Animation {
+    id: u64,
+    target: AnimationTarget,
+    from: AnimatedProperties,
+    to: AnimatedProperties,
+    easing: Easing,
+    start: Instant,
+    duration: Duration,
+}
+
+impl Animation {
+    fn finished(&self, cancelled: bool) -> FinishedAnimation {
+        FinishedAnimation {
+            id: self.id,
+            target: self.target,
+            cancelled,
+        }
+    }
+}
+
+#[derive(Default)]
+struct AnimatorState {
+    next_id: u64,
+    running: Vec<Animation>,
+}
+
+/// Running property animations of surfaces and layers.
+///
+/// Animations are started by RPC handlers and stepped once per output frame
+/// on the compositor thread, which applies the returned values and commits.
+#[derive(Default)]
+pub struct Animator {
+    state: Mutex<AnimatorState>,
+}
+
+impl Animator {
+    /// Create an animator with no running animations
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Animate `target` from its current values `from` to `to`.
+    ///
+    /// Only the properties set in `to` are animated. Running animations of
+    /// the same target that animate any of them are cancelled and returned
+    /// together with the ID of the new animation.
+    pub fn start(
+        &self,
+        target: AnimationTarget,
+        from: AnimatedProperties,
+        to: AnimatedProperties,
+        duration: Duration,
+        easing: Easing,
+        now: Instant,
+    ) -> (u64, Vec<FinishedAnimation>) {
+        let mut state = self.state.lock().unwrap();
+
+        let mut cancelled = Vec::new();
+        state.running.retain(|animation| {
+            let replaced = animation.target == target && animation.to.overlaps(&to);
+            if replaced {
+                cancelled.push(animation.finished(true));
+            }
+            !replaced
+        });
+
+        state.next_id += 1;
+        let id = state.next_id;
+        state.running.push(Animation {
+            id,
+            target,
+            from,
+            to,
+            easing,
+            start: now,
+            duration,
+        });
+
+        (id, cancelled)
+    }
+
+    /// Cancel every running animation of `target`
+    pub fn cancel(&self, target: AnimationTarget) -> Vec<FinishedAnimation> {
+        let mut state = self.state.lock().unwrap();
+        let mut cancelled = Vec::new();
+        state.running.retain(|animation| {
+            if animation.target == target {
+                cancelled.push(animation.finished(true));
+                false
+            } else {
+                true
+            }
+        });
+        cancelled
+    }
+
+    /// Number of running animations
+    pub fn running_count(&self) -> usize {
+        self.state.lock().unwrap().running.len()
+    }
+
+    /// Advance every animation to `now`.
+    ///
+    /// Returns the values to apply in this frame, and the animations that
+    /// reached their end with it. Those are removed after their final step.
+    pub fn step(&self, now: Instant) -> (Vec<AnimationStep>, Vec<FinishedAnimation>) {
+        let mut state = self.state.lock().unwrap();
+        let mut steps = Vec::with_capacity(state.running.len());
+        let mut finished = Vec::new();
+
+        state.running.retain(|animation| {
+            let elapsed = now.saturating_duration_since(animation.start);
+            let progress = if animation.duration.is_zero() {
+                1.0
+            } else {
+                (elapsed.as_secs_f32() / animation.duration.as_secs_f32()).min(1.0)
+            };
+
+            let done = progress >= 1.0;
+            let values = if done {
+                animation.to
+            } else {
+                AnimatedProperties::interpolate(
+                    &animation.from,
+                    &animation.to,
+                    animation.easing.apply(progress),
+                )
+            };
+            steps.push(AnimationStep {
+                target: animation.target,
+                values,
+            });
+
+            if done {
+                finished.push(animation.finished(false));
+            }
+            !done
+        });
+
+        (steps, finished)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn rect(x: i32, y: i32, width: i32, height: i32) -> Rectangle {
+        Rectangle {
+            x,
+            y,
+            width,
+            height,
+        }
+    }
+
+    #[test]
+    fn test_easing_curves() {
+        for easing in [
+            Easing::Linear,
+            Easing::EaseIn,
+            Easing::EaseOut,
+            Easing::EaseInOut,
+        ] {
+            assert_eq!(easing.apply(0.0), 0.0);
+            assert_eq!(easing.apply(1.0), 1.0);
+            assert_eq!(easing.name().parse::<Easing>(), Ok(easing));
+        }
+        assert_eq!(Easing::EaseInOut.apply(0.5), 0.5);
+        assert!(Easing::EaseIn.apply(0.5) < 0.5);
+        assert!(Easing::EaseOut.apply(0.5) > 0.5);
+        assert!("bounce".parse::<Easing>().is_err());
+    }
+
+    #[test]
+    fn test_step_interpolates_and_finishes() {
+        let animator = Animator::new();
+        let start = Instant::now();
+        let (id, cancelled) = animator.start(
+            AnimationTarget::Surface(1000),
+            AnimatedProperties {
+                destination: Some(rect(0, 0, 100, 100)),
+                opacity: Some(0.0),
+            },
+            AnimatedProperties {
+                destination: Some(rect(100, 50, 200, 100)),
+                opacity: Some(1.0),
+            },
+            Duration::from_millis(100),
+            Easing::Linear,
+            start,
+        );
+        assert!(cancelled.is_empty());
+
+        let (steps, finished) = animator.step(start + Duration::from_millis(50));
+        assert!(finished.is_empty());
+        assert_eq!(steps.len(), 1);
+        assert_eq!(steps[0].values.destination, Some(rect(50, 25, 150, 100)));
+        assert_eq!(steps[0].values.opacity, Some(0.5));
+
+        // The last step lands exactly on the target values
+        let (steps, finished) = animator.step(start + Duration::from_millis(130));
+        assert_eq!(steps[0].values.destination, Some(rect(100, 50, 200, 100)));
+        assert_eq!(steps[0].values.opacity, Some(1.0));
+        assert_eq!(
+            finished,
+            vec![FinishedAnimation {
+                id,
+                target: AnimationTarget::Surface(1000),
+                cancelled: false
+            }]
+        );
+        assert_eq!(animator.running_count(), 0);
+    }
+
+    #[test]
+    fn test_start_replaces_overlapping_animations() {
+        let animator = Animator::new();
+        let now = Instant::now();
+        let opacity = |value| AnimatedProperties {
+            destination: None,
+            opacity: Some(value),
+        };
+        let target = AnimationTarget::Layer(10);
+
+        let (fade, _) = animator.start(
+            target,
+            opacity(1.0),
+            opacity(0.0),
+            Duration::from_secs(1),
+            Easing::Linear,
+            now,
+        );
+        // A different property of the same target runs alongside
+        let (_, cancelled) = animator.start(
+            target,
+            AnimatedProperties::default(),
+            AnimatedProperties {
+                destination: Some(rect(0, 0, 10, 10)),
+                opacity: None,
+            },
+            Duration::from_secs(1),
+            Easing::Linear,
+            now,
+        );
+        assert!(cancelled.is_empty());
+
+        let (_, cancelled) = animator.start(
+            target,
+            opacity(0.5),
+            opacity(1.0),
+            Duration::from_secs(1),
+            Easing::Linear,
+            now,
+        );
+        assert_eq!(cancelled.len(), 1);
+        assert_eq!(cancelled[0].id, fade);
+        assert!(cancelled[0].cancelled);
+        assert_eq!(animator.running_count(), 2);
+
+        assert_eq!(animator.cancel(target).len(), 2);
+        assert_eq!(animator.running_count(), 0);
+    }
+}
@@ -6,29 +6,35 @@ use crate::ffi::bindings::ivi_layer::IviLayer;
 use crate::ffi::bindings::ivi_layout_api::IviLayoutApi;
 use crate::ffi::bindings::ivi_surface::IviSurface;
 use crate::ffi::bindings::*;
+use crate::metrics::{metrics, CallbackKind};
 #[allow(unused)]
 use jlogger_tracing::{jdebug, jerror, jinfo, jwarn};
 use std::collections::HashMap;
 use std::os::raw::c_void;
 use std::sync::{Arc, Mutex};
 
+/// Selects the surfaces that get a property listener
+pub type SurfaceListenerFilter = Arc<dyn Fn(u32) -> bool + Send + Sync>;
+
 /// Event listener context that holds a reference to the StateManager
 pub struct EventContext {
-    state_manager: Arc<Mutex<StateManager>>,
+    state_manager: Arc<StateManager>,
     ivi_api: Arc<IviLayoutApi>,
     id_assignment_manager: Arc<IdAssignmentManager>,
     surface_prop_listeners: Mutex<HashMap<u32, *mut wl_listener>>, // per-surface property listeners
     layer_prop_listeners: Mutex<HashMap<u32, *mut wl_listener>>,   // per-layer property listeners
+    /// Surfaces left out by the filter get no property listener (None = all get one)
+    surface_listener_filter: Option<SurfaceListenerFilter>,
 }
 
-// Safety: We ensure thread-safety through the Mutex on StateManager
+// Safety: StateManager synchronizes internally and the listener maps are behind Mutexes
 unsafe impl Send for EventContext {}
 unsafe impl Sync for EventContext {}
 
 impl EventContext {
     /// Create a new event context
     pub fn new(
-        state_manager: Arc<Mutex<StateManager>>,
+        state_manager: Arc<StateManager>,
         ivi_api: Arc<IviLayoutApi>,
         id_assignment_manager: Arc<IdAssignmentManager>,
     ) -> Self {
@@ -38,9 +44,21 @@ impl EventContext {
             id_assignment_manager,
             surface_prop_listeners: Mutex::new(HashMap::new()),
             layer_prop_listeners: Mutex::new(HashMap::new()),
+            surface_listener_filter: None,
         }
     }
 
+    /// Give property listeners only to the surfaces `filter` selects
+    ///
+    /// Surfaces it leaves out are still tracked: a configure event re-reads
+    /// its surface, and every commit of the RPC handler re-reads the surfaces
+    /// changed through it since the previous commit. Changes committed by
+    /// other IVI controllers are only seen once a listener is attached.
+    pub fn with_surface_listener_filter(mut self, filter: SurfaceListenerFilter) -> Self {
+        self.surface_listener_filter = Some(filter);
+        self
+    }
+
     /// Helper function to cleanup allocated listeners
     unsafe fn cleanup_listeners(listeners: &[*mut wl_listener]) {
         for &listener in listeners {
@@ -162,6 +180,7 @@ impl EventContext {
                 id_assignment_manager: Arc::clone(&self.id_assignment_manager),
                 surface_prop_listeners: Mutex::new(HashMap::new()),
                 layer_prop_listeners: Mutex::new(HashMap::new()),
+                surface_listener_filter: None,
             }),
         );
 
@@ -175,6 +194,58 @@ impl EventContext {
         self.ivi_api.surface_add_listener(&surface, listener)
     }
 
+    /// Register the property listener of a surface, unless the surface
+    /// listener filter leaves it out
+    ///
+    /// Returns whether a listener was registered.
+    /// # Safety
+    /// This function is unsafe because it deals with raw pointers.
+    pub unsafe fn attach_surface_property_listener(
+        &self,
+        surface_id: u32,
+    ) -> Result<bool, &'static str> {
+        if let Some(filter) = &self.surface_listener_filter {
+            if !filter(surface_id) {
+                return Ok(false);
+            }
+        }
+        self.register_surface_property_listener_by_id(surface_id)?;
+        Ok(true)
+    }
+
+    /// Register property listeners for the known surfaces that have none
+    /// and that the surface listener filter now selects
+    ///
+    /// Each newly watched surface is re-read, since changes made before its
+    /// listener existed went unseen. Returns the number of listeners added.
+    /// # Safety
+    /// This function is unsafe because it deals with raw pointers.
+    pub unsafe fn refresh_surface_property_listeners(&self) -> usize {
+        let Some(filter) = &self.surface_listener_filter else {
+            return 0;
+        };
+
+        let unwatched: Vec<u32> = {
+            let listeners = self.surface_prop_listeners.lock().unwrap();
+            self.state_manager
+                .snapshot()
+                .surfaces
+                .keys()
+                .copied()
+                .filter(|id| !listeners.contains_key(id))
+                .collect()
+        };
+
+        let mut added = 0;
+        for id in unwatched {
+            if filter(id) && self.register_surface_property_listener_by_id(id).is_ok() {
+                self.state_manager.handle_surface_configured(id);
+                added += 1;
+            }
+        }
+        added
+    }
+
     /// Remove and free a per-surface property listener by surface id
     /// # Safety
     /// This function is unsafe because it frees raw pointers.
@@ -237,6 +308,7 @@ impl EventContext {
                 id_assignment_manager: Arc::clone(&self.id_assignment_manager),
                 surface_prop_listeners: Mutex::new(HashMap::new()),
                 layer_prop_listeners: Mutex::new(HashMap::new()),
+                surface_listener_filter: None,
             }),
         );
 
@@ -276,6 +348,11 @@ impl EventContext {
         }
     }
 
+    /// Get a reference to the state manager
+    pub fn state_manager(&self) -> &Arc<StateManager> {
+        &self.state_manager
+    }
+
     /// Get a reference to the ID assignment manager
     pub fn id_assignment_manager(&self) -> &Arc<IdAssignmentManager> {
         &self.id_assignment_manager
@@ -356,6 +433,7 @@ lazy_static::lazy_static! {
 /// This function is unsafe because it is called from C code with raw pointers.
 #[no_mangle]
 pub unsafe extern "C" fn surface_created_callback(listener: *mut wl_listener, data: *mut c_void) {
+    let _timer = metrics().time_callback(CallbackKind::SurfaceCreated);
     if listener.is_null() || data.is_null() {
         return;
     }
@@ -390,32 +468,30 @@ pub unsafe extern "C" fn surface_created_callback(listener: *mut wl_listener, da
                         );
 
                         // Update state manager with the assigned surface ID and assignment info
-                        if let Ok(mut state_manager) = context.state_manager.lock() {
-                            state_manager.handle_surface_created_with_assignment_info(
+                        context
+                            .state_manager
+                            .handle_surface_created_with_assignment_info(
                                 info.assigned_id,
                                 true,             // is_auto_assigned
                                 Some(surface_id), // original_id
                             );
-                        }
 
                         // Register per-surface property listener for the assigned surface ID
                         context
-                            .register_surface_property_listener_by_id(info.assigned_id)
+                            .attach_surface_property_listener(info.assigned_id)
                             .ok();
                     } else {
                         // Valid ID - use as-is, mark as manually assigned
                         // Update state manager with the original surface ID
-                        if let Ok(mut state_manager) = context.state_manager.lock() {
-                            state_manager.handle_surface_created_with_assignment_info(
+                        context
+                            .state_manager
+                            .handle_surface_created_with_assignment_info(
                                 surface_id, false, // is_auto_assigned (valid ID means manual)
                                 None,  // original_id
                             );
-                        }
 
                         // Register per-surface property listener for the original surface ID
-                        context
-                            .register_surface_property_listener_by_id(surface_id)
-                            .ok();
+                        context.attach_surface_property_listener(surface_id).ok();
                     }
                 }
                 Err(e) => {
@@ -426,16 +502,14 @@ pub unsafe extern "C" fn surface_created_callback(listener: *mut wl_listener, da
                     );
 
                     // Fall back to normal surface creation handling
-                    if let Ok(mut state_manager) = context.state_manager.lock() {
-                        state_manager.handle_surface_created_with_assignment_info(
+                    context
+                        .state_manager
+                        .handle_surface_created_with_assignment_info(
                             surface_id, false, // is_auto_assigned
                             None,  // original_id
                         );
-                    }
 
-                    context
-                        .register_surface_property_listener_by_id(surface_id)
-                        .ok();
+                    context.attach_surface_property_listener(surface_id).ok();
                 }
             }
         }
@@ -447,6 +521,7 @@ pub unsafe extern "C" fn surface_created_callback(listener: *mut wl_listener, da
 /// This function is unsafe because it is called from C code with raw pointers.
 #[no_mangle]
 pub unsafe extern "C" fn surface_removed_callback(listener: *mut wl_listener, data: *mut c_void) {
+    let _timer = metrics().time_callback(CallbackKind::SurfaceRemoved);
     if listener.is_null() || data.is_null() {
         return;
     }
@@ -492,9 +567,7 @@ pub unsafe extern "C" fn surface_removed_callback(listener: *mut wl_listener, da
             }
 
             // Update state manager
-            if let Ok(mut state_manager) = context.state_manager.lock() {
-                state_manager.handle_surface_destroyed(surface_id);
-            }
+            context.state_manager.handle_surface_destroyed(surface_id);
 
             // Remove and free property listener for this surface
             context.remove_surface_property_listener(surface_id);
@@ -510,6 +583,7 @@ pub unsafe extern "C" fn surface_configured_callback(
     listener: *mut wl_listener,
     data: *mut c_void,
 ) {
+    let _timer = metrics().time_callback(CallbackKind::SurfaceConfigured);
     if listener.is_null() || data.is_null() {
         return;
     }
@@ -525,9 +599,7 @@ pub unsafe extern "C" fn surface_configured_callback(
             Arc::clone(&context.ivi_api),
         ) {
             let surface_id = surface.id();
-            if let Ok(mut state_manager) = context.state_manager.lock() {
-                state_manager.handle_surface_configured(surface_id);
-            }
+            context.state_manager.handle_surface_configured(surface_id);
         }
     }
 }
@@ -540,6 +612,7 @@ pub unsafe extern "C" fn surface_property_changed_callback(
     listener: *mut wl_listener,
     data: *mut c_void,
 ) {
+    let _timer = metrics().time_callback(CallbackKind::SurfacePropertyChanged);
     if listener.is_null() || data.is_null() {
         return;
     }
@@ -555,10 +628,8 @@ pub unsafe extern "C" fn surface_property_changed_callback(
             Arc::clone(&context.ivi_api),
         ) {
             let surface_id = surface.id();
-            if let Ok(mut state_manager) = context.state_manager.lock() {
-                // Recompute and emit property change notifications
-                state_manager.handle_surface_configured(surface_id);
-            }
+            // Recompute and emit property change notifications
+            context.state_manager.handle_surface_configured(surface_id);
         }
     }
 }
@@ -568,6 +639,7 @@ pub unsafe extern "C" fn surface_property_changed_callback(
 /// This function is unsafe because it is called from C code with raw pointers.
 #[no_mangle]
 pub unsafe extern "C" fn layer_created_callback(listener: *mut wl_listener, data: *mut c_void) {
+    let _timer = metrics().time_callback(CallbackKind::LayerCreated);
     if listener.is_null() || data.is_null() {
         return;
     }
@@ -583,9 +655,7 @@ pub unsafe extern "C" fn layer_created_callback(listener: *mut wl_listener, data
 
         if let Some(layer) = IviLayer::new(layer, Arc::clone(&context.ivi_api)) {
             let layer_id = layer.id();
-            if let Ok(mut state_manager) = context.state_manager.lock() {
-                state_manager.handle_layer_created(layer_id);
-            }
+            context.state_manager.handle_layer_created(layer_id);
             // Register per-layer property listener for this layer
             context
                 .register_layer_property_listener_by_id(layer_id)
@@ -599,6 +669,7 @@ pub unsafe extern "C" fn layer_created_callback(listener: *mut wl_listener, data
 /// # Safety
 /// This function is unsafe because it is called from C code with raw pointers.
 pub unsafe extern "C" fn layer_removed_callback(listener: *mut wl_listener, data: *mut c_void) {
+    let _timer = metrics().time_callback(CallbackKind::LayerRemoved);
     if listener.is_null() || data.is_null() {
         return;
     }
@@ -613,9 +684,7 @@ pub unsafe extern "C" fn layer_removed_callback(listener: *mut wl_listener, data
             IviLayer::new(data as *mut ivi_layout_layer, Arc::clone(&context.ivi_api))
         {
             let layer_id = layer.id();
-            if let Ok(mut state_manager) = context.state_manager.lock() {
-                state_manager.handle_layer_destroyed(layer_id);
-            }
+            context.state_manager.handle_layer_destroyed(layer_id);
             // Remove and free property listener for this layer
             context.remove_layer_property_listener(layer_id);
         }
@@ -630,6 +699,7 @@ pub unsafe extern "C" fn layer_property_changed_callback(
     listener: *mut wl_listener,
     data: *mut c_void,
 ) {
+    let _timer = metrics().time_callback(CallbackKind::LayerPropertyChanged);
     if listener.is_null() || data.is_null() {
         return;
     }
@@ -644,10 +714,8 @@ pub unsafe extern "C" fn layer_property_changed_callback(
             IviLayer::new(data as *mut ivi_layout_layer, Arc::clone(&context.ivi_api))
         {
             let layer_id = layer.id();
-            if let Ok(mut state_manager) = context.state_manager.lock() {
-                // Recompute and emit property change notifications
-                state_manager.handle_layer_configured(layer_id);
-            }
+            // Recompute and emit property change notifications
+            context.state_manager.handle_layer_configured(layer_id);
         }
     }
 }
@@ -0,0 +1,336 @@
+// Output frame listeners for work aligned with compositor repaints
+
+use crate::ffi::bindings::*;
+use crate::ffi::weston::{wl_list_remove, wl_signal_add};
+#[allow(unused)]
+use jlogger_tracing::{jdebug, jerror, jinfo, jwarn};
+use std::collections::HashSet;
+use std::os::raw::c_void;
+use std::sync::{Arc, Mutex};
+
+/// Called on the compositor thread after the primary output has been repainted
+pub type FrameCallback = Arc<dyn Fn() + Send + Sync>;
+
+/// Outputs listened to, by the address of their `OutputListener`
+#[derive(Debug, Default)]
+struct OutputSet {
+    /// Live `OutputListener` allocations, freed when their output goes away
+    live: HashSet<usize>,
+    /// Output whose frames drive the callback
+    primary: Option<usize>,
+}
+
+impl OutputSet {
+    fn insert(&mut self, output_listener: usize) {
+        self.live.insert(output_listener);
+        self.primary.get_or_insert(output_listener);
+    }
+
+    /// Forget an output; if it was the primary one, another takes over
+    fn remove(&mut self, output_listener: usize) -> bool {
+        if !self.live.remove(&output_listener) {
+            return false;
+        }
+        if self.primary == Some(output_listener) {
+            self.primary = self.live.iter().min().copied();
+        }
+        true
+    }
+}
+
+/// State shared by every listener of one `FrameListeners` registration
+struct FrameContext {
+    callback: FrameCallback,
+    outputs: Mutex<OutputSet>,
+}
+
+/// Frame and destroy listeners of one output
+///
+/// The listeners are the first fields so the callbacks can get back to the
+/// whole struct from the `wl_listener` pointer they are called with.
+#[repr(C)]
+struct OutputListener {
+    frame: wl_listener,
+    destroy: wl_listener,
+    ctx: Arc<FrameContext>,
+}
+
+/// Listener for outputs added after registration
+#[repr(C)]
+struct CreatedListener {
+    listener: wl_listener,
+    ctx: Arc<FrameContext>,
+}
+
+/// Registration of a frame callback with the outputs of the compositor.
+///
+/// The callback runs once per repaint of a single primary output, the first
+/// one attached, so work done per frame is not repeated for every output.
+/// When the primary output goes away another output takes over. Outputs
+/// created later are picked up through the compositor's
+/// `output_created_signal`, and the listeners of a destroyed output are
+/// freed with it. Dropping the registration removes the remaining listeners.
+pub struct FrameListeners {
+    ctx: Arc<FrameContext>,
+    created: *mut CreatedListener,
+}
+
+// Safety: the listeners are only touched from the compositor thread and the
+// set of live outputs is behind a Mutex
+unsafe impl Send for FrameListeners {}
+unsafe impl Sync for FrameListeners {}
+
+impl FrameListeners {
+    /// Call `callback` after each repaint of the primary output of `compositor`
+    ///
+    /// Returns the registration and the number of outputs it is attached to.
+    ///
+    /// # Safety
+    /// - compositor must be a valid weston_compositor pointer that outlives
+    ///   the returned registration
+    /// - must be called on the compositor thread
+    pub unsafe fn register(
+        compositor: *mut crate::ffi::weston::weston_compositor,
+        callback: FrameCallback,
+    ) -> Result<(Self, usize), &'static str> {
+        if compositor.is_null() {
+            return Err("Compositor pointer is null");
+        }
+        let compositor = compositor as *mut weston_compositor;
+
+        let ctx = Arc::new(FrameContext {
+            callback,
+            outputs: Mutex::new(OutputSet::default()),
+        });
+
+        // Attach to the outputs that already exist
+        let output_list = &mut (*compositor).output_list as *mut wl_list;
+        let mut link = (*output_list).next;
+        while link != output_list {
+            let offset = std::mem::offset_of!(weston_output, link);
+            let output = (link as *mut u8).sub(offset) as *mut weston_output;
+            attach_output(&ctx, output);
+            link = (*link).next;
+        }
+
+        let created = Box::into_raw(Box::new(CreatedListener {
+            listener: std::mem::zeroed(),
+            ctx: Arc::clone(&ctx),
+        }));
+        (*created).listener.notify = Some(output_created_callback);
+        wl_signal_add(
+            &mut (*compositor).output_created_signal,
+            &mut (*created).listener,
+        );
+
+        let count = ctx.outputs.lock().unwrap().live.len();
+        Ok((Self { ctx, created }, count))
+    }
+}
+
+impl Drop for FrameListeners {
+    fn drop(&mut self) {
+        unsafe {
+            wl_list_remove(&mut (*self.created).listener.link);
+            drop(Box::from_raw(self.created));
+
+            let outputs: Vec<usize> = {
+                let mut outputs = self.ctx.outputs.lock().unwrap();
+                outputs.primary = None;
+                outputs.live.drain().collect()
+            };
+            for output_listener in outputs {
+                free_output_listener(output_listener as *mut OutputListener);
+            }
+        }
+    }
+}
+
+/// Add frame and destroy listeners to `output`
+unsafe fn attach_output(ctx: &Arc<FrameContext>, output: *mut weston_output) {
+    if output.is_null() {
+        return;
+    }
+
+    let output_listener = Box::into_raw(Box::new(OutputListener {
+        frame: std::mem::zeroed(),
+        destroy: std::mem::zeroed(),
+        ctx: Arc::clone(ctx),
+    }));
+    (*output_listener).frame.notify = Some(output_frame_callback);
+    (*output_listener).destroy.notify = Some(output_destroyed_callback);
+
+    wl_signal_add(&mut (*output).frame_signal, &mut (*output_listener).frame);
+    wl_signal_add(
+        &mut (*output).destroy_signal,
+        &mut (*output_listener).destroy,
+    );
+
+    ctx.outputs.lock().unwrap().insert(output_listener as usize);
+    jdebug!("Frame listener attached to output {}", (*output).id);
+}
+
+/// Unlink and free the listeners of one output
+unsafe fn free_output_listener(output_listener: *mut OutputListener) {
+    wl_list_remove(&mut (*output_listener).frame.link);
+    wl_list_remove(&mut (*output_listener).destroy.link);
+    drop(Box::from_raw(output_listener));
+}
+
+unsafe extern "C" fn output_frame_callback(listener: *mut wl_listener, _data: *mut c_void) {
+    if listener.is_null() {
+        return;
+    }
+
+    let offset = std::mem::offset_of!(OutputListener, frame);
+    let output_listener = (listener as *mut u8).sub(offset) as *const OutputListener;
+    let ctx = &(*output_listener).ctx;
+    let primary = ctx.outputs.lock().unwrap().primary == Some(output_listener as usize);
+    if primary {
+        (ctx.callback)();
+    }
+}
+
+unsafe extern "C" fn output_destroyed_callback(listener: *mut wl_listener, _data: *mut c_void) {
+    if listener.is_null() {
+        return;
+    }
+
+    let offset = std::mem::offset_of!(OutputListener, destroy);
+    let output_listener = (listener as *mut u8).sub(offset) as *mut OutputListener;
+
+    let removed = {
+        let ctx = &(*output_listener).ctx;
+        ctx.outputs.lock().unwrap().remove(output_listener as usize)
+    };
+    if removed {
+        free_output_listener(output_listener);
+        jdebug!("Frame listener detached from destroyed output");
+    }
+}
+
+unsafe extern "C" fn output_created_callback(listener: *mut wl_listener, data: *mut c_void) {
+    if listener.is_null() || data.is_null() {
+        return;
+    }
+
+    // The listener is the first field of CreatedListener
+    let created = listener as *mut CreatedListener;
+    attach_output(&(*created).ctx, data as *mut weston_output);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::atomic::{AtomicUsize, Ordering};
+
+    fn address(listener: &OutputListener) -> usize {
+        listener as *const OutputListener as usize
+    }
+
+    /// Listeners of `count` outputs sharing one context, not linked to any signal
+    fn output_listeners(count: usize, callback: FrameCallback) -> Vec<OutputListener> {
+        let ctx = Arc::new(FrameContext {
+            callback,
+            outputs: Mutex::new(OutputSet::default()),
+        });
+
+        let listeners: Vec<OutputListener> = (0..count)
+            .map(|_| OutputListener {
+                // Safety: wl_listener is plain data
+                frame: unsafe { std::mem::zeroed() },
+                destroy: unsafe { std::mem::zeroed() },
+                ctx: Arc::clone(&ctx),
+            })
+            .collect();
+        // The vector is not grown again, so the addresses stay valid
+        for listener in &listeners {
+            ctx.outputs.lock().unwrap().insert(address(listener));
+        }
+        listeners
+    }
+
+    fn counting_listeners(count: usize) -> (Arc<AtomicUsize>, Vec<OutputListener>) {
+        let frames = Arc::new(AtomicUsize::new(0));
+        let frames_clone = Arc::clone(&frames);
+        let callback: FrameCallback = Arc::new(move || {
+            frames_clone.fetch_add(1, Ordering::Relaxed);
+        });
+        (frames, output_listeners(count, callback))
+    }
+
+    /// Deliver the frame signal of every live output once, as one refresh does
+    fn refresh(listeners: &mut [OutputListener]) {
+        for listener in listeners {
+            let live = listener
+                .ctx
+                .outputs
+                .lock()
+                .unwrap()
+                .live
+                .contains(&address(listener));
+            if live {
+                // Safety: the listener is a live OutputListener
+                unsafe { output_frame_callback(&mut listener.frame, std::ptr::null_mut()) };
+            }
+        }
+    }
+
+    #[test]
+    fn test_one_callback_per_refresh_of_several_outputs() {
+        let (frames, mut listeners) = counting_listeners(3);
+
+        refresh(&mut listeners);
+        refresh(&mut listeners);
+        assert_eq!(frames.load(Ordering::Relaxed), 2);
+
+        // Another output takes over when the primary one goes away
+        let ctx = Arc::clone(&listeners[0].ctx);
+        let primary = ctx.outputs.lock().unwrap().primary.unwrap();
+        assert!(ctx.outputs.lock().unwrap().remove(primary));
+        assert!(ctx.outputs.lock().unwrap().primary.is_some());
+        refresh(&mut listeners);
+        assert_eq!(frames.load(Ordering::Relaxed), 3);
+
+        // Without outputs there is no primary
+        let mut outputs = ctx.outputs.lock().unwrap();
+        for listener in &listeners {
+            outputs.remove(address(listener));
+        }
+        assert_eq!(outputs.primary, None);
+    }
+
+    #[test]
+    fn test_frame_numbers_follow_the_primary_output() {
+        use crate::rpc::commit_scheduler::{CommitScheduler, DeferredResponse};
+        use crate::rpc::protocol::Encoding;
+        use crate::rpc::transport::ClientId;
+
+        let scheduler = Arc::new(CommitScheduler::new());
+        let due = Arc::new(Mutex::new(Vec::new()));
+        let callback: FrameCallback = {
+            let scheduler = Arc::clone(&scheduler);
+            let due = Arc::clone(&due);
+            Arc::new(move || {
+                if let Some((frame, _)) = scheduler.next_frame() {
+                    due.lock().unwrap().push(frame);
+                }
+            })
+        };
+        let mut listeners = output_listeners(2, callback);
+
+        refresh(&mut listeners);
+        scheduler.defer(DeferredResponse {
+            client_id: ClientId::from_u64(1),
+            id: 1,
+            result: serde_json::json!({}),
+            encoding: Encoding::Json,
+            lane: None,
+        });
+        refresh(&mut listeners);
+
+        // Two refreshes of two outputs are two frames; the change shows in the third
+        assert_eq!(scheduler.frame(), 2);
+        assert_eq!(*due.lock().unwrap(), vec![3]);
+    }
+}
@@ -18,7 +18,7 @@
 //! - `IdAssignmentError`: Error types specific to ID assignment operations
 //! - Validation functions for configuration parameters
 
-use std::collections::HashSet;
+use std::collections::{BTreeMap, HashSet};
 use std::sync::{
     atomic::{AtomicBool, AtomicU64, Ordering},
     Arc, Mutex, RwLock,
@@ -337,6 +337,90 @@ impl IdAssignmentConfig {
     }
 }
 
+/// Active IDs of the assignment range, stored as runs of consecutive IDs
+///
+/// Neighbouring runs are merged, so the ID after a run is never active. The
+/// next free ID at or after any position is then the position itself or the
+/// end of the run containing it plus one: one ordered-map lookup, however many
+/// IDs are active or how long the occupied stretch is.
+#[derive(Debug, Clone, Default)]
+struct OccupiedRuns {
+    /// First ID of each run -> last ID of the run (inclusive)
+    runs: BTreeMap<u32, u32>,
+    /// Number of IDs in all runs
+    count: u64,
+}
+
+impl OccupiedRuns {
+    /// The run containing `id`, as (first, last)
+    fn run_containing(&self, id: u32) -> Option<(u32, u32)> {
+        self.runs
+            .range(..=id)
+            .next_back()
+            .filter(|(_, &last)| last >= id)
+            .map(|(&first, &last)| (first, last))
+    }
+
+    fn insert(&mut self, id: u32) {
+        if self.run_containing(id).is_some() {
+            return;
+        }
+
+        // Since `id` is free, a run containing `id - 1` ends right there
+        let before = id.checked_sub(1).and_then(|prev| self.run_containing(prev));
+        let after = id
+            .checked_add(1)
+            .and_then(|next| self.runs.remove(&next).map(|last| (next, last)));
+
+        match (before, after) {
+            (Some((first, _)), Some((_, last))) => self.runs.insert(first, last),
+            (Some((first, _)), None) => self.runs.insert(first, id),
+            (None, Some((_, last))) => self.runs.insert(id, last),
+            (None, None) => self.runs.insert(id, id),
+        };
+        self.count += 1;
+    }
+
+    fn remove(&mut self, id: u32) {
+        let Some((first, last)) = self.run_containing(id) else {
+            return;
+        };
+
+        self.runs.remove(&first);
+        if first < id {
+            self.runs.insert(first, id - 1);
+        }
+        if id < last {
+            self.runs.insert(id + 1, last);
+        }
+        self.count -= 1;
+    }
+
+    /// First ID at or after `id` that is not in a run, or `None` past `u32::MAX`
+    fn next_free(&self, id: u32) -> Option<u32> {
+        match self.run_containing(id) {
+            Some((_, last)) => last.checked_add(1),
+            None => Some(id),
+        }
+    }
+
+    fn clear(&mut self) {
+        self.runs.clear();
+        self.count = 0;
+    }
+}
+
+/// An available ID found by [`SurfaceIdRegistry::next_available`]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct AvailableId {
+    /// The available ID
+    pub id: u32,
+    /// Number of active IDs skipped to reach it
+    pub skipped: u32,
+    /// Whether the search wrapped around from max_id to start_id
+    pub wrapped_around: bool,
+}
+
 /// Surface ID Registry for tracking active surface IDs
 ///
 /// This registry maintains the state of all active surface IDs in the system,
@@ -351,6 +435,9 @@ pub struct SurfaceIdRegistry {
     /// Set of IDs that were automatically assigned (subset of active_ids)
     auto_assigned_ids: HashSet<u32>,
 
+    /// Active IDs within the assignment range, for finding free IDs
+    occupied: OccupiedRuns,
+
     /// Configuration for ID assignment behavior
     config: IdAssignmentConfig,
 
@@ -382,6 +469,7 @@ impl SurfaceIdRegistry {
         Self {
             active_ids: HashSet::new(),
             auto_assigned_ids: HashSet::new(),
+            occupied: OccupiedRuns::default(),
             config,
             stats: IdAssignmentStats::default(),
             created_at: Instant::now(),
@@ -438,6 +526,9 @@ impl SurfaceIdRegistry {
 
         // Register the ID
         self.active_ids.insert(id);
+        if self.config.is_in_range(id) {
+            self.occupied.insert(id);
+        }
         if is_auto_assigned {
             self.auto_assigned_ids.insert(id);
             self.stats.active_auto_assigned += 1;
@@ -493,6 +584,7 @@ impl SurfaceIdRegistry {
 
         // Remove from both sets
         self.active_ids.remove(&id);
+        self.occupied.remove(id);
         if was_auto_assigned {
             self.auto_assigned_ids.remove(&id);
             self.stats.active_auto_assigned = self.stats.active_auto_assigned.saturating_sub(1);
@@ -576,13 +668,62 @@ impl SurfaceIdRegistry {
     /// # Returns
     /// The number of IDs that are available for auto-assignment
     pub fn available_count(&self) -> usize {
-        let range_size = self.config.range_size() as usize;
-        let used_in_range = self
-            .active_ids
-            .iter()
-            .filter(|&&id| self.config.is_in_range(id))
-            .count();
-        range_size.saturating_sub(used_in_range)
+        self.config.range_size().saturating_sub(self.occupied.count) as usize
+    }
+
+    /// Find the first available ID at or after `from`, wrapping around to
+    /// start_id after max_id
+    ///
+    /// Takes O(log n) in the number of runs of consecutive active IDs, no
+    /// matter how many active IDs lie between `from` and the result. A `from`
+    /// outside the assignment range searches from start_id.
+    ///
+    /// # Arguments
+    /// * `from` - First ID to consider
+    ///
+    /// # Returns
+    /// The available ID, or `None` if every ID in the range is active
+    ///
+    /// # Examples
+    /// ```
+    /// use weston_ivi_controller::controller::id_assignment::{SurfaceIdRegistry, IdAssignmentConfig};
+    ///
+    /// let config = IdAssignmentConfig::default();
+    /// let mut registry = SurfaceIdRegistry::new(config);
+    /// registry.register_id(0x10000000, true)?;
+    /// registry.register_id(0x10000001, true)?;
+    ///
+    /// let available = registry.next_available(0x10000000).unwrap();
+    /// assert_eq!(available.id, 0x10000002);
+    /// assert_eq!(available.skipped, 2);
+    /// # Ok::<(), Box<dyn std::error::Error>>(())
+    /// ```
+    pub fn next_available(&self, from: u32) -> Option<AvailableId> {
+        let (start, max) = (self.config.start_id, self.config.max_id);
+        let from = if self.config.is_in_range(from) {
+            from
+        } else {
+            start
+        };
+
+        if let Some(id) = self.occupied.next_free(from).filter(|&id| id <= max) {
+            return Some(AvailableId {
+                id,
+                skipped: id - from,
+                wrapped_around: false,
+            });
+        }
+
+        // Everything from `from` to max_id is active; a free ID, if any, is
+        // before `from`
+        self.occupied
+            .next_free(start)
+            .filter(|&id| id < from)
+            .map(|id| AvailableId {
+                id,
+                skipped: (max - from + 1).saturating_add(id - start),
+                wrapped_around: true,
+            })
     }
 
     /// Get comprehensive statistics about the registry
@@ -663,6 +804,7 @@ impl SurfaceIdRegistry {
     pub fn clear(&mut self) {
         self.active_ids.clear();
         self.auto_assigned_ids.clear();
+        self.occupied.clear();
         self.stats.active_auto_assigned = 0;
         self.stats.registry_size = 0;
 
@@ -697,6 +839,19 @@ impl SurfaceIdRegistry {
             )));
         }
 
+        // Check that the free-ID index covers exactly the active IDs in range
+        let in_range = self
+            .active_ids
+            .iter()
+            .filter(|&&id| self.config.is_in_range(id))
+            .count() as u64;
+        if in_range != self.occupied.count {
+            return Err(IdAssignmentError::registry_error(format!(
+                "Consistency error: free-ID index mismatch (active in range: {}, indexed: {})",
+                in_range, self.occupied.count
+            )));
+        }
+
         // Check that registry size matches active IDs count
         if self.active_ids.len() != self.stats.registry_size {
             return Err(IdAssignmentError::registry_error(format!(
@@ -1112,10 +1267,12 @@ impl IdAssigner {
     ///
     /// This method implements the core assignment algorithm:
     /// 1. Start with the current sequential ID
-    /// 2. Check if it's available in the registry
-    /// 3. If not available, increment and check again
-    /// 4. Handle wraparound when reaching max_id
-    /// 5. Continue until an available ID is found or all IDs are exhausted
+    /// 2. Look up the first available ID at or after it in the registry,
+    ///    skipping active IDs and wrapping around after max_id
+    /// 3. Continue the sequence after the assigned ID
+    ///
+    /// The lookup does not probe the active IDs one by one, so assignment
+    /// stays fast when the range is nearly full or after a wraparound.
     ///
     /// # Arguments
     /// * `registry` - Registry to check for ID conflicts
@@ -1143,9 +1300,6 @@ impl IdAssigner {
         registry: &SurfaceIdRegistry,
     ) -> IdAssignmentResult<AssignmentResult> {
         let start_time = Instant::now();
-        let mut conflicts_resolved = 0;
-        let mut wrapped_around = false;
-        let starting_id = self.current_id;
 
         tracing::debug!(
             current_id = self.current_id,
@@ -1153,89 +1307,60 @@ impl IdAssigner {
             "Starting ID assignment"
         );
 
-        // Check if we have any available IDs at all
-        if registry.available_count() == 0 {
+        let available = self.take_next_available(registry)?;
+        let assignment_duration = start_time.elapsed();
+
+        tracing::info!(
+            assigned_id = available.id,
+            conflicts_resolved = available.skipped,
+            wrapped_around = available.wrapped_around,
+            duration_us = assignment_duration.as_micros(),
+            "Successfully assigned surface ID"
+        );
+
+        Ok(AssignmentResult {
+            assigned_id: available.id,
+            wrapped_around: available.wrapped_around,
+            conflicts_resolved: available.skipped,
+            assignment_duration,
+        })
+    }
+
+    /// Find the first available ID from the current position and move the
+    /// position past it
+    fn take_next_available(
+        &mut self,
+        registry: &SurfaceIdRegistry,
+    ) -> IdAssignmentResult<AvailableId> {
+        let Some(available) = registry.next_available(self.current_id) else {
+            tracing::error!(
+                current_id = self.current_id,
+                "No available ID in the assignment range"
+            );
             return Err(IdAssignmentError::no_available_ids(
                 self.config.start_id,
                 self.config.max_id,
             ));
-        }
-
-        loop {
-            // Check if current ID is available
-            if registry.is_available(self.current_id) {
-                let assigned_id = self.current_id;
-
-                // Advance to next ID for future assignments
-                self.advance_current_id();
-
-                let assignment_duration = start_time.elapsed();
-
-                tracing::info!(
-                    assigned_id = assigned_id,
-                    conflicts_resolved = conflicts_resolved,
-                    wrapped_around = wrapped_around,
-                    duration_us = assignment_duration.as_micros(),
-                    "Successfully assigned surface ID"
-                );
-
-                return Ok(AssignmentResult {
-                    assigned_id,
-                    wrapped_around,
-                    conflicts_resolved,
-                    assignment_duration,
-                });
-            }
+        };
 
-            // Current ID is not available, resolve conflict
-            conflicts_resolved += 1;
+        if available.skipped > 0 {
             tracing::debug!(
-                conflicted_id = self.current_id,
-                conflicts_resolved = conflicts_resolved,
-                "Resolving ID conflict"
+                from_id = self.current_id,
+                conflicts_resolved = available.skipped,
+                wrapped_around = available.wrapped_around,
+                "Skipped active IDs"
             );
+        }
+        if available.wrapped_around {
+            self.has_wrapped = true;
+            tracing::debug!("ID assignment wrapped around to start of range");
+        }
 
-            // Check if we're about to wrap around
-            let will_wrap = self.current_id >= self.config.max_id;
-
-            // Advance to next ID
-            self.advance_current_id();
-
-            // Update wrapped_around flag if we wrapped during this advance
-            if will_wrap {
-                wrapped_around = true;
-                tracing::debug!("ID assignment wrapped around to start of range");
-            }
-
-            // Check if we've made a full circle without finding an available ID
-            if self.current_id == starting_id && conflicts_resolved > 0 {
-                tracing::error!(
-                    starting_id = starting_id,
-                    conflicts_resolved = conflicts_resolved,
-                    available_count = registry.available_count(),
-                    "Completed full circle without finding available ID"
-                );
-
-                return Err(IdAssignmentError::no_available_ids(
-                    self.config.start_id,
-                    self.config.max_id,
-                ));
-            }
-
-            // Safety check to prevent infinite loops (should never happen with proper registry)
-            if u64::from(conflicts_resolved) > self.config.range_size() {
-                tracing::error!(
-                    conflicts_resolved = conflicts_resolved,
-                    range_size = self.config.range_size(),
-                    "Excessive conflicts resolved, possible registry inconsistency"
-                );
+        // Continue the sequence after the assigned ID
+        self.current_id = available.id;
+        self.advance_current_id();
 
-                return Err(IdAssignmentError::registry_error(
-                    "Excessive conflicts during ID assignment, possible registry inconsistency"
-                        .to_string(),
-                ));
-            }
-        }
+        Ok(available)
     }
 
     /// Advance the current ID to the next value, handling wraparound
@@ -2433,15 +2558,15 @@ impl IdAssignmentManager {
     }
 
     /// Assign next ID with sequential assignment priority over reuse
+    ///
+    /// Continues from the assigner's position rather than reusing earlier
+    /// freed IDs, which only come up again after a wraparound.
     fn assign_next_id_with_sequential_priority(
         &self,
         assigner: &mut IdAssigner,
         registry: &SurfaceIdRegistry,
     ) -> IdAssignmentResult<AssignmentResult> {
         let start_time = Instant::now();
-        let mut conflicts_resolved = 0;
-        let mut wrapped_around = false;
-        let starting_id = assigner.current_id();
 
         tracing::debug!(
             current_id = assigner.current_id(),
@@ -2450,93 +2575,24 @@ impl IdAssignmentManager {
             "Starting ID assignment with sequential priority"
         );
 
-        // Check if we have any available IDs at all
-        if registry.available_count() == 0 {
-            return Err(IdAssignmentError::no_available_ids(
-                self.config.start_id,
-                self.config.max_id,
-            ));
-        }
-
-        // Sequential assignment strategy: prefer continuing from current position
-        // rather than reusing earlier freed IDs
-        loop {
-            // Check if current ID is available
-            if registry.is_available(assigner.current_id()) {
-                let assigned_id = assigner.current_id();
-
-                // Advance to next ID for future assignments
-                assigner.advance_current_id();
-
-                let assignment_duration = start_time.elapsed();
-
-                tracing::info!(
-                    assigned_id = assigned_id,
-                    conflicts_resolved = conflicts_resolved,
-                    wrapped_around = wrapped_around,
-                    duration_us = assignment_duration.as_micros(),
-                    sequential_priority = true,
-                    "Successfully assigned surface ID with sequential priority"
-                );
-
-                return Ok(AssignmentResult {
-                    assigned_id,
-                    wrapped_around,
-                    conflicts_resolved,
-                    assignment_duration,
-                });
-            }
-
-            // Current ID is not available, resolve conflict
-            conflicts_resolved += 1;
-            tracing::debug!(
-                conflicted_id = assigner.current_id(),
-                conflicts_resolved = conflicts_resolved,
-                "Resolving ID conflict with sequential priority"
-            );
-
-            // Check if we're about to wrap around
-            let will_wrap = assigner.current_id() >= self.config.max_id;
-
-            // Advance to next ID
-            assigner.advance_current_id();
-
-            // Update wrapped_around flag if we wrapped during this advance
-            if will_wrap {
-                wrapped_around = true;
-                tracing::debug!(
-                    "ID assignment wrapped around to start of range with sequential priority"
-                );
-            }
-
-            // Check if we've made a full circle without finding an available ID
-            if assigner.current_id() == starting_id && conflicts_resolved > 0 {
-                tracing::error!(
-                    starting_id = starting_id,
-                    conflicts_resolved = conflicts_resolved,
-                    available_count = registry.available_count(),
-                    "Completed full circle without finding available ID (sequential priority)"
-                );
-
-                return Err(IdAssignmentError::no_available_ids(
-                    self.config.start_id,
-                    self.config.max_id,
-                ));
-            }
+        let available = assigner.take_next_available(registry)?;
+        let assignment_duration = start_time.elapsed();
 
-            // Safety check to prevent infinite loops
-            if u64::from(conflicts_resolved) > self.config.range_size() {
-                tracing::error!(
-                    conflicts_resolved = conflicts_resolved,
-                    range_size = self.config.range_size(),
-                    "Excessive conflicts resolved with sequential priority, possible registry inconsistency"
-                );
+        tracing::info!(
+            assigned_id = available.id,
+            conflicts_resolved = available.skipped,
+            wrapped_around = available.wrapped_around,
+            duration_us = assignment_duration.as_micros(),
+            sequential_priority = true,
+            "Successfully assigned surface ID with sequential priority"
+        );
 
-                return Err(IdAssignmentError::registry_error(
-                    "Excessive conflicts during ID assignment with sequential priority".to_string(),
-                ));
-            }
-        }
+        Ok(AssignmentResult {
+            assigned_id: available.id,
+            wrapped_around: available.wrapped_around,
+            conflicts_resolved: available.skipped,
+            assignment_duration,
+        })
     }
 
     /// Determine if an assignment was sequential (not reused)
@@ -5592,6 +5648,40 @@ mod tests {
         assert_eq!(result.conflicts_resolved, 1); // Skipped 0x10000003
     }
 
+    #[test]
+    fn test_registry_next_available_skips_runs() {
+        let config = IdAssignmentConfig::new(100, 199, 0xFFFFFFFF).unwrap();
+        let mut registry = SurfaceIdRegistry::new(config);
+
+        // Two runs, 100..=149 and 151..=199, with 150 free between them
+        for id in (100..=199).filter(|&id| id != 150) {
+            registry.register_id(id, true).unwrap();
+        }
+        // IDs outside the range do not count
+        registry.register_id(42, false).unwrap();
+        assert_eq!(registry.available_count(), 1);
+        registry.validate_consistency().unwrap();
+
+        let available = registry.next_available(100).unwrap();
+        assert_eq!((available.id, available.skipped), (150, 50));
+        assert!(!available.wrapped_around);
+
+        let available = registry.next_available(160).unwrap();
+        assert_eq!((available.id, available.skipped), (150, 90));
+        assert!(available.wrapped_around);
+
+        // Filling the gap merges the runs; releasing splits them again
+        registry.register_id(150, true).unwrap();
+        assert!(registry.next_available(120).is_none());
+        assert_eq!(registry.available_count(), 0);
+        registry.release_id(120).unwrap();
+        registry.release_id(199).unwrap();
+        assert_eq!(registry.next_available(100).unwrap().id, 120);
+        assert_eq!(registry.next_available(121).unwrap().id, 199);
+        assert_eq!(registry.available_count(), 2);
+        registry.validate_consistency().unwrap();
+    }
+
     #[test]
     fn test_assigner_wraparound() {
         // Use a small range for easier testing
@@ -9,7 +9,7 @@ mod tests {
         IdAssignmentConfig, IdAssignmentManager, StateManager,
     };
     use crate::ffi::bindings::ivi_layout_api::IviLayoutApi;
-    use std::sync::{Arc, Mutex};
+    use std::sync::Arc;
     use std::time::Duration;
 
     /// Create a mock IVI API for testing
@@ -54,7 +54,7 @@ mod tests {
     #[test]
     fn test_state_manager_auto_assignment_integration() {
         let ivi_api = create_mock_ivi_api();
-        let mut state_manager = StateManager::new(Arc::clone(&ivi_api));
+        let state_manager = StateManager::new(Arc::clone(&ivi_api));
         
         // Test the enhanced surface creation handler
         state_manager.handle_surface_created_with_assignment_info(
@@ -190,7 +190,7 @@ mod tests {
                 .expect("Failed to create ID assignment manager")
         );
         
-        let state_manager = Arc::new(Mutex::new(StateManager::new(Arc::clone(&ivi_api))));
+        let state_manager = Arc::new(StateManager::new(Arc::clone(&ivi_api)));
         
         // Verify that both components can be shared across threads
         let id_manager_clone = Arc::clone(&id_manager);
@@ -200,7 +200,7 @@ mod tests {
         // In a real multi-threaded test, we would spawn threads here
         let _handle = std::thread::spawn(move || {
             let _config = id_manager_clone.config();
-            let _state = state_manager_clone.lock().unwrap();
+            let _state = state_manager_clone.snapshot();
         });
     }
 
@@ -288,11 +288,11 @@ mod tests {
                 .expect("Failed to create ID assignment manager")
         );
         
-        let state_manager = Arc::new(Mutex::new(StateManager::new(Arc::clone(&ivi_api))));
+        let state_manager = Arc::new(StateManager::new(Arc::clone(&ivi_api)));
         
         // Verify components can be created together
         assert!(!id_manager.is_shutdown_requested());
-        assert_eq!(state_manager.lock().unwrap().surface_count(), 0);
+        assert_eq!(state_manager.surface_count(), 0);
         
         // Verify configuration consistency
         assert_eq!(id_manager.config().start_id, 0x10000000);
@@ -301,7 +301,7 @@ mod tests {
         
         // Verify initial state is consistent
         let stats = id_manager.get_stats().unwrap();
-        let state_count = state_manager.lock().unwrap().surface_count();
+        let state_count = state_manager.surface_count();
         assert_eq!(stats.active_auto_assigned, 0);
         assert_eq!(state_count, 0);
     }
@@ -0,0 +1,215 @@
+// Wake-ups of the compositor's event loop from other threads, and work it
+// runs once idle
+
+use crate::ffi::weston::{
+    wl_display_get_event_loop, wl_event_loop, wl_event_loop_add_fd, wl_event_loop_add_idle,
+    wl_event_source, wl_event_source_remove, WL_EVENT_READABLE,
+};
+use crate::rpc::WakeRequest;
+#[allow(unused)]
+use jlogger_tracing::{jdebug, jerror, jinfo, jwarn};
+use std::os::fd::{AsRawFd, FromRawFd, OwnedFd};
+use std::os::raw::c_void;
+use std::sync::Arc;
+
+/// Called on the compositor thread after a wake-up
+pub type LoopCallback = Arc<dyn Fn() + Send + Sync>;
+
+/// State handed to the event source callback
+struct LoopContext {
+    fd: Arc<OwnedFd>,
+    callback: LoopCallback,
+}
+
+/// An eventfd watched by the compositor's `wl_event_loop`
+///
+/// Any thread can signal the eventfd through [`waker`](Self::waker); the
+/// event loop then calls the callback on the compositor thread, once for all
+/// the wake-ups since the previous call. Dropping the registration removes
+/// the event source.
+pub struct LoopWakeup {
+    ctx: *mut LoopContext,
+    source: *mut wl_event_source,
+}
+
+// Safety: the event source is only touched from the compositor thread and the
+// eventfd may be written from any thread
+unsafe impl Send for LoopWakeup {}
+unsafe impl Sync for LoopWakeup {}
+
+impl LoopWakeup {
+    /// Call `callback` from the event loop of `compositor` after each wake-up
+    ///
+    /// # Safety
+    /// - compositor must be a valid weston_compositor pointer that outlives
+    ///   the returned registration
+    /// - must be called on the compositor thread
+    pub unsafe fn register(
+        compositor: *mut crate::ffi::weston::weston_compositor,
+        callback: LoopCallback,
+    ) -> Result<Self, String> {
+        let event_loop = compositor_event_loop(compositor)?;
+
+        let fd = libc::eventfd(0, libc::EFD_CLOEXEC | libc::EFD_NONBLOCK);
+        if fd < 0 {
+            return Err(format!(
+                "Failed to create eventfd: {}",
+                std::io::Error::last_os_error()
+            ));
+        }
+
+        let ctx = Box::into_raw(Box::new(LoopContext {
+            fd: Arc::new(OwnedFd::from_raw_fd(fd)),
+            callback,
+        }));
+
+        let source = wl_event_loop_add_fd(
+            event_loop,
+            fd,
+            WL_EVENT_READABLE,
+            loop_wakeup_callback,
+            ctx as *mut c_void,
+        );
+        if source.is_null() {
+            drop(Box::from_raw(ctx));
+            return Err("Failed to add eventfd to the event loop".to_string());
+        }
+
+        Ok(Self { ctx, source })
+    }
+
+    /// Wake-up request that may be called from any thread
+    pub fn waker(&self) -> WakeRequest {
+        // Safety: ctx stays valid until drop, and the eventfd itself is shared
+        let fd = unsafe { Arc::clone(&(*self.ctx).fd) };
+        Arc::new(move || {
+            let value: u64 = 1;
+            // Safety: writes 8 bytes from a valid u64. The write only fails
+            // when the counter would overflow, and then a wake-up is pending
+            unsafe {
+                libc::write(
+                    fd.as_raw_fd(),
+                    &value as *const u64 as *const c_void,
+                    std::mem::size_of::<u64>(),
+                );
+            }
+        })
+    }
+}
+
+impl Drop for LoopWakeup {
+    fn drop(&mut self) {
+        unsafe {
+            wl_event_source_remove(self.source);
+            drop(Box::from_raw(self.ctx));
+        }
+    }
+}
+
+/// Event loop of a compositor
+///
+/// # Safety
+/// - compositor must be null or a valid weston_compositor pointer
+unsafe fn compositor_event_loop(
+    compositor: *mut crate::ffi::weston::weston_compositor,
+) -> Result<*mut wl_event_loop, String> {
+    if compositor.is_null() {
+        return Err("Compositor pointer is null".to_string());
+    }
+    let compositor = compositor as *mut crate::ffi::bindings::weston_compositor;
+
+    let event_loop = wl_display_get_event_loop((*compositor).wl_display);
+    if event_loop.is_null() {
+        return Err("Compositor has no event loop".to_string());
+    }
+    Ok(event_loop)
+}
+
+/// State handed to the idle source callback
+struct IdleContext {
+    source: *mut wl_event_source,
+    /// Taken when the event loop runs it
+    callback: Option<Box<dyn FnOnce()>>,
+}
+
+/// A callback the compositor's event loop runs once, when it next runs out
+/// of events
+///
+/// Dropping the registration before the call cancels it.
+pub struct IdleCallback {
+    ctx: *mut IdleContext,
+}
+
+impl IdleCallback {
+    /// Run `callback` on the compositor thread once its event loop is idle
+    ///
+    /// # Safety
+    /// - compositor must be a valid weston_compositor pointer that outlives
+    ///   the returned registration
+    /// - must be called on the compositor thread
+    pub unsafe fn register(
+        compositor: *mut crate::ffi::weston::weston_compositor,
+        callback: Box<dyn FnOnce()>,
+    ) -> Result<Self, String> {
+        let event_loop = compositor_event_loop(compositor)?;
+
+        let ctx = Box::into_raw(Box::new(IdleContext {
+            source: std::ptr::null_mut(),
+            callback: Some(callback),
+        }));
+
+        let source = wl_event_loop_add_idle(event_loop, idle_callback, ctx as *mut c_void);
+        if source.is_null() {
+            drop(Box::from_raw(ctx));
+            return Err("Failed to add idle source to the event loop".to_string());
+        }
+        (*ctx).source = source;
+
+        Ok(Self { ctx })
+    }
+
+    /// Whether the event loop has yet to run the callback
+    pub fn is_pending(&self) -> bool {
+        // Safety: ctx stays valid until drop
+        unsafe { (*self.ctx).callback.is_some() }
+    }
+}
+
+impl Drop for IdleCallback {
+    fn drop(&mut self) {
+        unsafe {
+            // The event loop frees an idle source once it has run it
+            if self.is_pending() {
+                wl_event_source_remove((*self.ctx).source);
+            }
+            drop(Box::from_raw(self.ctx));
+        }
+    }
+}
+
+/// Idle source callback: run the registered callback once
+unsafe extern "C" fn idle_callback(data: *mut c_void) {
+    let ctx = &mut *(data as *mut IdleContext);
+    if let Some(callback) = ctx.callback.take() {
+        callback();
+    }
+}
+
+/// Event source callback: consume the wake-ups, then run the callback
+unsafe extern "C" fn loop_wakeup_callback(
+    fd: libc::c_int,
+    _mask: u32,
+    data: *mut c_void,
+) -> libc::c_int {
+    let ctx = &*(data as *const LoopContext);
+
+    let mut value: u64 = 0;
+    libc::read(
+        fd,
+        &mut value as *mut u64 as *mut c_void,
+        std::mem::size_of::<u64>(),
+    );
+
+    (ctx.callback)();
+    0
+}
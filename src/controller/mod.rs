@@ -1,19 +1,29 @@
 // Controller module - Core IVI surface management
 
+pub mod animation;
 pub mod events;
+pub mod frame_listeners;
 pub mod id_assignment;
+pub mod loop_wakeup;
 pub mod notifications;
+pub mod scene_mirror;
+pub mod scene_presets;
 pub mod state;
 pub mod subscriptions;
 pub mod validation;
 
-pub use events::{EventContext, EventListeners};
+pub use animation::{AnimatedProperties, AnimationTarget, Animator, Easing};
+pub use events::{EventContext, EventListeners, SurfaceListenerFilter};
+pub use frame_listeners::{FrameCallback, FrameListeners};
 pub use id_assignment::{
     IdAssignmentConfig, IdAssignmentError, IdAssignmentInfo, IdAssignmentManager,
     IdAssignmentResult, IdAssignmentStats,
 };
+pub use loop_wakeup::{IdleCallback, LoopCallback, LoopWakeup};
 pub use notifications::{Notification, NotificationData, NotificationManager, NotificationType};
-pub use state::StateManager;
+pub use scene_mirror::{SceneMirror, SceneMirrorReader};
+pub use scene_presets::{SceneOp, ScenePreset, ScenePresets};
+pub use state::{SceneSnapshot, StateManager};
 pub use subscriptions::SubscriptionManager;
 pub use validation::{
     validate_opacity, validate_orientation, validate_position, validate_size, validate_z_order,
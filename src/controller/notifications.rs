@@ -1,9 +1,10 @@
 // Notification system for surface and focus changes
 
+use super::animation::AnimationTarget;
 use crate::ffi::bindings::*;
 #[allow(unused)]
 use jlogger_tracing::{jdebug, jerror, jinfo, jwarn, JloggerBuilder, LevelFilter};
-use std::collections::HashMap;
+use std::sync::atomic::{AtomicPtr, Ordering};
 use std::sync::{Arc, Mutex};
 
 /// Type of notification
@@ -42,6 +43,20 @@ pub enum NotificationType {
     SurfaceContentReady,
     /// Surface buffer dimensions changed
     SurfaceContentSizeChanged,
+
+    // Animation events
+    /// Animation reached its target values or was cancelled
+    AnimationCompleted,
+}
+
+impl NotificationType {
+    /// Number of notification types
+    pub const COUNT: usize = 15;
+
+    /// Dense index of the type, in `0..COUNT`
+    pub fn index(self) -> usize {
+        self as usize
+    }
 }
 
 /// Notification data for geometry changes
@@ -153,6 +168,13 @@ pub enum NotificationData {
         new_width: i32,
         new_height: i32,
     },
+
+    // Animation notifications
+    AnimationCompleted {
+        animation_id: u64,
+        target: AnimationTarget,
+        cancelled: bool,
+    },
 }
 
 /// A notification event
@@ -165,40 +187,65 @@ pub struct Notification {
 /// Callback function type for notifications
 pub type NotificationCallback = Arc<dyn Fn(&Notification) + Send + Sync>;
 
+/// Callbacks of every notification type, indexed by `NotificationType::index`
+type CallbackTable = [Vec<NotificationCallback>; NotificationType::COUNT];
+
 /// Manages notifications for surface and focus changes
+///
+/// Callbacks are kept in a copy-on-write table: registering one publishes a
+/// new table, and emitting only loads the current one, so emitters never
+/// take a lock and never wait for each other or for a registration.
 pub struct NotificationManager {
-    callbacks: Arc<Mutex<HashMap<NotificationType, Vec<NotificationCallback>>>>,
+    /// Current table, never modified after it has been published
+    table: AtomicPtr<CallbackTable>,
+    /// Tables replaced by a registration. An emitter may still be running
+    /// their callbacks, so they are only freed with the manager. The lock
+    /// also serializes registrations.
+    retired: Mutex<Vec<*mut CallbackTable>>,
 }
 
+// Safety: published tables are immutable and are freed only in drop, and the
+// retired list is behind a Mutex
+unsafe impl Send for NotificationManager {}
+unsafe impl Sync for NotificationManager {}
+
 impl NotificationManager {
     /// Create a new notification manager
     pub fn new() -> Self {
+        let table: Box<CallbackTable> = Box::new(std::array::from_fn(|_| Vec::new()));
         Self {
-            callbacks: Arc::new(Mutex::new(HashMap::new())),
+            table: AtomicPtr::new(Box::into_raw(table)),
+            retired: Mutex::new(Vec::new()),
         }
     }
 
     /// Register a callback for a specific notification type
+    ///
+    /// Notifications emitted concurrently with the registration may or may
+    /// not reach the new callback.
     pub fn register_callback(
-        &mut self,
+        &self,
         notification_type: NotificationType,
         callback: NotificationCallback,
     ) {
-        let mut callbacks = self.callbacks.lock().unwrap();
-        callbacks
-            .entry(notification_type)
-            .or_default()
-            .push(callback);
+        let mut retired = self.retired.lock().unwrap();
+
+        let current = self.table.load(Ordering::Acquire);
+        // Safety: tables stay valid until drop
+        let mut table = Box::new(unsafe { (*current).clone() });
+        table[notification_type.index()].push(callback);
+
+        self.table.store(Box::into_raw(table), Ordering::Release);
+        retired.push(current);
     }
 
     /// Emit a notification to all registered callbacks
     pub fn emit(&self, notification: Notification) {
-        let callbacks = self.callbacks.lock().unwrap();
+        // Safety: tables stay valid until drop
+        let table = unsafe { &*self.table.load(Ordering::Acquire) };
 
-        if let Some(callback_list) = callbacks.get(&notification.notification_type) {
-            for callback in callback_list {
-                callback(&notification);
-            }
+        for callback in &table[notification.notification_type.index()] {
+            callback(&notification);
         }
     }
 
@@ -488,6 +535,32 @@ impl NotificationManager {
 
         self.emit(notification);
     }
+
+    /// Emit an animation completed notification
+    pub fn emit_animation_completed(
+        &self,
+        animation_id: u64,
+        target: AnimationTarget,
+        cancelled: bool,
+    ) {
+        let notification = Notification {
+            notification_type: NotificationType::AnimationCompleted,
+            data: NotificationData::AnimationCompleted {
+                animation_id,
+                target,
+                cancelled,
+            },
+        };
+
+        jdebug!(
+            "Animation {} of {:?} {}",
+            animation_id,
+            target,
+            if cancelled { "cancelled" } else { "completed" }
+        );
+
+        self.emit(notification);
+    }
 }
 
 impl Default for NotificationManager {
@@ -495,3 +568,88 @@ impl Default for NotificationManager {
         Self::new()
     }
 }
+
+impl Drop for NotificationManager {
+    fn drop(&mut self) {
+        let retired = std::mem::take(self.retired.get_mut().unwrap());
+        unsafe {
+            drop(Box::from_raw(*self.table.get_mut()));
+            for table in retired {
+                drop(Box::from_raw(table));
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::atomic::AtomicUsize;
+
+    #[test]
+    fn test_notification_type_index_is_dense() {
+        assert_eq!(NotificationType::GeometryChanged.index(), 0);
+        assert_eq!(
+            NotificationType::AnimationCompleted.index(),
+            NotificationType::COUNT - 1
+        );
+    }
+
+    fn counting_callback(counter: &Arc<AtomicUsize>) -> NotificationCallback {
+        let counter = Arc::clone(counter);
+        Arc::new(move |_| {
+            counter.fetch_add(1, Ordering::Relaxed);
+        })
+    }
+
+    #[test]
+    fn test_emit_reaches_callbacks_of_its_type() {
+        let manager = NotificationManager::new();
+        let created = Arc::new(AtomicUsize::new(0));
+        let destroyed = Arc::new(AtomicUsize::new(0));
+
+        manager.register_callback(
+            NotificationType::SurfaceCreated,
+            counting_callback(&created),
+        );
+        manager.register_callback(
+            NotificationType::SurfaceCreated,
+            counting_callback(&created),
+        );
+        manager.register_callback(
+            NotificationType::SurfaceDestroyed,
+            counting_callback(&destroyed),
+        );
+
+        manager.emit_surface_created(1000);
+        assert_eq!(created.load(Ordering::Relaxed), 2);
+        assert_eq!(destroyed.load(Ordering::Relaxed), 0);
+    }
+
+    #[test]
+    fn test_register_from_callback() {
+        // A callback registering another one must not deadlock, and the new
+        // callback only sees later notifications
+        let manager = Arc::new(NotificationManager::new());
+        let calls = Arc::new(AtomicUsize::new(0));
+
+        let inner_manager = Arc::downgrade(&manager);
+        let inner_calls = Arc::clone(&calls);
+        manager.register_callback(
+            NotificationType::LayerCreated,
+            Arc::new(move |_| {
+                if let Some(manager) = inner_manager.upgrade() {
+                    manager.register_callback(
+                        NotificationType::LayerCreated,
+                        counting_callback(&inner_calls),
+                    );
+                }
+            }),
+        );
+
+        manager.emit_layer_created(10);
+        assert_eq!(calls.load(Ordering::Relaxed), 0);
+        manager.emit_layer_created(10);
+        assert_eq!(calls.load(Ordering::Relaxed), 1);
+    }
+}
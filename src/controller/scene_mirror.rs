@@ -0,0 +1,917 @@
+// Shared-memory mirror of the scene for clients that only read it
+//
+// The plugin keeps a table of surface and layer records in a file mapped
+// MAP_SHARED (under /dev/shm by default). Readers in other processes map the
+// same file read-only and load records with plain memory reads, so a lookup
+// costs no system call and no round trip through the socket.
+//
+// Every record sits in a slot of its own guarded by a sequence counter
+// (seqlock): the writer makes the counter odd, stores the record and makes it
+// even again, and a reader retries while the counter is odd or changed under
+// it. The records use the layouts of `IviSurface` and `IviLayer` from
+// `ivi_client.h`.
+//
+// File layout:
+//   MirrorHeader                        (64 bytes)
+//   surface slots  x surface_capacity   (8 + size_of::<SurfaceRecord>() each)
+//   layer slots    x layer_capacity     (8 + size_of::<LayerRecord>() each)
+//
+// A slot is `seq: u32, used: u32` followed by the record, all native endian.
+
+use super::state::{LayerState, SceneSnapshot, SurfaceState};
+#[allow(unused)]
+use jlogger_tracing::{jdebug, jerror, jinfo, jwarn, JloggerBuilder, LevelFilter};
+use std::collections::{HashMap, HashSet};
+use std::fs::{File, OpenOptions};
+use std::io;
+use std::os::unix::fs::OpenOptionsExt;
+use std::os::unix::io::AsRawFd;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{fence, AtomicU32, AtomicU64, Ordering};
+use std::sync::Mutex;
+
+/// Default path of the mirror file
+pub const DEFAULT_SCENE_MIRROR_PATH: &str = "/dev/shm/weston-ivi-controller.scene";
+
+/// "IVIS" in ASCII
+pub const MIRROR_MAGIC: u32 = 0x4956_4953;
+/// Bumped whenever the file layout changes
+pub const MIRROR_VERSION: u32 = 1;
+
+/// Number of surface slots in the mirror
+pub const SURFACE_CAPACITY: u32 = 512;
+/// Number of layer slots in the mirror
+pub const LAYER_CAPACITY: u32 = 128;
+
+/// Set while some object does not fit in the table; readers must not treat a
+/// missing object as absent from the scene
+pub const FLAG_OVERFLOW: u32 = 1 << 0;
+/// Set when the plugin stopped updating the table
+pub const FLAG_CLOSED: u32 = 1 << 1;
+
+/// Attempts a reader makes at a slot before giving up on it
+///
+/// A slot stays odd for good if the plugin dies while writing it, so readers
+/// must not wait on it forever.
+const READ_ATTEMPTS: u32 = 10_000;
+/// Attempts spent spinning before yielding to a writer that may be preempted
+const READ_SPINS: u32 = 100;
+
+/// Rectangle as laid out in `ivi_client.h`
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct RectRecord {
+    pub x: i32,
+    pub y: i32,
+    pub width: i32,
+    pub height: i32,
+}
+
+/// Surface record, byte for byte the `IviSurface` of `ivi_client.h`
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Default)]
+pub struct SurfaceRecord {
+    pub id: u32,
+    pub orig_width: i32,
+    pub orig_height: i32,
+    pub src_rect: RectRecord,
+    pub dest_rect: RectRecord,
+    /// C `bool`: 0 or 1
+    pub visibility: u8,
+    pub _pad: [u8; 3],
+    pub opacity: f32,
+    /// Value of the C `IviOrientation` enum
+    pub orientation: u32,
+    pub z_order: i32,
+}
+
+/// Layer record, byte for byte the `IviLayer` of `ivi_client.h`
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Default)]
+pub struct LayerRecord {
+    pub id: u32,
+    pub src_rect: RectRecord,
+    pub dest_rect: RectRecord,
+    /// C `bool`: 0 or 1
+    pub visibility: u8,
+    pub _pad: [u8; 3],
+    pub opacity: f32,
+    /// Value of the C `IviOrientation` enum
+    pub orientation: u32,
+}
+
+const SURFACE_WORDS: usize = std::mem::size_of::<SurfaceRecord>() / 4;
+const LAYER_WORDS: usize = std::mem::size_of::<LayerRecord>() / 4;
+
+impl SurfaceRecord {
+    fn to_words(self) -> [u32; SURFACE_WORDS] {
+        // Safety: the record is made of 4-byte fields and explicit padding
+        unsafe { std::mem::transmute(self) }
+    }
+
+    fn from_words(words: [u32; SURFACE_WORDS]) -> Self {
+        // Safety: every bit pattern is a valid record
+        unsafe { std::mem::transmute(words) }
+    }
+}
+
+impl LayerRecord {
+    fn to_words(self) -> [u32; LAYER_WORDS] {
+        // Safety: the record is made of 4-byte fields and explicit padding
+        unsafe { std::mem::transmute(self) }
+    }
+
+    fn from_words(words: [u32; LAYER_WORDS]) -> Self {
+        // Safety: every bit pattern is a valid record
+        unsafe { std::mem::transmute(words) }
+    }
+}
+
+fn rect_record((x, y, width, height): (i32, i32, i32, i32)) -> RectRecord {
+    RectRecord {
+        x,
+        y,
+        width,
+        height,
+    }
+}
+
+impl From<&SurfaceState> for SurfaceRecord {
+    fn from(state: &SurfaceState) -> Self {
+        Self {
+            id: state.id,
+            orig_width: state.orig_size.0,
+            orig_height: state.orig_size.1,
+            src_rect: RectRecord {
+                x: state.src_rect.x,
+                y: state.src_rect.y,
+                width: state.src_rect.width,
+                height: state.src_rect.height,
+            },
+            dest_rect: RectRecord {
+                x: state.dest_rect.x,
+                y: state.dest_rect.y,
+                width: state.dest_rect.width,
+                height: state.dest_rect.height,
+            },
+            visibility: state.visibility as u8,
+            _pad: [0; 3],
+            opacity: state.opacity,
+            orientation: state.orientation as u32,
+            z_order: state.z_order,
+        }
+    }
+}
+
+impl From<&LayerState> for LayerRecord {
+    fn from(state: &LayerState) -> Self {
+        Self {
+            id: state.id,
+            src_rect: rect_record(state.src_rect),
+            dest_rect: rect_record(state.dest_rect),
+            visibility: state.visibility as u8,
+            _pad: [0; 3],
+            opacity: state.opacity,
+            orientation: state.orientation as u32,
+        }
+    }
+}
+
+/// Header at the start of the mirror file
+#[repr(C)]
+struct MirrorHeader {
+    magic: u32,
+    version: u32,
+    header_size: u32,
+    surface_capacity: u32,
+    layer_capacity: u32,
+    surface_slot_size: u32,
+    layer_slot_size: u32,
+    flags: AtomicU32,
+    /// Scene generation the table was last brought up to
+    generation: AtomicU64,
+    _reserved: [u32; 6],
+}
+
+const HEADER_SIZE: usize = std::mem::size_of::<MirrorHeader>();
+const SURFACE_SLOT_SIZE: usize = 8 + SURFACE_WORDS * 4;
+const LAYER_SLOT_SIZE: usize = 8 + LAYER_WORDS * 4;
+
+/// Seqlock-guarded slot holding one record of `N` words
+#[repr(C)]
+struct Slot<const N: usize> {
+    seq: AtomicU32,
+    used: AtomicU32,
+    words: [AtomicU32; N],
+}
+
+impl<const N: usize> Slot<N> {
+    fn write(&self, words: Option<[u32; N]>) {
+        let seq = self.seq.load(Ordering::Relaxed);
+        self.seq.store(seq.wrapping_add(1), Ordering::Relaxed);
+        fence(Ordering::Release);
+
+        match words {
+            Some(words) => {
+                for (slot, word) in self.words.iter().zip(words) {
+                    slot.store(word, Ordering::Relaxed);
+                }
+                self.used.store(1, Ordering::Relaxed);
+            }
+            None => self.used.store(0, Ordering::Relaxed),
+        }
+
+        self.seq.store(seq.wrapping_add(2), Ordering::Release);
+    }
+
+    fn read(&self) -> io::Result<Option<[u32; N]>> {
+        for attempt in 0..READ_ATTEMPTS {
+            if attempt >= READ_SPINS {
+                std::thread::yield_now();
+            } else if attempt > 0 {
+                std::hint::spin_loop();
+            }
+
+            let before = self.seq.load(Ordering::Acquire);
+            if before & 1 != 0 {
+                continue;
+            }
+
+            let used = self.used.load(Ordering::Relaxed);
+            let mut words = [0u32; N];
+            for (word, slot) in words.iter_mut().zip(&self.words) {
+                *word = slot.load(Ordering::Relaxed);
+            }
+
+            fence(Ordering::Acquire);
+            if self.seq.load(Ordering::Relaxed) == before {
+                return Ok((used != 0).then_some(words));
+            }
+        }
+
+        Err(io::Error::new(
+            io::ErrorKind::TimedOut,
+            "scene mirror slot is never left consistent by its writer",
+        ))
+    }
+}
+
+type SurfaceSlot = Slot<SURFACE_WORDS>;
+type LayerSlot = Slot<LAYER_WORDS>;
+
+fn mirror_size(surface_capacity: u32, layer_capacity: u32) -> usize {
+    HEADER_SIZE
+        + surface_capacity as usize * SURFACE_SLOT_SIZE
+        + layer_capacity as usize * LAYER_SLOT_SIZE
+}
+
+/// Memory mapping of a mirror file, unmapped on drop
+struct Mapping {
+    ptr: *mut u8,
+    len: usize,
+}
+
+// Safety: the mapping is only accessed through atomics
+unsafe impl Send for Mapping {}
+unsafe impl Sync for Mapping {}
+
+impl Mapping {
+    fn new(file: &File, len: usize, writable: bool) -> io::Result<Self> {
+        let prot = if writable {
+            libc::PROT_READ | libc::PROT_WRITE
+        } else {
+            libc::PROT_READ
+        };
+        // Safety: mapping a file we hold open; the result is checked below
+        let ptr = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                prot,
+                libc::MAP_SHARED,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(Self {
+            ptr: ptr as *mut u8,
+            len,
+        })
+    }
+
+    fn header(&self) -> &MirrorHeader {
+        // Safety: every mapping is at least HEADER_SIZE bytes and page aligned
+        unsafe { &*(self.ptr as *const MirrorHeader) }
+    }
+
+    /// Safety: the header must describe this mapping
+    unsafe fn surface_slot(&self, index: usize) -> &SurfaceSlot {
+        &*(self.ptr.add(HEADER_SIZE + index * SURFACE_SLOT_SIZE) as *const SurfaceSlot)
+    }
+
+    /// Safety: the header must describe this mapping
+    unsafe fn layer_slot(&self, index: usize) -> &LayerSlot {
+        let surfaces = self.header().surface_capacity as usize * SURFACE_SLOT_SIZE;
+        &*(self
+            .ptr
+            .add(HEADER_SIZE + surfaces + index * LAYER_SLOT_SIZE) as *const LayerSlot)
+    }
+}
+
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        // Safety: ptr and len come from a successful mmap
+        unsafe {
+            libc::munmap(self.ptr as *mut libc::c_void, self.len);
+        }
+    }
+}
+
+/// Slot assignment of the objects in the table
+struct SlotIndex {
+    slots: HashMap<u32, usize>,
+    free: Vec<usize>,
+}
+
+impl SlotIndex {
+    fn new(capacity: u32) -> Self {
+        Self {
+            slots: HashMap::new(),
+            // Lowest slots first, so a small scene stays at the front of the table
+            free: (0..capacity as usize).rev().collect(),
+        }
+    }
+
+    fn slot_for(&mut self, id: u32) -> Option<usize> {
+        if let Some(&slot) = self.slots.get(&id) {
+            return Some(slot);
+        }
+        let slot = self.free.pop()?;
+        self.slots.insert(id, slot);
+        Some(slot)
+    }
+
+    fn release(&mut self, id: u32) -> Option<usize> {
+        let slot = self.slots.remove(&id)?;
+        self.free.push(slot);
+        Some(slot)
+    }
+}
+
+struct MirrorIndex {
+    surfaces: SlotIndex,
+    layers: SlotIndex,
+    /// Surfaces in the scene that did not fit in the table
+    overflowed_surfaces: HashSet<u32>,
+    /// Layers in the scene that did not fit in the table
+    overflowed_layers: HashSet<u32>,
+    /// Generation of the last scene written to the table
+    generation: u64,
+}
+
+/// Writer side of the scene mirror, owned by the state manager
+pub struct SceneMirror {
+    path: PathBuf,
+    mapping: Mapping,
+    index: Mutex<MirrorIndex>,
+}
+
+impl SceneMirror {
+    /// Create the mirror file at `path`, replacing any left from an earlier run
+    ///
+    /// The file is filled in before it is renamed into place, so readers never
+    /// see a partial header. It is only readable by the compositor's user.
+    pub fn create(path: &Path) -> io::Result<Self> {
+        let len = mirror_size(SURFACE_CAPACITY, LAYER_CAPACITY);
+        let tmp_path = PathBuf::from(format!("{}.{}.tmp", path.display(), std::process::id()));
+
+        let file = OpenOptions::new()
+            .read(true)
+            .write(true)
+            .create(true)
+            .truncate(true)
+            .mode(0o600)
+            .open(&tmp_path)?;
+        let mapping = file
+            .set_len(len as u64)
+            .and_then(|_| Mapping::new(&file, len, true));
+        let mapping = match mapping {
+            Ok(mapping) => mapping,
+            Err(e) => {
+                let _ = std::fs::remove_file(&tmp_path);
+                return Err(e);
+            }
+        };
+
+        // Safety: the mapping is fresh and not shared yet
+        unsafe {
+            let header = mapping.ptr as *mut MirrorHeader;
+            (*header).magic = MIRROR_MAGIC;
+            (*header).version = MIRROR_VERSION;
+            (*header).header_size = HEADER_SIZE as u32;
+            (*header).surface_capacity = SURFACE_CAPACITY;
+            (*header).layer_capacity = LAYER_CAPACITY;
+            (*header).surface_slot_size = SURFACE_SLOT_SIZE as u32;
+            (*header).layer_slot_size = LAYER_SLOT_SIZE as u32;
+        }
+
+        // Readers still holding the previous file learn that it is dead
+        if let Ok(previous) = OpenOptions::new().read(true).write(true).open(path) {
+            if let Ok(previous) = SceneMirrorReader::map(&previous, true) {
+                previous
+                    .mapping
+                    .header()
+                    .flags
+                    .fetch_or(FLAG_CLOSED, Ordering::Release);
+            }
+        }
+
+        if let Err(e) = std::fs::rename(&tmp_path, path) {
+            let _ = std::fs::remove_file(&tmp_path);
+            return Err(e);
+        }
+
+        jinfo!("Scene mirror published at {}", path.display());
+
+        Ok(Self {
+            path: path.to_path_buf(),
+            mapping,
+            index: Mutex::new(MirrorIndex {
+                surfaces: SlotIndex::new(SURFACE_CAPACITY),
+                layers: SlotIndex::new(LAYER_CAPACITY),
+                overflowed_surfaces: HashSet::new(),
+                overflowed_layers: HashSet::new(),
+                generation: 0,
+            }),
+        })
+    }
+
+    /// Path of the mirror file
+    pub fn path(&self) -> &Path {
+        &self.path
+    }
+
+    /// Bring the table up to date with `scene`
+    ///
+    /// Only records changed since the last call are rewritten. Callers must
+    /// serialize calls with changes to the scene, which the state manager does
+    /// by calling this under its write lock.
+    pub fn sync(&self, scene: &SceneSnapshot) {
+        let mut index = self.index.lock().unwrap();
+        if index.generation == scene.generation {
+            return;
+        }
+
+        let changes = scene.changes_since(index.generation);
+
+        if changes.full {
+            // Nothing is reported removed, so drop whatever is no longer there
+            let gone: Vec<u32> = index
+                .surfaces
+                .slots
+                .keys()
+                .filter(|id| !scene.surfaces.contains_key(id))
+                .copied()
+                .collect();
+            for id in gone {
+                self.remove_surface(&mut index, id);
+            }
+            let gone: Vec<u32> = index
+                .layers
+                .slots
+                .keys()
+                .filter(|id| !scene.layers.contains_key(id))
+                .copied()
+                .collect();
+            for id in gone {
+                self.remove_layer(&mut index, id);
+            }
+            index
+                .overflowed_surfaces
+                .retain(|id| scene.surfaces.contains_key(id));
+            index
+                .overflowed_layers
+                .retain(|id| scene.layers.contains_key(id));
+        } else {
+            for &id in &changes.removed_surfaces {
+                self.remove_surface(&mut index, id);
+            }
+            for &id in &changes.removed_layers {
+                self.remove_layer(&mut index, id);
+            }
+        }
+
+        for surface in &changes.surfaces {
+            self.write_surface(&mut index, surface);
+        }
+        for layer in &changes.layers {
+            self.write_layer(&mut index, layer);
+        }
+
+        // Removals may have made room for objects that did not fit before
+        let waiting: Vec<u32> = index.overflowed_surfaces.iter().copied().collect();
+        for id in waiting {
+            if index.surfaces.free.is_empty() {
+                break;
+            }
+            if let Some(surface) = scene.surfaces.get(&id) {
+                self.write_surface(&mut index, surface);
+            }
+        }
+        let waiting: Vec<u32> = index.overflowed_layers.iter().copied().collect();
+        for id in waiting {
+            if index.layers.free.is_empty() {
+                break;
+            }
+            if let Some(layer) = scene.layers.get(&id) {
+                self.write_layer(&mut index, layer);
+            }
+        }
+
+        let header = self.mapping.header();
+        let overflow = !index.overflowed_surfaces.is_empty() || !index.overflowed_layers.is_empty();
+        if overflow {
+            if header.flags.fetch_or(FLAG_OVERFLOW, Ordering::Release) & FLAG_OVERFLOW == 0 {
+                jwarn!(
+                    "Scene mirror is full ({} surfaces, {} layers); readers must fall back to RPC",
+                    SURFACE_CAPACITY,
+                    LAYER_CAPACITY
+                );
+            }
+        } else if header.flags.fetch_and(!FLAG_OVERFLOW, Ordering::Release) & FLAG_OVERFLOW != 0 {
+            jinfo!("Scene mirror holds the whole scene again");
+        }
+
+        index.generation = scene.generation;
+        header.generation.store(scene.generation, Ordering::Release);
+    }
+
+    /// Write a surface to its slot, or note that it did not fit
+    fn write_surface(&self, index: &mut MirrorIndex, surface: &SurfaceState) {
+        match index.surfaces.slot_for(surface.id) {
+            // Safety: the slot index is bounded by the capacity in the header
+            Some(slot) => unsafe {
+                self.mapping
+                    .surface_slot(slot)
+                    .write(Some(SurfaceRecord::from(surface).to_words()));
+                index.overflowed_surfaces.remove(&surface.id);
+            },
+            None => {
+                index.overflowed_surfaces.insert(surface.id);
+            }
+        }
+    }
+
+    /// Write a layer to its slot, or note that it did not fit
+    fn write_layer(&self, index: &mut MirrorIndex, layer: &LayerState) {
+        match index.layers.slot_for(layer.id) {
+            // Safety: the slot index is bounded by the capacity in the header
+            Some(slot) => unsafe {
+                self.mapping
+                    .layer_slot(slot)
+                    .write(Some(LayerRecord::from(layer).to_words()));
+                index.overflowed_layers.remove(&layer.id);
+            },
+            None => {
+                index.overflowed_layers.insert(layer.id);
+            }
+        }
+    }
+
+    fn remove_surface(&self, index: &mut MirrorIndex, id: u32) {
+        index.overflowed_surfaces.remove(&id);
+        if let Some(slot) = index.surfaces.release(id) {
+            // Safety: the slot index is bounded by the capacity in the header
+            unsafe { self.mapping.surface_slot(slot).write(None) };
+        }
+    }
+
+    fn remove_layer(&self, index: &mut MirrorIndex, id: u32) {
+        index.overflowed_layers.remove(&id);
+        if let Some(slot) = index.layers.release(id) {
+            // Safety: the slot index is bounded by the capacity in the header
+            unsafe { self.mapping.layer_slot(slot).write(None) };
+        }
+    }
+}
+
+impl Drop for SceneMirror {
+    fn drop(&mut self) {
+        self.mapping
+            .header()
+            .flags
+            .fetch_or(FLAG_CLOSED, Ordering::Release);
+        let _ = std::fs::remove_file(&self.path);
+    }
+}
+
+/// Reader side of the scene mirror
+///
+/// Reads are plain loads from the shared mapping. A reader that finds
+/// [`is_closed`](Self::is_closed) set should open the file again, since the
+/// plugin has restarted or shut down.
+pub struct SceneMirrorReader {
+    mapping: Mapping,
+    surface_capacity: usize,
+    layer_capacity: usize,
+}
+
+impl SceneMirrorReader {
+    /// Map the mirror file at `path` read-only
+    pub fn open(path: &Path) -> io::Result<Self> {
+        let file = File::open(path)?;
+        Self::map(&file, false)
+    }
+
+    fn map(file: &File, writable: bool) -> io::Result<Self> {
+        let invalid = |what: &str| io::Error::new(io::ErrorKind::InvalidData, what.to_string());
+
+        let len = file.metadata()?.len() as usize;
+        if len < HEADER_SIZE {
+            return Err(invalid("scene mirror is truncated"));
+        }
+
+        let mapping = Mapping::new(file, len, writable)?;
+        let header = mapping.header();
+        if header.magic != MIRROR_MAGIC {
+            return Err(invalid("not a scene mirror"));
+        }
+        if header.version != MIRROR_VERSION
+            || header.header_size as usize != HEADER_SIZE
+            || header.surface_slot_size as usize != SURFACE_SLOT_SIZE
+            || header.layer_slot_size as usize != LAYER_SLOT_SIZE
+        {
+            return Err(invalid("unsupported scene mirror version"));
+        }
+        if len < mirror_size(header.surface_capacity, header.layer_capacity) {
+            return Err(invalid("scene mirror is truncated"));
+        }
+
+        Ok(Self {
+            surface_capacity: header.surface_capacity as usize,
+            layer_capacity: header.layer_capacity as usize,
+            mapping,
+        })
+    }
+
+    /// Scene generation the table was last brought up to
+    pub fn generation(&self) -> u64 {
+        self.mapping.header().generation.load(Ordering::Acquire)
+    }
+
+    /// True once the plugin stopped updating this file
+    pub fn is_closed(&self) -> bool {
+        self.mapping.header().flags.load(Ordering::Acquire) & FLAG_CLOSED != 0
+    }
+
+    /// True while some objects do not fit in the table
+    pub fn is_overflowed(&self) -> bool {
+        self.mapping.header().flags.load(Ordering::Acquire) & FLAG_OVERFLOW != 0
+    }
+
+    /// Number of surface slots
+    pub fn surface_capacity(&self) -> usize {
+        self.surface_capacity
+    }
+
+    /// Number of layer slots
+    pub fn layer_capacity(&self) -> usize {
+        self.layer_capacity
+    }
+
+    /// Record in surface slot `slot`, or None if the slot is empty
+    ///
+    /// Fails with `TimedOut` if the slot is never seen consistent, for
+    /// example because the plugin died while writing it.
+    pub fn read_surface(&self, slot: usize) -> io::Result<Option<SurfaceRecord>> {
+        if slot >= self.surface_capacity {
+            return Ok(None);
+        }
+        // Safety: bounds checked against the validated header
+        let words = unsafe { self.mapping.surface_slot(slot).read() }?;
+        Ok(words.map(SurfaceRecord::from_words))
+    }
+
+    /// Record in layer slot `slot`, or None if the slot is empty
+    ///
+    /// Fails with `TimedOut` if the slot is never seen consistent.
+    pub fn read_layer(&self, slot: usize) -> io::Result<Option<LayerRecord>> {
+        if slot >= self.layer_capacity {
+            return Ok(None);
+        }
+        // Safety: bounds checked against the validated header
+        let words = unsafe { self.mapping.layer_slot(slot).read() }?;
+        Ok(words.map(LayerRecord::from_words))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::controller::state::StateManager;
+    use crate::ffi::bindings::ivi_layout_api::IviLayoutApi;
+    use crate::ffi::bindings::{Orientation, Rectangle};
+    use std::sync::Arc;
+
+    fn mirror_path(name: &str) -> PathBuf {
+        std::env::temp_dir().join(format!("ivi-mirror-{}-{}", name, std::process::id()))
+    }
+
+    fn make_state_manager() -> StateManager {
+        let ivi_api = Arc::new(IviLayoutApi::from_raw(std::ptr::dangling()).unwrap());
+        StateManager::new(ivi_api)
+    }
+
+    fn surface(id: u32, x: i32) -> SurfaceState {
+        SurfaceState {
+            id,
+            orig_size: (1920, 1080),
+            src_rect: Rectangle {
+                x: 0,
+                y: 0,
+                width: 1920,
+                height: 1080,
+            },
+            dest_rect: Rectangle {
+                x,
+                y: x,
+                width: 960,
+                height: 540,
+            },
+            visibility: true,
+            opacity: 0.5,
+            orientation: Orientation::Rotate90,
+            z_order: 3,
+            is_auto_assigned: false,
+            original_id: None,
+        }
+    }
+
+    fn layer(id: u32) -> LayerState {
+        LayerState {
+            id,
+            visibility: false,
+            opacity: 1.0,
+            src_rect: (0, 0, 1920, 1080),
+            dest_rect: (10, 20, 1920, 1080),
+            orientation: Orientation::Flipped,
+        }
+    }
+
+    fn find_surface(reader: &SceneMirrorReader, id: u32) -> Option<SurfaceRecord> {
+        (0..reader.surface_capacity())
+            .filter_map(|slot| reader.read_surface(slot).unwrap())
+            .find(|record| record.id == id)
+    }
+
+    #[test]
+    fn records_have_the_c_layouts() {
+        assert_eq!(std::mem::size_of::<SurfaceRecord>(), 60);
+        assert_eq!(std::mem::offset_of!(SurfaceRecord, visibility), 44);
+        assert_eq!(std::mem::offset_of!(SurfaceRecord, opacity), 48);
+        assert_eq!(std::mem::size_of::<LayerRecord>(), 48);
+        assert_eq!(std::mem::offset_of!(LayerRecord, opacity), 40);
+        assert_eq!(HEADER_SIZE, 64);
+    }
+
+    #[test]
+    fn mirrors_the_scene_of_the_state_manager() {
+        let path = mirror_path("scene");
+        let sm = make_state_manager();
+        sm.add_surface(1000, surface(1000, 0));
+        sm.attach_scene_mirror(SceneMirror::create(&path).unwrap());
+
+        let reader = SceneMirrorReader::open(&path).unwrap();
+        assert_eq!(reader.generation(), sm.snapshot().generation);
+        let record = find_surface(&reader, 1000).unwrap();
+        assert_eq!(record, SurfaceRecord::from(&surface(1000, 0)));
+        assert_eq!(record.orientation, 1);
+
+        sm.add_layer(5000, layer(5000));
+        sm.update_surface(1000, surface(1000, 100));
+        sm.add_surface(1001, surface(1001, 0));
+        assert_eq!(find_surface(&reader, 1000).unwrap().dest_rect.x, 100);
+        assert!(find_surface(&reader, 1001).is_some());
+        let layer_record = (0..reader.layer_capacity())
+            .find_map(|slot| reader.read_layer(slot).unwrap())
+            .unwrap();
+        assert_eq!(layer_record, LayerRecord::from(&layer(5000)));
+
+        sm.remove_surface(1000);
+        assert!(find_surface(&reader, 1000).is_none());
+        assert_eq!(reader.generation(), sm.snapshot().generation);
+        assert!(!reader.is_closed());
+        assert!(!reader.is_overflowed());
+
+        drop(sm);
+        assert!(reader.is_closed());
+        assert!(!path.exists());
+    }
+
+    #[test]
+    fn replacing_the_mirror_closes_the_old_one() {
+        let path = mirror_path("replace");
+        let first = SceneMirror::create(&path).unwrap();
+        let reader = SceneMirrorReader::open(&path).unwrap();
+
+        let second = SceneMirror::create(&path).unwrap();
+        assert!(reader.is_closed());
+        assert!(!SceneMirrorReader::open(&path).unwrap().is_closed());
+
+        // The old writer must not take the new file with it
+        std::mem::forget(first);
+        drop(second);
+    }
+
+    #[test]
+    fn reports_overflow() {
+        let path = mirror_path("overflow");
+        let sm = make_state_manager();
+        sm.attach_scene_mirror(SceneMirror::create(&path).unwrap());
+        for id in 0..=SURFACE_CAPACITY {
+            sm.add_surface(id, surface(id, 0));
+        }
+
+        let reader = SceneMirrorReader::open(&path).unwrap();
+        assert!(reader.is_overflowed());
+        assert!(find_surface(&reader, 0).is_some());
+        assert!(find_surface(&reader, SURFACE_CAPACITY).is_none());
+
+        // The surface left out takes the first slot that frees up
+        sm.remove_surface(0);
+        assert!(!reader.is_overflowed());
+        assert_eq!(
+            find_surface(&reader, SURFACE_CAPACITY).unwrap(),
+            SurfaceRecord::from(&surface(SURFACE_CAPACITY, 0))
+        );
+
+        sm.add_surface(0, surface(0, 0));
+        assert!(reader.is_overflowed());
+        // A surface that did not fit is no longer waited for once it is gone
+        sm.remove_surface(0);
+        assert!(!reader.is_overflowed());
+        assert!(find_surface(&reader, 0).is_none());
+    }
+
+    #[test]
+    fn gives_up_on_a_slot_left_mid_write() {
+        let path = mirror_path("stuck");
+        let mirror = SceneMirror::create(&path).unwrap();
+        // As if the plugin died between the two counter updates
+        // Safety: slot 0 is within the capacity of the header
+        unsafe { mirror.mapping.surface_slot(0) }
+            .seq
+            .store(1, Ordering::Release);
+
+        let reader = SceneMirrorReader::open(&path).unwrap();
+        let err = reader.read_surface(0).unwrap_err();
+        assert_eq!(err.kind(), io::ErrorKind::TimedOut);
+        assert!(reader.read_surface(1).unwrap().is_none());
+    }
+
+    #[test]
+    fn mirror_is_private_to_its_user() {
+        use std::os::unix::fs::PermissionsExt;
+
+        let path = mirror_path("mode");
+        let _mirror = SceneMirror::create(&path).unwrap();
+        let mode = std::fs::metadata(&path).unwrap().permissions().mode();
+        assert_eq!(mode & 0o777, 0o600);
+    }
+
+    #[test]
+    fn rejects_files_that_are_not_mirrors() {
+        let path = mirror_path("garbage");
+        std::fs::write(&path, vec![0u8; 4096]).unwrap();
+        assert!(SceneMirrorReader::open(&path).is_err());
+        std::fs::remove_file(&path).unwrap();
+    }
+
+    #[test]
+    fn readers_never_see_torn_records() {
+        let path = mirror_path("torn");
+        let sm = Arc::new(make_state_manager());
+        sm.add_surface(1000, surface(1000, 0));
+        sm.attach_scene_mirror(SceneMirror::create(&path).unwrap());
+
+        let writer = {
+            let sm = Arc::clone(&sm);
+            std::thread::spawn(move || {
+                for x in 1..20_000 {
+                    sm.update_surface(1000, surface(1000, x));
+                }
+            })
+        };
+
+        // Every write keeps dest_rect.x == dest_rect.y
+        let reader = SceneMirrorReader::open(&path).unwrap();
+        while !writer.is_finished() {
+            let record = reader.read_surface(0).unwrap().unwrap();
+            assert_eq!(record.dest_rect.x, record.dest_rect.y);
+        }
+        writer.join().unwrap();
+    }
+}
@@ -0,0 +1,368 @@
+// Named scene presets, validated once and applied in one pass
+
+use super::validation::{self, ValidationError};
+use crate::ffi::bindings::Rectangle;
+use crate::rpc::protocol::{SceneDefinition, SceneRect};
+#[allow(unused)]
+use jlogger_tracing::{jdebug, jerror, jinfo, jwarn};
+use std::collections::HashMap;
+use std::path::Path;
+use std::sync::{Arc, Mutex};
+
+/// One IVI layout call of a preset
+#[derive(Debug, Clone, PartialEq)]
+pub enum SceneOp {
+    SurfaceSource {
+        id: u32,
+        rect: Rectangle,
+    },
+    SurfaceDestination {
+        id: u32,
+        rect: Rectangle,
+    },
+    SurfaceVisibility {
+        id: u32,
+        visible: bool,
+    },
+    SurfaceOpacity {
+        id: u32,
+        opacity: f32,
+    },
+    LayerSource {
+        id: u32,
+        rect: Rectangle,
+    },
+    LayerDestination {
+        id: u32,
+        rect: Rectangle,
+    },
+    LayerVisibility {
+        id: u32,
+        visible: bool,
+    },
+    LayerOpacity {
+        id: u32,
+        opacity: f32,
+    },
+    /// Render order of a layer, bottommost surface first
+    LayerSurfaces {
+        id: u32,
+        surface_ids: Box<[u32]>,
+    },
+    /// Render order of a screen
+    ScreenLayers {
+        name: Box<str>,
+        layer_ids: Box<[u32]>,
+    },
+}
+
+/// A scene definition turned into the IVI calls that apply it
+///
+/// Property changes come first, then layer and screen render orders, so a
+/// surface is configured before it becomes part of the visible scene.
+#[derive(Debug, Clone, PartialEq)]
+pub struct ScenePreset {
+    ops: Box<[SceneOp]>,
+    /// Every surface the preset refers to
+    surfaces: Box<[u32]>,
+    /// Every layer the preset refers to
+    layers: Box<[u32]>,
+    /// Every screen the preset refers to
+    screens: Box<[Box<str>]>,
+}
+
+impl ScenePreset {
+    /// Validate a definition and build its operations
+    ///
+    /// Errors name the offending entry, e.g. `surfaces[2]: Invalid opacity ...`.
+    pub fn compile(definition: &SceneDefinition) -> Result<Self, String> {
+        let mut ops = Vec::new();
+        let mut surfaces = Vec::new();
+        let mut layers = Vec::new();
+        let mut screens = Vec::new();
+
+        for (index, surface) in definition.surfaces.iter().enumerate() {
+            let at = |e: ValidationError| format!("surfaces[{}]: {}", index, e);
+            let id = surface.id;
+            if let Some(rect) = surface.source {
+                ops.push(SceneOp::SurfaceSource {
+                    id,
+                    rect: checked_rect(rect).map_err(at)?,
+                });
+            }
+            if let Some(rect) = surface.destination {
+                ops.push(SceneOp::SurfaceDestination {
+                    id,
+                    rect: checked_rect(rect).map_err(at)?,
+                });
+            }
+            if let Some(visible) = surface.visible {
+                ops.push(SceneOp::SurfaceVisibility { id, visible });
+            }
+            if let Some(opacity) = surface.opacity {
+                validation::validate_opacity(opacity).map_err(at)?;
+                ops.push(SceneOp::SurfaceOpacity { id, opacity });
+            }
+            surfaces.push(id);
+        }
+
+        let mut render_orders = Vec::new();
+        for (index, layer) in definition.layers.iter().enumerate() {
+            let at = |e: ValidationError| format!("layers[{}]: {}", index, e);
+            let id = layer.id;
+            if let Some(rect) = layer.source {
+                ops.push(SceneOp::LayerSource {
+                    id,
+                    rect: checked_rect(rect).map_err(at)?,
+                });
+            }
+            if let Some(rect) = layer.destination {
+                ops.push(SceneOp::LayerDestination {
+                    id,
+                    rect: checked_rect(rect).map_err(at)?,
+                });
+            }
+            if let Some(visible) = layer.visible {
+                ops.push(SceneOp::LayerVisibility { id, visible });
+            }
+            if let Some(opacity) = layer.opacity {
+                validation::validate_opacity(opacity).map_err(at)?;
+                ops.push(SceneOp::LayerOpacity { id, opacity });
+            }
+            if let Some(surface_ids) = &layer.surfaces {
+                surfaces.extend_from_slice(surface_ids);
+                render_orders.push(SceneOp::LayerSurfaces {
+                    id,
+                    surface_ids: surface_ids.as_slice().into(),
+                });
+            }
+            layers.push(id);
+        }
+        ops.append(&mut render_orders);
+
+        for (index, screen) in definition.screens.iter().enumerate() {
+            if screen.name.is_empty() {
+                return Err(format!("screens[{}]: Missing screen name", index));
+            }
+            layers.extend_from_slice(&screen.layers);
+            ops.push(SceneOp::ScreenLayers {
+                name: screen.name.as_str().into(),
+                layer_ids: screen.layers.as_slice().into(),
+            });
+            screens.push(screen.name.as_str().into());
+        }
+
+        if ops.is_empty() {
+            return Err("Scene sets nothing".to_string());
+        }
+
+        surfaces.sort_unstable();
+        surfaces.dedup();
+        layers.sort_unstable();
+        layers.dedup();
+        screens.sort_unstable();
+        screens.dedup();
+
+        Ok(Self {
+            ops: ops.into(),
+            surfaces: surfaces.into(),
+            layers: layers.into(),
+            screens: screens.into(),
+        })
+    }
+
+    pub fn ops(&self) -> &[SceneOp] {
+        &self.ops
+    }
+
+    /// Surfaces that must exist to apply the preset, sorted
+    pub fn surfaces(&self) -> &[u32] {
+        &self.surfaces
+    }
+
+    /// Layers that must exist to apply the preset, sorted
+    pub fn layers(&self) -> &[u32] {
+        &self.layers
+    }
+
+    /// Screens that must exist to apply the preset, sorted
+    pub fn screens(&self) -> &[Box<str>] {
+        &self.screens
+    }
+}
+
+/// Check a rectangle with the same rules as the `set_*_rectangle` requests
+fn checked_rect(rect: SceneRect) -> Result<Rectangle, ValidationError> {
+    validation::validate_position(rect.x, rect.y)?;
+    validation::validate_size(rect.width, rect.height)?;
+    Ok(Rectangle {
+        x: rect.x,
+        y: rect.y,
+        width: rect.width,
+        height: rect.height,
+    })
+}
+
+/// Scene presets by name
+#[derive(Default)]
+pub struct ScenePresets {
+    presets: Mutex<HashMap<String, Arc<ScenePreset>>>,
+}
+
+impl ScenePresets {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Store a preset under `name`, returning whether it replaced one
+    pub fn define(&self, name: &str, preset: ScenePreset) -> bool {
+        self.presets
+            .lock()
+            .unwrap()
+            .insert(name.to_string(), Arc::new(preset))
+            .is_some()
+    }
+
+    pub fn get(&self, name: &str) -> Option<Arc<ScenePreset>> {
+        self.presets.lock().unwrap().get(name).cloned()
+    }
+
+    /// Names of all presets, sorted
+    pub fn names(&self) -> Vec<String> {
+        let mut names: Vec<String> = self.presets.lock().unwrap().keys().cloned().collect();
+        names.sort();
+        names
+    }
+
+    /// Define the presets of a JSON file mapping names to scene definitions
+    ///
+    /// Nothing is defined unless every preset in the file is valid. Returns
+    /// the number of presets loaded.
+    pub fn load_file(&self, path: &Path) -> Result<usize, String> {
+        let contents = std::fs::read_to_string(path).map_err(|e| e.to_string())?;
+        let definitions: HashMap<String, SceneDefinition> =
+            serde_json::from_str(&contents).map_err(|e| e.to_string())?;
+
+        let mut compiled = Vec::with_capacity(definitions.len());
+        for (name, definition) in &definitions {
+            let preset =
+                ScenePreset::compile(definition).map_err(|e| format!("Scene '{}': {}", name, e))?;
+            compiled.push((name, preset));
+        }
+
+        for (name, preset) in compiled {
+            jdebug!("Loaded scene '{}' ({} operations)", name, preset.ops.len());
+            self.define(name, preset);
+        }
+        Ok(definitions.len())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use serde_json::json;
+
+    fn definition(value: serde_json::Value) -> SceneDefinition {
+        serde_json::from_value(value).unwrap()
+    }
+
+    #[test]
+    fn test_compile_orders_properties_before_render_orders() {
+        let preset = ScenePreset::compile(&definition(json!({
+            "screens": [{ "name": "HDMI-A-1", "layers": [10] }],
+            "layers": [{ "id": 10, "surfaces": [1001, 1000], "visible": true }],
+            "surfaces": [{
+                "id": 1000,
+                "destination": { "x": 0, "y": 0, "width": 1920, "height": 1080 },
+                "opacity": 1.0
+            }]
+        })))
+        .unwrap();
+
+        let rect = Rectangle {
+            x: 0,
+            y: 0,
+            width: 1920,
+            height: 1080,
+        };
+        assert_eq!(
+            preset.ops(),
+            &[
+                SceneOp::SurfaceDestination { id: 1000, rect },
+                SceneOp::SurfaceOpacity {
+                    id: 1000,
+                    opacity: 1.0
+                },
+                SceneOp::LayerVisibility {
+                    id: 10,
+                    visible: true
+                },
+                SceneOp::LayerSurfaces {
+                    id: 10,
+                    surface_ids: vec![1001, 1000].into(),
+                },
+                SceneOp::ScreenLayers {
+                    name: "HDMI-A-1".into(),
+                    layer_ids: vec![10].into(),
+                },
+            ]
+        );
+        assert_eq!(preset.surfaces(), &[1000, 1001]);
+        assert_eq!(preset.layers(), &[10]);
+        assert_eq!(preset.screens(), &["HDMI-A-1".into()]);
+    }
+
+    #[test]
+    fn test_compile_validates_values() {
+        let err = ScenePreset::compile(&definition(json!({
+            "surfaces": [{ "id": 1, "visible": true }, { "id": 2, "opacity": 1.5 }]
+        })))
+        .unwrap_err();
+        assert!(err.starts_with("surfaces[1]: Invalid opacity"), "{}", err);
+
+        let err = ScenePreset::compile(&definition(json!({
+            "layers": [{ "id": 10, "destination": { "x": 0, "y": 0, "width": 0, "height": 1 } }]
+        })))
+        .unwrap_err();
+        assert!(err.starts_with("layers[0]: Invalid size"), "{}", err);
+
+        assert!(ScenePreset::compile(&SceneDefinition::default()).is_err());
+    }
+
+    #[test]
+    fn test_load_file_is_all_or_nothing() {
+        let dir = std::env::temp_dir().join(format!("scene-presets-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let path = dir.join("scenes.json");
+        let presets = ScenePresets::new();
+
+        std::fs::write(
+            &path,
+            json!({
+                "navigation": { "surfaces": [{ "id": 1000, "visible": true }] },
+                "broken": { "surfaces": [{ "id": 1000, "opacity": -1.0 }] }
+            })
+            .to_string(),
+        )
+        .unwrap();
+        let err = presets.load_file(&path).unwrap_err();
+        assert!(err.starts_with("Scene 'broken'"), "{}", err);
+        assert!(presets.names().is_empty());
+
+        std::fs::write(
+            &path,
+            json!({
+                "navigation": { "surfaces": [{ "id": 1000, "visible": true }] },
+                "reverse_camera": { "layers": [{ "id": 20, "visible": true }] }
+            })
+            .to_string(),
+        )
+        .unwrap();
+        assert_eq!(presets.load_file(&path).unwrap(), 2);
+        assert_eq!(presets.names(), vec!["navigation", "reverse_camera"]);
+        assert!(presets.get("navigation").is_some());
+
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+}
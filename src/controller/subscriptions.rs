@@ -1,78 +1,538 @@
 // Subscription management for event notifications
 
-use crate::rpc::protocol::{EventType, RpcNotification};
+use crate::metrics::{metrics, QueueDepth};
+use crate::rpc::client_slab::{ClientKey, ClientMap};
+use crate::rpc::framing::SharedFrame;
+use crate::rpc::protocol::{Encoding, EventType, RpcNotification, SubscriptionScope};
 use crate::rpc::transport::ClientId;
 #[allow(unused)]
 use jlogger_tracing::{jdebug, jerror, jinfo, jtrace, jwarn};
-use std::collections::{HashMap, HashSet, VecDeque};
-use std::sync::{Arc, Mutex};
+use std::collections::{HashMap, VecDeque};
+use std::sync::{Arc, Condvar, Mutex, OnceLock};
 
 /// Default notification buffer size per client
 pub const DEFAULT_BUFFER_SIZE: usize = 100;
 
+/// A notification as queued for its subscribers.
+///
+/// The wire frame is encoded at most once per encoding, the first time a
+/// client using that encoding needs it, and the same allocation is shared by
+/// every client it is delivered to.
+#[derive(Debug)]
+pub struct QueuedNotification {
+    notification: RpcNotification,
+    key: Option<CoalesceKey>,
+    /// Object created or destroyed, for lifecycle events
+    lifecycle: Option<ObjectRef>,
+    frames: [OnceLock<SharedFrame>; Encoding::COUNT],
+}
+
+impl QueuedNotification {
+    pub fn new(event_type: EventType, notification: RpcNotification) -> Self {
+        Self {
+            key: coalesce_key(event_type, &notification),
+            lifecycle: lifecycle_object(event_type, &notification),
+            notification,
+            frames: Default::default(),
+        }
+    }
+
+    /// The decoded notification
+    pub fn notification(&self) -> &RpcNotification {
+        &self.notification
+    }
+
+    /// The frame in `encoding`, ready to be written to a transport
+    pub fn frame(&self, encoding: Encoding) -> Result<&SharedFrame, String> {
+        let slot = &self.frames[encoding as usize];
+        if let Some(frame) = slot.get() {
+            return Ok(frame);
+        }
+
+        let payload = self
+            .notification
+            .encode(encoding)
+            .map_err(|e| e.to_string())?;
+        let frame = SharedFrame::new(&payload).map_err(|e| e.to_string())?;
+
+        // A concurrent caller may have won the race; both frames are identical
+        Ok(slot.get_or_init(|| frame))
+    }
+}
+
+/// Events reported from a surface's property listener
+const SURFACE_PROPERTY_EVENTS: [EventType; 7] = [
+    EventType::SurfaceContentSizeChanged,
+    EventType::SourceGeometryChanged,
+    EventType::DestinationGeometryChanged,
+    EventType::VisibilityChanged,
+    EventType::OpacityChanged,
+    EventType::OrientationChanged,
+    EventType::ZOrderChanged,
+];
+
+/// Identifies the object state a notification reports, for coalescing
+type CoalesceKey = (EventType, u32);
+
+/// Coalescing key of a state change notification
+///
+/// Lifecycle and focus events have no key: they are never merged and never
+/// evicted from a coalescing client's buffer.
+fn coalesce_key(event_type: EventType, notification: &RpcNotification) -> Option<CoalesceKey> {
+    let id_field = match event_type {
+        EventType::SurfaceContentSizeChanged
+        | EventType::SourceGeometryChanged
+        | EventType::DestinationGeometryChanged
+        | EventType::VisibilityChanged
+        | EventType::OpacityChanged
+        | EventType::OrientationChanged
+        | EventType::ZOrderChanged => "surface_id",
+        EventType::LayerVisibilityChanged | EventType::LayerOpacityChanged => "layer_id",
+        _ => return None,
+    };
+
+    let id = notification.params.get(id_field)?.as_u64()?;
+    Some((event_type, id as u32))
+}
+
+/// Object a coalescing key belongs to
+fn key_object((event_type, id): CoalesceKey) -> ObjectRef {
+    match event_type {
+        EventType::LayerVisibilityChanged | EventType::LayerOpacityChanged => ObjectRef::Layer(id),
+        _ => ObjectRef::Surface(id),
+    }
+}
+
+/// Object created or destroyed by a lifecycle notification
+fn lifecycle_object(event_type: EventType, notification: &RpcNotification) -> Option<ObjectRef> {
+    let id = |field: &str| {
+        notification
+            .params
+            .get(field)
+            .and_then(|value| value.as_u64())
+            .map(|id| id as u32)
+    };
+
+    match event_type {
+        EventType::SurfaceCreated | EventType::SurfaceDestroyed => {
+            id("surface_id").map(ObjectRef::Surface)
+        }
+        EventType::LayerCreated | EventType::LayerDestroyed => id("layer_id").map(ObjectRef::Layer),
+        _ => None,
+    }
+}
+
+/// Combine a pending state change with a newer one for the same object
+///
+/// The result carries the newer values and the `old_*` values of the pending
+/// notification, so the client still sees where the change started.
+fn merge_state_change(pending: &RpcNotification, newer: RpcNotification) -> RpcNotification {
+    let mut merged = newer;
+    if let (Some(merged_params), Some(pending_params)) =
+        (merged.params.as_object_mut(), pending.params.as_object())
+    {
+        for (key, value) in pending_params {
+            if key.starts_with("old_") {
+                merged_params.insert(key.clone(), value.clone());
+            }
+        }
+    }
+    merged
+}
+
+/// Set of event types, one bit per type (see [`EventType::bit`])
+type EventMask = u32;
+
+/// A surface or layer that events can be subscribed for
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum ObjectRef {
+    Surface(u32),
+    Layer(u32),
+}
+
+impl ObjectRef {
+    /// The objects named by a subscription scope
+    fn in_scope(scope: &SubscriptionScope) -> impl Iterator<Item = ObjectRef> + '_ {
+        let surfaces = scope.surface_ids.iter().map(|&id| ObjectRef::Surface(id));
+        let layers = scope.layer_ids.iter().map(|&id| ObjectRef::Layer(id));
+        surfaces.chain(layers)
+    }
+}
+
+/// Objects a notification is about
+///
+/// Focus changes refer to both the previously and the newly focused surface,
+/// and animations to whichever of a surface or a layer they animate.
+fn notification_objects(
+    event_type: EventType,
+    notification: &RpcNotification,
+) -> [Option<ObjectRef>; 2] {
+    let id = |field: &str| {
+        notification
+            .params
+            .get(field)
+            .and_then(|value| value.as_u64())
+            .map(|id| id as u32)
+    };
+
+    match event_type {
+        EventType::FocusChanged => [
+            id("old_focused_surface").map(ObjectRef::Surface),
+            id("new_focused_surface").map(ObjectRef::Surface),
+        ],
+        EventType::LayerCreated
+        | EventType::LayerDestroyed
+        | EventType::LayerVisibilityChanged
+        | EventType::LayerOpacityChanged => [id("layer_id").map(ObjectRef::Layer), None],
+        EventType::AnimationCompleted => [
+            id("surface_id").map(ObjectRef::Surface),
+            id("layer_id").map(ObjectRef::Layer),
+        ],
+        _ => [id("surface_id").map(ObjectRef::Surface), None],
+    }
+}
+
 /// Per-client subscription state
 struct ClientSubscription {
-    event_types: HashSet<EventType>,
-    event_buffer: VecDeque<RpcNotification>,
+    /// Shared with the delivery thread, so draining clones no peer names
+    client_id: Arc<ClientId>,
+    /// Events subscribed for every object
+    event_mask: EventMask,
+    /// Events subscribed for individual objects, never zero
+    object_masks: HashMap<ObjectRef, EventMask>,
+    /// Queued notifications; `None` marks a state change evicted from the middle
+    event_buffer: VecDeque<Option<Arc<QueuedNotification>>>,
+    /// Position of the first slot of `event_buffer`, counted since the client was created
+    buffer_start: u64,
+    /// Notifications in `event_buffer`, not counting evicted slots
+    queued: usize,
     buffer_size: usize,
+    /// Merge state changes per object instead of queueing each one
+    coalesce: bool,
+    /// Position of the state change each newer one merges into (coalescing only)
+    pending_changes: HashMap<CoalesceKey, u64>,
+    /// Positions of queued state changes, oldest first, for eviction (coalescing only)
+    state_changes: VecDeque<u64>,
+    /// Notifications dropped because the buffer was full
+    dropped: u64,
 }
 
 impl ClientSubscription {
-    fn new(buffer_size: usize) -> Self {
+    fn new(client_id: &ClientId, buffer_size: usize) -> Self {
         Self {
-            event_types: HashSet::new(),
+            client_id: Arc::new(client_id.clone()),
+            event_mask: 0,
+            object_masks: HashMap::new(),
             event_buffer: VecDeque::with_capacity(buffer_size),
+            buffer_start: 0,
+            queued: 0,
             buffer_size,
+            coalesce: false,
+            pending_changes: HashMap::new(),
+            state_changes: VecDeque::new(),
+            dropped: 0,
         }
     }
 
-    fn subscribe(&mut self, event_types: Vec<EventType>) {
-        for event_type in event_types {
-            self.event_types.insert(event_type);
+    /// Whether an event for `object` with `bit` is wanted through an object subscription
+    fn wants_object_event(&self, object: ObjectRef, bit: EventMask) -> bool {
+        self.object_masks
+            .get(&object)
+            .is_some_and(|mask| mask & bit != 0)
+    }
+
+    fn queue_notification(&mut self, notification: Arc<QueuedNotification>) {
+        if self.coalesce {
+            self.queue_coalesced(notification);
+            return;
         }
+
+        // If buffer is full, drop oldest (FIFO)
+        if self.queued >= self.buffer_size {
+            while let Some(dropped) = self.event_buffer.pop_front() {
+                self.buffer_start += 1;
+                if dropped.is_some() {
+                    self.queued -= 1;
+                    jdebug!("Dropped oldest notification due to buffer overflow");
+                    self.record_drop();
+                    break;
+                }
+            }
+        }
+        self.push(notification);
     }
 
-    fn unsubscribe(&mut self, event_types: Vec<EventType>) {
-        for event_type in event_types {
-            self.event_types.remove(&event_type);
+    /// Queue for a coalescing client
+    ///
+    /// A state change for an object that already has one pending replaces it
+    /// in place. A lifecycle event for an object ends its pending changes, so
+    /// later changes are queued after the event instead of merged ahead of it.
+    /// When the buffer is full the oldest state change is evicted; lifecycle
+    /// and focus events are kept even if that exceeds the buffer size.
+    fn queue_coalesced(&mut self, notification: Arc<QueuedNotification>) {
+        let key = notification.key;
+        if let Some(key) = key {
+            if let Some(&position) = self.pending_changes.get(&key) {
+                let slot = &mut self.event_buffer[(position - self.buffer_start) as usize];
+                if let Some(pending) = slot {
+                    let merged = merge_state_change(
+                        pending.notification(),
+                        notification.notification().clone(),
+                    );
+                    *slot = Some(Arc::new(QueuedNotification {
+                        notification: merged,
+                        key: Some(key),
+                        lifecycle: None,
+                        frames: Default::default(),
+                    }));
+                    jtrace!("Coalesced {:?} for object {}", key.0, key.1);
+                    metrics().notification_coalesced();
+                    return;
+                }
+            }
         }
+
+        if self.queued >= self.buffer_size {
+            self.evict_oldest_state_change();
+        }
+
+        if let Some(object) = notification.lifecycle {
+            self.pending_changes
+                .retain(|&pending, _| key_object(pending) != object);
+        }
+        if let Some(key) = key {
+            let position = self.buffer_start + self.event_buffer.len() as u64;
+            self.pending_changes.insert(key, position);
+            self.state_changes.push_back(position);
+        }
+        self.push(notification);
     }
 
-    fn is_subscribed(&self, event_type: &EventType) -> bool {
-        self.event_types.contains(event_type)
+    fn push(&mut self, notification: Arc<QueuedNotification>) {
+        self.event_buffer.push_back(Some(notification));
+        self.queued += 1;
+        metrics().notification_queued();
     }
 
-    fn queue_notification(&mut self, notification: RpcNotification) {
-        // If buffer is full, drop oldest (FIFO)
-        if self.event_buffer.len() >= self.buffer_size {
-            let dropped = self.event_buffer.pop_front();
-            if dropped.is_some() {
-                jdebug!("Dropped oldest notification due to buffer overflow");
+    /// Evict the oldest queued state change of a coalescing client
+    ///
+    /// Its slot is left empty rather than removed, so the positions of the
+    /// others stay valid. Empty slots are trimmed from the front, and the
+    /// buffer is compacted once they outnumber the queued notifications.
+    fn evict_oldest_state_change(&mut self) {
+        let Some(position) = self.state_changes.pop_front() else {
+            return;
+        };
+
+        let evicted = self.event_buffer[(position - self.buffer_start) as usize].take();
+        if let Some(key) = evicted.and_then(|evicted| evicted.key) {
+            if self.pending_changes.get(&key) == Some(&position) {
+                self.pending_changes.remove(&key);
+            }
+        }
+        self.queued -= 1;
+        jdebug!("Dropped oldest state change due to buffer overflow");
+        self.record_drop();
+
+        while let Some(None) = self.event_buffer.front() {
+            self.event_buffer.pop_front();
+            self.buffer_start += 1;
+        }
+        if self.event_buffer.len() - self.queued > self.queued {
+            self.event_buffer.retain(Option::is_some);
+            self.rebuild_pending_changes();
+        }
+    }
+
+    fn record_drop(&mut self) {
+        self.dropped += 1;
+        metrics().notification_dropped();
+    }
+
+    /// Rebuild the positions of state changes from the buffer
+    fn rebuild_pending_changes(&mut self) {
+        self.pending_changes.clear();
+        self.state_changes.clear();
+        for (index, queued) in self.event_buffer.iter().enumerate() {
+            let Some(queued) = queued else {
+                continue;
+            };
+            let position = self.buffer_start + index as u64;
+            if let Some(object) = queued.lifecycle {
+                self.pending_changes
+                    .retain(|&pending, _| key_object(pending) != object);
+            }
+            if let Some(key) = queued.key {
+                self.pending_changes.insert(key, position);
+                self.state_changes.push_back(position);
             }
         }
-        self.event_buffer.push_back(notification);
     }
 
-    fn drain_notifications(&mut self) -> Vec<RpcNotification> {
-        self.event_buffer.drain(..).collect()
+    fn has_pending(&self) -> bool {
+        self.queued > 0
+    }
+
+    fn drain_notifications(&mut self) -> Vec<Arc<QueuedNotification>> {
+        self.pending_changes.clear();
+        self.state_changes.clear();
+        self.buffer_start += self.event_buffer.len() as u64;
+        self.queued = 0;
+        self.event_buffer.drain(..).flatten().collect()
     }
 
     fn get_subscriptions(&self) -> Vec<EventType> {
-        self.event_types.iter().copied().collect()
+        EventType::from_mask(self.event_mask)
+    }
+}
+
+/// Subscription state of every client, with indexes for matching events
+///
+/// Client state is stored under the key the transport interned the client
+/// with when it connected. Queuing a notification looks up its subscribers by
+/// event type and by the object it is about instead of testing every client,
+/// and reaches their state by slot without hashing client IDs.
+#[derive(Default)]
+struct SubscriptionTable {
+    clients: ClientMap<ClientSubscription>,
+    /// Clients subscribed to each event type for every object, by `EventType as usize`
+    by_event: [Vec<ClientKey>; EventType::COUNT],
+    /// Clients with an object subscription for each object
+    by_object: HashMap<ObjectRef, Vec<ClientKey>>,
+    /// Number of notifications queued so far, stamped on each as `seq`
+    sequence: u64,
+}
+
+impl SubscriptionTable {
+    /// Key of a client that has subscription state
+    fn key(&self, client_id: &ClientId) -> Option<ClientKey> {
+        let key = client_id.key();
+        self.clients.contains(key).then_some(key)
+    }
+
+    /// Key of a client, creating its subscription state on first use
+    fn intern(&mut self, client_id: &ClientId, buffer_size: usize) -> ClientKey {
+        let key = client_id.key();
+        self.clients
+            .get_or_insert_with(key, || ClientSubscription::new(client_id, buffer_size));
+        key
+    }
+
+    fn client(&mut self, client_id: &ClientId, buffer_size: usize) -> &mut ClientSubscription {
+        let key = self.intern(client_id, buffer_size);
+        &mut self.clients[key]
+    }
+
+    /// Replace the events a client is subscribed to for every object
+    fn set_event_mask(&mut self, key: ClientKey, mask: EventMask) {
+        let Some(client_sub) = self.clients.get_mut(key) else {
+            return;
+        };
+        let old_mask = std::mem::replace(&mut client_sub.event_mask, mask);
+
+        for event_type in EventType::from_mask(old_mask ^ mask) {
+            let subscribers = &mut self.by_event[event_type as usize];
+            if mask & event_type.bit() != 0 {
+                subscribers.push(key);
+            } else {
+                subscribers.retain(|&subscriber| subscriber != key);
+            }
+        }
+    }
+
+    /// Replace the events a client is subscribed to for one object
+    fn set_object_mask(&mut self, key: ClientKey, object: ObjectRef, mask: EventMask) {
+        let Some(client_sub) = self.clients.get_mut(key) else {
+            return;
+        };
+        let old_mask = if mask == 0 {
+            client_sub.object_masks.remove(&object)
+        } else {
+            client_sub.object_masks.insert(object, mask)
+        };
+
+        match (old_mask, mask) {
+            (None, 0) => {}
+            (None, _) => self.by_object.entry(object).or_default().push(key),
+            (Some(_), 0) => {
+                if let Some(subscribers) = self.by_object.get_mut(&object) {
+                    subscribers.retain(|&subscriber| subscriber != key);
+                    if subscribers.is_empty() {
+                        self.by_object.remove(&object);
+                    }
+                }
+            }
+            (Some(_), _) => {}
+        }
+    }
+
+    fn remove_client(&mut self, client_id: &ClientId) -> bool {
+        let Some(key) = self.key(client_id) else {
+            return false;
+        };
+
+        self.set_event_mask(key, 0);
+        let objects: Vec<ObjectRef> = self.clients[key].object_masks.keys().copied().collect();
+        for object in objects {
+            self.set_object_mask(key, object, 0);
+        }
+        self.clients.remove(key);
+        true
     }
 }
 
+type ClientSubscriptions = Arc<Mutex<SubscriptionTable>>;
+
 /// Manages client subscriptions and event buffering
 pub struct SubscriptionManager {
-    subscriptions: Arc<Mutex<HashMap<ClientId, ClientSubscription>>>,
+    subscriptions: ClientSubscriptions,
+    /// Signalled whenever a notification is queued for at least one client
+    ready: Arc<Condvar>,
     buffer_size: usize,
 }
 
+/// Blocking handle used by the delivery thread to wait for queued notifications.
+///
+/// It shares the subscription table with its `SubscriptionManager` but can be
+/// used without holding the lock that usually wraps the manager.
+pub struct NotificationWaiter {
+    subscriptions: ClientSubscriptions,
+    ready: Arc<Condvar>,
+}
+
+impl NotificationWaiter {
+    /// Block until at least one client has pending notifications, then drain
+    /// the buffers of every such client in a single pass
+    ///
+    /// Both are linear scans over the client slab.
+    pub fn wait_and_drain(&self) -> Vec<(Arc<ClientId>, Vec<Arc<QueuedNotification>>)> {
+        let subs = self.subscriptions.lock().unwrap();
+        let mut subs = self
+            .ready
+            .wait_while(subs, |subs| {
+                !subs.clients.iter().any(|(_, s)| s.has_pending())
+            })
+            .unwrap();
+
+        subs.clients
+            .iter_mut()
+            .filter(|(_, client_sub)| client_sub.has_pending())
+            .map(|(_, client_sub)| {
+                (
+                    Arc::clone(&client_sub.client_id),
+                    client_sub.drain_notifications(),
+                )
+            })
+            .collect()
+    }
+}
+
 impl SubscriptionManager {
     /// Create a new subscription manager
     pub fn new() -> Self {
         Self {
-            subscriptions: Arc::new(Mutex::new(HashMap::new())),
+            subscriptions: Arc::new(Mutex::new(SubscriptionTable::default())),
+            ready: Arc::new(Condvar::new()),
             buffer_size: DEFAULT_BUFFER_SIZE,
         }
     }
@@ -80,7 +540,8 @@ impl SubscriptionManager {
     /// Create a new subscription manager with custom buffer size
     pub fn with_buffer_size(buffer_size: usize) -> Self {
         Self {
-            subscriptions: Arc::new(Mutex::new(HashMap::new())),
+            subscriptions: Arc::new(Mutex::new(SubscriptionTable::default())),
+            ready: Arc::new(Condvar::new()),
             buffer_size,
         }
     }
@@ -91,70 +552,252 @@ impl SubscriptionManager {
         client_id: &ClientId,
         event_types: Vec<EventType>,
     ) -> Result<Vec<EventType>, String> {
+        self.subscribe_scoped(client_id, event_types, &SubscriptionScope::default())
+    }
+
+    /// Subscribe a client to event types for the objects in `scope`
+    ///
+    /// A global scope subscribes to the events of every object.
+    pub fn subscribe_scoped(
+        &self,
+        client_id: &ClientId,
+        event_types: Vec<EventType>,
+        scope: &SubscriptionScope,
+    ) -> Result<Vec<EventType>, String> {
+        let mask = EventType::mask_of(&event_types);
         let mut subs = self.subscriptions.lock().unwrap();
-        let client_sub = subs
-            .entry(client_id.clone())
-            .or_insert_with(|| ClientSubscription::new(self.buffer_size));
+        let key = subs.intern(client_id, self.buffer_size);
 
-        client_sub.subscribe(event_types.clone());
+        if scope.is_global() {
+            let mask = subs.clients[key].event_mask | mask;
+            subs.set_event_mask(key, mask);
+        } else {
+            for object in ObjectRef::in_scope(scope) {
+                let client_sub = &subs.clients[key];
+                let mask = client_sub.object_masks.get(&object).copied().unwrap_or(0) | mask;
+                subs.set_object_mask(key, object, mask);
+            }
+        }
 
-        jinfo!("Client {} subscribed to {:?}", client_id, event_types);
+        jinfo!(
+            "Client {} subscribed to {:?} ({:?})",
+            client_id,
+            event_types,
+            scope
+        );
 
         Ok(event_types)
     }
 
-    /// Unsubscribe a client from event types
+    /// Enable or disable per-object coalescing of a client's state changes
+    pub fn set_coalescing(&self, client_id: &ClientId, coalesce: bool) {
+        let mut subs = self.subscriptions.lock().unwrap();
+        let client_sub = subs.client(client_id, self.buffer_size);
+
+        client_sub.coalesce = coalesce;
+        if coalesce {
+            client_sub.rebuild_pending_changes();
+        } else {
+            client_sub.pending_changes.clear();
+            client_sub.state_changes.clear();
+        }
+
+        jinfo!(
+            "Client {} coalescing {}",
+            client_id,
+            if coalesce { "enabled" } else { "disabled" }
+        );
+    }
+
+    /// Whether a client's state changes are coalesced
+    pub fn is_coalescing(&self, client_id: &ClientId) -> bool {
+        let subs = self.subscriptions.lock().unwrap();
+        subs.key(client_id)
+            .and_then(|key| subs.clients.get(key))
+            .is_some_and(|client_sub| client_sub.coalesce)
+    }
+
+    /// Unsubscribe a client from event types, for every object
     pub fn unsubscribe(
         &self,
         client_id: &ClientId,
         event_types: Vec<EventType>,
     ) -> Result<Vec<EventType>, String> {
+        self.unsubscribe_scoped(client_id, event_types, &SubscriptionScope::default())
+    }
+
+    /// Unsubscribe a client from event types for the objects in `scope`
+    ///
+    /// A global scope removes the event types from the client's global
+    /// subscription and from all of its object subscriptions.
+    pub fn unsubscribe_scoped(
+        &self,
+        client_id: &ClientId,
+        event_types: Vec<EventType>,
+        scope: &SubscriptionScope,
+    ) -> Result<Vec<EventType>, String> {
+        let mask = EventType::mask_of(&event_types);
         let mut subs = self.subscriptions.lock().unwrap();
 
-        if let Some(client_sub) = subs.get_mut(client_id) {
-            client_sub.unsubscribe(event_types.clone());
-            jinfo!("Client {} unsubscribed from {:?}", client_id, event_types);
-            Ok(event_types)
+        let Some(key) = subs.key(client_id) else {
+            return Err(format!("Client {} has no subscriptions", client_id));
+        };
+
+        let objects: Vec<ObjectRef> = if scope.is_global() {
+            let client_sub = &subs.clients[key];
+            let global_mask = client_sub.event_mask & !mask;
+            let objects = client_sub.object_masks.keys().copied().collect();
+            subs.set_event_mask(key, global_mask);
+            objects
         } else {
-            Err(format!("Client {} has no subscriptions", client_id))
+            ObjectRef::in_scope(scope).collect()
+        };
+
+        for object in objects {
+            let object_mask = subs.clients[key]
+                .object_masks
+                .get(&object)
+                .copied()
+                .unwrap_or(0);
+            subs.set_object_mask(key, object, object_mask & !mask);
         }
+
+        jinfo!(
+            "Client {} unsubscribed from {:?} ({:?})",
+            client_id,
+            event_types,
+            scope
+        );
+        Ok(event_types)
     }
 
-    /// Get a client's current subscriptions
+    /// Get a client's current subscriptions for every object
     pub fn get_subscriptions(&self, client_id: &ClientId) -> Vec<EventType> {
         let subs = self.subscriptions.lock().unwrap();
-        subs.get(client_id)
+        subs.key(client_id)
+            .and_then(|key| subs.clients.get(key))
             .map(|client_sub| client_sub.get_subscriptions())
             .unwrap_or_default()
     }
 
+    /// Get a client's object subscriptions
+    pub fn get_object_subscriptions(
+        &self,
+        client_id: &ClientId,
+    ) -> Vec<(ObjectRef, Vec<EventType>)> {
+        let subs = self.subscriptions.lock().unwrap();
+        let Some(client_sub) = subs.key(client_id).and_then(|key| subs.clients.get(key)) else {
+            return Vec::new();
+        };
+
+        let mut objects: Vec<(ObjectRef, Vec<EventType>)> = client_sub
+            .object_masks
+            .iter()
+            .map(|(&object, &mask)| (object, EventType::from_mask(mask)))
+            .collect();
+        objects.sort_by_key(|(object, _)| match *object {
+            ObjectRef::Surface(id) => (0, id),
+            ObjectRef::Layer(id) => (1, id),
+        });
+        objects
+    }
+
     /// Queue a notification for all subscribed clients
+    ///
+    /// The notification is shared by reference between every subscriber's
+    /// buffer and serialized on delivery, once per encoding in use.
     pub fn queue_notification(&self, event_type: EventType, notification: RpcNotification) {
         let mut subs = self.subscriptions.lock().unwrap();
+        let SubscriptionTable {
+            clients,
+            by_event,
+            by_object,
+            sequence,
+            ..
+        } = &mut *subs;
 
-        let subscribed_clients: Vec<ClientId> = subs
-            .iter()
-            .filter(|(_, client_sub)| client_sub.is_subscribed(&event_type))
-            .map(|(client_id, _)| (*client_id).clone())
-            .collect();
+        let bit = event_type.bit();
+        let objects = notification_objects(event_type, &notification);
+        let mut notification = Some(notification);
+        let mut queued: Option<Arc<QueuedNotification>> = None;
+        let mut delivered = 0;
+
+        // Built on the first match, so unwatched events cost only the lookups
+        let mut deliver = |client_sub: &mut ClientSubscription| {
+            let queued = queued.get_or_insert_with(|| {
+                // Consecutive for a client watching every event of every object,
+                // so a gap there means notifications were lost
+                let mut notification = notification.take().unwrap();
+                *sequence += 1;
+                if let Some(params) = notification.params.as_object_mut() {
+                    params.insert("seq".to_string(), (*sequence).into());
+                }
+                Arc::new(QueuedNotification::new(event_type, notification))
+            });
+            client_sub.queue_notification(Arc::clone(queued));
+            delivered += 1;
+        };
+
+        for &key in &by_event[event_type as usize] {
+            if let Some(client_sub) = clients.get_mut(key) {
+                deliver(client_sub);
+            }
+        }
+
+        for (index, object) in objects.iter().enumerate() {
+            let Some(object) = *object else {
+                continue;
+            };
+            let Some(subscribers) = by_object.get(&object) else {
+                continue;
+            };
+            // A client matching both objects of a focus change gets it once
+            let earlier = if index == 1 { objects[0] } else { None };
 
-        for client_id in subscribed_clients {
-            if let Some(client_sub) = subs.get_mut(&client_id) {
-                client_sub.queue_notification(notification.clone());
+            for &key in subscribers {
+                let Some(client_sub) = clients.get_mut(key) else {
+                    continue;
+                };
+                let wanted = client_sub.event_mask & bit == 0
+                    && client_sub.wants_object_event(object, bit)
+                    && !earlier.is_some_and(|earlier| client_sub.wants_object_event(earlier, bit));
+                if wanted {
+                    deliver(client_sub);
+                }
             }
         }
 
+        // Nobody is listening
+        if delivered == 0 {
+            return;
+        }
+
         jdebug!(
             "Queued notification for event type {:?} to {} clients",
             event_type,
-            subs.len()
+            delivered
         );
+
+        // Wake the delivery thread
+        self.ready.notify_all();
+    }
+
+    /// Create a waiter that blocks until notifications are queued
+    pub fn waiter(&self) -> NotificationWaiter {
+        NotificationWaiter {
+            subscriptions: Arc::clone(&self.subscriptions),
+            ready: Arc::clone(&self.ready),
+        }
     }
 
     /// Drain all pending notifications for a client
-    pub fn drain_notifications(&self, client_id: &ClientId) -> Vec<RpcNotification> {
+    pub fn drain_notifications(&self, client_id: &ClientId) -> Vec<Arc<QueuedNotification>> {
         let mut subs = self.subscriptions.lock().unwrap();
-        subs.get_mut(client_id)
+        let Some(key) = subs.key(client_id) else {
+            return Vec::new();
+        };
+        subs.clients
+            .get_mut(key)
             .map(|client_sub| client_sub.drain_notifications())
             .unwrap_or_default()
     }
@@ -162,7 +805,7 @@ impl SubscriptionManager {
     /// Remove a client (called on disconnect)
     pub fn remove_client(&self, client_id: &ClientId) {
         let mut subs = self.subscriptions.lock().unwrap();
-        if subs.remove(client_id).is_some() {
+        if subs.remove_client(client_id) {
             jinfo!(
                 "Removed subscriptions for disconnected client {}",
                 client_id
@@ -170,10 +813,46 @@ impl SubscriptionManager {
         }
     }
 
+    /// Pending and dropped notifications of each client, for metrics
+    pub fn queue_depths(&self) -> Vec<QueueDepth> {
+        let subs = self.subscriptions.lock().unwrap();
+        subs.clients
+            .iter()
+            .map(|(_, client_sub)| QueueDepth {
+                client_id: client_sub.client_id.to_string(),
+                depth: client_sub.queued,
+                dropped: client_sub.dropped,
+            })
+            .collect()
+    }
+
+    /// Whether any client is subscribed to a property change of surface `id`,
+    /// either for every surface or for this one
+    pub fn watches_surface_properties(&self, id: u32) -> bool {
+        let subs = self.subscriptions.lock().unwrap();
+        let mask = EventType::mask_of(&SURFACE_PROPERTY_EVENTS);
+
+        if SURFACE_PROPERTY_EVENTS
+            .iter()
+            .any(|&event_type| !subs.by_event[event_type as usize].is_empty())
+        {
+            return true;
+        }
+
+        let object = ObjectRef::Surface(id);
+        subs.by_object.get(&object).is_some_and(|subscribers| {
+            subscribers.iter().any(|&key| {
+                subs.clients
+                    .get(key)
+                    .is_some_and(|client_sub| client_sub.wants_object_event(object, mask))
+            })
+        })
+    }
+
     /// Get the number of active subscribers
     pub fn subscriber_count(&self) -> usize {
         let subs = self.subscriptions.lock().unwrap();
-        subs.len()
+        subs.clients.len()
     }
 }
 
@@ -240,7 +919,9 @@ mod tests {
 
         let drained = manager.drain_notifications(&client_id);
         assert_eq!(drained.len(), 1);
-        assert_eq!(drained[0], notification);
+        let mut expected = notification;
+        expected.params["seq"] = json!(1);
+        assert_eq!(*drained[0].notification(), expected);
 
         // Should be empty after drain
         let drained2 = manager.drain_notifications(&client_id);
@@ -265,9 +946,345 @@ mod tests {
             manager.queue_notification(EventType::SurfaceCreated, notification);
         }
 
+        assert_eq!(
+            manager.queue_depths(),
+            vec![QueueDepth {
+                client_id: client_id.to_string(),
+                depth: 2,
+                dropped: 1,
+            }]
+        );
+
         let drained = manager.drain_notifications(&client_id);
         // Should only have the last 2 notifications
         assert_eq!(drained.len(), 2);
+        // The dropped one leaves a gap in the sequence numbers
+        assert_eq!(drained[0].notification().params["seq"], 2);
+        assert_eq!(drained[1].notification().params["seq"], 3);
+    }
+
+    fn opacity_change(surface_id: u32, old: f32, new: f32) -> RpcNotification {
+        RpcNotification::new(
+            "notification".to_string(),
+            json!({
+                "event_type": "OpacityChanged",
+                "surface_id": surface_id,
+                "old_opacity": old,
+                "new_opacity": new
+            }),
+        )
+    }
+
+    fn surface_created(surface_id: u32) -> RpcNotification {
+        RpcNotification::new(
+            "notification".to_string(),
+            json!({"event_type": "SurfaceCreated", "surface_id": surface_id}),
+        )
+    }
+
+    #[test]
+    fn test_coalescing_merges_state_changes_per_object() {
+        let manager = SubscriptionManager::new();
+        let client_id = ClientId::from_u64(1);
+        manager
+            .subscribe(
+                &client_id,
+                vec![EventType::OpacityChanged, EventType::SurfaceCreated],
+            )
+            .unwrap();
+        manager.set_coalescing(&client_id, true);
+
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(1, 1.0, 0.75));
+        manager.queue_notification(EventType::SurfaceCreated, surface_created(2));
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(3, 1.0, 0.5));
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(1, 0.75, 0.5));
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(1, 0.5, 0.25));
+
+        let drained = manager.drain_notifications(&client_id);
+        assert_eq!(drained.len(), 3);
+
+        // Surface 1 keeps its place, its first old value and its latest new value
+        let params = &drained[0].notification().params;
+        assert_eq!(params["surface_id"], 1);
+        assert_eq!(params["old_opacity"], 1.0);
+        assert_eq!(params["new_opacity"], 0.25);
+        assert_eq!(drained[1].notification().params["surface_id"], 2);
+        assert_eq!(drained[2].notification().params["surface_id"], 3);
+
+        // A drained change is not merged into later ones
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(1, 0.25, 0.0));
+        let drained = manager.drain_notifications(&client_id);
+        assert_eq!(drained[0].notification().params["old_opacity"], 0.25);
+
+        // Without coalescing every change is queued
+        manager.set_coalescing(&client_id, false);
+        for _ in 0..2 {
+            manager.queue_notification(EventType::OpacityChanged, opacity_change(1, 1.0, 0.5));
+        }
+        assert_eq!(manager.drain_notifications(&client_id).len(), 2);
+    }
+
+    #[test]
+    fn test_coalescing_overflow_keeps_lifecycle_events() {
+        let manager = SubscriptionManager::with_buffer_size(2);
+        let client_id = ClientId::from_u64(1);
+        manager
+            .subscribe(
+                &client_id,
+                vec![EventType::OpacityChanged, EventType::SurfaceCreated],
+            )
+            .unwrap();
+        manager.set_coalescing(&client_id, true);
+
+        manager.queue_notification(EventType::SurfaceCreated, surface_created(1));
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(5, 1.0, 0.5));
+        // Full: the state change is evicted, not the lifecycle event
+        manager.queue_notification(EventType::SurfaceCreated, surface_created(2));
+        // Nothing left to evict, so the buffer grows past its size
+        manager.queue_notification(EventType::SurfaceCreated, surface_created(3));
+
+        let drained = manager.drain_notifications(&client_id);
+        let ids: Vec<_> = drained
+            .iter()
+            .map(|n| n.notification().params["surface_id"].as_u64().unwrap())
+            .collect();
+        assert_eq!(ids, vec![1, 2, 3]);
+    }
+
+    fn surface_destroyed(surface_id: u32) -> RpcNotification {
+        RpcNotification::new(
+            "notification".to_string(),
+            json!({"event_type": "SurfaceDestroyed", "surface_id": surface_id}),
+        )
+    }
+
+    #[test]
+    fn test_coalescing_does_not_merge_across_lifecycle_events() {
+        let manager = SubscriptionManager::new();
+        let client_id = ClientId::from_u64(1);
+        manager
+            .subscribe(
+                &client_id,
+                vec![
+                    EventType::OpacityChanged,
+                    EventType::SurfaceCreated,
+                    EventType::SurfaceDestroyed,
+                ],
+            )
+            .unwrap();
+        manager.set_coalescing(&client_id, true);
+
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(1, 1.0, 0.5));
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(2, 1.0, 0.5));
+        manager.queue_notification(EventType::SurfaceDestroyed, surface_destroyed(1));
+        manager.queue_notification(EventType::SurfaceCreated, surface_created(1));
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(1, 1.0, 0.25));
+        // Surface 2 had no lifecycle event, so it still merges
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(2, 0.5, 0.25));
+
+        let drained = manager.drain_notifications(&client_id);
+        let events: Vec<_> = drained
+            .iter()
+            .map(|n| {
+                let params = &n.notification().params;
+                (
+                    params["event_type"].as_str().unwrap().to_string(),
+                    params["surface_id"].as_u64().unwrap(),
+                )
+            })
+            .collect();
+        assert_eq!(
+            events,
+            vec![
+                ("OpacityChanged".to_string(), 1),
+                ("OpacityChanged".to_string(), 2),
+                ("SurfaceDestroyed".to_string(), 1),
+                ("SurfaceCreated".to_string(), 1),
+                ("OpacityChanged".to_string(), 1),
+            ]
+        );
+        assert_eq!(drained[0].notification().params["new_opacity"], 0.5);
+        assert_eq!(drained[1].notification().params["new_opacity"], 0.25);
+        assert_eq!(drained[4].notification().params["old_opacity"], 1.0);
+    }
+
+    #[test]
+    fn test_coalescing_eviction_keeps_order_and_merges() {
+        let manager = SubscriptionManager::with_buffer_size(3);
+        let client_id = ClientId::from_u64(1);
+        manager
+            .subscribe(
+                &client_id,
+                vec![EventType::OpacityChanged, EventType::SurfaceCreated],
+            )
+            .unwrap();
+        manager.set_coalescing(&client_id, true);
+
+        // A lifecycle event pins the front, so evicted slots pile up behind it
+        manager.queue_notification(EventType::SurfaceCreated, surface_created(100));
+        for id in 1..=20 {
+            manager.queue_notification(EventType::OpacityChanged, opacity_change(id, 1.0, 0.5));
+            // The newest change stays mergeable after every eviction
+            manager.queue_notification(EventType::OpacityChanged, opacity_change(id, 0.5, 0.25));
+        }
+        assert_eq!(manager.queue_depths()[0].depth, 3);
+        assert_eq!(manager.queue_depths()[0].dropped, 18);
+
+        let drained = manager.drain_notifications(&client_id);
+        let ids: Vec<_> = drained
+            .iter()
+            .map(|n| n.notification().params["surface_id"].as_u64().unwrap())
+            .collect();
+        assert_eq!(ids, vec![100, 19, 20]);
+        assert_eq!(drained[2].notification().params["old_opacity"], 1.0);
+        assert_eq!(drained[2].notification().params["new_opacity"], 0.25);
+        assert_eq!(manager.queue_depths()[0].depth, 0);
+    }
+
+    fn focus_changed(old: u32, new: u32) -> RpcNotification {
+        RpcNotification::new(
+            "notification".to_string(),
+            json!({
+                "event_type": "FocusChanged",
+                "old_focused_surface": old,
+                "new_focused_surface": new
+            }),
+        )
+    }
+
+    #[test]
+    fn test_watches_surface_properties() {
+        let manager = SubscriptionManager::new();
+        let client_id = ClientId::from_u64(1);
+        assert!(!manager.watches_surface_properties(1000));
+
+        // Lifecycle events do not need property listeners
+        manager
+            .subscribe(&client_id, vec![EventType::SurfaceCreated])
+            .unwrap();
+        assert!(!manager.watches_surface_properties(1000));
+
+        manager
+            .subscribe_scoped(
+                &client_id,
+                vec![EventType::OpacityChanged],
+                &scope(&[1000], &[]),
+            )
+            .unwrap();
+        assert!(manager.watches_surface_properties(1000));
+        assert!(!manager.watches_surface_properties(1001));
+
+        manager
+            .subscribe(&client_id, vec![EventType::DestinationGeometryChanged])
+            .unwrap();
+        assert!(manager.watches_surface_properties(1001));
+
+        manager.remove_client(&client_id);
+        assert!(!manager.watches_surface_properties(1000));
+    }
+
+    fn scope(surface_ids: &[u32], layer_ids: &[u32]) -> SubscriptionScope {
+        SubscriptionScope {
+            surface_ids: surface_ids.to_vec(),
+            layer_ids: layer_ids.to_vec(),
+        }
+    }
+
+    #[test]
+    fn test_scoped_subscription_filters_by_object() {
+        let manager = SubscriptionManager::new();
+        let scoped = ClientId::from_u64(1);
+        let global = ClientId::from_u64(2);
+        manager
+            .subscribe_scoped(
+                &scoped,
+                vec![EventType::OpacityChanged, EventType::FocusChanged],
+                &scope(&[1, 2], &[]),
+            )
+            .unwrap();
+        manager
+            .subscribe(&global, vec![EventType::OpacityChanged])
+            .unwrap();
+
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(1, 1.0, 0.5));
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(3, 1.0, 0.5));
+        // Both focused surfaces are in scope, but the event is queued once
+        manager.queue_notification(EventType::FocusChanged, focus_changed(1, 2));
+        manager.queue_notification(EventType::FocusChanged, focus_changed(3, 2));
+        manager.queue_notification(EventType::FocusChanged, focus_changed(3, 4));
+
+        let drained = manager.drain_notifications(&scoped);
+        assert_eq!(drained.len(), 3);
+        assert_eq!(drained[0].notification().params["surface_id"], 1);
+        assert_eq!(drained[1].notification().params["old_focused_surface"], 1);
+        assert_eq!(drained[2].notification().params["old_focused_surface"], 3);
+        assert_eq!(manager.drain_notifications(&global).len(), 2);
+
+        // Global and scoped subscriptions to the same event deliver once
+        manager
+            .subscribe(&scoped, vec![EventType::OpacityChanged])
+            .unwrap();
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(1, 0.5, 0.0));
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(3, 0.5, 0.0));
+        assert_eq!(manager.drain_notifications(&scoped).len(), 2);
+    }
+
+    #[test]
+    fn test_scoped_unsubscribe_and_listing() {
+        let manager = SubscriptionManager::new();
+        let client_id = ClientId::from_u64(1);
+        manager
+            .subscribe_scoped(
+                &client_id,
+                vec![EventType::OpacityChanged, EventType::VisibilityChanged],
+                &scope(&[1, 2], &[]),
+            )
+            .unwrap();
+        manager
+            .subscribe_scoped(
+                &client_id,
+                vec![EventType::LayerOpacityChanged],
+                &scope(&[], &[10]),
+            )
+            .unwrap();
+
+        manager
+            .unsubscribe_scoped(
+                &client_id,
+                vec![EventType::OpacityChanged, EventType::VisibilityChanged],
+                &scope(&[2], &[]),
+            )
+            .unwrap();
+        assert!(manager.get_subscriptions(&client_id).is_empty());
+        assert_eq!(
+            manager.get_object_subscriptions(&client_id),
+            vec![
+                (
+                    ObjectRef::Surface(1),
+                    vec![EventType::VisibilityChanged, EventType::OpacityChanged]
+                ),
+                (ObjectRef::Layer(10), vec![EventType::LayerOpacityChanged]),
+            ]
+        );
+
+        // Surface 2 no longer has subscribers
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(2, 1.0, 0.5));
+        assert!(manager.drain_notifications(&client_id).is_empty());
+
+        // A global unsubscribe also clears object subscriptions
+        manager
+            .unsubscribe(&client_id, vec![EventType::OpacityChanged])
+            .unwrap();
+        manager.queue_notification(EventType::OpacityChanged, opacity_change(1, 1.0, 0.5));
+        assert!(manager.drain_notifications(&client_id).is_empty());
+        assert_eq!(
+            manager.get_object_subscriptions(&client_id)[0],
+            (ObjectRef::Surface(1), vec![EventType::VisibilityChanged])
+        );
+
+        manager.remove_client(&client_id);
+        assert!(manager.get_object_subscriptions(&client_id).is_empty());
+        assert!(manager.subscriptions.lock().unwrap().by_object.is_empty());
     }
 
     #[test]
@@ -287,6 +1304,40 @@ mod tests {
         assert_eq!(manager.get_subscriptions(&client_id).len(), 0);
     }
 
+    #[test]
+    fn test_subscriptions_follow_the_transport_key() {
+        let manager = SubscriptionManager::new();
+        let mut slab = crate::rpc::client_slab::ClientSlab::new();
+        let first = slab.insert(());
+        let first_id = ClientId::from_u64(first.to_u64());
+
+        manager
+            .subscribe(&first_id, vec![EventType::SurfaceCreated])
+            .unwrap();
+
+        // The next client of the slot starts without the subscriptions of the
+        // one before, even if those were never removed
+        slab.remove(first);
+        let second = slab.insert(());
+        assert_eq!(second.slot(), first.slot());
+        let second_id = ClientId::from_u64(second.to_u64());
+        assert!(manager.get_subscriptions(&second_id).is_empty());
+
+        manager
+            .subscribe(&second_id, vec![EventType::SurfaceDestroyed])
+            .unwrap();
+        manager.queue_notification(
+            EventType::SurfaceCreated,
+            RpcNotification::new("notification".to_string(), json!({"surface_id": 1})),
+        );
+        assert!(manager.drain_notifications(&second_id).is_empty());
+        assert!(manager.get_subscriptions(&first_id).is_empty());
+        assert_eq!(
+            manager.get_subscriptions(&second_id),
+            vec![EventType::SurfaceDestroyed]
+        );
+    }
+
     #[test]
     fn test_only_subscribed_clients_receive_notifications() {
         let manager = SubscriptionManager::new();
@@ -315,4 +1366,77 @@ mod tests {
         let drained2 = manager.drain_notifications(&client2);
         assert_eq!(drained2.len(), 0);
     }
+
+    #[test]
+    fn test_waiter_wakes_on_queue() {
+        let manager = SubscriptionManager::new();
+        let client = ClientId::from_u64(1);
+        manager
+            .subscribe(&client, vec![EventType::OpacityChanged])
+            .unwrap();
+
+        let waiter = manager.waiter();
+        let delivery = std::thread::spawn(move || waiter.wait_and_drain());
+
+        // Unsubscribed events must not wake the waiter
+        manager.queue_notification(
+            EventType::SurfaceCreated,
+            RpcNotification::new("notification".to_string(), json!({})),
+        );
+        manager.queue_notification(
+            EventType::OpacityChanged,
+            RpcNotification::new("notification".to_string(), json!({"surface_id": 7})),
+        );
+
+        let drained = delivery.join().unwrap();
+        assert_eq!(drained.len(), 1);
+        assert_eq!(*drained[0].0, client);
+        assert_eq!(drained[0].1.len(), 1);
+        assert_eq!(drained[0].1[0].notification().params["surface_id"], 7);
+
+        // Buffers are empty after the waiter drained them
+        assert!(manager.drain_notifications(&client).is_empty());
+    }
+
+    #[test]
+    fn test_notification_serialized_once_for_all_clients() {
+        let manager = SubscriptionManager::new();
+        let client1 = ClientId::from_u64(1);
+        let client2 = ClientId::from_u64(2);
+
+        for client in [&client1, &client2] {
+            manager
+                .subscribe(client, vec![EventType::DestinationGeometryChanged])
+                .unwrap();
+        }
+
+        let notification =
+            RpcNotification::new("notification".to_string(), json!({"surface_id": 3}));
+        manager.queue_notification(EventType::DestinationGeometryChanged, notification.clone());
+
+        let drained1 = manager.drain_notifications(&client1);
+        let drained2 = manager.drain_notifications(&client2);
+
+        // Both clients share the same encoded frame
+        assert!(Arc::ptr_eq(&drained1[0], &drained2[0]));
+
+        let frame = drained1[0].frame(Encoding::Json).unwrap();
+        let mut notification = notification;
+        notification.params["seq"] = json!(1);
+        let expected = serde_json::to_vec(&notification).unwrap();
+        assert_eq!(frame.payload(), expected.as_slice());
+        assert_eq!(
+            &frame.as_bytes()[..4],
+            &(expected.len() as u32).to_be_bytes()
+        );
+
+        // Repeated lookups reuse the frame; other encodings get their own
+        let again = drained2[0].frame(Encoding::Json).unwrap();
+        assert_eq!(frame.as_bytes().as_ptr(), again.as_bytes().as_ptr());
+        let binary = drained2[0].frame(Encoding::MessagePack).unwrap();
+        assert_eq!(
+            crate::rpc::msgpack::decode(binary.payload()).unwrap(),
+            serde_json::to_value(&notification).unwrap()
+        );
+    }
 }
@@ -18,6 +18,7 @@ pub mod ivi_layout_api;
 pub mod ivi_layout_layer_properties_m;
 pub mod ivi_layout_surface_properties_m;
 pub mod ivi_surface;
+pub mod staged;
 pub mod weston_output_m;
 pub mod weston_surface_m;
 
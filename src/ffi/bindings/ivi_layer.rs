@@ -32,7 +32,7 @@ impl IviLayer {
     }
 
     /// Get layer properties
-    fn properties(&self) -> Option<IviLayoutLayerProperties> {
+    pub fn properties(&self) -> Option<IviLayoutLayerProperties> {
         self.api.get_properties_of_layer(self)
     }
 
@@ -3,6 +3,7 @@ use super::ivi_layout_get_api;
 use super::ivi_layout_layer_properties_m::IviLayoutLayerProperties;
 use super::ivi_layout_surface_properties_m::IviLayoutSurfaceProperties;
 use super::ivi_surface::IviSurface;
+use super::staged::{self, StagedKey, StagedProperties};
 use super::weston_output_m::WestonOutput;
 use super::weston_surface_m::WestonSurface;
 use super::IviLayoutTransitionType;
@@ -48,6 +49,66 @@ impl IviLayoutApi {
         }
     }
 
+    fn staged_key<T>(&self, object: *mut T) -> StagedKey {
+        (self.api as usize, object as usize)
+    }
+
+    /// Values staged for a surface through this interface since the last commit
+    pub fn staged_surface_properties(&self, surface: &IviSurface) -> StagedProperties {
+        staged::surface(self.staged_key(surface.handle()))
+    }
+
+    /// Values staged for a layer through this interface since the last commit
+    pub fn staged_layer_properties(&self, layer: &IviLayer) -> StagedProperties {
+        staged::layer(self.staged_key(layer.handle()))
+    }
+
+    /// Render order staged for a layer since the last commit, if any
+    pub fn staged_surfaces_on_layer(&self, layer: &IviLayer) -> Option<Vec<IviSurface>> {
+        let order = staged::layer_order(self.staged_key(layer.handle()))?;
+        let api = Arc::new(Self {
+            api: self.api,
+            compositor: self.compositor,
+        });
+        Some(
+            order
+                .into_iter()
+                .filter_map(|handle| IviSurface::new(handle as *mut _, api.clone()))
+                .collect(),
+        )
+    }
+
+    /// Render order staged for an output since the last commit, if any
+    pub fn staged_layers_on_screen(&self, output: &WestonOutput) -> Option<Vec<IviLayer>> {
+        let order = staged::screen_order(self.staged_key(output.clone().into()))?;
+        let api = Arc::new(Self {
+            api: self.api,
+            compositor: self.compositor,
+        });
+        Some(
+            order
+                .into_iter()
+                .filter_map(|handle| IviLayer::new(handle as *mut _, api.clone()))
+                .collect(),
+        )
+    }
+
+    fn committed_layer_order(&self, layer: &IviLayer) -> Vec<usize> {
+        self.get_surfaces_on_layer(layer)
+            .iter()
+            .map(|surface| surface.handle() as usize)
+            .collect()
+    }
+
+    fn committed_screen_order(&self, output: *mut weston_output) -> Vec<usize> {
+        // Safety: callers pass outputs they got from the compositor
+        unsafe { self.get_layers_on_screen(output) }
+            .unwrap_or_default()
+            .iter()
+            .map(|layer| layer.handle() as usize)
+            .collect()
+    }
+
     /// Commit all changes and execute all enqueued commands
     pub fn commit_changes(&self) -> Result<(), &'static str> {
         unsafe {
@@ -59,6 +120,7 @@ impl IviLayoutApi {
                 .commit_changes
                 .ok_or("commit_changes function is null")?;
             let result = commit_fn();
+            staged::clear(self.api as usize);
 
             if result == IVI_SUCCEEDED {
                 Ok(())
@@ -286,6 +348,9 @@ impl IviLayoutApi {
                 .ok_or("surface_set_visibility function is null")?;
             set_visibility_fn(surface.handle(), visible);
         }
+        staged::update_surface(self.staged_key(surface.handle()), |staged| {
+            staged.visibility = Some(visible)
+        });
         Ok(())
     }
 
@@ -304,6 +369,9 @@ impl IviLayoutApi {
                 return Err("Failed to set surface opacity");
             }
         }
+        staged::update_surface(self.staged_key(surface.handle()), |staged| {
+            staged.opacity = Some(opacity)
+        });
         Ok(())
     }
 
@@ -322,6 +390,14 @@ impl IviLayoutApi {
                 .ok_or("surface_set_source_rectangle function is null")?;
             set_source_rectangle_fn(surface.handle(), x, y, width, height);
         }
+        staged::update_surface(self.staged_key(surface.handle()), |staged| {
+            staged.source_rectangle = Some(Rectangle {
+                x,
+                y,
+                width,
+                height,
+            })
+        });
         Ok(())
     }
 
@@ -340,6 +416,14 @@ impl IviLayoutApi {
                 .ok_or("surface_set_destination_rectangle function is null")?;
             set_destination_rectangle_fn(surface.handle(), x, y, width, height);
         }
+        staged::update_surface(self.staged_key(surface.handle()), |staged| {
+            staged.destination_rectangle = Some(Rectangle {
+                x,
+                y,
+                width,
+                height,
+            })
+        });
         Ok(())
     }
 
@@ -658,6 +742,9 @@ impl IviLayoutApi {
                 .ok_or("layer_set_visibility function is null")?;
             set_visibility_fn(layer.handle(), visible);
         }
+        staged::update_layer(self.staged_key(layer.handle()), |staged| {
+            staged.visibility = Some(visible)
+        });
         Ok(())
     }
 
@@ -672,6 +759,9 @@ impl IviLayoutApi {
                 return Err("Failed to set layer opacity");
             }
         }
+        staged::update_layer(self.staged_key(layer.handle()), |staged| {
+            staged.opacity = Some(opacity)
+        });
         Ok(())
     }
 
@@ -690,6 +780,14 @@ impl IviLayoutApi {
                 .ok_or("layer_set_source_rectangle function is null")?;
             set_source_rectangle_fn(layer.handle(), x, y, width, height);
         }
+        staged::update_layer(self.staged_key(layer.handle()), |staged| {
+            staged.source_rectangle = Some(Rectangle {
+                x,
+                y,
+                width,
+                height,
+            })
+        });
         Ok(())
     }
 
@@ -708,6 +806,14 @@ impl IviLayoutApi {
                 .ok_or("layer_set_destination_rectangle function is null")?;
             set_destination_rectangle_fn(layer.handle(), x, y, width, height);
         }
+        staged::update_layer(self.staged_key(layer.handle()), |staged| {
+            staged.destination_rectangle = Some(Rectangle {
+                x,
+                y,
+                width,
+                height,
+            })
+        });
         Ok(())
     }
 
@@ -723,6 +829,16 @@ impl IviLayoutApi {
                 .ok_or("layer_add_surface function is null")?;
             add_surface_fn(layer.handle(), surface.handle());
         }
+        let handle = surface.handle() as usize;
+        staged::update_layer_order(
+            self.staged_key(layer.handle()),
+            || self.committed_layer_order(layer),
+            |order| {
+                if !order.contains(&handle) {
+                    order.push(handle);
+                }
+            },
+        );
         Ok(())
     }
 
@@ -738,6 +854,12 @@ impl IviLayoutApi {
                 .ok_or("layer_remove_surface function is null")?;
             remove_surface_fn(layer.handle(), surface.handle());
         }
+        let handle = surface.handle() as usize;
+        staged::update_layer_order(
+            self.staged_key(layer.handle()),
+            || self.committed_layer_order(layer),
+            |order| order.retain(|&staged| staged != handle),
+        );
         Ok(())
     }
 
@@ -758,6 +880,9 @@ impl IviLayoutApi {
                 handles.as_ptr() as *mut *mut ivi_layout_surface,
                 handles.len() as i32,
             );
+            staged::update_layer_order(self.staged_key(layer.handle()), Vec::new, |order| {
+                *order = handles.iter().map(|&handle| handle as usize).collect()
+            });
         }
         Ok(())
     }
@@ -835,7 +960,18 @@ impl IviLayoutApi {
             let add_layer_fn = (*self.api)
                 .screen_add_layer
                 .ok_or("screen_add_layer function is null")?;
-            add_layer_fn(output.into(), layer.handle());
+            let output: *mut weston_output = output.into();
+            add_layer_fn(output, layer.handle());
+            let handle = layer.handle() as usize;
+            staged::update_screen_order(
+                self.staged_key(output),
+                || self.committed_screen_order(output),
+                |order| {
+                    if !order.contains(&handle) {
+                        order.push(handle);
+                    }
+                },
+            );
         }
         Ok(())
     }
@@ -851,11 +987,15 @@ impl IviLayoutApi {
                 .screen_set_render_order
                 .ok_or("screen_set_layer_order function is null")?;
             let handles: Vec<*mut ivi_layout_layer> = layers.iter().map(|l| l.handle()).collect();
+            let output: *mut weston_output = output.into();
             set_order_fn(
-                output.into(),
+                output,
                 handles.as_ptr() as *mut *mut ivi_layout_layer,
                 handles.len() as i32,
             );
+            staged::update_screen_order(self.staged_key(output), Vec::new, |order| {
+                *order = handles.iter().map(|&handle| handle as usize).collect()
+            });
         }
         Ok(())
     }
@@ -963,7 +1103,14 @@ impl IviLayoutApi {
             let remove_layer_fn = (*self.api)
                 .screen_remove_layer
                 .ok_or("screen_remove_layer function is null")?;
-            remove_layer_fn(output.into(), layer.handle());
+            let output: *mut weston_output = output.into();
+            remove_layer_fn(output, layer.handle());
+            let handle = layer.handle() as usize;
+            staged::update_screen_order(
+                self.staged_key(output),
+                || self.committed_screen_order(output),
+                |order| order.retain(|&staged| staged != handle),
+            );
         }
         Ok(())
     }
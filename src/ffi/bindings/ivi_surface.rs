@@ -32,7 +32,7 @@ impl IviSurface {
     }
 
     /// Get surface properties
-    fn properties(&self) -> Option<IviLayoutSurfaceProperties> {
+    pub fn properties(&self) -> Option<IviLayoutSurfaceProperties> {
         self.api.get_properties_of_surface(self)
     }
 
@@ -0,0 +1,118 @@
+// Values staged through the IVI layout interface and not committed yet
+//
+// The interface keeps what is set as pending state and applies it on the
+// next commit, but it only reports committed values back. The wrappers record
+// what they stage here, so callers that have to put staged values back, like
+// a scene rolled back partway, can tell them from committed ones.
+
+use super::Rectangle;
+use std::sync::Mutex;
+
+/// Property values staged for one surface or layer; `None` if not staged
+#[derive(Debug, Clone, Copy, Default, PartialEq)]
+pub struct StagedProperties {
+    pub source_rectangle: Option<Rectangle>,
+    pub destination_rectangle: Option<Rectangle>,
+    pub visibility: Option<bool>,
+    pub opacity: Option<f32>,
+}
+
+/// Address of the IVI layout interface and of one of its objects
+pub(super) type StagedKey = (usize, usize);
+
+/// Staged values by object, looked up linearly: a handful are staged
+/// between two commits
+struct StagedChanges {
+    surfaces: Vec<(StagedKey, StagedProperties)>,
+    layers: Vec<(StagedKey, StagedProperties)>,
+    /// Surface handles of each layer's staged render order
+    layer_orders: Vec<(StagedKey, Vec<usize>)>,
+    /// Layer handles of each output's staged render order
+    screen_orders: Vec<(StagedKey, Vec<usize>)>,
+}
+
+static STAGED: Mutex<StagedChanges> = Mutex::new(StagedChanges {
+    surfaces: Vec::new(),
+    layers: Vec::new(),
+    layer_orders: Vec::new(),
+    screen_orders: Vec::new(),
+});
+
+fn entry<T: Default>(entries: &mut Vec<(StagedKey, T)>, key: StagedKey) -> &mut T {
+    let index = match entries.iter().position(|(k, _)| *k == key) {
+        Some(index) => index,
+        None => {
+            entries.push((key, T::default()));
+            entries.len() - 1
+        }
+    };
+    &mut entries[index].1
+}
+
+fn get<T: Clone>(entries: &[(StagedKey, T)], key: StagedKey) -> Option<T> {
+    entries
+        .iter()
+        .find(|(k, _)| *k == key)
+        .map(|(_, value)| value.clone())
+}
+
+pub(super) fn update_surface(key: StagedKey, change: impl FnOnce(&mut StagedProperties)) {
+    change(entry(&mut STAGED.lock().unwrap().surfaces, key));
+}
+
+pub(super) fn surface(key: StagedKey) -> StagedProperties {
+    get(&STAGED.lock().unwrap().surfaces, key).unwrap_or_default()
+}
+
+pub(super) fn update_layer(key: StagedKey, change: impl FnOnce(&mut StagedProperties)) {
+    change(entry(&mut STAGED.lock().unwrap().layers, key));
+}
+
+pub(super) fn layer(key: StagedKey) -> StagedProperties {
+    get(&STAGED.lock().unwrap().layers, key).unwrap_or_default()
+}
+
+/// Change the staged render order of a layer, starting from `committed` if
+/// none is staged yet
+pub(super) fn update_layer_order(
+    key: StagedKey,
+    committed: impl FnOnce() -> Vec<usize>,
+    change: impl FnOnce(&mut Vec<usize>),
+) {
+    let mut staged = STAGED.lock().unwrap();
+    if get(&staged.layer_orders, key).is_none() {
+        staged.layer_orders.push((key, committed()));
+    }
+    change(entry(&mut staged.layer_orders, key));
+}
+
+pub(super) fn layer_order(key: StagedKey) -> Option<Vec<usize>> {
+    get(&STAGED.lock().unwrap().layer_orders, key)
+}
+
+/// Change the staged render order of an output, starting from `committed`
+/// if none is staged yet
+pub(super) fn update_screen_order(
+    key: StagedKey,
+    committed: impl FnOnce() -> Vec<usize>,
+    change: impl FnOnce(&mut Vec<usize>),
+) {
+    let mut staged = STAGED.lock().unwrap();
+    if get(&staged.screen_orders, key).is_none() {
+        staged.screen_orders.push((key, committed()));
+    }
+    change(entry(&mut staged.screen_orders, key));
+}
+
+pub(super) fn screen_order(key: StagedKey) -> Option<Vec<usize>> {
+    get(&STAGED.lock().unwrap().screen_orders, key)
+}
+
+/// Forget everything staged through the interface at `api`, once committed
+pub(super) fn clear(api: usize) {
+    let mut staged = STAGED.lock().unwrap();
+    staged.surfaces.retain(|((a, _), _)| *a != api);
+    staged.layers.retain(|((a, _), _)| *a != api);
+    staged.layer_orders.retain(|((a, _), _)| *a != api);
+    staged.screen_orders.retain(|((a, _), _)| *a != api);
+}
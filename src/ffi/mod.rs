@@ -6,6 +6,7 @@ pub mod weston;
 // Re-export commonly used types
 pub use bindings::*;
 pub use weston::{
-    weston_compositor, weston_compositor_add_destroy_listener_once, weston_plugin_api_get,
-    wl_listener, wl_notify_func_t,
+    weston_compositor, weston_compositor_add_destroy_listener_once,
+    weston_compositor_schedule_repaint, weston_plugin_api_get, wl_list_remove, wl_listener,
+    wl_notify_func_t, wl_signal_add,
 };
@@ -33,3 +33,102 @@ extern "C" {
         destroy_handler: unsafe extern "C" fn(*mut wl_listener, *mut libc::c_void),
     ) -> bool;
 }
+
+// Functions exported by libwayland-server and libweston that are not part of
+// the generated bindings
+extern "C" {
+    /// Insert `elm` into a wl_list after `list`
+    ///
+    /// # Safety
+    /// - list must point to an element of an initialized wl_list
+    /// - elm must not be linked into any list
+    pub fn wl_list_insert(list: *mut super::bindings::wl_list, elm: *mut super::bindings::wl_list);
+
+    /// Unlink `elm` from its wl_list
+    ///
+    /// # Safety
+    /// - elm must be linked into a list that is still alive
+    pub fn wl_list_remove(elm: *mut super::bindings::wl_list);
+
+    /// Ask the compositor to repaint every output
+    ///
+    /// # Safety
+    /// - compositor must be a valid weston_compositor pointer
+    pub fn weston_compositor_schedule_repaint(compositor: *mut weston_compositor);
+}
+
+/// Add a listener to a signal, like the inline `wl_signal_add` of
+/// wayland-server-core.h
+///
+/// # Safety
+/// - signal must point to an initialized wl_signal
+/// - listener must point to a wl_listener that is not linked into any list
+///   and stays valid until it is removed with `wl_list_remove`
+pub unsafe fn wl_signal_add(signal: *mut super::bindings::wl_signal, listener: *mut wl_listener) {
+    wl_list_insert((*signal).listener_list.prev, &mut (*listener).link);
+}
+
+/// Event loop of a Wayland display
+#[repr(C)]
+pub struct wl_event_loop {
+    _unused: [u8; 0],
+}
+
+/// Source registered with a `wl_event_loop`
+#[repr(C)]
+pub struct wl_event_source {
+    _unused: [u8; 0],
+}
+
+/// File descriptor readiness mask of wayland-server-core.h
+pub const WL_EVENT_READABLE: u32 = 0x01;
+
+/// Callback of a file descriptor event source
+pub type wl_event_loop_fd_func_t =
+    unsafe extern "C" fn(fd: libc::c_int, mask: u32, data: *mut libc::c_void) -> libc::c_int;
+
+/// Callback of an idle event source
+pub type wl_event_loop_idle_func_t = unsafe extern "C" fn(data: *mut libc::c_void);
+
+// Event loop functions of libwayland-server
+extern "C" {
+    /// Event loop that dispatches the requests of `display`
+    ///
+    /// # Safety
+    /// - display must be a valid wl_display pointer
+    pub fn wl_display_get_event_loop(
+        display: *mut super::bindings::wl_display,
+    ) -> *mut wl_event_loop;
+
+    /// Call `func` from `event_loop` whenever `fd` is ready for `mask`
+    ///
+    /// # Safety
+    /// - event_loop must be a valid wl_event_loop pointer
+    /// - data must stay valid until the source is removed
+    pub fn wl_event_loop_add_fd(
+        event_loop: *mut wl_event_loop,
+        fd: libc::c_int,
+        mask: u32,
+        func: wl_event_loop_fd_func_t,
+        data: *mut libc::c_void,
+    ) -> *mut wl_event_source;
+
+    /// Call `func` once, the next time `event_loop` runs out of events
+    ///
+    /// The source is freed after the call.
+    ///
+    /// # Safety
+    /// - event_loop must be a valid wl_event_loop pointer
+    /// - data must stay valid until the call or until the source is removed
+    pub fn wl_event_loop_add_idle(
+        event_loop: *mut wl_event_loop,
+        func: wl_event_loop_idle_func_t,
+        data: *mut libc::c_void,
+    ) -> *mut wl_event_source;
+
+    /// Remove and free an event source
+    ///
+    /// # Safety
+    /// - source must be a source that has not been removed yet
+    pub fn wl_event_source_remove(source: *mut wl_event_source) -> libc::c_int;
+}
@@ -50,6 +50,21 @@
 //! - `--socket-path=<path>`: Path to the UNIX domain socket (default: /tmp/weston-ivi-controller.sock)
 //! - `--max-connections=<num>`: Maximum number of client connections (default: 10)
 //!
+//! ## Scene Mirror Configuration
+//! - `--scene-mirror=<path|off>`: Shared-memory file the scene is published in for
+//!   read-only clients (default: /dev/shm/weston-ivi-controller.scene)
+//!
+//! ## Startup Configuration
+//! - `--startup-mode=<immediate|deferred>`: `deferred` starts listening at once and
+//!   loads the scene once the compositor is idle (default: immediate)
+//!
+//! ## Scene Preset Configuration
+//! - `--scene-presets=<path>`: JSON file of named scenes for `apply_scene`, loaded at startup
+//!
+//! ## Recording Configuration
+//! - `--record=<path>`: Record received requests and sent notifications to `path`,
+//!   for `ivi_cli replay` (default: not recorded)
+//!
 //! ## ID Assignment Configuration
 //! - `--id-start=<id>`: Starting ID for auto-assignment range (default: 0x10000000, supports hex with 0x prefix)
 //! - `--id-max=<id>`: Maximum ID for auto-assignment range (default: 0xFFFFFFFE, supports hex with 0x prefix)
@@ -62,6 +77,10 @@
 //! Configuration can also be set via environment variables (overridden by command-line args):
 //! - `WESTON_IVI_SOCKET_PATH`: Socket path
 //! - `WESTON_IVI_MAX_CONNECTIONS`: Maximum connections
+//! - `WESTON_IVI_SCENE_MIRROR`: Scene mirror path, or `off`
+//! - `WESTON_IVI_SCENE_PRESETS`: Scene presets file
+//! - `WESTON_IVI_RECORD`: RPC traffic recording file
+//! - `WESTON_IVI_STARTUP_MODE`: Startup mode (`immediate` or `deferred`)
 //! - `WESTON_IVI_ID_START`: ID assignment start ID
 //! - `WESTON_IVI_ID_MAX`: ID assignment max ID
 //! - `WESTON_IVI_ID_INVALID`: Invalid ID value
@@ -78,6 +97,7 @@
 pub mod controller;
 pub mod error;
 pub mod ffi;
+pub mod metrics;
 pub mod rpc;
 pub mod transport;
 
@@ -94,18 +114,50 @@ use std::sync::{Arc, Mutex};
 
 use libc::{c_char, c_int, c_void};
 
-use crate::controller::notifications::NotificationType;
+use crate::controller::notifications::{NotificationCallback, NotificationType};
 use crate::ffi::bindings::ivi_layout_api::IviLayoutApi;
+use crate::metrics::BootTimer;
+use controller::scene_mirror::DEFAULT_SCENE_MIRROR_PATH;
 use controller::{
-    EventContext, EventListeners, IdAssignmentConfig, IdAssignmentManager, StateManager,
+    EventContext, EventListeners, FrameListeners, IdAssignmentConfig, IdAssignmentManager,
+    IdleCallback, LoopWakeup, SceneMirror, StateManager,
 };
-use rpc::{NotificationBridge, RpcHandler};
+use rpc::executor::default_read_workers;
+use rpc::{transport::DEFAULT_MAX_PENDING_BYTES, NotificationBridge, RpcHandler, SlowClientPolicy};
 #[cfg(not(feature = "enable-ipcon"))]
 use transport::{unix_socket::UnixSocketConfig, UnixSocketTransport};
 
 #[cfg(feature = "enable-ipcon")]
 use transport::ipcon::IpconTransport;
 
+/// When the plugin loads the scene and registers its IVI listeners
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum StartupMode {
+    /// Everything before `wet_module_init` returns
+    #[default]
+    Immediate,
+
+    /// Listen on the socket at once and do the rest once the compositor's
+    /// event loop is idle; per-surface property listeners are only attached
+    /// to surfaces with subscribers
+    Deferred,
+}
+
+impl std::str::FromStr for StartupMode {
+    type Err = String;
+
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        match s {
+            "immediate" => Ok(StartupMode::Immediate),
+            "deferred" => Ok(StartupMode::Deferred),
+            _ => Err(format!(
+                "Invalid startup mode '{}' (expected 'immediate' or 'deferred')",
+                s
+            )),
+        }
+    }
+}
+
 /// Plugin configuration structure
 ///
 /// This struct holds all configuration parameters for the plugin,
@@ -118,6 +170,24 @@ pub struct PluginConfig {
     /// Maximum number of client connections
     pub max_connections: usize,
 
+    /// Maximum bytes queued for a client that is not reading its socket
+    pub max_pending_bytes: usize,
+
+    /// What to do with a client that exceeds `max_pending_bytes`
+    pub slow_client_policy: SlowClientPolicy,
+
+    /// Shared-memory file the scene is mirrored to, or None to not publish it
+    pub scene_mirror_path: Option<PathBuf>,
+
+    /// JSON file of scene presets loaded at startup
+    pub scene_presets_path: Option<PathBuf>,
+
+    /// File received requests and sent notifications are recorded to
+    pub record_path: Option<PathBuf>,
+
+    /// When the scene is loaded and the IVI listeners are registered
+    pub startup_mode: StartupMode,
+
     /// ID assignment configuration
     pub id_assignment: IdAssignmentConfig,
 }
@@ -127,6 +197,12 @@ impl Default for PluginConfig {
         Self {
             socket_path: PathBuf::from("/tmp/weston-ivi-controller.sock"),
             max_connections: 10,
+            max_pending_bytes: DEFAULT_MAX_PENDING_BYTES,
+            slow_client_policy: SlowClientPolicy::default(),
+            scene_mirror_path: Some(PathBuf::from(DEFAULT_SCENE_MIRROR_PATH)),
+            scene_presets_path: None,
+            record_path: None,
+            startup_mode: StartupMode::default(),
             id_assignment: IdAssignmentConfig::default(),
         }
     }
@@ -158,6 +234,11 @@ impl PluginConfig {
             return Err("max_connections should not exceed 1000".to_string());
         }
 
+        // Validate outbound queue limit
+        if self.max_pending_bytes == 0 {
+            return Err("max_pending_bytes must be greater than 0".to_string());
+        }
+
         // Validate ID assignment configuration
         self.id_assignment
             .validate()
@@ -171,14 +252,24 @@ impl PluginConfig {
 struct PluginState {
     // Kept alive to maintain shared ownership with RpcHandler and EventContext
     #[allow(dead_code)]
-    state_manager: Arc<Mutex<StateManager>>,
+    state_manager: Arc<StateManager>,
     rpc_handler: Arc<RpcHandler>,
     // ID assignment manager for automatic surface ID assignment
     #[allow(dead_code)]
     id_assignment_manager: Arc<IdAssignmentManager>,
-    // Kept alive to maintain event listener registrations with Weston
+    // Kept alive to maintain event listener registrations with Weston; set
+    // by the idle callback with a deferred startup
     #[allow(dead_code)]
     event_listeners: Option<EventListeners>,
+    // Pending deferred startup, cancelled if the compositor goes away first
+    #[allow(dead_code)]
+    deferred_startup: Option<IdleCallback>,
+    // Kept alive to deliver output frames to the commit scheduler
+    #[allow(dead_code)]
+    frame_listeners: Option<FrameListeners>,
+    // Kept alive to run queued requests on the compositor thread
+    #[allow(dead_code)]
+    loop_wakeup: Option<LoopWakeup>,
     // Plugin configuration for cleanup reference
     #[allow(dead_code)]
     config: PluginConfig,
@@ -361,6 +452,7 @@ unsafe fn plugin_init_impl(
     argv: *const *const c_char,
 ) -> Result<(PluginState, *mut ffi::weston_compositor), String> {
     jinfo!("Weston IVI Controller plugin initializing...");
+    let mut boot = BootTimer::start();
 
     // Parse command-line arguments and environment variables
     let config = parse_plugin_config(argc, argv);
@@ -375,7 +467,10 @@ unsafe fn plugin_init_impl(
     {
         jinfo!("Using socket path: {:?}", config.socket_path);
         jinfo!("Max connections: {}", config.max_connections);
+        jinfo!("Max pending bytes per client: {}", config.max_pending_bytes);
+        jinfo!("Slow client policy: {:?}", config.slow_client_policy);
     }
+    jinfo!("Startup mode: {:?}", config.startup_mode);
     jinfo!(
         "ID assignment range: {:#x} - {:#x}",
         config.id_assignment.start_id,
@@ -397,6 +492,7 @@ unsafe fn plugin_init_impl(
         "ID assignment operation timeout: {}ms",
         config.id_assignment.assignment_timeout_ms
     );
+    boot.phase("config");
 
     // Retrieve the IVI layout API from Weston compositor
     let ivi_api = Arc::new(
@@ -406,13 +502,16 @@ unsafe fn plugin_init_impl(
 
     jinfo!("IVI layout API retrieved successfully");
 
-    // Create state manager
-    let mut state_manager = StateManager::new(ivi_api.clone());
-
-    // Synchronize initial state with IVI
-    state_manager.sync_with_ivi();
+    // Create state manager; the scene is loaded with the IVI listeners below
+    let state_manager = Arc::new(StateManager::new(ivi_api.clone()));
 
-    let state_manager = Arc::new(Mutex::new(state_manager));
+    // Readers can do without the mirror, so failing to create it is not fatal
+    if let Some(path) = &config.scene_mirror_path {
+        match SceneMirror::create(path) {
+            Ok(mirror) => state_manager.attach_scene_mirror(mirror),
+            Err(e) => jwarn!("Failed to create scene mirror {}: {}", path.display(), e),
+        }
+    }
 
     jinfo!("State manager created");
 
@@ -421,6 +520,21 @@ unsafe fn plugin_init_impl(
 
     jinfo!("RPC handler created");
 
+    // Clients can still define scenes, so a bad presets file is not fatal
+    if let Some(path) = &config.scene_presets_path {
+        match rpc_handler.scene_presets().load_file(path) {
+            Ok(count) => jinfo!("Loaded {} scene presets from {}", count, path.display()),
+            Err(e) => jwarn!("Failed to load scene presets {}: {}", path.display(), e),
+        }
+    }
+
+    // Started before the transport, so the recording holds whole sessions
+    if let Some(path) = &config.record_path {
+        if let Err(e) = rpc_handler.start_recording(path) {
+            jwarn!("Failed to record RPC traffic to {}: {}", path.display(), e);
+        }
+    }
+
     #[cfg(feature = "enable-ipcon")]
     {
         let transport = Box::new(IpconTransport::new(None).map_err(|e| {
@@ -442,6 +556,8 @@ unsafe fn plugin_init_impl(
         let transport_config = UnixSocketConfig {
             socket_path: config.socket_path.clone(),
             max_connections: config.max_connections,
+            max_pending_bytes: config.max_pending_bytes,
+            slow_client_policy: config.slow_client_policy,
         };
 
         let transport = Box::new(UnixSocketTransport::new(transport_config));
@@ -452,6 +568,7 @@ unsafe fn plugin_init_impl(
 
         jinfo!("UnixDomainSocket Transport registered");
     }
+    boot.phase("rpc handler");
 
     // Create ID assignment manager with parsed configuration
     let id_assignment_manager = Arc::new(
@@ -461,70 +578,60 @@ unsafe fn plugin_init_impl(
 
     jinfo!("ID assignment manager created");
 
-    // Register IVI event listeners
-    let event_context = Arc::new(EventContext::new(
+    let mut event_context = EventContext::new(
         Arc::clone(&state_manager),
         Arc::clone(&ivi_api),
         Arc::clone(&id_assignment_manager),
-    ));
-
-    let event_listeners = Arc::clone(&event_context)
-        .register_listeners()
-        .map_err(|e| {
-            jerror!("Failed to register event listeners: {}", e);
-            format!("Failed to register event listeners: {}", e)
-        })?;
-
-    jinfo!("Event listeners registered");
+    );
 
-    // Register per-surface property listeners for existing surfaces
-    unsafe {
-        let existing_ids: Vec<u32> = {
-            state_manager
-                .lock()
-                .unwrap()
-                .get_all_surfaces()
-                .iter()
-                .map(|s| s.id)
-                .collect()
-        };
-        for id in existing_ids {
-            let _ = event_context.register_surface_property_listener_by_id(id);
-        }
+    // With a deferred startup, surfaces get property listeners once they
+    // have subscribers rather than all at once; until then their state
+    // follows the configure events and the RPC handler's commits
+    if config.startup_mode == StartupMode::Deferred {
+        let subscriptions = rpc_handler.subscription_manager();
+        event_context = event_context.with_surface_listener_filter(Arc::new(move |id| {
+            subscriptions.lock().unwrap().watches_surface_properties(id)
+        }));
     }
-
-    // Register per-layer property listeners for existing layers
-    unsafe {
-        let existing_layer_ids: Vec<u32> = {
-            let layers = ivi_api.get_layers()?;
-            layers.iter().map(|l| l.id()).collect()
-        };
-        for id in existing_layer_ids {
-            let _ = event_context.register_layer_property_listener_by_id(id);
-        }
+    let event_context = Arc::new(event_context);
+
+    if config.startup_mode == StartupMode::Deferred {
+        let event_context = Arc::clone(&event_context);
+        rpc_handler.on_subscribe(Arc::new(move || {
+            let added = unsafe { event_context.refresh_surface_property_listeners() };
+            if added > 0 {
+                jdebug!("Attached property listeners to {} surfaces", added);
+            }
+        }));
     }
 
     // Bridge notifications -> subscriptions, and register callbacks
     {
         let bridge = Arc::new(NotificationBridge::new(rpc_handler.subscription_manager()));
-
-        let notification_manager_arc = {
-            // Get Arc<Mutex<NotificationManager>> from state manager
-            let sm = state_manager.lock().unwrap();
-            sm.notification_manager()
+        // Convert on a worker so the compositor thread only copies notifications
+        let bridge_queue = match Arc::clone(&bridge).spawn_worker() {
+            Ok(queue) => Some(queue),
+            Err(e) => {
+                jwarn!(
+                    "Failed to start notification bridge worker, converting inline: {}",
+                    e
+                );
+                None
+            }
         };
 
-        let mut nm = notification_manager_arc.lock().unwrap();
+        let nm = state_manager.notification_manager();
 
         // Helper to register a callback for a notification type
-        let mut register = |nt: NotificationType| {
-            let bridge_cloned = Arc::clone(&bridge);
-            nm.register_callback(
-                nt,
-                Arc::new(move |n| {
-                    bridge_cloned.handle_notification(n);
-                }),
-            );
+        let register = |nt: NotificationType| {
+            let callback: NotificationCallback = match bridge_queue.clone() {
+                Some(queue) => Arc::new(move |n| queue.push(n)),
+                None => {
+                    let bridge_cloned = Arc::clone(&bridge);
+                    Arc::new(move |n| bridge_cloned.handle_notification(n))
+                }
+            };
+            nm.register_callback(nt, callback);
         };
 
         // Register for all supported notification types
@@ -541,18 +648,112 @@ unsafe fn plugin_init_impl(
         register(NotificationType::LayerDestroyed);
         register(NotificationType::LayerVisibilityChanged);
         register(NotificationType::LayerOpacityChanged);
+        // Animation notifications
+        register(NotificationType::AnimationCompleted);
     }
 
-    // Start the transport
-    rpc_handler.start_transport().map_err(|e| {
-        jerror!("Failed to start transport: {:?}", e);
-        format!("Failed to start transport: {:?}", e)
-    })?;
+    // Commit "next_frame" requests once per frame of the primary output
+    let frame_listeners = {
+        let handler = Arc::clone(&rpc_handler);
+        match FrameListeners::register(compositor, Arc::new(move || handler.on_output_frame())) {
+            Ok((listeners, outputs)) => {
+                // Raw pointers are not Send; the compositor outlives the plugin state
+                let compositor_addr = compositor as usize;
+                rpc_handler.attach_frame_commits(Arc::new(move || unsafe {
+                    ffi::weston_compositor_schedule_repaint(
+                        compositor_addr as *mut ffi::weston_compositor,
+                    )
+                }));
+                jinfo!("Frame commit scheduler attached to {} outputs", outputs);
+                Some(listeners)
+            }
+            Err(e) => {
+                jwarn!("Frame-aligned commits disabled: {}", e);
+                None
+            }
+        }
+    };
+
+    // Run requests that use the IVI layout API on the compositor thread
+    let loop_wakeup = {
+        let handler = Arc::clone(&rpc_handler);
+        match LoopWakeup::register(compositor, Arc::new(move || handler.run_queued())) {
+            Ok(wakeup) => {
+                rpc_handler.attach_event_loop(wakeup.waker());
+                jinfo!("Requests marshalled onto the compositor event loop");
+                Some(wakeup)
+            }
+            Err(e) => {
+                jwarn!("Requests run on the transport thread: {}", e);
+                None
+            }
+        }
+    };
+    boot.phase("event loop");
+
+    // A deferred startup needs the event loop to hold the requests of early
+    // clients until the scene is loaded
+    let mut deferred_startup = None;
+    let mut event_listeners = None;
+    if config.startup_mode == StartupMode::Deferred && loop_wakeup.is_some() {
+        start_transport(&rpc_handler)?;
+        boot.phase("transport");
+
+        let startup = {
+            let rpc_handler = Arc::clone(&rpc_handler);
+            let event_context = Arc::clone(&event_context);
+            let ivi_api = Arc::clone(&ivi_api);
+            Box::new(move || {
+                let listeners = match load_scene(&event_context, &ivi_api) {
+                    Ok(listeners) => listeners,
+                    Err(e) => {
+                        // Clients must not be served an empty scene: close
+                        // their connections and stop listening
+                        jerror!("Deferred startup failed, stopping the transport: {}", e);
+                        if let Err(e) = rpc_handler.stop_transport() {
+                            jerror!("Failed to stop transport: {:?}", e);
+                        }
+                        return;
+                    }
+                };
+                boot.phase("scene and listeners");
 
-    // Start background notification delivery to subscribed clients
-    rpc_handler.start_notification_delivery();
+                match PLUGIN_STATE.lock().unwrap().as_mut() {
+                    Some(state) => state.event_listeners = Some(listeners),
+                    None => jwarn!("Plugin state is gone, dropping event listeners"),
+                }
+
+                start_read_workers(&rpc_handler);
+                boot.phase("read workers");
+                boot.finish("Deferred startup finished");
+            })
+        };
+
+        match IdleCallback::register(compositor, startup) {
+            Ok(idle) => {
+                jinfo!("Scene loading deferred until the compositor is idle");
+                deferred_startup = Some(idle);
+            }
+            Err(e) => {
+                jwarn!("Failed to defer startup, loading the scene now: {}", e);
+                event_listeners = Some(load_scene(&event_context, &ivi_api)?);
+                start_read_workers(&rpc_handler);
+            }
+        }
+    } else {
+        if config.startup_mode == StartupMode::Deferred {
+            jwarn!("Deferred startup needs the compositor event loop, starting immediately");
+        }
+
+        event_listeners = Some(load_scene(&event_context, &ivi_api)?);
+        boot.phase("scene and listeners");
+
+        start_read_workers(&rpc_handler);
+        start_transport(&rpc_handler)?;
+        boot.phase("transport");
+        boot.finish("Startup finished");
+    }
 
-    jinfo!("Transport started");
     jinfo!("Weston IVI Controller plugin initialized successfully");
 
     Ok((
@@ -560,13 +761,89 @@ unsafe fn plugin_init_impl(
             state_manager,
             rpc_handler,
             id_assignment_manager,
-            event_listeners: Some(event_listeners),
+            event_listeners,
+            deferred_startup,
+            frame_listeners,
+            loop_wakeup,
             config,
         },
         compositor, // Return compositor pointer for destroy listener registration
     ))
 }
 
+/// Load the current scene and register the IVI listeners that keep it up to date
+///
+/// # Safety
+/// Must be called on the compositor thread; registers C callbacks with raw pointers.
+unsafe fn load_scene(
+    event_context: &Arc<EventContext>,
+    ivi_api: &IviLayoutApi,
+) -> Result<EventListeners, String> {
+    // Synchronize initial state with IVI
+    event_context.state_manager().sync_with_ivi();
+
+    let event_listeners = Arc::clone(event_context)
+        .register_listeners()
+        .map_err(|e| {
+            jerror!("Failed to register event listeners: {}", e);
+            format!("Failed to register event listeners: {}", e)
+        })?;
+
+    jinfo!("Event listeners registered");
+
+    // Register per-surface property listeners for existing surfaces
+    let existing_ids: Vec<u32> = event_context
+        .state_manager()
+        .snapshot()
+        .surfaces
+        .keys()
+        .copied()
+        .collect();
+    let mut watched = 0;
+    for &id in &existing_ids {
+        if let Ok(true) = event_context.attach_surface_property_listener(id) {
+            watched += 1;
+        }
+    }
+    jinfo!(
+        "Property listeners attached to {} of {} surfaces",
+        watched,
+        existing_ids.len()
+    );
+
+    // Register per-layer property listeners for existing layers
+    let existing_layer_ids: Vec<u32> = {
+        let layers = ivi_api.get_layers()?;
+        layers.iter().map(|l| l.id()).collect()
+    };
+    for id in existing_layer_ids {
+        let _ = event_context.register_layer_property_listener_by_id(id);
+    }
+
+    Ok(event_listeners)
+}
+
+/// Answer snapshot reads on worker threads
+fn start_read_workers(rpc_handler: &RpcHandler) {
+    if let Err(e) = rpc_handler.start_read_workers(default_read_workers()) {
+        jwarn!("Snapshot reads run on the transport thread: {}", e);
+    }
+}
+
+/// Start accepting clients and delivering their notifications
+fn start_transport(rpc_handler: &Arc<RpcHandler>) -> Result<(), String> {
+    rpc_handler.start_transport().map_err(|e| {
+        jerror!("Failed to start transport: {:?}", e);
+        format!("Failed to start transport: {:?}", e)
+    })?;
+
+    // Start background notification delivery to subscribed clients
+    rpc_handler.start_notification_delivery();
+
+    jinfo!("Transport started");
+    Ok(())
+}
+
 /// Parse plugin configuration from command-line arguments and environment variables
 ///
 /// This function parses both command-line arguments and environment variables
@@ -623,6 +900,84 @@ unsafe fn parse_plugin_config(argc: c_int, argv: *const *const c_char) -> Plugin
                     config.max_connections = max_conn;
                 }
             }
+            // Outbound queue limit per client
+            else if arg == "--max-pending-bytes" && i + 1 < argc as isize {
+                let value_ptr = *argv.offset(i + 1);
+                if !value_ptr.is_null() {
+                    let value = CStr::from_ptr(value_ptr).to_string_lossy();
+                    if let Ok(max_pending) = value.parse::<usize>() {
+                        config.max_pending_bytes = max_pending;
+                    }
+                }
+            } else if arg.starts_with("--max-pending-bytes=") {
+                let value = arg.strip_prefix("--max-pending-bytes=").unwrap();
+                if let Ok(max_pending) = value.parse::<usize>() {
+                    config.max_pending_bytes = max_pending;
+                }
+            }
+            // Policy for clients over the outbound queue limit
+            else if arg == "--slow-client-policy" && i + 1 < argc as isize {
+                let value_ptr = *argv.offset(i + 1);
+                if !value_ptr.is_null() {
+                    let value = CStr::from_ptr(value_ptr).to_string_lossy();
+                    if let Ok(policy) = value.parse::<SlowClientPolicy>() {
+                        config.slow_client_policy = policy;
+                    }
+                }
+            } else if arg.starts_with("--slow-client-policy=") {
+                let value = arg.strip_prefix("--slow-client-policy=").unwrap();
+                if let Ok(policy) = value.parse::<SlowClientPolicy>() {
+                    config.slow_client_policy = policy;
+                }
+            }
+            // Scene mirror path
+            else if arg == "--scene-mirror" && i + 1 < argc as isize {
+                let value_ptr = *argv.offset(i + 1);
+                if !value_ptr.is_null() {
+                    let value = CStr::from_ptr(value_ptr).to_string_lossy();
+                    config.scene_mirror_path = parse_scene_mirror_path(&value);
+                }
+            } else if arg.starts_with("--scene-mirror=") {
+                let value = arg.strip_prefix("--scene-mirror=").unwrap();
+                config.scene_mirror_path = parse_scene_mirror_path(value);
+            }
+            // Startup mode
+            else if arg == "--startup-mode" && i + 1 < argc as isize {
+                let value_ptr = *argv.offset(i + 1);
+                if !value_ptr.is_null() {
+                    let value = CStr::from_ptr(value_ptr).to_string_lossy();
+                    if let Ok(mode) = value.parse::<StartupMode>() {
+                        config.startup_mode = mode;
+                    }
+                }
+            } else if arg.starts_with("--startup-mode=") {
+                let value = arg.strip_prefix("--startup-mode=").unwrap();
+                if let Ok(mode) = value.parse::<StartupMode>() {
+                    config.startup_mode = mode;
+                }
+            }
+            // Scene presets file
+            else if arg == "--scene-presets" && i + 1 < argc as isize {
+                let value_ptr = *argv.offset(i + 1);
+                if !value_ptr.is_null() {
+                    let value = CStr::from_ptr(value_ptr).to_string_lossy();
+                    config.scene_presets_path = Some(PathBuf::from(value.as_ref()));
+                }
+            } else if arg.starts_with("--scene-presets=") {
+                let value = arg.strip_prefix("--scene-presets=").unwrap();
+                config.scene_presets_path = Some(PathBuf::from(value));
+            }
+            // RPC traffic recording file
+            else if arg == "--record" && i + 1 < argc as isize {
+                let value_ptr = *argv.offset(i + 1);
+                if !value_ptr.is_null() {
+                    let value = CStr::from_ptr(value_ptr).to_string_lossy();
+                    config.record_path = Some(PathBuf::from(value.as_ref()));
+                }
+            } else if arg.starts_with("--record=") {
+                let value = arg.strip_prefix("--record=").unwrap();
+                config.record_path = Some(PathBuf::from(value));
+            }
             // ID assignment start ID
             else if arg == "--id-start" && i + 1 < argc as isize {
                 let value_ptr = *argv.offset(i + 1);
@@ -739,6 +1094,42 @@ fn parse_environment_config(config: &mut PluginConfig) {
         }
     }
 
+    // Outbound queue limit per client
+    if let Ok(max_pending_str) = env::var("WESTON_IVI_MAX_PENDING_BYTES") {
+        if let Ok(max_pending) = max_pending_str.parse::<usize>() {
+            config.max_pending_bytes = max_pending;
+        }
+    }
+
+    // Policy for clients over the outbound queue limit
+    if let Ok(policy_str) = env::var("WESTON_IVI_SLOW_CLIENT_POLICY") {
+        if let Ok(policy) = policy_str.parse::<SlowClientPolicy>() {
+            config.slow_client_policy = policy;
+        }
+    }
+
+    // Scene mirror path
+    if let Ok(path) = env::var("WESTON_IVI_SCENE_MIRROR") {
+        config.scene_mirror_path = parse_scene_mirror_path(&path);
+    }
+
+    // Scene presets file
+    if let Ok(path) = env::var("WESTON_IVI_SCENE_PRESETS") {
+        config.scene_presets_path = Some(PathBuf::from(path));
+    }
+
+    // RPC traffic recording file
+    if let Ok(path) = env::var("WESTON_IVI_RECORD") {
+        config.record_path = Some(PathBuf::from(path));
+    }
+
+    // Startup mode
+    if let Ok(mode_str) = env::var("WESTON_IVI_STARTUP_MODE") {
+        if let Ok(mode) = mode_str.parse::<StartupMode>() {
+            config.startup_mode = mode;
+        }
+    }
+
     // ID assignment start ID
     if let Ok(start_id_str) = env::var("WESTON_IVI_ID_START") {
         if let Ok(start_id) = parse_hex_or_decimal(&start_id_str) {
@@ -782,6 +1173,14 @@ fn parse_environment_config(config: &mut PluginConfig) {
     }
 }
 
+/// Parse the scene mirror setting: a path, or "off" to not publish the scene
+fn parse_scene_mirror_path(value: &str) -> Option<PathBuf> {
+    match value {
+        "off" | "" => None,
+        path => Some(PathBuf::from(path)),
+    }
+}
+
 /// Parse a string as either hexadecimal (with 0x prefix) or decimal
 ///
 /// # Arguments
@@ -894,12 +1293,24 @@ mod tests {
             let max_conn_arg = CString::new("--max-connections=5").unwrap();
             let id_start_arg = CString::new("--id-start=0x20000000").unwrap();
             let id_max_arg = CString::new("--id-max=0x30000000").unwrap();
+            let max_pending_arg = CString::new("--max-pending-bytes=65536").unwrap();
+            let policy_arg = CString::new("--slow-client-policy=drop").unwrap();
+            let mirror_arg = CString::new("--scene-mirror=off").unwrap();
+            let presets_arg = CString::new("--scene-presets=/etc/weston/scenes.json").unwrap();
+            let startup_arg = CString::new("--startup-mode=deferred").unwrap();
+            let record_arg = CString::new("--record=/tmp/session.ivirec").unwrap();
 
             let args = [
                 socket_path_arg.as_ptr(),
                 max_conn_arg.as_ptr(),
                 id_start_arg.as_ptr(),
                 id_max_arg.as_ptr(),
+                max_pending_arg.as_ptr(),
+                policy_arg.as_ptr(),
+                mirror_arg.as_ptr(),
+                presets_arg.as_ptr(),
+                startup_arg.as_ptr(),
+                record_arg.as_ptr(),
             ];
 
             let config = parse_plugin_config(args.len() as i32, args.as_ptr());
@@ -908,6 +1319,18 @@ mod tests {
             assert_eq!(config.max_connections, 5);
             assert_eq!(config.id_assignment.start_id, 0x20000000);
             assert_eq!(config.id_assignment.max_id, 0x30000000);
+            assert_eq!(config.max_pending_bytes, 65536);
+            assert_eq!(config.slow_client_policy, SlowClientPolicy::DropFrames);
+            assert_eq!(config.scene_mirror_path, None);
+            assert_eq!(
+                config.scene_presets_path,
+                Some(PathBuf::from("/etc/weston/scenes.json"))
+            );
+            assert_eq!(config.startup_mode, StartupMode::Deferred);
+            assert_eq!(
+                config.record_path,
+                Some(PathBuf::from("/tmp/session.ivirec"))
+            );
         }
     }
 
@@ -0,0 +1,653 @@
+// Runtime metrics of the RPC and compositor hot paths
+//
+// Everything is recorded with relaxed atomics into fixed-size tables, so
+// recording never allocates or takes a lock. Readers take a snapshot with
+// `get_metrics`; the values of one snapshot are not taken atomically
+// together, which is fine for monitoring.
+
+use crate::rpc::protocol::RpcMethod;
+#[allow(unused)]
+use jlogger_tracing::{jdebug, jerror, jinfo, jwarn};
+use serde_json::{json, Map, Value};
+use std::fmt::Write;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::{Duration, Instant};
+
+/// Upper bounds of the latency histogram buckets, in microseconds
+///
+/// Durations above the last bound land in an overflow bucket.
+pub const LATENCY_BUCKETS_US: [u64; 14] = [
+    5, 10, 25, 50, 100, 250, 500, 1_000, 2_500, 5_000, 10_000, 25_000, 50_000, 100_000,
+];
+
+const BUCKET_COUNT: usize = LATENCY_BUCKETS_US.len() + 1;
+
+/// Fixed-bucket latency histogram
+pub struct Histogram {
+    buckets: [AtomicU64; BUCKET_COUNT],
+    count: AtomicU64,
+    sum_us: AtomicU64,
+    max_us: AtomicU64,
+}
+
+impl Histogram {
+    pub const fn new() -> Self {
+        Self {
+            buckets: [const { AtomicU64::new(0) }; BUCKET_COUNT],
+            count: AtomicU64::new(0),
+            sum_us: AtomicU64::new(0),
+            max_us: AtomicU64::new(0),
+        }
+    }
+
+    /// Record one duration
+    pub fn record(&self, elapsed: Duration) {
+        let us = u64::try_from(elapsed.as_micros()).unwrap_or(u64::MAX);
+        let bucket = LATENCY_BUCKETS_US.partition_point(|&bound| bound < us);
+
+        self.buckets[bucket].fetch_add(1, Ordering::Relaxed);
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.sum_us.fetch_add(us, Ordering::Relaxed);
+        self.max_us.fetch_max(us, Ordering::Relaxed);
+    }
+
+    /// Start timing; the duration is recorded when the timer is dropped
+    pub fn start_timer(&self) -> Timer<'_> {
+        Timer {
+            histogram: self,
+            start: Instant::now(),
+        }
+    }
+
+    pub fn snapshot(&self) -> HistogramSnapshot {
+        HistogramSnapshot {
+            buckets: std::array::from_fn(|i| self.buckets[i].load(Ordering::Relaxed)),
+            count: self.count.load(Ordering::Relaxed),
+            sum_us: self.sum_us.load(Ordering::Relaxed),
+            max_us: self.max_us.load(Ordering::Relaxed),
+        }
+    }
+}
+
+impl Default for Histogram {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Records the time since its creation into a histogram when dropped
+pub struct Timer<'a> {
+    histogram: &'a Histogram,
+    start: Instant,
+}
+
+impl Drop for Timer<'_> {
+    fn drop(&mut self) {
+        self.histogram.record(self.start.elapsed());
+    }
+}
+
+/// Values of a histogram at one point in time
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct HistogramSnapshot {
+    /// Count per bucket (not cumulative), the overflow bucket last
+    pub buckets: [u64; BUCKET_COUNT],
+    pub count: u64,
+    pub sum_us: u64,
+    pub max_us: u64,
+}
+
+impl HistogramSnapshot {
+    /// Upper bound of the bucket holding quantile `q` (0 if nothing was recorded)
+    ///
+    /// For the overflow bucket the largest recorded duration is returned.
+    pub fn quantile_us(&self, q: f64) -> u64 {
+        if self.count == 0 {
+            return 0;
+        }
+
+        let rank = ((self.count as f64 * q).ceil() as u64).clamp(1, self.count);
+        let mut seen = 0;
+        for (i, &count) in self.buckets.iter().enumerate() {
+            seen += count;
+            if seen >= rank {
+                return LATENCY_BUCKETS_US.get(i).copied().unwrap_or(self.max_us);
+            }
+        }
+        self.max_us
+    }
+
+    fn to_json(&self) -> Value {
+        let mut cumulative = 0;
+        let buckets: Vec<Value> = self
+            .buckets
+            .iter()
+            .enumerate()
+            .map(|(i, &count)| {
+                cumulative += count;
+                json!({ "le_us": LATENCY_BUCKETS_US.get(i), "count": cumulative })
+            })
+            .collect();
+
+        json!({
+            "count": self.count,
+            "sum_us": self.sum_us,
+            "max_us": self.max_us,
+            "p50_us": self.quantile_us(0.5),
+            "p90_us": self.quantile_us(0.9),
+            "p99_us": self.quantile_us(0.99),
+            "buckets": buckets,
+        })
+    }
+
+    /// Append the series of a Prometheus histogram with the given labels
+    fn write_prometheus(&self, out: &mut String, name: &str, labels: &str) {
+        let braces = |extra: &str| {
+            let all: Vec<&str> = [labels, extra]
+                .into_iter()
+                .filter(|l| !l.is_empty())
+                .collect();
+            if all.is_empty() {
+                String::new()
+            } else {
+                format!("{{{}}}", all.join(","))
+            }
+        };
+
+        let mut cumulative = 0;
+        for (i, &count) in self.buckets.iter().enumerate() {
+            cumulative += count;
+            let le = match LATENCY_BUCKETS_US.get(i) {
+                Some(&bound) => format!("le=\"{}\"", bound as f64 / 1e6),
+                None => "le=\"+Inf\"".to_string(),
+            };
+            let _ = writeln!(out, "{}_bucket{} {}", name, braces(&le), cumulative);
+        }
+        let _ = writeln!(
+            out,
+            "{}_sum{} {}",
+            name,
+            braces(""),
+            self.sum_us as f64 / 1e6
+        );
+        let _ = writeln!(out, "{}_count{} {}", name, braces(""), self.count);
+    }
+}
+
+/// Compositor callbacks whose run time is measured
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CallbackKind {
+    SurfaceCreated,
+    SurfaceRemoved,
+    SurfaceConfigured,
+    SurfacePropertyChanged,
+    LayerCreated,
+    LayerRemoved,
+    LayerPropertyChanged,
+    /// Per-frame work: animations and frame-aligned commits
+    OutputFrame,
+    /// Requests run on the compositor thread, one pass per wake-up
+    QueuedRequests,
+}
+
+impl CallbackKind {
+    pub const COUNT: usize = 9;
+
+    pub const ALL: [CallbackKind; Self::COUNT] = [
+        CallbackKind::SurfaceCreated,
+        CallbackKind::SurfaceRemoved,
+        CallbackKind::SurfaceConfigured,
+        CallbackKind::SurfacePropertyChanged,
+        CallbackKind::LayerCreated,
+        CallbackKind::LayerRemoved,
+        CallbackKind::LayerPropertyChanged,
+        CallbackKind::OutputFrame,
+        CallbackKind::QueuedRequests,
+    ];
+
+    pub fn name(self) -> &'static str {
+        match self {
+            CallbackKind::SurfaceCreated => "surface_created",
+            CallbackKind::SurfaceRemoved => "surface_removed",
+            CallbackKind::SurfaceConfigured => "surface_configured",
+            CallbackKind::SurfacePropertyChanged => "surface_property_changed",
+            CallbackKind::LayerCreated => "layer_created",
+            CallbackKind::LayerRemoved => "layer_removed",
+            CallbackKind::LayerPropertyChanged => "layer_property_changed",
+            CallbackKind::OutputFrame => "output_frame",
+            CallbackKind::QueuedRequests => "queued_requests",
+        }
+    }
+}
+
+/// Event queue of one subscribed client, reported with the metrics
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct QueueDepth {
+    pub client_id: String,
+    /// Notifications waiting for delivery
+    pub depth: usize,
+    /// Notifications dropped because the queue was full
+    pub dropped: u64,
+}
+
+/// Counters and latency histograms of the controller
+pub struct Metrics {
+    /// Time spent in each RPC method, indexed by `RpcMethod::index`
+    rpc_latency: [Histogram; RpcMethod::COUNT],
+    rpc_errors: [AtomicU64; RpcMethod::COUNT],
+    /// Requests whose method or parameters could not be parsed
+    invalid_requests: AtomicU64,
+    /// Time from receiving a message to handing its response to the transport
+    messages: Histogram,
+    frames_received: AtomicU64,
+    bytes_received: AtomicU64,
+    frames_dropped: AtomicU64,
+    slow_client_disconnects: AtomicU64,
+    notifications_queued: AtomicU64,
+    notifications_dropped: AtomicU64,
+    notifications_coalesced: AtomicU64,
+    callbacks: [Histogram; CallbackKind::COUNT],
+}
+
+static METRICS: Metrics = Metrics::new();
+
+/// Metrics of this controller instance
+pub fn metrics() -> &'static Metrics {
+    &METRICS
+}
+
+impl Metrics {
+    pub const fn new() -> Self {
+        Self {
+            rpc_latency: [const { Histogram::new() }; RpcMethod::COUNT],
+            rpc_errors: [const { AtomicU64::new(0) }; RpcMethod::COUNT],
+            invalid_requests: AtomicU64::new(0),
+            messages: Histogram::new(),
+            frames_received: AtomicU64::new(0),
+            bytes_received: AtomicU64::new(0),
+            frames_dropped: AtomicU64::new(0),
+            slow_client_disconnects: AtomicU64::new(0),
+            notifications_queued: AtomicU64::new(0),
+            notifications_dropped: AtomicU64::new(0),
+            notifications_coalesced: AtomicU64::new(0),
+            callbacks: [const { Histogram::new() }; CallbackKind::COUNT],
+        }
+    }
+
+    /// Record one call of the RPC method with index `method`
+    pub fn record_rpc(&self, method: usize, elapsed: Duration, ok: bool) {
+        self.rpc_latency[method].record(elapsed);
+        if !ok {
+            self.rpc_errors[method].fetch_add(1, Ordering::Relaxed);
+        }
+    }
+
+    pub fn invalid_request(&self) {
+        self.invalid_requests.fetch_add(1, Ordering::Relaxed);
+    }
+
+    /// Time the handling of one incoming message
+    pub fn time_message(&self) -> Timer<'_> {
+        self.messages.start_timer()
+    }
+
+    /// Time one run of a compositor callback
+    pub fn time_callback(&self, kind: CallbackKind) -> Timer<'_> {
+        self.callbacks[kind as usize].start_timer()
+    }
+
+    pub fn frame_received(&self, bytes: usize) {
+        self.frames_received.fetch_add(1, Ordering::Relaxed);
+        self.bytes_received
+            .fetch_add(bytes as u64, Ordering::Relaxed);
+    }
+
+    /// An outbound frame was dropped for a client that is not reading
+    pub fn frame_dropped(&self) {
+        self.frames_dropped.fetch_add(1, Ordering::Relaxed);
+    }
+
+    /// A client was disconnected for not reading
+    pub fn slow_client_disconnected(&self) {
+        self.slow_client_disconnects.fetch_add(1, Ordering::Relaxed);
+    }
+
+    pub fn notification_queued(&self) {
+        self.notifications_queued.fetch_add(1, Ordering::Relaxed);
+    }
+
+    pub fn notification_dropped(&self) {
+        self.notifications_dropped.fetch_add(1, Ordering::Relaxed);
+    }
+
+    pub fn notification_coalesced(&self) {
+        self.notifications_coalesced.fetch_add(1, Ordering::Relaxed);
+    }
+
+    /// Metrics as the `get_metrics` JSON result
+    ///
+    /// Only RPC methods and callbacks that ran at least once are listed.
+    pub fn to_json(&self, queues: &[QueueDepth]) -> Value {
+        let mut rpc = Map::new();
+        for (index, name) in RpcMethod::NAMES.iter().enumerate() {
+            let latency = self.rpc_latency[index].snapshot();
+            if latency.count == 0 {
+                continue;
+            }
+            let mut stats = latency.to_json();
+            stats["errors"] = json!(self.rpc_errors[index].load(Ordering::Relaxed));
+            rpc.insert(name.to_string(), stats);
+        }
+
+        let mut callbacks = Map::new();
+        for kind in CallbackKind::ALL {
+            let latency = self.callbacks[kind as usize].snapshot();
+            if latency.count > 0 {
+                callbacks.insert(kind.name().to_string(), latency.to_json());
+            }
+        }
+
+        let load = |counter: &AtomicU64| counter.load(Ordering::Relaxed);
+        json!({
+            "rpc": rpc,
+            "invalid_requests": load(&self.invalid_requests),
+            "messages": self.messages.snapshot().to_json(),
+            "callbacks": callbacks,
+            "transport": {
+                "frames_received": load(&self.frames_received),
+                "bytes_received": load(&self.bytes_received),
+                "frames_dropped": load(&self.frames_dropped),
+                "slow_client_disconnects": load(&self.slow_client_disconnects),
+            },
+            "notifications": {
+                "queued": load(&self.notifications_queued),
+                "dropped": load(&self.notifications_dropped),
+                "coalesced": load(&self.notifications_coalesced),
+                "queues": queues
+                    .iter()
+                    .map(|q| json!({
+                        "client_id": q.client_id,
+                        "depth": q.depth,
+                        "dropped": q.dropped,
+                    }))
+                    .collect::<Vec<_>>(),
+            },
+        })
+    }
+
+    /// Metrics in the Prometheus text exposition format
+    pub fn to_prometheus(&self, queues: &[QueueDepth]) -> String {
+        let mut out = String::new();
+        let load = |counter: &AtomicU64| counter.load(Ordering::Relaxed);
+        let header = |out: &mut String, name: &str, kind: &str, help: &str| {
+            let _ = writeln!(out, "# HELP {} {}", name, help);
+            let _ = writeln!(out, "# TYPE {} {}", name, kind);
+        };
+
+        header(
+            &mut out,
+            "ivi_rpc_duration_seconds",
+            "histogram",
+            "Time spent handling RPC requests, by method",
+        );
+        for (index, name) in RpcMethod::NAMES.iter().enumerate() {
+            let latency = self.rpc_latency[index].snapshot();
+            if latency.count > 0 {
+                latency.write_prometheus(
+                    &mut out,
+                    "ivi_rpc_duration_seconds",
+                    &format!("method=\"{}\"", name),
+                );
+            }
+        }
+
+        header(
+            &mut out,
+            "ivi_rpc_errors_total",
+            "counter",
+            "RPC requests that returned an error, by method",
+        );
+        for (index, name) in RpcMethod::NAMES.iter().enumerate() {
+            let errors = load(&self.rpc_errors[index]);
+            if errors > 0 {
+                let _ = writeln!(
+                    out,
+                    "ivi_rpc_errors_total{{method=\"{}\"}} {}",
+                    name, errors
+                );
+            }
+        }
+
+        header(
+            &mut out,
+            "ivi_rpc_message_duration_seconds",
+            "histogram",
+            "Time from receiving a message to sending its response",
+        );
+        self.messages
+            .snapshot()
+            .write_prometheus(&mut out, "ivi_rpc_message_duration_seconds", "");
+
+        header(
+            &mut out,
+            "ivi_callback_duration_seconds",
+            "histogram",
+            "Time spent in compositor callbacks, by callback",
+        );
+        for kind in CallbackKind::ALL {
+            let latency = self.callbacks[kind as usize].snapshot();
+            if latency.count > 0 {
+                latency.write_prometheus(
+                    &mut out,
+                    "ivi_callback_duration_seconds",
+                    &format!("callback=\"{}\"", kind.name()),
+                );
+            }
+        }
+
+        let counters = [
+            (
+                "ivi_rpc_invalid_requests_total",
+                "Requests that could not be parsed",
+                &self.invalid_requests,
+            ),
+            (
+                "ivi_transport_frames_received_total",
+                "Frames received from clients",
+                &self.frames_received,
+            ),
+            (
+                "ivi_transport_bytes_received_total",
+                "Payload bytes received from clients",
+                &self.bytes_received,
+            ),
+            (
+                "ivi_transport_frames_dropped_total",
+                "Outbound frames dropped for clients that do not read",
+                &self.frames_dropped,
+            ),
+            (
+                "ivi_transport_slow_client_disconnects_total",
+                "Clients disconnected for not reading",
+                &self.slow_client_disconnects,
+            ),
+            (
+                "ivi_notifications_queued_total",
+                "Notifications queued for delivery",
+                &self.notifications_queued,
+            ),
+            (
+                "ivi_notifications_dropped_total",
+                "Notifications dropped because a client queue was full",
+                &self.notifications_dropped,
+            ),
+            (
+                "ivi_notifications_coalesced_total",
+                "Notifications merged into a pending one",
+                &self.notifications_coalesced,
+            ),
+        ];
+        for (name, help, counter) in counters {
+            header(&mut out, name, "counter", help);
+            let _ = writeln!(out, "{} {}", name, load(counter));
+        }
+
+        header(
+            &mut out,
+            "ivi_client_queue_depth",
+            "gauge",
+            "Notifications waiting for delivery, by client",
+        );
+        for queue in queues {
+            let _ = writeln!(
+                out,
+                "ivi_client_queue_depth{{client=\"{}\"}} {}",
+                queue.client_id, queue.depth
+            );
+        }
+
+        out
+    }
+}
+
+impl Default for Metrics {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Durations of the plugin's startup phases, each logged as it ends
+///
+/// Startup runs once, so unlike the metrics above this simply allocates.
+pub struct BootTimer {
+    start: Instant,
+    phase_start: Instant,
+    phases: Vec<(&'static str, Duration)>,
+}
+
+impl BootTimer {
+    pub fn start() -> Self {
+        let now = Instant::now();
+        Self {
+            start: now,
+            phase_start: now,
+            phases: Vec::new(),
+        }
+    }
+
+    /// End the current phase and start the next one
+    pub fn phase(&mut self, name: &'static str) {
+        let now = Instant::now();
+        let elapsed = now - self.phase_start;
+        self.phase_start = now;
+        self.phases.push((name, elapsed));
+        jinfo!("Startup phase '{}' took {} us", name, elapsed.as_micros());
+    }
+
+    /// Phases ended so far, in order
+    pub fn phases(&self) -> &[(&'static str, Duration)] {
+        &self.phases
+    }
+
+    /// Time since the timer was started
+    pub fn elapsed(&self) -> Duration {
+        self.start.elapsed()
+    }
+
+    /// Log the time from start to `milestone`, with the share of each phase
+    pub fn finish(&self, milestone: &str) {
+        let mut summary = String::new();
+        for (index, (name, elapsed)) in self.phases.iter().enumerate() {
+            let separator = if index == 0 { "" } else { ", " };
+            let _ = write!(summary, "{}{} {} us", separator, name, elapsed.as_micros());
+        }
+        jinfo!(
+            "{} {} us after module init ({})",
+            milestone,
+            self.elapsed().as_micros(),
+            summary
+        );
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_boot_timer_phases() {
+        let mut boot = BootTimer::start();
+        boot.phase("config");
+        std::thread::sleep(Duration::from_millis(2));
+        boot.phase("transport");
+
+        let names: Vec<&str> = boot.phases().iter().map(|(name, _)| *name).collect();
+        assert_eq!(names, vec!["config", "transport"]);
+        assert!(boot.phases()[1].1 >= Duration::from_millis(2));
+        let total: Duration = boot.phases().iter().map(|(_, elapsed)| *elapsed).sum();
+        assert!(boot.elapsed() >= total);
+    }
+
+    #[test]
+    fn test_histogram_buckets_and_quantiles() {
+        let histogram = Histogram::new();
+        for us in [3, 5, 7, 40, 40, 40, 900, 2_000, 2_000, 200_000] {
+            histogram.record(Duration::from_micros(us));
+        }
+
+        let snapshot = histogram.snapshot();
+        assert_eq!(snapshot.count, 10);
+        assert_eq!(snapshot.max_us, 200_000);
+        // 3 and 5 are within the first bound, 7 in the second
+        assert_eq!(snapshot.buckets[0], 2);
+        assert_eq!(snapshot.buckets[1], 1);
+        assert_eq!(snapshot.buckets[BUCKET_COUNT - 1], 1);
+
+        assert_eq!(snapshot.quantile_us(0.5), 50);
+        assert_eq!(snapshot.quantile_us(0.9), 2_500);
+        // The overflow bucket reports the largest duration seen
+        assert_eq!(snapshot.quantile_us(1.0), 200_000);
+        assert_eq!(Histogram::new().snapshot().quantile_us(0.5), 0);
+    }
+
+    #[test]
+    fn test_report_formats() {
+        let metrics = Metrics::new();
+        let list_surfaces = RpcMethod::ListSurfaces.index();
+        metrics.record_rpc(list_surfaces, Duration::from_micros(30), true);
+        metrics.record_rpc(list_surfaces, Duration::from_micros(60), false);
+        drop(metrics.time_callback(CallbackKind::OutputFrame));
+        metrics.notification_dropped();
+        let queues = [QueueDepth {
+            client_id: "7".to_string(),
+            depth: 3,
+            dropped: 1,
+        }];
+
+        let report = metrics.to_json(&queues);
+        assert_eq!(report["rpc"]["list_surfaces"]["count"], 2);
+        assert_eq!(report["rpc"]["list_surfaces"]["errors"], 1);
+        assert!(report["rpc"].get("get_surface").is_none());
+        assert_eq!(report["callbacks"]["output_frame"]["count"], 1);
+        assert_eq!(report["notifications"]["dropped"], 1);
+        assert_eq!(report["notifications"]["queues"][0]["depth"], 3);
+        let buckets = report["rpc"]["list_surfaces"]["buckets"]
+            .as_array()
+            .unwrap();
+        assert_eq!(buckets.len(), BUCKET_COUNT);
+        assert_eq!(buckets[BUCKET_COUNT - 1]["le_us"], Value::Null);
+        assert_eq!(buckets[BUCKET_COUNT - 1]["count"], 2);
+
+        let text = metrics.to_prometheus(&queues);
+        assert!(text.contains(
+            "ivi_rpc_duration_seconds_bucket{method=\"list_surfaces\",le=\"0.00005\"} 1\n"
+        ));
+        assert!(text
+            .contains("ivi_rpc_duration_seconds_bucket{method=\"list_surfaces\",le=\"+Inf\"} 2\n"));
+        assert!(text.contains("ivi_rpc_duration_seconds_count{method=\"list_surfaces\"} 2\n"));
+        assert!(text.contains("ivi_rpc_errors_total{method=\"list_surfaces\"} 1\n"));
+        assert!(text.contains("ivi_notifications_dropped_total 1\n"));
+        assert!(text.contains("ivi_client_queue_depth{client=\"7\"} 3\n"));
+        assert!(text.contains("ivi_rpc_message_duration_seconds_count 0\n"));
+    }
+}
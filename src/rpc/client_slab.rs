@@ -0,0 +1,413 @@
+// Dense per-client storage indexed by small integer keys
+
+/// Key of a client entry in a [`ClientSlab`]
+///
+/// The slot is the index into the slab's contiguous storage; the generation
+/// tells apart clients that used the same slot one after the other, so a key
+/// kept past its client's removal never reaches a later client.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct ClientKey {
+    slot: u32,
+    generation: u32,
+}
+
+impl ClientKey {
+    /// Index into the slab's storage
+    pub fn slot(self) -> usize {
+        self.slot as usize
+    }
+
+    /// Pack the key into a single integer, for wire-visible client IDs
+    ///
+    /// The first client of each slot gets the slot number plus one, so IDs
+    /// count up from 1 until slots start being reused.
+    pub fn to_u64(self) -> u64 {
+        (u64::from(self.generation - 1) << 32) | (u64::from(self.slot) + 1)
+    }
+
+    /// Inverse of [`to_u64`](Self::to_u64)
+    ///
+    /// Values not produced by `to_u64` give keys that match no entry.
+    pub fn from_u64(value: u64) -> Self {
+        Self {
+            slot: (value as u32).wrapping_sub(1),
+            generation: ((value >> 32) as u32).wrapping_add(1),
+        }
+    }
+}
+
+impl std::fmt::Display for ClientKey {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(f, "{}", self.to_u64())
+    }
+}
+
+struct Entry<T> {
+    /// Generation of the current or, when vacant, the last occupant
+    generation: u32,
+    value: Option<T>,
+}
+
+/// Per-client state in one contiguous array, reusing the slots of clients
+/// that went away
+///
+/// Lookups by [`ClientKey`] are an index and a generation check, and
+/// iteration is a linear scan, with no hashing. Generations start at 1.
+pub struct ClientSlab<T> {
+    entries: Vec<Entry<T>>,
+    /// Vacant slots, reused most recently freed first
+    free: Vec<u32>,
+    len: usize,
+}
+
+impl<T> ClientSlab<T> {
+    pub fn new() -> Self {
+        Self {
+            entries: Vec::new(),
+            free: Vec::new(),
+            len: 0,
+        }
+    }
+
+    /// Store `value` in a free slot and return its key
+    pub fn insert(&mut self, value: T) -> ClientKey {
+        self.len += 1;
+
+        if let Some(slot) = self.free.pop() {
+            let entry = &mut self.entries[slot as usize];
+            entry.generation = entry.generation.wrapping_add(1).max(1);
+            entry.value = Some(value);
+            return ClientKey {
+                slot,
+                generation: entry.generation,
+            };
+        }
+
+        let slot = self.entries.len() as u32;
+        self.entries.push(Entry {
+            generation: 1,
+            value: Some(value),
+        });
+        ClientKey {
+            slot,
+            generation: 1,
+        }
+    }
+
+    /// Remove the entry of `key`, freeing its slot
+    pub fn remove(&mut self, key: ClientKey) -> Option<T> {
+        let entry = self.entries.get_mut(key.slot())?;
+        if entry.generation != key.generation {
+            return None;
+        }
+
+        let value = entry.value.take()?;
+        self.free.push(key.slot);
+        self.len -= 1;
+        Some(value)
+    }
+
+    pub fn get(&self, key: ClientKey) -> Option<&T> {
+        self.entries
+            .get(key.slot())
+            .filter(|entry| entry.generation == key.generation)
+            .and_then(|entry| entry.value.as_ref())
+    }
+
+    pub fn get_mut(&mut self, key: ClientKey) -> Option<&mut T> {
+        self.entries
+            .get_mut(key.slot())
+            .filter(|entry| entry.generation == key.generation)
+            .and_then(|entry| entry.value.as_mut())
+    }
+
+    /// Key of the client currently in `slot`
+    pub fn key_at(&self, slot: usize) -> Option<ClientKey> {
+        let entry = self.entries.get(slot)?;
+        entry.value.as_ref().map(|_| ClientKey {
+            slot: slot as u32,
+            generation: entry.generation,
+        })
+    }
+
+    pub fn contains(&self, key: ClientKey) -> bool {
+        self.get(key).is_some()
+    }
+
+    /// Number of occupied slots
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    /// Occupied entries in slot order
+    pub fn iter(&self) -> impl Iterator<Item = (ClientKey, &T)> {
+        self.entries.iter().enumerate().filter_map(|(slot, entry)| {
+            let key = ClientKey {
+                slot: slot as u32,
+                generation: entry.generation,
+            };
+            entry.value.as_ref().map(|value| (key, value))
+        })
+    }
+
+    /// Occupied entries in slot order, mutably
+    pub fn iter_mut(&mut self) -> impl Iterator<Item = (ClientKey, &mut T)> {
+        self.entries
+            .iter_mut()
+            .enumerate()
+            .filter_map(|(slot, entry)| {
+                let key = ClientKey {
+                    slot: slot as u32,
+                    generation: entry.generation,
+                };
+                entry.value.as_mut().map(|value| (key, value))
+            })
+    }
+
+    /// Remove every entry; keys handed out before stay invalid
+    pub fn clear(&mut self) {
+        for (slot, entry) in self.entries.iter_mut().enumerate() {
+            if entry.value.take().is_some() {
+                self.free.push(slot as u32);
+            }
+        }
+        self.len = 0;
+    }
+}
+
+impl<T> std::ops::Index<ClientKey> for ClientSlab<T> {
+    type Output = T;
+
+    /// Panics if `key` is not in the slab
+    fn index(&self, key: ClientKey) -> &T {
+        self.get(key).expect("client key not in slab")
+    }
+}
+
+impl<T> std::ops::IndexMut<ClientKey> for ClientSlab<T> {
+    fn index_mut(&mut self, key: ClientKey) -> &mut T {
+        self.get_mut(key).expect("client key not in slab")
+    }
+}
+
+impl<T> Default for ClientSlab<T> {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Per-client values stored under the keys of another slab
+///
+/// Layers above a transport keep their state of a client here, indexed by
+/// the key the transport's slab gave it, so they share one identity for the
+/// client and find its state without hashing. A value left behind by an
+/// earlier client of a slot is never returned for a later one, and is
+/// replaced when the later one is first stored.
+pub struct ClientMap<T> {
+    entries: Vec<Option<(u32, T)>>,
+    len: usize,
+}
+
+impl<T> ClientMap<T> {
+    pub fn new() -> Self {
+        Self {
+            entries: Vec::new(),
+            len: 0,
+        }
+    }
+
+    pub fn get(&self, key: ClientKey) -> Option<&T> {
+        match self.entries.get(key.slot())? {
+            Some((generation, value)) if *generation == key.generation => Some(value),
+            _ => None,
+        }
+    }
+
+    pub fn get_mut(&mut self, key: ClientKey) -> Option<&mut T> {
+        match self.entries.get_mut(key.slot())? {
+            Some((generation, value)) if *generation == key.generation => Some(value),
+            _ => None,
+        }
+    }
+
+    pub fn contains(&self, key: ClientKey) -> bool {
+        self.get(key).is_some()
+    }
+
+    /// Store `value` for `key`, returning the value it replaces
+    ///
+    /// Only a value of the same client is returned; one left behind by an
+    /// earlier client of the slot is dropped.
+    pub fn insert(&mut self, key: ClientKey, value: T) -> Option<T> {
+        let slot = self.slot_mut(key);
+        let previous = slot.replace((key.generation, value));
+        match previous {
+            Some((generation, value)) if generation == key.generation => Some(value),
+            Some(_) => None,
+            None => {
+                self.len += 1;
+                None
+            }
+        }
+    }
+
+    /// Value of `key`, stored first with `f` if the client has none yet
+    pub fn get_or_insert_with(&mut self, key: ClientKey, f: impl FnOnce() -> T) -> &mut T {
+        if !self.contains(key) {
+            self.insert(key, f());
+        }
+        self.get_mut(key).expect("value was just inserted")
+    }
+
+    pub fn remove(&mut self, key: ClientKey) -> Option<T> {
+        let entry = self.entries.get_mut(key.slot())?;
+        if !matches!(entry, Some((generation, _)) if *generation == key.generation) {
+            return None;
+        }
+        self.len -= 1;
+        entry.take().map(|(_, value)| value)
+    }
+
+    /// Number of clients with a value
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    /// Stored values in slot order
+    pub fn iter(&self) -> impl Iterator<Item = (ClientKey, &T)> {
+        self.entries.iter().enumerate().filter_map(|(slot, entry)| {
+            entry.as_ref().map(|(generation, value)| {
+                let key = ClientKey {
+                    slot: slot as u32,
+                    generation: *generation,
+                };
+                (key, value)
+            })
+        })
+    }
+
+    /// Stored values in slot order, mutably
+    pub fn iter_mut(&mut self) -> impl Iterator<Item = (ClientKey, &mut T)> {
+        self.entries
+            .iter_mut()
+            .enumerate()
+            .filter_map(|(slot, entry)| {
+                entry.as_mut().map(|(generation, value)| {
+                    let key = ClientKey {
+                        slot: slot as u32,
+                        generation: *generation,
+                    };
+                    (key, value)
+                })
+            })
+    }
+
+    pub fn clear(&mut self) {
+        self.entries.clear();
+        self.len = 0;
+    }
+
+    fn slot_mut(&mut self, key: ClientKey) -> &mut Option<(u32, T)> {
+        if key.slot() >= self.entries.len() {
+            self.entries.resize_with(key.slot() + 1, || None);
+        }
+        &mut self.entries[key.slot()]
+    }
+}
+
+impl<T> std::ops::Index<ClientKey> for ClientMap<T> {
+    type Output = T;
+
+    /// Panics if `key` has no value
+    fn index(&self, key: ClientKey) -> &T {
+        self.get(key).expect("client key not in map")
+    }
+}
+
+impl<T> std::ops::IndexMut<ClientKey> for ClientMap<T> {
+    fn index_mut(&mut self, key: ClientKey) -> &mut T {
+        self.get_mut(key).expect("client key not in map")
+    }
+}
+
+impl<T> Default for ClientMap<T> {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_slots_are_reused_with_a_new_generation() {
+        let mut slab = ClientSlab::new();
+        let a = slab.insert("a");
+        let b = slab.insert("b");
+        assert_eq!((a.slot(), b.slot()), (0, 1));
+        assert_eq!(slab.len(), 2);
+
+        assert_eq!(slab.remove(a), Some("a"));
+        assert_eq!(slab.remove(a), None);
+
+        // The freed slot goes to the next client, and the old key misses it
+        let c = slab.insert("c");
+        assert_eq!(c.slot(), a.slot());
+        assert_ne!(c, a);
+        assert_eq!(slab.get(a), None);
+        assert_eq!(slab.get(c), Some(&"c"));
+        assert_eq!((a.to_u64(), b.to_u64()), (1, 2));
+        assert_eq!(ClientKey::from_u64(c.to_u64()), c);
+        assert_eq!(slab.key_at(c.slot()), Some(c));
+        assert_eq!(slab.get(ClientKey::from_u64(0)), None);
+
+        let keys: Vec<ClientKey> = slab.iter().map(|(key, _)| key).collect();
+        assert_eq!(keys, vec![c, b]);
+
+        slab.clear();
+        assert!(slab.is_empty());
+        assert!(!slab.contains(b));
+        assert_eq!(slab.insert("d").slot(), 1);
+    }
+
+    #[test]
+    fn test_client_map_follows_the_keys_of_a_slab() {
+        let mut slab = ClientSlab::new();
+        let mut map = ClientMap::new();
+        let a = slab.insert(());
+        let b = slab.insert(());
+
+        assert_eq!(map.insert(b, "b"), None);
+        assert_eq!(map.get(b), Some(&"b"));
+        assert_eq!(map.get(a), None);
+        *map.get_or_insert_with(a, || "a") = "a2";
+        assert_eq!(map.insert(a, "a3"), Some("a2"));
+        assert_eq!(map.len(), 2);
+
+        // A later client of the slot never sees the value of the earlier one
+        slab.remove(a);
+        let c = slab.insert(());
+        assert_eq!(c.slot(), a.slot());
+        assert_eq!(map.get(c), None);
+        assert_eq!(map.remove(c), None);
+        assert_eq!(map.insert(c, "c"), None);
+        assert_eq!(map.get(a), None);
+        assert_eq!(map.len(), 2);
+
+        let keys: Vec<ClientKey> = map.iter().map(|(key, _)| key).collect();
+        assert_eq!(keys, vec![c, b]);
+        assert_eq!(map.remove(b), Some("b"));
+        assert_eq!(map.len(), 1);
+        map.clear();
+        assert!(map.is_empty());
+    }
+}
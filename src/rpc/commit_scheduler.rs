@@ -0,0 +1,181 @@
+// Frame-aligned commits for requests sent with `"commit": "next_frame"`
+
+use super::executor::LaneToken;
+use super::protocol::Encoding;
+use super::transport::ClientId;
+#[allow(unused)]
+use jlogger_tracing::{jdebug, jerror, jinfo, jtrace, jwarn};
+use std::sync::{Arc, Mutex, OnceLock};
+
+/// Asks the compositor for a repaint, so that a frame signal follows
+pub type RepaintRequest = Arc<dyn Fn() + Send + Sync>;
+
+/// Successful result of a request whose commit waits for the next frame
+#[derive(Debug, PartialEq)]
+pub struct DeferredResponse {
+    pub client_id: ClientId,
+    pub id: u64,
+    pub result: serde_json::Value,
+    /// Encoding the request arrived in, used for the response
+    pub encoding: Encoding,
+    /// Lane of a request run from the compositor queue, held until the
+    /// response is sent so that the client's later requests wait for it
+    pub lane: Option<LaneToken>,
+}
+
+#[derive(Debug, Default)]
+struct FrameState {
+    /// Frames of the primary output seen so far, the only output whose frame
+    /// signal reaches the scheduler
+    frame: u64,
+    /// Changes were made for the next frame
+    commit_due: bool,
+    /// Requests answered after the commit of the next frame
+    waiting: Vec<DeferredResponse>,
+}
+
+/// Collects changes made for the next output frame and commits them once.
+///
+/// Requests asking for a frame-aligned commit apply their changes right away
+/// and park their response here. When the next output frame completes, one
+/// `commit_changes()` covers everything parked since the previous frame and
+/// all of those requests are answered. Until frame signals are attached
+/// there is no frame to wait for, so such requests commit immediately.
+#[derive(Default)]
+pub struct CommitScheduler {
+    state: Mutex<FrameState>,
+    /// Set once output frame signals are delivered to this scheduler
+    request_repaint: OnceLock<RepaintRequest>,
+}
+
+impl CommitScheduler {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Record that output frame signals are delivered to this scheduler
+    ///
+    /// `request_repaint` is called when the first change of a frame is
+    /// deferred, since an idle compositor has no frame coming.
+    pub fn attach(&self, request_repaint: RepaintRequest) {
+        if self.request_repaint.set(request_repaint).is_err() {
+            jwarn!("Commit scheduler is already attached");
+        }
+    }
+
+    /// Whether output frame signals are delivered to this scheduler
+    pub fn is_attached(&self) -> bool {
+        self.request_repaint.get().is_some()
+    }
+
+    /// Ask the compositor for a repaint, if frame signals are attached
+    pub fn request_repaint(&self) {
+        if let Some(request_repaint) = self.request_repaint.get() {
+            request_repaint();
+        }
+    }
+
+    /// Number of frames of the primary output seen so far
+    pub fn frame(&self) -> u64 {
+        self.state.lock().unwrap().frame
+    }
+
+    /// Number of requests waiting for the next frame
+    pub fn waiting_count(&self) -> usize {
+        self.state.lock().unwrap().waiting.len()
+    }
+
+    /// Park a response until the commit of the next frame
+    pub fn defer(&self, response: DeferredResponse) {
+        let first = {
+            let mut state = self.state.lock().unwrap();
+            state.waiting.push(response);
+            !std::mem::replace(&mut state.commit_due, true)
+        };
+
+        if first {
+            self.request_repaint();
+        }
+    }
+
+    /// Count a completed frame of the primary output and take the commit due with it
+    ///
+    /// Returns `None` if no changes were made for this frame. Otherwise
+    /// returns the number of the primary output frame that will show the
+    /// committed changes, the one following the frame that just completed,
+    /// and the responses waiting for the commit.
+    pub fn next_frame(&self) -> Option<(u64, Vec<DeferredResponse>)> {
+        let mut state = self.state.lock().unwrap();
+        state.frame += 1;
+        if !std::mem::replace(&mut state.commit_due, false) {
+            return None;
+        }
+        Some((state.frame + 1, std::mem::take(&mut state.waiting)))
+    }
+
+    /// Drop the responses waiting for a disconnected client, returning the
+    /// lanes they held
+    ///
+    /// Its changes are still committed with the next frame.
+    pub fn remove_client(&self, client_id: &ClientId) -> Vec<LaneToken> {
+        let mut state = self.state.lock().unwrap();
+        let (removed, waiting): (Vec<_>, Vec<_>) = std::mem::take(&mut state.waiting)
+            .into_iter()
+            .partition(|response| &response.client_id == client_id);
+        state.waiting = waiting;
+        removed
+            .into_iter()
+            .filter_map(|response| response.lane)
+            .collect()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use serde_json::json;
+
+    fn deferred(client: u64, id: u64) -> DeferredResponse {
+        DeferredResponse {
+            client_id: ClientId::from_u64(client),
+            id,
+            result: json!({ "success": true }),
+            encoding: Encoding::Json,
+            lane: None,
+        }
+    }
+
+    #[test]
+    fn test_one_commit_per_frame() {
+        let scheduler = CommitScheduler::new();
+        assert!(!scheduler.is_attached());
+        let repaints = Arc::new(Mutex::new(0));
+        let repaints_clone = Arc::clone(&repaints);
+        scheduler.attach(Arc::new(move || *repaints_clone.lock().unwrap() += 1));
+        assert!(scheduler.is_attached());
+
+        // Only the first change of a frame asks for a repaint
+        scheduler.defer(deferred(1, 10));
+        scheduler.defer(deferred(2, 20));
+        scheduler.defer(deferred(3, 30));
+        assert_eq!(*repaints.lock().unwrap(), 1);
+        scheduler.remove_client(&ClientId::from_u64(3));
+        assert_eq!(scheduler.waiting_count(), 2);
+
+        let (frame, due) = scheduler.next_frame().unwrap();
+        assert_eq!(frame, 2);
+        assert_eq!(due, vec![deferred(1, 10), deferred(2, 20)]);
+
+        // Frames without changes are counted but have nothing to commit
+        assert!(scheduler.next_frame().is_none());
+        assert_eq!(scheduler.frame(), 2);
+
+        // The commit is still due if every waiting client disconnected
+        scheduler.defer(deferred(1, 11));
+        assert_eq!(*repaints.lock().unwrap(), 2);
+        scheduler.remove_client(&ClientId::from_u64(1));
+        let (frame, due) = scheduler.next_frame().unwrap();
+        assert_eq!(frame, 4);
+        assert!(due.is_empty());
+    }
+}
@@ -0,0 +1,506 @@
+// Where requests run: snapshot reads on worker threads, everything else on
+// the compositor thread
+
+use super::client_slab::{ClientKey, ClientMap};
+use super::protocol::{CommitMode, Encoding, RpcMessage};
+use super::transport::ClientId;
+#[allow(unused)]
+use jlogger_tracing::{jdebug, jerror, jinfo, jtrace, jwarn};
+use std::collections::VecDeque;
+use std::sync::{Arc, Condvar, Mutex, OnceLock};
+use std::thread;
+
+/// Work handed to a pool thread
+pub type Job = Box<dyn FnOnce() + Send>;
+
+/// Asks the compositor thread to run the queued requests
+pub type WakeRequest = Arc<dyn Fn() + Send + Sync>;
+
+/// Upper bound on read workers, however many cores there are
+pub const MAX_READ_WORKERS: usize = 4;
+
+/// Number of read workers for this machine
+pub fn default_read_workers() -> usize {
+    thread::available_parallelism()
+        .map(|n| n.get())
+        .unwrap_or(1)
+        .clamp(1, MAX_READ_WORKERS)
+}
+
+#[derive(Default)]
+struct PoolState {
+    jobs: VecDeque<Job>,
+    stopped: bool,
+}
+
+#[derive(Default)]
+struct PoolQueue {
+    state: Mutex<PoolState>,
+    ready: Condvar,
+}
+
+/// Fixed set of threads that run jobs in the order they were queued
+///
+/// Dropping the pool lets the threads finish the queued jobs and exit; it
+/// does not wait for them, since the last owner may be one of the jobs.
+pub struct WorkerPool {
+    queue: Arc<PoolQueue>,
+    threads: usize,
+}
+
+impl WorkerPool {
+    /// Start `threads` workers
+    pub fn start(threads: usize) -> std::io::Result<Self> {
+        let queue = Arc::new(PoolQueue::default());
+
+        for index in 0..threads.max(1) {
+            let queue = Arc::clone(&queue);
+            thread::Builder::new()
+                .name(format!("ivi-rpc-read-{}", index))
+                .spawn(move || Self::run(&queue))?;
+        }
+
+        Ok(Self {
+            queue,
+            threads: threads.max(1),
+        })
+    }
+
+    fn run(queue: &PoolQueue) {
+        loop {
+            let job = {
+                let mut state = queue.state.lock().unwrap();
+                loop {
+                    if let Some(job) = state.jobs.pop_front() {
+                        break job;
+                    }
+                    if state.stopped {
+                        return;
+                    }
+                    state = queue.ready.wait(state).unwrap();
+                }
+            };
+            job();
+        }
+    }
+
+    /// Number of worker threads
+    pub fn threads(&self) -> usize {
+        self.threads
+    }
+
+    /// Queue a job for the next idle worker
+    pub fn execute(&self, job: Job) {
+        self.queue.state.lock().unwrap().jobs.push_back(job);
+        self.queue.ready.notify_one();
+    }
+}
+
+impl Drop for WorkerPool {
+    fn drop(&mut self) {
+        self.queue.state.lock().unwrap().stopped = true;
+        self.queue.ready.notify_all();
+    }
+}
+
+/// A message waiting for the compositor thread
+pub struct QueuedMessage {
+    pub client_id: ClientId,
+    pub message: RpcMessage,
+    /// Encoding in effect when the message arrived
+    pub encoding: Encoding,
+    /// Set by [`ClientLanes`] on a `"commit": "next_frame"` request, whose
+    /// response may be sent after the compositor thread ran it
+    pub lane: Option<LaneToken>,
+}
+
+/// Messages handed to the compositor thread, taken all at once per wake-up
+#[derive(Default)]
+pub struct CompositorQueue {
+    messages: Mutex<Vec<QueuedMessage>>,
+    /// Set once the compositor's event loop runs the queue
+    wake: OnceLock<WakeRequest>,
+}
+
+impl CompositorQueue {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Record that `wake` makes the compositor thread run the queue
+    pub fn attach(&self, wake: WakeRequest) {
+        if self.wake.set(wake).is_err() {
+            jwarn!("Compositor queue is already attached");
+        }
+    }
+
+    /// Whether the compositor thread runs this queue
+    pub fn is_attached(&self) -> bool {
+        self.wake.get().is_some()
+    }
+
+    /// Queue a message, waking the compositor thread for the first one of a pass
+    ///
+    /// Hands the message back if no event loop is attached.
+    pub fn push(&self, message: QueuedMessage) -> Result<(), QueuedMessage> {
+        let Some(wake) = self.wake.get() else {
+            return Err(message);
+        };
+
+        let first = {
+            let mut messages = self.messages.lock().unwrap();
+            messages.push(message);
+            messages.len() == 1
+        };
+
+        if first {
+            wake();
+        }
+        Ok(())
+    }
+
+    /// Take every queued message, in arrival order
+    pub fn take(&self) -> Vec<QueuedMessage> {
+        std::mem::take(&mut *self.messages.lock().unwrap())
+    }
+}
+
+/// Work of one client that has not been answered yet
+#[derive(Default)]
+struct InFlight {
+    /// Reads running on the worker pool
+    reads: usize,
+    /// Messages for the compositor thread, parked or queued
+    queued: usize,
+    /// Queued next_frame requests, until their response is sent
+    deferred: usize,
+    /// Messages waiting for the reads and next_frame responses before them
+    /// to be answered before they are queued, in arrival order
+    parked: VecDeque<QueuedMessage>,
+}
+
+impl InFlight {
+    fn is_idle(&self) -> bool {
+        self.reads == 0 && self.queued == 0 && self.deferred == 0
+    }
+
+    /// Whether a message for the compositor has to wait before it is queued
+    fn is_blocked(&self) -> bool {
+        self.reads > 0 || self.deferred > 0
+    }
+
+    /// Queue a message, holding the client's lane for a next_frame request
+    fn push(
+        &mut self,
+        queue: &CompositorQueue,
+        key: ClientKey,
+        mut message: QueuedMessage,
+    ) -> Result<(), QueuedMessage> {
+        let RpcMessage::Single(request) = &message.message else {
+            return queue.push(message);
+        };
+        if !matches!(CommitMode::from_request(request), Ok(CommitMode::NextFrame)) {
+            return queue.push(message);
+        }
+
+        message.lane = Some(LaneToken(key));
+        queue.push(message)?;
+        self.deferred += 1;
+        Ok(())
+    }
+
+    /// Queue the parked messages up to the first one that blocks the rest
+    fn unpark(&mut self, queue: &CompositorQueue, key: ClientKey) {
+        // Queued under the lock, so a message arriving meanwhile cannot
+        // get ahead of them
+        while !self.is_blocked() {
+            let Some(message) = self.parked.pop_front() else {
+                break;
+            };
+            if self.push(queue, key, message).is_err() {
+                jwarn!("Dropping a parked message: compositor queue is detached");
+                self.queued -= 1;
+            }
+        }
+    }
+}
+
+/// Holds the lane of a client from the time a next_frame request of it is
+/// queued until its response is sent, see [`ClientLanes::end_deferred`]
+#[derive(Debug, PartialEq)]
+#[must_use]
+pub struct LaneToken(ClientKey);
+
+/// Keeps the requests of each client from overtaking each other across the
+/// worker pool and the compositor thread
+///
+/// A read goes to the pool only while none of the client's messages wait for
+/// the compositor, so it never misses a change the client asked for before.
+/// A message for the compositor is parked while the client has reads on the
+/// pool, and the last of those reads queues it, so a handshake cannot switch
+/// the encoding under a response that is still being built. The transport
+/// thread never waits for the pool. A `"commit": "next_frame"` request, whose
+/// response waits for the next frame after the compositor ran it, holds back
+/// the client's later messages the same way until that response is sent.
+/// Reads of different clients, and the reads of one
+/// client among themselves, still run in parallel. Clients are tracked by
+/// the key their transport interned them under.
+#[derive(Default)]
+pub struct ClientLanes {
+    clients: Mutex<ClientMap<InFlight>>,
+}
+
+impl ClientLanes {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Start a read on the pool, unless the client has messages queued for
+    /// the compositor or next_frame responses not sent yet
+    pub fn try_begin_read(&self, client_id: &ClientId) -> bool {
+        let mut clients = self.clients.lock().unwrap();
+        let in_flight = clients.get_or_insert_with(client_id.key(), InFlight::default);
+        if in_flight.queued > 0 || in_flight.deferred > 0 {
+            return false;
+        }
+        in_flight.reads += 1;
+        true
+    }
+
+    /// A read started with [`try_begin_read`](Self::try_begin_read) was
+    /// answered; the last read of a client hands its parked messages to `queue`
+    pub fn end_read(&self, queue: &CompositorQueue, client_id: &ClientId) {
+        let mut clients = self.clients.lock().unwrap();
+        Self::update(&mut clients, client_id.key(), |in_flight| {
+            in_flight.reads -= 1;
+            in_flight.unpark(queue, client_id.key());
+        });
+    }
+
+    /// Hand a message to `queue` once the client's reads and next_frame
+    /// responses are answered
+    ///
+    /// Without either in flight the message is queued right away; otherwise
+    /// it is parked until [`end_read`](Self::end_read) or
+    /// [`end_deferred`](Self::end_deferred) of the last one. Either way it
+    /// counts as queued until [`end_queued`](Self::end_queued). A next_frame
+    /// request is queued with a [`LaneToken`] that holds back the client's
+    /// later messages until it is given to `end_deferred`. Hands the message
+    /// back if no event loop is attached to `queue`.
+    pub fn begin_queued(
+        &self,
+        queue: &CompositorQueue,
+        message: QueuedMessage,
+    ) -> Result<(), QueuedMessage> {
+        if !queue.is_attached() {
+            return Err(message);
+        }
+
+        let mut clients = self.clients.lock().unwrap();
+        let key = message.client_id.key();
+        let in_flight = clients.get_or_insert_with(key, InFlight::default);
+        if in_flight.is_blocked() {
+            in_flight.parked.push_back(message);
+        } else if let Err(message) = in_flight.push(queue, key, message) {
+            Self::update(&mut clients, key, |_| {});
+            return Err(message);
+        }
+        clients[key].queued += 1;
+        Ok(())
+    }
+
+    /// A message counted by [`begin_queued`](Self::begin_queued) was answered
+    pub fn end_queued(&self, client_id: &ClientId) {
+        let mut clients = self.clients.lock().unwrap();
+        Self::update(&mut clients, client_id.key(), |in_flight| {
+            in_flight.queued -= 1
+        });
+    }
+
+    /// The response of a next_frame request queued by
+    /// [`begin_queued`](Self::begin_queued) was sent or dropped; the last one
+    /// hands the client's parked messages to `queue`
+    pub fn end_deferred(&self, queue: &CompositorQueue, lane: LaneToken) {
+        let mut clients = self.clients.lock().unwrap();
+        Self::update(&mut clients, lane.0, |in_flight| {
+            in_flight.deferred -= 1;
+            in_flight.unpark(queue, lane.0);
+        });
+    }
+
+    /// Apply `change` and forget clients with nothing in flight
+    fn update(
+        clients: &mut ClientMap<InFlight>,
+        key: ClientKey,
+        change: impl FnOnce(&mut InFlight),
+    ) {
+        if let Some(in_flight) = clients.get_mut(key) {
+            change(in_flight);
+            if in_flight.is_idle() {
+                clients.remove(key);
+            }
+        }
+    }
+
+    /// Number of clients with requests in flight
+    pub fn busy_clients(&self) -> usize {
+        self.clients.lock().unwrap().len()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::rpc::protocol::RpcRequest;
+    use serde_json::json;
+    use std::sync::atomic::{AtomicUsize, Ordering};
+    use std::sync::mpsc;
+    use std::time::Duration;
+
+    #[test]
+    fn test_worker_pool_runs_jobs() {
+        let pool = WorkerPool::start(3).unwrap();
+        assert_eq!(pool.threads(), 3);
+
+        let (tx, rx) = mpsc::channel();
+        for i in 0..20 {
+            let tx = tx.clone();
+            pool.execute(Box::new(move || tx.send(i).unwrap()));
+        }
+
+        let mut seen: Vec<i32> = (0..20)
+            .map(|_| rx.recv_timeout(Duration::from_secs(5)).unwrap())
+            .collect();
+        seen.sort();
+        assert_eq!(seen, (0..20).collect::<Vec<_>>());
+    }
+
+    #[test]
+    fn test_compositor_queue_wakes_once_per_pass() {
+        let queue = CompositorQueue::new();
+        let message = |id| QueuedMessage {
+            client_id: ClientId::from_u64(1),
+            message: RpcMessage::Single(RpcRequest::new(id, "commit".to_string(), json!({}))),
+            encoding: Encoding::Json,
+            lane: None,
+        };
+
+        // Without an event loop the caller keeps the message
+        assert!(queue.push(message(1)).is_err());
+
+        let wakes = Arc::new(AtomicUsize::new(0));
+        let wakes_clone = Arc::clone(&wakes);
+        queue.attach(Arc::new(move || {
+            wakes_clone.fetch_add(1, Ordering::SeqCst);
+        }));
+        assert!(queue.is_attached());
+
+        assert!(queue.push(message(2)).is_ok());
+        assert!(queue.push(message(3)).is_ok());
+        assert_eq!(wakes.load(Ordering::SeqCst), 1);
+        assert_eq!(queue.take().len(), 2);
+
+        assert!(queue.push(message(4)).is_ok());
+        assert_eq!(wakes.load(Ordering::SeqCst), 2);
+    }
+
+    #[test]
+    fn test_client_lanes_keep_order() {
+        let lanes = ClientLanes::new();
+        let queue = CompositorQueue::new();
+        let client = ClientId::from_u64(1);
+        let other = ClientId::from_u64(2);
+        let message = |id| QueuedMessage {
+            client_id: client.clone(),
+            message: RpcMessage::Single(RpcRequest::new(id, "commit".to_string(), json!({}))),
+            encoding: Encoding::Json,
+            lane: None,
+        };
+        let ids = |messages: Vec<QueuedMessage>| -> Vec<u64> {
+            messages
+                .into_iter()
+                .map(|queued| match queued.message {
+                    RpcMessage::Single(request) => request.id,
+                    RpcMessage::Batch(_) => unreachable!(),
+                })
+                .collect()
+        };
+
+        // Without an event loop the caller keeps the message
+        assert!(lanes.begin_queued(&queue, message(1)).is_err());
+        assert_eq!(lanes.busy_clients(), 0);
+        queue.attach(Arc::new(|| {}));
+
+        // Reads run in parallel
+        assert!(lanes.try_begin_read(&client));
+        assert!(lanes.try_begin_read(&client));
+
+        // Messages for the compositor are parked behind both reads, without
+        // blocking the caller, and queued in order by the last one
+        assert!(lanes.begin_queued(&queue, message(2)).is_ok());
+        assert!(lanes.begin_queued(&queue, message(3)).is_ok());
+        lanes.end_read(&queue, &client);
+        assert!(queue.take().is_empty());
+        lanes.end_read(&queue, &client);
+        assert_eq!(ids(queue.take()), vec![2, 3]);
+
+        // Reads behind a queued message go to the compositor as well
+        assert!(!lanes.try_begin_read(&client));
+        assert!(lanes.try_begin_read(&other));
+        lanes.end_read(&queue, &other);
+
+        // With no reads in flight a message is queued right away
+        assert!(lanes.begin_queued(&queue, message(4)).is_ok());
+        assert_eq!(ids(queue.take()), vec![4]);
+
+        for _ in 0..3 {
+            lanes.end_queued(&client);
+        }
+        assert_eq!(lanes.busy_clients(), 0);
+        assert!(lanes.try_begin_read(&client));
+        assert_eq!(lanes.busy_clients(), 1);
+        lanes.end_read(&queue, &client);
+        assert_eq!(lanes.busy_clients(), 0);
+    }
+
+    #[test]
+    fn test_next_frame_request_holds_the_lane() {
+        let lanes = ClientLanes::new();
+        let queue = CompositorQueue::new();
+        queue.attach(Arc::new(|| {}));
+        let client = ClientId::from_u64(1);
+        let message = |id, params| QueuedMessage {
+            client_id: client.clone(),
+            message: RpcMessage::Single(RpcRequest::new(id, "commit".to_string(), params)),
+            encoding: Encoding::Json,
+            lane: None,
+        };
+        let next_frame = || json!({ "commit": "next_frame" });
+
+        // A next_frame request is queued with the lane; the request behind it
+        // waits for its response, not just for the compositor to run it
+        assert!(lanes.begin_queued(&queue, message(1, next_frame())).is_ok());
+        assert!(lanes.begin_queued(&queue, message(2, json!({}))).is_ok());
+        let mut queued = queue.take();
+        assert_eq!(queued.len(), 1);
+        let lane = queued.pop().unwrap().lane.unwrap();
+        lanes.end_queued(&client);
+        assert!(!lanes.try_begin_read(&client));
+
+        // Parked messages are queued up to the next next_frame request
+        assert!(lanes.begin_queued(&queue, message(3, next_frame())).is_ok());
+        assert!(lanes.begin_queued(&queue, message(4, json!({}))).is_ok());
+        lanes.end_deferred(&queue, lane);
+        let queued = queue.take();
+        assert_eq!(queued.len(), 2);
+        assert!(queued[0].lane.is_none());
+        let lane = queued.into_iter().nth(1).unwrap().lane.unwrap();
+        lanes.end_queued(&client);
+        lanes.end_queued(&client);
+
+        lanes.end_deferred(&queue, lane);
+        assert_eq!(queue.take().len(), 1);
+        lanes.end_queued(&client);
+        assert_eq!(lanes.busy_clients(), 0);
+    }
+}
@@ -13,7 +13,7 @@
 //! ## Example
 //!
 //! ```rust,ignore
-//! use weston_ivi_controller::rpc::framing::{FrameReader, write_frame};
+//! use weston_ivi_controller::rpc::framing::{FrameReadResult, FrameReader, write_frame};
 //! use std::io::Cursor;
 //!
 //! // Writing a frame
@@ -24,10 +24,18 @@
 //! let mut reader = FrameReader::new();
 //! let mut cursor = Cursor::new(&buffer);
 //! let message = reader.read_frame(&mut cursor).unwrap();
-//! assert_eq!(message, Some(b"hello".to_vec()));
+//! assert_eq!(message, FrameReadResult::Complete(b"hello".to_vec()));
+//!
+//! // Reading without copying: fill from a non-blocking source, then borrow
+//! // each complete payload straight out of the reader's buffer
+//! reader.fill_from(&mut socket, 64 * 1024).unwrap();
+//! while let Some(payload) = reader.next_frame().unwrap() {
+//!     handle(payload);
+//! }
 //! ```
 
 use std::io::{self, Read, Write};
+use std::sync::Arc;
 
 /// Maximum message size (64MB) for DOS protection
 pub const MAX_MESSAGE_SIZE: u32 = 64 * 1024 * 1024;
@@ -43,52 +51,60 @@ pub enum FrameReadResult {
     Eof,
 }
 
-/// State machine for reading length-prefixed messages
-#[derive(Debug)]
-enum ReadState {
-    /// Waiting for 4-byte length header
-    WaitingForHeader {
-        header_buf: [u8; 4],
-        bytes_read: usize,
-    },
-    /// Waiting for payload bytes
-    WaitingForPayload {
-        expected_len: u32,
-        bytes_read: usize,
-        buffer: Vec<u8>,
-    },
+/// Outcome of filling a `FrameReader` from a non-blocking source
+#[derive(Debug, PartialEq, Eq, Clone, Copy)]
+pub enum FillStatus {
+    /// The source has no more data for now (WouldBlock)
+    Drained,
+    /// The read budget was used up; more data may be pending
+    BudgetExhausted,
+    /// End of file / connection closed
+    Eof,
 }
 
-impl Default for ReadState {
-    fn default() -> Self {
-        ReadState::WaitingForHeader {
-            header_buf: [0; 4],
-            bytes_read: 0,
-        }
-    }
-}
+/// Size of a frame header in bytes
+const HEADER_LEN: usize = 4;
+
+/// Minimum free space made available before each read
+const READ_CHUNK: usize = 4096;
+
+/// Buffers larger than this are released once they become empty
+const MAX_IDLE_CAPACITY: usize = 4 * 1024 * 1024;
 
 /// Frame reader for length-prefixed messages.
 ///
+/// Incoming bytes are read straight into a reusable growable buffer. Frames
+/// are parsed in place and returned as slices into that buffer, so a payload
+/// is never copied between the socket and the message handler. Consumed bytes
+/// are reclaimed by moving the start offset; only a trailing partial frame is
+/// ever moved, and only when the buffer runs out of room.
+///
 /// This struct maintains state across multiple read operations,
 /// allowing it to handle partial reads correctly.
-#[derive(Debug)]
+#[derive(Debug, Default)]
 pub struct FrameReader {
-    state: ReadState,
-    buffer: Vec<u8>, // Unprocessed data from previous reads
+    buffer: Vec<u8>,
+    /// Offset of the first unconsumed byte
+    start: usize,
+    /// Offset one past the last valid byte
+    end: usize,
 }
 
 impl FrameReader {
     /// Create a new frame reader
     pub fn new() -> Self {
         Self {
-            state: ReadState::default(),
             buffer: Vec::new(),
+            start: 0,
+            end: 0,
         }
     }
 
     /// Read a complete frame from the given reader.
     ///
+    /// This returns an owned copy of the payload; use `fill_from` together with
+    /// `next_frame` to process frames without copying.
+    ///
     /// Returns:
     /// - `Ok(Complete(message))` if a complete message was read
     /// - `Ok(NeedMore)` if more data is needed (e.g., WouldBlock)
@@ -104,124 +120,155 @@ impl FrameReader {
     pub fn read_frame<R: Read>(&mut self, reader: &mut R) -> io::Result<FrameReadResult> {
         loop {
             // First try to process any buffered data
-            if !self.buffer.is_empty() {
-                if let Some(message) = self.try_extract_message()? {
-                    return Ok(FrameReadResult::Complete(message));
-                }
+            if let Some(message) = self.next_frame()? {
+                return Ok(FrameReadResult::Complete(message.to_vec()));
             }
 
             // Need more data - try to read from reader
-            let mut temp_buf = [0u8; 4096];
-            let n = match reader.read(&mut temp_buf) {
-                Ok(0) => {
-                    // EOF
-                    return Ok(FrameReadResult::Eof);
-                }
-                Ok(n) => n,
+            match self.read_once(reader) {
+                Ok(0) => return Ok(FrameReadResult::Eof),
+                Ok(_) => {}
                 Err(e) if e.kind() == io::ErrorKind::WouldBlock => {
                     return Ok(FrameReadResult::NeedMore); // No data available
                 }
-                Err(e) if e.kind() == io::ErrorKind::Interrupted => {
-                    continue; // Retry
-                }
+                Err(e) if e.kind() == io::ErrorKind::Interrupted => {}
                 Err(e) => return Err(e),
-            };
-
-            // Append new data to buffer
-            self.buffer.extend_from_slice(&temp_buf[..n]);
+            }
+        }
+    }
 
-            // Try to extract a message from buffer
-            if let Some(message) = self.try_extract_message()? {
-                return Ok(FrameReadResult::Complete(message));
+    /// Read from a non-blocking source into the internal buffer until it would
+    /// block, reaches end of file, or `budget` bytes have been read.
+    ///
+    /// Buffered frames are retrieved afterwards with `next_frame`. The budget
+    /// bounds how much is buffered before the caller gets to process it.
+    pub fn fill_from<R: Read>(&mut self, reader: &mut R, budget: usize) -> io::Result<FillStatus> {
+        let mut total = 0;
+
+        while total < budget {
+            match self.read_once(reader) {
+                Ok(0) => return Ok(FillStatus::Eof),
+                Ok(n) => total += n,
+                Err(e) if e.kind() == io::ErrorKind::WouldBlock => return Ok(FillStatus::Drained),
+                Err(e) if e.kind() == io::ErrorKind::Interrupted => {}
+                Err(e) => return Err(e),
             }
-            // If no complete message yet, loop to read more data
         }
+
+        Ok(FillStatus::BudgetExhausted)
     }
 
-    /// Try to extract a complete message from the internal buffer
-    fn try_extract_message(&mut self) -> io::Result<Option<Vec<u8>>> {
-        loop {
-            match &mut self.state {
-                ReadState::WaitingForHeader {
-                    header_buf,
-                    bytes_read,
-                } => {
-                    let needed = 4 - *bytes_read;
-                    let available = self.buffer.len();
-
-                    if available == 0 {
-                        return Ok(None); // Need more data
-                    }
-
-                    let to_copy = needed.min(available);
-
-                    // Copy bytes to header buffer and remove from internal buffer
-                    header_buf[*bytes_read..*bytes_read + to_copy]
-                        .copy_from_slice(&self.buffer[..to_copy]);
-                    self.buffer.drain(..to_copy);
-                    *bytes_read += to_copy;
-
-                    // If we have complete header, parse it
-                    if *bytes_read == 4 {
-                        let msg_len = u32::from_be_bytes(*header_buf);
-
-                        // Validate message size
-                        if msg_len == 0 {
-                            return Err(io::Error::new(
-                                io::ErrorKind::InvalidData,
-                                "Message length is zero",
-                            ));
-                        }
-                        if msg_len > MAX_MESSAGE_SIZE {
-                            return Err(io::Error::new(
-                                io::ErrorKind::InvalidData,
-                                format!(
-                                    "Message too large: {} bytes (max: {})",
-                                    msg_len, MAX_MESSAGE_SIZE
-                                ),
-                            ));
-                        }
-
-                        // Transition to payload state
-                        self.state = ReadState::WaitingForPayload {
-                            expected_len: msg_len,
-                            bytes_read: 0,
-                            buffer: Vec::with_capacity(msg_len as usize),
-                        };
-                    }
-                }
+    /// Extract the next complete frame from the internal buffer.
+    ///
+    /// The returned payload borrows the reader's buffer and is valid until the
+    /// next call on this reader. Returns `Ok(None)` if no complete frame is
+    /// buffered yet.
+    ///
+    /// # Errors
+    ///
+    /// Returns an `InvalidData` error if the frame header announces a zero
+    /// length or a length above MAX_MESSAGE_SIZE.
+    pub fn next_frame(&mut self) -> io::Result<Option<&[u8]>> {
+        let available = self.end - self.start;
+        if available < HEADER_LEN {
+            return Ok(None);
+        }
 
-                ReadState::WaitingForPayload {
-                    expected_len,
-                    bytes_read,
-                    buffer,
-                } => {
-                    let needed = (*expected_len as usize) - *bytes_read;
-                    let available = self.buffer.len();
+        // Parse the header in place
+        let mut header = [0u8; HEADER_LEN];
+        header.copy_from_slice(&self.buffer[self.start..self.start + HEADER_LEN]);
+        let msg_len = u32::from_be_bytes(header);
+
+        // Validate message size
+        if msg_len == 0 {
+            return Err(io::Error::new(
+                io::ErrorKind::InvalidData,
+                "Message length is zero",
+            ));
+        }
+        if msg_len > MAX_MESSAGE_SIZE {
+            return Err(io::Error::new(
+                io::ErrorKind::InvalidData,
+                format!(
+                    "Message too large: {} bytes (max: {})",
+                    msg_len, MAX_MESSAGE_SIZE
+                ),
+            ));
+        }
 
-                    if available == 0 {
-                        return Ok(None); // Need more data
-                    }
+        let frame_len = HEADER_LEN + msg_len as usize;
+        if available < frame_len {
+            // Make room for the whole frame now so the rest is read in place
+            self.reserve_frame(frame_len);
+            return Ok(None); // Need more data
+        }
 
-                    let to_copy = needed.min(available);
+        let payload_start = self.start + HEADER_LEN;
+        self.start += frame_len;
 
-                    // Copy bytes to payload buffer and remove from internal buffer
-                    buffer.extend_from_slice(&self.buffer[..to_copy]);
-                    self.buffer.drain(..to_copy);
-                    *bytes_read += to_copy;
+        Ok(Some(
+            &self.buffer[payload_start..payload_start + msg_len as usize],
+        ))
+    }
 
-                    // If we have complete message, extract it
-                    if *bytes_read == *expected_len as usize {
-                        let message = std::mem::take(buffer);
+    /// Number of bytes buffered but not yet returned as frames
+    pub fn buffered_len(&self) -> usize {
+        self.end - self.start
+    }
 
-                        // Reset to waiting for next header
-                        self.state = ReadState::default();
+    /// Perform a single read into the free tail of the buffer
+    fn read_once<R: Read>(&mut self, reader: &mut R) -> io::Result<usize> {
+        self.make_room();
+        let n = reader.read(&mut self.buffer[self.end..])?;
+        self.end += n;
+        Ok(n)
+    }
 
-                        return Ok(Some(message));
-                    }
-                }
+    /// Ensure at least READ_CHUNK bytes of free space after `end`
+    fn make_room(&mut self) {
+        if self.start == self.end {
+            // Everything consumed: rewind for free and drop oversized buffers
+            self.start = 0;
+            self.end = 0;
+            if self.buffer.len() > MAX_IDLE_CAPACITY {
+                self.buffer = Vec::new();
             }
         }
+
+        if self.buffer.len() - self.end >= READ_CHUNK {
+            return;
+        }
+
+        // Move the trailing partial frame to the front before growing
+        if self.start > 0 {
+            self.buffer.copy_within(self.start..self.end, 0);
+            self.end -= self.start;
+            self.start = 0;
+        }
+
+        if self.buffer.len() - self.end < READ_CHUNK {
+            let new_len = (self.buffer.len() * 2).max(self.end + READ_CHUNK);
+            self.buffer.resize(new_len, 0);
+        }
+    }
+
+    /// Ensure the buffer can hold a frame of `frame_len` bytes starting at
+    /// `start`, plus one read chunk so the next frame does not force a regrow
+    fn reserve_frame(&mut self, frame_len: usize) {
+        let wanted = frame_len + READ_CHUNK;
+        if self.buffer.len() - self.start >= wanted {
+            return;
+        }
+
+        if self.start > 0 {
+            self.buffer.copy_within(self.start..self.end, 0);
+            self.end -= self.start;
+            self.start = 0;
+        }
+
+        if self.buffer.len() < wanted {
+            self.buffer.resize(wanted, 0);
+        }
     }
 
     /// Reset the frame reader state.
@@ -229,14 +276,8 @@ impl FrameReader {
     /// This is useful when the underlying connection is reset or
     /// when you want to discard a partially-read message.
     pub fn reset(&mut self) {
-        self.state = ReadState::default();
-        self.buffer.clear();
-    }
-}
-
-impl Default for FrameReader {
-    fn default() -> Self {
-        Self::new()
+        self.start = 0;
+        self.end = 0;
     }
 }
 
@@ -291,6 +332,49 @@ pub fn write_frame<W: Write>(writer: &mut W, data: &[u8]) -> io::Result<()> {
     Ok(())
 }
 
+/// Encode a payload as a complete length-prefixed frame.
+///
+/// # Errors
+///
+/// Returns error if data length exceeds MAX_MESSAGE_SIZE
+pub fn encode_frame(data: &[u8]) -> io::Result<Vec<u8>> {
+    let mut frame = Vec::with_capacity(4 + data.len());
+    write_frame(&mut frame, data)?;
+    Ok(frame)
+}
+
+/// An immutable, reference-counted frame with the length prefix already applied.
+///
+/// Cloning is cheap, so one encoded message can be queued for and written to
+/// any number of clients without copying the payload again.
+#[derive(Debug, Clone, PartialEq)]
+pub struct SharedFrame {
+    bytes: Arc<[u8]>,
+}
+
+impl SharedFrame {
+    /// Encode a payload into a shared frame
+    ///
+    /// # Errors
+    ///
+    /// Returns error if data length exceeds MAX_MESSAGE_SIZE
+    pub fn new(data: &[u8]) -> io::Result<Self> {
+        Ok(Self {
+            bytes: Arc::from(encode_frame(data)?),
+        })
+    }
+
+    /// The complete frame (header and payload), ready to be written to a stream
+    pub fn as_bytes(&self) -> &[u8] {
+        &self.bytes
+    }
+
+    /// The payload without the length prefix, for message-based transports
+    pub fn payload(&self) -> &[u8] {
+        &self.bytes[4..]
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -424,4 +508,98 @@ mod tests {
         let message = reader.read_frame(&mut cursor).unwrap();
         assert_eq!(message, FrameReadResult::Complete(b"test".to_vec()));
     }
+
+    /// Reader that hands out at most `chunk` bytes per call, then reports WouldBlock
+    struct TrickleReader {
+        data: Vec<u8>,
+        pos: usize,
+        chunk: usize,
+    }
+
+    impl Read for TrickleReader {
+        fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+            if self.pos == self.data.len() {
+                return Err(io::Error::from(io::ErrorKind::WouldBlock));
+            }
+            let n = self.chunk.min(buf.len()).min(self.data.len() - self.pos);
+            buf[..n].copy_from_slice(&self.data[self.pos..self.pos + n]);
+            self.pos += n;
+            Ok(n)
+        }
+    }
+
+    #[test]
+    fn test_fill_and_borrow_pipelined_frames() {
+        let mut data = Vec::new();
+        for i in 0..100u32 {
+            write_frame(&mut data, format!("request {}", i).as_bytes()).unwrap();
+        }
+
+        let mut source = TrickleReader {
+            data,
+            pos: 0,
+            chunk: 7,
+        };
+        let mut reader = FrameReader::new();
+        let mut received = Vec::new();
+
+        loop {
+            let status = reader.fill_from(&mut source, 64).unwrap();
+            while let Some(frame) = reader.next_frame().unwrap() {
+                received.push(String::from_utf8(frame.to_vec()).unwrap());
+            }
+            if status == FillStatus::Drained {
+                break;
+            }
+            assert_eq!(status, FillStatus::BudgetExhausted);
+        }
+
+        assert_eq!(received.len(), 100);
+        assert_eq!(received[0], "request 0");
+        assert_eq!(received[99], "request 99");
+        assert_eq!(reader.buffered_len(), 0);
+    }
+
+    #[test]
+    fn test_large_frame_across_many_reads() {
+        let payload: Vec<u8> = (0..200_000u32).map(|i| i as u8).collect();
+        let mut data = Vec::new();
+        write_frame(&mut data, b"small").unwrap();
+        write_frame(&mut data, &payload).unwrap();
+
+        let mut source = TrickleReader {
+            data,
+            pos: 0,
+            chunk: 1000,
+        };
+        let mut reader = FrameReader::new();
+        assert_eq!(
+            reader.fill_from(&mut source, usize::MAX).unwrap(),
+            FillStatus::Drained
+        );
+
+        assert_eq!(reader.next_frame().unwrap(), Some(&b"small"[..]));
+        assert_eq!(reader.next_frame().unwrap(), Some(payload.as_slice()));
+        assert_eq!(reader.next_frame().unwrap(), None);
+    }
+
+    #[test]
+    fn test_shared_frame() {
+        let frame = SharedFrame::new(b"hello").unwrap();
+        assert_eq!(
+            frame.as_bytes(),
+            &[0, 0, 0, 5, b'h', b'e', b'l', b'l', b'o']
+        );
+        assert_eq!(frame.payload(), b"hello");
+
+        // Clones share the same allocation
+        let clone = frame.clone();
+        assert_eq!(clone.as_bytes().as_ptr(), frame.as_bytes().as_ptr());
+
+        // A shared frame decodes like any other frame
+        let mut reader = FrameReader::new();
+        let mut cursor = Cursor::new(clone.as_bytes());
+        let result = reader.read_frame(&mut cursor).unwrap();
+        assert_eq!(result, FrameReadResult::Complete(b"hello".to_vec()));
+    }
 }
@@ -1,37 +1,158 @@
 // RPC request handler
 
-use super::protocol::{EventType, RpcError, RpcMethod, RpcRequest, RpcResponse};
+use super::client_slab::ClientMap;
+use super::commit_scheduler::{CommitScheduler, DeferredResponse, RepaintRequest};
+use super::executor::{
+    ClientLanes, CompositorQueue, LaneToken, QueuedMessage, WakeRequest, WorkerPool,
+};
+use super::framing::SharedFrame;
+use super::protocol::{
+    AnimationParams, CommitMode, Encoding, EventType, MetricsFormat, RpcError, RpcMessage,
+    RpcMethod, RpcRequest, RpcResponse, SceneDefinition, SubscriptionScope,
+};
+use super::recorder::{RecordKind, RpcRecorder};
 use super::transport::{ClientId, MessageHandler, Transport, TransportError};
-use crate::controller::state::{StateManager, SurfaceState};
-use crate::controller::subscriptions::SubscriptionManager;
+use crate::controller::animation::{
+    AnimatedProperties, AnimationTarget, Animator, Easing, FinishedAnimation,
+};
+use crate::controller::scene_presets::{SceneOp, ScenePreset, ScenePresets};
+use crate::controller::state::{LayerState, SceneSnapshot, StateManager, SurfaceState};
+use crate::controller::subscriptions::{ObjectRef, SubscriptionManager};
 use crate::controller::validation;
+use crate::ffi::bindings::ivi_layer::IviLayer;
+use crate::ffi::bindings::ivi_layout_api::IviLayoutApi;
 use crate::ffi::bindings::ivi_surface::IviSurface;
-use crate::ffi::bindings::weston_output_m::ScreenInfo;
+use crate::ffi::bindings::weston_output_m::{ScreenInfo, WestonOutput};
 use crate::ffi::bindings::Rectangle;
+use crate::metrics::{metrics, CallbackKind};
 #[allow(unused)]
 use jlogger_tracing::{jdebug, jerror, jinfo, jtrace, jwarn, JloggerBuilder, LevelFilter};
 use serde_json::json;
-use std::sync::{Arc, Mutex};
+use std::collections::HashMap;
+use std::path::Path;
+use std::sync::{Arc, Mutex, OnceLock};
 use std::thread;
-use std::time::Duration;
+use std::time::{Duration, Instant};
+
+/// Called on the thread of a subscribe request, after it succeeded
+pub type SubscribeHook = Arc<dyn Fn() + Send + Sync>;
+
+/// Controller state update for a change made through the IVI layout API,
+/// made once the change is committed
+#[derive(Debug, Clone, PartialEq)]
+enum CommitEffect {
+    /// Read back the properties of a surface
+    SurfaceConfigured(u32),
+    /// Read back the properties of a layer
+    LayerConfigured(u32),
+    /// Record the new z-order of a surface and announce the change
+    SurfaceZOrder { id: u32, z_order: i32 },
+    /// Forget a destroyed layer
+    LayerDestroyed(u32),
+    /// Read back every surface and layer of an applied scene
+    Scene(Arc<ScenePreset>),
+}
+
+/// Wire encoding state of one client
+#[derive(Debug, Clone, Copy, Default)]
+struct ClientEncoding {
+    current: Encoding,
+    /// Chosen by a handshake; takes effect once the handshake response is sent
+    next: Option<Encoding>,
+}
+
+/// Encoded result of a list request for one scene generation
+#[derive(Default)]
+struct CachedList {
+    generation: u64,
+    results: [Option<Arc<[u8]>>; Encoding::COUNT],
+}
+
+/// Encoded list_surfaces and list_layers results, rebuilt only after the
+/// scene has changed
+#[derive(Default)]
+struct ListCache {
+    surfaces: Mutex<CachedList>,
+    layers: Mutex<CachedList>,
+}
 
 /// Handles RPC requests and generates responses
 pub struct RpcHandler {
-    state_manager: Arc<Mutex<StateManager>>,
+    state_manager: Arc<StateManager>,
     transport: Arc<Mutex<Option<Box<dyn Transport>>>>,
     subscription_manager: Arc<Mutex<SubscriptionManager>>,
+    /// Wire encoding negotiated by each client (absent = JSON), by transport key
+    encodings: Arc<Mutex<ClientMap<ClientEncoding>>>,
+    list_cache: ListCache,
+    /// Frame-aligned commits of `"commit": "next_frame"` requests
+    commit_scheduler: CommitScheduler,
+    /// Property animations stepped with each output frame
+    animator: Animator,
+    /// Threads answering snapshot reads, once started
+    read_pool: OnceLock<WorkerPool>,
+    /// Requests waiting to run on the compositor thread
+    compositor_queue: CompositorQueue,
+    /// Per-client order across the read pool and the compositor queue
+    lanes: ClientLanes,
+    /// Layouts stored by define_scene or loaded at startup
+    scene_presets: ScenePresets,
+    /// Run after every successful subscribe, once set
+    subscribe_hook: OnceLock<SubscribeHook>,
+    /// Log of received requests and sent notifications, once started
+    recorder: Arc<OnceLock<RpcRecorder>>,
+    /// State updates of changes made but not committed yet, made by the
+    /// next commit that goes through, whichever request makes it
+    uncommitted: Mutex<Vec<CommitEffect>>,
 }
 
 impl RpcHandler {
     /// Create a new RPC handler wrapped in Arc for shared ownership
-    pub fn new(state_manager: Arc<Mutex<StateManager>>) -> Arc<Self> {
+    pub fn new(state_manager: Arc<StateManager>) -> Arc<Self> {
         Arc::new(Self {
             state_manager,
             transport: Arc::new(Mutex::new(None)),
             subscription_manager: Arc::new(Mutex::new(SubscriptionManager::new())),
+            encodings: Arc::new(Mutex::new(ClientMap::new())),
+            list_cache: ListCache::default(),
+            commit_scheduler: CommitScheduler::new(),
+            animator: Animator::new(),
+            read_pool: OnceLock::new(),
+            compositor_queue: CompositorQueue::new(),
+            lanes: ClientLanes::new(),
+            scene_presets: ScenePresets::new(),
+            subscribe_hook: OnceLock::new(),
+            recorder: Arc::new(OnceLock::new()),
+            uncommitted: Mutex::new(Vec::new()),
         })
     }
 
+    /// Wire encoding currently used by a client
+    pub fn client_encoding(&self, client_id: &ClientId) -> Encoding {
+        self.encodings
+            .lock()
+            .unwrap()
+            .get(client_id.key())
+            .map(|state| state.current)
+            .unwrap_or_default()
+    }
+
+    /// Apply the encoding chosen by a handshake whose response has been sent
+    fn apply_encoding_switch(&self, client_id: &ClientId) {
+        let mut encodings = self.encodings.lock().unwrap();
+        let Some(state) = encodings.get_mut(client_id.key()) else {
+            return;
+        };
+
+        if let Some(next) = state.next.take() {
+            state.current = next;
+            jinfo!("Client {} switched to {} encoding", client_id, next.name());
+        }
+
+        if state.current == Encoding::Json {
+            encodings.remove(client_id.key());
+        }
+    }
+
     /// Get a reference to the subscription manager (for testing and integration)
     pub fn subscription_manager(&self) -> Arc<Mutex<SubscriptionManager>> {
         Arc::clone(&self.subscription_manager)
@@ -70,77 +191,91 @@ impl RpcHandler {
     }
 
     /// Stop the registered transport
+    ///
+    /// A running recording is written out, since the plugin may be unloaded
+    /// next.
     pub fn stop_transport(&self) -> Result<(), TransportError> {
-        let mut transport_lock = self.transport.lock().unwrap();
-        if let Some(transport) = transport_lock.as_mut() {
-            transport.stop()
-        } else {
-            Ok(())
+        let result = {
+            let mut transport_lock = self.transport.lock().unwrap();
+            if let Some(transport) = transport_lock.as_mut() {
+                transport.stop()
+            } else {
+                Ok(())
+            }
+        };
+
+        if let Some(recorder) = self.recorder.get() {
+            if let Err(e) = recorder.flush() {
+                jwarn!("Failed to write out RPC recording: {}", e);
+            }
         }
+        result
     }
 
     /// Start the notification delivery loop in a background thread
     /// This should be called after register_transport() and start_transport()
+    ///
+    /// The thread blocks until `SubscriptionManager::queue_notification` signals
+    /// that events are pending, so it uses no CPU while the scene is idle.
     pub fn start_notification_delivery(self: &Arc<Self>) {
-        let subscription_manager = Arc::clone(&self.subscription_manager);
+        let waiter = self.subscription_manager.lock().unwrap().waiter();
         let transport = Arc::clone(&self.transport);
+        let encodings = Arc::clone(&self.encodings);
+        let recorder = Arc::clone(&self.recorder);
 
         jinfo!("Starting notification delivery loop");
 
         thread::spawn(move || {
             loop {
-                // Small sleep to avoid busy-waiting
-                thread::sleep(Duration::from_millis(10));
+                let pending = waiter.wait_and_drain();
 
-                // Get connected clients
+                // Send every client's batch under a single transport lock.
+                // Frames are encoded once per encoding and shared between clients.
                 let transport_lock = transport.lock().unwrap();
                 if let Some(ref t) = *transport_lock {
-                    let clients = t.get_connected_clients();
-                    drop(transport_lock);
-
-                    // Drain and send notifications for each client
-                    for client_id in clients {
-                        let notifications = subscription_manager
-                            .lock()
-                            .unwrap()
-                            .drain_notifications(&client_id);
-
-                        if notifications.is_empty() {
-                            continue;
-                        }
-
+                    for (client_id, notifications) in pending {
                         jtrace!(
                             "Sending {} notifications to client {}",
                             notifications.len(),
                             client_id
                         );
 
-                        for notification in notifications {
-                            // Serialize notification to JSON
-                            match serde_json::to_vec(&notification) {
-                                Ok(json) => {
-                                    // Transport handles length-prefix framing
-                                    // Send to client
-                                    let transport_lock = transport.lock().unwrap();
-                                    if let Some(ref t) = *transport_lock {
-                                        if let Err(e) = t.send(&client_id, &json) {
-                                            jwarn!(
-                                                "Failed to send notification to client {}: {:?}",
-                                                client_id,
-                                                e
-                                            );
-                                        }
-                                    }
-                                }
+                        let encoding = encodings
+                            .lock()
+                            .unwrap()
+                            .get(client_id.key())
+                            .map(|state| state.current)
+                            .unwrap_or_default();
+
+                        let frames: Vec<SharedFrame> = notifications
+                            .iter()
+                            .filter_map(|notification| match notification.frame(encoding) {
+                                Ok(frame) => Some(frame.clone()),
                                 Err(e) => {
-                                    jerror!(
-                                        "Failed to serialize notification for client {}: {:?}",
-                                        client_id,
-                                        e
-                                    );
+                                    jerror!("Failed to serialize notification: {}", e);
+                                    None
                                 }
+                            })
+                            .collect();
+
+                        if let Some(recorder) = recorder.get() {
+                            for frame in &frames {
+                                recorder.record(
+                                    RecordKind::Notification,
+                                    &client_id,
+                                    encoding,
+                                    frame.payload(),
+                                );
                             }
                         }
+
+                        if let Err(e) = t.send_batch(&client_id, &frames) {
+                            jwarn!(
+                                "Failed to send notification to client {}: {:?}",
+                                client_id,
+                                e
+                            );
+                        }
                     }
                 }
             }
@@ -149,6 +284,269 @@ impl RpcHandler {
         jinfo!("Notification delivery loop started");
     }
 
+    /// Answer snapshot reads (`list_*`, `get_*` from the scene state) on
+    /// `threads` worker threads instead of the transport thread
+    ///
+    /// Without workers every request runs where the transport received it.
+    pub fn start_read_workers(&self, threads: usize) -> std::io::Result<()> {
+        let pool = WorkerPool::start(threads)?;
+        let threads = pool.threads();
+        if self.read_pool.set(pool).is_err() {
+            jwarn!("Read workers are already running");
+        } else {
+            jinfo!("Answering snapshot reads on {} worker threads", threads);
+        }
+        Ok(())
+    }
+
+    /// Run every request that needs the IVI layout API on the compositor thread
+    ///
+    /// `wake` must make the compositor's event loop call
+    /// [`run_queued`](Self::run_queued). Before this is called, such requests
+    /// run on the transport thread.
+    pub fn attach_event_loop(&self, wake: WakeRequest) {
+        self.compositor_queue.attach(wake);
+    }
+
+    /// Call `hook` after each subscribe request that succeeded
+    ///
+    /// With an event loop attached the hook runs on the compositor thread.
+    pub fn on_subscribe(&self, hook: SubscribeHook) {
+        if self.subscribe_hook.set(hook).is_err() {
+            jwarn!("Subscribe hook is already set");
+        }
+    }
+
+    /// Record every request received and every notification sent to `path`
+    ///
+    /// The recording can be replayed with `ivi_cli replay`.
+    pub fn start_recording(&self, path: &Path) -> std::io::Result<()> {
+        if self.recorder.get().is_some() {
+            jwarn!("RPC traffic is already being recorded");
+            return Ok(());
+        }
+
+        let recorder = RpcRecorder::create(path)?;
+        if self.recorder.set(recorder).is_err() {
+            jwarn!("RPC traffic is already being recorded");
+        } else {
+            jinfo!("Recording RPC traffic to {}", path.display());
+        }
+        Ok(())
+    }
+
+    /// Run the requests queued for the compositor thread
+    ///
+    /// Called from the compositor's event loop. Consecutive requests that
+    /// commit share a single `commit_changes()` at the end of the run, like
+    /// the requests of a batch, so everything queued since the last wake-up
+    /// takes one pass through the IVI layout API.
+    pub fn run_queued(&self) {
+        let queued = self.compositor_queue.take();
+        if queued.is_empty() {
+            return;
+        }
+
+        let _timer = metrics().time_callback(CallbackKind::QueuedRequests);
+        jtrace!("Running {} queued requests", queued.len());
+        let mut uncommitted = Vec::new();
+
+        for QueuedMessage {
+            client_id,
+            message,
+            encoding,
+            mut lane,
+        } in queued
+        {
+            let request = match message {
+                RpcMessage::Single(request)
+                    if matches!(
+                        CommitMode::from_request(&request),
+                        Ok(CommitMode::Immediate)
+                    ) =>
+                {
+                    request
+                }
+                message => {
+                    self.commit_queued(&mut uncommitted);
+                    // A deferred next_frame response takes the lane with it
+                    if let Some(data) = self.respond(&client_id, message, encoding, &mut lane) {
+                        self.send_response(&client_id, &data);
+                    }
+                    self.lanes.end_queued(&client_id);
+                    self.end_deferred(lane);
+                    continue;
+                }
+            };
+
+            let mut method = match RpcMethod::from_request(&request) {
+                Ok(method) => method,
+                Err(e) => {
+                    jwarn!("Invalid RPC method: {}, error: {}", request.method, e);
+                    metrics().invalid_request();
+                    self.send_encoded(&client_id, RpcResponse::error(request.id, e), encoding);
+                    self.lanes.end_queued(&client_id);
+                    continue;
+                }
+            };
+
+            // Requests that do not commit may depend on the commits before
+            // them (a handshake, for one, changes the encoding of later
+            // responses), so those are made and answered first
+            let wants_commit = method.defer_commit();
+            if !wants_commit {
+                self.commit_queued(&mut uncommitted);
+            }
+
+            let result = match method {
+                RpcMethod::Commit => Ok(json!({ "success": true })),
+                method => self.dispatch(&client_id, method),
+            };
+
+            match result {
+                Ok(value) if wants_commit => uncommitted.push(DeferredResponse {
+                    client_id,
+                    id: request.id,
+                    result: value,
+                    encoding,
+                    lane: None,
+                }),
+                result => {
+                    let response = match result {
+                        Ok(value) => RpcResponse::success(request.id, value),
+                        Err(error) => {
+                            jerror!("RPC request failed: id={}, error: {}", request.id, error);
+                            RpcResponse::error(request.id, error)
+                        }
+                    };
+                    self.send_encoded(&client_id, response, encoding);
+                    self.lanes.end_queued(&client_id);
+                }
+            }
+        }
+
+        self.commit_queued(&mut uncommitted);
+    }
+
+    /// Commit the changes of queued requests and answer them
+    fn commit_queued(&self, uncommitted: &mut Vec<DeferredResponse>) {
+        if uncommitted.is_empty() {
+            return;
+        }
+
+        let commit_result = self.handle_commit();
+        jdebug!("Committed changes of {} queued requests", uncommitted.len());
+
+        for deferred in uncommitted.drain(..) {
+            let response = match &commit_result {
+                Ok(_) => RpcResponse::success(deferred.id, mark_committed(deferred.result)),
+                Err(error) => RpcResponse::error(deferred.id, error.clone()),
+            };
+            self.send_encoded(&deferred.client_id, response, deferred.encoding);
+            self.lanes.end_queued(&deferred.client_id);
+        }
+    }
+
+    /// Answer a decoded message, returning the encoded response to send, if any
+    ///
+    /// A next_frame request whose response waits for the next frame takes
+    /// `lane` with it, to be released once that response is sent.
+    fn respond(
+        &self,
+        client_id: &ClientId,
+        message: RpcMessage,
+        encoding: Encoding,
+        lane: &mut Option<LaneToken>,
+    ) -> Option<Vec<u8>> {
+        let serialized = match message {
+            RpcMessage::Single(request) => match CommitMode::from_request(&request) {
+                Ok(CommitMode::Immediate) => match self.cached_list_response(&request, encoding) {
+                    Some(response) => response,
+                    None => self.handle_request(client_id, request).encode(encoding),
+                },
+                Ok(CommitMode::NextFrame) => {
+                    match self.next_frame_request(client_id, request, encoding, lane) {
+                        Some(response) => response.encode(encoding),
+                        // Answered after the commit of the next frame
+                        None => return None,
+                    }
+                }
+                Err(e) => RpcResponse::error(request.id, e).encode(encoding),
+            },
+            RpcMessage::Batch(requests) if requests.is_empty() => RpcResponse::error(
+                0,
+                RpcError::invalid_request("Empty batch request".to_string()),
+            )
+            .encode(encoding),
+            RpcMessage::Batch(requests) => {
+                let responses = self.handle_batch(client_id, requests);
+                RpcResponse::encode_batch(&responses, encoding)
+            }
+        };
+
+        match serialized {
+            Ok(data) => Some(data),
+            Err(e) => {
+                jerror!(
+                    "Failed to serialize RPC response for client {}: {:?}",
+                    client_id,
+                    e
+                );
+                None
+            }
+        }
+    }
+
+    fn respond_and_send(&self, client_id: &ClientId, message: RpcMessage, encoding: Encoding) {
+        if let Some(data) = self.respond(client_id, message, encoding, &mut None) {
+            self.send_response(client_id, &data);
+        }
+    }
+
+    fn send_encoded(&self, client_id: &ClientId, response: RpcResponse, encoding: Encoding) {
+        match response.encode(encoding) {
+            Ok(data) => self.send_response(client_id, &data),
+            Err(e) => jerror!(
+                "Failed to serialize RPC response for client {}: {:?}",
+                client_id,
+                e
+            ),
+        }
+    }
+
+    /// Send an encoded response and apply an encoding switch it completes
+    fn send_response(&self, client_id: &ClientId, response_data: &[u8]) {
+        jdebug!(
+            "Sending response to client {}, {} bytes",
+            client_id,
+            response_data.len()
+        );
+        let transport_lock = self.transport.lock().unwrap();
+        if let Some(transport) = transport_lock.as_ref() {
+            match transport.send(client_id, response_data) {
+                Ok(_) => {
+                    jdebug!("Successfully sent response to client {}", client_id);
+                }
+                Err(e) => {
+                    jerror!(
+                        "Failed to send RPC response to client {}: {:?}",
+                        client_id,
+                        e
+                    );
+                }
+            }
+
+            // Still under the transport lock, so no notification in the new
+            // encoding can overtake the handshake response
+            self.apply_encoding_switch(client_id);
+        } else {
+            jwarn!(
+                "No transport available to send response to client {}",
+                client_id
+            );
+        }
+    }
+
     /// Handle an RPC request
     pub fn handle_request(&self, client_id: &ClientId, request: RpcRequest) -> RpcResponse {
         jdebug!(
@@ -163,12 +561,478 @@ impl RpcHandler {
             Ok(m) => m,
             Err(e) => {
                 jwarn!("Invalid RPC method: {}, error: {}", request.method, e);
+                metrics().invalid_request();
                 return RpcResponse::error(request.id, e);
             }
         };
 
         // Route to the appropriate handler
+        let result = self.dispatch(client_id, method);
+
+        // Generate response
+        match result {
+            Ok(value) => {
+                jdebug!("RPC request successful: id={}", request.id);
+                RpcResponse::success(request.id, value)
+            }
+            Err(error) => {
+                jerror!("RPC request failed: id={}, error: {}", request.id, error);
+                RpcResponse::error(request.id, error)
+            }
+        }
+    }
+
+    /// Handle a request sent with `"commit": "next_frame"`
+    ///
+    /// The changes are applied right away, but instead of committing, the
+    /// request waits for the next output frame: its response is sent by
+    /// [`on_output_frame`](Self::on_output_frame) after the single commit that
+    /// covers every change made for that frame. Returns the response to send
+    /// now if there is nothing to wait for: the request failed, it does not
+    /// commit, or no output frame signals are attached.
+    pub fn handle_next_frame_request(
+        &self,
+        client_id: &ClientId,
+        request: RpcRequest,
+        encoding: Encoding,
+    ) -> Option<RpcResponse> {
+        self.next_frame_request(client_id, request, encoding, &mut None)
+    }
+
+    /// [`handle_next_frame_request`](Self::handle_next_frame_request), taking
+    /// the client's `lane` along with a response that waits
+    fn next_frame_request(
+        &self,
+        client_id: &ClientId,
+        request: RpcRequest,
+        encoding: Encoding,
+        lane: &mut Option<LaneToken>,
+    ) -> Option<RpcResponse> {
+        if !self.commit_scheduler.is_attached() {
+            return Some(self.handle_request(client_id, request));
+        }
+
+        let mut method = match RpcMethod::from_request(&request) {
+            Ok(method) => method,
+            Err(e) => {
+                jwarn!("Invalid RPC method: {}, error: {}", request.method, e);
+                metrics().invalid_request();
+                return Some(RpcResponse::error(request.id, e));
+            }
+        };
+
+        let wants_commit = method.defer_commit();
         let result = match method {
+            RpcMethod::Commit => Ok(json!({ "success": true })),
+            method => self.dispatch(client_id, method),
+        };
+
+        match result {
+            Ok(result) if wants_commit => {
+                self.commit_scheduler.defer(DeferredResponse {
+                    client_id: client_id.clone(),
+                    id: request.id,
+                    result,
+                    encoding,
+                    lane: lane.take(),
+                });
+                jdebug!("Request {} waits for the next frame commit", request.id);
+                None
+            }
+            Ok(value) => Some(RpcResponse::success(request.id, value)),
+            Err(error) => {
+                jerror!("RPC request failed: id={}, error: {}", request.id, error);
+                Some(RpcResponse::error(request.id, error))
+            }
+        }
+    }
+
+    /// Start aligning `"commit": "next_frame"` requests with output frames
+    ///
+    /// Called once frame listeners deliver [`on_output_frame`](Self::on_output_frame);
+    /// before that, such requests commit immediately. `request_repaint` must
+    /// make the compositor repaint, so that an idle output produces a frame.
+    pub fn attach_frame_commits(&self, request_repaint: RepaintRequest) {
+        self.commit_scheduler.attach(request_repaint);
+    }
+
+    /// Step the running animations, commit them together with the changes
+    /// made for the frame that just completed, and answer the requests that
+    /// waited for it
+    ///
+    /// Called from the frame signal of the primary output, on the compositor
+    /// thread, so animations step and changes commit once per refresh.
+    pub fn on_output_frame(&self) {
+        let _timer = metrics().time_callback(CallbackKind::OutputFrame);
+        let (steps, mut finished) = self.animator.step(Instant::now());
+        let mut animated = Vec::with_capacity(steps.len());
+        for step in &steps {
+            match self.apply_animation_step(step.target, &step.values) {
+                Ok(()) => animated.push(step.target),
+                Err(e) => {
+                    jwarn!("Stopping animations of {:?}: {}", step.target, e);
+                    finished.extend(self.animator.cancel(step.target));
+                }
+            }
+        }
+
+        let due = self.commit_scheduler.next_frame();
+        if !animated.is_empty() || due.is_some() {
+            let commit_result = self.commit_pending();
+
+            match &commit_result {
+                Ok(()) => {
+                    for target in animated {
+                        match target {
+                            AnimationTarget::Surface(id) => {
+                                self.state_manager.handle_surface_configured(id)
+                            }
+                            AnimationTarget::Layer(id) => {
+                                self.state_manager.handle_layer_configured(id)
+                            }
+                        }
+                    }
+                }
+                Err(e) => jerror!("Failed to commit frame changes: {:?}", e),
+            }
+
+            if let Some((frame, waiting)) = due {
+                self.answer_frame_commit(frame, waiting, &commit_result);
+            }
+        }
+
+        // Commits only repaint when something changed; keep frames coming
+        // for the animations that are still running
+        if self.animator.running_count() > 0 {
+            self.commit_scheduler.request_repaint();
+        }
+        self.notify_animations_finished(&finished);
+    }
+
+    /// Answer the requests that waited for the commit of `frame` and release
+    /// the lanes they held
+    fn answer_frame_commit(
+        &self,
+        frame: u64,
+        waiting: Vec<DeferredResponse>,
+        commit_result: &Result<(), RpcError>,
+    ) {
+        jdebug!(
+            "Committed changes of {} requests for frame {}",
+            waiting.len(),
+            frame
+        );
+
+        let transport_lock = self.transport.lock().unwrap();
+        for deferred in waiting {
+            let Some(transport) = transport_lock.as_ref() else {
+                self.end_deferred(deferred.lane);
+                continue;
+            };
+
+            let response = match commit_result {
+                Ok(()) => {
+                    let mut result = deferred.result;
+                    if let Some(result) = result.as_object_mut() {
+                        result.insert("committed".to_string(), json!(true));
+                        result.insert("frame".to_string(), json!(frame));
+                    }
+                    RpcResponse::success(deferred.id, result)
+                }
+                Err(error) => RpcResponse::error(deferred.id, error.clone()),
+            };
+
+            let sent = response
+                .encode(deferred.encoding)
+                .map_err(|e| format!("{:?}", e))
+                .and_then(|data| {
+                    transport
+                        .send(&deferred.client_id, &data)
+                        .map_err(|e| format!("{:?}", e))
+                });
+            if let Err(e) = sent {
+                jerror!(
+                    "Failed to send frame commit response to client {}: {}",
+                    deferred.client_id,
+                    e
+                );
+            }
+            self.end_deferred(deferred.lane);
+        }
+    }
+
+    /// Release the lane a deferred response held, if any
+    fn end_deferred(&self, lane: Option<LaneToken>) {
+        if let Some(lane) = lane {
+            self.lanes.end_deferred(&self.compositor_queue, lane);
+        }
+    }
+
+    /// Set the values of one animation step, without committing
+    fn apply_animation_step(
+        &self,
+        target: AnimationTarget,
+        values: &AnimatedProperties,
+    ) -> Result<(), String> {
+        match target {
+            AnimationTarget::Surface(id) => {
+                let mut surface = self
+                    .id_to_surface(id)
+                    .ok_or_else(|| format!("Surface {} not found", id))?;
+                if let Some(rect) = values.destination {
+                    surface.set_destination_rectangle(rect)?;
+                }
+                if let Some(opacity) = values.opacity {
+                    surface.set_opacity(opacity)?;
+                }
+            }
+            AnimationTarget::Layer(id) => {
+                let mut layer = self
+                    .id_to_layer(id)
+                    .ok_or_else(|| format!("Layer {} not found", id))?;
+                if let Some(rect) = values.destination {
+                    layer.set_destination_rectangle(rect)?;
+                }
+                if let Some(opacity) = values.opacity {
+                    layer.set_opacity(opacity)?;
+                }
+            }
+        }
+        Ok(())
+    }
+
+    /// Emit AnimationCompleted for each finished or cancelled animation
+    fn notify_animations_finished(&self, finished: &[FinishedAnimation]) {
+        if finished.is_empty() {
+            return;
+        }
+
+        let notification_manager = self.state_manager.notification_manager();
+        for animation in finished {
+            notification_manager.emit_animation_completed(
+                animation.id,
+                animation.target,
+                animation.cancelled,
+            );
+        }
+    }
+
+    /// Answer list_surfaces or list_layers from the cached encoded result
+    ///
+    /// Returns `None` for every other request. The result is encoded once per
+    /// scene generation and encoding, so repeated polling of an unchanged scene
+    /// costs one `Arc` clone and one copy into the response.
+    pub fn cached_list_response(
+        &self,
+        request: &RpcRequest,
+        encoding: Encoding,
+    ) -> Option<Result<Vec<u8>, RpcError>> {
+        let (cache, build, method): (_, fn(&SceneSnapshot) -> serde_json::Value, _) =
+            match request.method.as_str() {
+                "list_surfaces" => (
+                    &self.list_cache.surfaces,
+                    list_surfaces_result,
+                    RpcMethod::ListSurfaces,
+                ),
+                "list_layers" => (
+                    &self.list_cache.layers,
+                    list_layers_result,
+                    RpcMethod::ListLayers,
+                ),
+                _ => return None,
+            };
+        let start = Instant::now();
+
+        let scene = self.state_manager.snapshot();
+        let result = {
+            let mut cache = cache.lock().unwrap();
+            if cache.generation != scene.generation {
+                *cache = CachedList {
+                    generation: scene.generation,
+                    ..Default::default()
+                };
+            }
+
+            match &mut cache.results[encoding as usize] {
+                Some(result) => Arc::clone(result),
+                slot => match encoding.encode_value(&build(&scene)) {
+                    Ok(result) => Arc::clone(slot.insert(result.into())),
+                    Err(e) => return Some(Err(e)),
+                },
+            }
+        };
+
+        jdebug!(
+            "Answering {} from scene generation {}: id={}",
+            request.method,
+            scene.generation,
+            request.id
+        );
+        let response = RpcResponse::encode_with_result(request.id, &result, encoding);
+        metrics().record_rpc(method.index(), start.elapsed(), true);
+        Some(Ok(response))
+    }
+
+    /// Handle a JSON-RPC batch, committing once after the last request.
+    ///
+    /// Requests run in order with their own commits deferred. If any of them
+    /// asked for a commit (`auto_commit` or an explicit `commit`), the batch
+    /// ends with a single `commit_changes()`, so the whole scene change becomes
+    /// visible in one compositor frame. If that commit fails, the requests that
+    /// asked for it report the commit error.
+    pub fn handle_batch(
+        &self,
+        client_id: &ClientId,
+        requests: Vec<RpcRequest>,
+    ) -> Vec<RpcResponse> {
+        jdebug!(
+            "Handling RPC batch from client {}: {} requests",
+            client_id,
+            requests.len()
+        );
+
+        let mut outcomes = Vec::with_capacity(requests.len());
+        let mut commit_requested = false;
+
+        for request in requests {
+            let outcome = match RpcMethod::from_request(&request) {
+                Ok(mut method) => {
+                    let wants_commit = method.defer_commit();
+                    let result = match method {
+                        RpcMethod::Commit => Ok(json!({ "success": true })),
+                        method => self.dispatch(client_id, method),
+                    };
+                    let wants_commit = wants_commit && result.is_ok();
+                    commit_requested |= wants_commit;
+                    (request.id, result, wants_commit)
+                }
+                Err(e) => {
+                    jwarn!(
+                        "Invalid RPC method in batch: {}, error: {}",
+                        request.method,
+                        e
+                    );
+                    metrics().invalid_request();
+                    (request.id, Err(e), false)
+                }
+            };
+            outcomes.push(outcome);
+        }
+
+        let commit_result = if commit_requested {
+            self.handle_commit().map(|_| ())
+        } else {
+            Ok(())
+        };
+
+        outcomes
+            .into_iter()
+            .map(|(id, result, wants_commit)| {
+                let result = match (&commit_result, wants_commit) {
+                    (Err(e), true) => Err(e.clone()),
+                    (Ok(()), true) => result.map(mark_committed),
+                    (_, false) => result,
+                };
+
+                match result {
+                    Ok(value) => RpcResponse::success(id, value),
+                    Err(error) => {
+                        jerror!("RPC request failed: id={}, error: {}", id, error);
+                        RpcResponse::error(id, error)
+                    }
+                }
+            })
+            .collect()
+    }
+
+    /// Route a parsed method to its handler, recording its run time
+    fn dispatch(
+        &self,
+        client_id: &ClientId,
+        method: RpcMethod,
+    ) -> Result<serde_json::Value, RpcError> {
+        let index = method.index();
+        // Changes left uncommitted are reflected in the state by the commit
+        // that eventually covers them
+        let effect = if method.commits() {
+            None
+        } else {
+            self.commit_effect(&method)
+        };
+        let start = Instant::now();
+        let result = self.run_method(client_id, method);
+        metrics().record_rpc(index, start.elapsed(), result.is_ok());
+
+        if let (Ok(_), Some(effect)) = (&result, effect) {
+            let mut uncommitted = self.uncommitted.lock().unwrap();
+            if !uncommitted.contains(&effect) {
+                uncommitted.push(effect);
+            }
+        }
+        result
+    }
+
+    /// State update the auto-commit path of `method` makes after its commit
+    fn commit_effect(&self, method: &RpcMethod) -> Option<CommitEffect> {
+        match *method {
+            RpcMethod::SetSurfaceSourceRectangle { id, .. }
+            | RpcMethod::SetSurfaceDestinationRectangle { id, .. }
+            | RpcMethod::SetSurfaceVisibility { id, .. }
+            | RpcMethod::SetSurfaceOpacity { id, .. } => Some(CommitEffect::SurfaceConfigured(id)),
+            RpcMethod::SetSurfaceZOrder { id, z_order, .. } => {
+                Some(CommitEffect::SurfaceZOrder { id, z_order })
+            }
+            RpcMethod::CreateLayer { id, .. }
+            | RpcMethod::SetLayerSourceRectangle { id, .. }
+            | RpcMethod::SetLayerDestinationRectangle { id, .. }
+            | RpcMethod::SetLayerVisibility { id, .. }
+            | RpcMethod::SetLayerOpacity { id, .. } => Some(CommitEffect::LayerConfigured(id)),
+            RpcMethod::DestroyLayer { id, .. } => Some(CommitEffect::LayerDestroyed(id)),
+            RpcMethod::ApplyScene { ref name, .. } => {
+                self.scene_presets.get(name).map(CommitEffect::Scene)
+            }
+            _ => None,
+        }
+    }
+
+    /// Make the state updates of committed changes, in the order the changes
+    /// were made
+    fn apply_commit_effects(&self, effects: &[CommitEffect]) {
+        for effect in effects {
+            match effect {
+                CommitEffect::SurfaceConfigured(id) => {
+                    self.state_manager.handle_surface_configured(*id)
+                }
+                CommitEffect::LayerConfigured(id) => {
+                    self.state_manager.handle_layer_configured(*id)
+                }
+                CommitEffect::SurfaceZOrder { id, z_order } => {
+                    if let Some(old_z_order) = self.state_manager.set_surface_z_order(*id, *z_order)
+                    {
+                        self.state_manager
+                            .notification_manager()
+                            .emit_z_order_change(*id, old_z_order, *z_order);
+                    }
+                }
+                CommitEffect::LayerDestroyed(id) => self.state_manager.handle_layer_destroyed(*id),
+                CommitEffect::Scene(preset) => {
+                    for &id in preset.surfaces() {
+                        self.state_manager.handle_surface_configured(id);
+                    }
+                    for &id in preset.layers() {
+                        self.state_manager.handle_layer_configured(id);
+                    }
+                }
+            }
+        }
+    }
+
+    fn run_method(
+        &self,
+        client_id: &ClientId,
+        method: RpcMethod,
+    ) -> Result<serde_json::Value, RpcError> {
+        match method {
             RpcMethod::ListSurfaces => self.handle_list_surfaces(),
             RpcMethod::GetSurface { id } => self.handle_get_surface(id),
             RpcMethod::SetSurfaceSourceRectangle {
@@ -207,15 +1071,31 @@ impl RpcHandler {
             RpcMethod::SetSurfaceFocus { id, auto_commit } => {
                 self.handle_set_surface_focus(id, auto_commit)
             }
+            RpcMethod::AnimateSurface { id, animation } => {
+                self.handle_animate(AnimationTarget::Surface(id), animation)
+            }
             RpcMethod::Commit => self.handle_commit(),
 
             // Subscription methods
-            RpcMethod::Subscribe { event_types } => self.handle_subscribe(client_id, event_types),
-            RpcMethod::Unsubscribe { event_types } => {
-                self.handle_unsubscribe(client_id, event_types)
+            RpcMethod::Subscribe {
+                event_types,
+                scope,
+                coalesce,
+            } => self.handle_subscribe(client_id, event_types, scope, coalesce),
+            RpcMethod::Unsubscribe { event_types, scope } => {
+                self.handle_unsubscribe(client_id, event_types, scope)
             }
             RpcMethod::ListSubscriptions => self.handle_list_subscriptions(client_id),
 
+            // Connection methods
+            RpcMethod::Handshake { encodings } => self.handle_handshake(client_id, encodings),
+
+            // Scene methods
+            RpcMethod::GetChangesSince { generation } => self.handle_get_changes_since(generation),
+
+            // Diagnostics
+            RpcMethod::GetMetrics { format } => self.handle_get_metrics(format),
+
             // Layer methods
             RpcMethod::ListLayers => self.handle_list_layers(),
             RpcMethod::CreateLayer {
@@ -271,6 +1151,9 @@ impl RpcHandler {
                 auto_commit,
             } => self.handle_remove_surface_from_layer(layer_id, surface_id, auto_commit),
             RpcMethod::GetLayerSurfaces { layer_id } => self.handle_get_layer_surfaces(layer_id),
+            RpcMethod::AnimateLayer { id, animation } => {
+                self.handle_animate(AnimationTarget::Layer(id), animation)
+            }
             // Screen operations
             RpcMethod::ListScreens => self.handle_list_screens(),
             RpcMethod::GetScreen { name } => self.handle_get_screen(name),
@@ -288,40 +1171,75 @@ impl RpcHandler {
                 layer_id,
                 auto_commit,
             } => self.handle_remove_layer_from_screen(screen_name, layer_id, auto_commit),
-        };
-
-        // Generate response
-        match result {
-            Ok(value) => {
-                jdebug!("RPC request successful: id={}", request.id);
-                RpcResponse::success(request.id, value)
+            // Scene presets
+            RpcMethod::DefineScene { name, definition } => {
+                self.handle_define_scene(name, definition)
             }
-            Err(error) => {
-                jerror!("RPC request failed: id={}, error: {}", request.id, error);
-                RpcResponse::error(request.id, error)
+            RpcMethod::ApplyScene { name, auto_commit } => {
+                self.handle_apply_scene(name, auto_commit)
             }
         }
     }
 
     /// Handle list_surfaces request
     fn handle_list_surfaces(&self) -> Result<serde_json::Value, RpcError> {
-        let state_manager = self.state_manager.lock().unwrap();
-        let surfaces = state_manager.get_all_surfaces();
+        Ok(list_surfaces_result(&self.state_manager.snapshot()))
+    }
+
+    /// Handle get_changes_since request
+    fn handle_get_changes_since(&self, generation: u64) -> Result<serde_json::Value, RpcError> {
+        let scene = self.state_manager.snapshot();
+        let changes = scene.changes_since(generation);
+
+        jdebug!(
+            "Changes since generation {}: {} surfaces, {} layers, {} removed (full={})",
+            generation,
+            changes.surfaces.len(),
+            changes.layers.len(),
+            changes.removed_surfaces.len() + changes.removed_layers.len(),
+            changes.full
+        );
+
+        let surfaces: Vec<serde_json::Value> = changes
+            .surfaces
+            .iter()
+            .map(|surface| surface_state_to_json(surface))
+            .collect();
+        let layers: Vec<serde_json::Value> = changes
+            .layers
+            .iter()
+            .map(|layer| layer_state_to_json(layer))
+            .collect();
+
+        Ok(json!({
+            "generation": changes.generation,
+            "full": changes.full,
+            "surfaces": surfaces,
+            "layers": layers,
+            "removed_surfaces": changes.removed_surfaces,
+            "removed_layers": changes.removed_layers,
+        }))
+    }
 
-        let surface_list: Vec<serde_json::Value> =
-            surfaces.iter().map(surface_state_to_json).collect();
+    /// Handle get_metrics request
+    fn handle_get_metrics(&self, format: MetricsFormat) -> Result<serde_json::Value, RpcError> {
+        let queues = self.subscription_manager.lock().unwrap().queue_depths();
 
-        Ok(json!({ "surfaces": surface_list }))
+        Ok(match format {
+            MetricsFormat::Json => metrics().to_json(&queues),
+            MetricsFormat::Prometheus => json!({
+                "format": "prometheus",
+                "text": metrics().to_prometheus(&queues),
+            }),
+        })
     }
 
     /// Handle get_surface request
     fn handle_get_surface(&self, id: u32) -> Result<serde_json::Value, RpcError> {
-        let state_manager = self.state_manager.lock().unwrap();
-
-        match state_manager.get_surface(id) {
+        match self.state_manager.snapshot().surfaces.get(&id) {
             Some(surface) => {
                 jdebug!("Retrieved surface {}", id);
-                Ok(surface_state_to_json(&surface))
+                Ok(surface_state_to_json(surface))
             }
             None => {
                 jwarn!("Surface not found: {}", id);
@@ -331,47 +1249,43 @@ impl RpcHandler {
     }
 
     fn id_to_surface(&self, id: u32) -> Option<IviSurface> {
-        let state_manager = self.state_manager.lock().unwrap();
-
-        let ivi_api = state_manager.ivi_api().clone();
-        ivi_api.get_surface_from_id(id)
+        self.state_manager.ivi_api().get_surface_from_id(id)
     }
 
-    fn commit_surface_changes(&self, id: u32) -> Result<(), RpcError> {
-        let state_manager = self.state_manager.lock().unwrap();
-        let ivi_api = state_manager.ivi_api().clone();
-        drop(state_manager);
-
-        ivi_api
+    /// Commit every pending change, then make the state updates of the
+    /// changes earlier requests left uncommitted
+    ///
+    /// Every commit of this controller goes through here, so the state of a
+    /// surface without a property listener still follows what is committed.
+    fn commit_pending(&self) -> Result<(), RpcError> {
+        self.state_manager
+            .ivi_api()
             .commit_changes()
             .map_err(|e| RpcError::internal_error(e.to_string()))?;
 
+        let effects = std::mem::take(&mut *self.uncommitted.lock().unwrap());
+        self.apply_commit_effects(&effects);
+        Ok(())
+    }
+
+    fn commit_surface_changes(&self, id: u32) -> Result<(), RpcError> {
+        self.commit_pending()?;
+
         // Update internal state
-        let mut state_manager = self.state_manager.lock().unwrap();
-        state_manager.handle_surface_configured(id);
+        self.state_manager.handle_surface_configured(id);
 
         Ok(())
     }
 
     fn id_to_layer(&self, id: u32) -> Option<crate::ffi::bindings::ivi_layer::IviLayer> {
-        let state_manager = self.state_manager.lock().unwrap();
-
-        let ivi_api = state_manager.ivi_api().clone();
-        ivi_api.get_layer_from_id(id)
+        self.state_manager.ivi_api().get_layer_from_id(id)
     }
 
     fn commit_layer_changes(&self, id: u32) -> Result<(), RpcError> {
-        let state_manager = self.state_manager.lock().unwrap();
-        let ivi_api = state_manager.ivi_api().clone();
-        drop(state_manager);
-
-        ivi_api
-            .commit_changes()
-            .map_err(|e| RpcError::internal_error(e.to_string()))?;
+        self.commit_pending()?;
 
         // Update internal state
-        let mut state_manager = self.state_manager.lock().unwrap();
-        state_manager.handle_layer_configured(id);
+        self.state_manager.handle_layer_configured(id);
 
         Ok(())
     }
@@ -539,30 +1453,10 @@ impl RpcHandler {
 
         // Commit changes only if auto_commit is true
         if auto_commit {
-            let state_manager = self.state_manager.lock().unwrap();
-            let ivi_api = state_manager.ivi_api().clone();
-            drop(state_manager);
-
-            ivi_api
-                .commit_changes()
-                .map_err(|e| RpcError::internal_error(e.to_string()))?;
-
-            // Update internal state and emit notification
-            // Capture old z-order first
-            let mut state_manager = self.state_manager.lock().unwrap();
-            let old_z = state_manager.get_surface(id).map(|s| s.z_order);
-            if let Some(mut surface_state) = state_manager.get_surface(id) {
-                surface_state.z_order = z_order;
-                state_manager.update_surface(id, surface_state);
-            }
+            self.commit_pending()?;
 
-            // Emit z-order change if we have an old value
-            if let Some(old_z_order) = old_z {
-                let nm = state_manager.notification_manager().clone();
-                drop(state_manager);
-                let nm = nm.lock().unwrap();
-                nm.emit_z_order_change(id, old_z_order, z_order);
-            }
+            // Update internal state and emit notification if we had an old value
+            self.apply_commit_effects(&[CommitEffect::SurfaceZOrder { id, z_order }]);
         }
 
         Ok(json!({ "success": true, "committed": auto_commit }))
@@ -594,12 +1488,7 @@ impl RpcHandler {
 
         // Commit changes only if auto_commit is true
         if auto_commit {
-            let state_manager = self.state_manager.lock().unwrap();
-            let ivi_api = state_manager.ivi_api().clone();
-            drop(state_manager);
-            ivi_api
-                .commit_changes()
-                .map_err(|e| RpcError::internal_error(e.to_string()))?;
+            self.commit_pending()?;
             jinfo!("Focus set to surface {} and committed", id);
         } else {
             jinfo!("Focus set to surface {} (pending commit)", id);
@@ -608,18 +1497,115 @@ impl RpcHandler {
         Ok(json!({ "success": true, "committed": auto_commit }))
     }
 
+    /// Handle animate_surface and animate_layer requests
+    ///
+    /// The animation starts from the current values of the animated
+    /// properties and is stepped and committed with each output frame.
+    fn handle_animate(
+        &self,
+        target: AnimationTarget,
+        animation: AnimationParams,
+    ) -> Result<serde_json::Value, RpcError> {
+        let easing = match &animation.easing {
+            Some(name) => name.parse::<Easing>().map_err(|e| {
+                RpcError::invalid_params(format!("Invalid 'easing' parameter: {}", e))
+            })?,
+            None => Easing::default(),
+        };
+        if let Some((x, y, width, height)) = animation.destination {
+            validation::validate_position(x, y)
+                .map_err(|e| RpcError::invalid_params(e.to_string()))?;
+            validation::validate_size(width, height)
+                .map_err(|e| RpcError::invalid_params(e.to_string()))?;
+        }
+        if let Some(opacity) = animation.opacity {
+            validation::validate_opacity(opacity)
+                .map_err(|e| RpcError::invalid_params(e.to_string()))?;
+        }
+
+        if !self.commit_scheduler.is_attached() {
+            return Err(RpcError::internal_error(
+                "Animations are not available without output frame signals".to_string(),
+            ));
+        }
+
+        let scene = self.state_manager.snapshot();
+        let (current_rect, current_opacity) = match target {
+            AnimationTarget::Surface(id) => {
+                let surface = scene
+                    .surfaces
+                    .get(&id)
+                    .ok_or_else(|| RpcError::surface_not_found(id))?;
+                (surface.dest_rect, surface.opacity)
+            }
+            AnimationTarget::Layer(id) => {
+                let layer = scene
+                    .layers
+                    .get(&id)
+                    .ok_or_else(|| RpcError::layer_not_found(id))?;
+                let (x, y, width, height) = layer.dest_rect;
+                (
+                    Rectangle {
+                        x,
+                        y,
+                        width,
+                        height,
+                    },
+                    layer.opacity,
+                )
+            }
+        };
+
+        let to = AnimatedProperties {
+            destination: animation
+                .destination
+                .map(|(x, y, width, height)| Rectangle {
+                    x,
+                    y,
+                    width,
+                    height,
+                }),
+            opacity: animation.opacity,
+        };
+        let from = AnimatedProperties {
+            destination: to.destination.map(|_| current_rect),
+            opacity: to.opacity.map(|_| current_opacity),
+        };
+
+        let (animation_id, replaced) = self.animator.start(
+            target,
+            from,
+            to,
+            Duration::from_millis(animation.duration_ms as u64),
+            easing,
+            Instant::now(),
+        );
+        jdebug!(
+            "Animation {} of {:?} started: {:?} over {} ms ({})",
+            animation_id,
+            target,
+            to,
+            animation.duration_ms,
+            easing.name()
+        );
+
+        self.notify_animations_finished(&replaced);
+        self.commit_scheduler.request_repaint();
+
+        Ok(json!({
+            "success": true,
+            "animation_id": animation_id,
+            "duration_ms": animation.duration_ms,
+            "easing": easing.name(),
+        }))
+    }
+
     /// Handle commit request - commits all pending changes
     fn handle_commit(&self) -> Result<serde_json::Value, RpcError> {
         jdebug!("Committing all pending changes");
 
-        let state_manager = self.state_manager.lock().unwrap();
-        let ivi_api = state_manager.ivi_api().clone();
-        drop(state_manager);
-
         // Commit all pending changes
-        ivi_api
-            .commit_changes()
-            .map_err(|e| RpcError::internal_error(e.to_string()))?;
+        self.commit_pending()?;
 
         jinfo!("All pending changes committed");
 
@@ -631,6 +1617,8 @@ impl RpcHandler {
         &self,
         client_id: &ClientId,
         event_types: Vec<EventType>,
+        scope: SubscriptionScope,
+        coalesce: Option<bool>,
     ) -> Result<serde_json::Value, RpcError> {
         jinfo!(
             "Client {} subscribing to {} event types",
@@ -638,10 +1626,21 @@ impl RpcHandler {
             event_types.len()
         );
 
-        let subscription_manager = self.subscription_manager.lock().unwrap();
-        let subscribed = subscription_manager
-            .subscribe(client_id, event_types)
-            .map_err(RpcError::internal_error)?;
+        let (subscribed, coalesce) = {
+            let subscription_manager = self.subscription_manager.lock().unwrap();
+            let subscribed = subscription_manager
+                .subscribe_scoped(client_id, event_types, &scope)
+                .map_err(RpcError::internal_error)?;
+            if let Some(coalesce) = coalesce {
+                subscription_manager.set_coalescing(client_id, coalesce);
+            }
+            (subscribed, subscription_manager.is_coalescing(client_id))
+        };
+
+        // The hook may query the subscriptions
+        if let Some(hook) = self.subscribe_hook.get() {
+            hook();
+        }
 
         jinfo!(
             "Client {} successfully subscribed to {} event types",
@@ -651,7 +1650,10 @@ impl RpcHandler {
 
         Ok(json!({
             "success": true,
-            "subscribed": subscribed
+            "subscribed": subscribed,
+            "surface_ids": scope.surface_ids,
+            "layer_ids": scope.layer_ids,
+            "coalesce": coalesce
         }))
     }
 
@@ -660,6 +1662,7 @@ impl RpcHandler {
         &self,
         client_id: &ClientId,
         event_types: Vec<EventType>,
+        scope: SubscriptionScope,
     ) -> Result<serde_json::Value, RpcError> {
         jinfo!(
             "Client {} unsubscribing from {} event types",
@@ -669,7 +1672,7 @@ impl RpcHandler {
 
         let subscription_manager = self.subscription_manager.lock().unwrap();
         let unsubscribed = subscription_manager
-            .unsubscribe(client_id, event_types)
+            .unsubscribe_scoped(client_id, event_types, &scope)
             .map_err(RpcError::internal_error)?;
 
         jinfo!(
@@ -680,10 +1683,37 @@ impl RpcHandler {
 
         Ok(json!({
             "success": true,
-            "unsubscribed": unsubscribed
+            "unsubscribed": unsubscribed,
+            "surface_ids": scope.surface_ids,
+            "layer_ids": scope.layer_ids
         }))
     }
 
+    /// Handle handshake request - switch the client to the first supported encoding
+    ///
+    /// The response is still sent in the previous encoding; the switch is
+    /// applied after it has been written.
+    fn handle_handshake(
+        &self,
+        client_id: &ClientId,
+        encodings: Vec<String>,
+    ) -> Result<serde_json::Value, RpcError> {
+        let encoding = encodings
+            .iter()
+            .find_map(|name| name.parse::<Encoding>().ok())
+            .ok_or_else(|| {
+                RpcError::invalid_params(format!("No supported encoding in {:?}", encodings))
+            })?;
+
+        self.encodings
+            .lock()
+            .unwrap()
+            .get_or_insert_with(client_id.key(), ClientEncoding::default)
+            .next = Some(encoding);
+
+        Ok(json!({ "encoding": encoding.name() }))
+    }
+
     /// Handle list_subscriptions request - list all active subscriptions for a client
     fn handle_list_subscriptions(
         &self,
@@ -693,48 +1723,31 @@ impl RpcHandler {
 
         let subscription_manager = self.subscription_manager.lock().unwrap();
         let subscriptions = subscription_manager.get_subscriptions(client_id);
+        let objects: Vec<serde_json::Value> = subscription_manager
+            .get_object_subscriptions(client_id)
+            .into_iter()
+            .map(|(object, event_types)| match object {
+                ObjectRef::Surface(id) => json!({ "surface_id": id, "event_types": event_types }),
+                ObjectRef::Layer(id) => json!({ "layer_id": id, "event_types": event_types }),
+            })
+            .collect();
 
         jdebug!(
-            "Client {} has {} active subscriptions",
+            "Client {} has {} active subscriptions and {} object subscriptions",
             client_id,
-            subscriptions.len()
+            subscriptions.len(),
+            objects.len()
         );
 
         Ok(json!({
-            "subscriptions": subscriptions
+            "subscriptions": subscriptions,
+            "objects": objects
         }))
     }
 
     /// Handle list_layers request
     fn handle_list_layers(&self) -> Result<serde_json::Value, RpcError> {
-        let state_manager = self.state_manager.lock().unwrap();
-        let layers = state_manager.get_all_layers();
-
-        let layer_list: Vec<serde_json::Value> = layers
-            .iter()
-            .map(|layer| {
-                json!({
-                    "id": layer.id,
-                    "src_rect": {
-                        "x": layer.src_rect.0,
-                        "y": layer.src_rect.1,
-                        "width": layer.src_rect.2,
-                        "height": layer.src_rect.3,
-                    },
-                    "dest_rect": {
-                        "x": layer.dest_rect.0,
-                        "y": layer.dest_rect.1,
-                        "width": layer.dest_rect.2,
-                        "height": layer.dest_rect.3,
-                    },
-                    "visibility": layer.visibility,
-                    "opacity": layer.opacity,
-                    "orientation": layer.orientation,
-                })
-            })
-            .collect();
-
-        Ok(json!({ "layers": layer_list }))
+        Ok(list_layers_result(&self.state_manager.snapshot()))
     }
 
     fn handle_create_layer(
@@ -750,9 +1763,7 @@ impl RpcHandler {
         validation::validate_size(width, height)
             .map_err(|e| RpcError::invalid_params(e.to_string()))?;
 
-        let state_manager = self.state_manager.lock().unwrap();
-        let ivi_api = state_manager.ivi_api().clone();
-        drop(state_manager);
+        let ivi_api = self.state_manager.ivi_api().clone();
 
         // Create the layer via IVI API
         let layer = ivi_api
@@ -780,7 +1791,7 @@ impl RpcHandler {
     ) -> Result<serde_json::Value, RpcError> {
         jdebug!("Destroying layer {} [auto_commit={}]", id, auto_commit);
 
-        let state_manager = self.state_manager.lock().unwrap();
+        let state_manager = &self.state_manager;
         let ivi_api = state_manager.ivi_api().clone();
 
         // Verify layer exists before attempting to destroy
@@ -789,8 +1800,6 @@ impl RpcHandler {
             return Err(RpcError::layer_not_found(id));
         }
 
-        drop(state_manager);
-
         // Get the layer from the IVI API
         let layer = ivi_api
             .get_layer_from_id(id)
@@ -805,13 +1814,10 @@ impl RpcHandler {
 
         // Commit changes if auto_commit is true
         if auto_commit {
-            ivi_api
-                .commit_changes()
-                .map_err(|e| RpcError::internal_error(e.to_string()))?;
+            self.commit_pending()?;
 
             // Update internal state - the layer is now destroyed
-            let mut state_manager = self.state_manager.lock().unwrap();
-            state_manager.handle_layer_destroyed(id);
+            self.state_manager.handle_layer_destroyed(id);
 
             jinfo!("Layer {} destruction committed", id);
         }
@@ -821,29 +1827,10 @@ impl RpcHandler {
 
     /// Handle get_layer request
     fn handle_get_layer(&self, id: u32) -> Result<serde_json::Value, RpcError> {
-        let state_manager = self.state_manager.lock().unwrap();
-
-        match state_manager.get_layer(id) {
+        match self.state_manager.snapshot().layers.get(&id) {
             Some(layer) => {
                 jdebug!("Retrieved layer {}", id);
-                Ok(json!({
-                    "id": layer.id,
-                    "src_rect": {
-                        "x": layer.src_rect.0,
-                        "y": layer.src_rect.1,
-                        "width": layer.src_rect.2,
-                        "height": layer.src_rect.3,
-                    },
-                    "dest_rect": {
-                        "x": layer.dest_rect.0,
-                        "y": layer.dest_rect.1,
-                        "width": layer.dest_rect.2,
-                        "height": layer.dest_rect.3,
-                    },
-                    "visibility": layer.visibility,
-                    "opacity": layer.opacity,
-                    "orientation": layer.orientation,
-                }))
+                Ok(layer_state_to_json(layer))
             }
             None => {
                 jwarn!("Layer not found: {}", id);
@@ -936,7 +1923,7 @@ impl RpcHandler {
             auto_commit
         );
 
-        let state_manager = self.state_manager.lock().unwrap();
+        let state_manager = &self.state_manager;
 
         // Check if layer exists
         if !state_manager.has_layer(id) {
@@ -946,7 +1933,6 @@ impl RpcHandler {
 
         // Get the IVI API and update the layer
         let ivi_api = state_manager.ivi_api().clone();
-        drop(state_manager); // Release lock before calling IVI API
 
         let mut layer = ivi_api
             .get_layer_from_id(id)
@@ -958,13 +1944,10 @@ impl RpcHandler {
 
         // Commit changes only if auto_commit is true
         if auto_commit {
-            ivi_api
-                .commit_changes()
-                .map_err(|e| RpcError::internal_error(e.to_string()))?;
+            self.commit_pending()?;
 
             // Update internal state
-            let mut state_manager = self.state_manager.lock().unwrap();
-            state_manager.handle_layer_configured(id);
+            self.state_manager.handle_layer_configured(id);
         }
 
         Ok(json!({ "success": true, "committed": auto_commit }))
@@ -988,7 +1971,7 @@ impl RpcHandler {
             auto_commit
         );
 
-        let state_manager = self.state_manager.lock().unwrap();
+        let state_manager = &self.state_manager;
 
         // Check if layer exists
         if !state_manager.has_layer(id) {
@@ -998,7 +1981,6 @@ impl RpcHandler {
 
         // Get the IVI API and update the layer
         let ivi_api = state_manager.ivi_api().clone();
-        drop(state_manager); // Release lock before calling IVI API
 
         let mut layer = ivi_api
             .get_layer_from_id(id)
@@ -1010,13 +1992,10 @@ impl RpcHandler {
 
         // Commit changes only if auto_commit is true
         if auto_commit {
-            ivi_api
-                .commit_changes()
-                .map_err(|e| RpcError::internal_error(e.to_string()))?;
+            self.commit_pending()?;
 
             // Update internal state
-            let mut state_manager = self.state_manager.lock().unwrap();
-            state_manager.handle_layer_configured(id);
+            self.state_manager.handle_layer_configured(id);
         }
 
         Ok(json!({ "success": true, "committed": auto_commit }))
@@ -1036,7 +2015,7 @@ impl RpcHandler {
             auto_commit
         );
 
-        let state_manager = self.state_manager.lock().unwrap();
+        let state_manager = &self.state_manager;
         let ivi_api = state_manager.ivi_api().clone();
 
         // Get layer and verify it exists
@@ -1057,8 +2036,6 @@ impl RpcHandler {
             ));
         }
 
-        drop(state_manager);
-
         // Build reference slice: first = bottommost, last = topmost
         let surface_refs: Vec<&_> = surfaces.iter().collect();
 
@@ -1069,9 +2046,7 @@ impl RpcHandler {
 
         // Commit if requested
         if auto_commit {
-            ivi_api
-                .commit_changes()
-                .map_err(|e| RpcError::internal_error(e.to_string()))?;
+            self.commit_pending()?;
         }
 
         Ok(json!({
@@ -1095,7 +2070,7 @@ impl RpcHandler {
             auto_commit
         );
 
-        let state_manager = self.state_manager.lock().unwrap();
+        let state_manager = &self.state_manager;
         let ivi_api = state_manager.ivi_api().clone();
 
         // Get layer and verify it exists
@@ -1111,8 +2086,6 @@ impl RpcHandler {
             .get_surface_from_id(surface_id)
             .ok_or_else(|| RpcError::internal_error(format!("Surface {} not found", surface_id)))?;
 
-        drop(state_manager);
-
         // Append new surface to end (topmost position)
         surfaces.push(new_surface);
 
@@ -1126,9 +2099,7 @@ impl RpcHandler {
 
         // Commit if requested
         if auto_commit {
-            ivi_api
-                .commit_changes()
-                .map_err(|e| RpcError::internal_error(e.to_string()))?;
+            self.commit_pending()?;
         }
 
         Ok(json!({
@@ -1152,7 +2123,7 @@ impl RpcHandler {
             auto_commit
         );
 
-        let state_manager = self.state_manager.lock().unwrap();
+        let state_manager = &self.state_manager;
         let ivi_api = state_manager.ivi_api().clone();
 
         // Get layer and verify it exists
@@ -1165,8 +2136,6 @@ impl RpcHandler {
             .get_surface_from_id(surface_id)
             .ok_or_else(|| RpcError::internal_error(format!("Surface {} not found", surface_id)))?;
 
-        drop(state_manager);
-
         // Remove surface from layer
         ivi_api
             .layer_remove_surface(&layer, &surface)
@@ -1176,9 +2145,7 @@ impl RpcHandler {
 
         // Commit if requested
         if auto_commit {
-            ivi_api
-                .commit_changes()
-                .map_err(|e| RpcError::internal_error(e.to_string()))?;
+            self.commit_pending()?;
         }
 
         Ok(json!({
@@ -1192,7 +2159,7 @@ impl RpcHandler {
     fn handle_get_layer_surfaces(&self, layer_id: u32) -> Result<serde_json::Value, RpcError> {
         jdebug!("Getting surfaces for layer {}", layer_id);
 
-        let state_manager = self.state_manager.lock().unwrap();
+        let state_manager = &self.state_manager;
         let ivi_api = state_manager.ivi_api().clone();
 
         // Get layer and verify it exists
@@ -1200,8 +2167,6 @@ impl RpcHandler {
             .get_layer_from_id(layer_id)
             .ok_or_else(|| RpcError::internal_error(format!("Layer {} not found", layer_id)))?;
 
-        drop(state_manager);
-
         // Get surfaces on the layer
         let surfaces = ivi_api.get_surfaces_on_layer(&layer);
 
@@ -1212,6 +2177,52 @@ impl RpcHandler {
     }
 }
 
+/// Report a shared commit as the commit of a request that deferred its own
+fn mark_committed(mut value: serde_json::Value) -> serde_json::Value {
+    if let Some(committed) = value.get_mut("committed") {
+        *committed = json!(true);
+    }
+    value
+}
+
+/// Build the result of list_surfaces from a scene snapshot
+fn list_surfaces_result(scene: &SceneSnapshot) -> serde_json::Value {
+    let surface_list: Vec<serde_json::Value> =
+        scene.surfaces.values().map(surface_state_to_json).collect();
+
+    json!({ "generation": scene.generation, "surfaces": surface_list })
+}
+
+/// Build the result of list_layers from a scene snapshot
+fn list_layers_result(scene: &SceneSnapshot) -> serde_json::Value {
+    let layer_list: Vec<serde_json::Value> =
+        scene.layers.values().map(layer_state_to_json).collect();
+
+    json!({ "generation": scene.generation, "layers": layer_list })
+}
+
+/// Convert a LayerState to JSON
+fn layer_state_to_json(layer: &LayerState) -> serde_json::Value {
+    json!({
+        "id": layer.id,
+        "src_rect": {
+            "x": layer.src_rect.0,
+            "y": layer.src_rect.1,
+            "width": layer.src_rect.2,
+            "height": layer.src_rect.3,
+        },
+        "dest_rect": {
+            "x": layer.dest_rect.0,
+            "y": layer.dest_rect.1,
+            "width": layer.dest_rect.2,
+            "height": layer.dest_rect.3,
+        },
+        "visibility": layer.visibility,
+        "opacity": layer.opacity,
+        "orientation": layer.orientation,
+    })
+}
+
 /// Convert a SurfaceState to JSON
 fn surface_state_to_json(surface: &SurfaceState) -> serde_json::Value {
     json!({
@@ -1242,9 +2253,7 @@ fn surface_state_to_json(surface: &SurfaceState) -> serde_json::Value {
 impl RpcHandler {
     /// List all screens
     fn handle_list_screens(&self) -> Result<serde_json::Value, RpcError> {
-        let state_manager = self.state_manager.lock().unwrap();
-        let ivi_api = state_manager.ivi_api().clone();
-        drop(state_manager);
+        let ivi_api = self.state_manager.ivi_api().clone();
 
         let screens = ivi_api.get_screens();
         let screen_infos: Vec<serde_json::Value> = screens
@@ -1269,9 +2278,7 @@ impl RpcHandler {
 
     /// Get a specific screen by name
     fn handle_get_screen(&self, name: String) -> Result<serde_json::Value, RpcError> {
-        let state_manager = self.state_manager.lock().unwrap();
-        let ivi_api = state_manager.ivi_api().clone();
-        drop(state_manager);
+        let ivi_api = self.state_manager.ivi_api().clone();
 
         let screens = ivi_api.get_screens();
         let screen = screens
@@ -1295,9 +2302,7 @@ impl RpcHandler {
 
     /// Get layers assigned to a screen
     fn handle_get_screen_layers(&self, screen_name: String) -> Result<serde_json::Value, RpcError> {
-        let state_manager = self.state_manager.lock().unwrap();
-        let ivi_api = state_manager.ivi_api().clone();
-        drop(state_manager);
+        let ivi_api = self.state_manager.ivi_api().clone();
 
         let screens = ivi_api.get_screens();
         let screen = screens
@@ -1320,7 +2325,7 @@ impl RpcHandler {
 
     /// Get screens assigned to a layer
     fn handle_get_layer_screens(&self, layer_id: u32) -> Result<serde_json::Value, RpcError> {
-        let state_manager = self.state_manager.lock().unwrap();
+        let state_manager = &self.state_manager;
         let ivi_api = state_manager.ivi_api().clone();
 
         // Get the layer
@@ -1328,8 +2333,6 @@ impl RpcHandler {
             .get_layer_from_id(layer_id)
             .ok_or_else(|| RpcError::layer_not_found(layer_id))?;
 
-        drop(state_manager);
-
         let screens = ivi_api
             .get_screens_under_layer(&layer)
             .map_err(|e| RpcError::internal_error(format!("Failed to get screens: {}", e)))?;
@@ -1346,7 +2349,7 @@ impl RpcHandler {
         layer_ids: Vec<u32>,
         auto_commit: bool,
     ) -> Result<serde_json::Value, RpcError> {
-        let state_manager = self.state_manager.lock().unwrap();
+        let state_manager = &self.state_manager;
         let ivi_api = state_manager.ivi_api().clone();
 
         // Find the screen
@@ -1374,8 +2377,6 @@ impl RpcHandler {
             ));
         }
 
-        drop(state_manager);
-
         // Set render order - convert Vec<IviLayer> to &[&IviLayer]
         let layer_refs: Vec<&_> = layers.iter().collect();
         ivi_api
@@ -1383,9 +2384,7 @@ impl RpcHandler {
             .map_err(|e| RpcError::internal_error(format!("Failed to set render order: {}", e)))?;
 
         if auto_commit {
-            ivi_api
-                .commit_changes()
-                .map_err(|e| RpcError::internal_error(format!("Failed to commit: {}", e)))?;
+            self.commit_pending()?;
         }
 
         Ok(json!({
@@ -1402,7 +2401,7 @@ impl RpcHandler {
         layer_id: u32,
         auto_commit: bool,
     ) -> Result<serde_json::Value, RpcError> {
-        let state_manager = self.state_manager.lock().unwrap();
+        let state_manager = &self.state_manager;
         let ivi_api = state_manager.ivi_api().clone();
 
         // Find the screen
@@ -1414,32 +2413,315 @@ impl RpcHandler {
                 RpcError::internal_error(format!("Screen '{}' not found", screen_name))
             })?;
 
-        // Get the layer using get_layer_from_id
-        let layer = ivi_api
-            .get_layer_from_id(layer_id)
-            .ok_or_else(|| RpcError::layer_not_found(layer_id))?;
+        // Get the layer using get_layer_from_id
+        let layer = ivi_api
+            .get_layer_from_id(layer_id)
+            .ok_or_else(|| RpcError::layer_not_found(layer_id))?;
+
+        // Remove layer from screen
+        ivi_api
+            .screen_remove_layer(screen.clone(), &layer)
+            .map_err(|e| RpcError::internal_error(format!("Failed to remove layer: {}", e)))?;
+
+        if auto_commit {
+            self.commit_pending()?;
+        }
+
+        Ok(json!({
+            "screen_name": screen_name,
+            "layer_id": layer_id,
+            "committed": auto_commit
+        }))
+    }
+}
+
+impl RpcHandler {
+    /// Named scene presets of this handler
+    pub fn scene_presets(&self) -> &ScenePresets {
+        &self.scene_presets
+    }
+
+    /// Validate a scene definition and store it under `name`
+    fn handle_define_scene(
+        &self,
+        name: String,
+        definition: SceneDefinition,
+    ) -> Result<serde_json::Value, RpcError> {
+        let preset = ScenePreset::compile(&definition).map_err(RpcError::invalid_params)?;
+        let operations = preset.ops().len();
+        let replaced = self.scene_presets.define(&name, preset);
+
+        jinfo!(
+            "Defined scene '{}' ({} operations{})",
+            name,
+            operations,
+            if replaced { ", replaced" } else { "" }
+        );
+
+        Ok(json!({
+            "name": name,
+            "operations": operations,
+            "replaced": replaced
+        }))
+    }
+
+    /// Apply a stored scene: every IVI object is looked up before the first
+    /// change, so a missing one leaves the scene untouched
+    fn handle_apply_scene(
+        &self,
+        name: String,
+        auto_commit: bool,
+    ) -> Result<serde_json::Value, RpcError> {
+        let preset = self
+            .scene_presets
+            .get(&name)
+            .ok_or_else(|| RpcError::invalid_params(format!("Scene '{}' not defined", name)))?;
+        jdebug!("Applying scene '{}' [auto_commit={}]", name, auto_commit);
+
+        let ivi_api = self.state_manager.ivi_api().clone();
+
+        let mut surfaces = HashMap::with_capacity(preset.surfaces().len());
+        for &id in preset.surfaces() {
+            let surface = self
+                .id_to_surface(id)
+                .ok_or_else(|| RpcError::surface_not_found(id))?;
+            surfaces.insert(id, surface);
+        }
+
+        let mut layers = HashMap::with_capacity(preset.layers().len());
+        for &id in preset.layers() {
+            let layer = self
+                .id_to_layer(id)
+                .ok_or_else(|| RpcError::layer_not_found(id))?;
+            layers.insert(id, layer);
+        }
 
-        drop(state_manager);
+        let outputs = ivi_api.get_screens();
+        let mut screens = HashMap::with_capacity(preset.screens().len());
+        for name in preset.screens() {
+            let output = outputs
+                .iter()
+                .find(|output| output.name().as_deref() == Some(&**name))
+                .ok_or_else(|| RpcError::invalid_params(format!("Screen '{}' not found", name)))?;
+            screens.insert(&**name, output);
+        }
 
-        // Remove layer from screen
-        ivi_api
-            .screen_remove_layer(screen.clone(), &layer)
-            .map_err(|e| RpcError::internal_error(format!("Failed to remove layer: {}", e)))?;
+        // A failure partway puts back what the scene already staged, so a
+        // later commit does not pick up half of it
+        let mut undo = Vec::with_capacity(preset.ops().len());
+        for op in preset.ops() {
+            let prior = scene_undo(op, &ivi_api, &surfaces, &layers, &screens);
+            if let Err(e) = apply_scene_op(op, &ivi_api, &mut surfaces, &mut layers, &screens) {
+                jwarn!(
+                    "Scene '{}' failed after {} operations, rolling back: {}",
+                    name,
+                    undo.len(),
+                    e
+                );
+                for prior in undo.into_iter().rev() {
+                    if let Err(e) =
+                        undo_scene_op(prior, &ivi_api, &mut surfaces, &mut layers, &screens)
+                    {
+                        jwarn!("Failed to roll back scene '{}': {}", name, e);
+                    }
+                }
+                return Err(RpcError::internal_error(e));
+            }
+            undo.extend(prior);
+        }
 
+        // One commit for the whole scene
         if auto_commit {
-            ivi_api
-                .commit_changes()
-                .map_err(|e| RpcError::internal_error(format!("Failed to commit: {}", e)))?;
+            self.commit_pending()?;
+
+            self.apply_commit_effects(&[CommitEffect::Scene(Arc::clone(&preset))]);
         }
 
         Ok(json!({
-            "screen_name": screen_name,
-            "layer_id": layer_id,
+            "name": name,
+            "operations": preset.ops().len(),
             "committed": auto_commit
         }))
     }
 }
 
+/// Value that a scene operation replaces, to put back if the scene fails
+/// partway: the one staged since the last commit, or else the committed one,
+/// so that changes other requests left uncommitted survive the rollback
+enum SceneUndo {
+    Op(SceneOp),
+    LayerSurfaces(u32, Vec<IviSurface>),
+    ScreenLayers(Box<str>, Vec<IviLayer>),
+}
+
+/// Record the value `op` is about to replace, or None if it cannot be read
+fn scene_undo(
+    op: &SceneOp,
+    ivi_api: &IviLayoutApi,
+    surfaces: &HashMap<u32, IviSurface>,
+    layers: &HashMap<u32, IviLayer>,
+    screens: &HashMap<&str, &WestonOutput>,
+) -> Option<SceneUndo> {
+    let undo = match op {
+        SceneOp::SurfaceSource { id, .. } => SceneOp::SurfaceSource {
+            id: *id,
+            rect: match ivi_api
+                .staged_surface_properties(&surfaces[id])
+                .source_rectangle
+            {
+                Some(rect) => rect,
+                None => surfaces[id].properties()?.source_rectangle(),
+            },
+        },
+        SceneOp::SurfaceDestination { id, .. } => SceneOp::SurfaceDestination {
+            id: *id,
+            rect: match ivi_api
+                .staged_surface_properties(&surfaces[id])
+                .destination_rectangle
+            {
+                Some(rect) => rect,
+                None => surfaces[id].properties()?.destination_rectangle(),
+            },
+        },
+        SceneOp::SurfaceVisibility { id, .. } => SceneOp::SurfaceVisibility {
+            id: *id,
+            visible: match ivi_api.staged_surface_properties(&surfaces[id]).visibility {
+                Some(visible) => visible,
+                None => surfaces[id].properties()?.visibility(),
+            },
+        },
+        SceneOp::SurfaceOpacity { id, .. } => SceneOp::SurfaceOpacity {
+            id: *id,
+            opacity: match ivi_api.staged_surface_properties(&surfaces[id]).opacity {
+                Some(opacity) => opacity,
+                None => surfaces[id].properties()?.opacity(),
+            },
+        },
+        SceneOp::LayerSource { id, .. } => SceneOp::LayerSource {
+            id: *id,
+            rect: match ivi_api
+                .staged_layer_properties(&layers[id])
+                .source_rectangle
+            {
+                Some(rect) => rect,
+                None => layers[id].properties()?.source_rectangle(),
+            },
+        },
+        SceneOp::LayerDestination { id, .. } => SceneOp::LayerDestination {
+            id: *id,
+            rect: match ivi_api
+                .staged_layer_properties(&layers[id])
+                .destination_rectangle
+            {
+                Some(rect) => rect,
+                None => layers[id].properties()?.destination_rectangle(),
+            },
+        },
+        SceneOp::LayerVisibility { id, .. } => SceneOp::LayerVisibility {
+            id: *id,
+            visible: match ivi_api.staged_layer_properties(&layers[id]).visibility {
+                Some(visible) => visible,
+                None => layers[id].properties()?.visibility(),
+            },
+        },
+        SceneOp::LayerOpacity { id, .. } => SceneOp::LayerOpacity {
+            id: *id,
+            opacity: match ivi_api.staged_layer_properties(&layers[id]).opacity {
+                Some(opacity) => opacity,
+                None => layers[id].properties()?.opacity(),
+            },
+        },
+        SceneOp::LayerSurfaces { id, .. } => {
+            let order = ivi_api
+                .staged_surfaces_on_layer(&layers[id])
+                .unwrap_or_else(|| layers[id].get_surfaces());
+            return Some(SceneUndo::LayerSurfaces(*id, order));
+        }
+        SceneOp::ScreenLayers { name, .. } => {
+            let screen = screens[&**name];
+            let order = match ivi_api.staged_layers_on_screen(screen) {
+                Some(order) => order,
+                // Safety: the output comes from the compositor's list of screens
+                None => unsafe { ivi_api.get_layers_on_screen(screen.clone().into()) }.ok()?,
+            };
+            return Some(SceneUndo::ScreenLayers(name.clone(), order));
+        }
+    };
+    Some(SceneUndo::Op(undo))
+}
+
+/// Make the IVI layout call of one scene operation
+fn apply_scene_op(
+    op: &SceneOp,
+    ivi_api: &IviLayoutApi,
+    surfaces: &mut HashMap<u32, IviSurface>,
+    layers: &mut HashMap<u32, IviLayer>,
+    screens: &HashMap<&str, &WestonOutput>,
+) -> Result<(), String> {
+    match op {
+        SceneOp::SurfaceSource { id, rect } => {
+            surfaces.get_mut(id).unwrap().set_source_rectangle(*rect)
+        }
+        SceneOp::SurfaceDestination { id, rect } => surfaces
+            .get_mut(id)
+            .unwrap()
+            .set_destination_rectangle(*rect),
+        SceneOp::SurfaceVisibility { id, visible } => {
+            surfaces.get_mut(id).unwrap().set_visibility(*visible)
+        }
+        SceneOp::SurfaceOpacity { id, opacity } => {
+            surfaces.get_mut(id).unwrap().set_opacity(*opacity)
+        }
+        SceneOp::LayerSource { id, rect } => {
+            layers.get_mut(id).unwrap().set_source_rectangle(*rect)
+        }
+        SceneOp::LayerDestination { id, rect } => {
+            layers.get_mut(id).unwrap().set_destination_rectangle(*rect)
+        }
+        SceneOp::LayerVisibility { id, visible } => {
+            layers.get_mut(id).unwrap().set_visibility(*visible)
+        }
+        SceneOp::LayerOpacity { id, opacity } => layers.get_mut(id).unwrap().set_opacity(*opacity),
+        SceneOp::LayerSurfaces { id, surface_ids } => {
+            let refs: Vec<&IviSurface> = surface_ids.iter().map(|id| &surfaces[id]).collect();
+            ivi_api
+                .layer_set_render_order(&layers[id], &refs)
+                .map_err(|e| format!("Failed to set render order: {}", e))
+        }
+        SceneOp::ScreenLayers { name, layer_ids } => {
+            let refs: Vec<&IviLayer> = layer_ids.iter().map(|id| &layers[id]).collect();
+            ivi_api
+                .screen_set_render_order(screens[&**name].clone(), &refs)
+                .map_err(|e| format!("Failed to set render order: {}", e))
+        }
+    }
+}
+
+/// Put back a value recorded by [`scene_undo`]
+fn undo_scene_op(
+    undo: SceneUndo,
+    ivi_api: &IviLayoutApi,
+    surfaces: &mut HashMap<u32, IviSurface>,
+    layers: &mut HashMap<u32, IviLayer>,
+    screens: &HashMap<&str, &WestonOutput>,
+) -> Result<(), String> {
+    match undo {
+        SceneUndo::Op(op) => apply_scene_op(&op, ivi_api, surfaces, layers, screens),
+        SceneUndo::LayerSurfaces(id, order) => {
+            let refs: Vec<&IviSurface> = order.iter().collect();
+            ivi_api
+                .layer_set_render_order(&layers[&id], &refs)
+                .map_err(|e| format!("Failed to set render order: {}", e))
+        }
+        SceneUndo::ScreenLayers(name, order) => {
+            let refs: Vec<&IviLayer> = order.iter().collect();
+            ivi_api
+                .screen_set_render_order(screens[&*name].clone(), &refs)
+                .map_err(|e| format!("Failed to set render order: {}", e))
+        }
+    }
+}
+
 /// Message handler implementation that bridges transport and RPC handler
 struct RpcMessageHandler {
     rpc_handler: Arc<RpcHandler>,
@@ -1448,10 +2730,19 @@ struct RpcMessageHandler {
 impl MessageHandler for RpcMessageHandler {
     fn handle_message(&self, client_id: &ClientId, data: &[u8]) {
         jtrace!("Received message from client {}", client_id);
+        let _timer = metrics().time_message();
 
-        // Parse the incoming message as an RPC request
-        let request = match RpcRequest::from_json(data) {
-            Ok(req) => req,
+        // Decode and answer in the encoding in effect when the message arrived,
+        // so a handshake is answered in the encoding it was sent in
+        let encoding = self.rpc_handler.client_encoding(client_id);
+
+        if let Some(recorder) = self.rpc_handler.recorder.get() {
+            recorder.record(RecordKind::Request, client_id, encoding, data);
+        }
+
+        // Parse the incoming message as an RPC request or a batch of requests
+        let message = match RpcMessage::decode(data, encoding) {
+            Ok(message) => message,
             Err(e) => {
                 // If we can't parse the request, we can't send a proper response
                 // because we don't have a request ID
@@ -1464,48 +2755,49 @@ impl MessageHandler for RpcMessageHandler {
             }
         };
 
-        // Handle the request
-        let response = self.rpc_handler.handle_request(client_id, request);
+        let handler = &self.rpc_handler;
 
-        // Serialize the response
-        let response_data = match response.to_json() {
-            Ok(data) => data,
-            Err(e) => {
-                jerror!(
-                    "Failed to serialize RPC response for client {}: {:?}",
-                    client_id,
-                    e
-                );
+        // Snapshot reads go to the worker pool, unless the client still waits
+        // for requests on the compositor thread that they must not overtake
+        if let Some(pool) = handler.read_pool.get() {
+            let snapshot_read = match &message {
+                RpcMessage::Single(request) => {
+                    RpcMethod::reads_snapshot(&request.method)
+                        && matches!(CommitMode::from_request(request), Ok(CommitMode::Immediate))
+                }
+                RpcMessage::Batch(_) => false,
+            };
+
+            if snapshot_read && handler.lanes.try_begin_read(client_id) {
+                let handler = Arc::clone(handler);
+                let client_id = client_id.clone();
+                pool.execute(Box::new(move || {
+                    handler.respond_and_send(&client_id, message, encoding);
+                    handler
+                        .lanes
+                        .end_read(&handler.compositor_queue, &client_id);
+                }));
                 return;
             }
+        }
+
+        // Everything else runs on the compositor thread, if its event loop
+        // is attached, after the client's reads still on the pool
+        let queued = QueuedMessage {
+            client_id: client_id.clone(),
+            message,
+            encoding,
+            lane: None,
+        };
+        let message = match handler
+            .lanes
+            .begin_queued(&handler.compositor_queue, queued)
+        {
+            Ok(()) => return,
+            Err(queued) => queued.message,
         };
 
-        // Send the response back to the client
-        jdebug!(
-            "Sending response to client {}, {} bytes",
-            client_id,
-            response_data.len()
-        );
-        let transport_lock = self.rpc_handler.transport.lock().unwrap();
-        if let Some(transport) = transport_lock.as_ref() {
-            match transport.send(client_id, &response_data) {
-                Ok(_) => {
-                    jdebug!("Successfully sent response to client {}", client_id);
-                }
-                Err(e) => {
-                    jerror!(
-                        "Failed to send RPC response to client {}: {:?}",
-                        client_id,
-                        e
-                    );
-                }
-            }
-        } else {
-            jwarn!(
-                "No transport available to send response to client {}",
-                client_id
-            );
-        }
+        handler.respond_and_send(client_id, message, encoding);
     }
 
     fn handle_disconnect(&self, client_id: &ClientId) {
@@ -1519,6 +2811,15 @@ impl MessageHandler for RpcMessageHandler {
             .unwrap()
             .remove_client(client_id);
 
+        self.rpc_handler
+            .encodings
+            .lock()
+            .unwrap()
+            .remove(client_id.key());
+        for lane in self.rpc_handler.commit_scheduler.remove_client(client_id) {
+            self.rpc_handler.end_deferred(Some(lane));
+        }
+
         jdebug!("Cleaned up subscriptions for client {}", client_id);
     }
 }
@@ -1526,7 +2827,6 @@ impl MessageHandler for RpcMessageHandler {
 #[cfg(test)]
 mod tests {
     use super::*;
-    use crate::ffi::bindings::ivi_layout_api::IviLayoutApi;
     use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
 
     /// Mock transport for testing
@@ -1534,7 +2834,7 @@ mod tests {
         started: AtomicBool,
         stopped: AtomicBool,
         last_client_id: AtomicU64,
-        last_message: Mutex<Vec<u8>>,
+        last_message: Arc<Mutex<Vec<u8>>>,
         handler: Mutex<Option<Box<dyn MessageHandler>>>,
     }
 
@@ -1544,7 +2844,7 @@ mod tests {
                 started: AtomicBool::new(false),
                 stopped: AtomicBool::new(false),
                 last_client_id: AtomicU64::new(0),
-                last_message: Mutex::new(Vec::new()),
+                last_message: Arc::new(Mutex::new(Vec::new())),
                 handler: Mutex::new(None),
             }
         }
@@ -1574,16 +2874,16 @@ mod tests {
         fn send_to_clients(
             &self,
             client_ids: &[&ClientId],
-            data: &[u8],
+            frame: &SharedFrame,
         ) -> Result<(), TransportError> {
             for &client_id in client_ids {
-                self.send(client_id, data)?;
+                self.send(client_id, frame.payload())?;
             }
             Ok(())
         }
 
-        fn get_connected_clients(&self) -> Vec<ClientId> {
-            vec![ClientId::from_u64(1)]
+        fn for_each_client(&self, f: &mut dyn FnMut(&ClientId)) {
+            f(&ClientId::from_u64(1));
         }
 
         fn register_handler(&mut self, handler: Box<dyn MessageHandler>) {
@@ -1592,14 +2892,90 @@ mod tests {
     }
 
     // Helper to create a mock state manager for testing
-    fn create_mock_state_manager() -> Arc<Mutex<StateManager>> {
+    fn create_mock_state_manager() -> Arc<StateManager> {
         // Create a mock IVI API with a null pointer (safe for testing as we won't call IVI functions)
         let ivi_api = {
             // For testing, we create a dummy API pointer
             // This is safe because our tests don't actually call IVI functions
             Arc::new(IviLayoutApi::from_raw(std::ptr::dangling()).unwrap())
         };
-        Arc::new(Mutex::new(StateManager::new(ivi_api)))
+        Arc::new(StateManager::new(ivi_api))
+    }
+
+    unsafe extern "C" fn fake_commit_changes() -> i32 {
+        crate::ffi::bindings::IVI_SUCCEEDED
+    }
+
+    unsafe extern "C" fn fake_get_surface_from_id(
+        _id: u32,
+    ) -> *mut crate::ffi::bindings::ivi_layout_surface {
+        std::ptr::NonNull::dangling().as_ptr()
+    }
+
+    unsafe extern "C" fn fake_get_layers_under_surface(
+        _surface: *mut crate::ffi::bindings::ivi_layout_surface,
+        length: *mut i32,
+        _array: *mut *mut *mut crate::ffi::bindings::ivi_layout_layer,
+    ) -> i32 {
+        *length = 0;
+        crate::ffi::bindings::IVI_SUCCEEDED
+    }
+
+    /// State manager tracking surface 1000, over an IVI API that finds every
+    /// surface, puts none of them on a layer and accepts every commit
+    fn create_fake_state_manager() -> Arc<StateManager> {
+        create_fake_state_manager_with(|_| {})
+    }
+
+    /// Like [`create_fake_state_manager`], with more of the interface filled in by `setup`
+    fn create_fake_state_manager_with(
+        setup: impl FnOnce(&mut crate::ffi::bindings::ivi_layout_interface),
+    ) -> Arc<StateManager> {
+        // Safety: a zeroed interface has every function unset
+        let mut api: crate::ffi::bindings::ivi_layout_interface = unsafe { std::mem::zeroed() };
+        setup(&mut api);
+        api.commit_changes = Some(fake_commit_changes);
+        api.get_surface_from_id = Some(fake_get_surface_from_id);
+        api.get_layers_under_surface = Some(fake_get_layers_under_surface);
+        let ivi_api = Arc::new(IviLayoutApi::from_raw(Box::leak(Box::new(api))).unwrap());
+
+        let state_manager = Arc::new(StateManager::new(ivi_api));
+        state_manager.add_surface(
+            1000,
+            SurfaceState {
+                id: 1000,
+                orig_size: (640, 480),
+                src_rect: Rectangle::default(),
+                dest_rect: Rectangle::default(),
+                visibility: true,
+                opacity: 1.0,
+                orientation: crate::ffi::bindings::Orientation::Normal,
+                z_order: 0,
+                is_auto_assigned: false,
+                original_id: None,
+            },
+        );
+        state_manager
+    }
+
+    /// Record the z-order changes announced by `state_manager`
+    fn collect_z_order_changes(state_manager: &StateManager) -> Arc<Mutex<Vec<(i32, i32)>>> {
+        use crate::controller::notifications::{NotificationData, NotificationType};
+
+        let changes = Arc::new(Mutex::new(Vec::new()));
+        let changes_clone = Arc::clone(&changes);
+        state_manager.notification_manager().register_callback(
+            NotificationType::ZOrderChanged,
+            Arc::new(move |notification| {
+                if let NotificationData::ZOrderChange(change) = &notification.data {
+                    changes_clone
+                        .lock()
+                        .unwrap()
+                        .push((change.old_z_order, change.new_z_order));
+                }
+            }),
+        );
+        changes
     }
 
     #[test]
@@ -1636,6 +3012,234 @@ mod tests {
         assert!(result.is_ok());
     }
 
+    #[test]
+    fn test_batch_responses_in_order() {
+        let state_manager = create_mock_state_manager();
+        let rpc_handler = RpcHandler::new(state_manager);
+        let client_id = ClientId::from_u64(1);
+
+        // None of these touch the IVI API or ask for a commit
+        let requests = vec![
+            RpcRequest::new(1, "list_surfaces".to_string(), json!({})),
+            RpcRequest::new(2, "no_such_method".to_string(), json!({})),
+            RpcRequest::new(
+                3,
+                "subscribe".to_string(),
+                json!({ "event_types": ["SurfaceCreated"] }),
+            ),
+            RpcRequest::new(4, "list_subscriptions".to_string(), json!({})),
+        ];
+
+        let responses = rpc_handler.handle_batch(&client_id, requests);
+
+        let ids: Vec<u64> = responses.iter().map(|r| r.id).collect();
+        assert_eq!(ids, vec![1, 2, 3, 4]);
+        assert!(responses[0].result.is_some());
+        assert_eq!(responses[1].error.as_ref().unwrap().code, -32601);
+        assert!(responses[2].result.is_some());
+        assert!(responses[3].result.is_some());
+    }
+
+    #[test]
+    fn test_batch_updates_state_after_its_commit() {
+        let state_manager = create_fake_state_manager();
+        let changes = collect_z_order_changes(&state_manager);
+        let rpc_handler = RpcHandler::new(Arc::clone(&state_manager));
+        let client_id = ClientId::from_u64(1);
+
+        let requests = vec![
+            RpcRequest::new(
+                1,
+                "set_surface_z_order".to_string(),
+                json!({ "id": 1000, "z_order": 3, "auto_commit": true }),
+            ),
+            RpcRequest::new(
+                2,
+                "set_surface_z_order".to_string(),
+                json!({ "id": 1000, "z_order": 2001 }),
+            ),
+        ];
+
+        let responses = rpc_handler.handle_batch(&client_id, requests);
+        assert_eq!(responses[0].result.as_ref().unwrap()["committed"], true);
+        assert!(responses[1].error.is_some());
+
+        // The update skipped with the request's own commit follows the batch
+        // commit; the failed request changes nothing
+        assert_eq!(state_manager.get_surface(1000).unwrap().z_order, 3);
+        assert_eq!(*changes.lock().unwrap(), vec![(0, 3)]);
+    }
+
+    #[test]
+    fn test_later_commit_updates_state_of_uncommitted_changes() {
+        let state_manager = create_fake_state_manager();
+        let changes = collect_z_order_changes(&state_manager);
+        let rpc_handler = RpcHandler::new(Arc::clone(&state_manager));
+        let client_id = ClientId::from_u64(1);
+
+        let raise = RpcRequest::new(
+            1,
+            "set_surface_z_order".to_string(),
+            json!({ "id": 1000, "z_order": 3 }),
+        );
+        let result = rpc_handler
+            .handle_request(&client_id, raise)
+            .result
+            .unwrap();
+        assert_eq!(result["committed"], false);
+        assert_eq!(state_manager.get_surface(1000).unwrap().z_order, 0);
+
+        // Whichever request commits next covers the change
+        let commit = RpcRequest::new(2, "commit".to_string(), json!({}));
+        assert!(rpc_handler
+            .handle_request(&client_id, commit)
+            .result
+            .is_some());
+        assert_eq!(state_manager.get_surface(1000).unwrap().z_order, 3);
+        assert_eq!(*changes.lock().unwrap(), vec![(0, 3)]);
+
+        // Its update is made once
+        let commit = RpcRequest::new(3, "commit".to_string(), json!({}));
+        rpc_handler.handle_request(&client_id, commit);
+        assert_eq!(changes.lock().unwrap().len(), 1);
+    }
+
+    #[test]
+    fn test_next_frame_request_waits_for_frame() {
+        let state_manager = create_mock_state_manager();
+        let rpc_handler = RpcHandler::new(state_manager);
+        let client_id = ClientId::from_u64(1);
+        let commit = RpcRequest::new(1, "commit".to_string(), json!({ "commit": "next_frame" }));
+
+        // Without frame signals the request would commit immediately
+        assert!(!rpc_handler.commit_scheduler.is_attached());
+
+        let repaints = Arc::new(AtomicU64::new(0));
+        let repaints_clone = Arc::clone(&repaints);
+        rpc_handler.attach_frame_commits(Arc::new(move || {
+            repaints_clone.fetch_add(1, Ordering::SeqCst);
+        }));
+
+        assert!(rpc_handler
+            .handle_next_frame_request(&client_id, commit, Encoding::Json)
+            .is_none());
+        assert_eq!(rpc_handler.commit_scheduler.waiting_count(), 1);
+        assert_eq!(repaints.load(Ordering::SeqCst), 1);
+
+        // Requests that fail or do not commit are answered right away
+        let invalid = RpcRequest::new(
+            2,
+            "set_surface_opacity".to_string(),
+            json!({ "id": 1000, "opacity": 2.0, "auto_commit": true, "commit": "next_frame" }),
+        );
+        let response = rpc_handler
+            .handle_next_frame_request(&client_id, invalid, Encoding::Json)
+            .unwrap();
+        assert!(response.error.is_some());
+        let list = RpcRequest::new(3, "list_surfaces".to_string(), json!({}));
+        let response = rpc_handler
+            .handle_next_frame_request(&client_id, list, Encoding::Json)
+            .unwrap();
+        assert!(response.result.is_some());
+        assert_eq!(rpc_handler.commit_scheduler.waiting_count(), 1);
+    }
+
+    #[test]
+    fn test_frame_commit_updates_state() {
+        let state_manager = create_fake_state_manager();
+        let changes = collect_z_order_changes(&state_manager);
+        let rpc_handler = RpcHandler::new(Arc::clone(&state_manager));
+        let client_id = ClientId::from_u64(1);
+        rpc_handler.attach_frame_commits(Arc::new(|| {}));
+
+        let raise = RpcRequest::new(
+            1,
+            "set_surface_z_order".to_string(),
+            json!({ "id": 1000, "z_order": 3, "auto_commit": true, "commit": "next_frame" }),
+        );
+        assert!(rpc_handler
+            .handle_next_frame_request(&client_id, raise, Encoding::Json)
+            .is_none());
+        assert_eq!(state_manager.get_surface(1000).unwrap().z_order, 0);
+
+        // The update waits for the frame commit, like the response
+        rpc_handler.on_output_frame();
+        assert_eq!(state_manager.get_surface(1000).unwrap().z_order, 3);
+        assert_eq!(*changes.lock().unwrap(), vec![(0, 3)]);
+    }
+
+    #[test]
+    fn test_animate_surface_request() {
+        let state_manager = create_mock_state_manager();
+        state_manager.add_surface(
+            1000,
+            SurfaceState {
+                id: 1000,
+                orig_size: (640, 480),
+                src_rect: Rectangle::default(),
+                dest_rect: Rectangle::default(),
+                visibility: true,
+                opacity: 1.0,
+                orientation: crate::ffi::bindings::Orientation::Normal,
+                z_order: 0,
+                is_auto_assigned: false,
+                original_id: None,
+            },
+        );
+        let rpc_handler = RpcHandler::new(state_manager);
+        let client_id = ClientId::from_u64(1);
+        let fade = |id| {
+            RpcRequest::new(
+                id,
+                "animate_surface".to_string(),
+                json!({ "id": 1000, "opacity": 0.0, "duration_ms": 200, "easing": "ease_in" }),
+            )
+        };
+
+        // Animations need the frame clock
+        let response = rpc_handler.handle_request(&client_id, fade(1));
+        assert_eq!(response.error.unwrap().code, -32603);
+
+        let repaints = Arc::new(AtomicU64::new(0));
+        let repaints_clone = Arc::clone(&repaints);
+        rpc_handler.attach_frame_commits(Arc::new(move || {
+            repaints_clone.fetch_add(1, Ordering::SeqCst);
+        }));
+
+        let result = rpc_handler
+            .handle_request(&client_id, fade(2))
+            .result
+            .unwrap();
+        assert_eq!(result["animation_id"], 1);
+        assert_eq!(result["easing"], "ease_in");
+        assert_eq!(repaints.load(Ordering::SeqCst), 1);
+
+        // A second fade replaces the first
+        let result = rpc_handler
+            .handle_request(&client_id, fade(3))
+            .result
+            .unwrap();
+        assert_eq!(result["animation_id"], 2);
+        assert_eq!(rpc_handler.animator.running_count(), 1);
+
+        let missing = RpcRequest::new(
+            4,
+            "animate_layer".to_string(),
+            json!({ "id": 10, "opacity": 0.0, "duration_ms": 200 }),
+        );
+        assert!(rpc_handler
+            .handle_request(&client_id, missing)
+            .error
+            .is_some());
+        let bad_easing = RpcRequest::new(
+            5,
+            "animate_surface".to_string(),
+            json!({ "id": 1000, "opacity": 0.0, "duration_ms": 200, "easing": "bounce" }),
+        );
+        let response = rpc_handler.handle_request(&client_id, bad_easing);
+        assert_eq!(response.error.unwrap().code, -32602);
+    }
+
     #[test]
     fn test_message_handler_integration() {
         let state_manager = create_mock_state_manager();
@@ -1655,4 +3259,477 @@ mod tests {
         let transport_lock = rpc_handler.transport.lock().unwrap();
         assert!(transport_lock.is_some());
     }
+
+    #[test]
+    fn test_list_response_cached_until_scene_changes() {
+        let state_manager = create_mock_state_manager();
+        let rpc_handler = RpcHandler::new(Arc::clone(&state_manager));
+        let request = RpcRequest::new(7, "list_layers".to_string(), json!({}));
+        let cached_result = || {
+            rpc_handler.list_cache.layers.lock().unwrap().results[Encoding::Json as usize]
+                .clone()
+                .unwrap()
+        };
+
+        let response = rpc_handler
+            .cached_list_response(&request, Encoding::Json)
+            .unwrap()
+            .unwrap();
+        let expected = RpcResponse::success(7, json!({ "generation": 0, "layers": [] }))
+            .encode(Encoding::Json)
+            .unwrap();
+        assert_eq!(response, expected);
+
+        // An unchanged scene reuses the encoded result
+        let first = cached_result();
+        rpc_handler.cached_list_response(&request, Encoding::Json);
+        assert!(Arc::ptr_eq(&first, &cached_result()));
+
+        // A change to the scene rebuilds it
+        state_manager.add_layer(
+            10,
+            LayerState {
+                id: 10,
+                visibility: true,
+                opacity: 1.0,
+                src_rect: (0, 0, 100, 100),
+                dest_rect: (0, 0, 100, 100),
+                orientation: crate::ffi::bindings::Orientation::Normal,
+            },
+        );
+        let response = rpc_handler
+            .cached_list_response(&request, Encoding::Json)
+            .unwrap()
+            .unwrap();
+        let response: serde_json::Value = serde_json::from_slice(&response).unwrap();
+        assert_eq!(response["result"]["layers"][0]["id"], 10);
+        assert!(!Arc::ptr_eq(&first, &cached_result()));
+
+        // Other methods are not answered from the cache
+        let request = RpcRequest::new(8, "get_layer".to_string(), json!({ "id": 10 }));
+        assert!(rpc_handler
+            .cached_list_response(&request, Encoding::Json)
+            .is_none());
+    }
+
+    #[test]
+    fn test_handshake_switches_encoding() {
+        let state_manager = create_mock_state_manager();
+        let rpc_handler = RpcHandler::new(state_manager);
+        let transport = MockTransport::new();
+        let sent = Arc::clone(&transport.last_message);
+        rpc_handler.register_transport(Box::new(transport)).unwrap();
+
+        let handler = RpcMessageHandler {
+            rpc_handler: Arc::clone(&rpc_handler),
+        };
+        let client_id = ClientId::from_u64(1);
+
+        // The handshake itself is sent and answered in JSON
+        let handshake = RpcRequest::new(
+            1,
+            "handshake".to_string(),
+            json!({ "encodings": ["cbor", "msgpack", "json"] }),
+        );
+        handler.handle_message(&client_id, &handshake.to_json().unwrap());
+        let response = RpcResponse::from_json(&sent.lock().unwrap()).unwrap();
+        assert_eq!(response.result.unwrap()["encoding"], "msgpack");
+        assert_eq!(
+            rpc_handler.client_encoding(&client_id),
+            Encoding::MessagePack
+        );
+
+        // Later requests and responses are MessagePack
+        let request = super::super::msgpack::to_vec(&json!({
+            "id": 2,
+            "method": "list_subscriptions",
+            "params": {}
+        }));
+        handler.handle_message(&client_id, &request);
+        let response = super::super::msgpack::decode(&sent.lock().unwrap()).unwrap();
+        assert_eq!(response["id"], 2);
+        assert!(response["result"]["subscriptions"].is_array());
+
+        // Unsupported encodings are rejected and the encoding is kept
+        let result = rpc_handler.dispatch(
+            &client_id,
+            RpcMethod::Handshake {
+                encodings: vec!["xml".to_string()],
+            },
+        );
+        assert_eq!(result.unwrap_err().code, -32602);
+        assert_eq!(
+            rpc_handler.client_encoding(&client_id),
+            Encoding::MessagePack
+        );
+
+        handler.handle_disconnect(&client_id);
+        assert_eq!(rpc_handler.client_encoding(&client_id), Encoding::Json);
+    }
+
+    #[test]
+    fn test_recording_captures_requests() {
+        let rpc_handler = RpcHandler::new(create_mock_state_manager());
+        rpc_handler
+            .register_transport(Box::new(MockTransport::new()))
+            .unwrap();
+        let path = std::env::temp_dir().join(format!("rpc-handler-{}.ivirec", std::process::id()));
+        rpc_handler.start_recording(&path).unwrap();
+
+        let handler = RpcMessageHandler {
+            rpc_handler: Arc::clone(&rpc_handler),
+        };
+        let client_id = ClientId::from_u64(7);
+        let handshake = RpcRequest::new(
+            1,
+            "handshake".to_string(),
+            json!({ "encodings": ["msgpack"] }),
+        );
+        handler.handle_message(&client_id, &handshake.to_json().unwrap());
+        let request = super::super::msgpack::to_vec(&json!({
+            "id": 2,
+            "method": "list_subscriptions",
+            "params": {}
+        }));
+        handler.handle_message(&client_id, &request);
+        rpc_handler.recorder.get().unwrap().flush().unwrap();
+
+        // Each frame is recorded in the encoding it arrived in
+        let frames: Vec<_> = crate::rpc::RecordReader::open(&path)
+            .unwrap()
+            .collect::<std::io::Result<_>>()
+            .unwrap();
+        assert_eq!(frames.len(), 2);
+        assert!(frames
+            .iter()
+            .all(|f| f.kind == RecordKind::Request && f.client == 7));
+        assert_eq!(frames[0].encoding, Encoding::Json);
+        assert_eq!(frames[1].encoding, Encoding::MessagePack);
+        assert_eq!(
+            frames[1].requests().unwrap()[0].method,
+            "list_subscriptions"
+        );
+
+        std::fs::remove_file(&path).unwrap();
+    }
+
+    #[test]
+    fn test_requests_routed_to_compositor_queue_and_read_pool() {
+        let state_manager = create_mock_state_manager();
+        let rpc_handler = RpcHandler::new(state_manager);
+        let transport = MockTransport::new();
+        let sent = Arc::clone(&transport.last_message);
+        rpc_handler.register_transport(Box::new(transport)).unwrap();
+
+        let wakes = Arc::new(AtomicU64::new(0));
+        let wakes_clone = Arc::clone(&wakes);
+        rpc_handler.attach_event_loop(Arc::new(move || {
+            wakes_clone.fetch_add(1, Ordering::SeqCst);
+        }));
+        rpc_handler.start_read_workers(2).unwrap();
+
+        let handler = RpcMessageHandler {
+            rpc_handler: Arc::clone(&rpc_handler),
+        };
+        let client_id = ClientId::from_u64(1);
+        let last_id = || {
+            let sent = sent.lock().unwrap();
+            (!sent.is_empty()).then(|| RpcResponse::from_json(&sent).unwrap().id)
+        };
+
+        // A subscribe waits for the compositor thread, and so does the read
+        // behind it, which must see the subscription
+        let subscribe = RpcRequest::new(
+            1,
+            "subscribe".to_string(),
+            json!({ "event_types": ["SurfaceCreated"] }),
+        );
+        let read = RpcRequest::new(2, "list_subscriptions".to_string(), json!({}));
+        handler.handle_message(&client_id, &subscribe.to_json().unwrap());
+        handler.handle_message(&client_id, &read.to_json().unwrap());
+        assert_eq!(wakes.load(Ordering::SeqCst), 1);
+        assert_eq!(last_id(), None);
+
+        rpc_handler.run_queued();
+        let response = RpcResponse::from_json(&sent.lock().unwrap()).unwrap();
+        assert_eq!(response.id, 2);
+        assert_eq!(
+            response.result.unwrap()["subscriptions"][0],
+            "SurfaceCreated"
+        );
+        assert_eq!(rpc_handler.lanes.busy_clients(), 0);
+
+        // With nothing queued, reads are answered by the pool
+        let read = RpcRequest::new(3, "list_subscriptions".to_string(), json!({}));
+        handler.handle_message(&client_id, &read.to_json().unwrap());
+        let deadline = std::time::Instant::now() + std::time::Duration::from_secs(5);
+        while last_id() != Some(3) {
+            assert!(std::time::Instant::now() < deadline);
+            thread::sleep(std::time::Duration::from_millis(1));
+        }
+        assert_eq!(wakes.load(Ordering::SeqCst), 1);
+    }
+
+    #[test]
+    fn test_queued_requests_update_state_after_their_commit() {
+        let state_manager = create_fake_state_manager();
+        let changes = collect_z_order_changes(&state_manager);
+        let rpc_handler = RpcHandler::new(Arc::clone(&state_manager));
+        let transport = MockTransport::new();
+        let sent = Arc::clone(&transport.last_message);
+        rpc_handler.register_transport(Box::new(transport)).unwrap();
+        rpc_handler.attach_event_loop(Arc::new(|| {}));
+
+        let handler = RpcMessageHandler {
+            rpc_handler: Arc::clone(&rpc_handler),
+        };
+        let client_id = ClientId::from_u64(1);
+        let raise = RpcRequest::new(
+            1,
+            "set_surface_z_order".to_string(),
+            json!({ "id": 1000, "z_order": 3, "auto_commit": true }),
+        );
+        handler.handle_message(&client_id, &raise.to_json().unwrap());
+        assert_eq!(state_manager.get_surface(1000).unwrap().z_order, 0);
+
+        rpc_handler.run_queued();
+        let response = RpcResponse::from_json(&sent.lock().unwrap()).unwrap();
+        assert_eq!(response.result.unwrap()["committed"], true);
+        assert_eq!(state_manager.get_surface(1000).unwrap().z_order, 3);
+        assert_eq!(*changes.lock().unwrap(), vec![(0, 3)]);
+    }
+
+    #[test]
+    fn test_read_waits_for_next_frame_response() {
+        let state_manager = create_fake_state_manager();
+        let rpc_handler = RpcHandler::new(state_manager);
+        let transport = MockTransport::new();
+        let sent = Arc::clone(&transport.last_message);
+        rpc_handler.register_transport(Box::new(transport)).unwrap();
+        rpc_handler.attach_event_loop(Arc::new(|| {}));
+        rpc_handler.attach_frame_commits(Arc::new(|| {}));
+        rpc_handler.start_read_workers(2).unwrap();
+
+        let handler = RpcMessageHandler {
+            rpc_handler: Arc::clone(&rpc_handler),
+        };
+        let client_id = ClientId::from_u64(1);
+        let last_id = || {
+            let sent = sent.lock().unwrap();
+            (!sent.is_empty()).then(|| RpcResponse::from_json(&sent).unwrap().id)
+        };
+
+        // The read arrives after the next_frame request has been run, and
+        // again after it has been queued but not run yet
+        let raise = |id| {
+            RpcRequest::new(
+                id,
+                "set_surface_z_order".to_string(),
+                json!({ "id": 1000, "z_order": 3, "auto_commit": true, "commit": "next_frame" }),
+            )
+        };
+        let read = |id| RpcRequest::new(id, "list_subscriptions".to_string(), json!({}));
+        handler.handle_message(&client_id, &raise(1).to_json().unwrap());
+        rpc_handler.run_queued();
+        handler.handle_message(&client_id, &read(2).to_json().unwrap());
+        rpc_handler.run_queued();
+        assert_eq!(last_id(), None);
+
+        rpc_handler.on_output_frame();
+        assert_eq!(last_id(), Some(1));
+        rpc_handler.run_queued();
+        assert_eq!(last_id(), Some(2));
+
+        handler.handle_message(&client_id, &raise(3).to_json().unwrap());
+        handler.handle_message(&client_id, &read(4).to_json().unwrap());
+        rpc_handler.run_queued();
+        assert_eq!(last_id(), Some(2));
+
+        rpc_handler.on_output_frame();
+        assert_eq!(last_id(), Some(3));
+        rpc_handler.run_queued();
+        assert_eq!(last_id(), Some(4));
+        assert_eq!(rpc_handler.lanes.busy_clients(), 0);
+    }
+
+    #[test]
+    fn test_disconnect_releases_next_frame_lane() {
+        let state_manager = create_fake_state_manager();
+        let rpc_handler = RpcHandler::new(state_manager);
+        rpc_handler.attach_event_loop(Arc::new(|| {}));
+        rpc_handler.attach_frame_commits(Arc::new(|| {}));
+
+        let handler = RpcMessageHandler {
+            rpc_handler: Arc::clone(&rpc_handler),
+        };
+        let client_id = ClientId::from_u64(1);
+        let raise = RpcRequest::new(
+            1,
+            "set_surface_z_order".to_string(),
+            json!({ "id": 1000, "z_order": 3, "auto_commit": true, "commit": "next_frame" }),
+        );
+        handler.handle_message(&client_id, &raise.to_json().unwrap());
+        rpc_handler.run_queued();
+        assert_eq!(rpc_handler.lanes.busy_clients(), 1);
+
+        handler.handle_disconnect(&client_id);
+        assert_eq!(rpc_handler.lanes.busy_clients(), 0);
+    }
+
+    /// Visibility values set through the fake interface of the rollback test
+    static SCENE_VISIBILITY_CALLS: Mutex<Vec<bool>> = Mutex::new(Vec::new());
+
+    unsafe extern "C" fn fake_get_properties_of_surface(
+        _surface: *mut crate::ffi::bindings::ivi_layout_surface,
+    ) -> *const crate::ffi::bindings::ivi_layout_surface_properties {
+        let mut props: crate::ffi::bindings::ivi_layout_surface_properties = std::mem::zeroed();
+        props.visibility = true;
+        props.opacity = 256;
+        Box::leak(Box::new(props))
+    }
+
+    unsafe extern "C" fn fake_surface_set_visibility(
+        _surface: *mut crate::ffi::bindings::ivi_layout_surface,
+        visible: bool,
+    ) -> i32 {
+        SCENE_VISIBILITY_CALLS.lock().unwrap().push(visible);
+        crate::ffi::bindings::IVI_SUCCEEDED
+    }
+
+    unsafe extern "C" fn fake_failing_surface_set_opacity(
+        _surface: *mut crate::ffi::bindings::ivi_layout_surface,
+        _opacity: crate::ffi::bindings::wl_fixed_t,
+    ) -> i32 {
+        -1
+    }
+
+    #[test]
+    fn test_failed_scene_is_rolled_back() {
+        let state_manager = create_fake_state_manager_with(|api| {
+            api.get_properties_of_surface = Some(fake_get_properties_of_surface);
+            api.surface_set_visibility = Some(fake_surface_set_visibility);
+            api.surface_set_opacity = Some(fake_failing_surface_set_opacity);
+        });
+        let rpc_handler = RpcHandler::new(state_manager);
+        let client_id = ClientId::from_u64(1);
+        let define = RpcRequest::new(
+            1,
+            "define_scene".to_string(),
+            json!({
+                "name": "rear",
+                "surfaces": [{ "id": 1000, "visible": false, "opacity": 0.5 }]
+            }),
+        );
+        assert!(rpc_handler
+            .handle_request(&client_id, define)
+            .result
+            .is_some());
+
+        // The opacity call fails after the visibility was staged
+        let apply = RpcRequest::new(2, "apply_scene".to_string(), json!({ "name": "rear" }));
+        let response = rpc_handler.handle_request(&client_id, apply);
+        assert_eq!(response.error.unwrap().code, -32603);
+
+        // Nothing else was staged, so the visibility is put back to its
+        // committed value
+        assert_eq!(*SCENE_VISIBILITY_CALLS.lock().unwrap(), vec![false, true]);
+        assert!(rpc_handler.uncommitted.lock().unwrap().is_empty());
+    }
+
+    /// Visibility values set through the fake interface of the staged rollback test
+    static STAGED_VISIBILITY_CALLS: Mutex<Vec<bool>> = Mutex::new(Vec::new());
+
+    unsafe extern "C" fn fake_staged_surface_set_visibility(
+        _surface: *mut crate::ffi::bindings::ivi_layout_surface,
+        visible: bool,
+    ) -> i32 {
+        STAGED_VISIBILITY_CALLS.lock().unwrap().push(visible);
+        crate::ffi::bindings::IVI_SUCCEEDED
+    }
+
+    #[test]
+    fn test_failed_scene_keeps_changes_staged_by_others() {
+        let state_manager = create_fake_state_manager_with(|api| {
+            api.get_properties_of_surface = Some(fake_get_properties_of_surface);
+            api.surface_set_visibility = Some(fake_staged_surface_set_visibility);
+            api.surface_set_opacity = Some(fake_failing_surface_set_opacity);
+        });
+        let rpc_handler = RpcHandler::new(state_manager);
+        let client_id = ClientId::from_u64(1);
+        let other = ClientId::from_u64(2);
+        let define = RpcRequest::new(
+            1,
+            "define_scene".to_string(),
+            json!({
+                "name": "rear",
+                "surfaces": [{ "id": 1000, "visible": true, "opacity": 0.5 }]
+            }),
+        );
+        assert!(rpc_handler
+            .handle_request(&client_id, define)
+            .result
+            .is_some());
+
+        // Another client hides the surface without committing yet
+        let hide = RpcRequest::new(
+            2,
+            "set_surface_visibility".to_string(),
+            json!({ "id": 1000, "visible": false }),
+        );
+        assert!(rpc_handler.handle_request(&other, hide).result.is_some());
+
+        let apply = RpcRequest::new(3, "apply_scene".to_string(), json!({ "name": "rear" }));
+        let response = rpc_handler.handle_request(&client_id, apply);
+        assert_eq!(response.error.unwrap().code, -32603);
+
+        // The rollback restores the staged value, not the committed one
+        assert_eq!(
+            *STAGED_VISIBILITY_CALLS.lock().unwrap(),
+            vec![false, true, false]
+        );
+    }
+
+    #[test]
+    fn test_define_scene_request() {
+        let rpc_handler = RpcHandler::new(create_mock_state_manager());
+        let client_id = ClientId::from_u64(1);
+        let define = |id, opacity| {
+            RpcRequest::new(
+                id,
+                "define_scene".to_string(),
+                json!({
+                    "name": "navigation",
+                    "surfaces": [{ "id": 1000, "visible": true, "opacity": opacity }],
+                    "layers": [{ "id": 5000, "surfaces": [1000] }]
+                }),
+            )
+        };
+
+        let result = rpc_handler
+            .handle_request(&client_id, define(1, 1.0))
+            .result
+            .unwrap();
+        assert_eq!(result["operations"], 3);
+        assert_eq!(result["replaced"], false);
+
+        let result = rpc_handler
+            .handle_request(&client_id, define(2, 0.5))
+            .result
+            .unwrap();
+        assert_eq!(result["replaced"], true);
+
+        // Invalid definitions leave the stored scene alone
+        let response = rpc_handler.handle_request(&client_id, define(3, 2.0));
+        assert_eq!(response.error.unwrap().code, -32602);
+        let preset = rpc_handler.scene_presets().get("navigation").unwrap();
+        assert!(preset.ops().contains(&SceneOp::SurfaceOpacity {
+            id: 1000,
+            opacity: 0.5
+        }));
+
+        // Unknown scenes fail before any IVI call
+        let apply = RpcRequest::new(4, "apply_scene".to_string(), json!({ "name": "camera" }));
+        let response = rpc_handler.handle_request(&client_id, apply);
+        assert_eq!(response.error.unwrap().code, -32602);
+    }
 }
@@ -1,13 +1,27 @@
 // RPC module - Remote procedure call interface
 
+pub mod client_slab;
+pub mod commit_scheduler;
+pub mod executor;
 pub mod framing;
 pub mod handler;
+pub mod msgpack;
 pub mod notification_bridge;
 pub mod protocol;
+pub mod recorder;
 pub mod transport;
 
-pub use framing::{write_frame, FrameReadResult, FrameReader, MAX_MESSAGE_SIZE};
-pub use handler::RpcHandler;
+pub use client_slab::{ClientKey, ClientMap, ClientSlab};
+pub use commit_scheduler::{CommitScheduler, RepaintRequest};
+pub use executor::WakeRequest;
+pub use framing::{
+    encode_frame, write_frame, FillStatus, FrameReadResult, FrameReader, SharedFrame,
+    MAX_MESSAGE_SIZE,
+};
+pub use handler::{RpcHandler, SubscribeHook};
 pub use notification_bridge::NotificationBridge;
-pub use protocol::{RpcError, RpcMethod, RpcRequest, RpcResponse};
-pub use transport::{ClientId, MessageHandler, Transport, TransportError};
+pub use protocol::{
+    CommitMode, Encoding, MetricsFormat, RpcError, RpcMethod, RpcRequest, RpcResponse,
+};
+pub use recorder::{RecordKind, RecordReader, RecordedFrame, RpcRecorder};
+pub use transport::{ClientId, MessageHandler, SlowClientPolicy, Transport, TransportError};
@@ -0,0 +1,432 @@
+//! MessagePack encoding of JSON-RPC messages.
+//!
+//! A compact binary alternative to JSON text for the same message model.
+//! Every `serde_json::Value` maps onto a MessagePack value, so handlers keep
+//! producing `Value`s and only the bytes on the wire change. Integers and
+//! floats are written in binary instead of being formatted and re-parsed as
+//! decimal text, and keys and strings need no escaping.
+//!
+//! ## Supported Types
+//!
+//! | JSON    | MessagePack                                 |
+//! |---------|---------------------------------------------|
+//! | null    | nil                                         |
+//! | bool    | true / false                                |
+//! | integer | shortest fixint / int / uint form           |
+//! | float   | float 32 if lossless, else float 64         |
+//! | string  | fixstr / str 8 / str 16 / str 32            |
+//! | array   | fixarray / array 16 / array 32              |
+//! | object  | fixmap / map 16 / map 32 (string keys only) |
+//!
+//! Binary and extension types are rejected when decoding.
+
+use serde_json::{Map, Number, Value};
+use std::fmt;
+
+/// Maximum nesting depth accepted by [`decode`], to bound recursion on
+/// hostile input
+pub const MAX_DEPTH: usize = 128;
+
+/// Error returned when a buffer is not a valid MessagePack value
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct DecodeError(String);
+
+impl fmt::Display for DecodeError {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "Invalid MessagePack data: {}", self.0)
+    }
+}
+
+impl std::error::Error for DecodeError {}
+
+/// Append the MessagePack encoding of `value` to `out`
+pub fn encode(value: &Value, out: &mut Vec<u8>) {
+    match value {
+        Value::Null => out.push(0xc0),
+        Value::Bool(false) => out.push(0xc2),
+        Value::Bool(true) => out.push(0xc3),
+        Value::Number(number) => write_number(out, number),
+        Value::String(s) => write_str(out, s),
+        Value::Array(items) => {
+            write_array_len(out, items.len());
+            for item in items {
+                encode(item, out);
+            }
+        }
+        Value::Object(map) => {
+            write_map_len(out, map.len());
+            for (key, item) in map {
+                write_str(out, key);
+                encode(item, out);
+            }
+        }
+    }
+}
+
+/// Encode `value` into a new buffer
+pub fn to_vec(value: &Value) -> Vec<u8> {
+    let mut out = Vec::new();
+    encode(value, &mut out);
+    out
+}
+
+fn write_number(out: &mut Vec<u8>, number: &Number) {
+    if let Some(n) = number.as_u64() {
+        write_u64(out, n);
+    } else if let Some(n) = number.as_i64() {
+        write_i64(out, n);
+    } else {
+        write_f64(out, number.as_f64().unwrap_or(0.0));
+    }
+}
+
+/// Write an unsigned integer in its shortest form
+pub fn write_u64(out: &mut Vec<u8>, n: u64) {
+    if n < 0x80 {
+        out.push(n as u8);
+    } else if n <= u8::MAX as u64 {
+        out.extend_from_slice(&[0xcc, n as u8]);
+    } else if n <= u16::MAX as u64 {
+        out.push(0xcd);
+        out.extend_from_slice(&(n as u16).to_be_bytes());
+    } else if n <= u32::MAX as u64 {
+        out.push(0xce);
+        out.extend_from_slice(&(n as u32).to_be_bytes());
+    } else {
+        out.push(0xcf);
+        out.extend_from_slice(&n.to_be_bytes());
+    }
+}
+
+/// Write a signed integer in its shortest form
+pub fn write_i64(out: &mut Vec<u8>, n: i64) {
+    if n >= 0 {
+        write_u64(out, n as u64);
+    } else if n >= -32 {
+        out.push(n as i8 as u8);
+    } else if n >= i8::MIN as i64 {
+        out.extend_from_slice(&[0xd0, n as i8 as u8]);
+    } else if n >= i16::MIN as i64 {
+        out.push(0xd1);
+        out.extend_from_slice(&(n as i16).to_be_bytes());
+    } else if n >= i32::MIN as i64 {
+        out.push(0xd2);
+        out.extend_from_slice(&(n as i32).to_be_bytes());
+    } else {
+        out.push(0xd3);
+        out.extend_from_slice(&n.to_be_bytes());
+    }
+}
+
+/// Write a float, using 32 bits when that loses nothing (e.g. opacity values)
+pub fn write_f64(out: &mut Vec<u8>, n: f64) {
+    let narrow = n as f32;
+    if narrow as f64 == n {
+        out.push(0xca);
+        out.extend_from_slice(&narrow.to_be_bytes());
+    } else {
+        out.push(0xcb);
+        out.extend_from_slice(&n.to_be_bytes());
+    }
+}
+
+/// Write a UTF-8 string
+pub fn write_str(out: &mut Vec<u8>, s: &str) {
+    let len = s.len();
+    if len < 32 {
+        out.push(0xa0 | len as u8);
+    } else if len <= u8::MAX as usize {
+        out.extend_from_slice(&[0xd9, len as u8]);
+    } else if len <= u16::MAX as usize {
+        out.push(0xda);
+        out.extend_from_slice(&(len as u16).to_be_bytes());
+    } else {
+        out.push(0xdb);
+        out.extend_from_slice(&(len as u32).to_be_bytes());
+    }
+    out.extend_from_slice(s.as_bytes());
+}
+
+/// Write an array header; `len` values must follow
+pub fn write_array_len(out: &mut Vec<u8>, len: usize) {
+    if len < 16 {
+        out.push(0x90 | len as u8);
+    } else if len <= u16::MAX as usize {
+        out.push(0xdc);
+        out.extend_from_slice(&(len as u16).to_be_bytes());
+    } else {
+        out.push(0xdd);
+        out.extend_from_slice(&(len as u32).to_be_bytes());
+    }
+}
+
+/// Write a map header; `len` key/value pairs must follow
+pub fn write_map_len(out: &mut Vec<u8>, len: usize) {
+    if len < 16 {
+        out.push(0x80 | len as u8);
+    } else if len <= u16::MAX as usize {
+        out.push(0xde);
+        out.extend_from_slice(&(len as u16).to_be_bytes());
+    } else {
+        out.push(0xdf);
+        out.extend_from_slice(&(len as u32).to_be_bytes());
+    }
+}
+
+/// Decode exactly one MessagePack value from `data`
+pub fn decode(data: &[u8]) -> Result<Value, DecodeError> {
+    let mut decoder = Decoder {
+        data,
+        pos: 0,
+        error: None,
+    };
+    let value = decoder.value(0);
+
+    if let Some(error) = decoder.error {
+        return Err(error);
+    }
+
+    if decoder.pos != data.len() {
+        return Err(DecodeError(format!(
+            "{} trailing bytes",
+            data.len() - decoder.pos
+        )));
+    }
+
+    Ok(value)
+}
+
+/// Recursive-descent decoder.
+///
+/// Values are returned directly rather than as `Result<Value, _>`: the first
+/// error is recorded and decoding stops, returning `Null` for the rest.
+/// Unwrapping a `Result` at every level of the tree measurably slows down
+/// decoding of large responses.
+struct Decoder<'a> {
+    data: &'a [u8],
+    pos: usize,
+    error: Option<DecodeError>,
+}
+
+impl<'a> Decoder<'a> {
+    #[cold]
+    fn fail(&mut self, message: &str) -> Value {
+        if self.error.is_none() {
+            self.error = Some(DecodeError(message.to_string()));
+        }
+        // Make every further read fail immediately
+        self.pos = self.data.len();
+        Value::Null
+    }
+
+    fn take(&mut self, len: usize) -> Option<&'a [u8]> {
+        let bytes = self.data.get(self.pos..self.pos.checked_add(len)?)?;
+        self.pos += len;
+        Some(bytes)
+    }
+
+    fn array<const N: usize>(&mut self) -> Option<[u8; N]> {
+        self.take(N).map(|bytes| bytes.try_into().unwrap())
+    }
+
+    fn u8(&mut self) -> Option<u8> {
+        let byte = *self.data.get(self.pos)?;
+        self.pos += 1;
+        Some(byte)
+    }
+
+    fn u16(&mut self) -> Option<u16> {
+        self.array().map(u16::from_be_bytes)
+    }
+
+    fn u32(&mut self) -> Option<u32> {
+        self.array().map(u32::from_be_bytes)
+    }
+
+    fn value(&mut self, depth: usize) -> Value {
+        if depth > MAX_DEPTH {
+            return self.fail("nesting too deep");
+        }
+
+        let Some(marker) = self.u8() else {
+            return self.fail("unexpected end of data");
+        };
+
+        let value = match marker {
+            0x00..=0x7f => Some(Value::from(marker)),
+            0x80..=0x8f => return self.map((marker & 0x0f) as usize, depth),
+            0x90..=0x9f => return self.seq((marker & 0x0f) as usize, depth),
+            0xa0..=0xbf => return self.string((marker & 0x1f) as usize),
+            0xc0 => Some(Value::Null),
+            0xc2 => Some(Value::Bool(false)),
+            0xc3 => Some(Value::Bool(true)),
+            0xca => self.array().map(|b| float(f32::from_be_bytes(b) as f64)),
+            0xcb => self.array().map(|b| float(f64::from_be_bytes(b))),
+            0xcc => self.u8().map(Value::from),
+            0xcd => self.u16().map(Value::from),
+            0xce => self.u32().map(Value::from),
+            0xcf => self.array().map(|b| Value::from(u64::from_be_bytes(b))),
+            0xd0 => self.u8().map(|n| Value::from(n as i8)),
+            0xd1 => self.u16().map(|n| Value::from(n as i16)),
+            0xd2 => self.u32().map(|n| Value::from(n as i32)),
+            0xd3 => self.array().map(|b| Value::from(i64::from_be_bytes(b))),
+            0xd9 => match self.u8() {
+                Some(len) => return self.string(len as usize),
+                None => None,
+            },
+            0xda => match self.u16() {
+                Some(len) => return self.string(len as usize),
+                None => None,
+            },
+            0xdb => match self.u32() {
+                Some(len) => return self.string(len as usize),
+                None => None,
+            },
+            0xdc => match self.u16() {
+                Some(len) => return self.seq(len as usize, depth),
+                None => None,
+            },
+            0xdd => match self.u32() {
+                Some(len) => return self.seq(len as usize, depth),
+                None => None,
+            },
+            0xde => match self.u16() {
+                Some(len) => return self.map(len as usize, depth),
+                None => None,
+            },
+            0xdf => match self.u32() {
+                Some(len) => return self.map(len as usize, depth),
+                None => None,
+            },
+            0xe0..=0xff => Some(Value::from(marker as i8)),
+            _ => {
+                return self.fail(&format!("unsupported type marker 0x{:02x}", marker));
+            }
+        };
+
+        match value {
+            Some(value) => value,
+            None => self.fail("unexpected end of data"),
+        }
+    }
+
+    fn string(&mut self, len: usize) -> Value {
+        let Some(bytes) = self.take(len) else {
+            return self.fail("unexpected end of data");
+        };
+
+        match std::str::from_utf8(bytes) {
+            Ok(s) => Value::String(s.to_string()),
+            Err(e) => self.fail(&e.to_string()),
+        }
+    }
+
+    fn seq(&mut self, len: usize, depth: usize) -> Value {
+        // Every element is at least one byte, so a bogus length cannot
+        // reserve more than the remaining input
+        let mut items = Vec::with_capacity(len.min(self.data.len() - self.pos));
+        for _ in 0..len {
+            items.push(self.value(depth + 1));
+            if self.error.is_some() {
+                break;
+            }
+        }
+        Value::Array(items)
+    }
+
+    fn map(&mut self, len: usize, depth: usize) -> Value {
+        let mut map = Map::new();
+        for _ in 0..len {
+            let key = match self.value(depth + 1) {
+                Value::String(key) => key,
+                _ if self.error.is_some() => break,
+                _ => return self.fail("map key is not a string"),
+            };
+            let item = self.value(depth + 1);
+            if self.error.is_some() {
+                break;
+            }
+            map.insert(key, item);
+        }
+        Value::Object(map)
+    }
+}
+
+/// JSON cannot represent NaN or infinity; they decode as null like in serde_json
+fn float(n: f64) -> Value {
+    Number::from_f64(n)
+        .map(Value::Number)
+        .unwrap_or(Value::Null)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use serde_json::json;
+
+    #[test]
+    fn test_roundtrip() {
+        let value = json!({
+            "id": 42,
+            "result": {
+                "surfaces": [
+                    { "id": 1000, "opacity": 0.5, "visibility": true, "z_order": -3 },
+                    { "id": 4_000_000_000u64, "opacity": 0.1, "visibility": false, "z_order": -70_000 }
+                ],
+                "name": "x".repeat(300),
+                "empty": null
+            }
+        });
+
+        let bytes = to_vec(&value);
+        assert_eq!(decode(&bytes).unwrap(), value);
+
+        // Binary is smaller than JSON text for the same message
+        assert!(bytes.len() < serde_json::to_vec(&value).unwrap().len());
+    }
+
+    #[test]
+    fn test_integer_encodings() {
+        let cases: &[(i64, &[u8])] = &[
+            (0, &[0x00]),
+            (127, &[0x7f]),
+            (128, &[0xcc, 0x80]),
+            (65_535, &[0xcd, 0xff, 0xff]),
+            (-1, &[0xff]),
+            (-32, &[0xe0]),
+            (-33, &[0xd0, 0xdf]),
+            (-129, &[0xd1, 0xff, 0x7f]),
+        ];
+
+        for (n, expected) in cases {
+            let mut out = Vec::new();
+            write_i64(&mut out, *n);
+            assert_eq!(out.as_slice(), *expected, "encoding {}", n);
+            assert_eq!(decode(&out).unwrap(), json!(n));
+        }
+    }
+
+    #[test]
+    fn test_large_collections() {
+        let value = Value::Array((0..20_000).map(Value::from).collect());
+        let bytes = to_vec(&value);
+        assert_eq!(bytes[0], 0xdc);
+        assert_eq!(decode(&bytes).unwrap(), value);
+    }
+
+    #[test]
+    fn test_decode_rejects_invalid_input() {
+        // Truncated string
+        assert!(decode(&[0xa5, b'a']).is_err());
+        // Trailing bytes
+        assert!(decode(&[0xc0, 0xc0]).is_err());
+        // Binary type
+        assert!(decode(&[0xc4, 0x00]).is_err());
+        // Non-string map key
+        assert!(decode(&[0x81, 0x01, 0x02]).is_err());
+        // Array claiming more elements than the input holds
+        assert!(decode(&[0xdd, 0xff, 0xff, 0xff, 0xff]).is_err());
+        // Nesting beyond the limit
+        assert!(decode(&[0x91; MAX_DEPTH + 2]).is_err());
+    }
+}
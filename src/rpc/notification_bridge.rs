@@ -1,5 +1,6 @@
 // Notification bridge - converts internal notifications to RPC format
 
+use crate::controller::animation::AnimationTarget;
 use crate::controller::notifications::{
     FocusChangeNotification, GeometryChangeNotification, LayerOpacityChangeNotification,
     LayerVisibilityChangeNotification, Notification, NotificationData, OpacityChangeNotification,
@@ -7,8 +8,11 @@ use crate::controller::notifications::{
 };
 use crate::controller::subscriptions::SubscriptionManager;
 use crate::rpc::protocol::{EventType, RpcNotification};
+#[allow(unused)]
+use jlogger_tracing::{jdebug, jerror, jinfo, jwarn};
 use serde_json::json;
-use std::sync::{Arc, Mutex};
+use std::sync::{mpsc, Arc, Mutex};
+use std::thread;
 
 /// Bridges internal notifications to RPC client delivery
 pub struct NotificationBridge {
@@ -216,6 +220,24 @@ impl NotificationBridge {
                     "new_opacity": new_opacity
                 }),
             ),
+
+            // Animation events
+            NotificationData::AnimationCompleted {
+                animation_id,
+                target,
+                cancelled,
+            } => {
+                let mut params = json!({
+                    "event_type": "AnimationCompleted",
+                    "animation_id": animation_id,
+                    "cancelled": cancelled
+                });
+                match target {
+                    AnimationTarget::Surface(id) => params["surface_id"] = json!(id),
+                    AnimationTarget::Layer(id) => params["layer_id"] = json!(id),
+                }
+                (EventType::AnimationCompleted, params)
+            }
         };
 
         let rpc_notification = RpcNotification {
@@ -236,6 +258,42 @@ impl NotificationBridge {
             .unwrap()
             .queue_notification(event_type, rpc_notification);
     }
+
+    /// Start a worker thread that handles notifications pushed to the
+    /// returned queue, in order
+    ///
+    /// Callbacks on the compositor thread then only copy the notification;
+    /// the conversion to JSON and the subscription lookup run on the worker.
+    /// The worker exits when every clone of the queue has been dropped.
+    pub fn spawn_worker(self: Arc<Self>) -> std::io::Result<BridgeQueue> {
+        let (sender, receiver) = mpsc::channel::<Notification>();
+
+        thread::Builder::new()
+            .name("ivi-notify-bridge".to_string())
+            .spawn(move || {
+                for notification in receiver {
+                    self.handle_notification(&notification);
+                }
+                jdebug!("Notification bridge worker stopped");
+            })?;
+
+        Ok(BridgeQueue { sender })
+    }
+}
+
+/// Sending side of a notification bridge worker
+#[derive(Clone)]
+pub struct BridgeQueue {
+    sender: mpsc::Sender<Notification>,
+}
+
+impl BridgeQueue {
+    /// Hand a notification to the worker
+    pub fn push(&self, notification: &Notification) {
+        if self.sender.send(notification.clone()).is_err() {
+            jwarn!("Notification bridge worker is gone, dropping notification");
+        }
+    }
 }
 
 #[cfg(test)]
@@ -382,7 +440,43 @@ mod tests {
             .drain_notifications(&client_id);
 
         assert_eq!(notifications.len(), 1);
-        assert_eq!(notifications[0].method, "notification");
+        assert_eq!(notifications[0].notification().method, "notification");
+    }
+
+    #[test]
+    fn test_worker_queues_to_manager() {
+        let subscription_manager = Arc::new(Mutex::new(SubscriptionManager::new()));
+        let bridge = Arc::new(NotificationBridge::new(Arc::clone(&subscription_manager)));
+        let client_id = ClientId::from_u64(1);
+
+        let waiter = {
+            let manager = subscription_manager.lock().unwrap();
+            manager
+                .subscribe(&client_id, vec![EventType::LayerCreated])
+                .unwrap();
+            manager.waiter()
+        };
+
+        let queue = bridge.spawn_worker().unwrap();
+        for layer_id in [10, 20] {
+            queue.push(&Notification {
+                notification_type: NotificationType::LayerCreated,
+                data: NotificationData::LayerCreated { layer_id },
+            });
+        }
+
+        // Collect until both have been queued by the worker
+        let mut layer_ids = Vec::new();
+        while layer_ids.len() < 2 {
+            for (_, notifications) in waiter.wait_and_drain() {
+                layer_ids.extend(
+                    notifications
+                        .iter()
+                        .map(|n| n.notification().params["layer_id"].as_u64().unwrap()),
+                );
+            }
+        }
+        assert_eq!(layer_ids, vec![10, 20]);
     }
 
     #[test]
@@ -396,4 +490,28 @@ mod tests {
         assert_eq!(Orientation::Flipped180.to_string(), "Flipped180");
         assert_eq!(Orientation::Flipped270.to_string(), "Flipped270");
     }
+
+    #[test]
+    fn test_convert_animation_completed() {
+        let subscription_manager = Arc::new(Mutex::new(SubscriptionManager::new()));
+        let bridge = NotificationBridge::new(subscription_manager);
+
+        let notification = Notification {
+            notification_type: NotificationType::AnimationCompleted,
+            data: NotificationData::AnimationCompleted {
+                animation_id: 3,
+                target: AnimationTarget::Layer(10),
+                cancelled: false,
+            },
+        };
+
+        let (event_type, rpc_notification) = bridge.convert_notification(&notification);
+
+        assert_eq!(event_type, EventType::AnimationCompleted);
+        let params = rpc_notification.params.as_object().unwrap();
+        assert_eq!(params.get("animation_id").unwrap().as_u64().unwrap(), 3);
+        assert_eq!(params.get("layer_id").unwrap().as_u64().unwrap(), 10);
+        assert!(!params.contains_key("surface_id"));
+        assert!(!params.get("cancelled").unwrap().as_bool().unwrap());
+    }
 }
@@ -1,7 +1,59 @@
 // RPC protocol definitions
 
+use super::msgpack;
 use serde::{Deserialize, Serialize};
 
+/// Wire encoding of RPC messages on a connection.
+///
+/// Every connection starts out in JSON. A client switches with the
+/// `handshake` method; the handshake response is still sent in the old
+/// encoding and every later frame in either direction uses the new one.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, Default)]
+pub enum Encoding {
+    /// JSON text, the default and the easiest to debug
+    #[default]
+    Json,
+    /// MessagePack, a compact binary form of the same messages
+    MessagePack,
+}
+
+impl Encoding {
+    /// Number of encodings, for per-encoding lookup tables
+    pub const COUNT: usize = 2;
+
+    /// Name used for the encoding in the `handshake` method
+    pub fn name(self) -> &'static str {
+        match self {
+            Encoding::Json => "json",
+            Encoding::MessagePack => "msgpack",
+        }
+    }
+
+    /// Serialize a bare value, such as a request result, in this encoding
+    pub fn encode_value(self, value: &serde_json::Value) -> Result<Vec<u8>, RpcError> {
+        match self {
+            Encoding::Json => serde_json::to_vec(value)
+                .map_err(|e| RpcError::internal_error(format!("Failed to serialize value: {}", e))),
+            Encoding::MessagePack => Ok(msgpack::to_vec(value)),
+        }
+    }
+}
+
+impl std::str::FromStr for Encoding {
+    type Err = String;
+
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        match s {
+            "json" => Ok(Encoding::Json),
+            "msgpack" => Ok(Encoding::MessagePack),
+            _ => Err(format!(
+                "Invalid encoding '{}' (expected 'json' or 'msgpack')",
+                s
+            )),
+        }
+    }
+}
+
 /// Event types for client subscriptions
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, Serialize, Deserialize)]
 pub enum EventType {
@@ -23,6 +75,222 @@ pub enum EventType {
     LayerDestroyed,
     LayerVisibilityChanged,
     LayerOpacityChanged,
+
+    // Animation events
+    AnimationCompleted,
+}
+
+impl EventType {
+    /// Number of event types, for per-type tables and event masks
+    pub const COUNT: usize = 16;
+
+    /// Every event type, in declaration order
+    pub const ALL: [EventType; Self::COUNT] = [
+        EventType::SurfaceCreated,
+        EventType::SurfaceContentReady,
+        EventType::SurfaceContentSizeChanged,
+        EventType::SurfaceDestroyed,
+        EventType::SourceGeometryChanged,
+        EventType::DestinationGeometryChanged,
+        EventType::VisibilityChanged,
+        EventType::OpacityChanged,
+        EventType::OrientationChanged,
+        EventType::ZOrderChanged,
+        EventType::FocusChanged,
+        EventType::LayerCreated,
+        EventType::LayerDestroyed,
+        EventType::LayerVisibilityChanged,
+        EventType::LayerOpacityChanged,
+        EventType::AnimationCompleted,
+    ];
+
+    /// Bit of this event type in a `u32` event mask
+    pub fn bit(self) -> u32 {
+        1 << self as u32
+    }
+
+    /// Event mask with the bits of every type in `event_types`
+    pub fn mask_of(event_types: &[EventType]) -> u32 {
+        event_types
+            .iter()
+            .fold(0, |mask, event_type| mask | event_type.bit())
+    }
+
+    /// Event types whose bits are set in `mask`, in declaration order
+    pub fn from_mask(mask: u32) -> Vec<EventType> {
+        Self::ALL
+            .into_iter()
+            .filter(|event_type| mask & event_type.bit() != 0)
+            .collect()
+    }
+}
+
+/// Rectangle of a scene definition
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Deserialize)]
+#[serde(deny_unknown_fields)]
+pub struct SceneRect {
+    pub x: i32,
+    pub y: i32,
+    pub width: i32,
+    pub height: i32,
+}
+
+/// Properties a scene sets on one surface; unset ones are left alone
+#[derive(Debug, Clone, PartialEq, Deserialize)]
+#[serde(deny_unknown_fields)]
+pub struct SceneSurface {
+    pub id: u32,
+    pub source: Option<SceneRect>,
+    pub destination: Option<SceneRect>,
+    pub visible: Option<bool>,
+    pub opacity: Option<f32>,
+}
+
+/// Properties a scene sets on one layer; unset ones are left alone
+#[derive(Debug, Clone, PartialEq, Deserialize)]
+#[serde(deny_unknown_fields)]
+pub struct SceneLayer {
+    pub id: u32,
+    pub source: Option<SceneRect>,
+    pub destination: Option<SceneRect>,
+    pub visible: Option<bool>,
+    pub opacity: Option<f32>,
+    /// Render order of the layer's surfaces, bottommost first
+    pub surfaces: Option<Vec<u32>>,
+}
+
+/// Render order a scene sets on one screen
+#[derive(Debug, Clone, PartialEq, Deserialize)]
+#[serde(deny_unknown_fields)]
+pub struct SceneScreen {
+    pub name: String,
+    pub layers: Vec<u32>,
+}
+
+/// Scene preset of a `define_scene` request or a preset file
+#[derive(Debug, Clone, Default, PartialEq, Deserialize)]
+pub struct SceneDefinition {
+    #[serde(default)]
+    pub surfaces: Vec<SceneSurface>,
+    #[serde(default)]
+    pub layers: Vec<SceneLayer>,
+    #[serde(default)]
+    pub screens: Vec<SceneScreen>,
+}
+
+/// Surfaces and layers a subscription is limited to
+///
+/// An empty scope means every object.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct SubscriptionScope {
+    pub surface_ids: Vec<u32>,
+    pub layer_ids: Vec<u32>,
+}
+
+impl SubscriptionScope {
+    /// Returns true if the subscription applies to every object
+    pub fn is_global(&self) -> bool {
+        self.surface_ids.is_empty() && self.layer_ids.is_empty()
+    }
+
+    /// Read the optional `surface_ids` and `layer_ids` request parameters
+    fn from_params(params: &serde_json::Value) -> Result<Self, RpcError> {
+        let ids = |field: &str| -> Result<Vec<u32>, RpcError> {
+            match params.get(field) {
+                None => Ok(Vec::new()),
+                Some(value) => serde_json::from_value(value.clone()).map_err(|_| {
+                    RpcError::invalid_params(format!("Invalid '{}' parameter", field))
+                }),
+            }
+        };
+
+        Ok(Self {
+            surface_ids: ids("surface_ids")?,
+            layer_ids: ids("layer_ids")?,
+        })
+    }
+}
+
+/// Longest accepted animation, in milliseconds
+pub const MAX_ANIMATION_DURATION_MS: u64 = 60_000;
+
+/// Target values and timing of an `animate_surface` or `animate_layer` request
+#[derive(Debug, Clone, PartialEq)]
+pub struct AnimationParams {
+    /// Destination rectangle to animate to: (x, y, width, height)
+    pub destination: Option<(i32, i32, i32, i32)>,
+    /// Opacity to animate to
+    pub opacity: Option<f32>,
+    pub duration_ms: u32,
+    /// Name of the easing curve, checked by the handler
+    pub easing: Option<String>,
+}
+
+impl AnimationParams {
+    /// Read the `destination`, `opacity`, `duration_ms` and `easing` parameters
+    fn from_params(params: &serde_json::Value) -> Result<Self, RpcError> {
+        let destination = match params.get("destination") {
+            None => None,
+            Some(value) => {
+                let field = |name: &str| -> Result<i32, RpcError> {
+                    value
+                        .get(name)
+                        .and_then(|v| v.as_i64())
+                        .map(|v| v as i32)
+                        .ok_or_else(|| {
+                            RpcError::invalid_params(format!(
+                                "Missing or invalid 'destination.{}' parameter",
+                                name
+                            ))
+                        })
+                };
+                Some((field("x")?, field("y")?, field("width")?, field("height")?))
+            }
+        };
+
+        let opacity = match params.get("opacity") {
+            None => None,
+            Some(value) => Some(value.as_f64().ok_or_else(|| {
+                RpcError::invalid_params("Invalid 'opacity' parameter".to_string())
+            })? as f32),
+        };
+
+        if destination.is_none() && opacity.is_none() {
+            return Err(RpcError::invalid_params(
+                "Nothing to animate, expected 'destination' or 'opacity'".to_string(),
+            ));
+        }
+
+        let duration_ms = params
+            .get("duration_ms")
+            .and_then(|v| v.as_u64())
+            .filter(|ms| *ms <= MAX_ANIMATION_DURATION_MS)
+            .ok_or_else(|| {
+                RpcError::invalid_params(format!(
+                    "Missing or invalid 'duration_ms' parameter, expected at most {}",
+                    MAX_ANIMATION_DURATION_MS
+                ))
+            })? as u32;
+
+        let easing = match params.get("easing") {
+            None => None,
+            Some(value) => Some(
+                value
+                    .as_str()
+                    .ok_or_else(|| {
+                        RpcError::invalid_params("Invalid 'easing' parameter".to_string())
+                    })?
+                    .to_string(),
+            ),
+        };
+
+        Ok(Self {
+            destination,
+            opacity,
+            duration_ms,
+            easing,
+        })
+    }
 }
 
 /// RPC request structure
@@ -47,6 +315,35 @@ impl RpcRequest {
         })
     }
 
+    /// Build an RPC request from a decoded value
+    ///
+    /// The fields are moved out directly; going through `serde_json::from_value`
+    /// would rebuild the whole `params` tree.
+    pub fn from_value(value: serde_json::Value) -> Result<Self, RpcError> {
+        let parse_error = |message: &str| RpcError {
+            code: -32700, // Parse error
+            message: format!("Failed to parse request: {}", message),
+        };
+
+        let serde_json::Value::Object(mut fields) = value else {
+            return Err(parse_error("expected an object"));
+        };
+
+        let id = fields
+            .get("id")
+            .and_then(|v| v.as_u64())
+            .ok_or_else(|| parse_error("missing or invalid 'id'"))?;
+        let method = match fields.remove("method") {
+            Some(serde_json::Value::String(method)) => method,
+            _ => return Err(parse_error("missing or invalid 'method'")),
+        };
+        let params = fields
+            .remove("params")
+            .ok_or_else(|| parse_error("missing 'params'"))?;
+
+        Ok(Self { id, method, params })
+    }
+
     /// Serialize an RPC request to JSON bytes
     pub fn to_json(&self) -> Result<Vec<u8>, RpcError> {
         serde_json::to_vec(self).map_err(|e| RpcError {
@@ -56,6 +353,50 @@ impl RpcRequest {
     }
 }
 
+/// An incoming RPC message: a single request or a JSON-RPC 2.0 batch array
+#[derive(Debug, Clone, PartialEq)]
+pub enum RpcMessage {
+    Single(RpcRequest),
+    Batch(Vec<RpcRequest>),
+}
+
+impl RpcMessage {
+    /// Parse a single request object or a batch array from JSON bytes
+    pub fn from_json(data: &[u8]) -> Result<Self, RpcError> {
+        let is_batch = data.iter().find(|b| !b.is_ascii_whitespace()) == Some(&b'[');
+        if !is_batch {
+            return RpcRequest::from_json(data).map(RpcMessage::Single);
+        }
+
+        serde_json::from_slice(data)
+            .map(RpcMessage::Batch)
+            .map_err(|e| RpcError {
+                code: -32700, // Parse error
+                message: format!("Failed to parse batch request: {}", e),
+            })
+    }
+
+    /// Parse a single request or a batch array in the given encoding
+    pub fn decode(data: &[u8], encoding: Encoding) -> Result<Self, RpcError> {
+        let value = match encoding {
+            Encoding::Json => return Self::from_json(data),
+            Encoding::MessagePack => msgpack::decode(data).map_err(|e| RpcError {
+                code: -32700, // Parse error
+                message: format!("Failed to parse request: {}", e),
+            })?,
+        };
+
+        match value {
+            serde_json::Value::Array(items) => items
+                .into_iter()
+                .map(RpcRequest::from_value)
+                .collect::<Result<Vec<_>, _>>()
+                .map(RpcMessage::Batch),
+            value => RpcRequest::from_value(value).map(RpcMessage::Single),
+        }
+    }
+}
+
 /// RPC response structure
 #[derive(Debug, Clone, Serialize, Deserialize, PartialEq)]
 pub struct RpcResponse {
@@ -100,6 +441,91 @@ impl RpcResponse {
             message: format!("Failed to serialize response: {}", e),
         })
     }
+
+    /// Serialize the responses to a batch request as one JSON array
+    pub fn batch_to_json(responses: &[RpcResponse]) -> Result<Vec<u8>, RpcError> {
+        serde_json::to_vec(responses).map_err(|e| RpcError {
+            code: -32603, // Internal error
+            message: format!("Failed to serialize batch response: {}", e),
+        })
+    }
+
+    /// Serialize an RPC response in the given encoding
+    pub fn encode(&self, encoding: Encoding) -> Result<Vec<u8>, RpcError> {
+        match encoding {
+            Encoding::Json => self.to_json(),
+            Encoding::MessagePack => {
+                let mut out = Vec::new();
+                self.write_msgpack(&mut out);
+                Ok(out)
+            }
+        }
+    }
+
+    /// Serialize the responses to a batch request as one array in the given encoding
+    pub fn encode_batch(
+        responses: &[RpcResponse],
+        encoding: Encoding,
+    ) -> Result<Vec<u8>, RpcError> {
+        match encoding {
+            Encoding::Json => Self::batch_to_json(responses),
+            Encoding::MessagePack => {
+                let mut out = Vec::new();
+                msgpack::write_array_len(&mut out, responses.len());
+                for response in responses {
+                    response.write_msgpack(&mut out);
+                }
+                Ok(out)
+            }
+        }
+    }
+
+    /// Serialize a successful response around a result that is already encoded
+    ///
+    /// Produces the same bytes as encoding `RpcResponse::success(id, result)`,
+    /// which lets a cached result be reused for any request id.
+    pub fn encode_with_result(id: u64, result: &[u8], encoding: Encoding) -> Vec<u8> {
+        let mut out = Vec::with_capacity(result.len() + 32);
+        match encoding {
+            Encoding::Json => {
+                out.extend_from_slice(b"{\"id\":");
+                out.extend_from_slice(id.to_string().as_bytes());
+                out.extend_from_slice(b",\"result\":");
+                out.extend_from_slice(result);
+                out.push(b'}');
+            }
+            Encoding::MessagePack => {
+                msgpack::write_map_len(&mut out, 2);
+                msgpack::write_str(&mut out, "id");
+                msgpack::write_u64(&mut out, id);
+                msgpack::write_str(&mut out, "result");
+                out.extend_from_slice(result);
+            }
+        }
+        out
+    }
+
+    /// Write the response directly, without building an intermediate value
+    fn write_msgpack(&self, out: &mut Vec<u8>) {
+        let fields = 1 + self.result.is_some() as usize + self.error.is_some() as usize;
+        msgpack::write_map_len(out, fields);
+        msgpack::write_str(out, "id");
+        msgpack::write_u64(out, self.id);
+
+        if let Some(result) = &self.result {
+            msgpack::write_str(out, "result");
+            msgpack::encode(result, out);
+        }
+
+        if let Some(error) = &self.error {
+            msgpack::write_str(out, "error");
+            msgpack::write_map_len(out, 2);
+            msgpack::write_str(out, "code");
+            msgpack::write_i64(out, error.code as i64);
+            msgpack::write_str(out, "message");
+            msgpack::write_str(out, &error.message);
+        }
+    }
 }
 
 /// RPC notification structure (JSON-RPC 2.0 notification - no id field)
@@ -122,6 +548,22 @@ impl RpcNotification {
             message: format!("Failed to serialize notification: {}", e),
         })
     }
+
+    /// Serialize the notification in the given encoding
+    pub fn encode(&self, encoding: Encoding) -> Result<Vec<u8>, RpcError> {
+        match encoding {
+            Encoding::Json => self.to_json(),
+            Encoding::MessagePack => {
+                let mut out = Vec::new();
+                msgpack::write_map_len(&mut out, 2);
+                msgpack::write_str(&mut out, "method");
+                msgpack::write_str(&mut out, &self.method);
+                msgpack::write_str(&mut out, "params");
+                msgpack::encode(&self.params, &mut out);
+                Ok(out)
+            }
+        }
+    }
 }
 
 /// RPC error structure
@@ -145,6 +587,14 @@ impl RpcError {
         Self { code, message }
     }
 
+    /// Create an invalid request error
+    pub fn invalid_request(message: String) -> Self {
+        Self {
+            code: -32600,
+            message,
+        }
+    }
+
     /// Create an invalid parameters error
     pub fn invalid_params(message: String) -> Self {
         Self {
@@ -229,17 +679,39 @@ pub enum RpcMethod {
         id: u32,
         auto_commit: bool,
     },
+    AnimateSurface {
+        id: u32,
+        animation: AnimationParams,
+    },
     Commit,
 
     // Subscription methods
     Subscribe {
         event_types: Vec<EventType>,
+        scope: SubscriptionScope,
+        coalesce: Option<bool>,
     },
     Unsubscribe {
         event_types: Vec<EventType>,
+        scope: SubscriptionScope,
     },
     ListSubscriptions,
 
+    // Connection methods
+    Handshake {
+        encodings: Vec<String>,
+    },
+
+    // Scene methods
+    GetChangesSince {
+        generation: u64,
+    },
+
+    // Diagnostics
+    GetMetrics {
+        format: MetricsFormat,
+    },
+
     // Layer methods
     ListLayers,
     GetLayer {
@@ -300,6 +772,10 @@ pub enum RpcMethod {
     GetLayerSurfaces {
         layer_id: u32,
     },
+    AnimateLayer {
+        id: u32,
+        animation: AnimationParams,
+    },
     // Screen operations
     ListScreens,
     GetScreen {
@@ -321,9 +797,218 @@ pub enum RpcMethod {
         layer_id: u32,
         auto_commit: bool,
     },
+    // Scene presets
+    DefineScene {
+        name: String,
+        definition: SceneDefinition,
+    },
+    ApplyScene {
+        name: String,
+        auto_commit: bool,
+    },
+}
+
+/// Output format of `get_metrics`, from its `format` parameter
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum MetricsFormat {
+    /// Structured JSON result (`"json"`)
+    #[default]
+    Json,
+    /// Prometheus text exposition format (`"prometheus"`)
+    Prometheus,
+}
+
+/// When the changes of a request are committed, from its `commit` parameter
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum CommitMode {
+    /// While handling the request, if it asks for a commit (`"immediate"`)
+    #[default]
+    Immediate,
+    /// With the next output frame, together with all other changes made
+    /// for that frame (`"next_frame"`)
+    NextFrame,
+}
+
+impl CommitMode {
+    /// Read the optional `commit` parameter of a request
+    pub fn from_request(request: &RpcRequest) -> Result<Self, RpcError> {
+        match request.params.get("commit") {
+            None => Ok(CommitMode::Immediate),
+            Some(value) => match value.as_str() {
+                Some("immediate") => Ok(CommitMode::Immediate),
+                Some("next_frame") => Ok(CommitMode::NextFrame),
+                _ => Err(RpcError::invalid_params(
+                    "Invalid 'commit' parameter, expected \"immediate\" or \"next_frame\""
+                        .to_string(),
+                )),
+            },
+        }
+    }
 }
 
 impl RpcMethod {
+    /// Number of RPC methods
+    pub const COUNT: usize = 37;
+
+    /// Wire names of the methods, in `index` order
+    pub const NAMES: [&'static str; Self::COUNT] = [
+        "list_surfaces",
+        "get_surface",
+        "set_surface_source_rectangle",
+        "set_surface_destination_rectangle",
+        "set_surface_visibility",
+        "set_surface_opacity",
+        "set_surface_z_order",
+        "set_surface_focus",
+        "animate_surface",
+        "commit",
+        "subscribe",
+        "unsubscribe",
+        "list_subscriptions",
+        "handshake",
+        "get_changes_since",
+        "get_metrics",
+        "list_layers",
+        "get_layer",
+        "create_layer",
+        "destroy_layer",
+        "set_layer_source_rectangle",
+        "set_layer_destination_rectangle",
+        "set_layer_visibility",
+        "set_layer_opacity",
+        "set_layer_surfaces",
+        "add_surface_to_layer",
+        "remove_surface_from_layer",
+        "get_layer_surfaces",
+        "animate_layer",
+        "list_screens",
+        "get_screen",
+        "get_screen_layers",
+        "get_layer_screens",
+        "add_layers_to_screen",
+        "remove_layer_from_screen",
+        "define_scene",
+        "apply_scene",
+    ];
+
+    /// Dense index of the method, in `0..COUNT`
+    pub fn index(&self) -> usize {
+        match self {
+            RpcMethod::ListSurfaces => 0,
+            RpcMethod::GetSurface { .. } => 1,
+            RpcMethod::SetSurfaceSourceRectangle { .. } => 2,
+            RpcMethod::SetSurfaceDestinationRectangle { .. } => 3,
+            RpcMethod::SetSurfaceVisibility { .. } => 4,
+            RpcMethod::SetSurfaceOpacity { .. } => 5,
+            RpcMethod::SetSurfaceZOrder { .. } => 6,
+            RpcMethod::SetSurfaceFocus { .. } => 7,
+            RpcMethod::AnimateSurface { .. } => 8,
+            RpcMethod::Commit => 9,
+            RpcMethod::Subscribe { .. } => 10,
+            RpcMethod::Unsubscribe { .. } => 11,
+            RpcMethod::ListSubscriptions => 12,
+            RpcMethod::Handshake { .. } => 13,
+            RpcMethod::GetChangesSince { .. } => 14,
+            RpcMethod::GetMetrics { .. } => 15,
+            RpcMethod::ListLayers => 16,
+            RpcMethod::GetLayer { .. } => 17,
+            RpcMethod::CreateLayer { .. } => 18,
+            RpcMethod::DestroyLayer { .. } => 19,
+            RpcMethod::SetLayerSourceRectangle { .. } => 20,
+            RpcMethod::SetLayerDestinationRectangle { .. } => 21,
+            RpcMethod::SetLayerVisibility { .. } => 22,
+            RpcMethod::SetLayerOpacity { .. } => 23,
+            RpcMethod::SetLayerSurfaces { .. } => 24,
+            RpcMethod::AddSurfaceToLayer { .. } => 25,
+            RpcMethod::RemoveSurfaceFromLayer { .. } => 26,
+            RpcMethod::GetLayerSurfaces { .. } => 27,
+            RpcMethod::AnimateLayer { .. } => 28,
+            RpcMethod::ListScreens => 29,
+            RpcMethod::GetScreen { .. } => 30,
+            RpcMethod::GetScreenLayers { .. } => 31,
+            RpcMethod::GetLayerScreens { .. } => 32,
+            RpcMethod::AddLayersToScreen { .. } => 33,
+            RpcMethod::RemoveLayerFromScreen { .. } => 34,
+            RpcMethod::DefineScene { .. } => 35,
+            RpcMethod::ApplyScene { .. } => 36,
+        }
+    }
+
+    /// Wire name of the method
+    pub fn name(&self) -> &'static str {
+        Self::NAMES[self.index()]
+    }
+
+    /// Whether the method only reads the scene snapshot or the subscription
+    /// table, so it can be answered without the IVI layout API
+    pub fn reads_snapshot(name: &str) -> bool {
+        matches!(
+            name,
+            "list_surfaces"
+                | "get_surface"
+                | "list_layers"
+                | "get_layer"
+                | "get_changes_since"
+                | "get_metrics"
+                | "list_subscriptions"
+        )
+    }
+
+    /// Turn off the method's own commit, returning whether it asked for one.
+    ///
+    /// Used for batch requests, which commit once after the last request. An
+    /// explicit `commit` counts as asking for a commit.
+    pub fn defer_commit(&mut self) -> bool {
+        match self {
+            RpcMethod::SetSurfaceSourceRectangle { auto_commit, .. }
+            | RpcMethod::SetSurfaceDestinationRectangle { auto_commit, .. }
+            | RpcMethod::SetSurfaceVisibility { auto_commit, .. }
+            | RpcMethod::SetSurfaceOpacity { auto_commit, .. }
+            | RpcMethod::SetSurfaceZOrder { auto_commit, .. }
+            | RpcMethod::SetSurfaceFocus { auto_commit, .. }
+            | RpcMethod::CreateLayer { auto_commit, .. }
+            | RpcMethod::DestroyLayer { auto_commit, .. }
+            | RpcMethod::SetLayerSourceRectangle { auto_commit, .. }
+            | RpcMethod::SetLayerDestinationRectangle { auto_commit, .. }
+            | RpcMethod::SetLayerVisibility { auto_commit, .. }
+            | RpcMethod::SetLayerOpacity { auto_commit, .. }
+            | RpcMethod::SetLayerSurfaces { auto_commit, .. }
+            | RpcMethod::AddSurfaceToLayer { auto_commit, .. }
+            | RpcMethod::RemoveSurfaceFromLayer { auto_commit, .. }
+            | RpcMethod::AddLayersToScreen { auto_commit, .. }
+            | RpcMethod::RemoveLayerFromScreen { auto_commit, .. }
+            | RpcMethod::ApplyScene { auto_commit, .. } => std::mem::replace(auto_commit, false),
+            RpcMethod::Commit => true,
+            _ => false,
+        }
+    }
+
+    /// Whether the method commits its changes itself when it runs
+    pub fn commits(&self) -> bool {
+        match *self {
+            RpcMethod::SetSurfaceSourceRectangle { auto_commit, .. }
+            | RpcMethod::SetSurfaceDestinationRectangle { auto_commit, .. }
+            | RpcMethod::SetSurfaceVisibility { auto_commit, .. }
+            | RpcMethod::SetSurfaceOpacity { auto_commit, .. }
+            | RpcMethod::SetSurfaceZOrder { auto_commit, .. }
+            | RpcMethod::SetSurfaceFocus { auto_commit, .. }
+            | RpcMethod::CreateLayer { auto_commit, .. }
+            | RpcMethod::DestroyLayer { auto_commit, .. }
+            | RpcMethod::SetLayerSourceRectangle { auto_commit, .. }
+            | RpcMethod::SetLayerDestinationRectangle { auto_commit, .. }
+            | RpcMethod::SetLayerVisibility { auto_commit, .. }
+            | RpcMethod::SetLayerOpacity { auto_commit, .. }
+            | RpcMethod::SetLayerSurfaces { auto_commit, .. }
+            | RpcMethod::AddSurfaceToLayer { auto_commit, .. }
+            | RpcMethod::RemoveSurfaceFromLayer { auto_commit, .. }
+            | RpcMethod::AddLayersToScreen { auto_commit, .. }
+            | RpcMethod::RemoveLayerFromScreen { auto_commit, .. }
+            | RpcMethod::ApplyScene { auto_commit, .. } => auto_commit,
+            RpcMethod::Commit => true,
+            _ => false,
+        }
+    }
+
     /// Parse an RPC method from a request
     pub fn from_request(request: &RpcRequest) -> Result<Self, RpcError> {
         match request.method.as_str() {
@@ -559,6 +1244,20 @@ impl RpcMethod {
                 })
             }
 
+            "animate_surface" => {
+                let id = request
+                    .params
+                    .get("id")
+                    .and_then(|v| v.as_u64())
+                    .ok_or_else(|| {
+                        RpcError::invalid_params("Missing or invalid 'id' parameter".to_string())
+                    })? as u32;
+                Ok(RpcMethod::AnimateSurface {
+                    id,
+                    animation: AnimationParams::from_params(&request.params)?,
+                })
+            }
+
             "commit" => Ok(RpcMethod::Commit),
 
             // Subscription methods
@@ -575,7 +1274,17 @@ impl RpcMethod {
                 .map_err(|_| {
                     RpcError::invalid_params("Invalid 'event_types' parameter".to_string())
                 })?;
-                Ok(RpcMethod::Subscribe { event_types })
+                let coalesce = match request.params.get("coalesce") {
+                    None => None,
+                    Some(value) => Some(value.as_bool().ok_or_else(|| {
+                        RpcError::invalid_params("Invalid 'coalesce' parameter".to_string())
+                    })?),
+                };
+                Ok(RpcMethod::Subscribe {
+                    event_types,
+                    scope: SubscriptionScope::from_params(&request.params)?,
+                    coalesce,
+                })
             }
 
             "unsubscribe" => {
@@ -591,11 +1300,60 @@ impl RpcMethod {
                 .map_err(|_| {
                     RpcError::invalid_params("Invalid 'event_types' parameter".to_string())
                 })?;
-                Ok(RpcMethod::Unsubscribe { event_types })
+                Ok(RpcMethod::Unsubscribe {
+                    event_types,
+                    scope: SubscriptionScope::from_params(&request.params)?,
+                })
             }
 
             "list_subscriptions" => Ok(RpcMethod::ListSubscriptions),
 
+            "handshake" => {
+                let encodings: Vec<String> = serde_json::from_value(
+                    request
+                        .params
+                        .get("encodings")
+                        .ok_or_else(|| {
+                            RpcError::invalid_params("Missing 'encodings' parameter".to_string())
+                        })?
+                        .clone(),
+                )
+                .map_err(|_| {
+                    RpcError::invalid_params("Invalid 'encodings' parameter".to_string())
+                })?;
+                Ok(RpcMethod::Handshake { encodings })
+            }
+
+            "get_changes_since" => {
+                let generation = request
+                    .params
+                    .get("generation")
+                    .and_then(|v| v.as_u64())
+                    .ok_or_else(|| {
+                        RpcError::invalid_params(
+                            "Missing or invalid 'generation' parameter".to_string(),
+                        )
+                    })?;
+                Ok(RpcMethod::GetChangesSince { generation })
+            }
+
+            // Diagnostics
+            "get_metrics" => {
+                let format =
+                    match request.params.get("format") {
+                        None => MetricsFormat::Json,
+                        Some(value) => match value.as_str() {
+                            Some("json") => MetricsFormat::Json,
+                            Some("prometheus") => MetricsFormat::Prometheus,
+                            _ => return Err(RpcError::invalid_params(
+                                "Invalid 'format' parameter, expected \"json\" or \"prometheus\""
+                                    .to_string(),
+                            )),
+                        },
+                    };
+                Ok(RpcMethod::GetMetrics { format })
+            }
+
             // Layer methods
             "list_layers" => Ok(RpcMethod::ListLayers),
 
@@ -937,6 +1695,20 @@ impl RpcMethod {
                 Ok(RpcMethod::GetLayerSurfaces { layer_id })
             }
 
+            "animate_layer" => {
+                let id = request
+                    .params
+                    .get("id")
+                    .and_then(|v| v.as_u64())
+                    .ok_or_else(|| {
+                        RpcError::invalid_params("Missing or invalid 'id' parameter".to_string())
+                    })? as u32;
+                Ok(RpcMethod::AnimateLayer {
+                    id,
+                    animation: AnimationParams::from_params(&request.params)?,
+                })
+            }
+
             // Screen operations
             "list_screens" => Ok(RpcMethod::ListScreens),
 
@@ -1053,7 +1825,312 @@ impl RpcMethod {
                 })
             }
 
+            // Scene presets
+            "define_scene" => {
+                let name = scene_name(&request.params)?;
+                let definition = serde_json::from_value(request.params.clone()).map_err(|e| {
+                    RpcError::invalid_params(format!("Invalid scene definition: {}", e))
+                })?;
+                Ok(RpcMethod::DefineScene { name, definition })
+            }
+
+            "apply_scene" => {
+                let name = scene_name(&request.params)?;
+                // Applying a scene commits unless asked not to
+                let auto_commit = request
+                    .params
+                    .get("auto_commit")
+                    .and_then(|v| v.as_bool())
+                    .unwrap_or(true);
+                Ok(RpcMethod::ApplyScene { name, auto_commit })
+            }
+
             _ => Err(RpcError::method_not_found(request.method.clone())),
         }
     }
 }
+
+/// Read the `name` parameter of a scene request
+fn scene_name(params: &serde_json::Value) -> Result<String, RpcError> {
+    params
+        .get("name")
+        .and_then(|v| v.as_str())
+        .filter(|name| !name.is_empty())
+        .map(str::to_string)
+        .ok_or_else(|| RpcError::invalid_params("Missing or invalid 'name' parameter".to_string()))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use serde_json::json;
+
+    #[test]
+    fn test_animation_parsing() {
+        let request = |params| {
+            RpcMethod::from_request(&RpcRequest::new(1, "animate_surface".to_string(), params))
+        };
+
+        let method = request(json!({
+            "id": 1000,
+            "destination": { "x": 0, "y": 0, "width": 640, "height": 480 },
+            "duration_ms": 300,
+            "easing": "ease_out"
+        }))
+        .unwrap();
+        assert_eq!(
+            method,
+            RpcMethod::AnimateSurface {
+                id: 1000,
+                animation: AnimationParams {
+                    destination: Some((0, 0, 640, 480)),
+                    opacity: None,
+                    duration_ms: 300,
+                    easing: Some("ease_out".to_string()),
+                },
+            }
+        );
+
+        // Something to animate and a bounded duration are required
+        assert!(request(json!({ "id": 1000, "duration_ms": 300 })).is_err());
+        assert!(request(json!({ "id": 1000, "opacity": 0.5 })).is_err());
+        assert!(request(json!({ "id": 1000, "opacity": 0.5, "duration_ms": 600_000 })).is_err());
+        assert!(request(json!({
+            "id": 1000,
+            "destination": { "x": 0, "y": 0, "width": 640 },
+            "duration_ms": 300
+        }))
+        .is_err());
+    }
+
+    #[test]
+    fn test_scene_parsing() {
+        let request = |method: &str, params| {
+            RpcMethod::from_request(&RpcRequest::new(1, method.to_string(), params))
+        };
+
+        let method = request(
+            "define_scene",
+            json!({
+                "name": "reverse_camera",
+                "surfaces": [{ "id": 1000, "visible": true, "opacity": 1.0 }],
+                "layers": [{ "id": 10, "surfaces": [1000] }],
+                "screens": [{ "name": "HDMI-A-1", "layers": [10] }]
+            }),
+        )
+        .unwrap();
+        let RpcMethod::DefineScene { name, definition } = method else {
+            panic!("Expected define_scene");
+        };
+        assert_eq!(name, "reverse_camera");
+        assert_eq!(definition.surfaces[0].visible, Some(true));
+        assert_eq!(definition.surfaces[0].destination, None);
+        assert_eq!(definition.layers[0].surfaces, Some(vec![1000]));
+        assert_eq!(definition.screens[0].layers, vec![10]);
+
+        // Misspelled properties are rejected instead of ignored
+        let err = request(
+            "define_scene",
+            json!({ "name": "nav", "surfaces": [{ "id": 1, "visibel": true }] }),
+        )
+        .unwrap_err();
+        assert_eq!(err.code, -32602);
+        assert!(request("define_scene", json!({ "surfaces": [] })).is_err());
+
+        // Applying commits by default
+        let mut method = request("apply_scene", json!({ "name": "nav" })).unwrap();
+        assert_eq!(
+            method,
+            RpcMethod::ApplyScene {
+                name: "nav".to_string(),
+                auto_commit: true,
+            }
+        );
+        assert!(method.defer_commit());
+    }
+
+    #[test]
+    fn test_method_names_match_index() {
+        // Parameters accepted by every method
+        let params = json!({
+            "id": 1000, "layer_id": 10, "surface_id": 1000, "surface_ids": [1000],
+            "layer_ids": [10], "name": "HDMI-A-1", "screen_name": "HDMI-A-1",
+            "x": 0, "y": 0, "width": 640, "height": 480, "visible": true,
+            "opacity": 0.5, "z_order": 1, "generation": 1,
+            "event_types": ["SurfaceCreated"], "encodings": ["json"], "duration_ms": 100
+        });
+
+        for name in RpcMethod::NAMES {
+            let request = RpcRequest::new(1, name.to_string(), params.clone());
+            let method = RpcMethod::from_request(&request).unwrap();
+            assert_eq!(method.name(), name);
+        }
+    }
+
+    #[test]
+    fn test_metrics_format_parsing() {
+        let request = |params| {
+            RpcMethod::from_request(&RpcRequest::new(1, "get_metrics".to_string(), params))
+        };
+
+        assert_eq!(
+            request(json!({})).unwrap(),
+            RpcMethod::GetMetrics {
+                format: MetricsFormat::Json
+            }
+        );
+        assert_eq!(
+            request(json!({ "format": "prometheus" })).unwrap(),
+            RpcMethod::GetMetrics {
+                format: MetricsFormat::Prometheus
+            }
+        );
+        assert_eq!(
+            request(json!({ "format": "xml" })).unwrap_err().code,
+            -32602
+        );
+    }
+
+    #[test]
+    fn test_commit_mode_parsing() {
+        let request = |params| RpcRequest::new(1, "commit".to_string(), params);
+
+        assert_eq!(
+            CommitMode::from_request(&request(json!({}))).unwrap(),
+            CommitMode::Immediate
+        );
+        assert_eq!(
+            CommitMode::from_request(&request(json!({ "commit": "next_frame" }))).unwrap(),
+            CommitMode::NextFrame
+        );
+        let err = CommitMode::from_request(&request(json!({ "commit": true }))).unwrap_err();
+        assert_eq!(err.code, -32602);
+    }
+
+    #[test]
+    fn test_event_type_bits() {
+        for (index, event_type) in EventType::ALL.into_iter().enumerate() {
+            assert_eq!(event_type as usize, index);
+        }
+
+        let events = vec![EventType::SurfaceCreated, EventType::AnimationCompleted];
+        let mask = EventType::mask_of(&events);
+        assert_eq!(mask, 1 | 1 << (EventType::COUNT - 1));
+        assert_eq!(EventType::from_mask(mask), events);
+    }
+
+    #[test]
+    fn test_message_single_and_batch() {
+        let single = RpcMessage::from_json(br#"{"id":1,"method":"commit","params":{}}"#).unwrap();
+        assert_eq!(
+            single,
+            RpcMessage::Single(RpcRequest::new(1, "commit".to_string(), json!({})))
+        );
+
+        let batch = RpcMessage::from_json(
+            br#" [{"id":1,"method":"list_surfaces","params":{}},
+                  {"id":2,"method":"commit","params":{}}]"#,
+        )
+        .unwrap();
+        match batch {
+            RpcMessage::Batch(requests) => {
+                assert_eq!(requests.len(), 2);
+                assert_eq!(requests[1].method, "commit");
+            }
+            _ => panic!("Expected a batch"),
+        }
+
+        let error = RpcMessage::from_json(b"[1, 2]").unwrap_err();
+        assert_eq!(error.code, -32700);
+    }
+
+    #[test]
+    fn test_defer_commit() {
+        let request = RpcRequest::new(
+            1,
+            "set_surface_visibility".to_string(),
+            json!({ "id": 1000, "visible": true, "auto_commit": true }),
+        );
+        let mut method = RpcMethod::from_request(&request).unwrap();
+        assert!(method.defer_commit());
+        assert_eq!(
+            method,
+            RpcMethod::SetSurfaceVisibility {
+                id: 1000,
+                visible: true,
+                auto_commit: false,
+            }
+        );
+
+        assert!(RpcMethod::Commit.defer_commit());
+        assert!(!RpcMethod::ListSurfaces.defer_commit());
+    }
+
+    #[test]
+    fn test_batch_response_serialization() {
+        let responses = vec![
+            RpcResponse::success(1, json!({ "success": true })),
+            RpcResponse::error(2, RpcError::surface_not_found(7)),
+        ];
+        let data = RpcResponse::batch_to_json(&responses).unwrap();
+        let decoded: Vec<RpcResponse> = serde_json::from_slice(&data).unwrap();
+        assert_eq!(decoded, responses);
+    }
+
+    #[test]
+    fn test_msgpack_encoding_matches_json_model() {
+        // Responses and notifications decode to the same values as their JSON form
+        let responses = vec![
+            RpcResponse::success(1, json!({ "id": 1000, "opacity": 0.5 })),
+            RpcResponse::error(2, RpcError::surface_not_found(7)),
+        ];
+        let data = RpcResponse::encode_batch(&responses, Encoding::MessagePack).unwrap();
+        assert_eq!(
+            msgpack::decode(&data).unwrap(),
+            serde_json::to_value(&responses).unwrap()
+        );
+
+        let notification =
+            RpcNotification::new("notification".to_string(), json!({ "surface_id": 3 }));
+        let data = notification.encode(Encoding::MessagePack).unwrap();
+        assert_eq!(
+            msgpack::decode(&data).unwrap(),
+            serde_json::to_value(&notification).unwrap()
+        );
+
+        // Requests are accepted singly and in batches
+        let request = json!({ "id": 5, "method": "list_layers", "params": {} });
+        let single = RpcMessage::decode(&msgpack::to_vec(&request), Encoding::MessagePack);
+        assert!(matches!(single, Ok(RpcMessage::Single(r)) if r.id == 5));
+
+        let batch = msgpack::to_vec(&json!([request, request]));
+        let batch = RpcMessage::decode(&batch, Encoding::MessagePack);
+        assert!(matches!(batch, Ok(RpcMessage::Batch(r)) if r.len() == 2));
+
+        // JSON text is not valid MessagePack for this model
+        let err = RpcMessage::decode(br#"{"id":1}"#, Encoding::MessagePack).unwrap_err();
+        assert_eq!(err.code, -32700);
+    }
+
+    #[test]
+    fn test_encode_with_result_matches_success() {
+        let result = json!({ "surfaces": [{ "id": 1000, "opacity": 0.5 }] });
+        for encoding in [Encoding::Json, Encoding::MessagePack] {
+            let encoded = encoding.encode_value(&result).unwrap();
+            assert_eq!(
+                RpcResponse::encode_with_result(42, &encoded, encoding),
+                RpcResponse::success(42, result.clone())
+                    .encode(encoding)
+                    .unwrap()
+            );
+        }
+    }
+
+    #[test]
+    fn test_encoding_names() {
+        for encoding in [Encoding::Json, Encoding::MessagePack] {
+            assert_eq!(encoding.name().parse::<Encoding>(), Ok(encoding));
+        }
+        assert!("cbor".parse::<Encoding>().is_err());
+    }
+}
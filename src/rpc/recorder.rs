@@ -0,0 +1,442 @@
+//! Recording of RPC traffic, for replaying a session against another build.
+//!
+//! ## File Format
+//!
+//! An 8-byte header, `IVIREC` and a little-endian `u16` format version, then
+//! one record per frame:
+//!
+//! ```text
+//! [kind u8][encoding u8][client u64][time µs u64][length u32][payload bytes]
+//! ```
+//!
+//! All integers are little-endian. The time counts from the start of the
+//! recording, and the payload is the frame as it crossed the socket, without
+//! its length prefix.
+//!
+//! ## Example
+//!
+//! ```rust,ignore
+//! use weston_ivi_controller::rpc::recorder::{RecordKind, RecordReader};
+//!
+//! for frame in RecordReader::open("session.ivirec")? {
+//!     let frame = frame?;
+//!     if frame.kind == RecordKind::Request {
+//!         for request in frame.requests()? {
+//!             println!("{:?} {} {}", frame.timestamp, request.method, request.params);
+//!         }
+//!     }
+//! }
+//! ```
+
+use super::protocol::{Encoding, RpcError, RpcMessage, RpcRequest};
+use super::transport::ClientId;
+#[allow(unused)]
+use jlogger_tracing::{jdebug, jerror, jinfo, jwarn};
+use std::fs::File;
+use std::hash::{Hash, Hasher};
+use std::io::{self, BufReader, BufWriter, Read, Write};
+use std::path::Path;
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread::{self, JoinHandle};
+use std::time::{Duration, Instant};
+
+/// Start of every recording
+pub const RECORD_MAGIC: &[u8; 6] = b"IVIREC";
+
+/// Version of the record layout
+pub const RECORD_VERSION: u16 = 1;
+
+/// Bytes of a record before its payload
+const RECORD_HEADER_LEN: usize = 22;
+
+/// How often the flusher thread writes out buffered records
+const FLUSH_INTERVAL: Duration = Duration::from_millis(100);
+
+/// Direction of a recorded frame
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum RecordKind {
+    /// A request or batch received from a client
+    Request,
+    /// A notification sent to a client
+    Notification,
+}
+
+impl RecordKind {
+    fn to_u8(self) -> u8 {
+        match self {
+            RecordKind::Request => 0,
+            RecordKind::Notification => 1,
+        }
+    }
+
+    fn from_u8(value: u8) -> Option<Self> {
+        match value {
+            0 => Some(RecordKind::Request),
+            1 => Some(RecordKind::Notification),
+            _ => None,
+        }
+    }
+}
+
+fn encoding_to_u8(encoding: Encoding) -> u8 {
+    match encoding {
+        Encoding::Json => 0,
+        Encoding::MessagePack => 1,
+    }
+}
+
+fn encoding_from_u8(value: u8) -> Option<Encoding> {
+    match value {
+        0 => Some(Encoding::Json),
+        1 => Some(Encoding::MessagePack),
+        _ => None,
+    }
+}
+
+/// Number a client is recorded under
+///
+/// Unix domain clients keep their ID; other clients get a hash of theirs.
+fn client_number(client_id: &ClientId) -> u64 {
+    client_id.unix_domain_id().unwrap_or_else(|| {
+        let mut hasher = std::collections::hash_map::DefaultHasher::new();
+        client_id.hash(&mut hasher);
+        hasher.finish()
+    })
+}
+
+struct RecorderState {
+    writer: BufWriter<File>,
+    /// Records were buffered since the last flush
+    dirty: bool,
+    /// Set after a write error; nothing more is recorded
+    failed: bool,
+    /// Set when the recorder is dropped, to end the flusher thread
+    stopped: bool,
+}
+
+impl RecorderState {
+    /// Write out the buffered records, stopping the recording on error
+    fn flush(&mut self) {
+        if !self.dirty || self.failed {
+            return;
+        }
+        self.dirty = false;
+        if let Err(e) = self.writer.flush() {
+            jwarn!("Failed to write RPC recording, recording stopped: {}", e);
+            self.failed = true;
+        }
+    }
+}
+
+struct Shared {
+    state: Mutex<RecorderState>,
+    /// Signalled when the recorder is dropped
+    stop: Condvar,
+}
+
+/// Appends received requests and sent notifications to a recording file
+///
+/// Records are buffered, and a flusher thread writes them out every 100 ms,
+/// so a recording never lags far behind even when traffic stops. Dropping
+/// the recorder writes out the rest. After a write error the recorder logs a
+/// warning once and stops recording.
+pub struct RpcRecorder {
+    shared: Arc<Shared>,
+    start: Instant,
+    flusher: Option<JoinHandle<()>>,
+}
+
+impl RpcRecorder {
+    /// Create (or truncate) the recording at `path` and write its header
+    pub fn create(path: &Path) -> io::Result<Self> {
+        let mut writer = BufWriter::new(File::create(path)?);
+        writer.write_all(RECORD_MAGIC)?;
+        writer.write_all(&RECORD_VERSION.to_le_bytes())?;
+        writer.flush()?;
+
+        let shared = Arc::new(Shared {
+            state: Mutex::new(RecorderState {
+                writer,
+                dirty: false,
+                failed: false,
+                stopped: false,
+            }),
+            stop: Condvar::new(),
+        });
+        let flusher = {
+            let shared = Arc::clone(&shared);
+            thread::Builder::new()
+                .name("ivi-rpc-recorder".to_string())
+                .spawn(move || Self::run_flusher(&shared))?
+        };
+
+        Ok(Self {
+            shared,
+            start: Instant::now(),
+            flusher: Some(flusher),
+        })
+    }
+
+    fn run_flusher(shared: &Shared) {
+        let mut state = shared.state.lock().unwrap();
+        while !state.stopped {
+            state.flush();
+            state = shared.stop.wait_timeout(state, FLUSH_INTERVAL).unwrap().0;
+        }
+    }
+
+    /// Append one frame
+    pub fn record(
+        &self,
+        kind: RecordKind,
+        client_id: &ClientId,
+        encoding: Encoding,
+        payload: &[u8],
+    ) {
+        let timestamp = self.start.elapsed().as_micros() as u64;
+        let mut header = [0u8; RECORD_HEADER_LEN];
+        header[0] = kind.to_u8();
+        header[1] = encoding_to_u8(encoding);
+        header[2..10].copy_from_slice(&client_number(client_id).to_le_bytes());
+        header[10..18].copy_from_slice(&timestamp.to_le_bytes());
+        header[18..22].copy_from_slice(&(payload.len() as u32).to_le_bytes());
+
+        let mut state = self.shared.state.lock().unwrap();
+        if state.failed {
+            return;
+        }
+
+        let result = state
+            .writer
+            .write_all(&header)
+            .and_then(|_| state.writer.write_all(payload));
+        state.dirty = true;
+
+        if let Err(e) = result {
+            jwarn!("Failed to write RPC recording, recording stopped: {}", e);
+            state.failed = true;
+        }
+    }
+
+    /// Write out the buffered records now
+    pub fn flush(&self) -> io::Result<()> {
+        let mut state = self.shared.state.lock().unwrap();
+        state.dirty = false;
+        state.writer.flush()
+    }
+}
+
+impl Drop for RpcRecorder {
+    fn drop(&mut self) {
+        {
+            let mut state = self.shared.state.lock().unwrap();
+            state.stopped = true;
+            state.flush();
+        }
+        self.shared.stop.notify_all();
+        if let Some(flusher) = self.flusher.take() {
+            let _ = flusher.join();
+        }
+    }
+}
+
+/// One frame read back from a recording
+#[derive(Debug, Clone, PartialEq)]
+pub struct RecordedFrame {
+    pub kind: RecordKind,
+    pub encoding: Encoding,
+    /// Client the frame came from or went to
+    pub client: u64,
+    /// Time since the start of the recording
+    pub timestamp: Duration,
+    pub payload: Vec<u8>,
+}
+
+impl RecordedFrame {
+    /// Requests of a [`RecordKind::Request`] frame, batches flattened
+    pub fn requests(&self) -> Result<Vec<RpcRequest>, RpcError> {
+        match RpcMessage::decode(&self.payload, self.encoding)? {
+            RpcMessage::Single(request) => Ok(vec![request]),
+            RpcMessage::Batch(requests) => Ok(requests),
+        }
+    }
+}
+
+/// Reads the frames of a recording in the order they were recorded
+pub struct RecordReader<R: Read> {
+    reader: R,
+}
+
+impl RecordReader<BufReader<File>> {
+    pub fn open<P: AsRef<Path>>(path: P) -> io::Result<Self> {
+        Self::new(BufReader::new(File::open(path)?))
+    }
+}
+
+impl<R: Read> RecordReader<R> {
+    /// Check the header of a recording and read its frames from `reader`
+    pub fn new(mut reader: R) -> io::Result<Self> {
+        let mut header = [0u8; 8];
+        reader.read_exact(&mut header)?;
+        if &header[..6] != RECORD_MAGIC {
+            return Err(invalid_data("Not an RPC recording"));
+        }
+
+        let version = u16::from_le_bytes([header[6], header[7]]);
+        if version != RECORD_VERSION {
+            return Err(invalid_data(format!(
+                "Unsupported recording version {}",
+                version
+            )));
+        }
+
+        Ok(Self { reader })
+    }
+
+    /// Next frame, or `None` at the end of the recording
+    pub fn read_frame(&mut self) -> io::Result<Option<RecordedFrame>> {
+        let mut header = [0u8; RECORD_HEADER_LEN];
+        match self.reader.read_exact(&mut header[..1]) {
+            Ok(()) => {}
+            Err(e) if e.kind() == io::ErrorKind::UnexpectedEof => return Ok(None),
+            Err(e) => return Err(e),
+        }
+        self.reader.read_exact(&mut header[1..])?;
+
+        let kind = RecordKind::from_u8(header[0])
+            .ok_or_else(|| invalid_data(format!("Unknown record kind {}", header[0])))?;
+        let encoding = encoding_from_u8(header[1])
+            .ok_or_else(|| invalid_data(format!("Unknown record encoding {}", header[1])))?;
+        let client = u64::from_le_bytes(header[2..10].try_into().unwrap());
+        let timestamp = u64::from_le_bytes(header[10..18].try_into().unwrap());
+        let len = u32::from_le_bytes(header[18..22].try_into().unwrap());
+
+        if len > super::framing::MAX_MESSAGE_SIZE {
+            return Err(invalid_data(format!("Record too large: {} bytes", len)));
+        }
+        let mut payload = vec![0u8; len as usize];
+        self.reader.read_exact(&mut payload)?;
+
+        Ok(Some(RecordedFrame {
+            kind,
+            encoding,
+            client,
+            timestamp: Duration::from_micros(timestamp),
+            payload,
+        }))
+    }
+}
+
+impl<R: Read> Iterator for RecordReader<R> {
+    type Item = io::Result<RecordedFrame>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        self.read_frame().transpose()
+    }
+}
+
+fn invalid_data<E: Into<Box<dyn std::error::Error + Send + Sync>>>(error: E) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, error)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::rpc::msgpack;
+    use serde_json::json;
+
+    #[test]
+    fn test_recording_round_trip() {
+        let path = std::env::temp_dir().join(format!("rpc-recorder-{}.ivirec", std::process::id()));
+        let recorder = RpcRecorder::create(&path).unwrap();
+
+        let request = br#"{"id":1,"method":"list_surfaces","params":{}}"#;
+        let batch = msgpack::to_vec(&json!([
+            { "id": 2, "method": "set_surface_visibility", "params": { "id": 1000, "visible": true } },
+            { "id": 3, "method": "commit", "params": {} }
+        ]));
+        let notification = br#"{"method":"notification","params":{}}"#;
+
+        recorder.record(
+            RecordKind::Request,
+            &ClientId::from_u64(1),
+            Encoding::Json,
+            request,
+        );
+        recorder.record(
+            RecordKind::Request,
+            &ClientId::from_u64(2),
+            Encoding::MessagePack,
+            &batch,
+        );
+        recorder.record(
+            RecordKind::Notification,
+            &ClientId::from_u64(1),
+            Encoding::Json,
+            notification,
+        );
+        recorder.flush().unwrap();
+
+        let frames: Vec<RecordedFrame> = RecordReader::open(&path)
+            .unwrap()
+            .collect::<io::Result<_>>()
+            .unwrap();
+        assert_eq!(frames.len(), 3);
+        assert_eq!(frames[0].kind, RecordKind::Request);
+        assert_eq!(frames[0].client, 1);
+        assert_eq!(frames[0].payload, request);
+        assert_eq!(frames[1].encoding, Encoding::MessagePack);
+        assert_eq!(frames[2].kind, RecordKind::Notification);
+        assert!(frames[0].timestamp <= frames[2].timestamp);
+
+        let requests = frames[1].requests().unwrap();
+        let methods: Vec<&str> = requests.iter().map(|r| r.method.as_str()).collect();
+        assert_eq!(methods, vec!["set_surface_visibility", "commit"]);
+        assert_eq!(requests[0].params["id"], 1000);
+
+        // Anything else is rejected up front
+        assert!(RecordReader::new(&b"not a recording"[..]).is_err());
+
+        std::fs::remove_file(&path).unwrap();
+    }
+
+    #[test]
+    fn test_recording_written_out_without_flush() {
+        let path =
+            std::env::temp_dir().join(format!("rpc-recorder-tail-{}.ivirec", std::process::id()));
+        let read_back = || {
+            RecordReader::open(&path)
+                .unwrap()
+                .collect::<io::Result<Vec<_>>>()
+                .unwrap()
+        };
+        let recorder = RpcRecorder::create(&path).unwrap();
+        let request = br#"{"id":1,"method":"commit","params":{}}"#;
+
+        // The last record reaches the file although nothing follows it
+        recorder.record(
+            RecordKind::Request,
+            &ClientId::from_u64(1),
+            Encoding::Json,
+            request,
+        );
+        let deadline = Instant::now() + Duration::from_secs(5);
+        while read_back().is_empty() {
+            assert!(Instant::now() < deadline, "record was never written out");
+            thread::sleep(Duration::from_millis(10));
+        }
+        assert_eq!(read_back()[0].payload, request);
+
+        // Dropping the recorder writes out the rest
+        recorder.record(
+            RecordKind::Request,
+            &ClientId::from_u64(2),
+            Encoding::Json,
+            request,
+        );
+        drop(recorder);
+        assert_eq!(read_back().len(), 2);
+
+        std::fs::remove_file(&path).unwrap();
+    }
+}
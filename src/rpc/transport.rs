@@ -1,27 +1,41 @@
 // Transport abstraction layer
 
+use super::client_slab::ClientKey;
+use super::framing::SharedFrame;
 use thiserror::Error;
 
 /// Client identifier for different transport types
 ///
 /// This enum represents client IDs across different transport mechanisms.
-/// The variant used depends on which transport feature is enabled.
+/// The variant used depends on which transport feature is enabled. Every
+/// client carries the key its transport's `ClientSlab` interned it under,
+/// which the layers above use to index their per-client state.
 ///
 /// # Variants
 ///
 /// - `UnixDomainId`: Numeric ID for Unix domain socket clients (default)
-/// - `IpconId`: String-based peer name for IPCON clients (requires `enable-ipcon` feature)
+/// - `IpconId`: Key and peer name for IPCON clients (requires `enable-ipcon` feature)
 #[derive(Debug, Clone, PartialEq, Eq, Hash)]
 pub enum ClientId {
     /// Unix domain socket client ID (numeric)
     UnixDomainId(u64),
 
-    /// IPCON peer name (string-based, requires `enable-ipcon` feature)
+    /// IPCON peer key and name (requires `enable-ipcon` feature)
     #[cfg(feature = "enable-ipcon")]
-    IpconId(String),
+    IpconId(ClientKey, String),
 }
 
 impl ClientId {
+    /// Key of the client in its transport's slab
+    pub fn key(&self) -> ClientKey {
+        match self {
+            ClientId::UnixDomainId(id) => ClientKey::from_u64(*id),
+
+            #[cfg(feature = "enable-ipcon")]
+            ClientId::IpconId(key, _) => *key,
+        }
+    }
+
     /// Extract the Unix domain socket ID if this is a `UnixDomainId` variant
     ///
     /// Returns `None` for other variants.
@@ -41,7 +55,7 @@ impl ClientId {
     #[cfg(feature = "enable-ipcon")]
     pub fn ipcon_id(&self) -> Option<&str> {
         match self {
-            ClientId::IpconId(id) => Some(id),
+            ClientId::IpconId(_, peer) => Some(peer),
             _ => None,
         }
     }
@@ -51,23 +65,12 @@ impl ClientId {
         ClientId::UnixDomainId(id)
     }
 
-    /// Create a `ClientId` from a String (IPCON peer name)
+    /// Create a `ClientId` for an IPCON peer interned under `key`
     ///
     /// Only available when the `enable-ipcon` feature is enabled.
     #[cfg(feature = "enable-ipcon")]
-    pub fn from_string(id: String) -> Self {
-        ClientId::IpconId(id)
-    }
-}
-
-#[cfg(feature = "enable-ipcon")]
-impl std::str::FromStr for ClientId {
-    type Err = TransportError;
-
-    fn from_str(s: &str) -> Result<Self, Self::Err> {
-        {
-            Ok(ClientId::IpconId(s.to_string()))
-        }
+    pub fn from_ipcon_peer(key: ClientKey, peer: String) -> Self {
+        ClientId::IpconId(key, peer)
     }
 }
 
@@ -76,7 +79,7 @@ impl std::fmt::Display for ClientId {
         match self {
             ClientId::UnixDomainId(id) => write!(f, "UnixDomainId({})", id),
             #[cfg(feature = "enable-ipcon")]
-            ClientId::IpconId(id) => write!(f, "IpconId({})", id),
+            ClientId::IpconId(_, peer) => write!(f, "IpconId({})", peer),
         }
     }
 }
@@ -97,6 +100,38 @@ pub enum TransportError {
     InitError(String),
 }
 
+/// Default limit on bytes queued for a single client
+pub const DEFAULT_MAX_PENDING_BYTES: usize = 4 * 1024 * 1024;
+
+/// What a transport does with a client whose outbound queue is over its limit
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum SlowClientPolicy {
+    /// Discard new notifications for the client until its queue drains
+    ///
+    /// Responses are still queued, up to twice the limit; a client that keeps
+    /// requesting without reading past that is disconnected.
+    DropFrames,
+
+    /// Close the connection; the client can reconnect and resynchronize
+    #[default]
+    Disconnect,
+}
+
+impl std::str::FromStr for SlowClientPolicy {
+    type Err = String;
+
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        match s {
+            "drop" => Ok(SlowClientPolicy::DropFrames),
+            "disconnect" => Ok(SlowClientPolicy::Disconnect),
+            _ => Err(format!(
+                "Invalid slow client policy '{}' (expected 'drop' or 'disconnect')",
+                s
+            )),
+        }
+    }
+}
+
 /// Transport trait for pluggable communication mechanisms
 ///
 /// This trait defines the interface for different IPC transport implementations.
@@ -121,24 +156,60 @@ pub trait Transport: Send + Sync {
 
     /// Send data to a specific client
     ///
+    /// Used for responses, which a slow-client policy must never drop.
+    ///
     /// # Arguments
     ///
     /// * `client_id` - The target client identifier
     /// * `data` - The raw bytes to send (should be a complete framed message)
     fn send(&self, client_id: &ClientId, data: &[u8]) -> Result<(), TransportError>;
 
-    /// Send data to multiple clients (typically for event notifications)
+    /// Send several pre-encoded frames to a specific client in order
+    ///
+    /// # Arguments
+    ///
+    /// * `client_id` - The target client identifier
+    /// * `frames` - Shared frames, typically queued notifications
+    ///
+    /// Frames sent this way are notifications, which
+    /// [`SlowClientPolicy::DropFrames`] may discard. The default
+    /// implementation calls `send` with each frame's payload.
+    /// Stream transports should override this to write the frames as-is and
+    /// take their internal lock once.
+    fn send_batch(
+        &self,
+        client_id: &ClientId,
+        frames: &[SharedFrame],
+    ) -> Result<(), TransportError> {
+        for frame in frames {
+            self.send(client_id, frame.payload())?;
+        }
+        Ok(())
+    }
+
+    /// Send one pre-encoded frame to multiple clients (typically for event notifications)
     ///
     /// # Arguments
     ///
     /// * `client_ids` - List of target client identifiers
-    /// * `data` - The raw bytes to send (same data to all clients)
+    /// * `frame` - The shared frame to send (same bytes to all clients)
     ///
     /// Implementations may use multicast or unicast depending on the transport.
-    fn send_to_clients(&self, client_ids: &[&ClientId], data: &[u8]) -> Result<(), TransportError>;
-
-    /// Get a list of all currently connected client IDs
-    fn get_connected_clients(&self) -> Vec<ClientId>;
+    fn send_to_clients(
+        &self,
+        client_ids: &[&ClientId],
+        frame: &SharedFrame,
+    ) -> Result<(), TransportError>;
+
+    /// Call `f` with each currently connected client
+    fn for_each_client(&self, f: &mut dyn FnMut(&ClientId));
+
+    /// Number of currently connected clients
+    fn client_count(&self) -> usize {
+        let mut count = 0;
+        self.for_each_client(&mut |_| count += 1);
+        count
+    }
 
     /// Register a message handler for processing incoming messages
     ///
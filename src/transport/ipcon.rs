@@ -13,10 +13,14 @@ use ipcon_sys::{
 };
 #[allow(unused)]
 use jlogger_tracing::{jdebug, jerror, jinfo, jwarn, JloggerBuilder, LevelFilter};
+use std::collections::HashMap;
+use std::sync::atomic::AtomicBool;
 use std::sync::{Arc, Mutex};
 use std::thread::{self, JoinHandle};
-use std::{str::FromStr, sync::atomic::AtomicBool};
 
+use crate::metrics::metrics;
+use crate::rpc::client_slab::{ClientKey, ClientSlab};
+use crate::rpc::framing::SharedFrame;
 use crate::rpc::transport::{ClientId, MessageHandler, Transport, TransportError};
 
 /// IPCON transport implementation
@@ -38,12 +42,42 @@ use crate::rpc::transport::{ClientId, MessageHandler, Transport, TransportError}
 /// ```
 pub struct IpconTransport {
     ih: Arc<Mutex<Ipcon>>,
-    clients: Arc<Mutex<Vec<ClientId>>>,
+    clients: Arc<Mutex<IpconClients>>,
     handler: Option<Arc<dyn MessageHandler>>,
     worker_thread: Option<JoinHandle<Result<(), TransportError>>>,
     running: Arc<AtomicBool>,
 }
 
+/// Peers seen by the transport, interned in a slab like Unix socket clients
+#[derive(Default)]
+struct IpconClients {
+    slab: ClientSlab<String>,
+    peers: HashMap<String, ClientKey>,
+}
+
+impl IpconClients {
+    /// Identity of `peer`, interning it on its first message
+    fn connect(&mut self, peer: &str) -> ClientId {
+        let key = match self.peers.get(peer) {
+            Some(key) => *key,
+            None => {
+                jinfo!("IPCON client connected: {}", peer);
+                let key = self.slab.insert(peer.to_string());
+                self.peers.insert(peer.to_string(), key);
+                key
+            }
+        };
+        ClientId::from_ipcon_peer(key, peer.to_string())
+    }
+
+    /// Forget `peer`, returning its identity if it was connected
+    fn disconnect(&mut self, peer: &str) -> Option<ClientId> {
+        let key = self.peers.remove(peer)?;
+        let peer = self.slab.remove(key)?;
+        Some(ClientId::from_ipcon_peer(key, peer))
+    }
+}
+
 fn dump_ipcon_msg(msg: &IpconMsg) -> String {
     match msg {
         IpconMsg::IpconMsgUser(data) => {
@@ -102,7 +136,7 @@ impl IpconTransport {
 
         Ok(Self {
             ih: Arc::new(Mutex::new(ih)),
-            clients: Arc::new(Mutex::new(Vec::new())),
+            clients: Arc::new(Mutex::new(IpconClients::default())),
             handler: None,
             worker_thread: None,
             running: Arc::new(AtomicBool::new(false)),
@@ -113,7 +147,7 @@ impl IpconTransport {
     fn event_loop(
         ih: Arc<Mutex<Ipcon>>,
         handler: Arc<dyn MessageHandler>,
-        clients: Arc<Mutex<Vec<ClientId>>>,
+        clients: Arc<Mutex<IpconClients>>,
         should_run: Arc<AtomicBool>,
     ) -> Result<(), TransportError> {
         jinfo!("IPCON transport event loop started");
@@ -159,17 +193,10 @@ impl IpconTransport {
                 IpconMsg::IpconMsgUser(data) => {
                     // Ipcon is a message-based protocol, so each message is complete
                     if data.msg_type == IpconMsgType::IpconMsgTypeNormal {
-                        let client_id = ClientId::from_str(&data.peer)?;
+                        // Add client to connected clients if not already present
+                        let client_id = clients.lock().unwrap().connect(&data.peer);
+                        metrics().frame_received(data.buf.len());
                         handler.handle_message(&client_id, &data.buf);
-
-                        {
-                            // Add client to connected clients list if not already present
-                            let mut clients_lock = clients.lock().unwrap();
-                            if !clients_lock.contains(&client_id) {
-                                jinfo!("IPCON client connected: {}", data.peer);
-                                clients_lock.push(client_id);
-                            }
-                        }
                     }
                 }
 
@@ -177,12 +204,11 @@ impl IpconTransport {
                     // Client is removed
                     if let Some(peer) = kevent.peer_removed() {
                         jinfo!("IPCON group removed: {}", peer);
-                        handler.handle_disconnect(&ClientId::from_str(&peer)?);
 
-                        {
-                            // Remove client from connected clients list
-                            let mut clients_lock = clients.lock().unwrap();
-                            clients_lock.retain(|c| c.ipcon_id().unwrap() != peer);
+                        // Peers that never sent a message have no state to clean up
+                        let client_id = clients.lock().unwrap().disconnect(&peer);
+                        if let Some(client_id) = client_id {
+                            handler.handle_disconnect(&client_id);
                         }
                     }
                 }
@@ -247,20 +273,26 @@ impl Transport for IpconTransport {
     fn send_to_clients(
         &self,
         _client_ids: &[&ClientId],
-        data: &[u8],
+        frame: &SharedFrame,
     ) -> Result<(), TransportError> {
-        // We use multicast for notifications
+        // We use multicast for notifications; IPCON messages carry their own length
         let ih = self.ih.lock().unwrap();
 
-        ih.send_multicast(DEFAULT_WESTON_IVI_CONTROLLER_GROUP, data, true)
+        ih.send_multicast(DEFAULT_WESTON_IVI_CONTROLLER_GROUP, frame.payload(), true)
             .map_err(|e| {
                 TransportError::SendError(format!("Failed to send IPCON multicast message: {}", e))
             })
     }
 
-    fn get_connected_clients(&self) -> Vec<ClientId> {
-        let clients_lock = self.clients.lock().unwrap();
-        clients_lock.clone()
+    fn for_each_client(&self, f: &mut dyn FnMut(&ClientId)) {
+        let clients = self.clients.lock().unwrap();
+        for (key, peer) in clients.slab.iter() {
+            f(&ClientId::from_ipcon_peer(key, peer.clone()));
+        }
+    }
+
+    fn client_count(&self) -> usize {
+        self.clients.lock().unwrap().slab.len()
     }
 
     fn register_handler(&mut self, handler: Box<dyn MessageHandler>) {
@@ -323,7 +355,7 @@ mod tests {
         match transport {
             Ok(t) => {
                 assert!(t.handler.is_none());
-                assert_eq!(t.clients.lock().unwrap().len(), 0);
+                assert_eq!(t.client_count(), 0);
                 assert!(!t.running.load(std::sync::atomic::Ordering::SeqCst));
             }
             Err(e) => {
@@ -345,7 +377,7 @@ mod tests {
         match transport {
             Ok(t) => {
                 assert!(t.handler.is_none());
-                assert_eq!(t.clients.lock().unwrap().len(), 0);
+                assert_eq!(t.client_count(), 0);
             }
             Err(e) => {
                 println!(
@@ -386,8 +418,9 @@ mod tests {
         let transport = IpconTransport::new(None);
 
         if let Ok(t) = transport {
-            let clients = t.get_connected_clients();
-            assert_eq!(clients.len(), 0);
+            let mut clients = 0;
+            t.for_each_client(&mut |_| clients += 1);
+            assert_eq!(clients, 0);
         }
     }
 
@@ -395,23 +428,29 @@ mod tests {
     fn test_client_id_conversions() {
         // Test ClientId creation for IPCON
         let peer_name = "test-peer";
-        let client_id = ClientId::from_str(peer_name).unwrap();
+        let mut clients = IpconClients::default();
+        let client_id = clients.connect(peer_name);
 
         // Verify it's an IPCON ID
         assert_eq!(client_id.ipcon_id(), Some(peer_name));
         assert_eq!(client_id.unix_domain_id(), None);
 
-        // Test string conversion
-        let client_id2 = ClientId::from_string(peer_name.to_string());
-        assert_eq!(client_id2.ipcon_id(), Some(peer_name));
+        // Later messages of the peer carry the same key
+        let client_id2 = clients.connect(peer_name);
+        assert_eq!(client_id2.key(), client_id.key());
 
         // Test equality
         assert_eq!(client_id, client_id2);
+
+        // A peer that reconnects is a new client
+        assert_eq!(clients.disconnect(peer_name), Some(client_id.clone()));
+        assert_eq!(clients.disconnect(peer_name), None);
+        assert_ne!(clients.connect(peer_name), client_id);
     }
 
     #[test]
     fn test_client_id_display() {
-        let client_id = ClientId::from_str("test-peer").unwrap();
+        let client_id = IpconClients::default().connect("test-peer");
         let display = format!("{}", client_id);
         assert!(display.contains("IpconId"));
         assert!(display.contains("test-peer"));
@@ -470,15 +509,13 @@ mod tests {
         // This test requires IPCON to be available
         let transport = IpconTransport::new(None).expect("IPCON not available");
 
-        let data = b"multicast test message";
-        let client_ids = [
-            ClientId::from_str("peer1").unwrap(),
-            ClientId::from_str("peer2").unwrap(),
-        ];
+        let frame = SharedFrame::new(b"multicast test message").unwrap();
+        let mut clients = IpconClients::default();
+        let client_ids = [clients.connect("peer1"), clients.connect("peer2")];
         let client_refs: Vec<&ClientId> = client_ids.iter().collect();
 
         // This should use multicast group
-        let result = transport.send_to_clients(&client_refs, data);
+        let result = transport.send_to_clients(&client_refs, &frame);
 
         // May succeed or fail depending on IPCON state
         // Just verify it doesn't panic
@@ -2,35 +2,192 @@
 
 #[allow(unused)]
 use jlogger_tracing::{jdebug, jerror, jinfo, jwarn, JloggerBuilder, LevelFilter};
-use std::collections::HashMap;
-use std::io;
-use std::os::unix::net::{UnixListener, UnixStream};
+use mio::net::{UnixListener, UnixStream};
+use mio::{Events, Interest, Poll, Registry, Token, Waker};
+use std::collections::VecDeque;
+use std::io::{self, IoSlice, Write};
+use std::net::Shutdown;
 use std::path::PathBuf;
 use std::sync::{Arc, Mutex};
 use std::thread::{self, JoinHandle};
-use std::time::Duration;
 
-use crate::rpc::framing::{write_frame, FrameReadResult, FrameReader};
-use crate::rpc::transport::{ClientId, MessageHandler, Transport, TransportError};
+use crate::metrics::metrics;
+use crate::rpc::client_slab::{ClientKey, ClientSlab};
+use crate::rpc::framing::{encode_frame, FillStatus, FrameReader, SharedFrame};
+use crate::rpc::transport::{
+    ClientId, MessageHandler, SlowClientPolicy, Transport, TransportError,
+    DEFAULT_MAX_PENDING_BYTES,
+};
+
+/// Token reserved for the listening socket
+const LISTENER: Token = Token(usize::MAX - 1);
+
+/// Token reserved for the waker used by `stop()`
+const WAKER: Token = Token(usize::MAX);
+
+/// Maximum number of readiness events handled per `poll()` call
+const EVENTS_CAPACITY: usize = 128;
+
+/// Maximum number of queued frames handed to a single `writev` call
+const MAX_IOVECS: usize = 64;
 
 /// Configuration for UNIX domain socket transport
 pub struct UnixSocketConfig {
     pub socket_path: PathBuf,
     pub max_connections: usize,
+    /// High-water mark for bytes queued to a client that is not reading
+    pub max_pending_bytes: usize,
+    /// What to do with a client that exceeds `max_pending_bytes`
+    pub slow_client_policy: SlowClientPolicy,
+}
+
+impl Default for UnixSocketConfig {
+    fn default() -> Self {
+        Self {
+            socket_path: PathBuf::from("/tmp/weston-ivi-controller.sock"),
+            max_connections: 10,
+            max_pending_bytes: DEFAULT_MAX_PENDING_BYTES,
+            slow_client_policy: SlowClientPolicy::default(),
+        }
+    }
+}
+
+/// Maximum number of bytes read from one client before its frames are dispatched
+const READ_BUDGET: usize = 64 * 1024;
+
+/// Multiple of `max_pending_bytes` that responses may still fill under
+/// [`SlowClientPolicy::DropFrames`] before the client is disconnected
+const RESPONSE_QUEUE_FACTOR: usize = 2;
+
+/// What a frame carries, which decides how a full queue treats it
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum FrameKind {
+    /// Answer to a request; the client waits for it by id
+    Response,
+    /// Event the client can resynchronize from if it misses it
+    Notification,
+}
+
+/// A frame waiting in a client's outbound queue
+enum OutboundFrame {
+    /// Frame encoded for a single client
+    Owned(Vec<u8>),
+    /// Frame shared with other clients
+    Shared(SharedFrame),
+}
+
+impl OutboundFrame {
+    fn as_bytes(&self) -> &[u8] {
+        match self {
+            OutboundFrame::Owned(bytes) => bytes,
+            OutboundFrame::Shared(frame) => frame.as_bytes(),
+        }
+    }
+}
+
+/// Per-client queue of encoded frames not yet accepted by the socket.
+///
+/// Frames are written with vectored I/O, so a header and its payload, and
+/// several queued frames, go out in a single system call.
+#[derive(Default)]
+struct OutboundQueue {
+    frames: VecDeque<OutboundFrame>,
+    /// Bytes of the front frame already written
+    head_written: usize,
+    /// Total bytes still to be written
+    pending_bytes: usize,
+}
+
+impl OutboundQueue {
+    fn is_empty(&self) -> bool {
+        self.frames.is_empty()
+    }
+
+    fn pending_bytes(&self) -> usize {
+        self.pending_bytes
+    }
+
+    fn push(&mut self, frame: OutboundFrame) {
+        self.pending_bytes += frame.as_bytes().len();
+        self.frames.push_back(frame);
+    }
+
+    fn clear(&mut self) {
+        self.frames.clear();
+        self.head_written = 0;
+        self.pending_bytes = 0;
+    }
+
+    /// Write queued frames until the queue is empty or the writer would block
+    fn write_to<W: Write>(&mut self, writer: &mut W) -> io::Result<()> {
+        while !self.frames.is_empty() {
+            let written = {
+                let mut slices = Vec::with_capacity(self.frames.len().min(MAX_IOVECS));
+                for (i, frame) in self.frames.iter().take(MAX_IOVECS).enumerate() {
+                    let bytes = frame.as_bytes();
+                    let offset = if i == 0 { self.head_written } else { 0 };
+                    slices.push(IoSlice::new(&bytes[offset..]));
+                }
+
+                match writer.write_vectored(&slices) {
+                    Ok(0) => {
+                        return Err(io::Error::new(
+                            io::ErrorKind::WriteZero,
+                            "Socket refused to accept more data",
+                        ));
+                    }
+                    Ok(n) => n,
+                    Err(e) if e.kind() == io::ErrorKind::WouldBlock => return Ok(()),
+                    Err(e) if e.kind() == io::ErrorKind::Interrupted => continue,
+                    Err(e) => return Err(e),
+                }
+            };
+
+            self.consume(written);
+        }
+
+        Ok(())
+    }
+
+    /// Drop `written` bytes from the front of the queue
+    fn consume(&mut self, mut written: usize) {
+        self.pending_bytes -= written;
+
+        while written > 0 {
+            let remaining = self.frames[0].as_bytes().len() - self.head_written;
+            if written < remaining {
+                self.head_written += written;
+                return;
+            }
+
+            written -= remaining;
+            self.head_written = 0;
+            self.frames.pop_front();
+        }
+    }
 }
 
 /// Client connection state
 struct ClientConnection {
     stream: UnixStream,
-    frame_reader: FrameReader,
+    /// Frames that could not be written without blocking
+    outbound: OutboundQueue,
+    /// Whether the stream is registered for writable readiness
+    awaiting_writable: bool,
+    /// Set once the client was cut off for lagging; the event loop cleans it up
+    closing: bool,
 }
 
 /// Shared state for the transport
 struct TransportState {
-    clients: HashMap<u64, ClientConnection>,
-    next_client_id: u64,
+    /// Connections by slot; a client's `UnixDomainId` is its packed key
+    clients: ClientSlab<ClientConnection>,
     handler: Option<Arc<dyn MessageHandler>>,
     running: bool,
+    /// Registry of the event loop poller, used to toggle writable interest from `send()`
+    registry: Option<Registry>,
+    max_pending_bytes: usize,
+    slow_client_policy: SlowClientPolicy,
 }
 
 /// UNIX domain socket transport implementation
@@ -38,175 +195,385 @@ pub struct UnixSocketTransport {
     config: UnixSocketConfig,
     state: Arc<Mutex<TransportState>>,
     listener_thread: Option<JoinHandle<()>>,
+    waker: Option<Waker>,
 }
 
 impl UnixSocketTransport {
     /// Create a new UNIX socket transport
     pub fn new(config: UnixSocketConfig) -> Self {
+        let state = TransportState {
+            clients: ClientSlab::new(),
+            handler: None,
+            running: false,
+            registry: None,
+            max_pending_bytes: config.max_pending_bytes,
+            slow_client_policy: config.slow_client_policy,
+        };
+
         Self {
             config,
-            state: Arc::new(Mutex::new(TransportState {
-                clients: HashMap::new(),
-                next_client_id: 1,
-                handler: None,
-                running: false,
-            })),
+            state: Arc::new(Mutex::new(state)),
             listener_thread: None,
+            waker: None,
         }
     }
 
-    /// Accept and handle new connections
-    fn accept_connection(
+    /// Map a client to its poll token
+    ///
+    /// Tokens are slots: a slot is only reused after the stream of its
+    /// previous client was deregistered.
+    fn client_token(client_id: ClientKey) -> Token {
+        Token(client_id.slot())
+    }
+
+    /// Accept all pending connections and register them with the poller
+    fn accept_connections(
         listener: &UnixListener,
+        registry: &Registry,
         state: &Arc<Mutex<TransportState>>,
+        max_connections: usize,
     ) -> io::Result<()> {
-        match listener.accept() {
-            Ok((stream, _addr)) => {
-                // Set non-blocking mode
-                stream.set_nonblocking(true)?;
-
-                let mut state_lock = state.lock().unwrap();
-                let client_id = state_lock.next_client_id;
-                state_lock.next_client_id += 1;
-
-                jinfo!("New client connected: {}", client_id);
+        loop {
+            match listener.accept() {
+                Ok((stream, _addr)) => {
+                    let mut state_lock = state.lock().unwrap();
+
+                    if state_lock.clients.len() >= max_connections {
+                        jwarn!(
+                            "Rejecting connection: maximum of {} clients reached",
+                            max_connections
+                        );
+                        continue;
+                    }
 
-                state_lock.clients.insert(
-                    client_id,
-                    ClientConnection {
+                    let client_id = state_lock.clients.insert(ClientConnection {
                         stream,
-                        frame_reader: FrameReader::new(),
-                    },
-                );
+                        outbound: OutboundQueue::default(),
+                        awaiting_writable: false,
+                        closing: false,
+                    });
+                    let connection = state_lock.clients.get_mut(client_id).unwrap();
+
+                    if let Err(e) = registry.register(
+                        &mut connection.stream,
+                        Self::client_token(client_id),
+                        Interest::READABLE,
+                    ) {
+                        state_lock.clients.remove(client_id);
+                        return Err(e);
+                    }
 
-                drop(state_lock);
-                Ok(())
-            }
-            Err(e) if e.kind() == io::ErrorKind::WouldBlock => Ok(()),
-            Err(e) => {
-                jerror!("Error accepting connection: {}", e);
-                Err(e)
+                    jinfo!("New client connected: {}", client_id);
+                }
+                Err(e) if e.kind() == io::ErrorKind::WouldBlock => return Ok(()),
+                Err(e) if e.kind() == io::ErrorKind::Interrupted => continue,
+                Err(e) => {
+                    jerror!("Error accepting connection: {}", e);
+                    return Err(e);
+                }
             }
         }
     }
 
-    /// Read data from a client using length-prefixed protocol (returns messages to process)
-    fn read_from_client(connection: &mut ClientConnection) -> io::Result<(bool, Vec<Vec<u8>>)> {
-        let mut messages = Vec::new();
+    /// Read and dispatch everything a client has sent (returns false if the client is gone).
+    ///
+    /// Bytes are read into the client's frame reader under the state lock, then
+    /// each complete payload is handed to the handler as a slice of that buffer
+    /// after the lock is released (handler.handle_message calls transport.send,
+    /// which needs the lock). The frame readers are owned by the event loop.
+    fn read_from_client(
+        client_id: ClientKey,
+        reader: &mut FrameReader,
+        state: &Arc<Mutex<TransportState>>,
+        handler: Option<&Arc<dyn MessageHandler>>,
+    ) -> bool {
+        let ipc_client_id = ClientId::from_u64(client_id.to_u64());
 
-        // Keep reading frames until we get NeedMore, Eof, or an error
+        // Readiness is edge-triggered, so the socket must be drained here
         loop {
-            match connection.frame_reader.read_frame(&mut connection.stream) {
-                Ok(FrameReadResult::Complete(message)) => {
-                    // Got a complete message
-                    messages.push(message);
-                    // Try to read more messages
-                    continue;
-                }
-                Ok(FrameReadResult::NeedMore) => {
-                    // No more data available or partial message
-                    // Return what we have so far
-                    return Ok((true, messages));
+            let status = {
+                let mut state_lock = state.lock().unwrap();
+                match state_lock.clients.get_mut(client_id) {
+                    Some(connection) => reader.fill_from(&mut connection.stream, READ_BUDGET),
+                    None => return false,
                 }
-                Ok(FrameReadResult::Eof) => {
-                    // Connection closed
-                    return Ok((false, messages));
+            };
+
+            loop {
+                match reader.next_frame() {
+                    Ok(Some(message)) => {
+                        metrics().frame_received(message.len());
+                        if let Some(handler) = handler {
+                            handler.handle_message(&ipc_client_id, message);
+                        }
+                    }
+                    Ok(None) => break,
+                    Err(e) => {
+                        // Protocol violation (zero-length or too large)
+                        jerror!("Protocol error: {}", e);
+                        return false;
+                    }
                 }
-                Err(e) if e.kind() == io::ErrorKind::InvalidData => {
-                    // Protocol violation (zero-length or too large)
-                    jerror!("Protocol error: {}", e);
-                    return Ok((false, messages));
+            }
+
+            match status {
+                // No more data available; a partial frame stays buffered
+                Ok(FillStatus::Drained) => return true,
+                // Let other work in after each budget, then keep reading
+                Ok(FillStatus::BudgetExhausted) => continue,
+                // Connection closed or connection error
+                Ok(FillStatus::Eof) | Err(_) => return false,
+            }
+        }
+    }
+
+    /// Queue an encoded frame for a client, enforcing the high-water mark.
+    ///
+    /// Only notifications are ever dropped: a dropped response would leave
+    /// its caller waiting forever. Under `DropFrames` responses keep being
+    /// queued up to `RESPONSE_QUEUE_FACTOR` times the limit, and beyond that
+    /// the client is disconnected like under `Disconnect`.
+    ///
+    /// Nothing is written here; call `flush_client` once the frames of a send
+    /// are queued so they can be coalesced into one `writev`.
+    fn queue_frame(
+        client_id: ClientKey,
+        connection: &mut ClientConnection,
+        frame: OutboundFrame,
+        kind: FrameKind,
+        max_pending_bytes: usize,
+        policy: SlowClientPolicy,
+    ) -> io::Result<()> {
+        if connection.closing {
+            return Err(io::Error::new(
+                io::ErrorKind::BrokenPipe,
+                "Client is being disconnected",
+            ));
+        }
+
+        // A frame always fits into an empty queue, however large it is
+        let pending = connection.outbound.pending_bytes();
+        let queued = pending + frame.as_bytes().len();
+        if pending > 0 && queued > max_pending_bytes {
+            let response_fits = queued <= max_pending_bytes.saturating_mul(RESPONSE_QUEUE_FACTOR);
+            return match (policy, kind) {
+                (SlowClientPolicy::DropFrames, FrameKind::Response) if response_fits => {
+                    connection.outbound.push(frame);
+                    Ok(())
                 }
-                Err(e) if e.kind() == io::ErrorKind::Interrupted => {
-                    // Retry
-                    continue;
+                (SlowClientPolicy::DropFrames, FrameKind::Notification) => {
+                    jwarn!(
+                        "Client {} is not reading ({} bytes queued), dropping frame",
+                        client_id,
+                        pending
+                    );
+                    metrics().frame_dropped();
+                    Err(io::Error::new(
+                        io::ErrorKind::WouldBlock,
+                        "Client outbound queue is full",
+                    ))
                 }
-                Err(_e) => {
-                    // Connection error
-                    return Ok((false, messages));
+                _ => {
+                    jwarn!(
+                        "Client {} is not reading ({} bytes queued), disconnecting",
+                        client_id,
+                        pending
+                    );
+                    metrics().slow_client_disconnected();
+                    // The shutdown wakes the event loop, which reaps the client
+                    connection.closing = true;
+                    connection.outbound.clear();
+                    let _ = connection.stream.shutdown(Shutdown::Both);
+                    Err(io::Error::new(
+                        io::ErrorKind::BrokenPipe,
+                        "Client outbound queue is full",
+                    ))
                 }
-            }
+            };
         }
+
+        connection.outbound.push(frame);
+        Ok(())
     }
 
-    /// Main event loop for handling connections
-    fn event_loop(listener: UnixListener, state: Arc<Mutex<TransportState>>) {
-        listener.set_nonblocking(true).unwrap();
+    /// Write queued frames and keep writable interest in line with the queue
+    fn flush_client(
+        client_id: ClientKey,
+        connection: &mut ClientConnection,
+        registry: Option<&Registry>,
+    ) -> io::Result<()> {
+        if connection.closing {
+            return Ok(());
+        }
 
-        loop {
-            // Check if we should stop
-            {
-                let state_lock = state.lock().unwrap();
-                if !state_lock.running {
-                    break;
-                }
+        connection.outbound.write_to(&mut connection.stream)?;
+
+        // Only wait for writable readiness while something is queued, to avoid spurious wakeups
+        let wants_writable = !connection.outbound.is_empty();
+        if wants_writable != connection.awaiting_writable {
+            if let Some(registry) = registry {
+                let interest = if wants_writable {
+                    Interest::READABLE | Interest::WRITABLE
+                } else {
+                    Interest::READABLE
+                };
+                registry.reregister(
+                    &mut connection.stream,
+                    Self::client_token(client_id),
+                    interest,
+                )?;
+                connection.awaiting_writable = wants_writable;
             }
+        }
 
-            // Accept new connections
-            let _ = Self::accept_connection(&listener, &state);
+        Ok(())
+    }
 
-            // Process existing connections
-            let mut disconnected_clients = Vec::new();
-            let mut client_messages: Vec<(ClientId, Vec<Vec<u8>>)> = Vec::new();
+    /// Queue frames for a client and write them unless the socket is known to be full
+    fn send_frames<I>(
+        state: &mut TransportState,
+        client_id: ClientKey,
+        kind: FrameKind,
+        frames: I,
+    ) -> Result<(), TransportError>
+    where
+        I: IntoIterator<Item = OutboundFrame>,
+    {
+        let connection = state
+            .clients
+            .get_mut(client_id)
+            .ok_or_else(|| TransportError::SendError(format!("Client {} not found", client_id)))?;
+
+        let mut result = Ok(());
+        for frame in frames {
+            if let Err(e) = Self::queue_frame(
+                client_id,
+                connection,
+                frame,
+                kind,
+                state.max_pending_bytes,
+                state.slow_client_policy,
+            ) {
+                result = Err(TransportError::SendError(format!(
+                    "Failed to send frame: {}",
+                    e
+                )));
+                break;
+            }
+        }
 
-            {
-                let mut state_lock = state.lock().unwrap();
+        // While waiting for writable readiness the event loop does the flushing
+        if !connection.awaiting_writable {
+            Self::flush_client(client_id, connection, state.registry.as_ref())
+                .map_err(|e| TransportError::SendError(format!("Failed to send frame: {}", e)))?;
+        }
 
-                for (&client_id, connection) in state_lock.clients.iter_mut() {
-                    match Self::read_from_client(connection) {
-                        Ok((alive, messages)) => {
-                            // Store messages if any
-                            if !messages.is_empty() {
-                                client_messages.push((ClientId::from_u64(client_id), messages));
-                            }
+        result
+    }
 
-                            // Mark for disconnection if not alive
-                            if !alive {
-                                disconnected_clients.push(client_id);
-                            }
-                        }
-                        Err(_) => {
-                            // Connection error
-                            disconnected_clients.push(client_id);
-                        }
-                    }
+    /// Main event loop for handling connections.
+    ///
+    /// Blocks in `Poll::poll` until a socket becomes ready or `stop()` fires the waker,
+    /// so the thread consumes no CPU while idle.
+    fn event_loop(
+        mut poll: Poll,
+        listener: UnixListener,
+        state: Arc<Mutex<TransportState>>,
+        max_connections: usize,
+    ) {
+        let mut events = Events::with_capacity(EVENTS_CAPACITY);
+        // Frame readers by client slot, next to the connections they belong to
+        let mut readers: Vec<Option<FrameReader>> = Vec::new();
+
+        loop {
+            if let Err(e) = poll.poll(&mut events, None) {
+                if e.kind() == io::ErrorKind::Interrupted {
+                    continue;
                 }
+                jerror!("Failed to poll for events: {}", e);
+                break;
             }
 
-            // Process messages outside the lock
-            // Get handler reference before releasing lock
+            // Check if we should stop (the waker is only fired by stop())
             let handler = {
                 let state_lock = state.lock().unwrap();
+                if !state_lock.running {
+                    break;
+                }
                 state_lock.handler.clone()
             };
+            let mut disconnected_clients = Vec::new();
 
-            // Call handler without holding the state lock to avoid deadlock
-            // (handler.handle_message calls transport.send which needs to acquire the lock)
-            if let Some(ref handler) = handler {
-                for (client_id, messages) in client_messages {
-                    for message in messages {
-                        handler.handle_message(&client_id, &message);
+            for event in events.iter() {
+                match event.token() {
+                    WAKER => {}
+                    LISTENER => {
+                        // Accept new connections
+                        let _ = Self::accept_connections(
+                            &listener,
+                            poll.registry(),
+                            &state,
+                            max_connections,
+                        );
+                    }
+                    token => {
+                        let Some(client_id) = state.lock().unwrap().clients.key_at(token.0) else {
+                            continue;
+                        };
+
+                        if event.is_writable() {
+                            let mut state_lock = state.lock().unwrap();
+                            let connection = match state_lock.clients.get_mut(client_id) {
+                                Some(connection) => connection,
+                                None => continue,
+                            };
+
+                            if let Err(e) =
+                                Self::flush_client(client_id, connection, Some(poll.registry()))
+                            {
+                                jdebug!("Failed to flush client {}: {}", client_id, e);
+                                disconnected_clients.push(client_id);
+                                continue;
+                            }
+                        }
+
+                        if event.is_readable() || event.is_read_closed() || event.is_error() {
+                            if readers.len() <= client_id.slot() {
+                                readers.resize_with(client_id.slot() + 1, || None);
+                            }
+                            let reader =
+                                readers[client_id.slot()].get_or_insert_with(Default::default);
+                            if !Self::read_from_client(client_id, reader, &state, handler.as_ref())
+                            {
+                                disconnected_clients.push(client_id);
+                            }
+                        }
                     }
                 }
             }
 
             // Clean up disconnected clients
-            if !disconnected_clients.is_empty() {
-                let mut state_lock = state.lock().unwrap();
+            for client_id in disconnected_clients {
+                if let Some(reader) = readers.get_mut(client_id.slot()) {
+                    *reader = None;
+                }
+                let removed = state.lock().unwrap().clients.remove(client_id);
 
-                for client_id in disconnected_clients {
+                if let Some(mut connection) = removed {
                     jinfo!("Client {} disconnected, cleaning up", client_id);
-                    state_lock.clients.remove(&client_id);
+                    let _ = poll.registry().deregister(&mut connection.stream);
 
-                    if let Some(ref handler) = state_lock.handler {
-                        handler.handle_disconnect(&ClientId::from_u64(client_id));
+                    if let Some(ref handler) = handler {
+                        handler.handle_disconnect(&ClientId::from_u64(client_id.to_u64()));
                     }
                 }
             }
-
-            // Small sleep to avoid busy-waiting
-            thread::sleep(Duration::from_millis(10));
         }
+
+        // Drop all connections; the poller and listener go away with this thread
+        let mut state_lock = state.lock().unwrap();
+        state_lock.clients.clear();
+        state_lock.registry = None;
     }
 }
 
@@ -227,24 +594,50 @@ impl Transport for UnixSocketTransport {
         }
 
         // Create the UNIX domain socket
-        let listener = UnixListener::bind(&self.config.socket_path).map_err(|e| {
+        let mut listener = UnixListener::bind(&self.config.socket_path).map_err(|e| {
             jerror!("Failed to bind socket: {}", e);
             TransportError::InitError(format!("Failed to bind socket: {}", e))
         })?;
 
+        // Set up the poller with the listener and a waker for stop()
+        let poll = Poll::new().map_err(|e| {
+            jerror!("Failed to create poller: {}", e);
+            TransportError::InitError(format!("Failed to create poller: {}", e))
+        })?;
+
+        poll.registry()
+            .register(&mut listener, LISTENER, Interest::READABLE)
+            .map_err(|e| {
+                jerror!("Failed to register listener: {}", e);
+                TransportError::InitError(format!("Failed to register listener: {}", e))
+            })?;
+
+        let waker = Waker::new(poll.registry(), WAKER).map_err(|e| {
+            jerror!("Failed to create waker: {}", e);
+            TransportError::InitError(format!("Failed to create waker: {}", e))
+        })?;
+
+        let registry = poll.registry().try_clone().map_err(|e| {
+            jerror!("Failed to clone poll registry: {}", e);
+            TransportError::InitError(format!("Failed to clone poll registry: {}", e))
+        })?;
+
         // Mark as running
         {
             let mut state = self.state.lock().unwrap();
             state.running = true;
+            state.registry = Some(registry);
         }
 
         // Start the listener thread
         let state_clone = Arc::clone(&self.state);
+        let max_connections = self.config.max_connections;
         let handle = thread::spawn(move || {
-            Self::event_loop(listener, state_clone);
+            Self::event_loop(poll, listener, state_clone, max_connections);
         });
 
         self.listener_thread = Some(handle);
+        self.waker = Some(waker);
 
         jinfo!("UNIX socket transport started successfully");
         Ok(())
@@ -259,6 +652,14 @@ impl Transport for UnixSocketTransport {
             state.running = false;
         }
 
+        // Interrupt the blocking poll so the thread notices. The waker must stay
+        // alive until the thread has exited: closing it drops the pending event.
+        if let Some(ref waker) = self.waker {
+            if let Err(e) = waker.wake() {
+                jerror!("Failed to wake listener thread: {}", e);
+            }
+        }
+
         // Wait for the thread to finish
         if let Some(handle) = self.listener_thread.take() {
             handle.join().map_err(|_| {
@@ -266,6 +667,7 @@ impl Transport for UnixSocketTransport {
                 TransportError::ConnectionError("Failed to join listener thread".to_string())
             })?;
         }
+        self.waker = None;
 
         // Clean up the socket file
         if self.config.socket_path.exists() {
@@ -284,38 +686,75 @@ impl Transport for UnixSocketTransport {
     fn send(&self, client_id: &ClientId, data: &[u8]) -> Result<(), TransportError> {
         let mut state = self.state.lock().unwrap();
 
-        let client_id = client_id.unix_domain_id().ok_or_else(|| {
-            TransportError::SendError(format!(
-                "Client ID {} is not a valid UNIX domain socket ID",
-                client_id
-            ))
-        })?;
+        let client_id = client_id
+            .unix_domain_id()
+            .map(ClientKey::from_u64)
+            .ok_or_else(|| {
+                TransportError::SendError(format!(
+                    "Client ID {} is not a valid UNIX domain socket ID",
+                    client_id
+                ))
+            })?;
 
-        if let Some(connection) = state.clients.get_mut(&client_id) {
-            // Use the shared framing module to write the frame
-            write_frame(&mut connection.stream, data)
-                .map_err(|e| TransportError::SendError(format!("Failed to send frame: {}", e)))?;
+        let frame = encode_frame(data)
+            .map_err(|e| TransportError::SendError(format!("Failed to send frame: {}", e)))?;
 
-            Ok(())
-        } else {
-            Err(TransportError::SendError(format!(
-                "Client {} not found",
-                client_id
-            )))
-        }
+        Self::send_frames(
+            &mut state,
+            client_id,
+            FrameKind::Response,
+            [OutboundFrame::Owned(frame)],
+        )
     }
 
-    fn send_to_clients(&self, client_ids: &[&ClientId], data: &[u8]) -> Result<(), TransportError> {
+    fn send_batch(
+        &self,
+        client_id: &ClientId,
+        frames: &[SharedFrame],
+    ) -> Result<(), TransportError> {
+        let mut state = self.state.lock().unwrap();
+
+        let client_id = client_id
+            .unix_domain_id()
+            .map(ClientKey::from_u64)
+            .ok_or_else(|| {
+                TransportError::SendError(format!(
+                    "Client ID {} is not a valid UNIX domain socket ID",
+                    client_id
+                ))
+            })?;
+
+        // Frames are already encoded; the whole batch is queued and written together
+        Self::send_frames(
+            &mut state,
+            client_id,
+            FrameKind::Notification,
+            frames.iter().cloned().map(OutboundFrame::Shared),
+        )
+    }
+
+    fn send_to_clients(
+        &self,
+        client_ids: &[&ClientId],
+        frame: &SharedFrame,
+    ) -> Result<(), TransportError> {
         let mut state = self.state.lock().unwrap();
         let mut errors = Vec::new();
 
         for &client_id in client_ids {
-            if let Some(client_id) = client_id.unix_domain_id() {
-                if let Some(connection) = state.clients.get_mut(&client_id) {
-                    // Use the shared framing module (best-effort delivery)
-                    if let Err(e) = write_frame(&mut connection.stream, data) {
-                        errors.push((client_id, e));
-                    }
+            if let Some(client_id) = client_id.unix_domain_id().map(ClientKey::from_u64) {
+                if !state.clients.contains(client_id) {
+                    continue;
+                }
+
+                // Best-effort delivery; every client gets the same shared bytes
+                if let Err(e) = Self::send_frames(
+                    &mut state,
+                    client_id,
+                    FrameKind::Notification,
+                    [OutboundFrame::Shared(frame.clone())],
+                ) {
+                    errors.push((client_id, e));
                 }
             } else {
                 jwarn!(
@@ -324,7 +763,6 @@ impl Transport for UnixSocketTransport {
                 );
             }
         }
-
         if errors.is_empty() {
             Ok(())
         } else {
@@ -334,13 +772,15 @@ impl Transport for UnixSocketTransport {
         }
     }
 
-    fn get_connected_clients(&self) -> Vec<ClientId> {
+    fn for_each_client(&self, f: &mut dyn FnMut(&ClientId)) {
         let state = self.state.lock().unwrap();
-        state
-            .clients
-            .keys()
-            .map(|&id| ClientId::from_u64(id))
-            .collect()
+        for (key, _) in state.clients.iter() {
+            f(&ClientId::from_u64(key.to_u64()));
+        }
+    }
+
+    fn client_count(&self) -> usize {
+        self.state.lock().unwrap().clients.len()
     }
 
     fn register_handler(&mut self, handler: Box<dyn MessageHandler>) {
@@ -378,6 +818,12 @@ mod tests {
         }
     }
 
+    fn connected_clients(transport: &UnixSocketTransport) -> Vec<ClientId> {
+        let mut clients = Vec::new();
+        transport.for_each_client(&mut |client_id| clients.push(client_id.clone()));
+        clients
+    }
+
     #[test]
     fn test_unix_socket_basic() {
         let socket_path = PathBuf::from("/tmp/test_ivi_socket_basic");
@@ -388,6 +834,7 @@ mod tests {
         let config = UnixSocketConfig {
             socket_path: socket_path.clone(),
             max_connections: 10,
+            ..Default::default()
         };
 
         let messages = Arc::new(Mutex::new(Vec::new()));
@@ -454,6 +901,7 @@ mod tests {
         let config = UnixSocketConfig {
             socket_path: socket_path.clone(),
             max_connections: 10,
+            ..Default::default()
         };
 
         let messages = Arc::new(Mutex::new(Vec::new()));
@@ -503,4 +951,267 @@ mod tests {
         // Clean up
         let _ = std::fs::remove_file(&socket_path);
     }
+
+    #[test]
+    fn test_unix_socket_stop_wakes_idle_loop() {
+        let socket_path = PathBuf::from("/tmp/test_ivi_socket_stop");
+
+        // Clean up any existing socket
+        let _ = std::fs::remove_file(&socket_path);
+
+        let config = UnixSocketConfig {
+            socket_path: socket_path.clone(),
+            max_connections: 10,
+            ..Default::default()
+        };
+
+        let mut transport = UnixSocketTransport::new(config);
+        transport.start().expect("Failed to start transport");
+
+        // Let the loop block in poll() with nothing to do
+        thread::sleep(Duration::from_millis(100));
+
+        // stop() must interrupt the blocking poll instead of waiting for traffic
+        let started = std::time::Instant::now();
+        transport.stop().expect("Failed to stop transport");
+        assert!(started.elapsed() < Duration::from_secs(1));
+        assert!(!socket_path.exists());
+    }
+
+    #[test]
+    fn test_unix_socket_max_connections() {
+        let socket_path = PathBuf::from("/tmp/test_ivi_socket_max_conn");
+
+        // Clean up any existing socket
+        let _ = std::fs::remove_file(&socket_path);
+
+        let config = UnixSocketConfig {
+            socket_path: socket_path.clone(),
+            max_connections: 1,
+            ..Default::default()
+        };
+
+        let mut transport = UnixSocketTransport::new(config);
+        transport.start().expect("Failed to start transport");
+
+        let _client1 = UnixStream::connect(&socket_path).expect("Failed to connect client 1");
+        thread::sleep(Duration::from_millis(100));
+
+        // The second connection is accepted by the kernel but dropped by the transport
+        let _client2 = UnixStream::connect(&socket_path).expect("Failed to connect client 2");
+        thread::sleep(Duration::from_millis(100));
+
+        assert_eq!(transport.client_count(), 1);
+
+        // Stop the transport
+        transport.stop().expect("Failed to stop transport");
+
+        // Clean up
+        let _ = std::fs::remove_file(&socket_path);
+    }
+
+    /// Writer that accepts a limited number of bytes before it would block
+    struct LimitedWriter {
+        written: Vec<u8>,
+        capacity: usize,
+        calls: usize,
+    }
+
+    impl Write for LimitedWriter {
+        fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+            self.write_vectored(&[IoSlice::new(buf)])
+        }
+
+        fn write_vectored(&mut self, bufs: &[IoSlice<'_>]) -> io::Result<usize> {
+            self.calls += 1;
+            let room = self.capacity - self.written.len();
+            if room == 0 {
+                return Err(io::Error::new(io::ErrorKind::WouldBlock, "full"));
+            }
+
+            let mut taken = 0;
+            for buf in bufs {
+                let n = buf.len().min(room - taken);
+                self.written.extend_from_slice(&buf[..n]);
+                taken += n;
+            }
+            Ok(taken)
+        }
+
+        fn flush(&mut self) -> io::Result<()> {
+            Ok(())
+        }
+    }
+
+    #[test]
+    fn test_outbound_queue_coalesces_and_resumes() {
+        let mut queue = OutboundQueue::default();
+        let shared = SharedFrame::new(b"shared").unwrap();
+        queue.push(OutboundFrame::Owned(encode_frame(b"first").unwrap()));
+        queue.push(OutboundFrame::Shared(shared.clone()));
+        queue.push(OutboundFrame::Shared(shared));
+        assert_eq!(queue.pending_bytes(), 9 + 10 + 10);
+
+        // All frames are written by one vectored call
+        let mut writer = LimitedWriter {
+            written: Vec::new(),
+            capacity: 1024,
+            calls: 0,
+        };
+        queue.write_to(&mut writer).unwrap();
+        assert_eq!(writer.calls, 1);
+        assert!(queue.is_empty());
+        assert_eq!(queue.pending_bytes(), 0);
+
+        // A partial write resumes in the middle of a frame
+        let mut queue = OutboundQueue::default();
+        queue.push(OutboundFrame::Owned(encode_frame(b"first").unwrap()));
+        queue.push(OutboundFrame::Owned(encode_frame(b"second").unwrap()));
+        let mut partial = LimitedWriter {
+            written: Vec::new(),
+            capacity: 12,
+            calls: 0,
+        };
+        queue.write_to(&mut partial).unwrap();
+        assert_eq!(queue.pending_bytes(), 9 + 10 - 12);
+
+        partial.capacity = 1024;
+        queue.write_to(&mut partial).unwrap();
+        assert!(queue.is_empty());
+
+        let mut expected = encode_frame(b"first").unwrap();
+        expected.extend_from_slice(&encode_frame(b"second").unwrap());
+        assert_eq!(partial.written, expected);
+    }
+
+    #[test]
+    fn test_unix_socket_disconnects_lagging_client() {
+        let socket_path = PathBuf::from("/tmp/test_ivi_socket_lagging");
+
+        // Clean up any existing socket
+        let _ = std::fs::remove_file(&socket_path);
+
+        let config = UnixSocketConfig {
+            socket_path: socket_path.clone(),
+            max_connections: 10,
+            max_pending_bytes: 64 * 1024,
+            slow_client_policy: SlowClientPolicy::Disconnect,
+        };
+
+        let messages = Arc::new(Mutex::new(Vec::new()));
+        let disconnects = Arc::new(Mutex::new(Vec::new()));
+
+        let handler = TestHandler {
+            messages: Arc::clone(&messages),
+            disconnects: Arc::clone(&disconnects),
+        };
+
+        let mut transport = UnixSocketTransport::new(config);
+        transport.register_handler(Box::new(handler));
+        transport.start().expect("Failed to start transport");
+
+        // Connect a client that never reads
+        let _client = UnixStream::connect(&socket_path).expect("Failed to connect");
+        thread::sleep(Duration::from_millis(100));
+
+        let clients = connected_clients(&transport);
+        assert_eq!(clients.len(), 1);
+
+        // Fill the socket buffer and then the outbound queue; sending never blocks
+        let payload = vec![b'x'; 16 * 1024];
+        let started = std::time::Instant::now();
+        let mut failed = false;
+        for _ in 0..1024 {
+            if transport.send(&clients[0], &payload).is_err() {
+                failed = true;
+                break;
+            }
+        }
+        assert!(failed);
+        assert!(started.elapsed() < Duration::from_secs(1));
+
+        // Give the event loop time to reap the client
+        thread::sleep(Duration::from_millis(100));
+
+        assert_eq!(transport.client_count(), 0);
+        assert_eq!(disconnects.lock().unwrap().len(), 1);
+
+        // Stop the transport
+        transport.stop().expect("Failed to stop transport");
+
+        // Clean up
+        let _ = std::fs::remove_file(&socket_path);
+    }
+
+    #[test]
+    fn test_unix_socket_drops_frames_for_lagging_client() {
+        let socket_path = PathBuf::from("/tmp/test_ivi_socket_drop");
+
+        // Clean up any existing socket
+        let _ = std::fs::remove_file(&socket_path);
+
+        let config = UnixSocketConfig {
+            socket_path: socket_path.clone(),
+            max_connections: 10,
+            max_pending_bytes: 64 * 1024,
+            slow_client_policy: SlowClientPolicy::DropFrames,
+        };
+
+        let mut transport = UnixSocketTransport::new(config);
+        transport.start().expect("Failed to start transport");
+
+        let client = UnixStream::connect(&socket_path).expect("Failed to connect");
+        thread::sleep(Duration::from_millis(100));
+
+        let clients = connected_clients(&transport);
+        let payload = vec![b'x'; 16 * 1024];
+        let notification = SharedFrame::new(&payload).unwrap();
+        let mut sent = 0;
+        while transport
+            .send_batch(&clients[0], std::slice::from_ref(&notification))
+            .is_ok()
+        {
+            sent += 1;
+            assert!(sent < 1024, "Outbound queue is not bounded");
+        }
+
+        // Responses are queued past the limit the notifications hit
+        let response = vec![b'r'; 1024];
+        transport
+            .send(&clients[0], &response)
+            .expect("Response was dropped");
+
+        // The client stays connected and receives every frame that was accepted
+        assert_eq!(transport.client_count(), 1);
+
+        client
+            .set_read_timeout(Some(Duration::from_secs(1)))
+            .expect("Failed to set timeout");
+        let mut reader = crate::rpc::framing::FrameReader::new();
+        let mut client = client;
+        for _ in 0..sent {
+            match reader
+                .read_frame(&mut client)
+                .expect("Failed to read frame")
+            {
+                crate::rpc::framing::FrameReadResult::Complete(frame) => {
+                    assert_eq!(frame, payload)
+                }
+                _ => panic!("Expected a complete frame"),
+            }
+        }
+        match reader
+            .read_frame(&mut client)
+            .expect("Failed to read frame")
+        {
+            crate::rpc::framing::FrameReadResult::Complete(frame) => assert_eq!(frame, response),
+            _ => panic!("Expected the response"),
+        }
+
+        // Stop the transport
+        transport.stop().expect("Failed to stop transport");
+
+        // Clean up
+        let _ = std::fs::remove_file(&socket_path);
+    }
 }